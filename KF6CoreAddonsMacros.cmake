@@ -5,6 +5,7 @@
 #     [SOURCES <src> [<src> [...]]] # optional since 5.83, required before
 #     [STATIC]
 #     [INSTALL_NAMESPACE "servicename"]
+#     [JSON <file>] # since 6.0
 # )
 #
 # This macro helps simplifying the creation of plugins for KPluginFactory
@@ -14,14 +15,117 @@
 # within ${KDE_INSTALL_PLUGINDIR}.
 # Since 5.89 the macro supports static plugins by passing in the STATIC option.
 #
+# Since 6.0 the JSON metadata of the plugin is checked when configuring, so that
+# mistakes show up at build time rather than when loading the plugin. Invalid JSON
+# is an error, values of the "KPlugin" object not having the type given by
+# kpluginmetadata.schema.json are warned about. The metadata file is the one given
+# by JSON, otherwise the one of K_PLUGIN_CLASS_WITH_JSON or K_PLUGIN_FACTORY_WITH_JSON
+# in the SOURCES. The check needs CMake 3.19.
+#
 # Example:
 #   kcoreaddons_add_plugin(kdeconnect_share SOURCES ${kdeconnect_share_SRCS} INSTALL_NAMESPACE "kdeconnect")
 #
 # Since 5.10.0
 
+# The metadata file of K_PLUGIN_CLASS_WITH_JSON or K_PLUGIN_FACTORY_WITH_JSON in @p sources, if any
+function(_kcoreaddons_find_plugin_json result)
+    set(${result} "" PARENT_SCOPE)
+    foreach(source IN LISTS ARGN)
+        get_filename_component(source "${source}" ABSOLUTE)
+        if (NOT EXISTS "${source}" OR NOT source MATCHES "\\.(cpp|cc|cxx)$")
+            continue()
+        endif()
+        file(STRINGS "${source}" lines REGEX "K_PLUGIN_(CLASS|FACTORY)_WITH_JSON\\(")
+        if (lines MATCHES "\"([^\"]+\\.json)\"")
+            # Relative to the source file, like moc looks it up
+            get_filename_component(sourceDir "${source}" DIRECTORY)
+            get_filename_component(json "${CMAKE_MATCH_1}" ABSOLUTE BASE_DIR "${sourceDir}")
+            set(${result} "${json}" PARENT_SCOPE)
+            return()
+        endif()
+    endforeach()
+endfunction()
+
+# Checks the plugin metadata @p json of @p plugin against kpluginmetadata.schema.json
+function(_kcoreaddons_check_plugin_json plugin json)
+    if (CMAKE_VERSION VERSION_LESS 3.19 OR NOT EXISTS "${json}")
+        return()
+    endif()
+    set(schemaFile "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/kpluginmetadata.schema.json")
+    if (NOT EXISTS "${schemaFile}")
+        # Building KCoreAddons itself
+        set(schemaFile "${CMAKE_CURRENT_FUNCTION_LIST_DIR}/src/lib/plugin/kpluginmetadata.schema.json")
+    endif()
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${json}")
+    file(READ "${json}" metadata)
+    file(READ "${schemaFile}" schema)
+
+    string(JSON type ERROR_VARIABLE error TYPE "${metadata}")
+    if (error)
+        message(SEND_ERROR "The metadata ${json} of the plugin ${plugin} is not valid JSON: ${error}")
+        return()
+    endif()
+    string(JSON type ERROR_VARIABLE error TYPE "${metadata}" KPlugin)
+    if (error)
+        return()
+    endif()
+    if (NOT type STREQUAL "OBJECT")
+        message(AUTHOR_WARNING "In the metadata ${json} of the plugin ${plugin}, KPlugin is expected to be an object, but it is ${type}")
+        return()
+    endif()
+
+    # The schema type of a KPlugin value, or of the items of its array, as named by string(JSON TYPE)
+    macro(_schema_type var)
+        string(JSON ${var} ERROR_VARIABLE error GET "${schema}" properties KPlugin properties ${ARGN} type)
+        if (error)
+            # {"$ref": "#/definitions/KAboutPerson"}
+            string(JSON ref ERROR_VARIABLE error GET "${schema}" properties KPlugin properties ${ARGN} $ref)
+            string(REGEX REPLACE "^#/definitions/" "" definition "${ref}")
+            string(JSON ${var} ERROR_VARIABLE error GET "${schema}" definitions "${definition}" type)
+        endif()
+        if (error)
+            set(${var} "")
+        endif()
+        string(TOUPPER "${${var}}" ${var})
+    endmacro()
+
+    string(JSON count LENGTH "${metadata}" KPlugin)
+    if (count EQUAL 0)
+        return()
+    endif()
+    math(EXPR last "${count} - 1")
+    foreach(index RANGE ${last})
+        string(JSON key MEMBER "${metadata}" KPlugin ${index})
+        # Keys the schema doesn't know, e.g. the translations like Name[de], may have any type
+        _schema_type(expected "${key}")
+        if (NOT expected)
+            continue()
+        endif()
+        string(JSON actual TYPE "${metadata}" KPlugin "${key}")
+        if (NOT actual STREQUAL expected)
+            message(AUTHOR_WARNING "In the metadata ${json} of the plugin ${plugin}, ${key} is expected to be ${expected}, but it is ${actual}")
+            continue()
+        endif()
+        if (actual STREQUAL "ARRAY")
+            _schema_type(expectedItem "${key}" items)
+            string(JSON itemCount LENGTH "${metadata}" KPlugin "${key}")
+            if (NOT expectedItem OR itemCount EQUAL 0)
+                continue()
+            endif()
+            math(EXPR lastItem "${itemCount} - 1")
+            foreach(item RANGE ${lastItem})
+                string(JSON actualItem TYPE "${metadata}" KPlugin "${key}" ${item})
+                if (NOT actualItem STREQUAL expectedItem)
+                    message(AUTHOR_WARNING "In the metadata ${json} of the plugin ${plugin}, the items of ${key} are expected to be ${expectedItem}, but item ${item} is ${actualItem}")
+                endif()
+            endforeach()
+        endif()
+    endforeach()
+endfunction()
+
 function(kcoreaddons_add_plugin plugin)
     set(options STATIC)
-    set(oneValueArgs INSTALL_NAMESPACE)
+    set(oneValueArgs INSTALL_NAMESPACE JSON)
     set(multiValueArgs SOURCES)
     cmake_parse_arguments(ARGS "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
 
@@ -35,6 +139,15 @@ function(kcoreaddons_add_plugin plugin)
         set(ARGS_STATIC ON)
     endif()
 
+    if (ARGS_JSON)
+        get_filename_component(ARGS_JSON "${ARGS_JSON}" ABSOLUTE)
+    else()
+        _kcoreaddons_find_plugin_json(ARGS_JSON ${ARGS_SOURCES})
+    endif()
+    if (ARGS_JSON)
+        _kcoreaddons_check_plugin_json(${plugin} "${ARGS_JSON}")
+    endif()
+
     if (ARGS_STATIC)
         add_library(${plugin} STATIC ${ARGS_SOURCES})
         target_compile_definitions(${plugin} PRIVATE QT_STATICPLUGIN)
@@ -120,6 +120,84 @@ void KAutoSaveFileTest::test_fileStaleFiles()
     QVERIFY(saveFile.staleFiles(normalFile, QStringLiteral("qttest")).isEmpty());
 }
 
+void KAutoSaveFileTest::test_staleFilesOfSimilarNames()
+{
+    const QUrl shortName = QUrl::fromLocalFile(QDir::temp().absoluteFilePath(QStringLiteral("similar.txt")));
+    const QUrl longName = QUrl::fromLocalFile(QDir::temp().absoluteFilePath(QStringLiteral("similar.txt.bak")));
+
+    KAutoSaveFile shortSaveFile(shortName);
+    QVERIFY(shortSaveFile.open(QIODevice::ReadWrite));
+    KAutoSaveFile longSaveFile(longName);
+    QVERIFY(longSaveFile.open(QIODevice::ReadWrite));
+
+    // Only the names of the stale files of shortName begin with the same name
+    const QList<KAutoSaveFile *> shortStaleFiles = KAutoSaveFile::staleFiles(shortName, QStringLiteral("qttest"));
+    QCOMPARE(shortStaleFiles.size(), 1);
+    QCOMPARE(shortStaleFiles.at(0)->fileName(), shortSaveFile.fileName());
+    qDeleteAll(shortStaleFiles);
+
+    const QList<KAutoSaveFile *> longStaleFiles = KAutoSaveFile::staleFiles(longName, QStringLiteral("qttest"));
+    QCOMPARE(longStaleFiles.size(), 1);
+    QCOMPARE(longStaleFiles.at(0)->fileName(), longSaveFile.fileName());
+    qDeleteAll(longStaleFiles);
+
+    const QList<KAutoSaveFile *> allStaleFiles = KAutoSaveFile::allStaleFiles(QStringLiteral("qttest"));
+    QStringList allFileNames;
+    for (const KAutoSaveFile *file : allStaleFiles) {
+        allFileNames << file->fileName();
+    }
+    qDeleteAll(allStaleFiles);
+    QVERIFY(allFileNames.contains(shortSaveFile.fileName()));
+    QVERIFY(allFileNames.contains(longSaveFile.fileName()));
+
+    shortSaveFile.releaseLock();
+    longSaveFile.releaseLock();
+}
+
+void KAutoSaveFileTest::test_snapshots()
+{
+    const QUrl normalFile = QUrl::fromLocalFile(QDir::temp().absoluteFilePath(QStringLiteral("snapshots.txt")));
+
+    KAutoSaveFile saveFile(normalFile);
+    QVERIFY(!saveFile.writeSnapshot("not locked yet"));
+    QVERIFY(saveFile.open(QIODevice::ReadWrite));
+
+    // Only the newest snapshot is written
+    saveFile.setSnapshotInterval(60 * 60 * 1000);
+    QCOMPARE(saveFile.snapshotInterval(), 60 * 60 * 1000);
+    QVERIFY(saveFile.writeSnapshot("one"));
+    QVERIFY(saveFile.writeSnapshot("two"));
+    QVERIFY(saveFile.writeSnapshot("three"));
+    saveFile.flushSnapshot();
+
+    auto readAutoSaveFile = [&saveFile]() {
+        QFile file(saveFile.fileName());
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    };
+    QCOMPARE(readAutoSaveFile(), QByteArray("three"));
+    KAutoSaveFile::SnapshotStatistics statistics = saveFile.snapshotStatistics();
+    QCOMPARE(statistics.writtenCount, 1);
+    QCOMPARE(statistics.droppedCount, 2);
+    QCOMPARE(statistics.failedCount, 0);
+    QVERIFY(statistics.lastLatency > 0);
+    QVERIFY(statistics.maxLatency >= statistics.lastLatency);
+
+    // Written after the interval, from the event loop
+    saveFile.setSnapshotInterval(0);
+    QVERIFY(saveFile.writeSnapshot("four"));
+    QTRY_COMPARE(saveFile.snapshotStatistics().writtenCount, 2);
+    QCOMPARE(readAutoSaveFile(), QByteArray("four"));
+
+    // Pending snapshots are dropped along with the file
+    saveFile.setSnapshotInterval(60 * 60 * 1000);
+    QVERIFY(saveFile.writeSnapshot("five"));
+    const QString autoSaveFileName = saveFile.fileName();
+    saveFile.releaseLock();
+    QVERIFY(!QFile::exists(autoSaveFileName));
+    QCOMPARE(saveFile.snapshotStatistics().droppedCount, 3);
+    QVERIFY(!saveFile.writeSnapshot("six"));
+}
+
 void KAutoSaveFileTest::test_applicationStaleFiles()
 {
     // TODO
@@ -20,6 +20,8 @@ private Q_SLOTS:
     void test_readWrite();
     void test_fileNameMaxLength();
     void test_fileStaleFiles();
+    void test_staleFilesOfSimilarNames();
+    void test_snapshots();
     void test_applicationStaleFiles();
     void test_locking();
     void cleanupTestCase();
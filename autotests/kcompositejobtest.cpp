@@ -26,6 +26,29 @@ void TestJob::doEmit()
     emitResult();
 }
 
+int QuickJob::s_running = 0;
+int QuickJob::s_maximumRunning = 0;
+QList<KJob *> QuickJob::s_started;
+
+QuickJob::QuickJob(int error, QObject *parent)
+    : KJob(parent)
+    , m_error(error)
+{
+}
+
+void QuickJob::start()
+{
+    s_started << this;
+    s_maximumRunning = qMax(s_maximumRunning, ++s_running);
+    setTotalAmount(Bytes, 10);
+    QTimer::singleShot(0, this, [this]() {
+        --s_running;
+        setProcessedAmount(Bytes, 10);
+        setError(m_error);
+        emitResult();
+    });
+}
+
 void CompositeJob::start()
 {
     if (hasSubjobs()) {
@@ -40,6 +63,11 @@ bool CompositeJob::addSubjob(KJob *job)
     return KCompositeJob::addSubjob(job);
 }
 
+bool CompositeJob::removeSubjob(KJob *job)
+{
+    return KCompositeJob::removeSubjob(job);
+}
+
 void CompositeJob::slotResult(KJob *job)
 {
     KCompositeJob::slotResult(job);
@@ -93,6 +121,145 @@ void KCompositeJobTest::testDeletionDuringExecution()
     QCOMPARE(destroyed_spy.size(), 1);
 }
 
+void KCompositeJobTest::testSubjobOrder()
+{
+    CompositeJob compositeJob;
+    QList<KJob *> jobs;
+    for (int i = 0; i < 10; ++i) {
+        jobs << new TestJob;
+        QVERIFY(compositeJob.addSubjob(jobs.last()));
+    }
+    QVERIFY(!compositeJob.addSubjob(jobs.first()));
+    QCOMPARE(compositeJob.subjobs(), jobs);
+
+    // From the front, the back and the middle
+    for (int i : {0, 9, 4, 5, 2}) {
+        QVERIFY(compositeJob.removeSubjob(jobs.at(i)));
+        QVERIFY(!compositeJob.removeSubjob(jobs.at(i)));
+        QCOMPARE(jobs.at(i)->parent(), nullptr);
+    }
+    QCOMPARE(compositeJob.subjobs(), (QList<KJob *>{jobs.at(1), jobs.at(3), jobs.at(6), jobs.at(7), jobs.at(8)}));
+
+    // Removed jobs can be added again, at the end
+    QVERIFY(compositeJob.addSubjob(jobs.at(4)));
+    QVERIFY(compositeJob.removeSubjob(jobs.at(6)));
+    QCOMPARE(compositeJob.subjobs(), (QList<KJob *>{jobs.at(1), jobs.at(3), jobs.at(7), jobs.at(8), jobs.at(4)}));
+
+    for (KJob *job : {jobs.at(3), jobs.at(1), jobs.at(4), jobs.at(8)}) {
+        QVERIFY(compositeJob.removeSubjob(job));
+    }
+    QVERIFY(compositeJob.hasSubjobs());
+    QCOMPARE(compositeJob.subjobs(), QList<KJob *>{jobs.at(7)});
+    QVERIFY(compositeJob.removeSubjob(jobs.at(7)));
+    QVERIFY(!compositeJob.hasSubjobs());
+    QVERIFY(compositeJob.subjobs().isEmpty());
+
+    qDeleteAll(jobs);
+}
+
+void KCompositeJobTest::testJobScheduler()
+{
+    QuickJob::s_started.clear();
+    QuickJob::s_maximumRunning = 0;
+
+    KJobScheduler *scheduler = new KJobScheduler;
+    scheduler->setMaximumConcurrentJobs(2);
+    QCOMPARE(scheduler->maximumConcurrentJobs(), 2);
+
+    KJob *a = new QuickJob;
+    KJob *b = new QuickJob;
+    KJob *c = new QuickJob;
+    KJob *d = new QuickJob;
+    KJob *e = new QuickJob;
+    QVERIFY(scheduler->addJob(a));
+    QVERIFY(scheduler->addJob(b));
+    QVERIFY(scheduler->addJob(c, {a}));
+    QVERIFY(scheduler->addJob(d, {a, b}));
+    QVERIFY(scheduler->addJob(e));
+    // Dependencies have to be added before
+    QVERIFY(!scheduler->addJob(new QuickJob(KJob::NoError, scheduler), {new QuickJob(KJob::NoError, scheduler)}));
+
+    QSignalSpy result_spy(scheduler, &KJob::result);
+    scheduler->start();
+    QVERIFY(result_spy.wait());
+    QCOMPARE(scheduler->error(), int(KJob::NoError));
+    QCOMPARE(QuickJob::s_started.size(), 5);
+    QCOMPARE(QuickJob::s_maximumRunning, 2);
+    QVERIFY(QuickJob::s_started.indexOf(c) > QuickJob::s_started.indexOf(a));
+    QVERIFY(QuickJob::s_started.indexOf(d) > QuickJob::s_started.indexOf(a));
+    QVERIFY(QuickJob::s_started.indexOf(d) > QuickJob::s_started.indexOf(b));
+    QCOMPARE(scheduler->totalAmount(KJob::Bytes), qulonglong(50));
+    QCOMPARE(scheduler->processedAmount(KJob::Bytes), qulonglong(50));
+    QCOMPARE(scheduler->percent(), 100ul);
+}
+
+void KCompositeJobTest::testJobSchedulerError()
+{
+    QuickJob::s_started.clear();
+
+    KJobScheduler *scheduler = new KJobScheduler;
+    scheduler->setMaximumConcurrentJobs(1);
+    KJob *failing = new QuickJob(KJob::UserDefinedError);
+    KJob *dependent = new QuickJob;
+    QVERIFY(scheduler->addJob(failing));
+    QVERIFY(scheduler->addJob(dependent, {failing}));
+
+    QSignalSpy result_spy(scheduler, &KJob::result);
+    scheduler->start();
+    QVERIFY(result_spy.wait());
+    QCOMPARE(scheduler->error(), int(KJob::UserDefinedError));
+    // Jobs depending on a failed job are not started
+    QCOMPARE(QuickJob::s_started, QList<KJob *>{failing});
+}
+
+void KCompositeJobTest::testJobSchedulerPriority()
+{
+    QuickJob::s_started.clear();
+
+    KJobScheduler *scheduler = new KJobScheduler;
+    scheduler->setMaximumConcurrentJobs(1);
+    KJob *low = new QuickJob;
+    KJob *normal = new QuickJob;
+    KJob *high = new QuickJob;
+    KJob *alsoHigh = new QuickJob;
+    low->setPriority(-1);
+    high->setPriority(1);
+    alsoHigh->setPriority(1);
+    QVERIFY(scheduler->addJob(low));
+    QVERIFY(scheduler->addJob(normal));
+    QVERIFY(scheduler->addJob(high));
+    QVERIFY(scheduler->addJob(alsoHigh));
+
+    QSignalSpy result_spy(scheduler, &KJob::result);
+    scheduler->start();
+    QVERIFY(result_spy.wait());
+    QCOMPARE(QuickJob::s_started, (QList<KJob *>{high, alsoHigh, normal, low}));
+}
+
+void KCompositeJobTest::testJobSchedulerCancellation()
+{
+    QuickJob::s_started.clear();
+
+    KJobScheduler *scheduler = new KJobScheduler;
+    scheduler->setMaximumConcurrentJobs(1);
+    KCancellationToken prefetching;
+    KJob *needed = new QuickJob;
+    KJob *prefetch = new QuickJob;
+    prefetch->setCancellationToken(prefetching);
+    KJob *dependent = new QuickJob;
+    QVERIFY(scheduler->addJob(needed));
+    QVERIFY(scheduler->addJob(prefetch));
+    QVERIFY(scheduler->addJob(dependent, {prefetch}));
+
+    QSignalSpy result_spy(scheduler, &KJob::result);
+    scheduler->start();
+    prefetching.cancel();
+    QVERIFY(result_spy.wait());
+    // Canceling is no error, the canceled job and the ones depending on it are not started
+    QCOMPARE(scheduler->error(), int(KJob::NoError));
+    QCOMPARE(QuickJob::s_started, QList<KJob *>{needed});
+}
+
 QTEST_GUILESS_MAIN(KCompositeJobTest)
 
 #include "moc_kcompositejobtest.cpp"
@@ -12,6 +12,7 @@
 #include <QObject>
 
 #include "kcompositejob.h"
+#include "kjobscheduler.h"
 
 class TestJob : public KJob
 {
@@ -39,11 +40,33 @@ public:
 
     void start() override;
     bool addSubjob(KJob *job) override;
+    bool removeSubjob(KJob *job) override;
+
+    using KCompositeJob::hasSubjobs;
+    using KCompositeJob::subjobs;
 
 protected Q_SLOTS:
     void slotResult(KJob *job) override;
 };
 
+/// Finishes in the next event loop iteration, after processing 10 bytes
+class QuickJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    explicit QuickJob(int error = NoError, QObject *parent = nullptr);
+
+    void start() override;
+
+    static int s_running;
+    static int s_maximumRunning;
+    static QList<KJob *> s_started;
+
+private:
+    const int m_error;
+};
+
 class KCompositeJobTest : public QObject
 {
     Q_OBJECT
@@ -53,6 +76,11 @@ public:
 
 private Q_SLOTS:
     void testDeletionDuringExecution();
+    void testSubjobOrder();
+    void testJobScheduler();
+    void testJobSchedulerError();
+    void testJobSchedulerPriority();
+    void testJobSchedulerCancellation();
 
 private:
     QEventLoop loop;
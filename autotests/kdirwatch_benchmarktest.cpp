@@ -10,11 +10,14 @@
 
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QSignalSpy>
 #include <QTemporaryDir>
 #include <QTest>
 #include <QThread>
+#include <ctime>
 #include <sys/stat.h>
 #ifdef Q_OS_UNIX
 #include <unistd.h> // ::link()
@@ -27,6 +30,34 @@
 
 using namespace KDirWatchTestUtils;
 
+// Creates @p count empty directories directly in @p basePath, returning their paths
+static QStringList createDirectories(const QString &basePath, int count)
+{
+    QStringList paths;
+    paths.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const QString path = basePath + QLatin1String("/dir") + QString::number(i);
+        QDir().mkdir(path);
+        paths.append(path);
+    }
+    return paths;
+}
+
+// The resident memory of the process in bytes, or -1 if not known
+static qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
 class KDirWatch_UnitTest : public QObject
 {
     Q_OBJECT
@@ -60,6 +91,13 @@ private Q_SLOTS: // test methods
     void benchCreateTree();
     void benchCreateWatcher();
     void benchNotifyWatcher();
+    void benchAddDirectories_data();
+    void benchAddDirectories();
+    void benchEventStorm_data();
+    void benchEventStorm();
+    void benchMemoryPerEntry();
+    void benchIdleRescan_data();
+    void benchIdleRescan();
 
 private:
     QTemporaryDir m_tempDir;
@@ -116,4 +154,156 @@ void KDirWatch_UnitTest::benchNotifyWatcher()
     }
 }
 
+void KDirWatch_UnitTest::benchAddDirectories_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+}
+
+void KDirWatch_UnitTest::benchAddDirectories()
+{
+#if !ENABLE_BENCHMARKS
+    QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    QFETCH(int, count);
+
+    QTemporaryDir dir;
+    const QStringList paths = createDirectories(dir.path(), count);
+
+    QBENCHMARK_ONCE {
+        KDirWatch watch;
+        for (const QString &path : paths) {
+            watch.addDir(path);
+        }
+    }
+}
+
+void KDirWatch_UnitTest::benchEventStorm_data()
+{
+    QTest::addColumn<int>("filesPerSecond");
+
+    QTest::newRow("100/s") << 100;
+    QTest::newRow("1000/s") << 1000;
+    QTest::newRow("10000/s") << 10000;
+}
+
+// Creates files in a watched directory at a given rate for a second, and
+// reports how many changes per second KDirWatch processed, as well as how long
+// after the end of the storm the last signal was emitted.
+void KDirWatch_UnitTest::benchEventStorm()
+{
+#if !ENABLE_BENCHMARKS
+    QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    QFETCH(int, filesPerSecond);
+
+    QTemporaryDir dir;
+    waitUntilMTimeChange(dir.path());
+
+    KDirWatch watch;
+    watch.addDir(dir.path(), KDirWatch::WatchFiles);
+    QSignalSpy spyDirty(&watch, &KDirWatch::dirty);
+    QSignalSpy spyCreated(&watch, &KDirWatch::created);
+    const KDirWatch::Statistics before = watch.statistics();
+
+    // Create the files in 100 slices of 10 ms
+    const int filesPerSlice = qMax(1, filesPerSecond / 100);
+    QElapsedTimer timer;
+    timer.start();
+    int created = 0;
+    for (int slice = 0; slice < 100; ++slice) {
+        for (int i = 0; i < filesPerSlice; ++i) {
+            createFile(dir.path() + QLatin1Char('/') + QLatin1String(s_filePrefix) + QString::number(created++));
+        }
+        const qint64 sliceEnd = (slice + 1) * 10;
+        if (timer.elapsed() < sliceEnd) {
+            QTest::qWait(int(sliceEnd - timer.elapsed()));
+        }
+    }
+    const qint64 stormEnd = timer.elapsed();
+
+    // Wait until no signal came for a while
+    qsizetype signalCount = -1;
+    qint64 lastSignal = stormEnd;
+    while (timer.elapsed() - lastSignal < 1000) {
+        QTest::qWait(50);
+        const qsizetype count = spyDirty.count() + spyCreated.count();
+        if (count != signalCount) {
+            signalCount = count;
+            lastSignal = timer.elapsed();
+        }
+    }
+    QVERIFY(signalCount > 0);
+
+    const KDirWatch::Statistics after = watch.statistics();
+    const double eventsPerSecond = double(after.eventsReceived - before.eventsReceived) / (double(lastSignal) / 1000);
+    qInfo("%d files created in %lld ms: %llu changes received, %llu coalesced, %lld signals, last one %lld ms after the end",
+          created,
+          stormEnd,
+          after.eventsReceived - before.eventsReceived,
+          after.eventsCoalesced - before.eventsCoalesced,
+          qint64(signalCount),
+          qMax<qint64>(0, lastSignal - stormEnd - 50));
+    QTest::setBenchmarkResult(eventsPerSecond, QTest::Events);
+}
+
+void KDirWatch_UnitTest::benchMemoryPerEntry()
+{
+#if !ENABLE_BENCHMARKS
+    QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    const int count = 10000;
+    QTemporaryDir dir;
+    const QStringList paths = createDirectories(dir.path(), count);
+
+    const qint64 before = residentMemory();
+    if (before < 0) {
+        QSKIP("The memory usage of the process is not known on this platform");
+    }
+
+    KDirWatch watch;
+    for (const QString &path : paths) {
+        watch.addDir(path);
+    }
+    const qint64 after = residentMemory();
+
+    qInfo("%lld bytes per watched directory", (after - before) / count);
+    QTest::setBenchmarkResult(double(after - before) / count, QTest::BytesAllocated);
+}
+
+void KDirWatch_UnitTest::benchIdleRescan_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1k") << 1000;
+    QTest::newRow("10k") << 10000;
+}
+
+// The CPU time used by watching directories that don't change, which comes
+// down to polling them with Stat
+void KDirWatch_UnitTest::benchIdleRescan()
+{
+#if !ENABLE_BENCHMARKS
+    QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    QFETCH(int, count);
+
+    QTemporaryDir dir;
+    const QStringList paths = createDirectories(dir.path(), count);
+
+    KDirWatch watch;
+    for (const QString &path : paths) {
+        watch.addDir(path);
+    }
+
+    const std::clock_t start = std::clock();
+    QTest::qWait(1000);
+    const std::clock_t ticks = std::clock() - start;
+
+    qInfo("%d idle directories: %.1f ms of CPU time per second", count, double(ticks) * 1000 / CLOCKS_PER_SEC);
+    QTest::setBenchmarkResult(double(ticks), QTest::CPUTicks);
+}
+
 #include "kdirwatch_benchmarktest.moc"
@@ -53,6 +53,12 @@ static const char *methodToString(KDirWatch::Method method)
         return "Stat";
     case KDirWatch::QFSWatch:
         return "QFSWatch";
+    case KDirWatch::FANotify:
+        return "FANotify";
+    case KDirWatch::FSEvents:
+        return "FSEvents";
+    case KDirWatch::ReadDirectoryChanges:
+        return "ReadDirectoryChanges";
     }
     return "ERROR!";
 }
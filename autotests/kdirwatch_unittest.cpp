@@ -64,7 +64,13 @@ private Q_SLOTS: // test methods
     }
     void touchOneFile();
     void touch1000Files();
+    void batchedSignals();
+    void limitedDelivery();
+    void statistics();
+    void watchManyFilesOfOneDir();
+    void addManyPaths();
     void watchAndModifyOneFile();
+    void watchContentChanges();
     void removeAndReAdd();
     void watchNonExistent();
     void watchNonExistentWithSingleton();
@@ -72,6 +78,10 @@ private Q_SLOTS: // test methods
     void testDeleteAndRecreateFile();
     void testDeleteAndRecreateDir();
     void testMoveTo();
+    void watchSubDirsInBackground();
+    void testRenamed();
+    void nameFilter();
+    void saveAndRestoreState();
     void nestedEventLoop();
     void testHardlinkChange();
     void stopAndRestart();
@@ -297,6 +307,201 @@ void KDirWatch_UnitTest::touch1000Files()
     }
 }
 
+void KDirWatch_UnitTest::batchedSignals()
+{
+    KDirWatch watch;
+    watch.addDir(m_path);
+    watch.startScan();
+
+    waitUntilMTimeChange(m_path);
+
+    QSignalSpy spyDirty(&watch, &KDirWatch::dirty);
+    QSignalSpy spyBatches(&watch, &KDirWatch::pathsChanged);
+    const int fileCount = 20;
+    for (int i = 0; i < fileCount; ++i) {
+        createFile(i);
+    }
+
+    waitForDirtySignal(watch, fileCount);
+    QVERIFY(!spyDirty.isEmpty());
+    QVERIFY(!spyBatches.isEmpty());
+
+    // Every batch lists each of its paths once, and every signal is part of one
+    QSet<QString> batchedPaths;
+    for (const QVariantList &batch : std::as_const(spyBatches)) {
+        const QStringList paths = batch.at(0).toStringList();
+        const QSet<QString> uniquePaths(paths.cbegin(), paths.cend());
+        QCOMPARE(uniquePaths.size(), paths.size());
+        batchedPaths.unite(uniquePaths);
+    }
+    for (const QVariantList &dirty : std::as_const(spyDirty)) {
+        QVERIFY(batchedPaths.contains(dirty.at(0).toString()));
+    }
+
+    for (int i = 0; i < fileCount; ++i) {
+        removeFile(i);
+    }
+}
+
+void KDirWatch_UnitTest::limitedDelivery()
+{
+    KDirWatch watch;
+    KDirWatch limitedWatch;
+    QCOMPARE(limitedWatch.deliveryInterval(), std::chrono::milliseconds(0));
+    QCOMPARE(limitedWatch.debounceInterval(), std::chrono::milliseconds(0));
+    limitedWatch.setDeliveryInterval(std::chrono::milliseconds(5000));
+    limitedWatch.setDebounceInterval(std::chrono::milliseconds(1000));
+    QCOMPARE(limitedWatch.deliveryInterval(), std::chrono::milliseconds(5000));
+    QCOMPARE(limitedWatch.debounceInterval(), std::chrono::milliseconds(1000));
+
+    watch.addDir(m_path);
+    limitedWatch.addDir(m_path);
+    waitUntilMTimeChange(m_path);
+
+    QSignalSpy spyDirty(&watch, &KDirWatch::dirty);
+    QSignalSpy spyLimitedDirty(&limitedWatch, &KDirWatch::dirty);
+    QSignalSpy spyLimitedBatches(&limitedWatch, &KDirWatch::pathsChanged);
+    const int fileCount = 5;
+    for (int i = 0; i < fileCount; ++i) {
+        createFile(i);
+    }
+
+    // Both instances are told about the changes at the same time, the
+    // limited one holds them back until they stopped for a second
+    QTRY_VERIFY(!spyDirty.isEmpty());
+    QVERIFY(spyLimitedDirty.isEmpty());
+    QTRY_VERIFY_WITH_TIMEOUT(!spyLimitedDirty.isEmpty(), 5000);
+    QTest::qWait(300);
+    QCOMPARE(spyLimitedBatches.count(), 1);
+
+    // Without limits the events are delivered right away again
+    limitedWatch.setDeliveryInterval(std::chrono::milliseconds(0));
+    limitedWatch.setDebounceInterval(std::chrono::milliseconds(0));
+    QCOMPARE(limitedWatch.debounceInterval(), std::chrono::milliseconds(0));
+
+    for (int i = 0; i < fileCount; ++i) {
+        removeFile(i);
+    }
+}
+
+void KDirWatch_UnitTest::statistics()
+{
+    KDirWatch watch;
+    const QString existingFile = m_path + QLatin1String("ExistingFile");
+    watch.addFile(existingFile);
+    watch.startScan();
+
+    const KDirWatch::Statistics before = watch.statistics();
+    QVERIFY(before.inotifyWatches + before.qfsWatches + before.statWatches + before.fanotifyWatches >= 1);
+
+    if (m_slow) {
+        waitUntilNewSecond();
+    }
+    appendToFile(existingFile);
+    QVERIFY(waitForOneSignal(watch, SIGNAL(dirty(QString)), existingFile));
+
+    const KDirWatch::Statistics after = watch.statistics();
+    QVERIFY(after.eventsReceived > before.eventsReceived);
+    QCOMPARE(after.queueOverflows, before.queueOverflows);
+}
+
+void KDirWatch_UnitTest::watchManyFilesOfOneDir()
+{
+    QTemporaryDir tempDir;
+    QStringList files;
+    for (int i = 0; i < 10; ++i) {
+        files.append(tempDir.path() + QLatin1String("/file") + QString::number(i));
+        createFile(files.last());
+    }
+
+    KDirWatch watch;
+    const int watchesBefore = watch.statistics().inotifyWatches;
+    const KDirWatch::Statistics fanotifyBefore = watch.statistics();
+    for (const QString &file : std::as_const(files)) {
+        watch.addFile(file);
+    }
+    watch.startScan();
+    if (watch.internalMethod() == KDirWatch::FANotify) {
+        // All of them use the mark of the filesystem
+        QCOMPARE(watch.statistics().fanotifyWatches, fanotifyBefore.fanotifyWatches + int(files.size()));
+        QCOMPARE(watch.statistics().fanotifyMarks, std::max(fanotifyBefore.fanotifyMarks, 1));
+    }
+    if (watch.internalMethod() == KDirWatch::FSEvents || watch.internalMethod() == KDirWatch::ReadDirectoryChanges) {
+        // All of them use the tree of the directory
+        QCOMPARE(watch.statistics().treeWatches, fanotifyBefore.treeWatches + int(files.size()));
+        QCOMPARE(watch.statistics().trees, fanotifyBefore.trees + 1);
+    }
+    if (watch.internalMethod() != KDirWatch::INotify) {
+        QSKIP("Only inotify shares the watch of the directory");
+    }
+    // All of them use the watch of the directory
+    QCOMPARE(watch.statistics().inotifyWatches, watchesBefore + 1);
+
+    if (m_slow) {
+        waitUntilNewSecond();
+    }
+    QSignalSpy spyDirty(&watch, &KDirWatch::dirty);
+    appendToFile(files.at(3));
+    QVERIFY(spyDirty.wait());
+    QCOMPARE(spyDirty.count(), 1);
+    QCOMPARE(spyDirty.at(0).at(0).toString(), files.at(3));
+
+    QFile::remove(files.at(5));
+    QVERIFY(waitForOneSignal(watch, SIGNAL(deleted(QString)), files.at(5)));
+    createFile(files.at(5));
+    QVERIFY(waitForOneSignal(watch, SIGNAL(created(QString)), files.at(5)));
+
+    // The watch of the directory goes away with the last file
+    for (const QString &file : std::as_const(files)) {
+        watch.removeFile(file);
+    }
+    QTRY_COMPARE(watch.statistics().inotifyWatches, watchesBefore);
+}
+
+void KDirWatch_UnitTest::addManyPaths()
+{
+    QTemporaryDir tempDir;
+    QStringList dirs;
+    QStringList files;
+    for (int i = 0; i < 200; ++i) {
+        dirs.append(tempDir.path() + QLatin1String("/dir") + QString::number(i));
+        QVERIFY(QDir().mkdir(dirs.last()));
+        files.append(dirs.last() + QLatin1String("/file"));
+        createFile(files.last());
+    }
+
+    KDirWatch watch;
+    // Duplicates and trailing slashes are ignored
+    watch.addDirs(dirs + QStringList{dirs.first(), dirs.last() + QLatin1Char('/')});
+    watch.addFiles(files);
+    watch.startScan();
+    for (int i = 0; i < dirs.size(); ++i) {
+        QVERIFY(watch.contains(dirs.at(i)));
+        QVERIFY(watch.contains(files.at(i)));
+    }
+
+    if (m_slow) {
+        waitUntilNewSecond();
+    }
+    QSignalSpy spyDirty(&watch, &KDirWatch::dirty);
+    appendToFile(files.at(42));
+    const auto dirtyPaths = [&spyDirty]() {
+        QStringList paths;
+        for (const QVariantList &dirty : std::as_const(spyDirty)) {
+            paths.append(dirty.at(0).toString());
+        }
+        return paths;
+    };
+    QTRY_VERIFY(dirtyPaths().contains(files.at(42)));
+
+    // Each path was added once
+    for (const QString &dir : std::as_const(dirs)) {
+        watch.removeDir(dir);
+    }
+    QVERIFY(!watch.contains(dirs.first()));
+    QVERIFY(!watch.contains(dirs.last()));
+}
+
 void KDirWatch_UnitTest::watchAndModifyOneFile() // watch a specific file, and modify it
 {
     KDirWatch watch;
@@ -310,6 +515,27 @@ void KDirWatch_UnitTest::watchAndModifyOneFile() // watch a specific file, and m
     QVERIFY(waitForOneSignal(watch, SIGNAL(dirty(QString)), existingFile));
 }
 
+void KDirWatch_UnitTest::watchContentChanges()
+{
+    KDirWatch watch;
+    const QString existingFile = m_path + QLatin1String("ExistingFile");
+    watch.addFile(existingFile, KDirWatch::WatchContentChanges);
+    watch.startScan();
+    QSignalSpy spyDirty(&watch, &KDirWatch::dirty);
+
+    // Changing the permissions changes the ctime, but not the contents
+    waitUntilMTimeChange(existingFile);
+    const QFile::Permissions permissions = QFile::permissions(existingFile);
+    QVERIFY(QFile::setPermissions(existingFile, permissions | QFile::ExeOwner));
+    QTest::qWait(500);
+    QVERIFY(QFile::setPermissions(existingFile, permissions));
+    QTest::qWait(500);
+    QCOMPARE(spyDirty.count(), 0);
+
+    appendToFile(existingFile);
+    QVERIFY(waitForOneSignal(watch, SIGNAL(dirty(QString)), existingFile));
+}
+
 void KDirWatch_UnitTest::removeAndReAdd()
 {
     KDirWatch watch;
@@ -507,6 +733,168 @@ void KDirWatch_UnitTest::testDeleteAndRecreateDir()
     delete tempDir2;
 }
 
+void KDirWatch_UnitTest::testRenamed()
+{
+    QTemporaryDir tempDir;
+    const QString file = tempDir.path() + QLatin1String("/file");
+    const QString subdir = tempDir.path() + QLatin1String("/a");
+    const QString nestedDir = subdir + QLatin1String("/b");
+    QVERIFY(QDir().mkpath(nestedDir));
+    createFile(file);
+
+    KDirWatch watch;
+    watch.addDir(tempDir.path(), KDirWatch::WatchFiles | KDirWatch::WatchSubDirs);
+    watch.startScan();
+    if (watch.internalMethod() != KDirWatch::INotify) {
+        QSKIP("Renames are only reported by inotify");
+    }
+    QVERIFY(watch.contains(nestedDir));
+
+    QSignalSpy spyRenamed(&watch, &KDirWatch::renamed);
+    QSignalSpy spyCreated(&watch, &KDirWatch::created);
+    QSignalSpy spyDeleted(&watch, &KDirWatch::deleted);
+    const QString renamedFile = tempDir.path() + QLatin1String("/renamed");
+    QVERIFY(QFile::rename(file, renamedFile));
+    QVERIFY(spyRenamed.wait());
+    QCOMPARE(spyRenamed.at(0).at(0).toString(), file);
+    QCOMPARE(spyRenamed.at(0).at(1).toString(), renamedFile);
+
+    // The watches of the subtree move along
+    const QString renamedDir = tempDir.path() + QLatin1String("/c");
+    QVERIFY(QFile::rename(subdir, renamedDir));
+    QVERIFY(spyRenamed.wait());
+    QCOMPARE(spyRenamed.at(1).at(0).toString(), subdir);
+    QCOMPARE(spyRenamed.at(1).at(1).toString(), renamedDir);
+    QVERIFY(!watch.contains(nestedDir));
+    QVERIFY(watch.contains(renamedDir + QLatin1String("/b")));
+    QCOMPARE(spyCreated.count(), 0);
+    QCOMPARE(spyDeleted.count(), 0);
+
+    createFile(renamedDir + QLatin1String("/b/file"));
+    QVERIFY(waitForOneSignal(watch, SIGNAL(created(QString)), renamedDir + QLatin1String("/b/file")));
+}
+
+void KDirWatch_UnitTest::nameFilter()
+{
+    QTemporaryDir tempDir;
+    const QString buildDir = tempDir.path() + QLatin1String("/build");
+    const QString srcDir = tempDir.path() + QLatin1String("/src");
+    QVERIFY(QDir().mkpath(buildDir));
+    QVERIFY(QDir().mkpath(srcDir));
+
+    KDirWatch watch;
+    KDirWatch::NameFilter filter;
+    filter.excludePatterns = QStringList{QStringLiteral("*.sw?"), QStringLiteral("build")};
+    watch.addDir(tempDir.path(), KDirWatch::WatchFiles | KDirWatch::WatchSubDirs, filter);
+    watch.startScan();
+
+    // Excluded directories are not watched at all
+    QVERIFY(watch.contains(srcDir));
+    QVERIFY(!watch.contains(buildDir));
+    if (watch.internalMethod() != KDirWatch::INotify) {
+        QSKIP("The files created in a directory are only reported by inotify");
+    }
+
+    QSignalSpy spyCreated(&watch, &KDirWatch::created);
+    createFile(tempDir.path() + QLatin1String("/.file.swp"));
+    createFile(srcDir + QLatin1String("/.file.swx"));
+    createFile(buildDir + QLatin1String("/file.o"));
+    const QString file = srcDir + QLatin1String("/file.cpp");
+    createFile(file);
+    QVERIFY(spyCreated.wait());
+    QCOMPARE(spyCreated.at(0).at(0).toString(), file);
+    QCOMPARE(spyCreated.count(), 1);
+    QVERIFY(watch.statistics().eventsFiltered > 0);
+
+    // Only matching files are reported, subdirectories are watched regardless
+    KDirWatch includingWatch;
+    filter.includePatterns = QStringList{QStringLiteral("*.cpp")};
+    includingWatch.addDir(tempDir.path(), KDirWatch::WatchFiles | KDirWatch::WatchSubDirs, filter);
+    QVERIFY(includingWatch.contains(srcDir));
+    QSignalSpy spyIncludedCreated(&includingWatch, &KDirWatch::created);
+    createFile(srcDir + QLatin1String("/file.h"));
+    const QString otherFile = srcDir + QLatin1String("/other.cpp");
+    createFile(otherFile);
+    QVERIFY(spyIncludedCreated.wait());
+    QCOMPARE(spyIncludedCreated.at(0).at(0).toString(), otherFile);
+    QCOMPARE(spyIncludedCreated.count(), 1);
+}
+
+void KDirWatch_UnitTest::saveAndRestoreState()
+{
+    QTemporaryDir tempDir;
+    const QString changedDir = tempDir.path() + QLatin1String("/a");
+    const QString unchangedDir = tempDir.path() + QLatin1String("/b");
+    QVERIFY(QDir().mkpath(changedDir));
+    QVERIFY(QDir().mkpath(unchangedDir));
+    const QString file = tempDir.path() + QLatin1String("/file");
+    createFile(file);
+    const QString stateFile = tempDir.path() + QLatin1String("/state");
+
+    {
+        KDirWatch watch;
+        watch.addDir(changedDir);
+        watch.addDir(unchangedDir);
+        watch.addFile(file);
+        QVERIFY(watch.saveState(stateFile));
+    }
+
+    // Changes made while nothing is watching
+    if (m_slow) {
+        waitUntilNewSecond();
+    }
+    createFile(changedDir + QLatin1String("/new"));
+    QVERIFY(QFile::remove(file));
+
+    KDirWatch watch;
+    QSignalSpy spyRestored(&watch, &KDirWatch::stateRestored);
+    QVERIFY(watch.restoreState(stateFile));
+    QVERIFY(spyRestored.wait());
+    QStringList changedPaths = spyRestored.at(0).at(0).toStringList();
+    changedPaths.sort();
+    QCOMPARE(changedPaths, (QStringList{changedDir, file}));
+    QVERIFY(watch.contains(changedDir));
+    QVERIFY(watch.contains(unchangedDir));
+    QVERIFY(watch.contains(file));
+
+    // The restored paths are watched as usual
+    createFile(file);
+    QVERIFY(waitForOneSignal(watch, SIGNAL(created(QString)), file));
+
+    QVERIFY(!watch.restoreState(tempDir.path() + QLatin1String("/missing")));
+}
+
+void KDirWatch_UnitTest::watchSubDirsInBackground()
+{
+    QTemporaryDir tempDir;
+    const QString subdir = tempDir.path() + QLatin1String("/a");
+    const QString nestedDir = subdir + QLatin1String("/b/c");
+    QVERIFY(QDir().mkpath(nestedDir));
+
+    KDirWatch watch;
+    watch.addDir(tempDir.path(), KDirWatch::WatchSubDirsInBackground);
+    watch.startScan();
+
+    // Only the top dir is registered right away
+    QVERIFY(watch.contains(tempDir.path()));
+    QVERIFY(!watch.contains(subdir));
+    QTRY_VERIFY(watch.contains(nestedDir));
+    QVERIFY(watch.contains(subdir));
+
+    if (m_slow) {
+        waitUntilNewSecond();
+    }
+    createFile(nestedDir + QLatin1String("/file"));
+    QVERIFY(waitForOneSignal(watch, SIGNAL(dirty(QString)), nestedDir));
+
+    // Removing the dir again stops the registration
+    KDirWatch otherWatch;
+    otherWatch.addDir(tempDir.path(), KDirWatch::WatchSubDirsInBackground);
+    otherWatch.removeDir(tempDir.path());
+    QTest::qWait(50);
+    QVERIFY(!otherWatch.contains(subdir));
+}
+
 void KDirWatch_UnitTest::testMoveTo()
 {
     // This reproduces the famous digikam crash, #222974
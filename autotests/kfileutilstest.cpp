@@ -53,6 +53,53 @@ void KFileUtilsTest::testSuggestName()
         QVERIFY(file.open(QIODevice::WriteOnly));
     }
     QCOMPARE(KFileUtils::suggestName(baseUrl, oldName), expectedOutput);
+    QCOMPARE(KFileUtils::suggestNames(baseUrl, QStringList{oldName}), QStringList{expectedOutput});
+}
+
+void KFileUtilsTest::testSuggestNames()
+{
+    QTemporaryDir dir;
+    const QUrl baseUrl = QUrl::fromLocalFile(dir.path());
+    for (const QString &localFile : {QStringLiteral("foo.txt"), QStringLiteral("foo (1).txt"), QStringLiteral("foo (3).txt"), QStringLiteral("bar")}) {
+        QFile file(dir.path() + QLatin1Char('/') + localFile);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+
+    const QStringList oldNames{
+        QStringLiteral("foo.txt"),
+        QStringLiteral("foo.txt"),
+        QStringLiteral("bar"),
+        QStringLiteral("foo (1).txt"),
+        QStringLiteral("foo.txt"),
+        QStringLiteral("bar (1)"),
+        QStringLiteral("baz"),
+    };
+    const QStringList expected{
+        QStringLiteral("foo (2).txt"),
+        QStringLiteral("foo (4).txt"),
+        QStringLiteral("bar (1)"),
+        QStringLiteral("foo (5).txt"),
+        QStringLiteral("foo (6).txt"),
+        QStringLiteral("bar (2)"),
+        QStringLiteral("baz (1)"),
+    };
+    QCOMPARE(KFileUtils::suggestNames(baseUrl, oldNames), expected);
+
+    // The same as suggesting them one after the other, creating the files
+    QStringList oneByOne;
+    for (const QString &oldName : oldNames) {
+        const QString name = KFileUtils::suggestName(baseUrl, oldName);
+        QFile file(dir.path() + QLatin1Char('/') + name);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        oneByOne << name;
+    }
+    QCOMPARE(oneByOne, expected);
+
+    // Many files of the same name
+    const QStringList names = KFileUtils::suggestNames(baseUrl, QStringList(1000, QStringLiteral("many.txt")));
+    QCOMPARE(names.size(), 1000);
+    QCOMPARE(names.first(), QStringLiteral("many (1).txt"));
+    QCOMPARE(names.last(), QStringLiteral("many (1000).txt"));
 }
 
 #if defined(Q_OS_UNIX) && !defined(Q_OS_MAC) && !defined(Q_OS_ANDROID)
@@ -88,6 +135,20 @@ void KFileUtilsTest::testfindAllUniqueFiles()
 
     const QStringList actual = KFileUtils::findAllUniqueFiles(dirs, QStringList{QStringLiteral("*.test")});
     QCOMPARE(actual, expected);
+
+    QStringList streamed;
+    KFileUtils::findAllUniqueFiles(dirs, QStringList{QStringLiteral("*.test")}, [&streamed](const QString &filePath) {
+        streamed << filePath;
+    });
+    QCOMPARE(streamed, expected);
+
+    // The filters match case-insensitively, like the ones of QDirIterator
+    streamed.clear();
+    KFileUtils::findAllUniqueFiles(dirs, QStringList{QStringLiteral("*.TXT")}, [&streamed](const QString &filePath) {
+        streamed << filePath;
+    });
+    QCOMPARE(streamed, KFileUtils::findAllUniqueFiles(dirs, QStringList{QStringLiteral("*.TXT")}));
+    QCOMPARE(streamed, QStringList{testDataBaseDir.filePath(QStringLiteral("testdir3/testDirName/nomatch.txt"))});
 }
 
 #include "moc_kfileutilstest.cpp"
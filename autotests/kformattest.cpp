@@ -81,6 +81,14 @@ void KFormatTest::formatByteSize()
     QCOMPARE(format.formatByteSize(2.3e22, 2, KFormat::MetricBinaryDialect), QStringLiteral("23.00 ZB"));
     QCOMPARE(format.formatByteSize(1.0e27, 1, KFormat::MetricBinaryDialect), QStringLiteral("1,000.0 YB"));
 
+    // Whole numbers right below and at the unit boundaries
+    QCOMPARE(format.formatByteSize(999999, 1, KFormat::MetricBinaryDialect), QStringLiteral("1,000.0 kB"));
+    QCOMPARE(format.formatByteSize(1000000, 1, KFormat::MetricBinaryDialect), QStringLiteral("1.0 MB"));
+    QCOMPARE(format.formatByteSize(1048575, 1, KFormat::IECBinaryDialect), QStringLiteral("1,024.0 KiB"));
+    QCOMPARE(format.formatByteSize(1048576, 1, KFormat::IECBinaryDialect), QStringLiteral("1.0 MiB"));
+    QCOMPARE(format.formatByteSize(9223372036854775807.0, 1, KFormat::IECBinaryDialect), QStringLiteral("8.0 EiB"));
+    QCOMPARE(format.formatByteSize(1023.5, 1, KFormat::IECBinaryDialect), QStringLiteral("1,024 B"));
+
     // Spattering of specific units
     QCOMPARE(format.formatByteSize(823000, 3, KFormat::IECBinaryDialect, KFormat::UnitMegaByte), QStringLiteral("0.785 MiB"));
     QCOMPARE(format.formatByteSize(1234034.0, 4, KFormat::JEDECBinaryDialect, KFormat::UnitByte), QStringLiteral("1,234,034 B"));
@@ -91,6 +99,33 @@ void KFormatTest::formatByteSize()
     QCOMPARE(format.formatByteSize(1000, 1, KFormat::JEDECBinaryDialect, KFormat::UnitKiloByte), QStringLiteral("1.0 KB"));
 }
 
+void KFormatTest::formatByteSizes()
+{
+    QLocale locale(QLocale::c());
+    locale.setNumberOptions(QLocale::DefaultNumberOptions);
+    KFormat format(locale);
+
+    const QList<qint64> sizes{0, 1023, 5000, 5000000, -1024};
+    const QStringList formatted = format.formatByteSizes(sizes);
+    QCOMPARE(formatted.size(), sizes.size());
+    for (qsizetype i = 0; i < sizes.size(); ++i) {
+        QCOMPARE(formatted.at(i), format.formatByteSize(sizes.at(i)));
+    }
+    QCOMPARE(format.formatByteSizes(sizes, 2, KFormat::MetricBinaryDialect, KFormat::UnitKiloByte).at(2), QStringLiteral("5.00 kB"));
+    QVERIFY(format.formatByteSizes({}).isEmpty());
+
+    // appending reuses the buffer
+    QString buffer = QStringLiteral("size: ");
+    format.appendByteSize(buffer, 5000, 1, KFormat::IECBinaryDialect);
+    QCOMPARE(buffer, QStringLiteral("size: 4.9 KiB"));
+    buffer.resize(0);
+    format.appendByteSize(buffer, 1000, 1, KFormat::JEDECBinaryDialect);
+    QCOMPARE(buffer, QStringLiteral("1,000 B"));
+    buffer.resize(0);
+    format.appendByteSize(buffer, 1000, 1, KFormat::MetricBinaryDialect);
+    QCOMPARE(buffer, QStringLiteral("1.0 kB"));
+}
+
 void KFormatTest::formatValue()
 {
     QLocale locale(QLocale::c());
@@ -111,6 +146,10 @@ void KFormatTest::formatValue()
     QCOMPARE(format.formatValue(1000, QStringLiteral("bit/s")), QStringLiteral("1.0 kbit/s"));
     QCOMPARE(format.formatValue(10e3, QStringLiteral("bit/s")), QStringLiteral("10.0 kbit/s"));
     QCOMPARE(format.formatValue(10e6, QStringLiteral("bit/s")), QStringLiteral("10.0 Mbit/s"));
+    QCOMPARE(format.formatValue(999999, QStringLiteral("bit/s")), QStringLiteral("1,000.0 kbit/s"));
+    QCOMPARE(format.formatValue(1024, KFormat::Unit::Byte, 1, KFormat::UnitPrefix::AutoAdjust, KFormat::IECBinaryDialect), QStringLiteral("1.0 KiB"));
+    QCOMPARE(format.formatValue(1023, KFormat::Unit::Byte, 1, KFormat::UnitPrefix::AutoAdjust, KFormat::IECBinaryDialect), QStringLiteral("1,023 B"));
+    QCOMPARE(format.formatValue(-5e6, KFormat::Unit::Byte, 1, KFormat::UnitPrefix::AutoAdjust, KFormat::MetricBinaryDialect), QStringLiteral("-5.0 MB"));
 
     QCOMPARE(format.formatValue(0.010, KFormat::Unit::Meter, 1, KFormat::UnitPrefix::Milli, KFormat::MetricBinaryDialect), QStringLiteral("10.0 mm"));
     QCOMPARE(format.formatValue(10.12e-6, KFormat::Unit::Meter, 2, KFormat::UnitPrefix::Micro, KFormat::MetricBinaryDialect), QString::fromUtf8("10.12 µm"));
@@ -397,6 +436,40 @@ void KFormatTest::formatRelativeDate()
     QCOMPARE(formatFrench.formatRelativeDateTime(testDateTime, QLocale::LongFormat), QStringLiteral("Dimanche 3 octobre 2021 at 05:33"));
 }
 
+void KFormatTest::relativeDateFormatter()
+{
+    KFormat format(QLocale::c());
+    KFormat::RelativeDateFormatter formatter(format, QLocale::LongFormat);
+
+    const QDateTime now = formatter.referenceDateTime();
+    QVERIFY(now.isValid());
+    QVERIFY(now.secsTo(QDateTime::currentDateTime()) < 60);
+
+    // Twice each, the second time from the cache
+    for (int i = 0; i < 2; ++i) {
+        for (int days = -10; days <= 10; ++days) {
+            const QDate date = now.date().addDays(days);
+            QCOMPARE(formatter.formatRelativeDate(date), format.formatRelativeDate(date, QLocale::LongFormat));
+        }
+        QCOMPARE(formatter.formatRelativeDate(QDate()), QStringLiteral("Invalid date"));
+
+        // Exactly 2 days ago is not relative for date times
+        const QDateTime twoDaysAgo = now.addDays(-2);
+        QCOMPARE(formatter.formatRelativeDateTime(twoDaysAgo),
+                 QStringLiteral("%1 at %2")
+                     .arg(QLocale::c().toString(twoDaysAgo.date(), QLocale::LongFormat), QLocale::c().toString(twoDaysAgo.time(), QLocale::ShortFormat)));
+        QCOMPARE(formatter.formatRelativeDateTime(now.addSecs(-1)), QStringLiteral("Just now"));
+        QCOMPARE(formatter.formatRelativeDateTime(now.addSecs(-300)), QStringLiteral("5 minute(s) ago"));
+        const QDateTime yesterday = now.addDays(-1);
+        QCOMPARE(formatter.formatRelativeDateTime(yesterday), QStringLiteral("Yesterday at %1").arg(QLocale::c().toString(yesterday.time(), QLocale::ShortFormat)));
+    }
+
+    formatter.refresh();
+    QVERIFY(formatter.referenceDateTime() >= now);
+    const QDate date = formatter.referenceDateTime().date();
+    QCOMPARE(formatter.formatRelativeDate(date), QStringLiteral("Today"));
+}
+
 QTEST_MAIN(KFormatTest)
 
 #include "moc_kformattest.cpp"
@@ -21,10 +21,12 @@ class KFormatTest : public QObject
 private Q_SLOTS:
 
     void formatByteSize();
+    void formatByteSizes();
     void formatDuration();
     void formatDecimalDuration();
     void formatSpelloutDuration();
     void formatRelativeDate();
+    void relativeDateFormatter();
     void formatValue();
 };
 
@@ -28,6 +28,10 @@ void KFuzzyMatcherTest::testMatchSimple_data()
     QTest::newRow("RTL") << QStringLiteral("ارو") << QStringLiteral("اردو") << true;
     QTest::newRow("WithSep") << QStringLiteral("tf") << QStringLiteral("the_file") << true;
     QTest::newRow("Umlaut") << QStringLiteral("Häu") << QStringLiteral("Häuser") << true;
+    QTest::newRow("Diacritics") << QStringLiteral("cafe") << QStringLiteral("CAFÉ") << true;
+    QTest::newRow("DiacriticsInPattern") << QStringLiteral("Créme") << QStringLiteral("crème") << true;
+    QTest::newRow("CaseFolding") << QStringLiteral("σς") << QStringLiteral("ΣΣ") << true;
+    QTest::newRow("Hangul") << QStringLiteral("가") << QStringLiteral("각") << false;
     QTest::newRow("Unmatched") << QStringLiteral("Name") << QStringLiteral("Nam") << false;
     QTest::newRow("Empty Pattern") << QStringLiteral("") << QStringLiteral("Nam") << true;
 }
@@ -197,6 +201,305 @@ void KFuzzyMatcherTest::testMatch()
     QCOMPARE(actual, expected);
 }
 
+void KFuzzyMatcherTest::testMatchAll_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("copies");
+
+    QTest::newRow("sort") << QStringLiteral("sort") << 1;
+    QTest::newRow("upper case") << QStringLiteral("SoRT") << 1;
+    QTest::newRow("umlaut") << QStringLiteral("Häu") << 1;
+    QTest::newRow("diacritics") << QStringLiteral("hau") << 1;
+    QTest::newRow("empty") << QString() << 1;
+    // Enough candidates to be scored on several threads
+    QTest::newRow("many") << QStringLiteral("sort") << 2000;
+}
+
+void KFuzzyMatcherTest::testMatchAll()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, copies);
+
+    const QStringList input{
+        QStringLiteral("Sort"),
+        QStringLiteral("Some other right test"),
+        QStringLiteral("Soup rate"),
+        QStringLiteral("Someother"),
+        QStringLiteral("irrelevant"),
+        QStringLiteral("Häuser"),
+        QStringLiteral("a long string to get over the length of a vector register, sorted"),
+    };
+    QList<QStringView> strings;
+    for (int i = 0; i < copies; ++i) {
+        for (const QString &str : input) {
+            strings << str;
+        }
+    }
+
+    const QList<KFuzzyMatcher::Result> results = KFuzzyMatcher::matchAll(pattern, strings);
+    QCOMPARE(results.size(), strings.size());
+    for (qsizetype i = 0; i < strings.size(); ++i) {
+        const KFuzzyMatcher::Result expected = KFuzzyMatcher::match(pattern, strings.at(i));
+        QCOMPARE(results.at(i).matched, expected.matched);
+        QCOMPARE(results.at(i).score, expected.score);
+    }
+}
+
+void KFuzzyMatcherTest::testRank_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<int>("copies");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("sort") << QStringLiteral("sort") << 1 << 3;
+    QTest::newRow("all") << QStringLiteral("so") << 1 << 100;
+    QTest::newRow("none") << QStringLiteral("sort") << 1 << 0;
+    QTest::newRow("unmatched") << QStringLiteral("xyz") << 1 << 5;
+    QTest::newRow("empty") << QString() << 1 << 4;
+    // Enough candidates to be ranked on several threads, with many ties
+    QTest::newRow("many") << QStringLiteral("sort") << 2000 << 50;
+}
+
+void KFuzzyMatcherTest::testRank()
+{
+    QFETCH(QString, pattern);
+    QFETCH(int, copies);
+    QFETCH(int, count);
+
+    const QStringList input{
+        QStringLiteral("Sort"),
+        QStringLiteral("Some other right test"),
+        QStringLiteral("Soup rate"),
+        QStringLiteral("Someother"),
+        QStringLiteral("irrelevant"),
+        QStringLiteral("sorted"),
+        QStringLiteral("a long string to get over the length of a vector register, sorted"),
+    };
+    QList<QStringView> strings;
+    for (int i = 0; i < copies; ++i) {
+        for (const QString &str : input) {
+            strings << str;
+        }
+    }
+
+    // Sorting all of the matches gives the same order
+    QList<int> expected;
+    for (int i = 0; i < strings.size(); ++i) {
+        if (KFuzzyMatcher::match(pattern, strings.at(i)).matched) {
+            expected.append(i);
+        }
+    }
+    std::stable_sort(expected.begin(), expected.end(), [&](int a, int b) {
+        return KFuzzyMatcher::match(pattern, strings.at(a)).score > KFuzzyMatcher::match(pattern, strings.at(b)).score;
+    });
+    expected = expected.mid(0, count);
+
+    QCOMPARE(KFuzzyMatcher::rank(pattern, strings, count), expected);
+    QCOMPARE(KFuzzyMatcher::Pattern(pattern).rank(strings, count), expected);
+}
+
+void KFuzzyMatcherTest::testMatchOptimal_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("inputstr");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("sort") << QStringLiteral("sort") << QStringLiteral("Sort") << true;
+    QTest::newRow("WithSep") << QStringLiteral("tf") << QStringLiteral("the_file") << true;
+    QTest::newRow("CamelCase") << QStringLiteral("kaapp") << QStringLiteral("kate_application") << true;
+    QTest::newRow("Umlaut") << QStringLiteral("Häu") << QStringLiteral("HÄUSER") << true;
+    QTest::newRow("Unmatched") << QStringLiteral("Name") << QStringLiteral("Nam") << false;
+    QTest::newRow("Empty Pattern") << QString() << QStringLiteral("Nam") << true;
+    QTest::newRow("path") << QStringLiteral("kfuzzy") << QStringLiteral("src/lib/kfuzzy/tests/kfuzzymatcher.cpp") << true;
+    // Too many matches and too long for match()
+    QTest::newRow("long") << QString(300, QLatin1Char('a')) << QString(300, QLatin1Char('a')) << true;
+    QTest::newRow("long unmatched") << QString(300, QLatin1Char('a')) << QString(299, QLatin1Char('a')) << false;
+}
+
+void KFuzzyMatcherTest::testMatchOptimal()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, inputstr);
+    QFETCH(bool, expected);
+
+    const KFuzzyMatcher::Result result = KFuzzyMatcher::matchOptimal(pattern, inputstr);
+    QCOMPARE(result.matched, expected);
+
+    // Never worse than the recursive scorer using the same rules
+    const KFuzzyMatcher::Result recursive = KFuzzyMatcher::match(pattern, inputstr);
+    if (recursive.matched) {
+        QVERIFY(result.score >= recursive.score);
+    }
+
+    const KFuzzyMatcher::Result compiled = KFuzzyMatcher::Pattern(pattern).matchOptimal(inputstr);
+    QCOMPARE(compiled.matched, result.matched);
+    QCOMPARE(compiled.score, result.score);
+}
+
+void KFuzzyMatcherTest::testMatchOptimalScore()
+{
+    // The same score as match() when it finds the best match itself
+    const auto sort = KFuzzyMatcher::matchOptimal(u"sort", u"Sort");
+    QCOMPARE(sort.score, KFuzzyMatcher::match(u"sort", u"Sort").score);
+
+    // Taking the word start over the first occurrence
+    QVERIFY(KFuzzyMatcher::matchOptimal(u"fm", u"f_fuzzy_matcher").score > KFuzzyMatcher::matchOptimal(u"fm", u"fxmatcher").score);
+}
+
+void KFuzzyMatcherTest::testPattern_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("inputstr");
+
+    QTest::newRow("AbcD") << QStringLiteral("AbcD") << QStringLiteral("AbCdefg");
+    QTest::newRow("WithSep") << QStringLiteral("tf") << QStringLiteral("the_file");
+    QTest::newRow("CamelCase") << QStringLiteral("kaapp") << QStringLiteral("KateApplication");
+    QTest::newRow("Umlaut") << QStringLiteral("Häu") << QStringLiteral("HÄUSER");
+    QTest::newRow("Unmatched") << QStringLiteral("Name") << QStringLiteral("Nam");
+    QTest::newRow("Empty Pattern") << QString() << QStringLiteral("Nam");
+    // Characters outside of ASCII which are lowered to ASCII ones
+    QTest::newRow("Kelvin sign pattern") << QStringLiteral("\u212Aate") << QStringLiteral("Kate");
+    QTest::newRow("Kelvin sign string") << QStringLiteral("kate") << QStringLiteral("\u212Aate");
+}
+
+void KFuzzyMatcherTest::testPattern()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, inputstr);
+
+    const KFuzzyMatcher::Pattern compiled(pattern);
+    QCOMPARE(compiled.pattern(), pattern);
+    QCOMPARE(compiled.isEmpty(), pattern.isEmpty());
+    QCOMPARE(compiled.matchSimple(inputstr), KFuzzyMatcher::matchSimple(pattern, inputstr));
+
+    const KFuzzyMatcher::Result result = compiled.match(inputstr);
+    const KFuzzyMatcher::Result expected = KFuzzyMatcher::match(pattern, inputstr);
+    QCOMPARE(result.matched, expected.matched);
+    QCOMPARE(result.score, expected.score);
+
+    for (const auto type : {KFuzzyMatcher::RangeType::FullyMatched, KFuzzyMatcher::RangeType::All}) {
+        const auto ranges = compiled.matchedRanges(inputstr, type);
+        const auto expectedRanges = KFuzzyMatcher::matchedRanges(pattern, inputstr, type);
+        QCOMPARE(ranges.size(), expectedRanges.size());
+        for (qsizetype i = 0; i < ranges.size(); ++i) {
+            QCOMPARE(ranges.at(i).start, expectedRanges.at(i).start);
+            QCOMPARE(ranges.at(i).length, expectedRanges.at(i).length);
+        }
+    }
+}
+
+void KFuzzyMatcherTest::testFilter()
+{
+    const QStringList candidates{
+        QStringLiteral("kdirwatch"),
+        QStringLiteral("kdirlister"),
+        QStringLiteral("kdir_watcher"),
+        QStringLiteral("kate"),
+        QStringLiteral("KDirWatch"),
+    };
+    KFuzzyMatcher::Filter filter(candidates);
+    QCOMPARE(filter.candidates(), candidates);
+    QCOMPARE(filter.matches(), (QList<int>{0, 1, 2, 3, 4}));
+
+    const auto verifyMatches = [&]() {
+        QList<int> expected;
+        for (int i = 0; i < candidates.size(); ++i) {
+            const KFuzzyMatcher::Result result = KFuzzyMatcher::match(filter.pattern(), candidates.at(i));
+            QCOMPARE(filter.result(i).matched, result.matched);
+            QCOMPARE(filter.result(i).score, result.score);
+            if (result.matched) {
+                expected << i;
+            }
+        }
+        QCOMPARE(filter.matches(), expected);
+    };
+
+    filter.setPattern(u"kdir");
+    verifyMatches();
+    QCOMPARE(filter.matches(), (QList<int>{0, 1, 2, 4}));
+
+    // Extending the pattern
+    filter.setPattern(u"kdirw");
+    verifyMatches();
+    QCOMPARE(filter.matches(), (QList<int>{0, 2, 4}));
+
+    // Not an extension of the previous pattern
+    filter.setPattern(u"kae");
+    verifyMatches();
+    QCOMPARE(filter.matches(), (QList<int>{2, 3}));
+
+    filter.setPattern(u"kdw");
+    verifyMatches();
+    const QList<int> top = filter.topMatches(2);
+    QCOMPARE(top.size(), 2);
+    QList<int> sorted = filter.matches();
+    std::stable_sort(sorted.begin(), sorted.end(), [&](int a, int b) {
+        return filter.result(a).score > filter.result(b).score;
+    });
+    QCOMPARE(top, sorted.mid(0, 2));
+    QCOMPARE(filter.topMatches(10), sorted);
+    QVERIFY(filter.topMatches(0).isEmpty());
+
+    filter.setCandidates({QStringLiteral("kdw")});
+    QCOMPARE(filter.matches(), (QList<int>{0}));
+}
+
+void KFuzzyMatcherTest::testIndex_data()
+{
+    QTest::addColumn<QString>("pattern");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("prefix") << QStringLiteral("kdir");
+    QTest::newRow("gaps") << QStringLiteral("kdw");
+    QTest::newRow("case") << QStringLiteral("KDIRW");
+    QTest::newRow("repeated") << QStringLiteral("tt");
+    QTest::newRow("accents") << QStringLiteral("ee");
+    QTest::newRow("missing character") << QStringLiteral("kdirz");
+    QTest::newRow("unmatched order") << QStringLiteral("wk");
+}
+
+void KFuzzyMatcherTest::testIndex()
+{
+    QFETCH(QString, pattern);
+
+    const QStringList candidates{
+        QStringLiteral("kdirwatch"),
+        QStringLiteral("kdirlister"),
+        QStringLiteral("kdir_watcher"),
+        QStringLiteral("kate"),
+        QStringLiteral("KDirWatch"),
+        QStringLiteral("Élève"),
+        QStringLiteral("settings"),
+        QString(),
+    };
+    const KFuzzyMatcher::Pattern prepared(pattern);
+    QList<int> expected;
+    for (int i = 0; i < candidates.size(); ++i) {
+        if (prepared.match(candidates.at(i)).matched) {
+            expected << i;
+        }
+    }
+    const QList<QStringView> strings(candidates.cbegin(), candidates.cend());
+
+    const KFuzzyMatcher::Index index(candidates);
+    QCOMPARE(index.candidates(), candidates);
+    QCOMPARE(index.matches(prepared), expected);
+    QCOMPARE(index.rank(prepared, 3), prepared.rank(strings, 3));
+    // Preselected are at least the matching candidates
+    const QList<int> preselected = index.preselect(prepared);
+    for (int i : std::as_const(expected)) {
+        QVERIFY(preselected.contains(i));
+    }
+
+    // Stored and loaded again
+    const KFuzzyMatcher::Index loaded = KFuzzyMatcher::Index::fromData(index.toData());
+    QCOMPARE(loaded.candidates(), candidates);
+    QCOMPARE(loaded.matches(prepared), expected);
+    QCOMPARE(loaded.preselect(prepared), preselected);
+
+    QVERIFY(KFuzzyMatcher::Index::fromData(QByteArray("garbage")).candidates().isEmpty());
+}
+
 void KFuzzyMatcherTest::testMatchedRanges_data()
 {
     QTest::addColumn<QString>("pattern");
@@ -211,6 +514,7 @@ void KFuzzyMatcherTest::testMatchedRanges_data()
     QTest::newRow("Hello") << QStringLiteral("Hlo") << QStringLiteral("Hello") << QList<Range>{{0, 1}, {3, 2}} << true;
     QTest::newRow("lll") << QStringLiteral("lll") << QStringLiteral("SVisualLoggerLogsList") << QList<Range>{{7, 1}, {13, 1}, {17, 1}} << true;
     QTest::newRow("Sort") << QStringLiteral("sort") << QStringLiteral("SorT") << QList<Range>{{0, 4}} << true;
+    QTest::newRow("Diacritics") << QStringLiteral("ea") << QStringLiteral("Été à") << QList<Range>{{0, 1}, {4, 1}} << true;
     QTest::newRow("Unmatching") << QStringLiteral("git") << QStringLiteral("gti") << QList<Range>{} << true;
     QTest::newRow("UnmatchingWithAllMatches") << QStringLiteral("git") << QStringLiteral("gti") << QList<Range>{{0, 1}, {2, 1}} << false;
 }
@@ -234,4 +538,52 @@ void KFuzzyMatcherTest::testMatchedRanges()
     QVERIFY(res);
 }
 
+void KFuzzyMatcherTest::testMatchPositions_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("string");
+
+    QTest::newRow("Empty") << QStringLiteral("") << QStringLiteral("hello");
+    QTest::newRow("Hello") << QStringLiteral("Hlo") << QStringLiteral("Hello");
+    QTest::newRow("lll") << QStringLiteral("lll") << QStringLiteral("SVisualLoggerLogsList");
+    QTest::newRow("Sort") << QStringLiteral("sort") << QStringLiteral("SorT");
+    QTest::newRow("Unmatching") << QStringLiteral("git") << QStringLiteral("gti");
+    QTest::newRow("Recursive") << QStringLiteral("kdwa") << QStringLiteral("kdirwatch_unittest_kdw_a");
+}
+
+void KFuzzyMatcherTest::testMatchPositions()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, string);
+
+    const auto expectedResult = KFuzzyMatcher::match(pattern, string);
+    const auto expectedRanges = KFuzzyMatcher::matchedRanges(pattern, string);
+
+    KFuzzyMatcher::MatchPositions positions;
+    positions.count = -1;
+    const auto result = KFuzzyMatcher::match(pattern, string, positions);
+    QCOMPARE(result.matched, expectedResult.matched);
+    QCOMPARE(result.score, expectedResult.score);
+    QCOMPARE(positions.count, expectedResult.matched ? pattern.size() : 0);
+    for (int i = 1; i < positions.count; ++i) {
+        QVERIFY(positions.positions[i - 1] < positions.positions[i]);
+    }
+
+    const auto compareRanges = [&expectedRanges](const QList<KFuzzyMatcher::Range> &ranges) {
+        return std::equal(expectedRanges.begin(), expectedRanges.end(), ranges.begin(), ranges.end(), [](const KFuzzyMatcher::Range &l, const KFuzzyMatcher::Range &r) {
+            return l.start == r.start && l.length == r.length;
+        });
+    };
+    QVERIFY(compareRanges(positions.ranges()));
+
+    // Reused for another string
+    const KFuzzyMatcher::Pattern compiled(pattern);
+    const auto compiledResult = compiled.match(string, positions);
+    QCOMPARE(compiledResult.matched, expectedResult.matched);
+    QCOMPARE(compiledResult.score, expectedResult.score);
+    QVERIFY(compareRanges(positions.ranges()));
+    compiled.match(QStringLiteral("~"), positions);
+    QCOMPARE(positions.count, 0);
+}
+
 #include "moc_kfuzzymatchertest.cpp"
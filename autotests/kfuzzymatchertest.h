@@ -19,8 +19,22 @@ private Q_SLOTS:
     void testMatchSimple();
     void testMatch_data();
     void testMatch();
+    void testMatchAll_data();
+    void testMatchAll();
+    void testRank_data();
+    void testRank();
+    void testMatchOptimal_data();
+    void testMatchOptimal();
+    void testMatchOptimalScore();
+    void testPattern_data();
+    void testPattern();
+    void testFilter();
+    void testIndex_data();
+    void testIndex();
     void testMatchedRanges_data();
     void testMatchedRanges();
+    void testMatchPositions_data();
+    void testMatchPositions();
 };
 
 #endif // KFUZZYMATCHERTEST_H
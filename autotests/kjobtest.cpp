@@ -6,9 +6,17 @@
 */
 
 #include "kjobtest.h"
-
+#include "kjobawaiter.h"
+#include "kjobregistry.h"
+#include "kjobtracingtracker.h"
+#include "kjobtrackerinterface.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QList>
 #include <QMetaEnum>
+#include <QPointer>
 #include <QSignalSpy>
 #include <QTest>
 #include <QTimer>
@@ -184,6 +192,404 @@ void KJobTest::testProgressTracking()
     delete job;
 }
 
+void KJobTest::testProgressEmissionInterval()
+{
+    TestJob *job = new TestJob;
+    QCOMPARE(job->progressEmissionInterval(), 0);
+    job->setProgressEmissionInterval(50);
+    QCOMPARE(job->progressEmissionInterval(), 50);
+
+    QSignalSpy processedChanged_spy(job, &KJob::processedAmountChanged);
+    QSignalSpy percentChanged_spy(job, &KJob::percentChanged);
+    job->setTotalSize(100);
+    QCOMPARE(percentChanged_spy.size(), 0);
+
+    // The first change is emitted at once, later ones once the interval elapsed
+    for (qulonglong size = 1; size <= 10; ++size) {
+        job->setProcessedSize(size);
+    }
+    QCOMPARE(processedChanged_spy.size(), 1);
+    QCOMPARE(percentChanged_spy.size(), 1);
+    QTRY_COMPARE(processedChanged_spy.size(), 2);
+    QCOMPARE(processedChanged_spy.at(1).at(2).value<qulonglong>(), qulonglong(10));
+    QCOMPARE(percentChanged_spy.size(), 2);
+    QCOMPARE(percentChanged_spy.at(1).at(1).value<unsigned long>(), static_cast<unsigned long>(10));
+
+    // The final values come before the result
+    job->setProcessedSize(100);
+    bool finalProgressBeforeResult = false;
+    connect(job, &KJob::result, this, [&]() {
+        finalProgressBeforeResult = processedChanged_spy.constLast().at(2).value<qulonglong>() == 100
+            && percentChanged_spy.constLast().at(1).value<unsigned long>() == 100;
+    });
+    QSignalSpy result_spy(job, &KJob::result);
+    job->start();
+    QVERIFY(result_spy.wait());
+    QVERIFY(finalProgressBeforeResult);
+}
+
+void KJobTest::testSpeed()
+{
+    TestJob *job = new TestJob;
+
+    // Without anyone listening, nothing is set up for the speed
+    job->emitSpeed(100);
+    QVERIFY(job->findChildren<QTimer *>().isEmpty());
+
+    QSignalSpy speed_spy(job, &KJob::speed);
+    job->emitSpeed(200);
+    QCOMPARE(speed_spy.size(), 1);
+    QCOMPARE(speed_spy.at(0).at(1).value<unsigned long>(), 200ul);
+    QCOMPARE(job->findChildren<QTimer *>().size(), 1);
+    delete job;
+}
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+// A coroutine which runs until its first suspension right away, and isn't waited for
+struct FireAndForget {
+    struct promise_type {
+        FireAndForget get_return_object()
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void()
+        {
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+static FireAndForget runJobs(TestJob *first, TestJob *second, QList<int> *errors)
+{
+    *errors << co_await *first;
+    *errors << co_await *second;
+}
+#endif
+
+void KJobTest::testCoAwait()
+{
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+    TestJob *first = new TestJob;
+    TestJob *second = new TestJob;
+    second->setError(KJob::UserDefinedError);
+    QSignalSpy second_spy(second, &KJob::result);
+
+    QList<int> errors;
+    runJobs(first, second, &errors);
+    // Suspended until the first job finished, without blocking
+    QVERIFY(errors.isEmpty());
+    QVERIFY(second_spy.wait());
+    QCOMPARE(errors, (QList<int>{KJob::NoError, KJob::UserDefinedError}));
+#else
+    QSKIP("Coroutines are not supported by this compiler");
+#endif
+}
+
+void KJobTest::testTracingTracker()
+{
+    KJobTracingTracker tracker;
+    TestJob *succeeding = new TestJob;
+    TestJob *failing = new TestJob;
+    failing->setError(KJob::UserDefinedError);
+    tracker.registerJob(succeeding);
+    tracker.registerJob(failing);
+
+    succeeding->setTotalSize(100);
+    succeeding->setProcessedSize(100);
+    QSignalSpy succeeding_spy(succeeding, &KJob::result);
+    QSignalSpy failing_spy(failing, &KJob::result);
+    succeeding->start();
+    failing->start();
+    QVERIFY(succeeding_spy.wait());
+    QTRY_COMPARE(failing_spy.size(), 1);
+
+    const auto statistics = tracker.statistics();
+    QCOMPARE(statistics.size(), 1);
+    const KJobTracingTracker::Statistics testJobStatistics = statistics.value(QStringLiteral("TestJob"));
+    QCOMPARE(testJobStatistics.jobCount, 2);
+    QCOMPARE(testJobStatistics.errorCount, 1);
+    QCOMPARE(testJobStatistics.processedBytes, qulonglong(100));
+    int histogramCount = 0;
+    for (int count : testJobStatistics.runTimeHistogram) {
+        histogramCount += count;
+    }
+    QCOMPARE(histogramCount, 2);
+
+    const QJsonArray events = QJsonDocument::fromJson(tracker.toChromeTrace()).object().value(QLatin1String("traceEvents")).toArray();
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events.at(0).toObject().value(QLatin1String("name")).toString(), QStringLiteral("TestJob"));
+    QCOMPARE(events.at(0).toObject().value(QLatin1String("ph")).toString(), QStringLiteral("X"));
+
+    tracker.clear();
+    QVERIFY(tracker.statistics().isEmpty());
+}
+
+void KJobTest::testJobRegistry()
+{
+    KJobRegistry registry;
+    int created = 0;
+    QPointer<TestJob> shared;
+    const auto factory = [&]() {
+        ++created;
+        shared = new TestJob;
+        return shared.data();
+    };
+
+    // Waiters on the same key share one job, and finish with its error
+    KSharedJob *first = registry.job(QStringLiteral("a"), factory);
+    KSharedJob *second = registry.job(QStringLiteral("a"), factory);
+    QVERIFY(first && second && first != second);
+    first->setAutoDelete(false);
+    second->setAutoDelete(false);
+    QCOMPARE(created, 1);
+    QCOMPARE(registry.waiterCount(QStringLiteral("a")), 2);
+    QCOMPARE(first->sharedJob(), shared.data());
+    QCOMPARE(second->key(), QStringLiteral("a"));
+
+    shared->setError(KJob::UserDefinedError);
+    shared->setTotalSize(10);
+    QCOMPARE(second->totalAmount(KJob::Bytes), qulonglong(10));
+    QSignalSpy first_spy(first, &KJob::result);
+    QSignalSpy second_spy(second, &KJob::result);
+    first->start();
+    second->start();
+    QVERIFY(second_spy.wait());
+    QCOMPARE(first_spy.size(), 1);
+    QCOMPARE(first->error(), int(KJob::UserDefinedError));
+    QCOMPARE(second->error(), int(KJob::UserDefinedError));
+    QVERIFY(!registry.contains(QStringLiteral("a")));
+    delete first;
+    delete second;
+
+    // Once finished, the key starts a new job
+    KSharedJob *third = registry.job(QStringLiteral("a"), factory);
+    QCOMPARE(created, 2);
+    KSharedJob *fourth = registry.job(QStringLiteral("a"), factory);
+    QCOMPARE(created, 2);
+
+    // The shared job is only killed once every waiter went away
+    QVERIFY(third->kill());
+    QVERIFY(shared);
+    QCOMPARE(registry.waiterCount(QStringLiteral("a")), 1);
+    delete fourth;
+    QVERIFY(!registry.contains(QStringLiteral("a")));
+    QTRY_VERIFY(!shared);
+
+    const auto failingFactory = []() -> KJob * {
+        return nullptr;
+    };
+    QVERIFY(!registry.job(QStringLiteral("b"), failingFactory));
+    QVERIFY(!registry.contains(QStringLiteral("b")));
+}
+
+void KJobTest::testCancellationToken()
+{
+    TestJob *job = new TestJob;
+    QCOMPARE(job->priority(), 0);
+    QSignalSpy priority_spy(job, &KJob::priorityChanged);
+    job->setPriority(5);
+    job->setPriority(5);
+    QCOMPARE(job->priority(), 5);
+    QCOMPARE(priority_spy.size(), 1);
+
+    KCancellationToken token;
+    QVERIFY(!job->cancellationToken());
+    job->setCancellationToken(token);
+    QVERIFY(job->cancellationToken() == token);
+    TestJob *other = new TestJob;
+    other->setCancellationToken(KCancellationToken(token));
+    TestJob *unrelated = new TestJob;
+    unrelated->setAutoDelete(false);
+    unrelated->setCancellationToken(KCancellationToken());
+
+    QSignalSpy job_spy(job, &KJob::result);
+    QSignalSpy other_spy(other, &KJob::result);
+    QVERIFY(!token.isCanceled());
+    token.cancel();
+    QVERIFY(token.isCanceled());
+    QCOMPARE(job_spy.size(), 1);
+    QCOMPARE(other_spy.size(), 1);
+    QCOMPARE(job->error(), int(KJob::KilledJobError));
+    QVERIFY(!unrelated->isFinished());
+    token.cancel();
+
+    // A canceled token kills jobs once they get it
+    unrelated->setCancellationToken(token);
+    QVERIFY(!unrelated->isFinished());
+    QTRY_VERIFY(unrelated->isFinished());
+    QCOMPARE(unrelated->error(), int(KJob::KilledJobError));
+    delete unrelated;
+}
+
+class ProgressTracker : public KJobTrackerInterface
+{
+public:
+    QList<qulonglong> processedAmounts;
+    QList<unsigned long> percents;
+    bool finishedSeen = false;
+    bool progressAfterFinished = false;
+
+protected:
+    void processedAmount(KJob *, KJob::Unit, qulonglong amount) override
+    {
+        progressAfterFinished |= finishedSeen;
+        processedAmounts << amount;
+    }
+    void percent(KJob *, unsigned long percent) override
+    {
+        progressAfterFinished |= finishedSeen;
+        percents << percent;
+    }
+    void finished(KJob *) override
+    {
+        finishedSeen = true;
+    }
+};
+
+void KJobTest::testProgressUpdateInterval()
+{
+    ProgressTracker tracker;
+    QCOMPARE(tracker.progressUpdateInterval(), 0);
+    tracker.setProgressUpdateInterval(50);
+    TestJob *job = new TestJob;
+    tracker.registerJob(job);
+
+    // Coalesced to the latest amount and percentage
+    job->setTotalSize(100);
+    for (qulonglong size = 1; size <= 10; ++size) {
+        job->setProcessedSize(size);
+    }
+    QVERIFY(tracker.processedAmounts.isEmpty());
+    QTRY_COMPARE(tracker.processedAmounts, QList<qulonglong>{10});
+    QCOMPARE(tracker.percents, QList<unsigned long>{10});
+
+    // Pending updates are passed on before the job finishes
+    job->setProcessedSize(20);
+    QSignalSpy finishedSpy(job, &KJob::finished);
+    job->start();
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(tracker.processedAmounts, (QList<qulonglong>{10, 20}));
+    QVERIFY(tracker.finishedSeen);
+    QVERIFY(!tracker.progressAfterFinished);
+}
+
+class FamilyTracker : public KJobTrackerInterface
+{
+public:
+    QList<KJob *> reportingJobs;
+    qulonglong totalSize = 0;
+    qulonglong processedSize = 0;
+    unsigned long lastPercent = 0;
+    int finishedChildren = 0;
+    int childCount = 0;
+    int childJobsCalls = 0;
+
+protected:
+    void totalAmount(KJob *job, KJob::Unit unit, qulonglong amount) override
+    {
+        reportingJobs << job;
+        if (unit == KJob::Bytes) {
+            totalSize = amount;
+        }
+    }
+    void processedAmount(KJob *job, KJob::Unit unit, qulonglong amount) override
+    {
+        reportingJobs << job;
+        if (unit == KJob::Bytes) {
+            processedSize = amount;
+        }
+    }
+    void percent(KJob *job, unsigned long percent) override
+    {
+        reportingJobs << job;
+        lastPercent = percent;
+    }
+    void childJobsChanged(KJob *job, int finishedCount, int totalCount) override
+    {
+        reportingJobs << job;
+        finishedChildren = finishedCount;
+        childCount = totalCount;
+        ++childJobsCalls;
+    }
+};
+
+void KJobTest::testChildJobs()
+{
+    FamilyTracker tracker;
+    TestJob *parent = new TestJob;
+    TestJob *first = new TestJob;
+    TestJob *second = new TestJob;
+    first->setTotalSize(100);
+    second->setTotalSize(300);
+    tracker.registerJob(parent);
+
+    // One report for the whole batch, with the summed amounts
+    tracker.registerChildJobs(parent, {first, second, first, parent, nullptr});
+    QCOMPARE(tracker.parentJob(first), parent);
+    QCOMPARE(tracker.parentJob(second), parent);
+    QCOMPARE(tracker.parentJob(parent), nullptr);
+    QCOMPARE(tracker.childJobsCalls, 1);
+    QCOMPARE(tracker.childCount, 2);
+    QCOMPARE(tracker.finishedChildren, 0);
+    QCOMPARE(tracker.totalSize, 400ULL);
+    QCOMPARE(tracker.processedSize, 0ULL);
+
+    first->setProcessedSize(100);
+    second->setProcessedSize(100);
+    QCOMPARE(tracker.processedSize, 200ULL);
+    QCOMPARE(tracker.lastPercent, 50UL);
+
+    // The amounts of a finished child still count
+    QSignalSpy finishedSpy(first, &KJob::finished);
+    first->start();
+    QVERIFY(finishedSpy.wait());
+    QCOMPARE(tracker.finishedChildren, 1);
+    QCOMPARE(tracker.childCount, 2);
+    QCOMPARE(tracker.parentJob(first), nullptr);
+
+    // The ones of an unregistered child don't
+    tracker.unregisterJobs({second});
+    QCOMPARE(tracker.childCount, 1);
+    QCOMPARE(tracker.totalSize, 100ULL);
+    QCOMPARE(tracker.processedSize, 100ULL);
+    QCOMPARE(tracker.lastPercent, 100UL);
+
+    // Only the parent is ever reported
+    QVERIFY(!tracker.reportingJobs.isEmpty());
+    for (KJob *job : std::as_const(tracker.reportingJobs)) {
+        QCOMPARE(job, parent);
+    }
+
+    // A child registered on its own as well keeps being reported after its parent is gone
+    TestJob *third = new TestJob;
+    tracker.registerJob(third);
+    tracker.registerChildJobs(parent, {third});
+    tracker.unregisterJob(parent);
+    tracker.reportingJobs.clear();
+    third->setProcessedSize(10);
+    QVERIFY(!tracker.reportingJobs.isEmpty());
+    for (KJob *job : std::as_const(tracker.reportingJobs)) {
+        QCOMPARE(job, third);
+    }
+    QCOMPARE(tracker.processedSize, 10ULL);
+
+    tracker.unregisterJob(third);
+    delete third;
+    delete second;
+    delete parent;
+}
+
 void KJobTest::testExec_data()
 {
     QTest::addColumn<int>("errorCode");
@@ -22,6 +22,7 @@ public:
     ~TestJob() override;
 
     void start() override;
+    using KJob::emitSpeed;
     using KJob::isFinished;
     using KJob::setProgressUnit;
 
@@ -71,6 +72,14 @@ private Q_SLOTS:
     void testEmitResult_data();
     void testEmitResult();
     void testProgressTracking();
+    void testProgressUpdateInterval();
+    void testProgressEmissionInterval();
+    void testChildJobs();
+    void testSpeed();
+    void testCoAwait();
+    void testTracingTracker();
+    void testJobRegistry();
+    void testCancellationToken();
     void testExec_data();
     void testExec();
     void testKill_data();
@@ -42,6 +42,16 @@ private Q_SLOTS:
         QCOMPARE(KLibexec::path(m_relative), m_fixtureDir);
     }
 
+    void testPathRepeated()
+    {
+        // The second lookups come from the cache, they mustn't mix up the relative paths
+        const QString otherDir = QFileInfo(QCoreApplication::applicationDirPath() + QLatin1String("/other")).absoluteFilePath();
+        for (int i = 0; i < 2; ++i) {
+            QCOMPARE(KLibexec::path(m_relative), m_fixtureDir);
+            QCOMPARE(KLibexec::path(QStringLiteral("other")), otherDir);
+        }
+    }
+
     void testKDEFrameworksPaths()
     {
         auto paths = KLibexec::kdeFrameworksPaths(m_relative);
@@ -11,6 +11,7 @@
 #include <QStandardPaths>
 #include <QStringLiteral>
 #include <QTemporaryDir>
+#include <QSignalSpy>
 #include <QTest>
 #include <algorithm>
 
@@ -88,6 +89,56 @@ void KListOpenFilesJobTest::testOpenFiles()
     QCOMPARE(processInfo.pid(), QCoreApplication::applicationPid());
 }
 
+void KListOpenFilesJobTest::testProcBackend()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("Scanning /proc is only supported on Linux");
+#endif
+    QTemporaryDir tempDir;
+    QFile tempFile(tempDir.path() + QStringLiteral("/file"));
+    QVERIFY(tempFile.open(QIODevice::WriteOnly));
+
+    auto job = new KListOpenFilesJob(tempDir.path());
+    job->setBackend(KListOpenFilesJob::Backend::Proc);
+    QCOMPARE(job->backend(), KListOpenFilesJob::Backend::Proc);
+    KProcessList::KProcessInfoList found;
+    connect(job, &KListOpenFilesJob::processesFound, this, [&found](const KProcessList::KProcessInfoList &processes) {
+        found += processes;
+    });
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    QCOMPARE(job->error(), KJob::NoError);
+
+    const auto processInfoList = job->processInfoList();
+    QCOMPARE(found.size(), processInfoList.size());
+    auto testProcessIterator = std::find_if(processInfoList.begin(), processInfoList.end(), [](const KProcessList::KProcessInfo &info) {
+        return info.pid() == QCoreApplication::applicationPid();
+    });
+    QVERIFY(testProcessIterator != processInfoList.end());
+    QVERIFY(testProcessIterator->isValid());
+
+    // Nothing open any more
+    tempFile.close();
+    job = new KListOpenFilesJob(tempDir.path());
+    job->setBackend(KListOpenFilesJob::Backend::Proc);
+    QVERIFY2(job->exec(), qPrintable(job->errorString()));
+    const auto laterProcessInfoList = job->processInfoList();
+    QVERIFY(std::none_of(laterProcessInfoList.cbegin(), laterProcessInfoList.cend(), [](const KProcessList::KProcessInfo &info) {
+        return info.pid() == QCoreApplication::applicationPid();
+    }));
+}
+
+void KListOpenFilesJobTest::testKill()
+{
+    QTemporaryDir tempDir;
+    auto job = new KListOpenFilesJob(tempDir.path());
+    job->setBackend(KListOpenFilesJob::Backend::Proc);
+    QSignalSpy resultSpy(job, &KJob::result);
+    job->start();
+    QVERIFY(job->kill(KJob::EmitResult));
+    QCOMPARE(resultSpy.size(), 1);
+    QCOMPARE(job->error(), KJob::KilledJobError);
+}
+
 void KListOpenFilesJobTest::testNoOpenFiles()
 {
     if (!hasLsofInstalled()) {
@@ -16,6 +16,8 @@ class KListOpenFilesJobTest : public QObject
 
 private Q_SLOTS:
     void testOpenFiles();
+    void testProcBackend();
+    void testKill();
     void testNoOpenFiles();
     void testNonExistingDir();
     void testLsofNotFound();
@@ -21,6 +21,8 @@ private Q_SLOTS:
     void expandMacrosShellQuote();
     void expandMacrosShellQuoteParens();
     void expandMacrosSubClass();
+    void expandTemplate();
+    void expandMacrosLikeExpander();
 };
 
 class MyCExpander : public KCharMacroExpander
@@ -119,6 +121,53 @@ void KMacroExpanderTest::expandMacros()
     QCOMPARE(KMacroExpander::expandMacros(s, smap), QLatin1String(" * Copyright (C) 2008 %{AUTHOR}"));
 }
 
+// Expands the macros of a map one by one, like expandMacros() used to
+class MapWExpander : public KWordMacroExpander
+{
+    const QHash<QString, QStringList> &map;
+
+public:
+    MapWExpander(const QHash<QString, QStringList> &map, QChar c)
+        : KWordMacroExpander(c)
+        , map(map)
+    {
+    }
+
+protected:
+    bool expandMacro(const QString &str, QStringList &ret) override
+    {
+        const auto it = map.constFind(str);
+        if (it == map.constEnd()) {
+            return false;
+        }
+        ret += *it;
+        return true;
+    }
+};
+
+class MapCExpander : public KCharMacroExpander
+{
+    const QHash<QChar, QStringList> &map;
+
+public:
+    MapCExpander(const QHash<QChar, QStringList> &map, QChar c)
+        : KCharMacroExpander(c)
+        , map(map)
+    {
+    }
+
+protected:
+    bool expandMacro(QChar ch, QStringList &ret) override
+    {
+        const auto it = map.constFind(ch);
+        if (it == map.constEnd()) {
+            return false;
+        }
+        ret += *it;
+        return true;
+    }
+};
+
 void KMacroExpanderTest::expandMacrosShellQuote()
 {
     QHash<QChar, QStringList> map;
@@ -256,6 +305,94 @@ void KMacroExpanderTest::expandMacrosSubClass()
     QCOMPARE(s, QLatin1String("subst expanded but not %not equ %"));
 }
 
+void KMacroExpanderTest::expandTemplate()
+{
+    QHash<QChar, QString> cmap;
+    cmap.insert(QLatin1Char('a'), QStringLiteral("%n"));
+    cmap.insert(QLatin1Char('f'), QStringLiteral("filename.txt"));
+    cmap.insert(QLatin1Char('u'), QStringLiteral("https://www.kde.org/index.html"));
+    QHash<QChar, QStringList> clmap;
+    clmap.insert(QLatin1Char('l'), {QStringLiteral("element1"), QStringLiteral("'element2'")});
+    clmap.insert(QLatin1Char('e'), {});
+
+    const QStringList charTemplates{
+        QStringLiteral("Title: %a - %f - %u - %n - %%"),
+        QStringLiteral("%% text %l text %e%n"),
+        QStringLiteral("%f%f%%%f%"),
+        QStringLiteral("no macros"),
+        QString(),
+    };
+    for (const QString &str : charTemplates) {
+        const KMacroTemplate compiled(str, KMacroTemplate::CharMacros);
+        QCOMPARE(compiled.templateString(), str);
+        QCOMPARE(compiled.expand(cmap), KMacroExpander::expandMacros(str, cmap));
+        QCOMPARE(compiled.expand(clmap), KMacroExpander::expandMacros(str, clmap));
+    }
+
+    QHash<QString, QString> smap;
+    smap.insert(QStringLiteral("foo"), QStringLiteral("%n"));
+    smap.insert(QStringLiteral("file"), QStringLiteral("filename.txt"));
+    smap.insert(QStringLiteral("url"), QStringLiteral("https://www.kde.org/index.html"));
+    QHash<QString, QStringList> slmap;
+    slmap.insert(QStringLiteral("list"), {QStringLiteral("element1"), QStringLiteral("'element2'")});
+
+    const QStringList wordTemplates{
+        QStringLiteral("Title: %foo - %file - %url - %name - %"),
+        QStringLiteral("Title: %{foo} - %{file} - %{url} - %{name} - %"),
+        QStringLiteral("Title: %foo-%file-%url-%name-%%"),
+        QStringLiteral("Title: %{file} %{url"),
+        QStringLiteral("%{} %list %{list}"),
+        // An unknown macro containing other macros
+        QStringLiteral("%{unknown %file %{url}} %{a%%b}"),
+    };
+    for (const QString &str : wordTemplates) {
+        const KMacroTemplate compiled(str, KMacroTemplate::WordMacros);
+        QCOMPARE(compiled.expand(smap), KMacroExpander::expandMacros(str, smap));
+        QCOMPARE(compiled.expand(slmap), KMacroExpander::expandMacros(str, slmap));
+    }
+
+    // Maps of the other kind of macros still give the same result
+    const KMacroTemplate wordTemplate(QStringLiteral("%file %f"), KMacroTemplate::WordMacros);
+    QCOMPARE(wordTemplate.expand(cmap), KMacroExpander::expandMacros(wordTemplate.templateString(), cmap));
+
+    const KMacroTemplate otherEscape(QStringLiteral("#f ## %f"), KMacroTemplate::CharMacros, QLatin1Char('#'));
+    QCOMPARE(otherEscape.expand(cmap), QStringLiteral("filename.txt # %f"));
+}
+
+void KMacroExpanderTest::expandMacrosLikeExpander()
+{
+    QHash<QString, QStringList> smap;
+    smap.insert(QStringLiteral("foo"), {QStringLiteral("%n")});
+    smap.insert(QStringLiteral("file"), {QStringLiteral("filename.txt")});
+    smap.insert(QStringLiteral("list"), {QStringLiteral("element1"), QStringLiteral("'element2'")});
+    smap.insert(QStringLiteral("empty"), {});
+    QHash<QChar, QStringList> cmap;
+    cmap.insert(QLatin1Char('f'), {QStringLiteral("filename.txt")});
+    cmap.insert(QLatin1Char('l'), {QStringLiteral("element1"), QStringLiteral("'element2'")});
+    cmap.insert(QLatin1Char('e'), {});
+
+    const QStringList strings{
+        QStringLiteral("%foo %file %list %empty %unknown %"),
+        QStringLiteral("%{foo}%{file}%{list}%{} %{file"),
+        QStringLiteral("%{unknown %file %{list}} %{a%%b} %%%f%l%"),
+        QStringLiteral("foo file_foo foo1 list,file,foo"),
+        QStringLiteral("f l e x fle"),
+        QStringLiteral("%"),
+        QString(),
+    };
+    for (const QChar escapeChar : {QChar(QLatin1Char('%')), QChar()}) {
+        for (const QString &str : strings) {
+            QString expected = str;
+            MapWExpander(smap, escapeChar).expandMacros(expected);
+            QCOMPARE(KMacroExpander::expandMacros(str, smap, escapeChar), expected);
+
+            expected = str;
+            MapCExpander(cmap, escapeChar).expandMacros(expected);
+            QCOMPARE(KMacroExpander::expandMacros(str, cmap, escapeChar), expected);
+        }
+    }
+}
+
 QTEST_MAIN(KMacroExpanderTest)
 
 #include "kmacroexpandertest.moc"
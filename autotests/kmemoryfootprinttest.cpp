@@ -0,0 +1,88 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KDirWatch>
+#include <KMemoryFootprint>
+#include <KSharedDataCache>
+
+#include <QObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+
+static KMemoryFootprint::Subsystem subsystem(const QString &name)
+{
+    const QList<KMemoryFootprint::Subsystem> subsystems = KMemoryFootprint::subsystems();
+    const auto it = std::find_if(subsystems.cbegin(), subsystems.cend(), [&name](const KMemoryFootprint::Subsystem &subsystem) {
+        return subsystem.name == name;
+    });
+    return it != subsystems.cend() ? *it : KMemoryFootprint::Subsystem();
+}
+
+class KMemoryFootprintTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void testSubsystems()
+    {
+        const QList<KMemoryFootprint::Subsystem> subsystems = KMemoryFootprint::subsystems();
+        QCOMPARE(subsystems.size(), 4);
+        QCOMPARE(subsystem(QStringLiteral("KPluginMetaData")).discardable, true);
+        QCOMPARE(subsystem(QStringLiteral("KNetworkMounts")).discardable, true);
+        QCOMPARE(subsystem(QStringLiteral("KDirWatch")).discardable, false);
+        QCOMPARE(subsystem(QStringLiteral("KSharedDataCache")).discardable, false);
+    }
+
+    void testSharedDataCache()
+    {
+        const KMemoryFootprint::Subsystem before = subsystem(QStringLiteral("KSharedDataCache"));
+        {
+            KSharedDataCache cache(QStringLiteral("kmemoryfootprinttest"), 1024 * 1024);
+            const KMemoryFootprint::Subsystem during = subsystem(QStringLiteral("KSharedDataCache"));
+            QCOMPARE(during.objects, before.objects + 1);
+            QVERIFY(during.bytes >= before.bytes + 1024 * 1024);
+        }
+        const KMemoryFootprint::Subsystem after = subsystem(QStringLiteral("KSharedDataCache"));
+        QCOMPARE(after.objects, before.objects);
+        QCOMPARE(after.bytes, before.bytes);
+        KSharedDataCache::deleteCache(QStringLiteral("kmemoryfootprinttest"));
+    }
+
+    void testDirWatch()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        KDirWatch watch;
+        const KMemoryFootprint::Subsystem before = subsystem(QStringLiteral("KDirWatch"));
+        watch.addDir(dir.path());
+        const KMemoryFootprint::Subsystem after = subsystem(QStringLiteral("KDirWatch"));
+        QVERIFY(after.objects > before.objects);
+        QVERIFY(after.bytes > before.bytes);
+
+        // Not discardable
+        KMemoryFootprint::releaseCaches();
+        QCOMPARE(subsystem(QStringLiteral("KDirWatch")).objects, after.objects);
+    }
+
+    void testReleaseCaches()
+    {
+        KMemoryFootprint::releaseCaches();
+        QCOMPARE(subsystem(QStringLiteral("KPluginMetaData")).objects, 0);
+        QCOMPARE(subsystem(QStringLiteral("KNetworkMounts")).objects, 0);
+    }
+};
+
+QTEST_GUILESS_MAIN(KMemoryFootprintTest)
+
+#include "kmemoryfootprinttest.moc"
@@ -36,4 +36,39 @@ void KMemoryInfoTest::operators()
     QCOMPARE(m.totalPhysical(), m1.totalPhysical());
 }
 
+void KMemoryInfoTest::effectiveValues()
+{
+    KMemoryInfo m;
+    QVERIFY(m.effectiveTotalPhysical() > 0);
+    QVERIFY(m.effectiveTotalPhysical() <= m.totalPhysical());
+    QVERIFY(m.effectiveAvailablePhysical() <= m.availablePhysical());
+    QVERIFY(m.effectiveAvailablePhysical() <= m.effectiveTotalPhysical());
+}
+
+void KMemoryInfoTest::sampler()
+{
+    KMemoryInfoSampler sampler;
+    const KMemoryInfo first = sampler.sample();
+    QVERIFY(!first.isNull());
+    QCOMPARE(first.totalPhysical(), KMemoryInfo().totalPhysical());
+    QVERIFY(first.availablePhysical() <= first.totalPhysical());
+
+    // the same sampler can be used again
+    const KMemoryInfo second = sampler.sample();
+    QVERIFY(!second.isNull());
+    QCOMPARE(second.totalPhysical(), first.totalPhysical());
+}
+
+void KMemoryInfoTest::pressureMonitoring()
+{
+    KMemoryInfoSampler sampler;
+    QVERIFY(!sampler.isMonitoringPressure());
+    // whether it's possible depends on the kernel and the permissions
+    const bool monitoring = sampler.startPressureMonitoring();
+    QCOMPARE(sampler.isMonitoringPressure(), monitoring);
+    QCOMPARE(sampler.startPressureMonitoring(), monitoring);
+    sampler.stopPressureMonitoring();
+    QVERIFY(!sampler.isMonitoringPressure());
+}
+
 #include "moc_kmemoryinfotest.cpp"
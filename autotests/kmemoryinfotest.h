@@ -23,6 +23,12 @@ private Q_SLOTS:
     void isNull();
 
     void operators();
+
+    void effectiveValues();
+
+    void sampler();
+
+    void pressureMonitoring();
 };
 
 #endif // KMEMORYINFOTEST_H
@@ -0,0 +1,98 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "knetworkmountstestadaptive.h"
+
+#include <KNetworkMounts>
+
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTest>
+
+using namespace std::chrono_literals;
+
+QTEST_MAIN(KNetworkMountsTestAdaptive)
+
+void KNetworkMountsTestAdaptive::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    m_configFileName = QStringLiteral("%1/network_mounts").arg(QStandardPaths::writableLocation(QStandardPaths::ConfigLocation));
+
+    QFile::remove(m_configFileName);
+    QVERIFY(!QFile::exists(m_configFileName));
+
+    // Whatever it is mounted on
+    m_path = QDir::tempPath() + QLatin1String("/knetworkmountstestadaptive");
+}
+
+void KNetworkMountsTestAdaptive::cleanupTestCase()
+{
+    KNetworkMounts::self()->sync();
+    QFile::remove(m_configFileName);
+}
+
+void KNetworkMountsTestAdaptive::testDisabled()
+{
+    KNetworkMounts::self()->setEnabled(true);
+    for (int i = 0; i < 10; ++i) {
+        KNetworkMounts::self()->recordLatency(m_path, 1s);
+    }
+    QVERIFY(KNetworkMounts::self()->detectedSlowPaths().isEmpty());
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(m_path));
+}
+
+void KNetworkMountsTestAdaptive::testSlowMount()
+{
+    KNetworkMounts::self()->setOption(KNetworkMounts::AdaptiveSlowPathDetection, true);
+
+    // A single slow operation isn't enough
+    KNetworkMounts::self()->recordLatency(m_path, 1s);
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(m_path));
+
+    for (int i = 0; i < 5; ++i) {
+        KNetworkMounts::self()->recordLatency(m_path, 1s);
+    }
+    const QStringList detected = KNetworkMounts::self()->detectedSlowPaths();
+    QCOMPARE(detected.size(), 1);
+    QVERIFY(detected.first().endsWith(QLatin1Char('/')));
+    QVERIFY(m_path.startsWith(detected.first()));
+
+    QVERIFY(KNetworkMounts::self()->isSlowPath(m_path));
+    QVERIFY(KNetworkMounts::self()->isSlowPath(m_path + QLatin1String("/subdir/file")));
+    QVERIFY(KNetworkMounts::self()->isOptionEnabledForPath(m_path, KNetworkMounts::KDirWatchDontAddWatches));
+    // Not a filesystem type
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(m_path, KNetworkMounts::NfsPaths));
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(m_path, KNetworkMounts::SmbPaths));
+
+    // Not when switched off again
+    KNetworkMounts::self()->setOption(KNetworkMounts::AdaptiveSlowPathDetection, false);
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(m_path));
+    KNetworkMounts::self()->setOption(KNetworkMounts::AdaptiveSlowPathDetection, true);
+    QVERIFY(KNetworkMounts::self()->isSlowPath(m_path));
+}
+
+void KNetworkMountsTestAdaptive::testRecovery()
+{
+    // Just below the threshold isn't fast enough again
+    for (int i = 0; i < 20; ++i) {
+        KNetworkMounts::self()->recordLatency(m_path, 90ms);
+    }
+    QVERIFY(KNetworkMounts::self()->isSlowPath(m_path));
+
+    for (int i = 0; i < 20; ++i) {
+        KNetworkMounts::self()->recordLatency(m_path, 10us);
+    }
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(m_path));
+    QVERIFY(KNetworkMounts::self()->detectedSlowPaths().isEmpty());
+}
+
+void KNetworkMountsTestAdaptive::testProbe()
+{
+    // The temp dir should answer quickly
+    QVERIFY(!KNetworkMounts::self()->probePath(QDir::tempPath()));
+    QVERIFY(!KNetworkMounts::self()->isSlowPath(QDir::tempPath()));
+}
@@ -0,0 +1,29 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KNETWORKMOUNTSTESTADAPTIVE_H
+#define KNETWORKMOUNTSTESTADAPTIVE_H
+
+#include <QObject>
+
+class KNetworkMountsTestAdaptive : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testDisabled();
+    void testSlowMount();
+    void testRecovery();
+    void testProbe();
+
+private:
+    QString m_configFileName;
+    QString m_path;
+};
+
+#endif
@@ -46,6 +46,16 @@ void KNetworkMountsTestStatic::testStaticFunctions_data()
                                 << QStringList{QStringLiteral("/mnt/test1/"), QStringLiteral("/mnt/test2/")} << "/mnt/test2/";
     QTest::newRow("/mnt/test3") << "/mnt/test2/" << (QStringList() << QStringLiteral("/mnt/test1/") << QStringLiteral("/mnt/test2/")) << false << "/mnt/test2/"
                                 << false << QStringList{QStringLiteral("/mnt/test1/"), QStringLiteral("/mnt/test2/")} << "/mnt/test2/";
+
+    // Nested slow paths, the first one in the list wins
+    QTest::newRow("nested1") << "/mnt/test/sub/file" << QStringList{QStringLiteral("/mnt/test/"), QStringLiteral("/mnt/test/sub/")} << true
+                             << "/mnt/test/sub/file/" << false << QStringList{QStringLiteral("/mnt/test/"), QStringLiteral("/mnt/test/sub/")} << "/mnt/test/";
+    QTest::newRow("nested2") << "/mnt/test/sub/file" << QStringList{QStringLiteral("/mnt/test/sub/"), QStringLiteral("/mnt/test/")} << true
+                             << "/mnt/test/sub/file/" << false << QStringList{QStringLiteral("/mnt/test/sub/"), QStringLiteral("/mnt/test/")} << "/mnt/test/sub/";
+    QTest::newRow("nested3") << "/mnt/test/other" << QStringList{QStringLiteral("/mnt/test/sub/"), QStringLiteral("/mnt/test/")} << true
+                             << "/mnt/test/other/" << false << QStringList{QStringLiteral("/mnt/test/sub/"), QStringLiteral("/mnt/test/")} << "/mnt/test/";
+    QTest::newRow("prefix") << "/mnt/testing" << QStringList{QStringLiteral("/mnt/test/")} << true << "/mnt/testing/" << false
+                            << QStringList{QStringLiteral("/mnt/test/")} << "";
 }
 
 void KNetworkMountsTestStatic::testStaticFunctions()
@@ -59,6 +69,7 @@ void KNetworkMountsTestStatic::testStaticFunctions()
     QFETCH(QString, expected_matching);
 
     QCOMPARE(getMatchingPath(path, paths), expected_matching);
+    QCOMPARE(KNetworkMountsPrefixMatcher(paths).match(path), expected_matching);
 
     QCOMPARE(ensureTrailingSlash(&path), expected_is_slash_added_to_path);
     QCOMPARE(path, expected_path_str);
@@ -76,6 +87,7 @@ void KNetworkMountsTestStatic::testStaticKNetworkMountOptionToString_data()
     QTest::newRow("StrongSideEffectsOptimizations") << KNetworkMounts::StrongSideEffectsOptimizations << "StrongSideEffectsOptimizations";
     QTest::newRow("KDirWatchDontAddWatches") << KNetworkMounts::KDirWatchDontAddWatches << "KDirWatchDontAddWatches";
     QTest::newRow("SymlinkPathsUseCache") << KNetworkMounts::SymlinkPathsUseCache << "SymlinkPathsUseCache";
+    QTest::newRow("AdaptiveSlowPathDetection") << KNetworkMounts::AdaptiveSlowPathDetection << "AdaptiveSlowPathDetection";
 }
 void KNetworkMountsTestStatic::testStaticKNetworkMountOptionToString()
 {
@@ -104,4 +116,42 @@ void KNetworkMountsTestStatic::testStaticKNetworkMountsTypeToString()
     QCOMPARE(enumToString(type), string);
 }
 
+void KNetworkMountsTestStatic::testSymlinkCache()
+{
+    KNetworkMountsSymlinkCache cache(4);
+
+    QCOMPARE(cache.value(QStringLiteral("/link")), QString());
+    QCOMPARE(cache.misses(), quint64(1));
+    QCOMPARE(cache.hits(), quint64(0));
+
+    cache.insert(QStringLiteral("/link"), QStringLiteral("/mnt/target"));
+    QCOMPARE(cache.value(QStringLiteral("/link")), QStringLiteral("/mnt/target"));
+    QCOMPARE(cache.hits(), quint64(1));
+
+    // Replacing keeps the size
+    cache.insert(QStringLiteral("/link"), QStringLiteral("/mnt/other"));
+    QCOMPARE(cache.size(), size_t(1));
+    QCOMPARE(cache.value(QStringLiteral("/link")), QStringLiteral("/mnt/other"));
+
+    cache.insert(QStringLiteral("/a"), QStringLiteral("/mnt/a"));
+    cache.insert(QStringLiteral("/b"), QStringLiteral("/mnt/b"));
+    cache.insert(QStringLiteral("/c"), QStringLiteral("/mnt/c"));
+    QCOMPARE(cache.size(), size_t(4));
+
+    // Use /link and /c, so that /a and /b are dropped when the cache is full
+    QCOMPARE(cache.value(QStringLiteral("/link")), QStringLiteral("/mnt/other"));
+    QCOMPARE(cache.value(QStringLiteral("/c")), QStringLiteral("/mnt/c"));
+    cache.insert(QStringLiteral("/d"), QStringLiteral("/mnt/d"));
+    QCOMPARE(cache.size(), size_t(3));
+    QCOMPARE(cache.value(QStringLiteral("/a")), QString());
+    QCOMPARE(cache.value(QStringLiteral("/b")), QString());
+    QCOMPARE(cache.value(QStringLiteral("/link")), QStringLiteral("/mnt/other"));
+    QCOMPARE(cache.value(QStringLiteral("/c")), QStringLiteral("/mnt/c"));
+    QCOMPARE(cache.value(QStringLiteral("/d")), QStringLiteral("/mnt/d"));
+
+    cache.clear();
+    QCOMPARE(cache.size(), size_t(0));
+    QCOMPARE(cache.value(QStringLiteral("/link")), QString());
+}
+
 #include "moc_knetworkmountsteststatic.cpp"
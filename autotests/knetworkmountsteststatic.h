@@ -20,6 +20,7 @@ private Q_SLOTS:
     void testStaticKNetworkMountOptionToString();
     void testStaticKNetworkMountsTypeToString_data();
     void testStaticKNetworkMountsTypeToString();
+    void testSymlinkCache();
 
 private:
     QString m_configFileName;
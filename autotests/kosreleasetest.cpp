@@ -36,6 +36,16 @@ private Q_SLOTS:
         QCOMPARE(r.extraKeys(), QStringList({QStringLiteral("DEBIAN_BTS")}));
         QCOMPARE(r.extraValue(QStringLiteral("DEBIAN_BTS")), QStringLiteral("debbugs://bugs.debian.org/"));
     }
+
+    void testSystem()
+    {
+        const KOSRelease &system = KOSRelease::system();
+        QCOMPARE(&KOSRelease::system(), &system);
+        // Falls back to the defaults on systems without os-release
+        QVERIFY(!system.name().isEmpty());
+        QVERIFY(!system.id().isEmpty());
+        QCOMPARE(system.name(), KOSRelease().name());
+    }
 };
 
 QTEST_MAIN(KOSReleaseTest)
@@ -9,9 +9,15 @@
 #include "kprocesslist.h"
 #include "kuser.h"
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QProcess>
 #include <QTest>
 #include <algorithm>
 
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
 namespace
 {
 QString getTestExeName()
@@ -75,6 +81,157 @@ void KProcessListTest::testProcessInfo()
     QCOMPARE(processInfo.user(), KUser().loginName());
 }
 
+void KProcessListTest::testProcessInfoListMatchesProcessInfo()
+{
+    const qint64 testExePid = QCoreApplication::applicationPid();
+    const KProcessList::KProcessInfoList processInfoList = KProcessList::processInfoList();
+    const auto it = std::find_if(processInfoList.cbegin(), processInfoList.cend(), [testExePid](const KProcessList::KProcessInfo &info) {
+        return info.pid() == testExePid;
+    });
+    QVERIFY(it != processInfoList.cend());
+
+    const KProcessList::KProcessInfo processInfo = KProcessList::processInfo(testExePid);
+    QCOMPARE(it->name(), processInfo.name());
+    QCOMPARE(it->command(), processInfo.command());
+    QCOMPARE(it->user(), processInfo.user());
+}
+
+void KProcessListTest::testProcessInfoFields()
+{
+    const qint64 testExePid = QCoreApplication::applicationPid();
+
+    const KProcessList::KProcessInfo withoutCommand = KProcessList::processInfo(testExePid, KProcessList::UserField);
+    QVERIFY(withoutCommand.isValid());
+    QVERIFY(!withoutCommand.fields().testFlag(KProcessList::CommandField));
+    QCOMPARE(withoutCommand.command(), withoutCommand.name());
+    QCOMPARE(withoutCommand.user(), KUser().loginName());
+
+#ifdef Q_OS_LINUX
+    const KProcessList::KProcessInfo withoutUser = KProcessList::processInfo(testExePid, KProcessList::CommandField);
+    QVERIFY(withoutUser.isValid());
+    QVERIFY(withoutUser.user().isEmpty());
+    QVERIFY(QDir::fromNativeSeparators(withoutUser.command()).endsWith(QLatin1String("/") + getTestExeName()));
+    QCOMPARE(withoutUser.parentPid(), -1);
+    QCOMPARE(withoutUser.state(), KProcessList::KProcessInfo::UnknownState);
+
+    const KProcessList::KProcessInfo all = KProcessList::processInfo(testExePid, KProcessList::AllFields);
+    QCOMPARE(all.fields(), KProcessList::AllFields);
+    QCOMPARE(all.parentPid(), qint64(::getppid()));
+    QCOMPARE(all.state(), KProcessList::KProcessInfo::Running);
+    QVERIFY(all.userTime() >= 0);
+    QVERIFY(all.systemTime() >= 0);
+    QVERIFY(all.residentSetSize() > 0);
+    QVERIFY(all.startTime().isValid());
+    QVERIFY(all.startTime() <= QDateTime::currentDateTime().addSecs(1));
+    QVERIFY(all.startTime() > QDateTime::currentDateTime().addSecs(-3600));
+    QVERIFY(all.cgroup().startsWith(QLatin1Char('/')));
+
+    // the listing has the same information
+    const KProcessList::KProcessInfoList processInfoList = KProcessList::processInfoList(KProcessList::AllFields);
+    const auto it = std::find_if(processInfoList.cbegin(), processInfoList.cend(), [testExePid](const KProcessList::KProcessInfo &info) {
+        return info.pid() == testExePid;
+    });
+    QVERIFY(it != processInfoList.cend());
+    QCOMPARE(it->parentPid(), all.parentPid());
+    QCOMPARE(it->startTime(), all.startTime());
+    QCOMPARE(it->cgroup(), all.cgroup());
+#endif
+}
+
+void KProcessListTest::testParallelProcessInfoList()
+{
+    const qint64 testExePid = QCoreApplication::applicationPid();
+    const KProcessList::KProcessInfoList parallel = KProcessList::processInfoList(KProcessList::DefaultFields, KProcessList::ParallelListing);
+    const auto it = std::find_if(parallel.cbegin(), parallel.cend(), [testExePid](const KProcessList::KProcessInfo &info) {
+        return info.pid() == testExePid;
+    });
+    QVERIFY(it != parallel.cend());
+    QCOMPARE(it->name(), getTestExeName());
+    QCOMPARE(it->user(), KUser().loginName());
+    QVERIFY(std::all_of(parallel.cbegin(), parallel.cend(), [](const KProcessList::KProcessInfo &info) {
+        return info.isValid();
+    }));
+
+    // Processes may come and go in between, but not many
+    const KProcessList::KProcessInfoList serial = KProcessList::processInfoList();
+    QVERIFY(qAbs(parallel.size() - serial.size()) < 50);
+}
+
+void KProcessListTest::testFilteredProcessInfoList()
+{
+    const qint64 testExePid = QCoreApplication::applicationPid();
+    const auto containsTestExe = [testExePid](const KProcessList::KProcessInfoList &list) {
+        return std::any_of(list.cbegin(), list.cend(), [testExePid](const KProcessList::KProcessInfo &info) {
+            return info.pid() == testExePid;
+        });
+    };
+
+    // The name of the test is longer than the one the Linux kernel keeps
+    const KProcessList::KProcessInfoList byName = KProcessList::processInfoList({getTestExeName(), QString()});
+    QVERIFY(containsTestExe(byName));
+    for (const KProcessList::KProcessInfo &info : byName) {
+        QCOMPARE(info.name(), getTestExeName());
+    }
+
+    const KProcessList::KProcessInfoList byUser = KProcessList::processInfoList({QString(), KUser().loginName()}, KProcessList::UserField);
+    QVERIFY(containsTestExe(byUser));
+    for (const KProcessList::KProcessInfo &info : byUser) {
+        QCOMPARE(info.user(), KUser().loginName());
+    }
+
+    const KProcessList::KProcessInfoList both = KProcessList::processInfoList({getTestExeName(), KUser().loginName()});
+    QVERIFY(containsTestExe(both));
+
+    // Only a prefix of the name, or another user
+    QVERIFY(!containsTestExe(KProcessList::processInfoList({getTestExeName().chopped(2), QString()})));
+    QVERIFY(KProcessList::processInfoList({getTestExeName(), QStringLiteral("no-such-user-for-kprocesslisttest")}).isEmpty());
+}
+
+void KProcessListTest::testSnapshot()
+{
+    const qint64 testExePid = QCoreApplication::applicationPid();
+    const auto hasPid = [](const KProcessList::KProcessInfoList &list, qint64 pid) {
+        return std::any_of(list.cbegin(), list.cend(), [pid](const KProcessList::KProcessInfo &info) {
+            return info.pid() == pid;
+        });
+    };
+
+    KProcessList::Snapshot snapshot;
+    QVERIFY(snapshot.processes().isEmpty());
+    const KProcessList::Snapshot::Delta first = snapshot.update();
+    QVERIFY(hasPid(first.added, testExePid));
+    QVERIFY(first.removed.isEmpty());
+    QVERIFY(first.changed.isEmpty());
+    QVERIFY(hasPid(snapshot.processes(), testExePid));
+    const KProcessList::KProcessInfoList processes = snapshot.processes();
+    QVERIFY(std::is_sorted(processes.cbegin(), processes.cend(), [](const KProcessList::KProcessInfo &a, const KProcessList::KProcessInfo &b) {
+        return a.pid() < b.pid();
+    }));
+
+    const KProcessList::Snapshot::Delta second = snapshot.update();
+    QVERIFY(!hasPid(second.added, testExePid));
+    QVERIFY(!hasPid(second.changed, testExePid));
+    QVERIFY(!second.removed.contains(testExePid));
+
+#ifdef Q_OS_UNIX
+    QProcess child;
+    child.start(QStringLiteral("sleep"), {QStringLiteral("30")});
+    QVERIFY(child.waitForStarted());
+
+    const KProcessList::Snapshot::Delta started = snapshot.update();
+    QVERIFY(hasPid(started.added, child.processId()));
+    QVERIFY(hasPid(snapshot.processes(), child.processId()));
+
+    const qint64 childPid = child.processId();
+    child.kill();
+    QVERIFY(child.waitForFinished());
+
+    const KProcessList::Snapshot::Delta exited = snapshot.update();
+    QVERIFY(exited.removed.contains(childPid));
+    QVERIFY(!hasPid(snapshot.processes(), childPid));
+#endif
+}
+
 void KProcessListTest::testProcessInfoNotFound()
 {
     KProcessList::KProcessInfo processInfo = KProcessList::processInfo(-1);
@@ -18,6 +18,11 @@ private Q_SLOTS:
     void testKProcessInfoConstructionAssignment();
     void testProcessInfoList();
     void testProcessInfo();
+    void testProcessInfoListMatchesProcessInfo();
+    void testProcessInfoFields();
+    void testParallelProcessInfoList();
+    void testFilteredProcessInfoList();
+    void testSnapshot();
     void testProcessInfoNotFound();
 };
 
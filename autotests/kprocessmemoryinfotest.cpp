@@ -0,0 +1,70 @@
+/*
+    This file is part of the KDE Frameworks
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QObject>
+#include <QTest>
+
+#include <memory>
+
+#include "kprocessmemoryinfo.h"
+
+class KProcessMemoryInfoTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void isNull()
+    {
+        KProcessMemoryInfo m;
+        QVERIFY(!m.isNull());
+    }
+
+    void operators()
+    {
+        KProcessMemoryInfo m;
+        auto m1 = m;
+        QVERIFY(m == m1);
+        QCOMPARE(m.residentSetSize(), m1.residentSetSize());
+    }
+
+    void consistency()
+    {
+        KProcessMemoryInfo m;
+        QVERIFY(m.residentSetSize() > 0);
+        QVERIFY(m.uniqueSetSize() <= m.residentSetSize());
+        QVERIFY(m.proportionalSetSize() <= m.residentSetSize());
+        QVERIFY(m.shared() <= m.residentSetSize());
+        QVERIFY(m.fileBacked() <= m.residentSetSize());
+#if defined(Q_OS_LINUX)
+        QVERIFY(m.uniqueSetSize() <= m.proportionalSetSize() || m.proportionalSetSize() == 0);
+        QVERIFY(m.anonymous() + m.fileBacked() <= m.residentSetSize());
+#endif
+    }
+
+    void growsWithAllocation()
+    {
+        const KProcessMemoryInfo before;
+
+        // touch every page, so that the memory is actually resident
+        constexpr size_t size = 64 * 1024 * 1024;
+        std::unique_ptr<char[]> memory(new char[size]);
+        for (size_t i = 0; i < size; i += 1024) {
+            memory[i] = char(i);
+        }
+
+        const KProcessMemoryInfo after;
+        QVERIFY(after != before);
+        QVERIFY(after.residentSetSize() >= before.residentSetSize() + size / 2);
+#if defined(Q_OS_LINUX)
+        QVERIFY(after.uniqueSetSize() >= before.uniqueSetSize() + size / 2);
+        QVERIFY(after.anonymous() >= before.anonymous() + size / 2);
+#endif
+        QVERIFY(memory[1024] == char(1024));
+    }
+};
+
+QTEST_GUILESS_MAIN(KProcessMemoryInfoTest)
+
+#include "kprocessmemoryinfotest.moc"
@@ -13,6 +13,9 @@
 #include <QStandardPaths>
 #include <QTest>
 #include <kprocess.h>
+#include <kprocesspool.h>
+
+#include <memory>
 
 #include <signal.h>
 #include <stdio.h>
@@ -26,6 +29,8 @@ private Q_SLOTS:
     void test_channels();
     void test_setShellCommand();
     void test_inheritance();
+    void test_standardOutputSink();
+    void test_pool();
 };
 
 // IOCCC nomination pending
@@ -117,6 +122,71 @@ void KProcessTest::test_inheritance()
 #endif
 }
 
+void KProcessTest::test_standardOutputSink()
+{
+#ifdef Q_OS_UNIX
+    QByteArray expected;
+    for (int i = 1; i <= 100000; ++i) {
+        expected += QByteArray::number(i) + '\n';
+    }
+
+    KProcess p;
+    p.setOutputChannelMode(KProcess::OnlyStdoutChannel);
+    QByteArray output;
+    int chunks = 0;
+    p.setStandardOutputSink([&](const QByteArray &data) {
+        output += data;
+        ++chunks;
+    });
+    p.setShellCommand(QStringLiteral("seq 1 100000"));
+    p.start();
+    QVERIFY(p.waitForFinished());
+
+    QCOMPARE(output, expected);
+    QVERIFY(chunks > 0);
+    QVERIFY(p.readAllStandardOutput().isEmpty());
+#else
+    QSKIP("This test needs a UNIX system");
+#endif
+}
+
+void KProcessTest::test_pool()
+{
+    QString helper = QCoreApplication::applicationDirPath() + QStringLiteral("/kprocesstest_helper");
+#ifdef Q_OS_WIN
+    helper += QStringLiteral(".exe");
+#endif
+    QVERIFY(QFile::exists(helper));
+
+    KProcessPool pool(helper, {QStringLiteral(POOLARG)});
+    pool.setOutputChannelMode(KProcess::OnlyStdoutChannel);
+    pool.setSize(2);
+    QTRY_COMPARE(pool.idleCount(), 2);
+
+    QProcessEnvironment environment;
+    environment.insert(QStringLiteral("KPROCESSTEST_VALUE"), QStringLiteral("baz"));
+    for (int i = 0; i < 3; ++i) {
+        std::unique_ptr<KProcess> process(pool.start({QStringLiteral("foo"), QString::number(i)}, environment));
+        process->write("input\n");
+        QVERIFY(process->waitForFinished());
+        QCOMPARE(process->readAllStandardOutput(), QByteArray("pooled foo " + QByteArray::number(i) + " baz\ninput\n"));
+        // Replaced in the background
+        QTRY_COMPARE(pool.idleCount(), 2);
+    }
+
+    // Started directly, the helper uses its own arguments
+    KProcess direct;
+    direct.setOutputChannelMode(KProcess::OnlyStdoutChannel);
+    direct.setProgram(helper, {QStringLiteral(POOLARG)});
+    direct.start();
+    direct.closeWriteChannel();
+    QVERIFY(direct.waitForFinished());
+    QCOMPARE(direct.readAllStandardOutput(), QByteArray("direct  \n\n"));
+
+    pool.setSize(0);
+    QCOMPARE(pool.idleCount(), 0);
+}
+
 QTEST_MAIN(KProcessTest)
 
 #include "kprocesstest.moc"
@@ -8,6 +8,9 @@
 
 #include "kprocesstest_helper.h"
 #include <kprocess.h>
+#include <kprocesspool.h>
+
+#include <QTextStream>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,6 +21,15 @@ int main(int argc, char **argv)
         printf("Missing parameter");
         return -1;
     }
+    if (qstrcmp(argv[1], POOLARG) == 0) {
+        QStringList arguments;
+        const bool pooled = KProcessPool::receiveTask(&arguments);
+        QTextStream out(stdout);
+        out << (pooled ? "pooled" : "direct") << ' ' << arguments.join(QLatin1Char(' ')) << ' ' << qEnvironmentVariable("KPROCESSTEST_VALUE") << '\n';
+        // Input after the task is left to the helper
+        out << QTextStream(stdin).readLine() << '\n';
+        return 0;
+    }
     KProcess p;
     p.setShellCommand(QString::fromLatin1("echo " EOUT "; echo " EERR " >&2"));
     p.setOutputChannelMode(static_cast<KProcess::OutputChannelMode>(atoi(argv[1])));
@@ -11,3 +11,4 @@
 #define POUT "program output:\n"
 #define ROUT "received stdout:\n"
 #define RERR "received stderr:\n"
+#define POOLARG "pool"
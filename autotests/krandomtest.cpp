@@ -33,6 +33,7 @@ class KRandomTest : public QObject
 private Q_SLOTS:
     void test_randomString();
     void test_randomStringThreaded();
+    void test_randomStringGenerator();
     void test_shuffle();
 };
 
@@ -47,6 +48,34 @@ void KRandomTest::test_randomString()
     QVERIFY(match.hasMatch());
 }
 
+void KRandomTest::test_randomStringGenerator()
+{
+    const QRegularExpression outputFormat(QRegularExpression::anchoredPattern(QStringLiteral("[A-Za-z0-9]*")));
+
+    // The same seed gives the same string
+    QRandomGenerator rg1(1);
+    QRandomGenerator rg2(1);
+    const QString seeded = KRandom::randomString(1000, &rg1);
+    QCOMPARE(seeded.length(), 1000);
+    QVERIFY(outputFormat.match(seeded).hasMatch());
+    QCOMPARE(KRandom::randomString(1000, &rg2), seeded);
+
+    // All characters show up, and none far more often than the others
+    QHash<QChar, int> counts;
+    const QString bulk = KRandom::randomString(62 * 1000, KRandom::threadGenerator());
+    QVERIFY(outputFormat.match(bulk).hasMatch());
+    for (const QChar c : bulk) {
+        ++counts[c];
+    }
+    QCOMPARE(counts.size(), 62);
+    for (const int count : std::as_const(counts)) {
+        QVERIFY2(count > 800 && count < 1200, qPrintable(QString::number(count)));
+    }
+
+    QCOMPARE(KRandom::randomString(0, &rg1), QString());
+    QVERIFY(KRandom::threadGenerator() == KRandom::threadGenerator());
+}
+
 void KRandomTest::test_shuffle()
 {
     {
@@ -13,8 +13,14 @@
 #include <QObject>
 #include <QStandardPaths>
 #include <QString>
+#include <numeric>
 #include <string.h> // strcpy
 
+#ifdef Q_OS_UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 class KSharedDataCacheTest : public QObject
 {
     Q_OBJECT
@@ -22,6 +28,29 @@ class KSharedDataCacheTest : public QObject
 private Q_SLOTS:
     void initTestCase();
     void simpleInsert();
+    void batchInsertFind();
+    void prefetch();
+    void findView();
+    void highIndexLoad();
+    void boundedDefragmentation();
+    void sizeClasses();
+    void eviction_data();
+    void eviction();
+    void admission();
+    void compression();
+    void statistics();
+    void expiry();
+    void hugePages();
+    void releaseFreeMemory();
+    void asyncOpen();
+    void iterateAndImport();
+    void negativeEntries();
+    void invalidation();
+    void resize();
+    void alignedEntries();
+    void writeBehind();
+    void frontCache();
+    void namespaces();
 };
 
 void KSharedDataCacheTest::initTestCase()
@@ -40,9 +69,7 @@ void KSharedDataCacheTest::simpleInsert()
     }
     // insert something into it
     KSharedDataCache cache(cacheName, 5 * 1024 * 1024);
-#ifndef Q_OS_WIN // the windows implementation is currently only memory based and not really shared
     QVERIFY(file.exists()); // make sure we got the cache filename right
-#endif
     QByteArray data;
     data.resize(9228);
     strcpy(data.data(), "Hello world");
@@ -59,6 +86,965 @@ void KSharedDataCacheTest::simpleInsert()
     QCOMPARE(result, data);
 }
 
+void KSharedDataCacheTest::batchInsertFind()
+{
+    const QLatin1String cacheName("myBatchTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    KSharedDataCache cache(cacheName, 5 * 1024 * 1024);
+
+    QList<QPair<QString, QByteArray>> entries;
+    for (int i = 0; i < 50; ++i) {
+        entries.append({QStringLiteral("key%1").arg(i), QByteArray(1000 + i, char('a' + i % 26))});
+    }
+    QCOMPARE(cache.insertMany(entries), 50);
+
+    QStringList keys;
+    for (const auto &entry : std::as_const(entries)) {
+        keys.append(entry.first);
+    }
+    keys.append(QStringLiteral("missing"));
+
+    QHash<QString, QByteArray> results;
+    QCOMPARE(cache.findMany(keys, &results), 50);
+    QCOMPARE(results.size(), 50);
+    for (const auto &entry : std::as_const(entries)) {
+        QCOMPARE(results.value(entry.first), entry.second);
+    }
+    QVERIFY(!results.contains(QStringLiteral("missing")));
+
+    // A null destination only counts
+    QCOMPARE(cache.findMany(keys, nullptr), 50);
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::prefetch()
+{
+    const QLatin1String cacheName("myPrefetchTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        QStringList keys;
+        for (int i = 0; i < 20; ++i) {
+            keys.append(QStringLiteral("entry%1").arg(i));
+            QVERIFY(cache.insert(keys.constLast(), QByteArray(10000, char('a' + i))));
+        }
+        QVERIFY(cache.insertNegative(QStringLiteral("negative")));
+
+        QCOMPARE(cache.prefetch({}), 0);
+        QCOMPARE(cache.prefetch(keys + QStringList{QStringLiteral("missing"), QStringLiteral("negative")}), keys.size());
+
+        // Prefetching is not a lookup
+        const KSharedDataCache::Statistics before = cache.statistics();
+        QCOMPARE(cache.prefetch(keys), keys.size());
+        QCOMPARE(cache.statistics().hits, before.hits);
+        QCOMPARE(cache.statistics().misses, before.misses);
+
+        QByteArray result;
+        for (int i = 0; i < keys.size(); ++i) {
+            QVERIFY(cache.find(keys.at(i), &result));
+            QCOMPARE(result, QByteArray(10000, char('a' + i)));
+        }
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::findView()
+{
+    const QLatin1String cacheName("myViewTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    KSharedDataCache cache(cacheName, 5 * 1024 * 1024);
+    const QByteArray data(100000, 'x');
+    QVERIFY(cache.insert(QStringLiteral("big"), data));
+
+    {
+        KSharedDataCache::EntryView view = cache.findView(QStringLiteral("big"));
+        QVERIFY(view.isValid());
+        QCOMPARE(view.data(), QByteArrayView(data));
+
+        // Moving transfers the pinned entry
+        KSharedDataCache::EntryView moved = std::move(view);
+        QVERIFY(!view.isValid());
+        QVERIFY(moved.isValid());
+        QCOMPARE(moved.data().size(), data.size());
+
+        // Another view of the same entry keeps it pinned when it goes away
+        {
+            const KSharedDataCache::EntryView other = cache.findView(QStringLiteral("big"));
+            QVERIFY(other.isValid());
+        }
+
+        // The cache stays usable, but leaves the pinned entry alone
+        QVERIFY(cache.insert(QStringLiteral("small"), QByteArray("abc")));
+        QVERIFY(!cache.insert(QStringLiteral("big"), QByteArray("replaced")));
+        for (int i = 0; i < 100; ++i) {
+            cache.insert(QStringLiteral("filler%1").arg(i), QByteArray(100000, char('a' + i % 26)));
+        }
+        cache.clear();
+        QVERIFY(!cache.contains(QStringLiteral("small")));
+        QVERIFY(cache.contains(QStringLiteral("big")));
+        QCOMPARE(moved.data(), QByteArrayView(data));
+    }
+
+    QVERIFY(!cache.findView(QStringLiteral("missing")).isValid());
+
+    // Unpinned again
+    QVERIFY(cache.insert(QStringLiteral("big"), QByteArray("replaced")));
+    cache.clear();
+    QVERIFY(!cache.contains(QStringLiteral("big")));
+
+#ifdef Q_OS_UNIX
+    // The pins of a process that died while holding a view are reclaimed
+    // once the cache is opened again
+    QVERIFY(cache.insert(QStringLiteral("big"), data));
+    const pid_t child = fork();
+    if (child == 0) {
+        const KSharedDataCache::EntryView view = cache.findView(QStringLiteral("big"));
+        _exit(view.isValid() ? 0 : 1);
+    }
+    int status = 0;
+    QCOMPARE(waitpid(child, &status, 0), child);
+    QVERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    QVERIFY(!cache.insert(QStringLiteral("big"), QByteArray("replaced")));
+    {
+        KSharedDataCache reopened(cacheName, 5 * 1024 * 1024);
+        QVERIFY(reopened.insert(QStringLiteral("big"), QByteArray("replaced")));
+    }
+#endif
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::highIndexLoad()
+{
+    const QLatin1String cacheName("myIndexLoadTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    // 256 pages of 4 KiB, so 128 index slots
+    KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+
+    // Fill most of the index table with small entries, which all fit in the
+    // cache, so none of them should be lost to index collisions.
+    const int entryCount = 80;
+    for (int i = 0; i < entryCount; ++i) {
+        QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), QByteArray::number(i)));
+    }
+
+    for (int i = 0; i < entryCount; ++i) {
+        QByteArray result;
+        QVERIFY2(cache.find(QStringLiteral("entry%1").arg(i), &result), qPrintable(QString::number(i)));
+        QCOMPARE(result, QByteArray::number(i));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::boundedDefragmentation()
+{
+    const QLatin1String cacheName("myDefragTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+    cache.setDefragmentationBudget(4);
+    QCOMPARE(cache.defragmentationBudget(), 4u);
+
+    // Fragment the cache by overwriting every other entry with a larger one
+    for (int i = 0; i < 60; ++i) {
+        QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), QByteArray(3000, 'a')));
+    }
+    for (int i = 0; i < 60; i += 2) {
+        QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), QByteArray(10000, 'b')));
+    }
+
+    // Needs contiguous room the fragmented cache might not have
+    const QByteArray big(100000, 'c');
+    QVERIFY(cache.insert(QStringLiteral("big"), big));
+    QByteArray result;
+    QVERIFY(cache.find(QStringLiteral("big"), &result));
+    QCOMPARE(result, big);
+
+    // Entries moved around remain intact
+    for (int i = 1; i < 60; i += 2) {
+        if (cache.find(QStringLiteral("entry%1").arg(i), &result)) {
+            QCOMPARE(result, QByteArray(3000, 'a'));
+        }
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::sizeClasses()
+{
+    const QLatin1String cacheName("mySizeClassTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 4 * 1024 * 1024, QList<unsigned>{256, 65536});
+        QVERIFY(cache.totalSize() > 0);
+
+        const QByteArray small(100, 's');
+        const QByteArray large(200000, 'l');
+        QVERIFY(cache.insert(QStringLiteral("small"), small));
+        QVERIFY(cache.insert(QStringLiteral("large"), large));
+
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("small"), &result));
+        QCOMPARE(result, small);
+        QVERIFY(cache.find(QStringLiteral("large"), &result));
+        QCOMPARE(result, large);
+
+        // Changing the size of an entry moves it to another size class
+        QVERIFY(cache.insert(QStringLiteral("small"), large));
+        QVERIFY(cache.find(QStringLiteral("small"), &result));
+        QCOMPARE(result, large);
+        QVERIFY(cache.insert(QStringLiteral("small"), small));
+        QVERIFY(cache.find(QStringLiteral("small"), &result));
+        QCOMPARE(result, small);
+
+        QHash<QString, QByteArray> results;
+        QCOMPARE(cache.findMany({QStringLiteral("small"), QStringLiteral("large"), QStringLiteral("none")}, &results), 2);
+        QCOMPARE(results.value(QStringLiteral("large")), large);
+
+        cache.clear();
+        QVERIFY(!cache.contains(QStringLiteral("small")));
+        QVERIFY(!cache.contains(QStringLiteral("large")));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::eviction_data()
+{
+    QTest::addColumn<KSharedDataCache::EvictionPolicy>("policy");
+
+    QTest::newRow("least often used") << KSharedDataCache::EvictLeastOftenUsed;
+    QTest::newRow("least recently used") << KSharedDataCache::EvictLeastRecentlyUsed;
+    QTest::newRow("oldest") << KSharedDataCache::EvictOldest;
+}
+
+void KSharedDataCacheTest::eviction()
+{
+    QFETCH(KSharedDataCache::EvictionPolicy, policy);
+
+    const QLatin1String cacheName("myEvictionTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        cache.setEvictionPolicy(policy);
+
+        // Insert several times as much as fits
+        QByteArray result;
+        for (int i = 0; i < 1000; ++i) {
+            const QByteArray data(3000 + (i % 7) * 1000, char('a' + i % 26));
+            QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), data));
+            QVERIFY(cache.find(QStringLiteral("entry%1").arg(i), &result));
+            QCOMPARE(result, data);
+        }
+
+        QVERIFY(cache.freeSize() < cache.totalSize());
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::admission()
+{
+    const QLatin1String cacheName("myAdmissionTestCache");
+
+    // Looks up a few entries all the time while scanning many others once,
+    // returns how many of the former survived.
+    auto scan = [cacheName](KSharedDataCache::EvictionPolicy policy, KSharedDataCache::Statistics *statistics) {
+        KSharedDataCache::deleteCache(cacheName);
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        cache.setEvictionPolicy(policy);
+
+        const QByteArray data(10000, 'x');
+        for (int i = 0; i < 20; ++i) {
+            cache.insert(QStringLiteral("hot%1").arg(i), data);
+            for (int j = 0; j < 4; ++j) {
+                cache.contains(QStringLiteral("hot%1").arg(i));
+                cache.find(QStringLiteral("hot%1").arg(i), nullptr);
+            }
+        }
+        for (int i = 0; i < 300; ++i) {
+            cache.insert(QStringLiteral("cold%1").arg(i), data);
+        }
+
+        int survivors = 0;
+        for (int i = 0; i < 20; ++i) {
+            survivors += cache.contains(QStringLiteral("hot%1").arg(i)) ? 1 : 0;
+        }
+        *statistics = cache.statistics();
+        return survivors;
+    };
+
+    KSharedDataCache::Statistics statistics;
+    QCOMPARE(scan(KSharedDataCache::AdmitFrequentlyUsed, &statistics), 20);
+    QVERIFY(statistics.rejections > 0);
+    QVERIFY(statistics.inserts < 320);
+
+    QVERIFY(scan(KSharedDataCache::EvictLeastRecentlyUsed, &statistics) < 20);
+    QCOMPARE(statistics.rejections, quint64(0));
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::compression()
+{
+    const QLatin1String cacheName("myCompressionTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        QCOMPARE(cache.compressionThreshold(), 0u);
+        cache.setCompressionThreshold(1024);
+        QCOMPARE(cache.compressionThreshold(), 1024u);
+
+        const QByteArray compressible = QByteArray("compressible data ").repeated(10000);
+        const unsigned freeBefore = cache.freeSize();
+        QVERIFY(cache.insert(QStringLiteral("compressible"), compressible));
+        QVERIFY(freeBefore - cache.freeSize() < unsigned(compressible.size()) / 2);
+
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("compressible"), &result));
+        QCOMPARE(result, compressible);
+
+        {
+            const KSharedDataCache::EntryView view = cache.findView(QStringLiteral("compressible"));
+            QVERIFY(view.isValid());
+            QCOMPARE(view.data(), QByteArrayView(compressible));
+        }
+
+        // Small entries are stored as is
+        QVERIFY(cache.insert(QStringLiteral("small"), QByteArrayLiteral("small")));
+        QHash<QString, QByteArray> results;
+        QCOMPARE(cache.findMany({QStringLiteral("compressible"), QStringLiteral("small")}, &results), 2);
+        QCOMPARE(results.value(QStringLiteral("compressible")), compressible);
+        QCOMPARE(results.value(QStringLiteral("small")), QByteArrayLiteral("small"));
+
+        // Other users of the cache decompress regardless of their settings
+        KSharedDataCache otherCache(cacheName, 1024 * 1024, 4096);
+        QVERIFY(otherCache.find(QStringLiteral("compressible"), &result));
+        QCOMPARE(result, compressible);
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::statistics()
+{
+    const QLatin1String cacheName("myStatisticsTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        KSharedDataCache::Statistics statistics = cache.statistics();
+        QCOMPARE(statistics.hits, quint64(0));
+        QCOMPARE(statistics.misses, quint64(0));
+        QCOMPARE(statistics.inserts, quint64(0));
+
+        QVERIFY(cache.insert(QStringLiteral("entry"), QByteArrayLiteral("data")));
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("entry"), &result));
+        QVERIFY(!cache.find(QStringLiteral("none"), &result));
+        QCOMPARE(cache.findMany({QStringLiteral("entry"), QStringLiteral("none")}, nullptr), 1);
+
+        statistics = cache.statistics();
+        QCOMPARE(statistics.inserts, quint64(1));
+        QCOMPARE(statistics.hits, quint64(2));
+        QCOMPARE(statistics.misses, quint64(2));
+
+        // Overfill the cache
+        for (int i = 0; i < 500; ++i) {
+            QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), QByteArray(8000, 'x')));
+        }
+
+        statistics = cache.statistics();
+        QCOMPARE(statistics.inserts, quint64(501));
+        QVERIFY(statistics.evictions + statistics.collisionEvictions > 0);
+
+        // Every lock taken is accounted for
+        QVERIFY(!statistics.lockWaitHistogram.isEmpty());
+        const quint64 locksTaken = std::accumulate(statistics.lockWaitHistogram.cbegin(), statistics.lockWaitHistogram.cend(), quint64(0));
+        QVERIFY(locksTaken >= 504);
+
+        // Statistics are shared
+        KSharedDataCache otherCache(cacheName, 1024 * 1024, 4096);
+        QCOMPARE(otherCache.statistics().inserts, quint64(501));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::expiry()
+{
+    const QLatin1String cacheName("myExpiryTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        QVERIFY(cache.insert(QStringLiteral("expiring"), QByteArrayLiteral("soon"), 1));
+        QVERIFY(cache.insert(QStringLiteral("lasting"), QByteArrayLiteral("forever")));
+
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("expiring"), &result));
+        QCOMPARE(result, QByteArrayLiteral("soon"));
+
+        QTest::qSleep(2100);
+
+        QVERIFY(!cache.find(QStringLiteral("expiring"), &result));
+        QVERIFY(!cache.contains(QStringLiteral("expiring")));
+        QVERIFY(!cache.findView(QStringLiteral("expiring")).isValid());
+        QVERIFY(cache.find(QStringLiteral("lasting"), &result));
+        QCOMPARE(result, QByteArrayLiteral("forever"));
+
+        // Inserting again revives the entry
+        QVERIFY(cache.insert(QStringLiteral("expiring"), QByteArrayLiteral("again")));
+        QVERIFY(cache.find(QStringLiteral("expiring"), &result));
+        QCOMPARE(result, QByteArrayLiteral("again"));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::hugePages()
+{
+    const QLatin1String cacheName("myHugePagesTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 4 * 1024 * 1024, 4096);
+        QVERIFY(!cache.hugePagesEnabled());
+
+        // Only a hint, the cache has to work either way
+        const bool enabled = cache.setHugePagesEnabled(true);
+        QCOMPARE(cache.hugePagesEnabled(), enabled);
+
+        const QByteArray data(100000, 'h');
+        QVERIFY(cache.insert(QStringLiteral("entry"), data));
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("entry"), &result));
+        QCOMPARE(result, data);
+
+        cache.setHugePagesEnabled(false);
+        QVERIFY(!cache.hugePagesEnabled());
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::releaseFreeMemory()
+{
+    const QLatin1String cacheName("myReleaseTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 4 * 1024 * 1024, 4096);
+        const QByteArray first(500000, 'a');
+        const QByteArray second(500000, 'b');
+        const QByteArray third(500000, 'c');
+        QVERIFY(cache.insert(QStringLiteral("first"), first));
+        QVERIFY(cache.insert(QStringLiteral("second"), second));
+        QVERIFY(cache.insert(QStringLiteral("third"), third));
+
+        // Frees most of the pages between the other entries
+        QVERIFY(cache.insert(QStringLiteral("second"), QByteArray(10, 'b')));
+
+        // Only supported on some systems, the cache has to work either way
+        const qint64 released = cache.releaseFreeMemory();
+        QVERIFY(released >= 0);
+        QVERIFY(released <= cache.freeSize());
+
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("first"), &result));
+        QCOMPARE(result, first);
+        QVERIFY(cache.find(QStringLiteral("third"), &result));
+        QCOMPARE(result, third);
+
+        // The free space can be used again
+        const QByteArray fourth(400000, 'd');
+        QVERIFY(cache.insert(QStringLiteral("fourth"), fourth));
+        QVERIFY(cache.find(QStringLiteral("fourth"), &result));
+        QCOMPARE(result, fourth);
+
+        cache.clear();
+        QCOMPARE(cache.freeSize(), cache.totalSize());
+        QVERIFY(cache.insert(QStringLiteral("first"), first));
+        QVERIFY(cache.find(QStringLiteral("first"), &result));
+        QCOMPARE(result, first);
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::asyncOpen()
+{
+    const QLatin1String cacheName("myAsyncTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        QFuture<QSharedPointer<KSharedDataCache>> future = KSharedDataCache::open(cacheName, 1024 * 1024, 4096);
+        future.waitForFinished();
+        QCOMPARE(future.resultCount(), 1);
+
+        const QSharedPointer<KSharedDataCache> cache = future.result();
+        QVERIFY(cache);
+        QVERIFY(cache->totalSize() > 0);
+        QVERIFY(cache->insert(QStringLiteral("entry"), QByteArrayLiteral("data")));
+        QByteArray result;
+        QVERIFY(cache->find(QStringLiteral("entry"), &result));
+        QCOMPARE(result, QByteArrayLiteral("data"));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::iterateAndImport()
+{
+    const QLatin1String cacheName("myIterationTestCache");
+    const QLatin1String importCacheName("myImportTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+    KSharedDataCache::deleteCache(importCacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        cache.setCompressionThreshold(1024);
+        QHash<QString, QByteArray> expected;
+        for (int i = 0; i < 20; ++i) {
+            const QByteArray data = QByteArray("data").repeated(i * 100 + 1);
+            expected.insert(QStringLiteral("entry%1").arg(i), data);
+            QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), data));
+        }
+        QVERIFY(cache.insert(QStringLiteral("expiring"), QByteArrayLiteral("data"), 3600));
+
+        QHash<QString, QByteArray> visited;
+        bool sawExpiry = false;
+        QCOMPARE(cache.forEachEntry([&](const KSharedDataCache::EntryInfo &info, QByteArrayView data) {
+            if (info.key == QLatin1String("expiring")) {
+                sawExpiry = info.expiryTime.isValid();
+                return true;
+            }
+            visited.insert(info.key, data.toByteArray());
+            return info.size == unsigned(data.size()) && info.addTime.isValid();
+        }),
+                 21);
+        QVERIFY(sawExpiry);
+        QCOMPARE(visited, expected);
+
+        // Stopping early
+        QCOMPARE(cache.forEachEntry([](const KSharedDataCache::EntryInfo &, QByteArrayView) {
+            return false;
+        }),
+                 1);
+
+        // The cache is not locked during the calls
+        QCOMPARE(cache.forEachEntry([&cache](const KSharedDataCache::EntryInfo &info, QByteArrayView data) {
+            QByteArray found;
+            return cache.find(info.key, &found) && found == data;
+        }),
+                 21);
+
+        KSharedDataCache importedCache(importCacheName, 2 * 1024 * 1024, 4096);
+        QCOMPARE(importedCache.importFrom(cache), 21);
+        QByteArray result;
+        for (auto it = expected.cbegin(); it != expected.cend(); ++it) {
+            QVERIFY(importedCache.find(it.key(), &result));
+            QCOMPARE(result, it.value());
+        }
+        QVERIFY(importedCache.contains(QStringLiteral("expiring")));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+    KSharedDataCache::deleteCache(importCacheName);
+}
+
+void KSharedDataCacheTest::negativeEntries()
+{
+    const QLatin1String cacheName("myNegativeTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        const QString key = QStringLiteral("missing");
+
+        // Keys that were never inserted are ruled out without locking
+        QByteArray result;
+        QVERIFY(!cache.find(QStringLiteral("neverInserted"), &result));
+        QCOMPARE(cache.statistics().filteredMisses, quint64(1));
+
+        QVERIFY(cache.insert(key, QByteArrayLiteral("data")));
+        QVERIFY(cache.insertNegative(key));
+        QVERIFY(!cache.find(key, &result));
+        QVERIFY(!cache.contains(key));
+        QVERIFY(!cache.findView(key).isValid());
+        QVERIFY(cache.containsNegative(key));
+        QVERIFY(cache.statistics().negativeHits >= 1);
+
+        // Not exported either
+        QCOMPARE(cache.forEachEntry([](const KSharedDataCache::EntryInfo &, QByteArrayView) {
+            return true;
+        }),
+                 0);
+
+        // Inserting data replaces the negative entry
+        QVERIFY(cache.insert(key, QByteArrayLiteral("found")));
+        QVERIFY(!cache.containsNegative(key));
+        QVERIFY(cache.find(key, &result));
+        QCOMPARE(result, QByteArrayLiteral("found"));
+
+        // Removed entries are not found even after the key filter is rebuilt
+        for (int i = 0; i < 5000; ++i) {
+            QVERIFY(cache.insertNegative(QStringLiteral("entry%1").arg(i)));
+        }
+        QVERIFY(!cache.containsNegative(key));
+        QVERIFY(cache.containsNegative(QStringLiteral("entry4999")));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::invalidation()
+{
+    const QLatin1String cacheName("myInvalidationTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024);
+        int callbackCalls = 0;
+        cache.setInvalidationCallback(
+            [&callbackCalls]() {
+                ++callbackCalls;
+            },
+            std::chrono::milliseconds(10));
+
+        // New entries don't invalidate anything
+        quint64 count = cache.invalidationCount();
+        QVERIFY(cache.insert(QStringLiteral("a"), QByteArrayLiteral("1")));
+        QVERIFY(cache.insert(QStringLiteral("b"), QByteArrayLiteral("2")));
+        QCOMPARE(cache.invalidationCount(), count);
+
+        // Replacing one does
+        QVERIFY(cache.insert(QStringLiteral("a"), QByteArrayLiteral("3")));
+        QCOMPARE_GT(cache.invalidationCount(), count);
+        QTRY_COMPARE(callbackCalls, 1);
+
+        // Also when done through another mapping of the cache
+        KSharedDataCache other(cacheName, 1024 * 1024);
+        count = cache.invalidationCount();
+        other.clear();
+        QCOMPARE_GT(cache.invalidationCount(), count);
+        QTRY_COMPARE(callbackCalls, 2);
+
+        count = cache.invalidationCount();
+        other.setTimestamp(cache.timestamp() + 1);
+        QCOMPARE_GT(cache.invalidationCount(), count);
+        QTRY_COMPARE(callbackCalls, 3);
+
+        // No more calls once the callback is unset
+        cache.setInvalidationCallback({});
+        const int calls = callbackCalls;
+        cache.clear();
+        QTest::qWait(50);
+        QCOMPARE(callbackCalls, calls);
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::resize()
+{
+    const QLatin1String cacheName("myResizeTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 256 * 1024, 1024);
+        KSharedDataCache other(cacheName, 256 * 1024, 1024);
+        const QByteArray data(900, 'x');
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), data));
+        }
+        cache.setTimestamp(42);
+
+        // Growing keeps everything
+        QVERIFY(cache.resize(4 * 1024 * 1024));
+        QVERIFY(cache.totalSize() >= 4u * 1024 * 1024);
+        QCOMPARE(cache.timestamp(), 42u);
+        QByteArray result;
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(cache.find(QStringLiteral("entry%1").arg(i), &result));
+            QCOMPARE(result, data);
+        }
+        for (int i = 100; i < 2000; ++i) {
+            QVERIFY(cache.insert(QStringLiteral("entry%1").arg(i), data));
+        }
+
+        // Others move over to the resized cache, even for lookups that don't
+        // get past the key filter
+        QVERIFY(other.contains(QStringLiteral("entry1998")));
+        QVERIFY(other.find(QStringLiteral("entry1999"), &result));
+        QCOMPARE(result, data);
+        QVERIFY(other.totalSize() >= 4u * 1024 * 1024);
+
+        // Shrinking keeps what fits
+        QVERIFY(cache.resize(512 * 1024));
+        QVERIFY(cache.totalSize() < 1024u * 1024);
+        QVERIFY(cache.freeSize() < cache.totalSize());
+        {
+            // Not while views point into the cache
+            const KSharedDataCache::EntryView view = cache.findView(QStringLiteral("entry1999"));
+            if (view.isValid()) {
+                QVERIFY(!cache.resize(1024 * 1024));
+            }
+        }
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::alignedEntries()
+{
+    const QLatin1String cacheName("myAlignedTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024);
+        const QByteArray header("width=16,height=16");
+        QByteArray pixels(16 * 16 * 4, '\0');
+        for (int i = 0; i < pixels.size(); ++i) {
+            pixels[i] = char(i);
+        }
+
+        QCOMPARE(KSharedDataCache::alignedDataOffset(0), qsizetype(0));
+        QCOMPARE(KSharedDataCache::alignedDataOffset(1), qsizetype(64));
+        QCOMPARE(KSharedDataCache::alignedDataOffset(64), qsizetype(64));
+        const qsizetype offset = KSharedDataCache::alignedDataOffset(header.size());
+
+        for (const QString &key : {QStringLiteral("a"), QStringLiteral("a much longer key for an aligned entry")}) {
+            QVERIFY(cache.insertAligned(key, header, pixels));
+
+            QByteArray result;
+            QVERIFY(cache.find(key, &result));
+            QCOMPARE(result.size(), offset + pixels.size());
+            QCOMPARE(result.first(header.size()), header);
+            QCOMPARE(result.sliced(header.size(), offset - header.size()), QByteArray(offset - header.size(), '\0'));
+            QCOMPARE(result.sliced(offset), pixels);
+
+            const KSharedDataCache::EntryView view = cache.findView(key);
+            QVERIFY(view.isValid());
+            QCOMPARE(view.data().sliced(offset), QByteArrayView(pixels));
+            QCOMPARE(quintptr(view.data().data()) % 64, quintptr(0));
+            QCOMPARE(quintptr(view.data().sliced(offset).data()) % 64, quintptr(0));
+        }
+
+        // Iterating sees the same data
+        bool seen = false;
+        cache.forEachEntry([&](const KSharedDataCache::EntryInfo &info, QByteArrayView data) {
+            if (info.key == QLatin1String("a")) {
+                seen = data.sliced(offset) == QByteArrayView(pixels);
+            }
+            return true;
+        });
+        QVERIFY(seen);
+
+        // Overwriting with a plain entry works
+        QVERIFY(cache.insert(QStringLiteral("a"), QByteArray("plain")));
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("a"), &result));
+        QCOMPARE(result, QByteArray("plain"));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::writeBehind()
+{
+    const QLatin1String cacheName("myWriteBehindTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024);
+        QCOMPARE(cache.writeBehindLimit(), 0u);
+        cache.setWriteBehindLimit(64 * 1024);
+        QCOMPARE(cache.writeBehindLimit(), 64u * 1024);
+
+        for (int i = 0; i < 100; ++i) {
+            QVERIFY(cache.insert(QStringLiteral("key%1").arg(i), QByteArray::number(i)));
+        }
+        QVERIFY(cache.insert(QStringLiteral("expiring"), QByteArrayLiteral("later"), 3600));
+        QVERIFY(cache.insert(QStringLiteral("key0"), QByteArrayLiteral("replaced")));
+
+        // Entries that don't fit into the queue are not cached
+        QVERIFY(!cache.insert(QStringLiteral("huge"), QByteArray(128 * 1024, 'x')));
+
+        cache.flush();
+        QByteArray result;
+        for (int i = 1; i < 100; ++i) {
+            QVERIFY(cache.find(QStringLiteral("key%1").arg(i), &result));
+            QCOMPARE(result, QByteArray::number(i));
+        }
+        QVERIFY(cache.find(QStringLiteral("key0"), &result));
+        QCOMPARE(result, QByteArrayLiteral("replaced"));
+        QVERIFY(cache.find(QStringLiteral("expiring"), &result));
+        QVERIFY(!cache.contains(QStringLiteral("huge")));
+
+        // The destructor flushes as well
+        QVERIFY(cache.insert(QStringLiteral("last"), QByteArrayLiteral("entry")));
+    }
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024);
+        QVERIFY(cache.contains(QStringLiteral("last")));
+
+        // Disabling applies the queue and inserts right away again
+        cache.setWriteBehindLimit(1024);
+        QVERIFY(cache.insert(QStringLiteral("queued"), QByteArrayLiteral("data")));
+        cache.setWriteBehindLimit(0);
+        QVERIFY(cache.contains(QStringLiteral("queued")));
+        QVERIFY(cache.insert(QStringLiteral("direct"), QByteArray(4096, 'x')));
+        QVERIFY(cache.contains(QStringLiteral("direct")));
+
+        // The event loop applies the queue
+        cache.setWriteBehindLimit(1024);
+        QVERIFY(cache.insert(QStringLiteral("later"), QByteArrayLiteral("data")));
+        QVERIFY(!cache.contains(QStringLiteral("later")));
+        QTRY_VERIFY(cache.contains(QStringLiteral("later")));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::frontCache()
+{
+    const QLatin1String cacheName("myFrontTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        // Another object of the same cache stands in for another process
+        KSharedDataCache cache(cacheName, 1024 * 1024);
+        KSharedDataCache other(cacheName, 1024 * 1024);
+        QCOMPARE(cache.frontCacheSize(), 0u);
+        cache.setFrontCacheSize(64 * 1024);
+        QCOMPARE(cache.frontCacheSize(), 64u * 1024);
+
+        QVERIFY(other.insert(QStringLiteral("key"), QByteArrayLiteral("one")));
+        QVERIFY(other.insert(QStringLiteral("unrelated"), QByteArrayLiteral("data")));
+        QByteArray result;
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("one"));
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("one"));
+
+        // Overwriting in another process outdates the copy
+        QVERIFY(other.insert(QStringLiteral("key"), QByteArrayLiteral("two")));
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("two"));
+
+        // So do clearing the cache and changing its timestamp
+        other.clear();
+        QVERIFY(!cache.find(QStringLiteral("key"), &result));
+        QVERIFY(other.insert(QStringLiteral("key"), QByteArrayLiteral("three")));
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("three"));
+        other.setTimestamp(other.timestamp() + 1);
+        QVERIFY(other.insert(QStringLiteral("key"), QByteArrayLiteral("four")));
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("four"));
+
+        // Copies larger than the front cache are not kept, but still found
+        const QByteArray big(128 * 1024, 'x');
+        QVERIFY(other.insert(QStringLiteral("big"), big));
+        QVERIFY(cache.find(QStringLiteral("big"), &result));
+        QCOMPARE(result, big);
+
+        cache.setFrontCacheSize(0);
+        QCOMPARE(cache.frontCacheSize(), 0u);
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("four"));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+void KSharedDataCacheTest::namespaces()
+{
+    const QLatin1String cacheName("myNamespaceTestCache");
+    KSharedDataCache::deleteCache(cacheName);
+
+    {
+        KSharedDataCache cache(cacheName, 1024 * 1024, 4096);
+        QVERIFY(!KSharedDataCache::Namespace().isValid());
+
+        KSharedDataCache::Namespace icons = cache.openNamespace(QStringLiteral("icons"), 64 * 1024);
+        KSharedDataCache::Namespace thumbnails = cache.openNamespace(QStringLiteral("thumbnails"));
+        QVERIFY(icons.isValid());
+        QVERIFY(thumbnails.isValid());
+        QCOMPARE(icons.name(), QStringLiteral("icons"));
+        QCOMPARE(icons.quota(), 64u * 1024);
+        QCOMPARE(thumbnails.quota(), 0u);
+
+        // The same key in different namespaces and in the cache itself
+        QVERIFY(icons.insert(QStringLiteral("key"), QByteArrayLiteral("icon")));
+        QVERIFY(thumbnails.insert(QStringLiteral("key"), QByteArrayLiteral("thumbnail")));
+        QVERIFY(cache.insert(QStringLiteral("key"), QByteArrayLiteral("plain")));
+        QByteArray result;
+        QVERIFY(icons.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("icon"));
+        QVERIFY(thumbnails.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("thumbnail"));
+        QVERIFY(cache.find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("plain"));
+        QVERIFY(!icons.find(QStringLiteral("missing"), &result));
+        QVERIFY(icons.contains(QStringLiteral("key")));
+        QVERIFY(!icons.contains(QStringLiteral("missing")));
+        QCOMPARE(icons.prefetch({QStringLiteral("key"), QStringLiteral("missing")}), 1);
+
+        // Other objects of the cache share the namespaces
+        KSharedDataCache other(cacheName, 1024 * 1024, 4096);
+        QVERIFY(other.openNamespace(QStringLiteral("icons"), 64 * 1024).find(QStringLiteral("key"), &result));
+        QCOMPARE(result, QByteArrayLiteral("icon"));
+
+        // The quota evicts the least recently used entries of the namespace only
+        const QByteArray data(6000, 'x');
+        for (int i = 0; i < 40; ++i) {
+            QVERIFY(icons.insert(QStringLiteral("icon%1").arg(i), data));
+            QVERIFY(thumbnails.insert(QStringLiteral("thumbnail%1").arg(i), data));
+            QVERIFY(icons.usedSize() <= icons.quota());
+        }
+        QVERIFY(icons.usedSize() > 0);
+        QVERIFY(thumbnails.usedSize() > icons.quota());
+        QVERIFY(icons.contains(QStringLiteral("icon39")));
+        QVERIFY(thumbnails.contains(QStringLiteral("thumbnail0")));
+        QVERIFY(!icons.insert(QStringLiteral("huge"), QByteArray(128 * 1024, 'x')));
+
+        const KSharedDataCache::Statistics statistics = icons.statistics();
+        QCOMPARE(statistics.hits, quint64(2));
+        QCOMPARE(statistics.misses, quint64(1));
+        QCOMPARE(statistics.inserts, quint64(41));
+        QVERIFY(statistics.evictions > 0);
+        QCOMPARE(thumbnails.statistics().evictions, quint64(0));
+
+        // Clearing a namespace leaves the others alone
+        icons.clear();
+        QVERIFY(!icons.contains(QStringLiteral("icon39")));
+        QCOMPARE(icons.usedSize(), 0u);
+        QVERIFY(thumbnails.contains(QStringLiteral("thumbnail39")));
+        QVERIFY(cache.contains(QStringLiteral("key")));
+
+        // Clearing the cache keeps the namespaces
+        cache.clear();
+        QCOMPARE(thumbnails.usedSize(), 0u);
+        QVERIFY(thumbnails.insert(QStringLiteral("key"), QByteArrayLiteral("again")));
+        QVERIFY(thumbnails.contains(QStringLiteral("key")));
+    }
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
 QTEST_MAIN(KSharedDataCacheTest)
 
 #include "kshareddatacachetest.moc"
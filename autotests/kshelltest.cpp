@@ -30,6 +30,8 @@ private Q_SLOTS:
     void quoteSplit();
     void quoteSplit_data();
     void abortOnMeta();
+    void splitArgsView_data();
+    void splitArgsView();
 };
 
 // The expansion of ~me isn't exactly QDir::homePath(), in case $HOME has a trailing slash, it's kept.
@@ -78,6 +80,11 @@ void KShellTest::quoteArg()
     QCOMPARE(KShell::quoteArg(QStringLiteral("a % space")), QStringLiteral("\"a %PERCENT_SIGN% space\""));
 #else
     QCOMPARE(KShell::quoteArg(QStringLiteral("a space")), QStringLiteral("'a space'"));
+    QCOMPARE(KShell::quoteArg(QStringLiteral("plain")), QStringLiteral("plain"));
+    QCOMPARE(KShell::quoteArg(QString()), QStringLiteral("''"));
+    QCOMPARE(KShell::quoteArg(QStringLiteral("it's")), QStringLiteral("'it'\\''s'"));
+    QCOMPARE(KShell::quoteArg(QStringLiteral("''")), QStringLiteral("''\\'''\\'''"));
+    QCOMPARE(KShell::quoteArg(QStringLiteral("a\"$b")), QStringLiteral("'a\"$b'"));
 #endif
 }
 
@@ -214,6 +221,47 @@ void KShellTest::abortOnMeta()
 #endif
 }
 
+void KShellTest::splitArgsView_data()
+{
+    QTest::addColumn<QString>("cmd");
+    QTest::addColumn<int>("flags");
+
+    QTest::newRow("plain") << QStringLiteral("kwrite --new-instance  %U ") << int(KShell::NoOptions);
+    QTest::newRow("quoted") << QStringLiteral("sh -c 'echo hi' \"a b\"c d\\ e") << int(KShell::NoOptions);
+    QTest::newRow("meta") << QStringLiteral("foo >bar") << int(KShell::AbortOnMeta);
+    QTest::newRow("assignment") << QStringLiteral("FOO=bar baz") << int(KShell::AbortOnMeta);
+    QTest::newRow("tilde") << QStringLiteral("ls ~ ~/dir") << int(KShell::TildeExpand);
+    QTest::newRow("bad quoting") << QStringLiteral("say \" error") << int(KShell::NoOptions);
+    QTest::newRow("one word") << QStringLiteral("dolphin") << int(KShell::AbortOnMeta);
+    QTest::newRow("empty") << QString() << int(KShell::NoOptions);
+}
+
+void KShellTest::splitArgsView()
+{
+    QFETCH(QString, cmd);
+    QFETCH(int, flags);
+
+    KShell::Errors expectedError = KShell::NoError;
+    const QStringList expected = KShell::splitArgs(cmd, KShell::Options(flags), &expectedError);
+
+    KShell::SplitArgsResult result;
+    // reusing the result replaces its contents
+    KShell::splitArgs(u"some leftover words", result);
+    QCOMPARE(KShell::splitArgs(cmd, result, KShell::Options(flags)), expectedError);
+    QCOMPARE(result.toStringList(), expected);
+    QCOMPARE(result.words().size(), expected.size());
+
+#ifndef Q_OS_WIN
+    // the words without quoting are not copied
+    const QString plain = QStringLiteral("kwrite --new-instance %U");
+    QCOMPARE(KShell::splitArgs(plain, result), KShell::NoError);
+    QCOMPARE(result.words().size(), 3);
+    for (QStringView word : result.words()) {
+        QVERIFY(word.data() >= plain.constData() && word.data() < plain.constData() + plain.size());
+    }
+#endif
+}
+
 QTEST_MAIN(KShellTest)
 
 #include "kshelltest.moc"
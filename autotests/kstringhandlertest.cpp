@@ -34,6 +34,15 @@ void KStringHandlerTest::tagURLs()
     test = QStringLiteral("Click on https://foo@bar:www.kde.org/ÿöyo/dyne.html#a1 for info.");
     QCOMPARE(KStringHandler::tagUrls(test),
              QStringLiteral("Click on <a href=\"https://foo@bar:www.kde.org/ÿöyo/dyne.html#a1\">https://foo@bar:www.kde.org/ÿöyo/dyne.html#a1</a> for info."));
+
+    // Schemes right after other text, and candidates that are no URLs
+    test = QStringLiteral("see:xhttps://kde.org, ftp:// and www..kde.org or www.www.");
+    QCOMPARE(KStringHandler::tagUrls(test),
+             QStringLiteral("see:x<a href=\"https://kde.org,\">https://kde.org,</a> ftp:// and www..kde.org or <a href=\"www.\">www.</a><a href=\"www.\">www.</a>"));
+
+    const QString noUrls = QStringLiteral("a long text with words, colons: and no links at all. ").repeated(100);
+    QCOMPARE(KStringHandler::tagUrls(noUrls), noUrls);
+    QCOMPARE(KStringHandler::tagUrls(noUrls + QLatin1String("http://kde.org")), noUrls + QLatin1String("<a href=\"http://kde.org\">http://kde.org</a>"));
 }
 
 void KStringHandlerTest::perlSplitTextSep()
@@ -60,6 +69,54 @@ void KStringHandlerTest::perlSplitRegexSep()
              (QStringList{QStringLiteral("aaa"), QStringLiteral("gǵg"), QStringLiteral("cd ef")}));
 }
 
+void KStringHandlerTest::perlSplitView()
+{
+    const QString text = QStringLiteral("__some__string____for__you__here__");
+    const QList<QStringView> views = KStringHandler::perlSplitView(u"__", text, 4);
+    QCOMPARE(views, (QList<QStringView>{u"some", u"string", u"for", u"you__here__"}));
+    // the tokens point into the original string
+    QCOMPARE(views.at(0).data(), text.constData() + 2);
+
+    QCOMPARE(KStringHandler::perlSplitView(QLatin1Char(' '), u"kparts reaches the parts other parts can't", 3),
+             (QList<QStringView>{u"kparts", u"reaches", u"the parts other parts can't"}));
+    QCOMPARE(KStringHandler::perlSplitView(QLatin1Char(' '), u"  a  b "), (QList<QStringView>{u"a", u"b"}));
+    QVERIFY(KStringHandler::perlSplitView(QLatin1Char(' '), u"   ").isEmpty());
+    QVERIFY(KStringHandler::perlSplitView(QLatin1Char(' '), QStringView()).isEmpty());
+
+    QCOMPARE(KStringHandler::perlSplitView(QRegularExpression(QStringLiteral("[! ]")), u"Split me up ! I'm bored ! OK ?", 3),
+             (QList<QStringView>{u"Split", u"me", u"up ! I'm bored ! OK ?"}));
+    // the separator's own options are replaced, as in perlSplit()
+    const QRegularExpression caseInsensitive(QStringLiteral("x"), QRegularExpression::CaseInsensitiveOption);
+    QCOMPARE(KStringHandler::perlSplitView(caseInsensitive, u"aXbxc"), (QList<QStringView>{u"aXb", u"c"}));
+    QCOMPARE(KStringHandler::perlSplitView(caseInsensitive, u"dxeXf"), (QList<QStringView>{u"d", u"eXf"}));
+    QCOMPARE(KStringHandler::perlSplitView(QRegularExpression(QStringLiteral("\\W"), QRegularExpression::UseUnicodePropertiesOption), u"aaa gǵg cd ef"),
+             (QList<QStringView>{u"aaa", u"gǵg", u"cd", u"ef"}));
+}
+
+void KStringHandlerTest::perlSplitIterator()
+{
+    KStringHandler::PerlSplitIterator it(u"=", u"==key=some==value=", 2);
+    QVERIFY(it.hasNext());
+    QCOMPARE(it.next(), QStringView(u"key"));
+    QVERIFY(it.hasNext());
+    QCOMPARE(it.next(), QStringView(u"some==value="));
+    QVERIFY(!it.hasNext());
+
+    QList<QStringView> tokens;
+    KStringHandler::PerlSplitIterator all(u", ", u"a, b, , c");
+    while (all.hasNext()) {
+        tokens.append(all.next());
+    }
+    QCOMPARE(tokens, (QList<QStringView>{u"a", u"b", u"c"}));
+
+    QVERIFY(!KStringHandler::PerlSplitIterator(u",", u",,,").hasNext());
+
+    // an empty separator doesn't split at all
+    KStringHandler::PerlSplitIterator noSeparator(QStringView(), u"abc");
+    QCOMPARE(noSeparator.next(), QStringView(u"abc"));
+    QVERIFY(!noSeparator.hasNext());
+}
+
 void KStringHandlerTest::obscure()
 {
     // See bug 167900, obscure() produced chars that could not properly be converted to and from
@@ -182,6 +239,9 @@ void KStringHandlerTest::logicalLength_data()
     QTest::newRow("Japanese") << QString::fromUtf8("\xe9\x9d\x92\xe3\x81\x84\xe7\xa9\xba") << 6;
     QTest::newRow("Korean") << QString::fromUtf8("\xed\x95\x9c\xea\xb5\xad\xec\x96\xb4") << 6;
     QTest::newRow("Mixed") << QString::fromUtf8("KDE\xe6\xa1\x8c\xe9\x9d\xa2") << 7;
+    QTest::newRow("LongMixed") << QString::fromUtf8("a file name long enough for vectors \xe6\xa1\x8c.txt and more\xe9\x9d\xa2") << 53;
+    QTest::newRow("SurrogatePair") << QString::fromUtf8("1234567\xf0\xa0\x80\x80") << 9;
+    QTest::newRow("LoneSurrogate") << (QStringLiteral("12345678") + QChar(0xd840)) << 9;
 }
 
 void KStringHandlerTest::logicalLength()
@@ -209,6 +269,10 @@ void KStringHandlerTest::lsqueeze()
     QFETCH(QString, expected);
 
     QCOMPARE(KStringHandler::lsqueeze(string, length), expected);
+
+    QStringList list{string, QStringLiteral("KDE"), string};
+    KStringHandler::lsqueeze(list, length);
+    QCOMPARE(list, (QStringList{expected, QStringLiteral("KDE"), expected}));
 }
 
 void KStringHandlerTest::csqueeze_data()
@@ -229,6 +293,10 @@ void KStringHandlerTest::csqueeze()
     QFETCH(QString, expected);
 
     QCOMPARE(KStringHandler::csqueeze(string, length), expected);
+
+    QStringList list{string, QStringLiteral("KDE"), string};
+    KStringHandler::csqueeze(list, length);
+    QCOMPARE(list, (QStringList{expected, QStringLiteral("KDE"), expected}));
 }
 
 void KStringHandlerTest::rsqueeze_data()
@@ -249,6 +317,10 @@ void KStringHandlerTest::rsqueeze()
     QFETCH(QString, expected);
 
     QCOMPARE(KStringHandler::rsqueeze(string, length), expected);
+
+    QStringList list{string, QStringLiteral("KDE"), string};
+    KStringHandler::rsqueeze(list, length);
+    QCOMPARE(list, (QStringList{expected, QStringLiteral("KDE"), expected}));
 }
 
 #include "moc_kstringhandlertest.cpp"
@@ -12,6 +12,8 @@ private Q_SLOTS:
     void tagURLs();
     void perlSplitTextSep();
     void perlSplitRegexSep();
+    void perlSplitView();
+    void perlSplitIterator();
     void obscure();
     void preProcessWrap_data();
     void preProcessWrap();
@@ -0,0 +1,59 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KSharedDataCache>
+#include <KTextToHTML>
+
+#include <QTest>
+
+class KTextToHTMLCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testConvertToHtmlCached();
+};
+
+void KTextToHTMLCacheTest::testConvertToHtmlCached()
+{
+    const QString cacheName = QStringLiteral("ktexttohtmlcachetest");
+    KSharedDataCache::deleteCache(cacheName);
+    KSharedDataCache cache(cacheName, 1024 * 1024);
+
+    const QString text = QStringLiteral("Hello *world*, see http://www.kde.org & mail foo@bar.com");
+    const KTextToHTML::Options flags = KTextToHTML::HighlightText;
+    const QString expected = KTextToHTML::convertToHtml(text, flags);
+
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, text, flags), expected);
+    QCOMPARE(cache.statistics().inserts, quint64(1));
+    // Now from the cache
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, text, flags), expected);
+    QCOMPARE(cache.statistics().inserts, quint64(1));
+    QCOMPARE(cache.statistics().hits, quint64(1));
+
+    // Other parameters are other entries
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, text, KTextToHTML::IgnoreUrls), KTextToHTML::convertToHtml(text, KTextToHTML::IgnoreUrls));
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, text, flags, 10), KTextToHTML::convertToHtml(text, flags, 10));
+    QCOMPARE(cache.statistics().inserts, quint64(3));
+
+    // The emoticons are built in, so smileys are cached as well
+    const QString smileyText = QStringLiteral("Hello :)");
+    const KTextToHTML::Options smileyFlags = KTextToHTML::ReplaceSmileys;
+    const QString smileyExpected = KTextToHTML::convertToHtml(smileyText, smileyFlags);
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, smileyText, smileyFlags), smileyExpected);
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, smileyText, smileyFlags), smileyExpected);
+    QCOMPARE(cache.statistics().inserts, quint64(4));
+    QCOMPARE(cache.statistics().hits, quint64(2));
+
+    QCOMPARE(KTextToHTML::convertToHtmlCached(&cache, QString(), flags), QString());
+    QCOMPARE(KTextToHTML::convertToHtmlCached(nullptr, text, flags), expected);
+
+    KSharedDataCache::deleteCache(cacheName);
+}
+
+QTEST_MAIN(KTextToHTMLCacheTest)
+
+#include "ktexttohtmlcachetest.moc"
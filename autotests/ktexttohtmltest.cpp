@@ -11,6 +11,7 @@
 #include "../src/lib/text/ktexttohtml.h"
 #include "../src/lib/text/ktexttohtml_p.h"
 
+#include <QBuffer>
 #include <QDebug>
 #include <QTest>
 #include <QUrl>
@@ -481,6 +482,105 @@ void KTextToHTMLTest::testHtmlConvert()
     QCOMPARE(actualHtml, htmlText);
 }
 
+void KTextToHTMLTest::testConverter_data()
+{
+    QTest::addColumn<int>("chunkSize");
+
+    QTest::newRow("single characters") << 1;
+    QTest::newRow("small chunks") << 7;
+    QTest::newRow("large chunks") << 100;
+}
+
+void KTextToHTMLTest::testConverter()
+{
+    QFETCH(int, chunkSize);
+
+    const QString plainText = QStringLiteral(
+        "Hello *world*, see http://www.kde.org.\n"
+        "\tindented by a tab, mail foo@bar.com or call +49 123 456789\n"
+        "a link broken over lines <http://www.kde.org/\n"
+        "some/path> and _underlined_ text\n"
+        "\n"
+        "  two spaces & <tags>\n"
+        "last line without newline");
+    const KTextToHTML::Options flags = KTextToHTML::PreserveSpaces | KTextToHTML::HighlightText | KTextToHTML::ConvertPhoneNumbers;
+    // Small enough for lines to be converted before the end of the text
+    const int maxUrlLen = 40;
+    const QString expected = KTextToHTML::convertToHtml(plainText, flags, maxUrlLen);
+
+    QString html;
+    int outputs = 0;
+    KTextToHTML::Converter converter(
+        [&](const QString &piece) {
+            html += piece;
+            ++outputs;
+        },
+        flags,
+        maxUrlLen);
+    for (int i = 0; i < plainText.size(); i += chunkSize) {
+        converter.addText(QStringView(plainText).mid(i, chunkSize));
+    }
+    QVERIFY(outputs > 0);
+    converter.finish();
+    QCOMPARE(html, expected);
+    QVERIFY(outputs > 1);
+
+    // The converter can be used again after finish()
+    html.clear();
+    converter.addText(plainText);
+    converter.finish();
+    QCOMPARE(html, expected);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    KTextToHTML::Converter deviceConverter(&buffer, flags, maxUrlLen);
+    deviceConverter.addText(plainText);
+    deviceConverter.finish();
+    QCOMPARE(QString::fromUtf8(buffer.data()), expected);
+}
+
+void KTextToHTMLTest::testConvertToHtmlBatch()
+{
+    const QStringList samples{
+        QStringLiteral("Hello *world*, see http://www.kde.org."),
+        QStringLiteral("mail foo@bar.com & <tags>"),
+        QStringLiteral("  two spaces\n\ttab"),
+        QStringLiteral("bad url <a href=\"http://foo.com\">link</a>"),
+        QString(),
+    };
+    QStringList plainTexts;
+    for (int i = 0; i < 100; ++i) {
+        plainTexts += samples;
+    }
+    const KTextToHTML::Options flags = KTextToHTML::PreserveSpaces | KTextToHTML::HighlightText;
+
+    const QStringList results = KTextToHTML::convertToHtmlBatch(plainTexts, flags);
+    QCOMPARE(results.size(), plainTexts.size());
+    for (qsizetype i = 0; i < plainTexts.size(); ++i) {
+        QCOMPARE(results.at(i), KTextToHTML::convertToHtml(plainTexts.at(i), flags));
+    }
+
+    QVERIFY(KTextToHTML::convertToHtmlBatch({}, flags).isEmpty());
+}
+
+void KTextToHTMLTest::testPathologicalInput()
+{
+    // These used to be rescanned from every '@' or digit
+    const KTextToHTML::Options flags = KTextToHTML::ConvertPhoneNumbers;
+    const QString ats = QStringLiteral("a@").repeated(100000);
+    QCOMPARE(KTextToHTML::convertToHtml(ats, flags), ats);
+    const QString digits = QString(100000, QLatin1Char('0'));
+    QCOMPARE(KTextToHTML::convertToHtml(digits, flags), digits);
+    const QString spacedDigits = QStringLiteral("0 ").repeated(100000) + QLatin1String("0x");
+    QCOMPARE(KTextToHTML::convertToHtml(spacedDigits, flags), spacedDigits);
+
+    // Too long for an address
+    const QString longLocalPart = QString(100000, QLatin1Char('a')) + QLatin1String("@example.com");
+    QCOMPARE(KTextToHTML::convertToHtml(longLocalPart, flags), longLocalPart);
+    const QString longDomain = QLatin1String("a@") + QString(100000, QLatin1Char('b')) + QLatin1String(".com");
+    QCOMPARE(KTextToHTML::convertToHtml(longDomain, flags), longDomain);
+}
+
 #define s(x) QStringLiteral(x)
 
 void KTextToHTMLTest::testEmoticons_data()
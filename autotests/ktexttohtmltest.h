@@ -17,6 +17,10 @@ private Q_SLOTS:
     void testGetUrl();
     void testHtmlConvert();
     void testHtmlConvert_data();
+    void testConverter_data();
+    void testConverter();
+    void testConvertToHtmlBatch();
+    void testPathologicalInput();
     void testEmoticons_data();
     void testEmoticons();
     void testEmoticonsNoReplace_data();
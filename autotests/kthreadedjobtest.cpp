@@ -0,0 +1,85 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KThreadedJob>
+
+#include <QSemaphore>
+#include <QSignalSpy>
+#include <QTest>
+#include <QThread>
+
+class KThreadedJobTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testResult();
+    void testError();
+    void testKill();
+};
+
+void KThreadedJobTest::testResult()
+{
+    QThread *workThread = nullptr;
+    auto job = new KThreadedJob([&workThread](KThreadedJob::Context &context) {
+        workThread = QThread::currentThread();
+        context.setTotalAmount(KJob::Bytes, 1000);
+        for (qulonglong amount = 1; amount <= 1000; ++amount) {
+            context.setProcessedAmount(KJob::Bytes, amount);
+        }
+    });
+    QSignalSpy processedSpy(job, &KJob::processedAmountChanged);
+    QSignalSpy resultSpy(job, &KJob::result);
+    job->start();
+    QVERIFY(resultSpy.wait());
+
+    QVERIFY(workThread);
+    QVERIFY(workThread != QThread::currentThread());
+    QCOMPARE(job->error(), int(KJob::NoError));
+    QCOMPARE(job->totalAmount(KJob::Bytes), qulonglong(1000));
+    QCOMPARE(job->processedAmount(KJob::Bytes), qulonglong(1000));
+    // Coalesced, as the updates came faster than they were handled
+    QVERIFY(processedSpy.size() < 1000);
+}
+
+void KThreadedJobTest::testError()
+{
+    auto job = new KThreadedJob([](KThreadedJob::Context &context) {
+        context.setError(KJob::UserDefinedError, QStringLiteral("failed"));
+    });
+    QSignalSpy resultSpy(job, &KJob::result);
+    job->start();
+    QVERIFY(resultSpy.wait());
+    QCOMPARE(job->error(), int(KJob::UserDefinedError));
+    QCOMPARE(job->errorText(), QStringLiteral("failed"));
+}
+
+void KThreadedJobTest::testKill()
+{
+    QSemaphore started;
+    std::atomic<bool> sawCancel = false;
+    QSemaphore done;
+    auto job = new KThreadedJob([&](KThreadedJob::Context &context) {
+        started.release();
+        while (!context.isCanceled()) {
+            QThread::msleep(1);
+        }
+        sawCancel = true;
+        done.release();
+    });
+    QSignalSpy destroyedSpy(job, &QObject::destroyed);
+    job->start();
+    started.acquire();
+    QVERIFY(job->kill());
+    QVERIFY(done.tryAcquire(1, 5000));
+    QVERIFY(sawCancel);
+    // The work being done doesn't touch the killed job
+    QVERIFY(destroyedSpy.wait());
+}
+
+QTEST_GUILESS_MAIN(KThreadedJobTest)
+
+#include "kthreadedjobtest.moc"
@@ -0,0 +1,58 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KTracing>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QObject>
+#include <QTest>
+
+class KTracingTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testInstall()
+    {
+        KTracingRingBuffer buffer;
+        QCOMPARE(KTracingSink::installed(), nullptr);
+        KTracingSink::install(&buffer);
+        QCOMPARE(KTracingSink::installed(), &buffer);
+        KTracingSink::install(nullptr);
+        QCOMPARE(KTracingSink::installed(), nullptr);
+    }
+
+    void testRingBuffer()
+    {
+        KTracingRingBuffer buffer(3);
+        buffer.begin("first", "length", 1);
+        buffer.end("first");
+        buffer.begin("second", nullptr, QVariant());
+        buffer.end("second");
+        QCOMPARE(buffer.size(), 3);
+
+        const QJsonArray events = QJsonDocument::fromJson(buffer.toChromeTrace()).object().value(QLatin1String("traceEvents")).toArray();
+        QCOMPARE(events.size(), 3);
+        // The oldest event was dropped
+        QCOMPARE(events.at(0).toObject().value(QLatin1String("name")).toString(), QStringLiteral("first"));
+        QCOMPARE(events.at(0).toObject().value(QLatin1String("ph")).toString(), QStringLiteral("E"));
+        QCOMPARE(events.at(1).toObject().value(QLatin1String("name")).toString(), QStringLiteral("second"));
+        QCOMPARE(events.at(1).toObject().value(QLatin1String("ph")).toString(), QStringLiteral("B"));
+        QVERIFY(!events.at(1).toObject().contains(QLatin1String("args")));
+        QVERIFY(events.at(1).toObject().value(QLatin1String("ts")).toInteger() <= events.at(2).toObject().value(QLatin1String("ts")).toInteger());
+
+        buffer.clear();
+        QCOMPARE(buffer.size(), 0);
+        buffer.begin("third", "namespace", QStringLiteral("kf6/test"));
+        const QJsonObject event = QJsonDocument::fromJson(buffer.toChromeTrace()).object().value(QLatin1String("traceEvents")).toArray().at(0).toObject();
+        QCOMPARE(event.value(QLatin1String("args")).toObject().value(QLatin1String("namespace")).toString(), QStringLiteral("kf6/test"));
+    }
+};
+
+QTEST_GUILESS_MAIN(KTracingTest)
+
+#include "ktracingtest.moc"
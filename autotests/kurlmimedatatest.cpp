@@ -159,4 +159,36 @@ void KUrlMimeDataTest::testMostLocalUrlList()
     delete mimeData;
 }
 
+void KUrlMimeDataTest::testKdeUriListParsing_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<QList<QUrl>>("expectedUrls");
+
+    const QList<QUrl> urls{QUrl(QStringLiteral("desktop:/foo")), QUrl(QStringLiteral("desktop:/bar"))};
+    QTest::newRow("empty") << QByteArray() << QList<QUrl>();
+    QTest::newRow("crlf") << QByteArray("desktop:/foo\r\ndesktop:/bar\r\n") << urls;
+    QTest::newRow("lf") << QByteArray("desktop:/foo\ndesktop:/bar\n") << urls;
+    QTest::newRow("no trailing newline") << QByteArray("desktop:/foo\r\ndesktop:/bar") << urls;
+    QTest::newRow("blank lines") << QByteArray("\n  desktop:/foo \r\n\r\n\tdesktop:/bar\n\n") << urls;
+}
+
+void KUrlMimeDataTest::testKdeUriListParsing()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QList<QUrl>, expectedUrls);
+
+    QMimeData mimeData;
+    mimeData.setData(QStringLiteral("application/x-kde4-urilist"), data);
+    QCOMPARE(KUrlMimeData::urlsFromMimeData(&mimeData), expectedUrls);
+
+    // And a big selection round-trips
+    QList<QUrl> urls;
+    for (int i = 0; i < 10000; ++i) {
+        urls.append(QUrl(QStringLiteral("smb://server/share/file %1.txt").arg(i)));
+    }
+    QMimeData bigMimeData;
+    KUrlMimeData::setUrls(urls, {}, &bigMimeData);
+    QCOMPARE(KUrlMimeData::urlsFromMimeData(&bigMimeData), urls);
+}
+
 #include "moc_kurlmimedatatest.cpp"
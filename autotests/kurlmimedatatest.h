@@ -19,6 +19,8 @@ private Q_SLOTS:
     void testFromQUrl();
     void testMostLocalUrlList_data();
     void testMostLocalUrlList();
+    void testKdeUriListParsing_data();
+    void testKdeUriListParsing();
 };
 
 #endif
@@ -8,6 +8,7 @@
 
 #include "kcoreaddons_debug.h"
 #include "kuser.h"
+#include "kuserlookupjob.h"
 
 namespace QTest
 {
@@ -31,6 +32,8 @@ private Q_SLOTS:
     void testKUserGroup();
     void testKUserId();
     void testKGroupId();
+    void testNamesForIds();
+    void testLookupJob();
 };
 
 static inline void printUserInfo(KUser user)
@@ -257,6 +260,52 @@ void KUserTest::testKGroupId()
     QCOMPARE(currentEffectiveGroup, KGroupId(currentGroup));
 }
 
+void KUserTest::testNamesForIds()
+{
+    const KUserId currentUser = KUserId::currentUserId();
+    const KUserId invalidUser;
+    const QStringList userNames = KUser::namesForIds({currentUser, invalidUser, currentUser});
+    QCOMPARE(userNames.size(), 3);
+    QCOMPARE(userNames.at(0), KUser(currentUser).loginName());
+    QVERIFY(userNames.at(1).isEmpty());
+    QCOMPARE(userNames.at(2), userNames.at(0));
+    // cached now
+    QCOMPARE(KUser::namesForIds({currentUser}), QStringList{userNames.at(0)});
+    QVERIFY(KUser::namesForIds({}).isEmpty());
+
+    const KGroupId currentGroup = KGroupId::currentGroupId();
+    const QStringList groupNames = KUserGroup::namesForIds({KGroupId(), currentGroup});
+    QCOMPARE(groupNames.size(), 2);
+    QVERIFY(groupNames.at(0).isEmpty());
+    QCOMPARE(groupNames.at(1), KUserGroup(currentGroup).name());
+}
+
+void KUserTest::testLookupJob()
+{
+    const KUser currentUser;
+
+    auto job = new KUserLookupJob(currentUser.loginName(), KUserLookupJob::LookupGroups);
+    QVERIFY(job->exec());
+    QCOMPARE(job->user(), currentUser);
+    QCOMPARE(job->user().homeDir(), currentUser.homeDir());
+    QCOMPARE(job->groups().size(), currentUser.groups().size());
+    QVERIFY(job->faceIconPath().isEmpty());
+
+    job = new KUserLookupJob(currentUser.userId());
+    QVERIFY(job->exec());
+    QCOMPARE(job->user().loginName(), currentUser.loginName());
+    QVERIFY(job->groups().isEmpty());
+
+    job = new KUserLookupJob(currentUser.loginName(), KUserLookupJob::LookupFaceIcon);
+    QVERIFY(job->exec());
+    QCOMPARE(job->faceIconPath(), currentUser.faceIconPath());
+
+    job = new KUserLookupJob(QStringLiteral("This_user_does_not_exist"));
+    QVERIFY(!job->exec());
+    QCOMPARE(job->error(), static_cast<int>(KUserLookupJob::Error::NoSuchUser));
+    QVERIFY(!job->user().isValid());
+}
+
 QTEST_MAIN(KUserTest)
 
 #include "kusertest.moc"
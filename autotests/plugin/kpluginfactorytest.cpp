@@ -9,10 +9,47 @@
 
 #include <QPluginLoader>
 #include <kpluginfactory.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+
 #ifndef Q_OS_WIN
 #include "plugins.h"
 #endif
 
+class TestInterface : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+};
+
+class TestInterfacePlugin : public TestInterface
+{
+    Q_OBJECT
+public:
+    using TestInterface::TestInterface;
+};
+
+class TestOtherPlugin : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+};
+
+class MultiPluginFactory : public KPluginFactory
+{
+    Q_OBJECT
+public:
+    MultiPluginFactory()
+    {
+        registerPlugin<TestInterfacePlugin>();
+        registerPlugin<TestOtherPlugin>();
+    }
+};
+
 class KPluginFactoryTest : public QObject
 {
     Q_OBJECT
@@ -48,6 +85,91 @@ private Q_SLOTS:
 #endif
     }
 
+    void testCreateByInterface()
+    {
+        MultiPluginFactory factory;
+
+        // The first registered plugin implementing the interface is created
+        std::unique_ptr<QObject> obj(factory.create<QObject>(this));
+        QVERIFY(obj);
+        QCOMPARE(obj->metaObject()->className(), "TestInterfacePlugin");
+        QCOMPARE(obj->parent(), this);
+
+        obj.reset(factory.create<TestInterface>(this));
+        QVERIFY(obj);
+        QCOMPARE(obj->metaObject()->className(), "TestInterfacePlugin");
+
+        obj.reset(factory.create<TestOtherPlugin>(this));
+        QVERIFY(obj);
+        QCOMPARE(obj->metaObject()->className(), "TestOtherPlugin");
+
+        QVERIFY(!factory.create<KPluginFactoryTest>(this));
+    }
+
+    void testLoadFactoryAsync()
+    {
+        const KPluginMetaData data(QStringLiteral("namespace/jsonplugin_cmake_macro"));
+        QVERIFY(data.isValid());
+        KPluginFactory::preload({data});
+
+        QFuture<KPluginFactory::Result<KPluginFactory>> future = KPluginFactory::loadFactoryAsync(data);
+        QTRY_VERIFY(future.isFinished());
+        const auto factoryResult = future.result();
+        QVERIFY(factoryResult);
+        QCOMPARE(factoryResult.plugin, KPluginFactory::loadFactory(data).plugin);
+        QCOMPARE(factoryResult.plugin->thread(), thread());
+
+        const auto invalidResult = KPluginFactory::loadFactoryAsync(KPluginMetaData(QStringLiteral("namespace/doesnotexist"))).result();
+        QVERIFY(!invalidResult);
+        QCOMPARE(invalidResult.errorReason, KPluginFactory::INVALID_PLUGIN);
+    }
+
+    void testFactoryHandle()
+    {
+        using namespace std::chrono_literals;
+        const KPluginMetaData data(QStringLiteral("namespace/jsonplugin_cmake_macro"));
+        QVERIFY(data.isValid());
+        const auto libraryInfo = [&data]() {
+            const auto libraries = KPluginFactory::managedLibraries();
+            const auto it = std::find_if(libraries.cbegin(), libraries.cend(), [&data](const KPluginFactory::ManagedLibrary &library) {
+                return library.fileName == data.fileName();
+            });
+            return it != libraries.cend() ? *it : KPluginFactory::ManagedLibrary();
+        };
+
+        auto handle = KPluginFactory::loadFactoryHandle(data, 10ms);
+        QVERIFY(handle);
+        QCOMPARE(handle.errorReason(), KPluginFactory::NO_PLUGIN_ERROR);
+        QObject *obj = handle.create<QObject>(this);
+        QVERIFY(obj);
+        QCOMPARE(obj->metaObject()->className(), "SimplePluginClass");
+
+        const int loadCount = libraryInfo().loadCount;
+        QVERIFY(libraryInfo().isLoaded);
+        QCOMPARE(libraryInfo().handleCount, 1);
+        QCOMPARE(libraryInfo().instanceCount, 1);
+
+        // The instance keeps the library
+        handle = {};
+        QCOMPARE(libraryInfo().handleCount, 0);
+        QTest::qWait(50);
+        QVERIFY(libraryInfo().isLoaded);
+
+        delete obj;
+        QCOMPARE(libraryInfo().instanceCount, 0);
+        QTRY_VERIFY(!libraryInfo().isLoaded);
+
+        // And is loaded again when needed
+        handle = KPluginFactory::loadFactoryHandle(data, 10ms);
+        QVERIFY(handle);
+        QVERIFY(libraryInfo().isLoaded);
+        QCOMPARE(libraryInfo().loadCount, loadCount + 1);
+
+        const auto invalid = KPluginFactory::loadFactoryHandle(KPluginMetaData(QStringLiteral("namespace/doesnotexist")));
+        QVERIFY(!invalid);
+        QCOMPARE(invalid.errorReason(), KPluginFactory::INVALID_PLUGIN);
+    }
+
     void testPluginWithoutMetaData()
     {
         KPluginFactory::Result<KPluginFactory> factoryResult = KPluginFactory::loadFactory(KPluginMetaData(QStringLiteral("namespace/pluginwithoutmetadata")));
@@ -0,0 +1,144 @@
+/*
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include <KPluginMetaData>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <map>
+#include <memory>
+
+#include "config-tests.h"
+
+Q_DECLARE_METATYPE(KPluginMetaData::KPluginMetaDataOptions)
+
+class KPluginMetaDataBenchmarkTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void benchFindPlugins_data();
+    void benchFindPlugins();
+    void benchFindPluginsFiltered_data();
+    void benchFindPluginsFiltered();
+    void benchFindPluginById_data();
+    void benchFindPluginById();
+
+private:
+    // The directory with @p count copies of the test plugin
+    QString pluginDirectory(int count);
+
+    std::map<int, std::unique_ptr<QTemporaryDir>> m_pluginDirectories;
+};
+
+void KPluginMetaDataBenchmarkTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+#if !ENABLE_BENCHMARKS
+    QSKIP("Benchmarks are disabled in debug mode");
+#endif
+}
+
+QString KPluginMetaDataBenchmarkTest::pluginDirectory(int count)
+{
+    auto &dir = m_pluginDirectories[count];
+    if (!dir) {
+        dir = std::make_unique<QTemporaryDir>();
+        const QString suffix = QFileInfo(QStringLiteral(TEMPLATE_PLUGIN)).suffix();
+        for (int i = 0; i < count; ++i) {
+            // The plugin id is derived from the file name, so every copy is a different plugin
+            const QString fileName = dir->filePath(QStringLiteral("benchplugin_%1.%2").arg(i).arg(suffix));
+            if (!QFile::copy(QStringLiteral(TEMPLATE_PLUGIN), fileName)) {
+                qWarning() << "Could not create" << fileName;
+            }
+        }
+    }
+    return dir->path();
+}
+
+static void addCountRows(const char *name, KPluginMetaData::KPluginMetaDataOptions options)
+{
+    for (int count : {100, 1000, 5000}) {
+        QTest::addRow("%s, %d plugins", name, count) << count << options;
+    }
+}
+
+void KPluginMetaDataBenchmarkTest::benchFindPlugins_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<KPluginMetaData::KPluginMetaDataOptions>("options");
+
+    addCountRows("cold", {});
+    addCountRows("warm", KPluginMetaData::CacheMetaData);
+    addCountRows("persistent cache", KPluginMetaData::PersistentCache);
+    addCountRows("parallel", KPluginMetaData::ParallelLoad);
+}
+
+void KPluginMetaDataBenchmarkTest::benchFindPlugins()
+{
+    QFETCH(int, count);
+    QFETCH(KPluginMetaData::KPluginMetaDataOptions, options);
+
+    const QString directory = pluginDirectory(count);
+    // Fills the caches for the warm runs, outside of the measurement
+    QCOMPARE(KPluginMetaData::findPlugins(directory, {}, options).size(), count);
+    QBENCHMARK {
+        KPluginMetaData::findPlugins(directory, {}, options);
+    }
+}
+
+void KPluginMetaDataBenchmarkTest::benchFindPluginsFiltered_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<KPluginMetaData::KPluginMetaDataOptions>("options");
+
+    addCountRows("callback", {});
+    addCountRows("indexed", KPluginMetaData::PersistentCache);
+}
+
+// Looking for plugins of a MIME type none of the plugins supports
+void KPluginMetaDataBenchmarkTest::benchFindPluginsFiltered()
+{
+    QFETCH(int, count);
+    QFETCH(KPluginMetaData::KPluginMetaDataOptions, options);
+
+    const QString directory = pluginDirectory(count);
+    KPluginMetaData::PluginFilter filter;
+    filter.mimeType = QStringLiteral("image/png");
+    QVERIFY(KPluginMetaData::findPluginsMatching(directory, filter, options).isEmpty());
+    QBENCHMARK {
+        KPluginMetaData::findPluginsMatching(directory, filter, options);
+    }
+}
+
+void KPluginMetaDataBenchmarkTest::benchFindPluginById_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<KPluginMetaData::KPluginMetaDataOptions>("options");
+
+    addCountRows("cold", {});
+    addCountRows("warm", KPluginMetaData::CacheMetaData);
+}
+
+void KPluginMetaDataBenchmarkTest::benchFindPluginById()
+{
+    QFETCH(int, count);
+    QFETCH(KPluginMetaData::KPluginMetaDataOptions, options);
+
+    const QString directory = pluginDirectory(count);
+    const QString pluginId = QStringLiteral("benchplugin_%1").arg(count / 2);
+    QVERIFY(KPluginMetaData::findPluginById(directory, pluginId, options).isValid());
+    QBENCHMARK {
+        KPluginMetaData::findPluginById(directory, pluginId, options);
+    }
+}
+
+QTEST_MAIN(KPluginMetaDataBenchmarkTest)
+
+#include "kpluginmetadatabenchmarktest.moc"
@@ -14,7 +14,9 @@
 
 #include "kcoreaddons_debug.h"
 #include <kaboutdata.h>
+#include <kjsonutils.h>
 #include <kpluginmetadata.h>
+#include <kpluginmimetypeindex.h>
 
 #include <QLocale>
 #include <QLoggingCategory>
@@ -166,6 +168,10 @@ private Q_SLOTS:
         QCOMPARE(m.version(), QStringLiteral("1.0"));
         QCOMPARE(m.website(), QStringLiteral("https://plasma.kde.org/"));
         QCOMPARE(m.mimeTypes(), QStringList(QStringLiteral("image/png")));
+
+        // The recurring values are interned
+        const KPluginMetaData other(m.rawData(), QStringLiteral("other"));
+        QCOMPARE(other.mimeTypes().constFirst().constData(), m.mimeTypes().constFirst().constData());
     }
 
     void testTranslations()
@@ -200,6 +206,45 @@ private Q_SLOTS:
         QCOMPARE(m.description(), QStringLiteral("Description"));
     }
 
+    void testTranslatedKeyLookup()
+    {
+        const QJsonObject jo = QJsonDocument::fromJson(
+                                   "{\n"
+                                   "\"Name\": \"Name\",\n"
+                                   "\"Name[de]\": \"Name (de)\",\n"
+                                   "\"Name[de_DE]\": \"Name (de_DE)\",\n"
+                                   "\"Description\": \"Description\",\n"
+                                   "\"Description[de]\": \"Beschreibung (de)\",\n"
+                                   "\"Count\": 3\n"
+                                   "}")
+                                   .object();
+
+        const KJsonUtils::TranslatedKeyLookup de(QLocale(QStringLiteral("de_DE")));
+        QCOMPARE(de.string(jo, u"Name"), QStringLiteral("Name (de_DE)"));
+        QCOMPARE(de.string(jo, u"Description"), QStringLiteral("Beschreibung (de)"));
+        QCOMPARE(de.string(jo, u"Count", QStringLiteral("none")), QStringLiteral("none"));
+        QCOMPARE(de.value(jo, u"Count"), QJsonValue(3));
+        QCOMPARE(de.value(jo, u"Missing", QJsonValue(true)), QJsonValue(true));
+
+        const QList<QJsonValue> values = de.values(jo, {u"Description", u"Missing", u"Name"});
+        QCOMPARE(values.size(), 3);
+        QCOMPARE(values.at(0), QJsonValue(QStringLiteral("Beschreibung (de)")));
+        QVERIFY(values.at(1).isUndefined());
+        QCOMPARE(values.at(2), QJsonValue(QStringLiteral("Name (de_DE)")));
+
+        const KJsonUtils::TranslatedKeyLookup c(QLocale::c());
+        QCOMPARE(c.locale(), QLocale::c());
+        QCOMPARE(c.string(jo, u"Name"), QStringLiteral("Name"));
+
+        // the free functions use the default locale
+        QLocale::setDefault(QLocale(QStringLiteral("de_CH")));
+        QCOMPARE(KJsonUtils::readTranslatedString(jo, QStringLiteral("Name")), QStringLiteral("Name (de)"));
+        QLocale::setDefault(QLocale(QStringLiteral("de_DE")));
+        QCOMPARE(KJsonUtils::readTranslatedString(jo, QStringLiteral("Name")), QStringLiteral("Name (de_DE)"));
+        QLocale::setDefault(QLocale::c());
+        QCOMPARE(KJsonUtils::readTranslatedString(jo, QStringLiteral("Name")), QStringLiteral("Name"));
+    }
+
     void testReadStringList()
     {
         if (!doMessagesWork()) {
@@ -243,6 +288,16 @@ private Q_SLOTS:
         QCOMPARE(data.value(QStringLiteral("QuotedNull"), QStringList()), QStringList(QStringLiteral("null")));
         QCOMPARE(data.value(QStringLiteral("ArrayWithNull"), QStringList()), QStringList() << QStringLiteral("foo") << QString() << QStringLiteral("bar"));
         QCOMPARE(data.value(QStringLiteral("Object"), QStringList()), QStringList());
+
+        // The decoded values are cached, but not the default values
+        const QStringList defaultValue{QStringLiteral("default")};
+        QCOMPARE(data.value(QStringLiteral("Object"), defaultValue), defaultValue);
+        QCOMPARE(data.value(QStringLiteral("Null"), defaultValue), defaultValue);
+        QCOMPARE(data.value(QStringLiteral("StringArray"), defaultValue), QStringList() << QStringLiteral("foo") << QStringLiteral("bar"));
+        QCOMPARE(data.value(QStringLiteral("String"), QStringLiteral("default")), QStringLiteral("foo"));
+        QCOMPARE(data.value(QStringLiteral("String"), QStringLiteral("other")), QStringLiteral("foo"));
+        QCOMPARE(data.value(QStringLiteral("Missing"), QStringLiteral("default")), QStringLiteral("default"));
+        QCOMPARE(data.value(QStringLiteral("Missing"), QStringLiteral("other")), QStringLiteral("other"));
     }
 
     void testJSONMetadata()
@@ -394,6 +449,129 @@ private Q_SLOTS:
         const KPluginMetaData validPlugin = KPluginMetaData::findPluginById(QStringLiteral("namespace"), QStringLiteral("jsonplugin_cmake_macro"));
         QVERIFY(validPlugin.isValid());
         QCOMPARE(plugins[0].pluginId(), QStringLiteral("jsonplugin_cmake_macro"));
+
+        // Looking up the metadata does not load the plugin
+        const KPluginMetaData qtPlugin = KPluginMetaData::findPluginById(QStringLiteral("namespace"), QStringLiteral("qtplugin"));
+        QVERIFY(qtPlugin.isValid());
+        QVERIFY(!QPluginLoader(qtPlugin.fileName()).isLoaded());
+    }
+
+    void testParallelLoad()
+    {
+        const auto serialPlugins = KPluginMetaData::findPlugins(QStringLiteral("namespace"), {}, KPluginMetaData::AllowEmptyMetaData);
+        const auto parallelPlugins =
+            KPluginMetaData::findPlugins(QStringLiteral("namespace"), {}, KPluginMetaData::AllowEmptyMetaData | KPluginMetaData::ParallelLoad);
+        QCOMPARE(parallelPlugins.size(), serialPlugins.size());
+        for (qsizetype i = 0; i < serialPlugins.size(); ++i) {
+            QCOMPARE(parallelPlugins.at(i).fileName(), serialPlugins.at(i).fileName());
+            QCOMPARE(parallelPlugins.at(i).pluginId(), serialPlugins.at(i).pluginId());
+        }
+    }
+
+    void testPersistentCache()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        auto pluginIds = [](const QList<KPluginMetaData> &plugins) {
+            QStringList ids;
+            for (const KPluginMetaData &plugin : plugins) {
+                ids << plugin.pluginId();
+            }
+            ids.sort();
+            return ids;
+        };
+        const QStringList expectedIds = pluginIds(KPluginMetaData::findPlugins(QStringLiteral("namespace"), {}, KPluginMetaData::AllowEmptyMetaData));
+        QVERIFY(!expectedIds.isEmpty());
+
+        // The first call writes the index, the second one reads it
+        for (int i = 0; i < 2; ++i) {
+            const auto plugins =
+                KPluginMetaData::findPlugins(QStringLiteral("namespace"), {}, KPluginMetaData::AllowEmptyMetaData | KPluginMetaData::PersistentCache);
+            QCOMPARE(pluginIds(plugins), expectedIds);
+        }
+
+        const auto plugins = KPluginMetaData::findPlugins(QStringLiteral("namespace"), {}, KPluginMetaData::PersistentCache);
+        const auto it = std::find_if(plugins.cbegin(), plugins.cend(), [](const KPluginMetaData &plugin) {
+            return plugin.pluginId() == QLatin1String("jsonplugin_cmake_macro");
+        });
+        QVERIFY(it != plugins.cend());
+        QCOMPARE(it->description(), QStringLiteral("This is a plugin"));
+        QVERIFY(QFileInfo(it->fileName()).isAbsolute());
+
+        const KPluginMetaData byId =
+            KPluginMetaData::findPluginById(QStringLiteral("namespace"), QStringLiteral("jsonplugin_cmake_macro"), KPluginMetaData::PersistentCache);
+        QVERIFY(byId.isValid());
+        QCOMPARE(byId.fileName(), it->fileName());
+        QVERIFY(!KPluginMetaData::findPluginById(QStringLiteral("namespace"), QStringLiteral("invalidid"), KPluginMetaData::PersistentCache).isValid());
+    }
+
+    void testFindPluginsMatching_data()
+    {
+        QTest::addColumn<QString>("mimeType");
+        QTest::addColumn<bool>("enabledByDefaultOnly");
+
+        QTest::newRow("all") << QString() << false;
+        QTest::newRow("enabled by default") << QString() << true;
+        QTest::newRow("text/plain") << QStringLiteral("text/plain") << false;
+        QTest::newRow("text/html") << QStringLiteral("text/html") << false;
+    }
+
+    void testFindPluginsMatching()
+    {
+        QFETCH(QString, mimeType);
+        QFETCH(bool, enabledByDefaultOnly);
+
+        QStandardPaths::setTestModeEnabled(true);
+        auto pluginIds = [](const QList<KPluginMetaData> &plugins) {
+            QStringList ids;
+            for (const KPluginMetaData &plugin : plugins) {
+                ids << plugin.pluginId();
+            }
+            ids.sort();
+            return ids;
+        };
+        const QStringList expectedIds = pluginIds(KPluginMetaData::findPlugins(
+            QStringLiteral("namespace"),
+            [&](const KPluginMetaData &plugin) {
+                return (mimeType.isEmpty() || plugin.supportsMimeType(mimeType)) && (!enabledByDefaultOnly || plugin.isEnabledByDefault());
+            },
+            KPluginMetaData::AllowEmptyMetaData));
+
+        KPluginMetaData::PluginFilter filter;
+        filter.mimeType = mimeType;
+        filter.enabledByDefaultOnly = enabledByDefaultOnly;
+        QCOMPARE(pluginIds(KPluginMetaData::findPluginsMatching(QStringLiteral("namespace"), filter, KPluginMetaData::AllowEmptyMetaData)), expectedIds);
+        // The first call writes the index, the second one reads it
+        for (int i = 0; i < 2; ++i) {
+            const auto plugins =
+                KPluginMetaData::findPluginsMatching(QStringLiteral("namespace"), filter, KPluginMetaData::AllowEmptyMetaData | KPluginMetaData::PersistentCache);
+            QCOMPARE(pluginIds(plugins), expectedIds);
+        }
+    }
+
+    void testMimeTypeIndex_data()
+    {
+        QTest::addColumn<QString>("mimeType");
+
+        QTest::newRow("text/plain") << QStringLiteral("text/plain");
+        QTest::newRow("text/html, inherited") << QStringLiteral("text/html");
+        QTest::newRow("invalid") << QStringLiteral("does/not/exist");
+    }
+
+    void testMimeTypeIndex()
+    {
+        QFETCH(QString, mimeType);
+
+        const QList<KPluginMetaData> expected = KPluginMetaData::findPlugins(QStringLiteral("namespace"), [&mimeType](const KPluginMetaData &plugin) {
+            return plugin.supportsMimeType(mimeType);
+        });
+
+        KPluginMimeTypeIndex index(QStringLiteral("namespace"));
+        QCOMPARE(index.plugins(), KPluginMetaData::findPlugins(QStringLiteral("namespace")));
+        QCOMPARE(index.pluginsSupporting(mimeType), expected);
+        // Memoized
+        QCOMPARE(index.pluginsSupporting(mimeType), expected);
+        QVERIFY(!index.reload());
+        QCOMPARE(index.pluginsSupporting(mimeType), expected);
     }
 
     void testStaticPlugins()
@@ -405,6 +583,8 @@ private Q_SLOTS:
 
         QCOMPARE(plugins.first().description(), QStringLiteral("This is a plugin"));
         QCOMPARE(plugins.first().fileName(), QStringLiteral("staticnamespace/static_jsonplugin_cmake_macro"));
+        // The metadata is looked up once
+        QCOMPARE(KPluginMetaData::findPlugins(QStringLiteral("staticnamespace")), plugins);
     }
 
     void testPluginsWithoutMetaData()
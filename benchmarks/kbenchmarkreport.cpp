@@ -0,0 +1,102 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// Merges the QTest XML logs of the benchmarks into one JSON document,
+// for comparing the results across releases and machines
+
+#include <kcoreaddons_version.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QXmlStreamReader>
+
+#include <cstdio>
+
+static QJsonObject readLog(QFile &file, QString *qtVersion)
+{
+    QJsonArray results;
+    QString function;
+
+    QXmlStreamReader xml(&file);
+    while (!xml.atEnd()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        const QXmlStreamAttributes attributes = xml.attributes();
+        if (xml.name() == QLatin1String("TestFunction")) {
+            function = attributes.value(QLatin1String("name")).toString();
+        } else if (xml.name() == QLatin1String("QtVersion")) {
+            *qtVersion = xml.readElementText();
+        } else if (xml.name() == QLatin1String("BenchmarkResult")) {
+            results.append(QJsonObject{
+                {QStringLiteral("function"), function},
+                {QStringLiteral("tag"), attributes.value(QLatin1String("tag")).toString()},
+                {QStringLiteral("metric"), attributes.value(QLatin1String("metric")).toString()},
+                {QStringLiteral("value"), attributes.value(QLatin1String("value")).toDouble()},
+                {QStringLiteral("iterations"), attributes.value(QLatin1String("iterations")).toInt()},
+            });
+        }
+    }
+    if (xml.hasError()) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(file.fileName()), qPrintable(xml.errorString()));
+    }
+
+    return QJsonObject{
+        {QStringLiteral("name"), QFileInfo(file.fileName()).completeBaseName()},
+        {QStringLiteral("results"), results},
+    };
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("output"), QStringLiteral("The JSON file to write, instead of the standard output."), QStringLiteral("file")});
+    parser.addPositionalArgument(QStringLiteral("logs"), QStringLiteral("The XML logs of the benchmarks, as written by their -o <log>,xml option."));
+    parser.process(app);
+
+    QString qtVersion = QString::fromLatin1(qVersion());
+    QJsonArray benchmarks;
+    const QStringList logs = parser.positionalArguments();
+    for (const QString &log : logs) {
+        QFile file(log);
+        if (!file.open(QIODevice::ReadOnly)) {
+            // Not written if the benchmark doesn't exist on this platform, or crashed
+            std::fprintf(stderr, "Skipping %s: %s\n", qPrintable(log), qPrintable(file.errorString()));
+            continue;
+        }
+        benchmarks.append(readLog(file, &qtVersion));
+    }
+
+    const QJsonObject report{
+        {QStringLiteral("kcoreaddonsVersion"), QStringLiteral(KCOREADDONS_VERSION_STRING)},
+        {QStringLiteral("qtVersion"), qtVersion},
+        {QStringLiteral("cpuArchitecture"), QSysInfo::currentCpuArchitecture()},
+        {QStringLiteral("kernel"), QSysInfo::kernelType() + QLatin1Char(' ') + QSysInfo::kernelVersion()},
+        {QStringLiteral("os"), QSysInfo::prettyProductName()},
+        {QStringLiteral("benchmarks"), benchmarks},
+    };
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (!parser.isSet(QStringLiteral("output"))) {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+        return 0;
+    }
+    QFile output(parser.value(QStringLiteral("output")));
+    if (!output.open(QIODevice::WriteOnly) || output.write(json) != json.size()) {
+        std::fprintf(stderr, "Could not write %s: %s\n", qPrintable(output.fileName()), qPrintable(output.errorString()));
+        return 1;
+    }
+    return 0;
+}
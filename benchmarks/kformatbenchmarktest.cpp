@@ -0,0 +1,153 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KFormat>
+
+#include <QDateTime>
+#include <QList>
+#include <QObject>
+#include <QRandomGenerator>
+#include <QTest>
+
+#include <utility>
+
+#include "config-tests.h"
+
+Q_DECLARE_METATYPE(KFormat::DurationFormatOptions)
+
+// The corpora, generated with a fixed seed so that every run formats the same values
+
+static QList<qint64> byteSizes()
+{
+    QRandomGenerator generator(42);
+    QList<qint64> sizes;
+    for (int i = 0; i < 1000; ++i) {
+        // Spread evenly over the magnitudes from bytes to terabytes
+        sizes << qint64(generator.bounded(1000)) << (qint64(1) << generator.bounded(42));
+    }
+    return sizes;
+}
+
+static QList<quint64> durations()
+{
+    QRandomGenerator generator(42);
+    QList<quint64> msecs;
+    for (int i = 0; i < 1000; ++i) {
+        msecs << generator.bounded(Q_UINT64_C(100) * 3600 * 1000);
+    }
+    return msecs;
+}
+
+class KFormatBenchmarkTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+#if !ENABLE_BENCHMARKS
+        QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    }
+
+    void benchFormatByteSize()
+    {
+        const KFormat format(QLocale::c());
+        const QList<qint64> sizes = byteSizes();
+        QBENCHMARK {
+            for (qint64 size : sizes) {
+                QVERIFY(!format.formatByteSize(size).isEmpty());
+            }
+        }
+    }
+
+    void benchAppendByteSize()
+    {
+        const KFormat format(QLocale::c());
+        const QList<qint64> sizes = byteSizes();
+        QString buffer;
+        QBENCHMARK {
+            buffer.clear();
+            for (qint64 size : sizes) {
+                format.appendByteSize(buffer, size);
+            }
+        }
+        QVERIFY(!buffer.isEmpty());
+    }
+
+    void benchFormatByteSizes()
+    {
+        const KFormat format(QLocale::c());
+        const QList<qint64> sizes = byteSizes();
+        QBENCHMARK {
+            QCOMPARE(format.formatByteSizes(sizes).size(), sizes.size());
+        }
+    }
+
+    void benchFormatDuration_data()
+    {
+        QTest::addColumn<KFormat::DurationFormatOptions>("options");
+
+        QTest::newRow("default") << KFormat::DurationFormatOptions(KFormat::DefaultDuration);
+        QTest::newRow("initials") << KFormat::DurationFormatOptions(KFormat::InitialDuration);
+        QTest::newRow("hours, minutes") << KFormat::DurationFormatOptions(KFormat::HideSeconds);
+    }
+
+    void benchFormatDuration()
+    {
+        QFETCH(KFormat::DurationFormatOptions, options);
+
+        const KFormat format(QLocale::c());
+        const QList<quint64> msecs = durations();
+        QBENCHMARK {
+            for (quint64 duration : msecs) {
+                QVERIFY(!format.formatDuration(duration, options).isEmpty());
+            }
+        }
+    }
+
+    void benchFormatSpelloutDuration()
+    {
+        const KFormat format(QLocale::c());
+        const QList<quint64> msecs = durations();
+        QBENCHMARK {
+            for (quint64 duration : msecs) {
+                QVERIFY(!format.formatSpelloutDuration(duration).isEmpty());
+            }
+        }
+    }
+
+    void benchFormatRelativeDateTime()
+    {
+        const KFormat format(QLocale::c());
+        // Relative to now, the same offsets every run
+        const QDateTime now = QDateTime::currentDateTime();
+        QList<QDateTime> dateTimes;
+        for (quint64 duration : durations()) {
+            dateTimes << now.addMSecs(-qint64(duration));
+        }
+        QBENCHMARK {
+            for (const QDateTime &dateTime : std::as_const(dateTimes)) {
+                QVERIFY(!format.formatRelativeDateTime(dateTime, QLocale::ShortFormat).isEmpty());
+            }
+        }
+    }
+
+    void benchFormatValue()
+    {
+        const KFormat format(QLocale::c());
+        const QList<qint64> sizes = byteSizes();
+        const QString unit = QStringLiteral("Hz");
+        QBENCHMARK {
+            for (qint64 size : sizes) {
+                QVERIFY(!format.formatValue(double(size), unit).isEmpty());
+            }
+        }
+    }
+};
+
+QTEST_GUILESS_MAIN(KFormatBenchmarkTest)
+
+#include "kformatbenchmarktest.moc"
@@ -0,0 +1,75 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <KProcessList>
+
+#include <QCoreApplication>
+#include <QObject>
+#include <QTest>
+
+#include "config-tests.h"
+
+Q_DECLARE_METATYPE(KProcessList::ProcessInfoFields)
+Q_DECLARE_METATYPE(KProcessList::ProcessListOptions)
+
+// Lists the processes of the machine running it, so results are only
+// comparable between runs on the same system under a similar load
+class KProcessListBenchmarkTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+#if !ENABLE_BENCHMARKS
+        QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    }
+
+    void benchProcessInfoList_data()
+    {
+        QTest::addColumn<KProcessList::ProcessInfoFields>("fields");
+        QTest::addColumn<KProcessList::ProcessListOptions>("options");
+
+        QTest::newRow("command") << KProcessList::ProcessInfoFields(KProcessList::CommandField) << KProcessList::ProcessListOptions();
+        QTest::newRow("default") << KProcessList::ProcessInfoFields(KProcessList::DefaultFields) << KProcessList::ProcessListOptions();
+        QTest::newRow("all") << KProcessList::ProcessInfoFields(KProcessList::AllFields) << KProcessList::ProcessListOptions();
+        QTest::newRow("all, parallel") << KProcessList::ProcessInfoFields(KProcessList::AllFields)
+                                       << KProcessList::ProcessListOptions(KProcessList::ParallelListing);
+    }
+
+    void benchProcessInfoList()
+    {
+        QFETCH(KProcessList::ProcessInfoFields, fields);
+        QFETCH(KProcessList::ProcessListOptions, options);
+
+        QBENCHMARK {
+            const KProcessList::KProcessInfoList processes = KProcessList::processInfoList(fields, options);
+            QVERIFY(!processes.isEmpty());
+        }
+    }
+
+    void benchProcessInfo()
+    {
+        const qint64 pid = QCoreApplication::applicationPid();
+        QBENCHMARK {
+            QVERIFY(KProcessList::processInfo(pid).isValid());
+        }
+    }
+
+    void benchSnapshotUpdate()
+    {
+        KProcessList::Snapshot snapshot;
+        snapshot.update();
+        QBENCHMARK {
+            snapshot.update();
+        }
+        QVERIFY(!snapshot.processes().isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(KProcessListBenchmarkTest)
+
+#include "kprocesslistbenchmarktest.moc"
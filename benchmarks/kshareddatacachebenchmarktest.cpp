@@ -0,0 +1,255 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include <kshareddatacache.h>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStandardPaths>
+#include <QString>
+#include <QTest>
+
+#include <algorithm>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "config-tests.h"
+
+Q_DECLARE_METATYPE(KSharedDataCache::EvictionPolicy)
+
+static const unsigned s_cacheSize = 16 * 1024 * 1024;
+
+static QString keyFor(int i)
+{
+    return QStringLiteral("entry%1").arg(i);
+}
+
+// Fills the cache to about @p fillRatio of its size with entries of @p itemSize
+// bytes, returning the number of entries inserted.
+static int fillCache(KSharedDataCache &cache, int itemSize, double fillRatio)
+{
+    const QByteArray data(itemSize, 'x');
+    const int count = qMax(1, int(s_cacheSize * fillRatio / itemSize));
+    for (int i = 0; i < count; ++i) {
+        cache.insert(keyFor(i), data);
+    }
+    return count;
+}
+
+class KSharedDataCacheBenchmarkTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void cleanup();
+    void benchInsert_data();
+    void benchInsert();
+    void benchFind_data();
+    void benchFind();
+    void benchEviction_data();
+    void benchEviction();
+    void benchContention_data();
+    void benchContention();
+
+private:
+    const QLatin1String m_cacheName = QLatin1String("myBenchmarkCache");
+};
+
+void KSharedDataCacheBenchmarkTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+#if !ENABLE_BENCHMARKS
+    QSKIP("Benchmarks are disabled in debug mode");
+#endif
+}
+
+void KSharedDataCacheBenchmarkTest::cleanup()
+{
+    KSharedDataCache::deleteCache(m_cacheName);
+}
+
+void KSharedDataCacheBenchmarkTest::benchInsert_data()
+{
+    QTest::addColumn<int>("itemSize");
+
+    QTest::newRow("64 B") << 64;
+    QTest::newRow("4 KiB") << 4096;
+    QTest::newRow("64 KiB") << 65536;
+}
+
+void KSharedDataCacheBenchmarkTest::benchInsert()
+{
+    QFETCH(int, itemSize);
+
+    KSharedDataCache::deleteCache(m_cacheName);
+    KSharedDataCache cache(m_cacheName, s_cacheSize, itemSize);
+    const QByteArray data(itemSize, 'x');
+
+    int i = 0;
+    QBENCHMARK {
+        cache.insert(keyFor(i++ % 1000), data);
+    }
+}
+
+void KSharedDataCacheBenchmarkTest::benchFind_data()
+{
+    QTest::addColumn<int>("itemSize");
+    QTest::addColumn<double>("fillRatio");
+
+    QTest::newRow("64 B, 10% full") << 64 << 0.1;
+    QTest::newRow("64 B, 90% full") << 64 << 0.9;
+    QTest::newRow("4 KiB, 10% full") << 4096 << 0.1;
+    QTest::newRow("4 KiB, 90% full") << 4096 << 0.9;
+    QTest::newRow("64 KiB, 90% full") << 65536 << 0.9;
+}
+
+void KSharedDataCacheBenchmarkTest::benchFind()
+{
+    QFETCH(int, itemSize);
+    QFETCH(double, fillRatio);
+
+    KSharedDataCache::deleteCache(m_cacheName);
+    KSharedDataCache cache(m_cacheName, s_cacheSize, itemSize);
+    const int count = fillCache(cache, itemSize, fillRatio);
+
+    QByteArray result;
+    int i = 0;
+    QBENCHMARK {
+        cache.find(keyFor(i++ % count), &result);
+    }
+}
+
+void KSharedDataCacheBenchmarkTest::benchEviction_data()
+{
+    QTest::addColumn<KSharedDataCache::EvictionPolicy>("policy");
+
+    QTest::newRow("least often used") << KSharedDataCache::EvictLeastOftenUsed;
+    QTest::newRow("least recently used") << KSharedDataCache::EvictLeastRecentlyUsed;
+    QTest::newRow("oldest") << KSharedDataCache::EvictOldest;
+}
+
+void KSharedDataCacheBenchmarkTest::benchEviction()
+{
+    QFETCH(KSharedDataCache::EvictionPolicy, policy);
+
+    KSharedDataCache::deleteCache(m_cacheName);
+    KSharedDataCache cache(m_cacheName, s_cacheSize, 4096);
+    cache.setEvictionPolicy(policy);
+    const int count = fillCache(cache, 4096, 1.0);
+
+    // Every insert has to evict something
+    const QByteArray data(4096, 'y');
+    int i = count;
+    QBENCHMARK {
+        cache.insert(keyFor(i++), data);
+    }
+}
+
+void KSharedDataCacheBenchmarkTest::benchContention_data()
+{
+    QTest::addColumn<int>("processCount");
+    QTest::addColumn<int>("writePercentage");
+
+    QTest::newRow("1 process, reads") << 1 << 0;
+    QTest::newRow("4 processes, reads") << 4 << 0;
+    QTest::newRow("4 processes, 10% writes") << 4 << 10;
+    QTest::newRow("16 processes, 10% writes") << 16 << 10;
+}
+
+// Runs @p processCount processes doing lookups and inserts on the same cache
+// at once, and reports the combined throughput and the worst 99th percentile
+// latency of any process.
+void KSharedDataCacheBenchmarkTest::benchContention()
+{
+    QFETCH(int, processCount);
+    QFETCH(int, writePercentage);
+
+    const int itemSize = 4096;
+    const int operationCount = 20000;
+
+    KSharedDataCache::deleteCache(m_cacheName);
+    int count = 0;
+    {
+        KSharedDataCache cache(m_cacheName, s_cacheSize, itemSize);
+        count = fillCache(cache, itemSize, 0.5);
+    }
+
+    struct Result {
+        qint64 elapsedNsecs;
+        qint64 p99Nsecs;
+    };
+
+    std::vector<int> pipes;
+    std::vector<pid_t> children;
+    for (int process = 0; process < processCount; ++process) {
+        int fds[2];
+        QVERIFY(::pipe(fds) == 0);
+
+        const pid_t pid = ::fork();
+        QVERIFY(pid >= 0);
+        if (pid == 0) {
+            ::close(fds[0]);
+
+            KSharedDataCache cache(m_cacheName, s_cacheSize, itemSize);
+            const QByteArray data(itemSize, char('a' + process));
+            std::vector<qint64> latencies;
+            latencies.reserve(operationCount);
+
+            QByteArray found;
+            QElapsedTimer total;
+            total.start();
+            for (int i = 0; i < operationCount; ++i) {
+                const int key = (i * 7919 + process * 104729) % count;
+                QElapsedTimer timer;
+                timer.start();
+                if (i % 100 < writePercentage) {
+                    cache.insert(keyFor(key), data);
+                } else {
+                    cache.find(keyFor(key), &found);
+                }
+                latencies.push_back(timer.nsecsElapsed());
+            }
+
+            Result result;
+            result.elapsedNsecs = total.nsecsElapsed();
+            std::nth_element(latencies.begin(), latencies.begin() + latencies.size() * 99 / 100, latencies.end());
+            result.p99Nsecs = latencies[latencies.size() * 99 / 100];
+
+            const bool written = ::write(fds[1], &result, sizeof(result)) == sizeof(result);
+            ::_exit(written ? 0 : 1);
+        }
+
+        ::close(fds[1]);
+        pipes.push_back(fds[0]);
+        children.push_back(pid);
+    }
+
+    qint64 longestElapsed = 0;
+    qint64 worstP99 = 0;
+    for (int process = 0; process < processCount; ++process) {
+        Result result;
+        const bool read = ::read(pipes[process], &result, sizeof(result)) == sizeof(result);
+        ::close(pipes[process]);
+
+        int status = 0;
+        ::waitpid(children[process], &status, 0);
+        QVERIFY(read);
+        QVERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+        longestElapsed = qMax(longestElapsed, result.elapsedNsecs);
+        worstP99 = qMax(worstP99, result.p99Nsecs);
+    }
+
+    const double opsPerSecond = double(processCount) * operationCount / (double(longestElapsed) / 1e9);
+    qInfo("%d processes, %d%% writes: %.0f ops/s, p99 latency %.1f us", processCount, writePercentage, opsPerSecond, worstP99 / 1000.0);
+    QTest::setBenchmarkResult(opsPerSecond, QTest::Events);
+}
+
+QTEST_MAIN(KSharedDataCacheBenchmarkTest)
+
+#include "kshareddatacachebenchmarktest.moc"
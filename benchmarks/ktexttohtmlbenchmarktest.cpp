@@ -0,0 +1,369 @@
+/*
+    SPDX-FileCopyrightText: 2005 Ingo Kloecker <kloecker@kde.org>
+    SPDX-FileCopyrightText: 2007 Allen Winter <winter@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include <KFuzzyMatcher>
+#include <KMacroExpander>
+#include <KShell>
+#include <KStringHandler>
+#include <KTextToHTML>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
+#include <QTest>
+
+#include "config-tests.h"
+
+Q_DECLARE_METATYPE(KTextToHTML::Options)
+
+// The corpora, generated so that the benchmarks don't depend on any files
+
+static QString prose()
+{
+    return QStringLiteral(
+               "The quick brown fox jumps over the lazy dog, and then it rests for a while in the shade of an old tree.\n"
+               "Nobody knows where it came from, but everyone agrees that it has been living in these woods for years.\n")
+        .repeated(2000);
+}
+
+static QString urlDense()
+{
+    return QStringLiteral(
+               "see https://www.kde.org/ and <http://planet.kde.org/> or mail foo@kde.org, call +49 123 456789 www.example.com\n")
+        .repeated(2000);
+}
+
+static QString emoticonChat()
+{
+    return QStringLiteral("alice: hey :-) how are you? bob: fine :D you? alice: meh :( but &lt;3 your cat ;)\n").repeated(2000);
+}
+
+static QString highlighted()
+{
+    return QStringLiteral("this is *bold* and _underlined_, this is /italic/ and -striked- text   with \ttabs\n").repeated(2000);
+}
+
+static QString hugeLine()
+{
+    return QStringLiteral("a single line without any newline, going on and on http://www.kde.org ").repeated(15000);
+}
+
+static QStringList filePaths()
+{
+    const QStringList dirs{
+        QStringLiteral("src/lib/caching/"),
+        QStringLiteral("src/lib/io/"),
+        QStringLiteral("src/lib/jobs/"),
+        QStringLiteral("src/lib/plugin/"),
+        QStringLiteral("src/lib/text/"),
+        QStringLiteral("autotests/"),
+    };
+    const QStringList names{
+        QStringLiteral("kdirwatch"),
+        QStringLiteral("kfuzzymatcher"),
+        QStringLiteral("kjobtrackerinterface"),
+        QStringLiteral("kpluginmetadata"),
+        QStringLiteral("kshareddatacache"),
+        QStringLiteral("ktexttohtml"),
+    };
+    QStringList paths;
+    for (int i = 0; i < 2000; ++i) {
+        paths << dirs.at(i % dirs.size()) + names.at((i / dirs.size()) % names.size()) + QString::number(i) + QStringLiteral(".cpp");
+    }
+    return paths;
+}
+
+static qsizetype byteSize(const QStringList &strings)
+{
+    qsizetype size = 0;
+    for (const QString &str : strings) {
+        size += str.size() * sizeof(QChar);
+    }
+    return size;
+}
+
+/**
+ * Runs @p function repeatedly for a while, and reports how many MB of input
+ * of @p bytes it processes per second
+ */
+template<typename Function>
+static void benchmarkThroughput(qsizetype bytes, Function function)
+{
+    // Once for warming up
+    function();
+
+    int iterations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    do {
+        function();
+        ++iterations;
+    } while (timer.elapsed() < 500);
+
+    const double bytesPerSecond = double(bytes) * iterations / (double(timer.nsecsElapsed()) / 1e9);
+    qInfo("%s: %.1f MB/s", QTest::currentDataTag() ? QTest::currentDataTag() : QTest::currentTestFunction(), bytesPerSecond / 1e6);
+    QTest::setBenchmarkResult(bytesPerSecond, QTest::BytesPerSecond);
+}
+
+class KTextToHTMLTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase()
+    {
+#if !ENABLE_BENCHMARKS
+        QSKIP("Benchmarks are disabled in debug mode");
+#endif
+    }
+
+    void benchHtmlConvert_data()
+    {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<KTextToHTML::Options>("options");
+
+        auto text = QStringLiteral("foo bar asdf :)").repeated(1000);
+        QTest::newRow("plain") << text << KTextToHTML::Options();
+        QTest::newRow("preserve-spaces") << text << KTextToHTML::Options(KTextToHTML::PreserveSpaces);
+        QTest::newRow("highlight-text") << text << KTextToHTML::Options(KTextToHTML::HighlightText);
+        QTest::newRow("replace-smileys") << text << KTextToHTML::Options(KTextToHTML::ReplaceSmileys);
+        QTest::newRow("preserve-spaces+highlight-text") << text << KTextToHTML::Options(KTextToHTML::PreserveSpaces | KTextToHTML::HighlightText);
+        QTest::newRow("preserve-spaces+highlight-text+replace-smileys")
+            << text << KTextToHTML::Options(KTextToHTML::PreserveSpaces | KTextToHTML::HighlightText | KTextToHTML::ReplaceSmileys);
+
+        auto textWithUrls = QStringLiteral("see https://www.kde.org/ or mail foo@kde.org for info, ").repeated(1000);
+        QTest::newRow("urls") << textWithUrls << KTextToHTML::Options();
+    }
+
+    void benchHtmlConvert()
+    {
+        QFETCH(QString, text);
+        QFETCH(KTextToHTML::Options, options);
+
+        QBENCHMARK {
+            const QString html = KTextToHTML::convertToHtml(text, options);
+            Q_UNUSED(html);
+        }
+    }
+
+    void benchHtmlConvertThroughput_data()
+    {
+        QTest::addColumn<QString>("text");
+        QTest::addColumn<KTextToHTML::Options>("options");
+
+        const QList<std::pair<const char *, QString>> corpora{
+            {"prose", prose()},
+            {"urls", urlDense()},
+            {"emoticons", emoticonChat()},
+            {"highlighted", highlighted()},
+            {"huge line", hugeLine()},
+        };
+        const QList<std::pair<const char *, KTextToHTML::Options>> optionSets{
+            {"none", KTextToHTML::Options()},
+            {"ignore-urls", KTextToHTML::IgnoreUrls},
+            {"highlight-text", KTextToHTML::HighlightText},
+            {"replace-smileys", KTextToHTML::ReplaceSmileys},
+            {"preserve-spaces", KTextToHTML::PreserveSpaces},
+            {"phone-numbers", KTextToHTML::ConvertPhoneNumbers},
+            {"all", KTextToHTML::PreserveSpaces | KTextToHTML::HighlightText | KTextToHTML::ReplaceSmileys | KTextToHTML::ConvertPhoneNumbers},
+        };
+        for (const auto &[corpusName, text] : corpora) {
+            for (const auto &[optionsName, options] : optionSets) {
+                QTest::addRow("%s, %s", corpusName, optionsName) << text << options;
+            }
+        }
+    }
+
+    void benchHtmlConvertThroughput()
+    {
+        QFETCH(QString, text);
+        QFETCH(KTextToHTML::Options, options);
+
+        benchmarkThroughput(text.size() * sizeof(QChar), [&]() {
+            const QString html = KTextToHTML::convertToHtml(text, options);
+            Q_UNUSED(html);
+        });
+    }
+
+    void benchFuzzyMatch_data()
+    {
+        QTest::addColumn<QString>("pattern");
+
+        QTest::newRow("short") << QStringLiteral("kfm");
+        QTest::newRow("long") << QStringLiteral("srclibtextkfuzzy");
+        QTest::newRow("no match") << QStringLiteral("xyzzy");
+    }
+
+    void benchFuzzyMatch()
+    {
+        QFETCH(QString, pattern);
+        const QStringList paths = filePaths();
+
+        benchmarkThroughput(byteSize(paths), [&]() {
+            for (const QString &path : paths) {
+                const auto result = KFuzzyMatcher::match(pattern, path);
+                Q_UNUSED(result);
+            }
+        });
+    }
+
+    void benchFuzzyMatchPattern_data()
+    {
+        benchFuzzyMatch_data();
+    }
+
+    void benchFuzzyMatchPattern()
+    {
+        QFETCH(QString, pattern);
+        const QStringList paths = filePaths();
+        const KFuzzyMatcher::Pattern compiled(pattern);
+
+        benchmarkThroughput(byteSize(paths), [&]() {
+            for (const QString &path : paths) {
+                const auto result = compiled.match(path);
+                Q_UNUSED(result);
+            }
+        });
+    }
+
+    void benchFuzzyMatchOptimal_data()
+    {
+        benchFuzzyMatch_data();
+    }
+
+    void benchFuzzyMatchOptimal()
+    {
+        QFETCH(QString, pattern);
+        const QStringList paths = filePaths();
+        const KFuzzyMatcher::Pattern compiled(pattern);
+
+        benchmarkThroughput(byteSize(paths), [&]() {
+            for (const QString &path : paths) {
+                const auto result = compiled.matchOptimal(path);
+                Q_UNUSED(result);
+            }
+        });
+    }
+
+    void benchFuzzyMatchAll_data()
+    {
+        benchFuzzyMatch_data();
+    }
+
+    void benchFuzzyMatchAll()
+    {
+        QFETCH(QString, pattern);
+        QStringList paths;
+        for (int i = 0; i < 10; ++i) {
+            paths += filePaths();
+        }
+        const QList<QStringView> views(paths.cbegin(), paths.cend());
+
+        benchmarkThroughput(byteSize(paths), [&]() {
+            const auto results = KFuzzyMatcher::matchAll(pattern, views);
+            Q_UNUSED(results);
+        });
+    }
+
+    void benchPerlSplit_data()
+    {
+        QTest::addColumn<QString>("text");
+
+        QTest::newRow("prose") << prose();
+        QTest::newRow("huge line") << hugeLine();
+    }
+
+    void benchPerlSplit()
+    {
+        QFETCH(QString, text);
+
+        benchmarkThroughput(text.size() * sizeof(QChar), [&]() {
+            const QStringList words = KStringHandler::perlSplit(QLatin1Char(' '), text);
+            Q_UNUSED(words);
+        });
+    }
+
+    void benchPerlSplitView_data()
+    {
+        benchPerlSplit_data();
+    }
+
+    void benchPerlSplitView()
+    {
+        QFETCH(QString, text);
+
+        benchmarkThroughput(text.size() * sizeof(QChar), [&]() {
+            const QList<QStringView> words = KStringHandler::perlSplitView(QLatin1Char(' '), text);
+            Q_UNUSED(words);
+        });
+    }
+
+    void benchSplitArgs_data()
+    {
+        QTest::addColumn<QStringList>("commands");
+
+        QTest::newRow("plain") << QStringList(2000, QStringLiteral("kwrite --new-instance -l 12 %U"));
+        QTest::newRow("quoted") << QStringList(2000, QStringLiteral("sh -c 'kwrite \"$1\"' _ %f"));
+    }
+
+    void benchSplitArgs()
+    {
+        QFETCH(QStringList, commands);
+
+        benchmarkThroughput(byteSize(commands), [&]() {
+            for (const QString &command : commands) {
+                const QStringList args = KShell::splitArgs(command, KShell::AbortOnMeta | KShell::TildeExpand);
+                Q_UNUSED(args);
+            }
+        });
+    }
+
+    void benchSplitArgsView_data()
+    {
+        benchSplitArgs_data();
+    }
+
+    void benchSplitArgsView()
+    {
+        QFETCH(QStringList, commands);
+        KShell::SplitArgsResult result;
+
+        benchmarkThroughput(byteSize(commands), [&]() {
+            for (const QString &command : commands) {
+                KShell::splitArgs(command, result, KShell::AbortOnMeta | KShell::TildeExpand);
+            }
+        });
+    }
+
+    void benchMacroExpander_data()
+    {
+        QTest::addColumn<QString>("text");
+
+        QTest::newRow("sparse") << QStringLiteral("the file %f is opened by %u with some text around it\n").repeated(5000);
+        QTest::newRow("dense") << QStringLiteral("%f %u %n %% %d").repeated(10000);
+    }
+
+    void benchMacroExpander()
+    {
+        QFETCH(QString, text);
+        const QHash<QChar, QString> map{
+            {QLatin1Char('f'), QStringLiteral("/home/user/file.txt")},
+            {QLatin1Char('u'), QStringLiteral("file:///home/user/file.txt")},
+            {QLatin1Char('n'), QStringLiteral("Name")},
+            {QLatin1Char('d'), QStringLiteral("/home/user")},
+        };
+
+        benchmarkThroughput(text.size() * sizeof(QChar), [&]() {
+            const QString expanded = KMacroExpander::expandMacros(text, map);
+            Q_UNUSED(expanded);
+        });
+    }
+};
+
+QTEST_MAIN(KTextToHTMLTest)
+
+#include "ktexttohtmlbenchmarktest.moc"
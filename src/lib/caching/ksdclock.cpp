@@ -9,8 +9,21 @@
 
 #include "kcoreaddons_debug.h"
 
+#include <QRandomGenerator>
+
 #include <memory>
 
+#ifdef Q_OS_WIN
+quint64 win32MutexLock::newId()
+{
+    quint64 id = 0;
+    while (id == 0) {
+        id = QRandomGenerator::system()->generate64();
+    }
+    return id;
+}
+#endif
+
 /**
  * This is a method to determine the best lock type to use for a
  * shared cache, based on local support. An identifier to the appropriate
@@ -23,6 +36,7 @@ SharedLockId findBestSharedLock()
     // support. Failing that we'll go thread-local
     bool timeoutsSupported = false;
     bool pthreadsProcessShared = false;
+    bool rwlocksProcessShared = false;
     bool semaphoresProcessShared = false;
 
 #ifdef KSDC_TIMEOUTS_SUPPORTED
@@ -45,9 +59,28 @@ SharedLockId findBestSharedLock()
 
         tempLock->initialize(pthreadsProcessShared);
     }
+
+    {
+        pthread_rwlock_t tempRWLock;
+        std::unique_ptr<KSDCLock> tempLock;
+        if (timeoutsSupported) {
+#ifdef KSDC_TIMEOUTS_SUPPORTED
+            tempLock = std::make_unique<pthreadTimedRWLock>(tempRWLock);
+#endif
+        } else {
+            tempLock = std::make_unique<pthreadRWLock>(tempRWLock);
+        }
+
+        tempLock->initialize(rwlocksProcessShared);
+    }
 #endif // KSDC_THREAD_PROCESS_SHARED_SUPPORTED
 
-    // Our first choice is pthread_mutex_t for compatibility.
+    // Our first choice is pthread_rwlock_t, which lets lookups from several
+    // processes proceed concurrently. Failing that, pthread_mutex_t.
+    if (timeoutsSupported && rwlocksProcessShared) {
+        return LOCKTYPE_RWLOCK;
+    }
+
     if (timeoutsSupported && pthreadsProcessShared) {
         return LOCKTYPE_MUTEX;
     }
@@ -74,8 +107,13 @@ SharedLockId findBestSharedLock()
         return LOCKTYPE_SEMAPHORE;
     }
 
+#ifdef Q_OS_WIN
+    // None of the above exist on Windows, but named mutexes always do.
+    return LOCKTYPE_WIN32_MUTEX;
+#else
     // Fallback to a dumb-simple but possibly-CPU-wasteful solution.
     return LOCKTYPE_SPINLOCK;
+#endif
 }
 
 KSDCLock *createLockFromId(SharedLockId id, SharedLock &lock)
@@ -90,6 +128,16 @@ KSDCLock *createLockFromId(SharedLockId id, SharedLock &lock)
 #endif
         return new pthreadLock(lock.mutex);
 
+        break;
+
+    case LOCKTYPE_RWLOCK:
+#ifdef KSDC_TIMEOUTS_SUPPORTED
+        if (::sysconf(_SC_TIMEOUTS) >= 200112L) {
+            return new pthreadTimedRWLock(lock.rwlock);
+        }
+#endif
+        return new pthreadRWLock(lock.rwlock);
+
         break;
 #endif // KSDC_THREAD_PROCESS_SHARED_SUPPORTED
 
@@ -109,6 +157,12 @@ KSDCLock *createLockFromId(SharedLockId id, SharedLock &lock)
         return new simpleSpinLock(lock.spinlock);
         break;
 
+#ifdef Q_OS_WIN
+    case LOCKTYPE_WIN32_MUTEX:
+        return new win32MutexLock(lock.win32MutexId);
+        break;
+#endif
+
     default:
         qCCritical(KCOREADDONS_DEBUG) << "Creating shell of a lock!";
         return new KSDCLock;
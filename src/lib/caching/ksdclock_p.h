@@ -10,8 +10,22 @@
 
 #include <qbasicatomic.h>
 
+#include <errno.h>
+#include <time.h>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+
+#include <string>
+#else
 #include <sched.h> // sched_yield
 #include <unistd.h> // Check for sched_yield
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 // Mac OS X, for all its POSIX compliance, does not support timeouts on its
 // mutexes, which is kind of a disaster for cross-process support. However
@@ -21,7 +35,7 @@
 #define KSDC_TIMEOUTS_SUPPORTED 1
 #endif
 
-#if defined(__GNUC__) && !defined(KSDC_TIMEOUTS_SUPPORTED)
+#if defined(__GNUC__) && !defined(KSDC_TIMEOUTS_SUPPORTED) && !defined(Q_OS_WIN)
 #warning "No support for POSIX timeouts -- application hangs are possible if the cache is corrupt"
 #endif
 
@@ -35,10 +49,26 @@
 #define KSDC_SEMAPHORES_SUPPORTED 1
 #endif
 
-#if defined(__GNUC__) && !defined(KSDC_SEMAPHORES_SUPPORTED) && !defined(KSDC_THREAD_PROCESS_SHARED_SUPPORTED)
+#if defined(__GNUC__) && !defined(KSDC_SEMAPHORES_SUPPORTED) && !defined(KSDC_THREAD_PROCESS_SHARED_SUPPORTED) && !defined(Q_OS_WIN)
 #warning "No system support claimed for process-shared synchronization, KSharedDataCache will be mostly useless."
 #endif
 
+// Tells the processor we're spinning, which saves power and frees up
+// resources for a sibling hyperthread possibly holding the lock.
+static inline void ksdcCpuRelax()
+{
+#if defined(Q_CC_GNU) && defined(Q_PROCESSOR_X86)
+    __builtin_ia32_pause();
+#elif defined(Q_CC_GNU) && (defined(Q_PROCESSOR_ARM_64) || (defined(Q_PROCESSOR_ARM) && Q_PROCESSOR_ARM >= 7))
+    asm volatile("yield");
+#endif
+}
+
+// How often the locks try to take a lock held by another process before
+// sleeping in the kernel, which is cheapest for the usual case of a lock
+// held only briefly.
+static constexpr unsigned s_ksdcSpinCount = 100;
+
 /**
  * This class defines an interface used by KSharedDataCache::Private to offload
  * proper locking and unlocking depending on what the platform supports at
@@ -67,12 +97,30 @@ public:
     virtual void unlock()
     {
     }
+
+    // Shared (reader) locking. Locks which do not distinguish between readers
+    // and writers simply take the exclusive lock.
+    virtual bool lockShared()
+    {
+        return lock();
+    }
+
+    virtual void unlockShared()
+    {
+        unlock();
+    }
 };
 
 /**
  * This is a very basic lock that should work on any system where GCC atomic
  * intrinsics are supported. It can waste CPU so better primitives should be
  * used if available on the system.
+ *
+ * The lock first spins for a short while, which is cheapest for the usual
+ * case of a lock held only briefly. After that it sleeps in the kernel until
+ * woken by unlock() on Linux, or yields the processor a few times elsewhere.
+ * The lock value is 0 if unlocked, 1 if locked and 2 if locked and possibly
+ * waited on.
  */
 class simpleSpinLock : public KSDCLock
 {
@@ -92,6 +140,40 @@ public:
 
     bool lock() override
     {
+        for (unsigned i = s_ksdcSpinCount; i > 0; --i) {
+            if (m_spinlock.loadRelaxed() == 0 && m_spinlock.testAndSetAcquire(0, 1)) {
+                return true;
+            }
+
+            ksdcCpuRelax();
+        }
+
+#ifdef __linux__
+        // Same timeout as for the other locks, upper-level code assumes the
+        // cache is corrupt if we fail.
+        struct timespec deadline;
+        ::clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += 10;
+
+        while (m_spinlock.fetchAndStoreAcquire(2) != 0) {
+            struct timespec now;
+            ::clock_gettime(CLOCK_MONOTONIC, &now);
+
+            struct timespec remaining = {deadline.tv_sec - now.tv_sec, deadline.tv_nsec - now.tv_nsec};
+            if (remaining.tv_nsec < 0) {
+                remaining.tv_sec--;
+                remaining.tv_nsec += 1000000000L;
+            }
+            if (remaining.tv_sec < 0) {
+                return false;
+            }
+
+            // Returns right away if the lock was released in the meantime.
+            ::syscall(SYS_futex, lockValue(), FUTEX_WAIT, 2, &remaining, nullptr, 0);
+        }
+
+        return true;
+#else
         // Spin a few times attempting to gain the lock, as upper-level code won't
         // attempt again without assuming the cache is corrupt.
         for (unsigned i = 50; i > 0; --i) {
@@ -105,14 +187,27 @@ public:
         }
 
         return false;
+#endif
     }
 
     void unlock() override
     {
-        m_spinlock.testAndSetRelease(1, 0);
+        if (m_spinlock.fetchAndStoreRelease(0) == 2) {
+#ifdef __linux__
+            ::syscall(SYS_futex, lockValue(), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+        }
     }
 
 private:
+#ifdef __linux__
+    int *lockValue() const
+    {
+        return reinterpret_cast<int *>(&m_spinlock);
+    }
+#endif
+
+#ifndef __linux__
 #ifdef Q_CC_GNU
     __attribute__((always_inline,
                    gnu_inline
@@ -127,7 +222,9 @@ private:
     {
 // TODO: Spinning might be better in multi-core systems... but that means
 // figuring how to find numbers of CPUs in a cross-platform way.
-#ifdef _POSIX_PRIORITY_SCHEDULING
+#if defined(Q_OS_WIN)
+        ::SwitchToThread();
+#elif defined(_POSIX_PRIORITY_SCHEDULING)
         sched_yield();
 #else
         // Sleep for shortest possible time (nanosleep should round-up).
@@ -135,6 +232,7 @@ private:
         ::nanosleep(&wait_time, static_cast<struct timespec *>(0));
 #endif
     }
+#endif
 
     QBasicAtomicInt &m_spinlock;
 };
@@ -157,6 +255,10 @@ public:
         // Initialize attributes, enable process-shared primitives, and setup
         // the mutex.
         if (::sysconf(_SC_THREAD_PROCESS_SHARED) >= 200112L && pthread_mutexattr_init(&mutexAttr) == 0) {
+#ifdef __GLIBC__
+            // Spins for a while before sleeping, see s_ksdcSpinCount
+            pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_ADAPTIVE_NP);
+#endif
             if (pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED) == 0 && pthread_mutex_init(&m_mutex, &mutexAttr) == 0) {
                 processSharingSupported = true;
             }
@@ -210,6 +312,129 @@ public:
 };
 #endif // defined(KSDC_THREAD_PROCESS_SHARED_SUPPORTED) && defined(KSDC_TIMEOUTS_SUPPORTED)
 
+#ifdef KSDC_THREAD_PROCESS_SHARED_SUPPORTED
+/**
+ * A reader/writer lock, allowing any number of processes to look up entries
+ * concurrently while modifications of the cache remain exclusive.
+ *
+ * This is the lock used on Linux. Unlike the mutexes, the rwlocks of glibc
+ * sleep in the kernel right away when the lock is taken, so the lock first
+ * spins for a short while, like simpleSpinLock.
+ */
+class pthreadRWLock : public KSDCLock
+{
+public:
+    pthreadRWLock(pthread_rwlock_t &rwlock)
+        : m_rwlock(rwlock)
+    {
+    }
+
+    bool initialize(bool &processSharingSupported) override
+    {
+        // Setup process-sharing.
+        pthread_rwlockattr_t rwlockAttr;
+        processSharingSupported = false;
+
+        if (::sysconf(_SC_THREAD_PROCESS_SHARED) >= 200112L && pthread_rwlockattr_init(&rwlockAttr) == 0) {
+#ifdef __GLIBC__
+            // The cache is read far more often than it is written to, so make
+            // sure a steady stream of readers can not starve out writers.
+            pthread_rwlockattr_setkind_np(&rwlockAttr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+            if (pthread_rwlockattr_setpshared(&rwlockAttr, PTHREAD_PROCESS_SHARED) == 0 && pthread_rwlock_init(&m_rwlock, &rwlockAttr) == 0) {
+                processSharingSupported = true;
+            }
+            pthread_rwlockattr_destroy(&rwlockAttr);
+        }
+
+        // Attempt to setup for thread-only synchronization.
+        if (!processSharingSupported && pthread_rwlock_init(&m_rwlock, nullptr) != 0) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool lock() override
+    {
+        return spinLock(pthread_rwlock_trywrlock) || pthread_rwlock_wrlock(&m_rwlock) == 0;
+    }
+
+    void unlock() override
+    {
+        pthread_rwlock_unlock(&m_rwlock);
+    }
+
+    bool lockShared() override
+    {
+        return spinLock(pthread_rwlock_tryrdlock) || pthread_rwlock_rdlock(&m_rwlock) == 0;
+    }
+
+    void unlockShared() override
+    {
+        pthread_rwlock_unlock(&m_rwlock);
+    }
+
+protected:
+    // Tries to take the lock with @p tryLock for a while, false if it stayed busy
+    bool spinLock(int (*tryLock)(pthread_rwlock_t *))
+    {
+        for (unsigned i = s_ksdcSpinCount; i > 0; --i) {
+            const int result = tryLock(&m_rwlock);
+            if (result == 0) {
+                return true;
+            } else if (result != EBUSY) {
+                return false;
+            }
+
+            ksdcCpuRelax();
+        }
+        return false;
+    }
+
+    pthread_rwlock_t &m_rwlock;
+};
+#endif // KSDC_THREAD_PROCESS_SHARED_SUPPORTED
+
+#if defined(KSDC_THREAD_PROCESS_SHARED_SUPPORTED) && defined(KSDC_TIMEOUTS_SUPPORTED)
+class pthreadTimedRWLock : public pthreadRWLock
+{
+public:
+    pthreadTimedRWLock(pthread_rwlock_t &rwlock)
+        : pthreadRWLock(rwlock)
+    {
+    }
+
+    bool lock() override
+    {
+        if (spinLock(pthread_rwlock_trywrlock)) {
+            return true;
+        }
+
+        struct timespec timeout;
+
+        // See pthreadTimedLock for the choice of timeout.
+        timeout.tv_sec = 10 + ::time(nullptr); // Absolute time, so 10 seconds from now
+        timeout.tv_nsec = 0;
+
+        return pthread_rwlock_timedwrlock(&m_rwlock, &timeout) == 0;
+    }
+
+    bool lockShared() override
+    {
+        if (spinLock(pthread_rwlock_tryrdlock)) {
+            return true;
+        }
+
+        struct timespec timeout;
+        timeout.tv_sec = 10 + ::time(nullptr);
+        timeout.tv_nsec = 0;
+
+        return pthread_rwlock_timedrdlock(&m_rwlock, &timeout) == 0;
+    }
+};
+#endif // defined(KSDC_THREAD_PROCESS_SHARED_SUPPORTED) && defined(KSDC_TIMEOUTS_SUPPORTED)
+
 #ifdef KSDC_SEMAPHORES_SUPPORTED
 class semaphoreLock : public KSDCLock
 {
@@ -277,6 +502,71 @@ public:
 };
 #endif // defined(KSDC_SEMAPHORES_SUPPORTED) && defined(KSDC_TIMEOUTS_SUPPORTED)
 
+#ifdef Q_OS_WIN
+/**
+ * A named Win32 mutex. The mutex itself belongs to the kernel, the shared
+ * memory only holds the random id it is named after, so that all processes
+ * mapping the cache open the same mutex.
+ *
+ * A mutex abandoned by a process that died while holding it is taken over.
+ * The sanity checks done after locking catch a cache it left damaged.
+ */
+class win32MutexLock : public KSDCLock
+{
+public:
+    win32MutexLock(quint64 &id)
+        : m_id(id)
+    {
+    }
+
+    ~win32MutexLock() override
+    {
+        if (m_mutex) {
+            ::CloseHandle(m_mutex);
+        }
+    }
+
+    bool initialize(bool &processSharingSupported) override
+    {
+        // Only the process setting up the cache finds no id yet, it is the
+        // only one accessing the cache at that point.
+        if (m_id == 0) {
+            m_id = newId();
+        }
+
+        // The session local namespace suffices, the cache files are per user.
+        const std::wstring name = L"Local\\KSharedDataCache-" + std::to_wstring(m_id);
+        m_mutex = ::CreateMutexW(nullptr, FALSE, name.c_str());
+        processSharingSupported = m_mutex != nullptr;
+        return processSharingSupported;
+    }
+
+    bool lock() override
+    {
+        // Same timeout as for the other locks, upper-level code assumes the
+        // cache is corrupt if we fail.
+        switch (::WaitForSingleObject(m_mutex, 10000)) {
+        case WAIT_OBJECT_0:
+        case WAIT_ABANDONED:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void unlock() override
+    {
+        ::ReleaseMutex(m_mutex);
+    }
+
+private:
+    static quint64 newId();
+
+    quint64 &m_id;
+    HANDLE m_mutex = nullptr;
+};
+#endif // Q_OS_WIN
+
 // This enum controls the type of the locking used for the cache to allow
 // for as much portability as possible. This value will be stored in the
 // cache and used by multiple processes, therefore you should consider this
@@ -286,6 +576,8 @@ enum SharedLockId {
     LOCKTYPE_MUTEX = 1, // pthread_mutex
     LOCKTYPE_SEMAPHORE = 2, // sem_t
     LOCKTYPE_SPINLOCK = 3, // atomic int in shared memory
+    LOCKTYPE_RWLOCK = 4, // pthread_rwlock
+    LOCKTYPE_WIN32_MUTEX = 5, // named Win32 mutex
 };
 
 // This type is a union of all possible lock types, with a SharedLockId used
@@ -294,11 +586,15 @@ struct SharedLock {
     union {
 #if defined(KSDC_THREAD_PROCESS_SHARED_SUPPORTED)
         pthread_mutex_t mutex;
+        pthread_rwlock_t rwlock;
 #endif
 #if defined(KSDC_SEMAPHORES_SUPPORTED)
         sem_t semaphore;
 #endif
         QBasicAtomicInt spinlock;
+#ifdef Q_OS_WIN
+        quint64 win32MutexId;
+#endif
 
         // It would be highly unfortunate if a simple glibc upgrade or kernel
         // addition caused this structure to change size when an existing
@@ -13,11 +13,22 @@
 
 #include <config-caching.h> // HAVE_SYS_MMAN_H
 
+#include <QDir>
 #include <QFile>
 #include <QtGlobal>
 #include <qplatformdefs.h>
 
+#include <atomic>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#else
+#include <fcntl.h> // fallocate
 #include <sys/resource.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#endif
 
 #if defined(_POSIX_MAPPED_FILES) && ((_POSIX_MAPPED_FILES == 0) || (_POSIX_MAPPED_FILES >= 200112L))
 #define KSDC_MAPPED_FILES_SUPPORTED 1
@@ -82,6 +93,127 @@ public:
         }
     }
 
+    // Same as lock(), but only takes the lock for reading if the lock type in
+    // use supports it. Only operations which do not modify the cache layout
+    // may be performed while holding the shared lock.
+    bool lockShared() const
+    {
+        if (Q_UNLIKELY(!m_mapped)) {
+            return false;
+        }
+        if (Q_LIKELY(m_mapped->shmLock.type == m_expectedType)) {
+            return m_lock->lockShared();
+        }
+
+        // Wrong type --> corrupt!
+        throw KSDCCorrupted("Invalid cache lock type!");
+    }
+
+    void unlockShared() const
+    {
+        if (Q_LIKELY(m_lock)) {
+            m_lock->unlockShared();
+        }
+    }
+
+    // Asks the kernel to back the mapping with transparent huge pages if
+    // @p enable is true, reducing TLB misses for large caches. Returns false
+    // if that is not supported.
+    bool adviseHugePages(bool enable) const
+    {
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        if (!m_mapped) {
+            return false;
+        }
+        return ::madvise(m_mapped, m_mapSize, enable ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) == 0;
+#else
+        Q_UNUSED(enable);
+        return false;
+#endif
+    }
+
+    // Asks the system to start reading in the pages covering the bytes
+    // [start, start + length) of the mapping, without waiting for them.
+    void adviseWillNeed(const void *start, quintptr length) const
+    {
+        if (!m_mapped || length == 0) {
+            return;
+        }
+#ifdef Q_OS_WIN
+        WIN32_MEMORY_RANGE_ENTRY range{const_cast<void *>(start), length};
+        ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+#elif defined(MADV_WILLNEED)
+        // madvise() wants the start aligned to a page of the system
+        const quintptr systemPageSize = ::sysconf(_SC_PAGESIZE);
+        const quintptr alignedStart = reinterpret_cast<quintptr>(start) & ~(systemPageSize - 1);
+        ::madvise(reinterpret_cast<void *>(alignedStart), length + (reinterpret_cast<quintptr>(start) - alignedStart), MADV_WILLNEED);
+#else
+        Q_UNUSED(start);
+#endif
+    }
+
+    // Returns the pages of the cache that are free and not needed by the free
+    // lists to the system, for all processes mapping the cache. The cache
+    // must be locked for writing. Returns the number of bytes released, 0 if
+    // that is not supported.
+    qint64 releaseUnusedPages() const
+    {
+#if defined(MADV_REMOVE) && defined(FALLOC_FL_KEEP_SIZE)
+        if (!m_mapped) {
+            return 0;
+        }
+
+        const quintptr systemPageSize = ::sysconf(_SC_PAGESIZE);
+        struct Range {
+            char *begin;
+            quintptr length;
+        };
+        std::vector<Range> ranges;
+        quintptr totalLength = 0;
+        m_mapped->forEachUnusedRange([&](char *begin, char *end) {
+            verifyProposedMemoryAccess(begin, end - begin);
+            // Only whole pages of the system, which must not overlap the bookkeeping
+            const quintptr alignedBegin = (reinterpret_cast<quintptr>(begin) + systemPageSize - 1) & ~(systemPageSize - 1);
+            const quintptr alignedEnd = reinterpret_cast<quintptr>(end) & ~(systemPageSize - 1);
+            if (alignedBegin < alignedEnd) {
+                ranges.push_back({reinterpret_cast<char *>(alignedBegin), alignedEnd - alignedBegin});
+                totalLength += alignedEnd - alignedBegin;
+            }
+        });
+        if (ranges.empty()) {
+            return 0;
+        }
+
+        // The pages of the file are allocated again right away, see below. Without
+        // the room for that, writing to them later would crash with SIGBUS.
+        struct statvfs fileSystem;
+        if (m_fd >= 0 && (::fstatvfs(m_fd, &fileSystem) != 0 || quint64(fileSystem.f_bavail) * fileSystem.f_frsize < totalLength)) {
+            return 0;
+        }
+
+        qint64 released = 0;
+        for (const Range &range : ranges) {
+            // Punches a hole into the file, or into the anonymous shared memory,
+            // dropping the pages from the page cache and the mappings of every process
+            if (::madvise(range.begin, range.length, MADV_REMOVE) != 0) {
+                // Not supported by the file system, or by the kernel
+                break;
+            }
+            released += range.length;
+            if (m_fd >= 0) {
+                // Like ensureFileAllocated(), but without pulling the pages into memory
+                const off_t offset = range.begin - reinterpret_cast<char *>(m_mapped);
+                if (::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, offset, range.length) != 0) {
+                    qCWarning(KCOREADDONS_DEBUG) << "Unable to allocate the released pages of the cache again:" << ::strerror(errno);
+                }
+            }
+        }
+        return released;
+#else
+        return 0;
+#endif
+    }
+
     // This should be called for any memory access to shared memory. This
     // function will verify that the bytes [base, base+accessLength) are
     // actually mapped to m_mapped. The cache itself may have incorrect cache
@@ -131,7 +263,8 @@ public:
         case KSharedDataCache::NoEvictionPreference: // fallthrough
         case KSharedDataCache::EvictLeastRecentlyUsed: // fallthrough
         case KSharedDataCache::EvictLeastOftenUsed: // fallthrough
-        case KSharedDataCache::EvictOldest:
+        case KSharedDataCache::EvictOldest: // fallthrough
+        case KSharedDataCache::AdmitFrequentlyUsed:
             break;
         default:
             return false;
@@ -142,6 +275,10 @@ public:
 
     SharedMemory *m_mapped;
 
+    // All mappings of the process, see KMemoryFootprint
+    static inline std::atomic<qsizetype> s_mappingCount = 0;
+    static inline std::atomic<qint64> s_mappedBytes = 0;
+
 private:
     // Put the cache in a condition to be able to call mapSharedMemory() by
     // completely detaching from shared memory (such as to respond to an
@@ -161,60 +298,140 @@ private:
             if (flush) {
                 ::msync(m_mapped, m_mapSize, MS_INVALIDATE | MS_ASYNC);
             }
+#else
+            Q_UNUSED(flush);
 #endif
-            ::munmap(m_mapped, m_mapSize);
-            if (0 != ::munmap(m_mapped, m_mapSize)) {
-                qCCritical(KCOREADDONS_DEBUG) << "Unable to unmap shared memory segment" << static_cast<void *>(m_mapped) << ":" << ::strerror(errno);
-            }
+            unmapMemory(m_mapped, m_mapSize);
+            s_mappingCount.fetch_sub(1, std::memory_order_relaxed);
+            s_mappedBytes.fetch_sub(m_mapSize, std::memory_order_relaxed);
         }
 
+#ifndef Q_OS_WIN
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+#endif
+
         // Do not delete m_mapped, it was never constructed, it's just an alias.
         m_mapped = nullptr;
         m_mapSize = 0;
     }
 
+#ifdef Q_OS_WIN
+    // Maps @p size bytes of @p file shared with all other processes mapping
+    // it, or a private anonymous memory segment if @p file is null. Returns
+    // nullptr if that fails.
+    static void *mapMemory(const QFile *file, uint size)
+    {
+        HANDLE fileHandle = INVALID_HANDLE_VALUE;
+        if (file) {
+            // The file is opened again instead of mapping file->handle(), since
+            // the mapping keeps the file open and the file must remain
+            // replaceable and removable meanwhile, see KSharedDataCache::resize()
+            // and deleteCache().
+            fileHandle = ::CreateFileW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(file->fileName()).utf16()),
+                                       GENERIC_READ | GENERIC_WRITE,
+                                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                       nullptr,
+                                       OPEN_EXISTING,
+                                       FILE_ATTRIBUTE_NORMAL,
+                                       nullptr);
+            if (fileHandle == INVALID_HANDLE_VALUE) {
+                return nullptr;
+            }
+        }
+
+        HANDLE mapping = ::CreateFileMappingW(fileHandle, nullptr, PAGE_READWRITE, 0, size, nullptr);
+        if (fileHandle != INVALID_HANDLE_VALUE) {
+            ::CloseHandle(fileHandle);
+        }
+        if (!mapping) {
+            return nullptr;
+        }
+
+        // The view keeps the mapping, and the mapping the file, alive.
+        void *mapAddress = ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+        ::CloseHandle(mapping);
+        return mapAddress;
+    }
+
+    static void unmapMemory(void *mapAddress, uint size)
+    {
+        Q_UNUSED(size);
+        if (!::UnmapViewOfFile(mapAddress)) {
+            qCCritical(KCOREADDONS_DEBUG) << "Unable to unmap shared memory segment" << mapAddress << ":" << ::GetLastError();
+        }
+    }
+#else
+    // Maps @p size bytes of @p file shared with all other processes mapping
+    // it, or a private anonymous memory segment if @p file is null. Returns
+    // nullptr if that fails.
+    static void *mapMemory(const QFile *file, uint size)
+    {
+        if (!file) {
+            void *mapAddress = QT_MMAP(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            return mapAddress != MAP_FAILED ? mapAddress : nullptr;
+        }
+
+        // Use mmap directly instead of QFile::map since the QFile (and its
+        // shared mapping) will disappear unless we hang onto the QFile for no
+        // reason (see the note below, we don't care about the file per se...)
+        void *mapAddress = QT_MMAP(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->handle(), 0);
+        if (mapAddress == MAP_FAILED) {
+            return nullptr;
+        }
+
+        // Successful mmap doesn't actually mean that whole range is readable so ensure it is
+        struct rlimit memlock;
+        if (getrlimit(RLIMIT_MEMLOCK, &memlock) == 0 && memlock.rlim_cur >= 2) {
+            // Half of limit in case something else has already locked some mem
+            uint lockSize = qMin(memlock.rlim_cur / 2, (rlim_t)size);
+            // Note that lockSize might be less than what we need to mmap
+            // and so this doesn't guarantee that later parts will be readable
+            // but that's fine, at least we know we will succeed here
+            if (mlock(mapAddress, lockSize)) {
+                throw KSDCCorrupted(QLatin1String("Cache is inaccessible ") + file->fileName());
+            }
+            if (munlock(mapAddress, lockSize) != 0) {
+                qCDebug(KCOREADDONS_DEBUG) << "Failed to munlock!";
+            }
+        } else {
+            qCWarning(KCOREADDONS_DEBUG) << "Failed to get RLIMIT_MEMLOCK!";
+        }
+
+        return mapAddress;
+    }
+
+    static void unmapMemory(void *mapAddress, uint size)
+    {
+        if (0 != ::munmap(mapAddress, size)) {
+            qCCritical(KCOREADDONS_DEBUG) << "Unable to unmap shared memory segment" << mapAddress << ":" << ::strerror(errno);
+        }
+    }
+#endif
+
     // This function does a lot of the important work, attempting to connect to shared
     // memory, a private anonymous mapping if that fails, and failing that, nothing (but
     // the cache remains "valid", we just don't actually do anything).
     void mapSharedMemory(const QFile *file, uint size, uint cacheSize, uint pageSize)
     {
-        void *mapAddress = MAP_FAILED;
+        void *mapAddress = nullptr;
 
         if (file) {
-            // Use mmap directly instead of QFile::map since the QFile (and its
-            // shared mapping) will disappear unless we hang onto the QFile for no
-            // reason (see the note below, we don't care about the file per se...)
-            mapAddress = QT_MMAP(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->handle(), 0);
+            mapAddress = mapMemory(file, size);
 
             // So... it is possible that someone else has mapped this cache already
             // with a larger size. If that's the case we need to at least match
             // the size to be able to access every entry, so fixup the mapping.
-            if (mapAddress != MAP_FAILED) {
-                // Successful mmap doesn't actually mean that whole range is readable so ensure it is
-                struct rlimit memlock;
-                if (getrlimit(RLIMIT_MEMLOCK, &memlock) == 0 && memlock.rlim_cur >= 2) {
-                    // Half of limit in case something else has already locked some mem
-                    uint lockSize = qMin(memlock.rlim_cur / 2, (rlim_t)size);
-                    // Note that lockSize might be less than what we need to mmap
-                    // and so this doesn't guarantee that later parts will be readable
-                    // but that's fine, at least we know we will succeed here
-                    if (mlock(mapAddress, lockSize)) {
-                        throw KSDCCorrupted(QLatin1String("Cache is inaccessible ") + file->fileName());
-                    }
-                    if (munlock(mapAddress, lockSize) != 0) {
-                        qCDebug(KCOREADDONS_DEBUG) << "Failed to munlock!";
-                    }
-                } else {
-                    qCWarning(KCOREADDONS_DEBUG) << "Failed to get RLIMIT_MEMLOCK!";
-                }
-
+            if (mapAddress) {
                 SharedMemory *mapped = reinterpret_cast<SharedMemory *>(mapAddress);
 
                 // First make sure that the version of the cache on disk is
                 // valid.  We also need to check that version != 0 to
                 // disambiguate against an uninitialized cache.
                 if (mapped->version != SharedMemory::PIXMAP_CACHE_VERSION && mapped->version > 0) {
-                    detachFromSharedMemory(false);
+                    unmapMemory(mapAddress, size);
                     throw KSDCCorrupted(QLatin1String("Wrong version of cache ") + file->fileName());
                 } else if (mapped->cacheSize > cacheSize) {
                     // This order is very important. We must save the cache size
@@ -222,10 +439,10 @@ private:
                     // the previous mapping size...
                     auto actualCacheSize = mapped->cacheSize;
                     auto actualPageSize = mapped->cachePageSize();
-                    ::munmap(mapAddress, size);
-                    size = SharedMemory::totalSize(cacheSize, pageSize);
-                    mapAddress = QT_MMAP(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->handle(), 0);
-                    if (mapAddress != MAP_FAILED) {
+                    unmapMemory(mapAddress, size);
+                    size = SharedMemory::totalSize(actualCacheSize, actualPageSize);
+                    mapAddress = mapMemory(file, size);
+                    if (mapAddress) {
                         cacheSize = actualCacheSize;
                         pageSize = actualPageSize;
                     }
@@ -247,22 +464,32 @@ private:
         // NOTE: We never use the on-disk representation independently of the
         // shared memory. If we don't get shared memory the disk info is ignored,
         // if we do get shared memory we never look at disk again.
-        if (!file || mapAddress == MAP_FAILED) {
+#ifndef Q_OS_WIN
+        // Kept to allocate the pages of the file again, see releaseUnusedPages()
+        if (file && mapAddress) {
+            m_fd = ::dup(file->handle());
+        }
+#endif
+
+        if (!file || !mapAddress) {
             qCWarning(KCOREADDONS_DEBUG) << "Couldn't establish file backed memory mapping, will fallback"
                                          << "to anonymous memory";
-            mapAddress = QT_MMAP(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            mapAddress = mapMemory(nullptr, size);
         }
 
         // Well now we're really hosed. We can still work, but we can't even cache
         // data.
-        if (mapAddress == MAP_FAILED) {
-            qCCritical(KCOREADDONS_DEBUG) << "Unable to allocate shared memory segment for shared data cache" << file->fileName() << "of size" << m_mapSize;
+        if (!mapAddress) {
+            qCCritical(KCOREADDONS_DEBUG) << "Unable to allocate shared memory segment for shared data cache" << (file ? file->fileName() : QString())
+                                          << "of size" << size;
             m_mapped = nullptr;
             m_mapSize = 0;
             return;
         }
 
         m_mapSize = size;
+        s_mappingCount.fetch_add(1, std::memory_order_relaxed);
+        s_mappedBytes.fetch_add(size, std::memory_order_relaxed);
 
         // We never actually construct m_mapped, but we assign it the same address as the
         // shared memory we just mapped, so effectively m_mapped is now a SharedMemory that
@@ -293,7 +520,11 @@ private:
                     return;
                 }
             } else {
+#ifdef Q_OS_WIN
+                ::Sleep(usecSleepTime / 1000); // spin
+#else
                 usleep(usecSleepTime); // spin
+#endif
 
                 // Exponential fallback as in Ethernet and similar collision resolution methods
                 usecSleepTime *= 2;
@@ -309,11 +540,23 @@ private:
             detachFromSharedMemory(false);
             return;
         }
+
+#ifdef MADV_WILLNEED
+        // Every lookup goes through the index table, and claiming pages
+        // through the page table, so start reading these in right away
+        // instead of taking page faults scattered all over them later.
+        const quintptr tablesSize = reinterpret_cast<quintptr>(m_mapped->cachePages()) - reinterpret_cast<quintptr>(m_mapped);
+        ::madvise(m_mapped, qMin(quintptr(m_mapSize), tablesSize), MADV_WILLNEED);
+#endif
     }
 
     std::unique_ptr<KSDCLock> m_lock;
     uint m_mapSize;
     SharedLockId m_expectedType;
+#ifndef Q_OS_WIN
+    // The mapped file, -1 for anonymous memory
+    int m_fd = -1;
+#endif
 };
 
 #endif /* KSDCMEMORY_P_H */
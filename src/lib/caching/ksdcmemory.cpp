@@ -11,122 +11,87 @@
 #include "kcoreaddons_debug.h"
 
 #include "ksdcmemory_p.h"
+#include "ktracing_p.h"
 
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QScopeGuard>
+#include <QVarLengthArray>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#endif
 
 //-----------------------------------------------------------------------------
-// MurmurHashAligned, by Austin Appleby
+// MurmurHash64A, by Austin Appleby
 // (Released to the public domain, or licensed under the MIT license where
 // software may not be released to the public domain. See
 // http://sites.google.com/site/murmurhash/)
 
-// Same algorithm as MurmurHash, but only does aligned reads - should be safer
-// on certain platforms.
-static unsigned int MurmurHashAligned(const void *key, int len, unsigned int seed)
+// Consumes 8 bytes per round. Reads go through memcpy, which compiles down to
+// plain (unaligned where supported) loads while staying safe on platforms
+// requiring aligned access.
+static quint64 MurmurHash64A(const void *key, qsizetype len, quint64 seed)
 {
-    const unsigned int m = 0xc6a4a793;
-    const int r = 16;
+    const quint64 m = Q_UINT64_C(0xc6a4a7935bd1e995);
+    const int r = 47;
 
     const unsigned char *data = reinterpret_cast<const unsigned char *>(key);
+    const unsigned char *end = data + (len & ~qsizetype(7));
 
-    unsigned int h = seed ^ (len * m);
-
-    int align = reinterpret_cast<quintptr>(data) & 3;
-
-    if (align && len >= 4) {
-        // Pre-load the temp registers
-
-        unsigned int t = 0;
-        unsigned int d = 0;
-
-        switch (align) {
-        case 1:
-            t |= data[2] << 16;
-            Q_FALLTHROUGH();
-        case 2:
-            t |= data[1] << 8;
-            Q_FALLTHROUGH();
-        case 3:
-            t |= data[0];
-        }
-
-        t <<= (8 * align);
-
-        data += 4 - align;
-        len -= 4 - align;
-
-        int sl = 8 * (4 - align);
-        int sr = 8 * align;
-
-        // Mix
-
-        while (len >= 4) {
-            d = *reinterpret_cast<const unsigned int *>(data);
-            t = (t >> sr) | (d << sl);
-            h += t;
-            h *= m;
-            h ^= h >> r;
-            t = d;
-
-            data += 4;
-            len -= 4;
-        }
-
-        // Handle leftover data in temp registers
-
-        int pack = len < align ? len : align;
+    quint64 h = seed ^ (quint64(len) * m);
 
-        d = 0;
+    while (data != end) {
+        quint64 k;
+        ::memcpy(&k, data, sizeof(k));
+        k = qFromLittleEndian(k); // Same hash regardless of byte order
 
-        switch (pack) {
-        case 3:
-            d |= data[2] << 16;
-            Q_FALLTHROUGH();
-        case 2:
-            d |= data[1] << 8;
-            Q_FALLTHROUGH();
-        case 1:
-            d |= data[0];
-            Q_FALLTHROUGH();
-        case 0:
-            h += (t >> sr) | (d << sl);
-            h *= m;
-            h ^= h >> r;
-        }
+        k *= m;
+        k ^= k >> r;
+        k *= m;
 
-        data += pack;
-        len -= pack;
-    } else {
-        while (len >= 4) {
-            h += *reinterpret_cast<const unsigned int *>(data);
-            h *= m;
-            h ^= h >> r;
+        h ^= k;
+        h *= m;
 
-            data += 4;
-            len -= 4;
-        }
+        data += 8;
     }
 
-    //----------
-    // Handle tail bytes
-
-    switch (len) {
+    switch (len & 7) {
+    case 7:
+        h ^= quint64(data[6]) << 48;
+        Q_FALLTHROUGH();
+    case 6:
+        h ^= quint64(data[5]) << 40;
+        Q_FALLTHROUGH();
+    case 5:
+        h ^= quint64(data[4]) << 32;
+        Q_FALLTHROUGH();
+    case 4:
+        h ^= quint64(data[3]) << 24;
+        Q_FALLTHROUGH();
     case 3:
-        h += data[2] << 16;
+        h ^= quint64(data[2]) << 16;
         Q_FALLTHROUGH();
     case 2:
-        h += data[1] << 8;
+        h ^= quint64(data[1]) << 8;
         Q_FALLTHROUGH();
     case 1:
-        h += data[0];
+        h ^= quint64(data[0]);
         h *= m;
-        h ^= h >> r;
     };
 
+    h ^= h >> r;
     h *= m;
-    h ^= h >> 10;
-    h *= m;
-    h ^= h >> 17;
+    h ^= h >> r;
 
     return h;
 }
@@ -135,11 +100,14 @@ static unsigned int MurmurHashAligned(const void *key, int len, unsigned int see
  * This is the hash function used for our data to hopefully make the
  * hashing used to place the QByteArrays as efficient as possible.
  */
-quint32 SharedMemory::generateHash(const QByteArray &buffer)
+quint32 SharedMemory::generateHash(QByteArrayView buffer)
 {
-    // The final constant is the "seed" for MurmurHash. Do *not* change it
-    // without incrementing the cache version.
-    return MurmurHashAligned(buffer.data(), buffer.size(), 0xF0F00F0F);
+    // The final constant is the "seed" for MurmurHash. Do *not* change it,
+    // nor the hash function itself, without incrementing the cache version.
+    // For the same reason no CPU-specific hash (e.g. using SSE4.2 CRC32) is
+    // used: every process attached to the cache must agree on the hashes.
+    const quint64 hash = MurmurHash64A(buffer.constData(), buffer.size(), 0xF0F00F0F);
+    return static_cast<quint32>(hash ^ (hash >> 32));
 }
 
 // Alignment concerns become a big deal when we're dealing with shared memory,
@@ -271,6 +239,36 @@ unsigned SharedMemory::cachePageSize() const
     return _pageSize;
 }
 
+void SharedStatistics::reset()
+{
+    hits.storeRelaxed(0);
+    misses.storeRelaxed(0);
+    negativeHits.storeRelaxed(0);
+    filteredMisses.storeRelaxed(0);
+    inserts.storeRelaxed(0);
+    rejections.storeRelaxed(0);
+    evictions.storeRelaxed(0);
+    collisionEvictions.storeRelaxed(0);
+    expirations.storeRelaxed(0);
+    defragmentations.storeRelaxed(0);
+    defragmentationTime.storeRelaxed(0);
+    lockWaitTime.storeRelaxed(0);
+    for (auto &bucket : lockWaitHistogram) {
+        bucket.storeRelaxed(0);
+    }
+}
+
+void SharedStatistics::recordLockWait(quint64 nsecs)
+{
+    lockWaitTime.fetchAndAddRelaxed(nsecs);
+
+    uint bucket = 0;
+    for (quint64 usecs = nsecs / 1000; usecs > 0 && bucket < LOCK_WAIT_BUCKET_COUNT - 1; usecs >>= 1) {
+        ++bucket;
+    }
+    lockWaitHistogram[bucket].fetchAndAddRelaxed(1);
+}
+
 /**
  * This is effectively the class ctor.  But since we're in shared memory,
  * there's a few rules:
@@ -321,6 +319,9 @@ bool SharedMemory::performInitialSetup(uint _cacheSize, uint _pageSize)
     pageSize = _pageSize;
     version = PIXMAP_CACHE_VERSION;
     cacheTimestamp = static_cast<unsigned>(::time(nullptr));
+    invalidations = 0;
+    resizedTo = 0;
+    statistics.reset();
 
     clearInternalTables();
 
@@ -340,6 +341,14 @@ void SharedMemory::clearInternalTables()
         table[i].index = -1;
     }
 
+    // All pages form one big free extent.
+    for (uint i = 0; i < FREE_LIST_COUNT; ++i) {
+        freeListHeads[i] = -1;
+    }
+    if (pageTableSize() > 0) {
+        linkFreeExtent(0, pageTableSize());
+    }
+
     // Setup index tables to be accurate.
     IndexTableEntry *indices = indexTable();
     for (uint i = 0; i < indexTableSize(); ++i) {
@@ -347,16 +356,345 @@ void SharedMemory::clearInternalTables()
         indices[i].useCount = 0;
         indices[i].fileNameHash = 0;
         indices[i].totalItemSize = 0;
+        indices[i].flags = 0;
+        indices[i].expiryTime = 0;
+        indices[i].checksum = 0;
         indices[i].addTime = 0;
         indices[i].lastUsedTime = 0;
+        indices[i].namespaceId = 0;
+        indices[i].pinHolders.storeRelaxed(0);
+    }
+
+    for (auto &cacheNamespace : namespaces) {
+        cacheNamespace.usedPages = 0;
+    }
+
+    // No entries left, so no bits either.
+    QAtomicInteger<quint32> *filter = keyFilter();
+    for (uint i = 0; i < keyFilterWordCount(); ++i) {
+        filter[i].storeRelaxed(0);
+    }
+    keyFilterRemovals = 0;
+
+    QAtomicInteger<quint32> *sketch = frequencySketch();
+    for (uint i = 0; i < frequencySketchWordCount(); ++i) {
+        sketch[i].storeRelaxed(0);
+    }
+    frequencySamples.storeRelaxed(0);
+}
+
+// Returns the bit of a key filter of @p wordCount words to set for the @p n-th
+// hash of @p keyHash, using double hashing to derive the hashes from the one
+// we have.
+static uint keyFilterBit(uint keyHash, uint n, uint wordCount)
+{
+    const uint secondHash = (keyHash * 0x9e3779b1u) | 1;
+    return (keyHash + n * secondHash) % (wordCount * 32);
+}
+
+void SharedMemory::addToKeyFilter(uint keyHash)
+{
+    QAtomicInteger<quint32> *filter = keyFilter();
+    const uint wordCount = keyFilterWordCount();
+    for (uint n = 0; n < KEY_FILTER_HASH_COUNT; ++n) {
+        const uint bit = keyFilterBit(keyHash, n, wordCount);
+        filter[bit / 32].fetchAndOrRelease(1u << (bit % 32));
+    }
+}
+
+bool SharedMemory::keyFilterMayContain(uint keyHash) const
+{
+    const QAtomicInteger<quint32> *filter = keyFilter();
+    const uint wordCount = keyFilterWordCount();
+    for (uint n = 0; n < KEY_FILTER_HASH_COUNT; ++n) {
+        const uint bit = keyFilterBit(keyHash, n, wordCount);
+        if (!(filter[bit / 32].loadAcquire() & (1u << (bit % 32)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SharedMemory::noteKeyFilterRemoval()
+{
+    // Rebuilding takes a pass over the index table, so only do that about
+    // once for every time the table could have been filled.
+    if (++keyFilterRemovals >= qMax(indexTableSize(), keyFilterWordCount())) {
+        rebuildKeyFilter();
+    }
+}
+
+void SharedMemory::rebuildKeyFilter()
+{
+    const uint wordCount = keyFilterWordCount();
+    std::vector<quint32> words(wordCount, 0);
+    const IndexTableEntry *indices = indexTable();
+    for (uint i = 0; i < indexTableSize(); ++i) {
+        if (indices[i].firstPage >= 0) {
+            for (uint n = 0; n < KEY_FILTER_HASH_COUNT; ++n) {
+                const uint bit = keyFilterBit(indices[i].fileNameHash, n, wordCount);
+                words[bit / 32] |= 1u << (bit % 32);
+            }
+        }
+    }
+
+    // Both the old and the new words have the bits of every entry still in
+    // the cache set, so storing them one by one is safe for lookups.
+    QAtomicInteger<quint32> *filter = keyFilter();
+    for (uint i = 0; i < wordCount; ++i) {
+        filter[i].storeRelease(words[i]);
+    }
+    keyFilterRemovals = 0;
+}
+
+// Returns the counter of the frequency sketch to use for the @p n-th hash of
+// @p keyHash, derived like the bits of the key filter but independent of them.
+static uint frequencyCounter(uint keyHash, uint n)
+{
+    const uint secondHash = (keyHash * 0x85ebca6bu) | 1;
+    return (keyHash ^ 0x5bd1e995u) + n * secondHash;
+}
+
+void SharedMemory::recordAccess(uint keyHash)
+{
+    if (evictionPolicy.loadRelaxed() != KSharedDataCache::AdmitFrequentlyUsed) {
+        return;
+    }
+
+    QAtomicInteger<quint32> *sketch = frequencySketch();
+    const uint wordCount = frequencySketchWordCount();
+    for (uint n = 0; n < FREQUENCY_SKETCH_HASH_COUNT; ++n) {
+        const uint counter = frequencyCounter(keyHash, n) % (wordCount * 8);
+        const uint shift = (counter % 8) * 4;
+        QAtomicInteger<quint32> &word = sketch[counter / 8];
+
+        // The counters saturate at 15.
+        quint32 value = word.loadRelaxed();
+        while (((value >> shift) & 0xf) < 0xf && !word.testAndSetRelaxed(value, value + (1u << shift), value)) { }
+    }
+
+    // Only the process that reaches the sample size ages the counters.
+    const uint sampleSize = frequencySampleSize();
+    if (frequencySamples.fetchAndAddRelaxed(1) + 1 == sampleSize) {
+        for (uint i = 0; i < wordCount; ++i) {
+            QAtomicInteger<quint32> &word = sketch[i];
+            quint32 value = word.loadRelaxed();
+            while (!word.testAndSetRelaxed(value, (value >> 1) & 0x77777777u, value)) { }
+        }
+        frequencySamples.fetchAndSubRelaxed(sampleSize / 2);
+    }
+}
+
+uint SharedMemory::estimateFrequency(uint keyHash) const
+{
+    const QAtomicInteger<quint32> *sketch = frequencySketch();
+    const uint wordCount = frequencySketchWordCount();
+    uint frequency = 0xf;
+    for (uint n = 0; n < FREQUENCY_SKETCH_HASH_COUNT; ++n) {
+        const uint counter = frequencyCounter(keyHash, n) % (wordCount * 8);
+        frequency = qMin(frequency, (sketch[counter / 8].loadRelaxed() >> ((counter % 8) * 4)) & 0xf);
+    }
+    return frequency;
+}
+
+uint SharedMemory::frequencySampleSize() const
+{
+    // About ten uses per entry the cache can hold, as suggested for TinyLFU.
+    return qMax(10 * indexTableSize(), 1024u);
+}
+
+quint64 SharedMemory::generationOf(uint keyHash) const
+{
+    return (quint64(cacheGeneration.loadAcquire()) << 32) | keyGenerations()[keyHash % keyGenerationCount()].loadAcquire();
+}
+
+void SharedMemory::bumpGeneration(uint keyHash)
+{
+    keyGenerations()[keyHash % keyGenerationCount()].fetchAndAddRelease(1);
+}
+
+uint SharedMemory::findNamespace(quint32 nameHash) const
+{
+    for (uint i = 0; i < NAMESPACE_COUNT; ++i) {
+        if (namespaces[i].nameHash.loadAcquire() == nameHash) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+uint SharedMemory::registerNamespace(quint32 nameHash, uint quota)
+{
+    if (const uint namespaceId = findNamespace(nameHash)) {
+        return namespaceId;
+    }
+
+    for (uint i = 0; i < NAMESPACE_COUNT; ++i) {
+        SharedNamespace &cacheNamespace = namespaces[i];
+        if (cacheNamespace.nameHash.loadRelaxed() == 0) {
+            cacheNamespace.quota = quota;
+            cacheNamespace.usedPages = 0;
+            cacheNamespace.hits.storeRelaxed(0);
+            cacheNamespace.misses.storeRelaxed(0);
+            cacheNamespace.inserts.storeRelaxed(0);
+            cacheNamespace.evictions.storeRelaxed(0);
+            cacheNamespace.nameHash.storeRelease(nameHash);
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool SharedMemory::makeNamespaceRoom(uint namespaceId, uint pagesNeeded)
+{
+    SharedNamespace &cacheNamespace = namespaces[namespaceId - 1];
+    if (cacheNamespace.quota == 0) {
+        return true;
+    }
+
+    const uint quotaPages = cacheNamespace.quota / cachePageSize();
+    if (pagesNeeded > quotaPages) {
+        return false;
+    }
+    if (cacheNamespace.usedPages + pagesNeeded <= quotaPages) {
+        return true;
+    }
+
+    // Only the entries of the namespace compete for its quota, so look at
+    // all of them instead of sampling the whole index table.
+    std::vector<IndexTableEntry> candidates;
+    const IndexTableEntry *indices = indexTable();
+    for (uint i = 0; i < indexTableSize(); ++i) {
+        if (indices[i].firstPage >= 0 && indices[i].namespaceId == namespaceId && indices[i].pinHolders.loadRelaxed() == 0) {
+            candidates.push_back(indices[i]);
+        }
+    }
+
+    const time_t now = ::time(nullptr);
+    std::sort(candidates.begin(), candidates.end(), [now](const IndexTableEntry &l, const IndexTableEntry &r) {
+        if (l.isExpired(now) != r.isExpired(now)) {
+            return l.isExpired(now);
+        }
+        return lruCompare(l, r);
+    });
+
+    for (const IndexTableEntry &candidate : candidates) {
+        const qint32 index = findEntryByHash(candidate.fileNameHash);
+        if (index < 0) {
+            continue;
+        }
+
+        removeEntry(index);
+        if (candidate.isExpired(now)) {
+            statistics.expirations.fetchAndAddRelaxed(1);
+        } else {
+            statistics.evictions.fetchAndAddRelaxed(1);
+            cacheNamespace.evictions.fetchAndAddRelaxed(1);
+        }
+
+        if (cacheNamespace.usedPages + pagesNeeded <= quotaPages) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void SharedMemory::removeNamespaceEntries(uint namespaceId)
+{
+    IndexTableEntry *indices = indexTable();
+    uint i = 0;
+    while (i < indexTableSize()) {
+        // Removing shifts the following entries into this slot, so look again.
+        if (indices[i].firstPage >= 0 && indices[i].namespaceId == namespaceId && indices[i].pinHolders.loadRelaxed() == 0) {
+            bumpGeneration(indices[i].fileNameHash);
+            removeEntry(i);
+        } else {
+            ++i;
+        }
+    }
+    invalidations.fetchAndAddRelease(1);
+}
+
+void SharedMemory::noteNamespaceRemoval(const IndexTableEntry &entry)
+{
+    if (entry.namespaceId > 0 && entry.namespaceId <= NAMESPACE_COUNT) {
+        SharedNamespace &cacheNamespace = namespaces[entry.namespaceId - 1];
+        cacheNamespace.usedPages -= qMin(cacheNamespace.usedPages, intCeil(entry.totalItemSize, cachePageSize()));
     }
 }
 
+// Returns the number of words of a table with one word for every
+// @p entriesPerWord entries of an index table of @p indexTableSize entries,
+// within MIN_TABLE_WORD_COUNT and @p maximumWords.
+static uint tableWordCount(uint indexTableSize, uint entriesPerWord, uint maximumWords)
+{
+    return qBound(uint(SharedMemory::MIN_TABLE_WORD_COUNT), SharedMemory::intCeil(indexTableSize, entriesPerWord), maximumWords);
+}
+
+// Sixteen bits for every entry keep the false positive rate of the key filter
+// around 0.5%, and two counters for every entry in the sketch suffice to tell
+// the popular entries from the rest.
+static uint keyFilterWordCount(uint indexTableSize)
+{
+    return tableWordCount(indexTableSize, 2, SharedMemory::KEY_FILTER_WORD_COUNT);
+}
+
+static uint frequencySketchWordCount(uint indexTableSize)
+{
+    return tableWordCount(indexTableSize, 4, SharedMemory::FREQUENCY_SKETCH_WORD_COUNT);
+}
+
+static uint keyGenerationCount(uint indexTableSize)
+{
+    return tableWordCount(indexTableSize, 2, SharedMemory::KEY_GENERATION_COUNT);
+}
+
+// Returns the size of the key filter, frequency sketch and key generations
+// stored between the header and the index table, in words.
+static uint auxiliaryWordCount(uint indexTableSize)
+{
+    return keyFilterWordCount(indexTableSize) + frequencySketchWordCount(indexTableSize) + keyGenerationCount(indexTableSize);
+}
+
+uint SharedMemory::keyFilterWordCount() const
+{
+    return ::keyFilterWordCount(indexTableSize());
+}
+
+uint SharedMemory::frequencySketchWordCount() const
+{
+    return ::frequencySketchWordCount(indexTableSize());
+}
+
+uint SharedMemory::keyGenerationCount() const
+{
+    return ::keyGenerationCount(indexTableSize());
+}
+
+const QAtomicInteger<quint32> *SharedMemory::keyFilter() const
+{
+    // The key filter goes immediately after this struct, followed by the
+    // frequency sketch and the key generations, which are all sized from the
+    // index table so that small caches don't pay for the tables of big ones.
+    return offsetAs<QAtomicInteger<quint32>>(this, sizeof(*this));
+}
+
+const QAtomicInteger<quint32> *SharedMemory::frequencySketch() const
+{
+    return keyFilter() + keyFilterWordCount();
+}
+
+const QAtomicInteger<quint32> *SharedMemory::keyGenerations() const
+{
+    return frequencySketch() + frequencySketchWordCount();
+}
+
 const IndexTableEntry *SharedMemory::indexTable() const
 {
-    // Index Table goes immediately after this struct, at the first byte
-    // where alignment constraints are met (accounted for by offsetAs).
-    return offsetAs<IndexTableEntry>(this, sizeof(*this));
+    // Index Table goes immediately after the key generations, at the first
+    // byte where alignment constraints are met.
+    return alignTo<IndexTableEntry>(keyGenerations() + keyGenerationCount());
 }
 
 const PageTableEntry *SharedMemory::pageTable() const
@@ -394,6 +732,24 @@ const void *SharedMemory::page(pageID at) const
 // above.  They use const_cast<> because I feel that is better than
 // duplicating the code.  I suppose template member functions (?)
 // may work, may investigate later.
+QAtomicInteger<quint32> *SharedMemory::keyFilter()
+{
+    const SharedMemory *that = const_cast<const SharedMemory *>(this);
+    return const_cast<QAtomicInteger<quint32> *>(that->keyFilter());
+}
+
+QAtomicInteger<quint32> *SharedMemory::frequencySketch()
+{
+    const SharedMemory *that = const_cast<const SharedMemory *>(this);
+    return const_cast<QAtomicInteger<quint32> *>(that->frequencySketch());
+}
+
+QAtomicInteger<quint32> *SharedMemory::keyGenerations()
+{
+    const SharedMemory *that = const_cast<const SharedMemory *>(this);
+    return const_cast<QAtomicInteger<quint32> *>(that->keyGenerations());
+}
+
 IndexTableEntry *SharedMemory::indexTable()
 {
     const SharedMemory *that = const_cast<const SharedMemory *>(this);
@@ -430,39 +786,224 @@ uint SharedMemory::indexTableSize() const
     return pageTableSize() / 2;
 }
 
+// Returns the free list holding extents of @p length pages.
+static uint freeListBucket(uint length)
+{
+    uint bucket = 0;
+    while ((length >>= 1) != 0) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+const FreeExtent *SharedMemory::freeExtent(pageID start) const
+{
+    const void *extentPage = page(start);
+    if (Q_UNLIKELY(!extentPage)) {
+        throw KSDCCorrupted();
+    }
+    return reinterpret_cast<const FreeExtent *>(extentPage);
+}
+
+FreeExtent *SharedMemory::freeExtent(pageID start)
+{
+    const SharedMemory *that = const_cast<const SharedMemory *>(this);
+    return const_cast<FreeExtent *>(that->freeExtent(start));
+}
+
+pageID *SharedMemory::freeExtentTail(pageID last)
+{
+    void *extentPage = page(last);
+    if (Q_UNLIKELY(!extentPage)) {
+        throw KSDCCorrupted();
+    }
+    return offsetAs<pageID>(extentPage, sizeof(FreeExtent));
+}
+
+void SharedMemory::linkFreeExtent(pageID start, uint length)
+{
+    if (Q_UNLIKELY(length == 0 || static_cast<uint>(start) + length > pageTableSize())) {
+        throw KSDCCorrupted();
+    }
+
+    const uint bucket = freeListBucket(length);
+    FreeExtent *extent = freeExtent(start);
+    extent->length = length;
+    extent->previous = -1;
+    extent->next = freeListHeads[bucket];
+    if (extent->next >= 0) {
+        freeExtent(extent->next)->previous = start;
+    }
+    freeListHeads[bucket] = start;
+
+    *freeExtentTail(start + length - 1) = start;
+}
+
+void SharedMemory::unlinkFreeExtent(pageID start)
+{
+    const FreeExtent *extent = freeExtent(start);
+    const uint bucket = freeListBucket(extent->length);
+
+    if (extent->previous >= 0) {
+        freeExtent(extent->previous)->next = extent->next;
+    } else if (Q_LIKELY(bucket < FREE_LIST_COUNT && freeListHeads[bucket] == start)) {
+        freeListHeads[bucket] = extent->next;
+    } else {
+        throw KSDCCorrupted();
+    }
+
+    if (extent->next >= 0) {
+        freeExtent(extent->next)->previous = extent->previous;
+    }
+}
+
+void SharedMemory::addFreeExtent(pageID start, uint length)
+{
+    const PageTableEntry *table = pageTable();
+
+    // Merge with the free extent ending right before us, if any...
+    if (start > 0 && table[start - 1].index < 0) {
+        const pageID leftStart = *freeExtentTail(start - 1);
+        if (Q_UNLIKELY(leftStart < 0 || leftStart >= start || freeExtent(leftStart)->length != static_cast<uint>(start - leftStart))) {
+            throw KSDCCorrupted();
+        }
+
+        unlinkFreeExtent(leftStart);
+        length += start - leftStart;
+        start = leftStart;
+    }
+
+    // ...and with the one starting right after us.
+    const uint end = start + length;
+    if (end < pageTableSize() && table[end].index < 0) {
+        const uint rightLength = freeExtent(end)->length;
+        if (Q_UNLIKELY(rightLength == 0 || end + rightLength > pageTableSize())) {
+            throw KSDCCorrupted();
+        }
+
+        unlinkFreeExtent(end);
+        length += rightLength;
+    }
+
+    linkFreeExtent(start, length);
+}
+
+void SharedMemory::rebuildFreeLists()
+{
+    for (uint i = 0; i < FREE_LIST_COUNT; ++i) {
+        freeListHeads[i] = -1;
+    }
+
+    const PageTableEntry *table = pageTable();
+    const pageID idLimit = static_cast<pageID>(pageTableSize());
+    pageID currentPage = 0;
+
+    while (currentPage < idLimit) {
+        if (table[currentPage].index >= 0) {
+            ++currentPage;
+            continue;
+        }
+
+        const pageID start = currentPage;
+        while (currentPage < idLimit && table[currentPage].index < 0) {
+            ++currentPage;
+        }
+        linkFreeExtent(start, currentPage - start);
+    }
+}
+
+void SharedMemory::forEachUnusedRange(const std::function<void(char *begin, char *end)> &release)
+{
+    // The number of steps is limited to guard against loops in a corrupted cache.
+    uint stepsLeft = pageTableSize();
+    for (uint bucket = 0; bucket < FREE_LIST_COUNT; ++bucket) {
+        pageID start = freeListHeads[bucket];
+        while (start >= 0) {
+            if (Q_UNLIKELY(static_cast<uint>(start) >= pageTableSize() || stepsLeft-- == 0)) {
+                throw KSDCCorrupted();
+            }
+
+            const FreeExtent *extent = freeExtent(start);
+            if (Q_UNLIKELY(extent->length == 0 || static_cast<uint>(start) + extent->length > pageTableSize())) {
+                throw KSDCCorrupted();
+            }
+
+            // Up to the tail, which is right after where a FreeExtent would be
+            // in the last page
+            char *begin = static_cast<char *>(page(start)) + sizeof(FreeExtent);
+            char *end = static_cast<char *>(page(start + extent->length - 1)) + sizeof(FreeExtent);
+            if (begin < end) {
+                release(begin, end);
+            }
+            start = extent->next;
+        }
+    }
+}
+
 /**
  * @return the index of the first page, for the set of contiguous
  * pages that can hold @p pagesNeeded PAGES.
  */
 pageID SharedMemory::findEmptyPages(uint pagesNeeded) const
 {
-    if (Q_UNLIKELY(pagesNeeded > pageTableSize())) {
+    if (Q_UNLIKELY(pagesNeeded == 0 || pagesNeeded > pageTableSize())) {
         return pageTableSize();
     }
 
-    // Loop through the page table, find the first empty page, and just
-    // makes sure that there are enough free pages.
-    const PageTableEntry *table = pageTable();
-    uint contiguousPagesFound = 0;
-    pageID base = 0;
-    for (pageID i = 0; i < static_cast<int>(pageTableSize()); ++i) {
-        if (table[i].index < 0) {
-            if (contiguousPagesFound == 0) {
-                base = i;
+    // Every extent in the lists after the first one is long enough, so only
+    // the first list may need to be searched beyond its head. The number of
+    // steps is limited to guard against loops in a corrupted cache.
+    uint stepsLeft = pageTableSize();
+    for (uint bucket = freeListBucket(pagesNeeded); bucket < FREE_LIST_COUNT; ++bucket) {
+        pageID start = freeListHeads[bucket];
+        while (start >= 0) {
+            if (Q_UNLIKELY(static_cast<uint>(start) >= pageTableSize() || stepsLeft-- == 0)) {
+                throw KSDCCorrupted();
             }
-            contiguousPagesFound++;
-        } else {
-            contiguousPagesFound = 0;
-        }
 
-        if (contiguousPagesFound == pagesNeeded) {
-            return base;
+            const FreeExtent *extent = freeExtent(start);
+            if (extent->length >= pagesNeeded) {
+                return start;
+            }
+            start = extent->next;
         }
     }
 
     return pageTableSize();
 }
 
+void SharedMemory::claimPages(pageID firstPage, uint pagesNeeded)
+{
+    const uint length = freeExtent(firstPage)->length;
+    if (Q_UNLIKELY(length < pagesNeeded || static_cast<uint>(firstPage) + length > pageTableSize())) {
+        throw KSDCCorrupted();
+    }
+
+    // Make sure the free list agrees with the page table, we are going to
+    // overwrite these pages.
+    PageTableEntry *table = pageTable();
+    for (uint i = 0; i < length; ++i) {
+        if (Q_UNLIKELY(table[firstPage + i].index >= 0)) {
+            qCCritical(KCOREADDONS_DEBUG) << "Free list of the cache points to used pages, cache is corrupt.";
+            throw KSDCCorrupted();
+        }
+    }
+
+    unlinkFreeExtent(firstPage);
+
+    // The pages only need to be marked as used here, the caller links them
+    // to their actual index entry.
+    for (uint i = 0; i < pagesNeeded; ++i) {
+        table[firstPage + i].index = 0;
+    }
+
+    // The rest of the extent is still free. Its neighbours are used, so no
+    // merging is needed.
+    if (length > pagesNeeded) {
+        linkFreeExtent(firstPage + pagesNeeded, length - pagesNeeded);
+    }
+}
+
 // left < right?
 bool SharedMemory::lruCompare(const IndexTableEntry &l, const IndexTableEntry &r)
 {
@@ -510,21 +1051,35 @@ bool SharedMemory::ageCompare(const IndexTableEntry &l, const IndexTableEntry &r
     return l.addTime < r.addTime;
 }
 
-void SharedMemory::defragment()
+bool SharedMemory::defragment(uint maxPagesMoved)
 {
     if (cacheAvail * cachePageSize() == cacheSize) {
-        return; // That was easy
+        return true; // That was easy
     }
 
+    KTRACE_SCOPE_ARG("KSharedDataCache::defragment", "maxPagesMoved", maxPagesMoved);
     qCDebug(KCOREADDONS_DEBUG) << "Defragmenting the shared cache";
 
+    QElapsedTimer timer;
+    timer.start();
+    const auto recordStatistics = qScopeGuard([this, &timer] {
+        statistics.defragmentations.fetchAndAddRelaxed(1);
+        statistics.defragmentationTime.fetchAndAddRelaxed(timer.nsecsElapsed());
+    });
+
     // Just do a linear scan, and anytime there is free space, swap it
     // with the pages to its right. In order to meet the precondition
     // we need to skip any used pages first.
+    // If we are limited in the number of pages to move then we stop once that
+    // many pages were moved (but only between entries, which must stay
+    // contiguous). Since already compacted pages are skipped quickly, the
+    // next call picks up more or less where we stopped.
+    // Entries pinned by entry views are skipped, their pages must not move.
 
     pageID currentPage = 0;
     pageID idLimit = static_cast<pageID>(pageTableSize());
     PageTableEntry *pages = pageTable();
+    uint pagesMoved = 0;
 
     if (Q_UNLIKELY(!pages || idLimit <= 0)) {
         throw KSDCCorrupted();
@@ -549,12 +1104,27 @@ void SharedMemory::defragment()
             break;
         }
 
+        if (maxPagesMoved > 0 && pagesMoved >= maxPagesMoved) {
+            rebuildFreeLists();
+            return false;
+        }
+
         // Found an entry, move it.
         qint32 affectedIndex = pages[currentPage].index;
         if (Q_UNLIKELY(affectedIndex < 0 || affectedIndex >= idLimit || indexTable()[affectedIndex].firstPage != currentPage)) {
             throw KSDCCorrupted();
         }
 
+        // Pinned entries can't move, so the free pages in front of them are
+        // left behind and compacting starts over right after them.
+        if (indexTable()[affectedIndex].pinHolders.loadRelaxed() != 0) {
+            while (currentPage < idLimit && pages[currentPage].index >= 0) {
+                ++currentPage;
+            }
+            freeSpot = currentPage;
+            continue;
+        }
+
         indexTable()[affectedIndex].firstPage = freeSpot;
 
         // Moving one page at a time guarantees we can use memcpy safely
@@ -574,6 +1144,7 @@ void SharedMemory::defragment()
             pages[currentPage].index = -1;
             ++currentPage;
             ++freeSpot;
+            ++pagesMoved;
 
             // If we've just moved the very last page and it happened to
             // be at the very end of the cache then we're done.
@@ -585,7 +1156,16 @@ void SharedMemory::defragment()
             // our affected entry or not, so detect if we've started moving
             // the data for a different entry and adjust if necessary.
             if (affectedIndex != pages[currentPage].index) {
-                indexTable()[pages[currentPage].index].firstPage = freeSpot;
+                if (pages[currentPage].index >= 0 && maxPagesMoved > 0 && pagesMoved >= maxPagesMoved) {
+                    rebuildFreeLists();
+                    return false;
+                }
+                if (pages[currentPage].index >= 0 && indexTable()[pages[currentPage].index].pinHolders.loadRelaxed() != 0) {
+                    break;
+                }
+                if (pages[currentPage].index >= 0) {
+                    indexTable()[pages[currentPage].index].firstPage = freeSpot;
+                }
             }
             affectedIndex = pages[currentPage].index;
         }
@@ -594,6 +1174,12 @@ void SharedMemory::defragment()
         // cycle repeats. However, currentPage is not the first unused
         // page, freeSpot is, so leave it alone.
     }
+
+    // Moving pages scrambled the free extents, but we just walked the whole
+    // table anyways.
+    rebuildFreeLists();
+
+    return true;
 }
 
 /**
@@ -604,43 +1190,181 @@ void SharedMemory::defragment()
  */
 qint32 SharedMemory::findNamedEntry(const QByteArray &key) const
 {
-    uint keyHash = SharedMemory::generateHash(key);
-    uint position = keyHash % indexTableSize();
-    uint probeNumber = 1; // See insert() for description
+    return findNamedEntry(key, SharedMemory::generateHash(key));
+}
 
-    // Imagine 3 entries A, B, C in this logical probing chain. If B is
-    // later removed then we can't find C either. So, we must keep
-    // searching for probeNumber number of tries (or we find the item,
-    // obviously).
-    while (indexTable()[position].fileNameHash != keyHash && probeNumber < MAX_PROBE_COUNT) {
-        position = (keyHash + (probeNumber + probeNumber * probeNumber) / 2) % indexTableSize();
-        probeNumber++;
+qint32 SharedMemory::findNamedEntry(const QByteArray &key, uint keyHash) const
+{
+    qint32 position = findEntryByHash(keyHash);
+    if (position < 0) {
+        return -1;
     }
 
-    if (indexTable()[position].fileNameHash == keyHash) {
-        pageID firstPage = indexTable()[position].firstPage;
-        if (firstPage < 0 || static_cast<uint>(firstPage) >= pageTableSize()) {
-            return -1;
-        }
+    pageID firstPage = indexTable()[position].firstPage;
+    if (firstPage < 0 || static_cast<uint>(firstPage) >= pageTableSize()) {
+        return -1;
+    }
 
-        const void *resultPage = page(firstPage);
-        if (Q_UNLIKELY(!resultPage)) {
-            throw KSDCCorrupted();
+    const void *resultPage = page(firstPage);
+    if (Q_UNLIKELY(!resultPage)) {
+        throw KSDCCorrupted();
+    }
+
+    const char *utf8FileName = reinterpret_cast<const char *>(resultPage);
+    if (qstrncmp(utf8FileName, key.constData(), cachePageSize()) == 0) {
+        return position;
+    }
+
+    return -1; // Not found, or a different one found.
+}
+
+qint32 SharedMemory::findEntryByHash(uint keyHash) const
+{
+    const IndexTableEntry *indices = indexTable();
+    const uint tableSize = indexTableSize();
+    uint position = keyHash % tableSize;
+
+    for (uint distance = 0; distance < MAX_PROBE_COUNT; ++distance) {
+        const IndexTableEntry &slot = indices[position];
+
+        // Entries are ordered by their distance from home, so had our entry
+        // been present it would have displaced any entry closer to its home
+        // than we are to ours.
+        if (slot.firstPage < 0 || probeDistance(slot.fileNameHash, position) < distance) {
+            return -1;
         }
 
-        const char *utf8FileName = reinterpret_cast<const char *>(resultPage);
-        if (qstrncmp(utf8FileName, key.constData(), cachePageSize()) == 0) {
+        if (slot.fileNameHash == keyHash) {
             return position;
         }
+
+        position = (position + 1) % tableSize;
     }
 
-    return -1; // Not found, or a different one found.
+    return -1;
+}
+
+uint SharedMemory::probeDistance(uint hash, uint position) const
+{
+    const uint tableSize = indexTableSize();
+    return (position + tableSize - hash % tableSize) % tableSize;
+}
+
+void SharedMemory::linkEntryPages(uint position)
+{
+    const IndexTableEntry &entry = indexTable()[position];
+    const uint pageCount = intCeil(entry.totalItemSize, cachePageSize());
+
+    if (Q_UNLIKELY(entry.firstPage < 0 || static_cast<uint>(entry.firstPage) + pageCount > pageTableSize())) {
+        throw KSDCCorrupted();
+    }
+
+    PageTableEntry *table = pageTable();
+    for (uint i = 0; i < pageCount; ++i) {
+        table[entry.firstPage + i].index = position;
+    }
 }
 
-// Function to use with std::unique_ptr in removeUsedPages below...
-void SharedMemory::deleteTable(IndexTableEntry *table)
+void SharedMemory::releaseEntryPages(const IndexTableEntry &entry)
 {
-    delete[] table;
+    const uint pageCount = intCeil(entry.totalItemSize, cachePageSize());
+
+    if (Q_UNLIKELY(entry.firstPage < 0 || static_cast<uint>(entry.firstPage) + pageCount > pageTableSize())) {
+        throw KSDCCorrupted();
+    }
+    noteNamespaceRemoval(entry);
+
+    PageTableEntry *table = pageTable();
+    for (uint i = 0; i < pageCount; ++i) {
+        table[entry.firstPage + i].index = -1;
+    }
+    cacheAvail += pageCount;
+
+    addFreeExtent(entry.firstPage, pageCount);
+}
+
+qint32 SharedMemory::insertIndexEntry(const IndexTableEntry &entry)
+{
+    IndexTableEntry *indices = indexTable();
+    const uint tableSize = indexTableSize();
+    const uint home = entry.fileNameHash % tableSize;
+
+    addToKeyFilter(entry.fileNameHash);
+
+    IndexTableEntry carried = entry;
+    uint position = home;
+    uint distance = 0;
+    uint displacements = 0;
+    uint displacedFrom[MAX_DISPLACEMENT_COUNT];
+    qint32 result = -1;
+
+    while (distance < MAX_PROBE_COUNT) {
+        IndexTableEntry &slot = indices[position];
+
+        if (slot.firstPage < 0) {
+            slot = carried;
+            linkEntryPages(position);
+            return result >= 0 ? result : static_cast<qint32>(position);
+        }
+
+        // Robin hood: take the slot from entries closer to their home than
+        // the entry we are carrying, and carry on with those instead.
+        const uint slotDistance = probeDistance(slot.fileNameHash, position);
+        if (slotDistance < distance) {
+            if (displacements >= MAX_DISPLACEMENT_COUNT) {
+                break;
+            }
+
+            std::swap(slot, carried);
+            linkEntryPages(position);
+            displacedFrom[displacements++] = position;
+            if (result < 0) {
+                result = position;
+            }
+            distance = slotDistance;
+        }
+
+        position = (position + 1) % tableSize;
+        ++distance;
+    }
+
+    if (result < 0) {
+        // Every slot our entry may be in is taken by an entry at least as far
+        // away from home, so the last slot's entry is just as far away from
+        // home as we would be. Replace it, which keeps the table ordered.
+        position = (home + MAX_PROBE_COUNT - 1) % tableSize;
+        if (indices[position].pinHolders.loadRelaxed() != 0) {
+            qCDebug(KCOREADDONS_DEBUG) << "Not evicting pinned cached entry" << position << "from crowded index table";
+            return -1;
+        }
+        qCDebug(KCOREADDONS_DEBUG) << "Evicting cached entry" << position << "from crowded index table";
+
+        const IndexTableEntry evicted = indices[position];
+        indices[position] = carried;
+        linkEntryPages(position);
+        releaseEntryPages(evicted);
+        statistics.collisionEvictions.fetchAndAddRelaxed(1);
+        noteKeyFilterRemoval();
+        return position;
+    }
+
+    // The last entry we displaced did not find a new home within reach. If it
+    // is pinned, put every entry back where it was instead of evicting it.
+    if (carried.pinHolders.loadRelaxed() != 0) {
+        qCDebug(KCOREADDONS_DEBUG) << "Not evicting displaced pinned cached entry from crowded index table";
+        while (displacements > 0) {
+            position = displacedFrom[--displacements];
+            std::swap(indices[position], carried);
+            linkEntryPages(position);
+        }
+        return -1;
+    }
+
+    qCDebug(KCOREADDONS_DEBUG) << "Evicting displaced cached entry from crowded index table";
+    releaseEntryPages(carried);
+    statistics.collisionEvictions.fetchAndAddRelaxed(1);
+    noteKeyFilterRemoval();
+    return result;
 }
 
 /**
@@ -648,12 +1372,14 @@ void SharedMemory::deleteTable(IndexTableEntry *table)
  *
  * @param numberNeeded the number of pages required to fulfill a current request.
  *        This number should be <0 and <= the number of pages in the cache.
+ * @param defragmentBudget If non-zero, the compactions move at most about this
+ *        many pages each, and entries are evicted instead if that isn't enough.
  * @return The identifier of the beginning of a consecutive block of pages able
  *         to fill the request. Returns a value >= pageTableSize() if no such
  *         request can be filled.
  * @internal
  */
-uint SharedMemory::removeUsedPages(uint numberNeeded)
+uint SharedMemory::removeUsedPages(uint numberNeeded, int admitFrequency, bool *rejected, uint defragmentBudget)
 {
     if (numberNeeded == 0) {
         qCCritical(KCOREADDONS_DEBUG) << "Internal error: Asked to remove exactly 0 pages for some reason.";
@@ -675,44 +1401,26 @@ uint SharedMemory::removeUsedPages(uint numberNeeded)
     qCDebug(KCOREADDONS_DEBUG) << "Removing old entries to free up" << numberNeeded << "pages," << cacheAvail << "are already theoretically available.";
 
     if (cacheAvail > 3 * numberNeeded) {
-        defragment();
+        defragment(defragmentBudget);
         uint result = findEmptyPages(numberNeeded);
 
         if (result < pageTableSize()) {
             return result;
         } else {
-            qCCritical(KCOREADDONS_DEBUG) << "Just defragmented a locked cache, but still there"
-                                          << "isn't enough room for the current request.";
+            if (defragmentBudget == 0) {
+                qCCritical(KCOREADDONS_DEBUG) << "Just defragmented a locked cache, but still there"
+                                              << "isn't enough room for the current request.";
+            }
         }
     }
 
-    // At this point we know we'll have to free some space up, so sort our
-    // list of entries by whatever the current criteria are and start
-    // killing expired entries.
-    std::unique_ptr<IndexTableEntry, decltype(deleteTable) *> tablePtr(new IndexTableEntry[indexTableSize()], deleteTable);
-
-    if (!tablePtr) {
-        qCCritical(KCOREADDONS_DEBUG) << "Unable to allocate temporary memory for sorting the cache!";
-        clearInternalTables();
-        throw KSDCCorrupted();
-    }
-
-    // We use tablePtr to ensure the data is destroyed, but do the access
-    // via a helper pointer to allow for array ops.
-    IndexTableEntry *table = tablePtr.get();
-
-    ::memcpy(table, indexTable(), sizeof(IndexTableEntry) * indexTableSize());
-
-    // Our entry ID is simply its index into the
-    // index table, which qSort will rearrange all willy-nilly, so first
-    // we'll save the *real* entry ID into firstPage (which is useless in
-    // our copy of the index table). On the other hand if the entry is not
-    // used then we note that with -1.
-    for (uint i = 0; i < indexTableSize(); ++i) {
-        table[i].firstPage = table[i].useCount > 0 ? static_cast<pageID>(i) : -1;
-    }
-
-    // Declare the comparison function that we'll use to pass to qSort,
+    // At this point we know we'll have to free some space up. Instead of
+    // sorting the whole index table by the current criteria, approximate the
+    // eviction order by sampling: every eviction looks at a few randomly
+    // picked entries, merges them with the best candidates left over from
+    // the previous evictions and removes the best one of those. This keeps
+    // the work proportional to the number of evicted entries.
+    // Declare the comparison function that we'll use to rank the candidates,
     // based on our cache eviction policy.
     bool (*compareFunction)(const IndexTableEntry &, const IndexTableEntry &);
     switch (evictionPolicy.loadRelaxed()) {
@@ -723,6 +1431,7 @@ uint SharedMemory::removeUsedPages(uint numberNeeded)
         break;
 
     case KSharedDataCache::EvictLeastRecentlyUsed:
+    case KSharedDataCache::AdmitFrequentlyUsed:
         compareFunction = lruCompare;
         break;
 
@@ -731,49 +1440,124 @@ uint SharedMemory::removeUsedPages(uint numberNeeded)
         break;
     }
 
-    std::sort(table, table + indexTableSize(), compareFunction);
+    // Copies of the candidate entries. Removing entries shifts their
+    // neighbours in the index table, so candidates are looked up again by
+    // hash before being removed.
+    QVarLengthArray<IndexTableEntry, 2 * EVICTION_SAMPLE_COUNT> candidates;
+
+    bool notAdmitted = false;
+    if (rejected) {
+        *rejected = false;
+    }
+
+    // Returns false if there is nothing left to remove, or if the best
+    // candidate is used too often to make room for an entry that is not.
+    auto removeCandidate = [&]() -> bool {
+        const IndexTableEntry *indices = indexTable();
+        const uint tableSize = indexTableSize();
+
+        for (uint sample = 0; sample < EVICTION_SAMPLE_COUNT; ++sample) {
+            uint position = QRandomGenerator::global()->bounded(tableSize);
+            uint probes = 0;
+            while ((indices[position].firstPage < 0 || indices[position].pinHolders.loadRelaxed() != 0) && probes < tableSize) {
+                position = (position + 1) % tableSize;
+                ++probes;
+            }
+
+            if (probes == tableSize) {
+                break; // No unpinned entries at all
+            }
+
+            const uint hash = indices[position].fileNameHash;
+            const bool known = std::any_of(candidates.cbegin(), candidates.cend(), [hash](const IndexTableEntry &candidate) {
+                return candidate.fileNameHash == hash;
+            });
+            if (!known) {
+                candidates.append(indices[position]);
+            }
+        }
+
+        // Expired entries go first, regardless of the eviction policy.
+        const time_t now = ::time(nullptr);
+        std::sort(candidates.begin(), candidates.end(), [compareFunction, now](const IndexTableEntry &l, const IndexTableEntry &r) {
+            if (l.isExpired(now) != r.isExpired(now)) {
+                return l.isExpired(now);
+            }
+            return compareFunction(l, r);
+        });
+
+        while (!candidates.isEmpty()) {
+            const qint32 curIndex = findEntryByHash(candidates.front().fileNameHash);
+            candidates.erase(candidates.begin());
+
+            // Already evicted in the meantime, try the next one instead.
+            if (curIndex < 0) {
+                continue;
+            }
+
+            const IndexTableEntry &victim = indexTable()[curIndex];
+            if (admitFrequency >= 0 && !victim.isExpired(now) && estimateFrequency(victim.fileNameHash) >= uint(admitFrequency)) {
+                qCDebug(KCOREADDONS_DEBUG) << "Not admitting an entry used less often than the entries it would replace";
+                notAdmitted = true;
+                return false;
+            }
+
+            qCDebug(KCOREADDONS_DEBUG) << "Removing entry of" << indexTable()[curIndex].totalItemSize << "size";
+            const bool expired = indexTable()[curIndex].isExpired(now);
+            const uint namespaceId = indexTable()[curIndex].namespaceId;
+            removeEntry(curIndex);
+            (expired ? statistics.expirations : statistics.evictions).fetchAndAddRelaxed(1);
+            if (!expired && namespaceId > 0 && namespaceId <= NAMESPACE_COUNT) {
+                namespaces[namespaceId - 1].evictions.fetchAndAddRelaxed(1);
+            }
+
+            if (candidates.size() > qsizetype(EVICTION_SAMPLE_COUNT)) {
+                candidates.resize(EVICTION_SAMPLE_COUNT);
+            }
+            return true;
+        }
 
-    // Least recently used entries will be in the front.
-    // Start killing until we have room.
+        return false;
+    };
 
-    // Note on removeEntry: It expects an index into the index table,
-    // but our sorted list is all jumbled. But we stored the real index
-    // in the firstPage member.
     // Remove entries until we've removed at least the required number
     // of pages.
-    uint i = 0;
-    while (i < indexTableSize() && numberNeeded > cacheAvail) {
-        int curIndex = table[i++].firstPage; // Really an index, not a page
-
-        // Removed everything, still no luck (or curIndex is set but too high).
-        if (curIndex < 0 || static_cast<uint>(curIndex) >= indexTableSize()) {
-            qCCritical(KCOREADDONS_DEBUG) << "Trying to remove index" << curIndex << "out-of-bounds for index table of size" << indexTableSize();
+    while (numberNeeded > cacheAvail) {
+        // Removed everything, still no luck.
+        if (!removeCandidate()) {
+            if (notAdmitted) {
+                if (rejected) {
+                    *rejected = true;
+                }
+                return pageTableSize();
+            }
+            if (pinnedEntryCount() > 0) {
+                qCDebug(KCOREADDONS_DEBUG) << "Only pinned entries are left, but still only" << cacheAvail << "of" << numberNeeded << "pages are available";
+                return pageTableSize();
+            }
+            qCCritical(KCOREADDONS_DEBUG) << "Removed all entries, but still only" << cacheAvail << "of" << numberNeeded << "pages are available";
             throw KSDCCorrupted();
         }
-
-        qCDebug(KCOREADDONS_DEBUG) << "Removing entry of" << indexTable()[curIndex].totalItemSize << "size";
-        removeEntry(curIndex);
     }
 
     // At this point let's see if we have freed up enough data by
-    // defragmenting first and seeing if we can find that free space.
-    defragment();
+    // defragmenting first and seeing if we can find that free space. With a
+    // budget that may not be enough, in which case more entries are evicted.
+    defragment(defragmentBudget);
 
     pageID result = pageTableSize();
-    while (i < indexTableSize() && (static_cast<uint>(result = findEmptyPages(numberNeeded))) >= pageTableSize()) {
-        int curIndex = table[i++].firstPage;
-
-        if (curIndex < 0) {
+    while ((static_cast<uint>(result = findEmptyPages(numberNeeded))) >= pageTableSize()) {
+        if (!removeCandidate()) {
+            if (notAdmitted) {
+                if (rejected) {
+                    *rejected = true;
+                }
+                return pageTableSize();
+            }
             // One last shot.
-            defragment();
+            defragment(defragmentBudget);
             return findEmptyPages(numberNeeded);
         }
-
-        if (Q_UNLIKELY(static_cast<uint>(curIndex) >= indexTableSize())) {
-            throw KSDCCorrupted();
-        }
-
-        removeEntry(curIndex);
     }
 
     // Whew.
@@ -789,8 +1573,10 @@ uint SharedMemory::totalSize(uint cacheSize, uint effectivePageSize)
     // Knowing the number of pages, we can determine what addresses we'd be
     // using (properly aligned), and from there determine how much memory
     // we'd use.
-    IndexTableEntry *indexTableStart = offsetAs<IndexTableEntry>(static_cast<void *>(nullptr), sizeof(SharedMemory));
+    QAtomicInteger<quint32> *auxiliaryStart = offsetAs<QAtomicInteger<quint32>>(static_cast<void *>(nullptr), sizeof(SharedMemory));
+    auxiliaryStart += auxiliaryWordCount(indexTableSize);
 
+    IndexTableEntry *indexTableStart = alignTo<IndexTableEntry>(auxiliaryStart);
     indexTableStart += indexTableSize;
 
     PageTableEntry *pageTableStart = reinterpret_cast<PageTableEntry *>(indexTableStart);
@@ -816,7 +1602,100 @@ uint SharedMemory::fileNameHash(const QByteArray &utf8FileName) const
 
 void SharedMemory::clear()
 {
-    clearInternalTables();
+    if (pinnedEntryCount() == 0) {
+        clearInternalTables();
+    } else {
+        // The entry views of the pinned entries still read their pages.
+        IndexTableEntry *indices = indexTable();
+        uint i = 0;
+        while (i < indexTableSize()) {
+            // Removing shifts the following entries into this slot, so look again.
+            if (indices[i].firstPage >= 0 && indices[i].pinHolders.loadRelaxed() == 0) {
+                removeEntry(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+    invalidations.fetchAndAddRelease(1);
+    cacheGeneration.fetchAndAddRelease(1);
+}
+
+uint SharedMemory::pinnedEntryCount() const
+{
+    const IndexTableEntry *indices = indexTable();
+    uint count = 0;
+    for (uint i = 0; i < indexTableSize(); ++i) {
+        if (indices[i].firstPage >= 0 && indices[i].pinHolders.loadRelaxed() != 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// Returns false if the process @p pid is known to be gone.
+static bool isProcessAlive(quint32 pid)
+{
+#ifdef Q_OS_WIN
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!process) {
+        return GetLastError() != ERROR_INVALID_PARAMETER;
+    }
+    const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+#else
+    // EPERM means the process exists, just not as ours.
+    return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+#endif
+}
+
+int SharedMemory::claimPinHolder(quint32 pid)
+{
+    for (uint i = 0; i < PIN_HOLDER_COUNT; ++i) {
+        if (pinHolderPids[i].testAndSetAcquire(0, pid)) {
+            // The previous holder may have failed to unpin its entries, but
+            // can't race with us: the slot was free and we hold the lock.
+            clearPinHolder(i);
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool SharedMemory::hasStalePinHolders() const
+{
+    for (const auto &pid : pinHolderPids) {
+        const quint32 holder = pid.loadAcquire();
+        if (holder != 0 && !isProcessAlive(holder)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint SharedMemory::reclaimStalePins()
+{
+    uint reclaimed = 0;
+    for (uint i = 0; i < PIN_HOLDER_COUNT; ++i) {
+        const quint32 holder = pinHolderPids[i].loadAcquire();
+        if (holder != 0 && !isProcessAlive(holder)) {
+            qCDebug(KCOREADDONS_DEBUG) << "Reclaiming the pinned entries of process" << holder;
+            clearPinHolder(i);
+            pinHolderPids[i].storeRelease(0);
+            ++reclaimed;
+        }
+    }
+    return reclaimed;
+}
+
+void SharedMemory::clearPinHolder(uint slot)
+{
+    IndexTableEntry *indices = indexTable();
+    const quint32 mask = ~(1u << slot);
+    for (uint i = 0; i < indexTableSize(); ++i) {
+        indices[i].pinHolders.fetchAndAndRelaxed(mask);
+    }
 }
 
 // Must be called while the lock is already held!
@@ -869,11 +1748,165 @@ void SharedMemory::removeEntry(uint index)
     }
 #endif
 
+    addFreeExtent(firstPage, entriesToRemove);
+
+    removeIndexSlot(index);
+}
+
+void SharedMemory::removeIndexSlot(uint index, bool linkPages)
+{
+    IndexTableEntry *entriesIndex = indexTable();
+    noteNamespaceRemoval(entriesIndex[index]);
+
     // Update the index
     entriesIndex[index].fileNameHash = 0;
     entriesIndex[index].totalItemSize = 0;
+    entriesIndex[index].flags = 0;
+    entriesIndex[index].expiryTime = 0;
+    entriesIndex[index].checksum = 0;
     entriesIndex[index].useCount = 0;
     entriesIndex[index].lastUsedTime = 0;
     entriesIndex[index].addTime = 0;
     entriesIndex[index].firstPage = -1;
+    entriesIndex[index].namespaceId = 0;
+    entriesIndex[index].pinHolders.storeRelaxed(0);
+
+    // Shift the following entries back towards their home slot, so that
+    // lookups never need to skip over the hole we just made.
+    uint hole = index;
+    uint next = (hole + 1) % indexTableSize();
+    while (entriesIndex[next].firstPage >= 0 && probeDistance(entriesIndex[next].fileNameHash, next) > 0) {
+        entriesIndex[hole] = entriesIndex[next];
+        if (linkPages) {
+            linkEntryPages(hole);
+        }
+
+        entriesIndex[next].fileNameHash = 0;
+        entriesIndex[next].totalItemSize = 0;
+        entriesIndex[next].flags = 0;
+        entriesIndex[next].expiryTime = 0;
+        entriesIndex[next].checksum = 0;
+        entriesIndex[next].useCount = 0;
+        entriesIndex[next].lastUsedTime = 0;
+        entriesIndex[next].addTime = 0;
+        entriesIndex[next].firstPage = -1;
+        entriesIndex[next].namespaceId = 0;
+        entriesIndex[next].pinHolders.storeRelaxed(0);
+
+        hole = next;
+        next = (next + 1) % indexTableSize();
+    }
+
+    noteKeyFilterRemoval();
+}
+
+bool SharedMemory::isEntryIntact(uint position, const std::vector<bool> &claimedPages) const
+{
+    const IndexTableEntry &entry = indexTable()[position];
+    const uint pageCount = intCeil(entry.totalItemSize, cachePageSize());
+
+    if (entry.totalItemSize == 0 || static_cast<uint>(entry.firstPage) >= pageTableSize() || pageCount > pageTableSize() - entry.firstPage) {
+        return false;
+    }
+
+    for (uint i = 0; i < pageCount; ++i) {
+        if (claimedPages[entry.firstPage + i]) {
+            return false;
+        }
+    }
+
+    // Entries further away from home than allowed can't be found anyway.
+    if (probeDistance(entry.fileNameHash, position) >= MAX_PROBE_COUNT) {
+        return false;
+    }
+
+    // The key, including its trailing null, must fit and hash correctly.
+    const char *item = static_cast<const char *>(page(entry.firstPage));
+    const char *keyEnd = item ? static_cast<const char *>(::memchr(item, '\0', entry.totalItemSize)) : nullptr;
+    if (!keyEnd) {
+        return false;
+    }
+
+    const QByteArrayView key(item, keyEnd - item);
+    if (generateHash(key) != entry.fileNameHash) {
+        return false;
+    }
+
+    const uint dataOffset = IndexTableEntry::dataOffset(key.size() + 1, entry.flags);
+    if (dataOffset > entry.totalItemSize) {
+        return false;
+    }
+
+    const QByteArrayView data(item + dataOffset, entry.totalItemSize - dataOffset);
+    return generateHash(data) == entry.checksum;
+}
+
+uint SharedMemory::salvage()
+{
+    // Copies of damaged entries may have been taken before the damage was noticed.
+    cacheGeneration.fetchAndAddRelease(1);
+
+    // A process that crashed while holding the lock may have held views too.
+    reclaimStalePins();
+
+    IndexTableEntry *indices = indexTable();
+    const uint tableSize = indexTableSize();
+
+    // Pages belonging to the intact entries found so far. Entries sharing
+    // pages with those are damaged too.
+    std::vector<bool> claimedPages(pageTableSize(), false);
+    uint damagedCount = 0;
+
+    for (uint i = 0; i < tableSize; ++i) {
+        IndexTableEntry &entry = indices[i];
+        if (entry.firstPage < 0) {
+            continue;
+        }
+
+        if (!isEntryIntact(i, claimedPages)) {
+            entry.flags |= IndexTableEntry::Quarantined;
+            ++damagedCount;
+            continue;
+        }
+
+        entry.flags &= ~IndexTableEntry::Quarantined;
+        const uint pageCount = intCeil(entry.totalItemSize, cachePageSize());
+        for (uint page = 0; page < pageCount; ++page) {
+            claimedPages[entry.firstPage + page] = true;
+        }
+    }
+
+    if (damagedCount > 0) {
+        qCWarning(KCOREADDONS_DEBUG) << "Removing" << damagedCount << "damaged entries from the cache";
+
+        // Removing an entry moves the following ones back, possibly moving
+        // another damaged entry into the same slot, so look at it again.
+        uint i = 0;
+        while (i < tableSize) {
+            if (indices[i].firstPage >= 0 && (indices[i].flags & IndexTableEntry::Quarantined)) {
+                removeIndexSlot(i, false);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    // Now rebuild everything else from the remaining entries
+    PageTableEntry *pages = pageTable();
+    for (uint i = 0; i < pageTableSize(); ++i) {
+        pages[i].index = -1;
+    }
+
+    cacheAvail = pageTableSize();
+    for (uint i = 0; i < tableSize; ++i) {
+        if (indices[i].firstPage >= 0) {
+            linkEntryPages(i);
+            cacheAvail -= intCeil(indices[i].totalItemSize, cachePageSize());
+        }
+    }
+
+    rebuildFreeLists();
+    rebuildKeyFilter();
+
+    return damagedCount;
 }
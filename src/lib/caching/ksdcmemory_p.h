@@ -12,6 +12,9 @@
 #include "ksdclock_p.h"
 #include "kshareddatacache.h"
 
+#include <functional>
+#include <vector>
+
 /**
  * A very simple class whose only purpose is to be thrown as an exception from
  * underlying code to indicate that the shared cache is apparently corrupt.
@@ -59,13 +62,25 @@ typedef qint32 pageID;
 //
 // 1. index table, containing a fixed-size list of possible cache entries.
 // Each index entry is of type IndexTableEntry (below), and holds the various
-// accounting data and a pointer to the first page.
+// accounting data and a pointer to the first page. The index table is an open
+// addressing hash table using robin hood hashing: every entry is within
+// MAX_PROBE_COUNT slots of its home slot (hash % size), and entries are kept
+// ordered by their distance from home so that lookups can stop early.
 //
 // 2. page table, which is used to speed up the process of searching for
 // free pages of memory. There is one entry for every page in the page table,
 // and it contains the index of the one entry in the index table actually
 // holding the page (or <0 if the page is free).
 //
+// In addition, every maximal run of free pages ("free extent") is kept in one
+// of several doubly-linked free lists in the header, bucketed by the base-2
+// logarithm of its length, so finding free room does not require scanning the
+// page table. The list links are stored in the free pages themselves (see
+// FreeExtent).
+//
+// The header also holds a Bloom filter of the key hashes of all entries, which
+// lets lookups of keys that are not cached return without taking the lock.
+//
 // The entire segment looks like so:
 // ?════════?═════════════?════════════?═══════?═══════?═══════?═══════?═══?
 // ? Header │ Index Table │ Page Table ? Pages │       │       │       │...?
@@ -76,13 +91,56 @@ typedef qint32 pageID;
 // will be in shared memory.  In addition, no pointers!  To point to something
 // you must use relative offsets since the pointer start addresses will be
 // different in each process.
+//
+// useCount and lastUsedTime are updated by lookups, which may run concurrently
+// while only holding the shared lock. They are purely advisory (used to pick
+// eviction candidates), so lost updates are acceptable.
 struct IndexTableEntry {
+    enum Flag {
+        Compressed = 0x1, ///< The data is compressed using qCompress()
+        Quarantined = 0x2, ///< Found damaged by salvage(), about to be removed
+        Negative = 0x4, ///< Records that the key is known not to exist, holds no data
+        Aligned = 0x8, ///< The data starts at a DataAlignment boundary, see dataOffset()
+    };
+
+    // Alignment of the data of Aligned entries, relative to the start of
+    // their first page (which itself is at least as aligned).
+    static constexpr uint DataAlignment = 64;
+
+    static constexpr uint alignUp(uint size)
+    {
+        return (size + DataAlignment - 1) & ~(DataAlignment - 1);
+    }
+
+    // Offset of the data from the start of the first page of an entry with
+    // the given @p flags, whose key takes @p keyLength bytes including its
+    // trailing null. Entries store the key, then the data, with zero padding
+    // in between for Aligned entries.
+    static constexpr uint dataOffset(uint keyLength, uint flags)
+    {
+        return (flags & Aligned) ? alignUp(keyLength) : keyLength;
+    }
+
     uint fileNameHash;
     uint totalItemSize; // in bytes
     mutable uint useCount;
     time_t addTime;
     mutable time_t lastUsedTime;
     pageID firstPage;
+    uint flags;
+    time_t expiryTime; // 0 if the entry does not expire
+    uint checksum; // generateHash() of the data, without the key
+    uint namespaceId; // 0, or the index in SharedMemory::namespaces + 1
+    // The pin holders (see SharedMemory::pinHolderPids) with
+    // KSharedDataCache::EntryView objects reading the data, one bit each.
+    // Changed while only holding the shared lock. The pages of pinned entries
+    // are neither freed nor moved.
+    QAtomicInteger<quint32> pinHolders;
+
+    bool isExpired(time_t now) const
+    {
+        return expiryTime != 0 && now >= expiryTime;
+    }
 };
 
 // Page table entry
@@ -91,6 +149,56 @@ struct PageTableEntry {
     qint32 index;
 };
 
+// The first page of every free extent starts with this header. The last page
+// of the extent additionally holds the pageID of the first page, right after
+// where the header would be, so that extents can be merged with their
+// neighbours when pages are freed.
+struct FreeExtent {
+    uint length; // in pages
+    pageID previous;
+    pageID next;
+};
+
+// Usage statistics of the cache, see KSharedDataCache::Statistics. Lookups
+// update these while only holding the shared lock, so all of them are atomic.
+struct SharedStatistics {
+    /// The number of buckets of the lock wait time histogram. Bucket 0 counts
+    /// waits under 1 µs, bucket N > 0 waits of [2^(N-1), 2^N) µs and the last
+    /// bucket all longer waits as well.
+    static const uint LOCK_WAIT_BUCKET_COUNT = 16;
+
+    QAtomicInteger<quint64> hits;
+    QAtomicInteger<quint64> misses;
+    QAtomicInteger<quint64> negativeHits;
+    QAtomicInteger<quint64> filteredMisses;
+    QAtomicInteger<quint64> inserts;
+    QAtomicInteger<quint64> rejections;
+    QAtomicInteger<quint64> evictions;
+    QAtomicInteger<quint64> collisionEvictions;
+    QAtomicInteger<quint64> expirations;
+    QAtomicInteger<quint64> defragmentations;
+    QAtomicInteger<quint64> defragmentationTime; // in ns
+    QAtomicInteger<quint64> lockWaitTime; // in ns
+    QAtomicInteger<quint64> lockWaitHistogram[LOCK_WAIT_BUCKET_COUNT];
+
+    void reset();
+
+    // Accounts for waiting @p nsecs to acquire the lock.
+    void recordLockWait(quint64 nsecs);
+};
+
+// A namespace of entries sharing the cache, see KSharedDataCache::Namespace.
+// Lookups update the statistics while only holding the shared lock.
+struct SharedNamespace {
+    QAtomicInteger<quint32> nameHash; // 0 if unused
+    uint quota; // in bytes, 0 for no quota
+    uint usedPages;
+    QAtomicInteger<quint64> hits;
+    QAtomicInteger<quint64> misses;
+    QAtomicInteger<quint64> inserts;
+    QAtomicInteger<quint64> evictions;
+};
+
 // Each individual page contains the cached data. The first page starts off with
 // the utf8-encoded key, a null '\0', and then the data follows immediately
 // from the next byte, possibly crossing consecutive page boundaries to hold
@@ -110,13 +218,50 @@ struct SharedMemory {
      * e.g. the next version bump will be from 4 to 8, then 12, etc.
      */
     enum {
-        PIXMAP_CACHE_VERSION = 12,
+        PIXMAP_CACHE_VERSION = 88,
         MINIMUM_CACHE_SIZE = 4096,
     };
 
-    /// The maximum number of probes to make while searching for a bucket in
-    /// the presence of collisions in the cache index table.
-    static const uint MAX_PROBE_COUNT = 6;
+    /// The number of free lists, free list N holding the free extents with a
+    /// length in [2^N, 2^(N+1)) pages.
+    static const uint FREE_LIST_COUNT = 32;
+
+    /// The maximum distance of an entry in the index table from its home
+    /// slot, and therefore the maximum number of probes a lookup makes.
+    static const uint MAX_PROBE_COUNT = 16;
+
+    /// The maximum number of entries a single insert may displace further
+    /// away from their home slot.
+    static const uint MAX_DISPLACEMENT_COUNT = 8;
+
+    /// The number of entries sampled for every entry removeUsedPages()
+    /// evicts. Higher values approximate the eviction policy more closely.
+    static const uint EVICTION_SAMPLE_COUNT = 8;
+
+    /// The maximum size of the key filter in 32-bit words, and the number of
+    /// its bits set for every key.
+    static const uint KEY_FILTER_WORD_COUNT = 4096;
+    static const uint KEY_FILTER_HASH_COUNT = 3;
+
+    /// The maximum size of the frequency sketch in 32-bit words of eight
+    /// 4-bit counters, and the number of counters incremented for every key.
+    static const uint FREQUENCY_SKETCH_WORD_COUNT = 2048;
+    static const uint FREQUENCY_SKETCH_HASH_COUNT = 4;
+
+    /// The maximum number of generation counters the keys are spread over.
+    static const uint KEY_GENERATION_COUNT = 4096;
+
+    /// The minimum size in 32-bit words of the key filter, the frequency
+    /// sketch and the generation counters, which otherwise grow with the
+    /// index table up to the maximum sizes above.
+    static const uint MIN_TABLE_WORD_COUNT = 16;
+
+    /// The maximum number of namespaces in a cache.
+    static const uint NAMESPACE_COUNT = 32;
+
+    /// The maximum number of KSharedDataCache objects, in any process, that
+    /// have entries pinned at the same time.
+    static const uint PIN_HOLDER_COUNT = 32;
 
     // Note to those who follow me. You should not, under any circumstances, ever
     // re-arrange the following two fields, even if you change the version number
@@ -141,6 +286,42 @@ struct SharedMemory {
     // written to, to allow clients to detect a changed cache quickly.
     QAtomicInt cacheTimestamp;
 
+    // The first page of the first free extent in each free list, or <0.
+    pageID freeListHeads[FREE_LIST_COUNT];
+
+    SharedStatistics statistics;
+
+    // The key filter, see keyFilter(). Removing an entry leaves its bits set,
+    // until keyFilterRemovals grows large enough for rebuildKeyFilter() to be
+    // worth it.
+    uint keyFilterRemovals;
+
+    // Grows whenever entries become invalid, rather than just evicted: when the
+    // cache is cleared, its timestamp changes or an entry is replaced or removed.
+    QAtomicInteger<quint32> invalidations;
+
+    // Set to the new cache size once the cache was resized, meaning that the
+    // resized cache replaced this one on disk and every process should move
+    // over to it. 0 while the cache is in use.
+    QAtomicInteger<quint32> resizedTo;
+
+    // The number of uses counted in the frequency sketch since it was last
+    // aged, see frequencySketch().
+    QAtomicInteger<quint32> frequencySamples;
+
+    // Bumped when clearing or salvaging the cache or changing its timestamp,
+    // see keyGenerations(). Never reset, so that no generation is seen twice.
+    QAtomicInteger<quint32> cacheGeneration;
+
+    // The namespaces registered by any process, which stay registered until
+    // the cache is deleted. Clearing the cache only resets their usage.
+    SharedNamespace namespaces[NAMESPACE_COUNT];
+
+    // The process ids of the KSharedDataCache objects that may pin entries,
+    // or 0 for unused slots. Recorded so that the pins of processes which
+    // crashed while holding views can be reclaimed, see reclaimStalePins().
+    QAtomicInteger<quint32> pinHolderPids[PIN_HOLDER_COUNT];
+
     /**
      * Converts the given average item size into an appropriate page size.
      */
@@ -164,6 +345,28 @@ struct SharedMemory {
     bool performInitialSetup(uint _cacheSize, uint _pageSize);
 
     void clearInternalTables();
+
+    // Bloom filter of the hashes of all entries in the index table, so that
+    // lookups of keys that are not cached can fail without taking the lock.
+    const QAtomicInteger<quint32> *keyFilter() const;
+    QAtomicInteger<quint32> *keyFilter();
+    uint keyFilterWordCount() const;
+
+    // Count-min sketch estimating how often keys were looked up or inserted
+    // recently, for the AdmitFrequentlyUsed eviction policy. All counters are
+    // halved once frequencySamples reaches frequencySampleSize(), so that
+    // keys which were popular a long time ago don't stay favored forever.
+    const QAtomicInteger<quint32> *frequencySketch() const;
+    QAtomicInteger<quint32> *frequencySketch();
+    uint frequencySketchWordCount() const;
+
+    // Generations of the data stored in the cache, so that processes can tell
+    // without taking the lock whether data they copied out is still current.
+    // Storing an entry bumps the counter its key hashes to. Never reset.
+    const QAtomicInteger<quint32> *keyGenerations() const;
+    QAtomicInteger<quint32> *keyGenerations();
+    uint keyGenerationCount() const;
+
     const IndexTableEntry *indexTable() const;
     const PageTableEntry *pageTable() const;
     const void *cachePages() const;
@@ -186,6 +389,31 @@ struct SharedMemory {
      */
     pageID findEmptyPages(uint pagesNeeded) const;
 
+    /**
+     * Marks @p pagesNeeded pages starting at @p firstPage, as returned by
+     * findEmptyPages(), as used. The pages must be linked to their index entry
+     * afterwards using linkEntryPages().
+     */
+    void claimPages(pageID firstPage, uint pagesNeeded);
+
+    // Updates the free lists for the pages [start, start + length) having
+    // been freed in the page table, merging them with neighbouring extents.
+    void addFreeExtent(pageID start, uint length);
+
+    // Recreates all free lists from the page table.
+    void rebuildFreeLists();
+
+    // Calls @p release with the bytes [begin, end) of every free extent that
+    // hold no bookkeeping of the free lists, i.e. all of them but its
+    // FreeExtent and its tail. Their contents may be discarded.
+    void forEachUnusedRange(const std::function<void(char *begin, char *end)> &release);
+
+    const FreeExtent *freeExtent(pageID start) const;
+    FreeExtent *freeExtent(pageID start);
+    pageID *freeExtentTail(pageID last);
+    void linkFreeExtent(pageID start, uint length);
+    void unlinkFreeExtent(pageID start);
+
     // left < right?
     static bool lruCompare(const IndexTableEntry &l, const IndexTableEntry &r);
 
@@ -195,7 +423,16 @@ struct SharedMemory {
     // left < right?
     static bool ageCompare(const IndexTableEntry &l, const IndexTableEntry &r);
 
-    void defragment();
+    /**
+     * Moves the used pages towards the start of the cache so that the free
+     * pages form one contiguous block. The pages of pinned entries stay where
+     * they are, leaving the free pages in front of them behind.
+     *
+     * @param maxPagesMoved If non-zero, stop once at least this many pages
+     *        were moved, to bound the time spent with the cache locked.
+     * @return true if the cache is fully compacted, false if stopped early.
+     */
+    bool defragment(uint maxPagesMoved = 0);
 
     /**
      * Finds the index entry for a given key.
@@ -205,29 +442,162 @@ struct SharedMemory {
      */
     qint32 findNamedEntry(const QByteArray &key) const;
 
-    // Function to use with std::unique_ptr in removeUsedPages below...
-    static void deleteTable(IndexTableEntry *table);
+    /**
+     * Same as above, but uses the precomputed @p keyHash (as returned by
+     * generateHash()) instead of hashing @p key again.
+     */
+    qint32 findNamedEntry(const QByteArray &key, uint keyHash) const;
+
+    /**
+     * Finds the index entry with the given hash, without verifying the key.
+     * @return The index of the entry, or <0 if no such entry is present.
+     */
+    qint32 findEntryByHash(uint keyHash) const;
+
+    /**
+     * Places @p entry in the index table, whose pages must already be
+     * allocated. If the index table is too crowded around the home slot of
+     * @p entry other entries may be evicted to make room.
+     * @return The index in the index table of the newly placed entry, or <0
+     *         if only pinned entries could have been evicted. The index
+     *         table is left unchanged in that case.
+     */
+    qint32 insertIndexEntry(const IndexTableEntry &entry);
+
+    // Returns how far the entry at @p position, hashed to @p hash, is from its
+    // home slot in the index table.
+    uint probeDistance(uint hash, uint position) const;
+
+    // Points the pages of the index entry at @p position back to it.
+    void linkEntryPages(uint position);
+
+    // Marks the pages of @p entry as free, the entry must not be (or no
+    // longer be) in the index table.
+    void releaseEntryPages(const IndexTableEntry &entry);
 
     /**
      * Removes the requested number of pages.
      *
      * @param numberNeeded the number of pages required to fulfill a current request.
      *        This number should be <0 and <= the number of pages in the cache.
+     * @param admitFrequency If not negative, no entry that is not expired and
+     *        was used at least that often according to estimateFrequency() is
+     *        removed. Gives up and sets @p rejected instead.
+     *        Pinned entries are never removed.
+     * @param defragmentBudget If non-zero, the compactions move at most about
+     *        this many pages each, see defragment(), and entries are evicted
+     *        instead if that doesn't make enough contiguous room.
      * @return The identifier of the beginning of a consecutive block of pages able
      *         to fill the request. Returns a value >= pageTableSize() if no such
      *         request can be filled.
      * @internal
      */
-    uint removeUsedPages(uint numberNeeded);
+    uint removeUsedPages(uint numberNeeded, int admitFrequency = -1, bool *rejected = nullptr, uint defragmentBudget = 0);
 
     // Returns the total size required for a given cache size.
     static uint totalSize(uint cacheSize, uint effectivePageSize);
 
     uint fileNameHash(const QByteArray &utf8FileName) const;
+
+    // Removes all entries but the pinned ones.
     void clear();
+
+    // Returns the number of entries that are pinned.
+    uint pinnedEntryCount() const;
+
+    // Claims a pin holder slot for a KSharedDataCache object of the process
+    // @p pid, dropping any pins left behind by its previous holder. Returns
+    // the slot, or -1 if all are taken. The lock must be held, shared
+    // suffices.
+    int claimPinHolder(quint32 pid);
+
+    // Returns whether any pin holder slot belongs to a process that is gone.
+    // May be called without holding the lock.
+    bool hasStalePinHolders() const;
+
+    // Drops the pins of the processes that are gone and frees their pin
+    // holder slots. The lock must be held for writing.
+    // @return The number of pin holders reclaimed.
+    uint reclaimStalePins();
+
+    // Drops the pins of the pin holder @p slot from every entry.
+    void clearPinHolder(uint slot);
     void removeEntry(uint index);
 
-    static quint32 generateHash(const QByteArray &buffer);
+    // Clears the index entry at @p index and moves the entries following it
+    // back towards their home slot, linking their pages to their new slot
+    // if @p linkPages is true. Does not touch the pages of the entry itself.
+    void removeIndexSlot(uint index, bool linkPages = true);
+
+    /**
+     * Checks every entry of the (locked) cache for consistency, removing the
+     * damaged ones, and rebuilds the page table and the free lists from the
+     * remaining entries.
+     *
+     * @return The number of entries removed.
+     */
+    uint salvage();
+
+    // Returns whether the entry at @p position is intact, not using any of
+    // the @p claimedPages.
+    bool isEntryIntact(uint position, const std::vector<bool> &claimedPages) const;
+
+    // Adds the entry hashed to @p keyHash to the key filter.
+    void addToKeyFilter(uint keyHash);
+
+    // Returns false if no entry hashed to @p keyHash is in the cache. May be
+    // called without holding the lock.
+    bool keyFilterMayContain(uint keyHash) const;
+
+    // Accounts for an entry having been removed from the index table,
+    // rebuilding the key filter once enough stale bits accumulated.
+    void noteKeyFilterRemoval();
+
+    // Recreates the key filter from the index table. Lookups running
+    // concurrently never miss an entry that is in the cache all along.
+    void rebuildKeyFilter();
+
+    // Counts a use of the key hashed to @p keyHash in the frequency sketch,
+    // if the AdmitFrequentlyUsed eviction policy is in use. May be called
+    // while only holding the shared lock, or without holding the lock.
+    void recordAccess(uint keyHash);
+
+    // Returns an estimate of how often the key hashed to @p keyHash was used
+    // recently, which may be too high but never too low.
+    uint estimateFrequency(uint keyHash) const;
+
+    // The number of uses after which the frequency sketch is aged.
+    uint frequencySampleSize() const;
+
+    // Returns the generation of the data stored for the key hashed to
+    // @p keyHash. May be called without holding the lock, and must be called
+    // before taking it to read the data.
+    quint64 generationOf(uint keyHash) const;
+
+    // Marks the data stored for the key hashed to @p keyHash as changed. The
+    // lock must be held for writing.
+    void bumpGeneration(uint keyHash);
+
+    // Returns the id of the namespace named by @p nameHash, which is non-zero,
+    // or 0 if it is not registered. May be called without holding the lock.
+    uint findNamespace(quint32 nameHash) const;
+
+    // Like findNamespace(), but registers the namespace with the given
+    // @p quota if needed. Returns 0 if there is no room for it.
+    uint registerNamespace(quint32 nameHash, uint quota);
+
+    // Evicts unpinned entries of the namespace @p namespaceId until
+    // @p pagesNeeded more pages fit into its quota. Returns false if that is
+    // impossible.
+    bool makeNamespaceRoom(uint namespaceId, uint pagesNeeded);
+
+    // Removes all unpinned entries of the namespace @p namespaceId.
+    void removeNamespaceEntries(uint namespaceId);
+
+    // Accounts for @p entry leaving the index table.
+    void noteNamespaceRemoval(const IndexTableEntry &entry);
+
+    static quint32 generateHash(QByteArrayView buffer);
 
     /**
      * @return the smallest integer greater than or equal to (@p a / @p b).
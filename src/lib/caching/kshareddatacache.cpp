@@ -9,16 +9,161 @@
 
 #include "kshareddatacache.h"
 #include "kcoreaddons_debug.h"
+#include "kmemoryfootprint_p.h"
 #include "ksdcmapping_p.h"
 #include "ksdcmemory_p.h"
+#include "ktracing_p.h"
 
 #include "kshareddatacache_p.h" // Various auxiliary support code
 
 #include <QByteArray>
+#include <QByteArrayView>
+#include <QCache>
+#include <QCoreApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QPromise>
 #include <QRandomGenerator>
+#include <QSet>
 #include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// How many entries forEachEntry() copies out with the lock held at once
+static const qsizetype s_forEachBatchSize = 64;
+
+static QString cacheFilePath(const QString &cacheName)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/") + cacheName + QLatin1String(".kcache");
+}
+
+// The inserts queued in write-behind mode, see setWriteBehindLimit(). A
+// zero timer applies them from the event loop of the thread owning the cache,
+// taking whatever accumulated until then as one batch.
+struct WriteBehindQueue {
+    struct Entry {
+        QString key;
+        QByteArray data;
+        unsigned ttl;
+    };
+
+    WriteBehindQueue(KSharedDataCache *cache, uint limit)
+        : maxQueuedBytes(limit)
+    {
+        timer.setSingleShot(true);
+        timer.setInterval(0);
+        QObject::connect(&timer, &QTimer::timeout, &timer, [this, cache]() {
+            apply(cache);
+        });
+    }
+
+    bool enqueue(const QString &key, const QByteArray &data, unsigned ttl)
+    {
+        const qsizetype size = key.size() * qsizetype(sizeof(QChar)) + data.size();
+        if (queuedBytes + size > qsizetype(maxQueuedBytes)) {
+            return false;
+        }
+
+        entries.push_back({key, data, ttl});
+        queuedBytes += size;
+        if (!timer.isActive()) {
+            timer.start();
+        }
+        return true;
+    }
+
+    void apply(KSharedDataCache *cache)
+    {
+        timer.stop();
+
+        std::vector<Entry> batch;
+        batch.swap(entries);
+        queuedBytes = 0;
+
+        // Runs of entries without expiry share one lock, the others are
+        // inserted one by one. Keep the order so the last insert of a key wins.
+        QList<QPair<QString, QByteArray>> run;
+        for (const Entry &entry : batch) {
+            if (entry.ttl == 0) {
+                run.append({entry.key, entry.data});
+                continue;
+            }
+            if (!run.isEmpty()) {
+                cache->insertMany(run);
+                run.clear();
+            }
+            cache->insertImmediately(entry.key, entry.data, entry.ttl);
+        }
+        if (!run.isEmpty()) {
+            cache->insertMany(run);
+        }
+    }
+
+    QTimer timer;
+    std::vector<Entry> entries;
+    qsizetype queuedBytes = 0;
+    uint maxQueuedBytes;
+};
+
+// Decoded copies of the entries found recently, see setFrontCacheSize(). Each
+// copy remembers the generation of the data it was taken from, a copy of an
+// older generation is outdated.
+struct FrontCache {
+    struct Entry {
+        QByteArray data;
+        quint64 generation;
+        time_t expiryTime;
+    };
+
+    explicit FrontCache(uint size)
+        : entries(size)
+    {
+    }
+
+    bool find(const QString &key, quint64 generation, QByteArray *destination)
+    {
+        QMutexLocker locker(&mutex);
+        const Entry *entry = entries.object(key);
+        if (!entry) {
+            return false;
+        }
+
+        if (entry->generation != generation || (entry->expiryTime != 0 && ::time(nullptr) >= entry->expiryTime)) {
+            entries.remove(key);
+            return false;
+        }
+
+        if (destination) {
+            *destination = entry->data;
+        }
+        return true;
+    }
+
+    void insert(const QString &key, const QByteArray &data, quint64 generation, time_t expiryTime)
+    {
+        QMutexLocker locker(&mutex);
+        entries.insert(key, new Entry{data, generation, expiryTime}, key.size() * qsizetype(sizeof(QChar)) + data.size());
+    }
+
+    void clear()
+    {
+        QMutexLocker locker(&mutex);
+        entries.clear();
+    }
+
+    QMutex mutex;
+    QCache<QString, Entry> entries;
+};
 
 // The per-instance private data, such as map size, whether
 // attached or not, pointer to shared memory, etc.
@@ -35,8 +180,129 @@ public:
         createMemoryMapping();
     }
 
+    // Size classes mode, see the KSharedDataCache constructor taking a list of
+    // item sizes. The cache itself maps no memory in that case and forwards
+    // everything to one cache per size class instead.
+    Private(const QString &name, unsigned defaultCacheSize, const QList<unsigned> &expectedItemSizes)
+        : m_cacheName(name)
+        , shm(nullptr)
+        , m_mapping(nullptr)
+        , m_defaultCacheSize(defaultCacheSize)
+        , m_expectedItemSize(0)
+    {
+        QList<unsigned> pageSizes;
+        for (unsigned itemSize : expectedItemSizes) {
+            const unsigned pageSize = SharedMemory::equivalentPageSize(itemSize);
+            if (!pageSizes.contains(pageSize)) {
+                pageSizes.append(pageSize);
+            }
+        }
+        std::sort(pageSizes.begin(), pageSizes.end());
+
+        if (pageSizes.size() <= 1) {
+            m_expectedItemSize = pageSizes.value(0);
+            createMemoryMapping();
+            return;
+        }
+
+        const unsigned classCacheSize = defaultCacheSize / pageSizes.size();
+        for (unsigned pageSize : std::as_const(pageSizes)) {
+            m_sizeClasses.push_back(std::make_unique<KSharedDataCache>(sizeClassCacheName(name, pageSize), classCacheSize, pageSize));
+            m_sizeClassPageSizes.append(pageSize);
+        }
+    }
+
+    static QString sizeClassCacheName(const QString &cacheName, unsigned pageSize)
+    {
+        return cacheName + QLatin1String(".sizeclass") + QString::number(pageSize);
+    }
+
+    bool hasSizeClasses() const
+    {
+        return !m_sizeClasses.empty();
+    }
+
+    // Picks the size class with the largest pages still not exceeding the
+    // item, so at most half of the item's pages can be wasted, or the class
+    // with the smallest pages if the item is smaller than any page.
+    KSharedDataCache *sizeClassFor(uint itemSize) const
+    {
+        std::size_t best = 0;
+        for (std::size_t i = 1; i < m_sizeClasses.size(); ++i) {
+            if (m_sizeClassPageSizes.at(i) <= itemSize) {
+                best = i;
+            }
+        }
+        return m_sizeClasses.at(best).get();
+    }
+
+    static uint requiredSize(const QString &key, const QByteArray &data)
+    {
+        return key.toUtf8().size() + 1 + data.size();
+    }
+
+    // The key stored in the pages of @p entry, with the lock held
+    QByteArrayView storedKey(const IndexTableEntry &entry) const
+    {
+        const char *item = static_cast<const char *>(shm->page(entry.firstPage));
+        if (Q_UNLIKELY(!item)) {
+            throw KSDCCorrupted();
+        }
+        m_mapping->verifyProposedMemoryAccess(item, entry.totalItemSize);
+
+        const char *keyEnd = static_cast<const char *>(::memchr(item, '\0', entry.totalItemSize));
+        if (Q_UNLIKELY(!keyEnd)) {
+            throw KSDCCorrupted();
+        }
+        return QByteArrayView(item, keyEnd - item);
+    }
+
+    // Removes the entries named by @p keys, if present. Returns false if
+    // some of them are pinned by an entry view, and could not be removed;
+    // their keys are added to @p pinnedKeys then, if given.
+    bool removeKeys(const QStringList &keys, QSet<QString> *pinnedKeys = nullptr)
+    {
+        if (keys.isEmpty()) {
+            return true;
+        }
+
+        bool removed = true;
+        try {
+            CacheLocker lock(this);
+            if (lock.failed()) {
+                return true;
+            }
+
+            for (const QString &key : keys) {
+                const qint32 entry = shm->findNamedEntry(key.toUtf8());
+                if (entry >= 0 && shm->indexTable()[entry].pinHolders.loadRelaxed() != 0) {
+                    removed = false;
+                    if (pinnedKeys) {
+                        pinnedKeys->insert(key);
+                    }
+                } else if (entry >= 0) {
+                    shm->removeEntry(entry);
+                    shm->invalidations.fetchAndAddRelease(1);
+                }
+            }
+        } catch (KSDCCorrupted) {
+            recoverCorruptedCache();
+        }
+        return removed;
+    }
+
     void createMemoryMapping()
     {
+        // The generations of the copies are those of the old mapping
+        if (m_frontCache) {
+            m_frontCache->clear();
+        }
+
+        // Entry views point into the old mapping, so it must not go away
+        // while any are alive.
+        Q_ASSERT(m_liveViews.load(std::memory_order_acquire) == 0);
+        releasePinHolder();
+
         shm = nullptr;
         m_mapping.reset();
 
@@ -50,8 +316,7 @@ public:
         cacheSize = qMax(pageSize * 256, cacheSize);
 
         // The m_cacheName is used to find the file to store the cache in.
-        const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
-        QString cacheName = cacheDir + QLatin1String("/") + m_cacheName + QLatin1String(".kcache");
+        QString cacheName = cacheFilePath(m_cacheName);
         QFile file(cacheName);
         QFileInfo fileInfo(file);
         if (!QDir().mkpath(fileInfo.absolutePath())) {
@@ -96,114 +361,242 @@ public:
             m_mapping.reset(new KSDCMapping(nullptr, size, cacheSize, pageSize));
             shm = m_mapping->m_mapped;
         }
+
+        if (m_hugePagesEnabled) {
+            m_mapping->adviseHugePages(true);
+        }
+
+        reclaimStalePins();
     }
 
-    // Called whenever the cache is apparently corrupt (for instance, a timeout trying to
-    // lock the cache). In this situation it is safer just to destroy it all and try again.
-    void recoverCorruptedCache()
+    // Drops the pins left behind by processes that crashed while holding
+    // entry views, which would otherwise keep their entries forever.
+    void reclaimStalePins()
     {
-        qCWarning(KCOREADDONS_DEBUG) << "Deleting corrupted cache" << m_cacheName;
+        if (!shm || !m_mapping || !shm->hasStalePinHolders()) {
+            return;
+        }
 
-        KSharedDataCache::deleteCache(m_cacheName);
+        try {
+            if (!m_mapping->lock()) {
+                return;
+            }
+        } catch (KSDCCorrupted) {
+            return;
+        }
 
-        createMemoryMapping();
+        try {
+            if (m_mapping->isLockedCacheSafe()) {
+                shm->reclaimStalePins();
+            }
+        } catch (KSDCCorrupted) {
+        }
+
+        m_mapping->unlock();
     }
 
-    class CacheLocker
+    // Frees the pin holder slot of this object, once no views are left.
+    void releasePinHolder()
     {
-        mutable Private *d;
-
-        bool cautiousLock()
-        {
-            int lockCount = 0;
+        QMutexLocker locker(&m_pinMutex);
+        if (shm && m_pinHolder >= 0) {
+            shm->pinHolderPids[m_pinHolder].testAndSetRelease(m_pinHolderPid, 0);
+        }
+        m_pinHolder = -1;
+        m_pinnedEntries.clear();
+    }
 
-            // Locking can fail due to a timeout. If it happens too often even though
-            // we're taking corrective action assume there's some disastrous problem
-            // and give up.
-            while (!d->m_mapping->lock() && !d->m_mapping->isLockedCacheSafe()) {
-                d->recoverCorruptedCache();
+    // Moves over to the cache that replaced ours on disk, if any process
+    // resized the cache. Not while entry views still point into our mapping.
+    void reattachIfResized()
+    {
+        for (int hops = 0; hops < 4 && shm && m_liveViews.load(std::memory_order_acquire) == 0; ++hops) {
+            const uint resizedTo = shm->resizedTo.loadAcquire();
+            if (Q_LIKELY(resizedTo == 0)) {
+                return;
+            }
+            qCDebug(KCOREADDONS_DEBUG) << "Cache" << m_cacheName << "was resized to" << resizedTo << "bytes, reattaching";
+            m_defaultCacheSize = resizedTo;
+            createMemoryMapping();
+        }
+    }
 
-                if (!d->m_mapping->isValid()) {
-                    qCWarning(KCOREADDONS_DEBUG) << "Lost the connection to shared memory for cache" << d->m_cacheName;
-                    return false;
+    // Reads in the header, index table and page table of the cache, which
+    // are accessed by every lookup, so the first lookups do not have to wait
+    // for them to be faulted in.
+    void prefault()
+    {
+        if (hasSizeClasses()) {
+            for (const auto &sizeClass : m_sizeClasses) {
+                if (sizeClass->d) {
+                    sizeClass->d->prefault();
                 }
+            }
+            return;
+        }
 
-                if (lockCount++ > 4) {
-                    qCCritical(KCOREADDONS_DEBUG) << "There is a very serious problem with the KDE data cache" << d->m_cacheName
-                                                  << "giving up trying to access cache.";
-                    return false;
-                }
+        try {
+            CacheLocker lock(this, ReadLock);
+            if (lock.failed()) {
+                return;
             }
 
-            return true;
+            // Touching a byte every 4 KiB hits every page at least once.
+            const volatile char *tables = reinterpret_cast<const volatile char *>(shm);
+            const quintptr tablesSize = reinterpret_cast<quintptr>(shm->cachePages()) - reinterpret_cast<quintptr>(shm);
+            char sum = 0;
+            for (quintptr offset = 0; offset < tablesSize; offset += 4096) {
+                sum ^= tables[offset];
+            }
+            Q_UNUSED(sum);
+        } catch (KSDCCorrupted) {
+            recoverCorruptedCache();
         }
+    }
 
-    public:
-        CacheLocker(const Private *_d)
-            : d(const_cast<Private *>(_d))
-        {
-            if (Q_UNLIKELY(!d || !cautiousLock())) {
-                d = nullptr;
+    // Called whenever the cache is apparently corrupt. If the cache can still
+    // be locked only the damaged entries are removed, otherwise it is safer
+    // to just destroy it all and try again.
+    void recoverCorruptedCache()
+    {
+        if (!salvageCache()) {
+            resetCorruptedCache();
+        }
+    }
+
+    // Called whenever the cache can't be recovered (for instance, a timeout
+    // trying to lock the cache) to destroy it all and try again.
+    void resetCorruptedCache()
+    {
+        // The views point into the mapping, which therefore has to stay.
+        if (m_liveViews.load(std::memory_order_acquire) > 0) {
+            qCWarning(KCOREADDONS_DEBUG) << "Not deleting corrupted cache" << m_cacheName << "while entry views are alive";
+            return;
+        }
+
+        qCWarning(KCOREADDONS_DEBUG) << "Deleting corrupted cache" << m_cacheName;
+
+        KSharedDataCache::deleteCache(m_cacheName);
+
+        createMemoryMapping();
+    }
+
+    // Removes the damaged entries of the cache and rebuilds its bookkeeping,
+    // returns false if that failed.
+    bool salvageCache()
+    {
+        // Salvaging frees the pages of damaged entries, which our views may
+        // still be reading.
+        if (!shm || !m_mapping || m_liveViews.load(std::memory_order_acquire) > 0) {
+            return false;
+        }
+
+        try {
+            if (!m_mapping->lock()) {
+                return false;
             }
+        } catch (KSDCCorrupted) {
+            return false;
         }
 
-        ~CacheLocker()
-        {
-            if (d) {
-                d->m_mapping->unlock();
+        bool salvaged = false;
+        try {
+            if (m_mapping->isLockedCacheSafe()) {
+                shm->salvage();
+                salvaged = true;
             }
+        } catch (KSDCCorrupted) {
         }
 
-        CacheLocker(const CacheLocker &) = delete;
-        CacheLocker &operator=(const CacheLocker &) = delete;
+        m_mapping->unlock();
+        return salvaged;
+    }
 
-        bool failed() const
-        {
-            return !d;
+    // Returns @p data compressed if it is at least m_compressionThreshold
+    // bytes large and compressing it actually saves space, setting @p flags
+    // to the IndexTableEntry flags to store the result with.
+    QByteArray encodeData(const QByteArray &data, uint *flags) const
+    {
+        *flags = 0;
+        if (m_compressionThreshold == 0 || uint(data.size()) < m_compressionThreshold) {
+            return data;
         }
-    };
 
-    QString m_cacheName;
-    SharedMemory *shm;
-    std::unique_ptr<KSDCMapping> m_mapping;
-    uint m_defaultCacheSize;
-    uint m_expectedItemSize;
-};
+        QByteArray compressed = qCompress(data, 1);
+        if (compressed.size() >= data.size()) {
+            return data;
+        }
 
-KSharedDataCache::KSharedDataCache(const QString &cacheName, unsigned defaultCacheSize, unsigned expectedItemSize)
-    : d(nullptr)
-{
-    try {
-        d = new Private(cacheName, defaultCacheSize, expectedItemSize);
-    } catch (KSDCCorrupted) {
-        qCCritical(KCOREADDONS_DEBUG) << "Failed to initialize KSharedDataCache!";
-        d = nullptr; // Just in case
+        *flags = IndexTableEntry::Compressed;
+        return compressed;
     }
-}
 
-KSharedDataCache::~KSharedDataCache()
-{
-    if (!d) {
-        return;
+    // Returns the shared bookkeeping of the namespace named by @p nameHash,
+    // or null if it is not registered. Takes no lock.
+    SharedNamespace *findNamespace(quint32 nameHash) const
+    {
+        if (!shm || shm->version != SharedMemory::PIXMAP_CACHE_VERSION) {
+            return nullptr;
+        }
+        const uint namespaceId = shm->findNamespace(nameHash);
+        return namespaceId > 0 ? &shm->namespaces[namespaceId - 1] : nullptr;
     }
 
-    delete d;
-}
+    // Returns a copy of the entry @p data stored with @p flags, decompressing
+    // it if needed. Throws KSDCCorrupted if it cannot be decompressed.
+    static QByteArray decodeData(QByteArrayView data, uint flags)
+    {
+        if (!(flags & IndexTableEntry::Compressed)) {
+            return data.toByteArray();
+        }
 
-bool KSharedDataCache::insert(const QString &key, const QByteArray &data)
-{
-    try {
-        Private::CacheLocker lock(d);
-        if (lock.failed()) {
+        QByteArray result = qUncompress(reinterpret_cast<const uchar *>(data.data()), data.size());
+        if (Q_UNLIKELY(result.isNull())) {
+            throw KSDCCorrupted("Unable to decompress cached entry");
+        }
+        return result;
+    }
+
+    // Inserts @p data into the cache under @p key, @p flags being the
+    // IndexTableEntry flags describing @p data, expiring at @p expiryTime
+    // (0 for never). For Aligned entries @p header is stored in front of
+    // @p data, padded to the alignment. The cache must already be
+    // locked, and @p encodedKey and @p keyHash must be the UTF-8 form of @p key
+    // and its hash as returned by SharedMemory::generateHash(). Throws
+    // KSDCCorrupted if the cache is found to be corrupt.
+    bool insertLocked(const QString &key,
+                      const QByteArray &encodedKey,
+                      uint keyHash,
+                      QByteArrayView data,
+                      uint flags = 0,
+                      time_t expiryTime = 0,
+                      QByteArrayView header = {},
+                      uint namespaceId = 0)
+    {
+        // See if we're overwriting an existing entry. Its pages can't be
+        // replaced while an entry view still reads them.
+        qint32 existing = shm->findEntryByHash(keyHash);
+        if (existing >= 0 && shm->indexTable()[existing].pinHolders.loadRelaxed() != 0) {
+            qCDebug(KCOREADDONS_DEBUG) << "Not overwriting pinned cached entry for" << key;
             return false;
         }
 
-        QByteArray encodedKey = key.toUtf8();
-        uint keyHash = SharedMemory::generateHash(encodedKey);
-        uint position = keyHash % d->shm->indexTableSize();
+        // Copies of the data stored for the key before are outdated now.
+        shm->bumpGeneration(keyHash);
+
+        if (existing >= 0) {
+            qCDebug(KCOREADDONS_DEBUG) << "Overwriting existing cached entry due to collision.";
+            shm->removeEntry(existing); // Remove it first
+            shm->invalidations.fetchAndAddRelease(1);
+        }
 
-        // See if we're overwriting an existing entry.
-        IndexTableEntry *indices = d->shm->indexTable();
+        // New keys only make room for themselves if they are used more often
+        // than the entries they replace, see AdmitFrequentlyUsed.
+        shm->recordAccess(keyHash);
+        int admitFrequency = -1;
+        if (existing < 0 && shm->evictionPolicy.loadRelaxed() == KSharedDataCache::AdmitFrequentlyUsed) {
+            admitFrequency = shm->estimateFrequency(keyHash);
+        }
 
         // In order to avoid the issue of a very long-lived cache having items
         // with a use count of 1 near-permanently, we attempt to artifically
@@ -214,7 +607,7 @@ bool KSharedDataCache::insert(const QString &key, const QByteArray &data)
         const static double mustCullPoint = 0.96l;
 
         // cacheAvail is in pages, cacheSize is in bytes.
-        double loadFactor = 1.0 - (1.0l * d->shm->cacheAvail * d->shm->cachePageSize() / d->shm->cacheSize);
+        double loadFactor = 1.0 - (1.0l * shm->cacheAvail * shm->cachePageSize() / shm->cacheSize);
         bool cullCollisions = false;
 
         if (Q_UNLIKELY(loadFactor >= mustCullPoint)) {
@@ -226,168 +619,1288 @@ bool KSharedDataCache::insert(const QString &key, const QByteArray &data)
             }
         }
 
-        // In case of collisions in the index table (i.e. identical positions), use
-        // quadratic chaining to attempt to find an empty slot. The equation we use
-        // is:
-        // position = (hash + (i + i*i) / 2) % size, where i is the probe number.
-        uint probeNumber = 1;
-        while (indices[position].useCount > 0 && probeNumber < SharedMemory::MAX_PROBE_COUNT) {
-            // If we actually stumbled upon an old version of the key we are
-            // overwriting, then use that position, do not skip over it.
-
-            if (Q_UNLIKELY(indices[position].fileNameHash == keyHash)) {
-                break;
-            }
-
-            // If we are "culling" old entries, see if this one is old and if so
-            // reduce its use count. If it reduces to zero then eliminate it and
-            // use its old spot.
+        // Remove the first expired entry sharing our probe window, if any.
+        // If we are "culling" old entries, also reduce the use count of the
+        // old entries sharing our probe window. If one reduces to zero then
+        // eliminate it. Pinned entries are left alone.
+        {
+            IndexTableEntry *indices = shm->indexTable();
+            const time_t now = ::time(nullptr);
+            uint position = keyHash % shm->indexTableSize();
+            for (uint probeNumber = 0; probeNumber < SharedMemory::MAX_PROBE_COUNT && indices[position].firstPage >= 0; ++probeNumber) {
+                if (indices[position].pinHolders.loadRelaxed() != 0) {
+                    position = (position + 1) % shm->indexTableSize();
+                    continue;
+                }
 
-            if (cullCollisions && (::time(nullptr) - indices[position].lastUsedTime) > 60) {
-                indices[position].useCount >>= 1;
-                if (indices[position].useCount == 0) {
-                    qCDebug(KCOREADDONS_DEBUG) << "Overwriting existing old cached entry due to collision.";
-                    d->shm->removeEntry(position); // Remove it first
+                if (indices[position].isExpired(now)) {
+                    qCDebug(KCOREADDONS_DEBUG) << "Removing expired cached entry due to collision.";
+                    // This shifts the following entries, so stop here.
+                    shm->removeEntry(position);
+                    shm->statistics.expirations.fetchAndAddRelaxed(1);
                     break;
                 }
-            }
-
-            position = (keyHash + (probeNumber + probeNumber * probeNumber) / 2) % d->shm->indexTableSize();
-            probeNumber++;
-        }
 
-        if (indices[position].useCount > 0 && indices[position].firstPage >= 0) {
-            qCDebug(KCOREADDONS_DEBUG) << "Overwriting existing cached entry due to collision.";
-            d->shm->removeEntry(position); // Remove it first
+                if (cullCollisions && (now - indices[position].lastUsedTime) > 60) {
+                    indices[position].useCount >>= 1;
+                    if (indices[position].useCount == 0) {
+                        qCDebug(KCOREADDONS_DEBUG) << "Removing existing old cached entry due to collision.";
+                        // This shifts the following entries, so stop here.
+                        shm->removeEntry(position);
+                        shm->statistics.collisionEvictions.fetchAndAddRelaxed(1);
+                        break;
+                    }
+                }
+                position = (position + 1) % shm->indexTableSize();
+            }
         }
 
         // Data will be stored as fileNamefoo\0PNGimagedata.....
         // So total size required is the length of the encoded file name + 1
         // for the trailing null, and then the length of the image data.
+        // Aligned entries pad the key and the header to the alignment.
         uint fileNameLength = 1 + encodedKey.length();
-        uint requiredSize = fileNameLength + data.size();
-        uint pagesNeeded = SharedMemory::intCeil(requiredSize, d->shm->cachePageSize());
+        const uint dataOffset = IndexTableEntry::dataOffset(fileNameLength, flags);
+        const uint headerLength = (flags & IndexTableEntry::Aligned) ? IndexTableEntry::alignUp(header.size()) : 0;
+        uint requiredSize = dataOffset + headerLength + data.size();
+        uint pagesNeeded = SharedMemory::intCeil(requiredSize, shm->cachePageSize());
         uint firstPage(-1);
 
-        if (pagesNeeded >= d->shm->pageTableSize()) {
+        if (pagesNeeded >= shm->pageTableSize()) {
             qCWarning(KCOREADDONS_DEBUG) << key << "is too large to be cached.";
             return false;
         }
 
+        if (namespaceId != 0 && !shm->makeNamespaceRoom(namespaceId, pagesNeeded)) {
+            qCDebug(KCOREADDONS_DEBUG) << key << "does not fit into the quota of its namespace.";
+            return false;
+        }
+
         // If the cache has no room, or the fragmentation is too great to find
         // the required number of consecutive free pages, take action.
-        if (pagesNeeded > d->shm->cacheAvail || (firstPage = d->shm->findEmptyPages(pagesNeeded)) >= d->shm->pageTableSize()) {
+        if (pagesNeeded > shm->cacheAvail || (firstPage = shm->findEmptyPages(pagesNeeded)) >= shm->pageTableSize()) {
             // If we have enough free space just defragment
             uint freePagesDesired = 3 * qMax(1u, pagesNeeded / 2);
 
-            if (d->shm->cacheAvail > freePagesDesired) {
+            if (shm->cacheAvail > freePagesDesired) {
                 // TODO: How the hell long does this actually take on real
                 // caches?
-                d->shm->defragment();
-                firstPage = d->shm->findEmptyPages(pagesNeeded);
-            } else {
+                m_defragmentPending = !shm->defragment(m_defragmentBudget);
+                firstPage = shm->findEmptyPages(pagesNeeded);
+            }
+
+            // If a bounded defragmentation did not free up enough
+            // contiguous room yet, make room by evicting entries instead.
+            if (firstPage >= shm->pageTableSize()) {
                 // If we already have free pages we don't want to remove a ton
                 // extra. However we can't rely on the return value of
                 // removeUsedPages giving us a good location since we're not
                 // passing in the actual number of pages that we need.
-                d->shm->removeUsedPages(qMin(2 * freePagesDesired, d->shm->pageTableSize()) - d->shm->cacheAvail);
-                firstPage = d->shm->findEmptyPages(pagesNeeded);
+                const uint pagesWanted = qMin(2 * freePagesDesired, shm->pageTableSize());
+                bool rejected = false;
+                shm->removeUsedPages(pagesWanted > shm->cacheAvail ? pagesWanted - shm->cacheAvail : pagesNeeded,
+                                     admitFrequency,
+                                     &rejected,
+                                     m_defragmentBudget);
+                if (rejected) {
+                    shm->statistics.rejections.fetchAndAddRelaxed(1);
+                    return false;
+                }
+                // Its compactions may have stopped early, continue them with the next inserts
+                m_defragmentPending = m_defragmentPending || m_defragmentBudget > 0;
+                firstPage = shm->findEmptyPages(pagesNeeded);
             }
 
-            if (firstPage >= d->shm->pageTableSize() || d->shm->cacheAvail < pagesNeeded) {
+            if (firstPage >= shm->pageTableSize() || shm->cacheAvail < pagesNeeded) {
                 qCCritical(KCOREADDONS_DEBUG) << "Unable to free up memory for" << key;
                 return false;
             }
         }
 
-        // Update page table
-        PageTableEntry *table = d->shm->pageTable();
-        for (uint i = 0; i < pagesNeeded; ++i) {
-            table[firstPage + i].index = position;
+        // Update index, this also links the pages to the entry.
+        IndexTableEntry entry;
+        entry.fileNameHash = keyHash;
+        entry.totalItemSize = requiredSize;
+        entry.useCount = 1;
+        entry.addTime = ::time(nullptr);
+        entry.lastUsedTime = entry.addTime;
+        entry.firstPage = firstPage;
+        entry.flags = flags;
+        entry.expiryTime = expiryTime;
+        entry.namespaceId = namespaceId;
+
+        // Update cache. Must happen before placing the entry since that might
+        // evict other entries, giving back their pages.
+        shm->cacheAvail -= pagesNeeded;
+        shm->claimPages(firstPage, pagesNeeded);
+        if (namespaceId != 0) {
+            shm->namespaces[namespaceId - 1].usedPages += pagesNeeded;
         }
 
-        // Update index
-        indices[position].fileNameHash = keyHash;
-        indices[position].totalItemSize = requiredSize;
-        indices[position].useCount = 1;
-        indices[position].addTime = ::time(nullptr);
-        indices[position].lastUsedTime = indices[position].addTime;
-        indices[position].firstPage = firstPage;
-
-        // Update cache
-        d->shm->cacheAvail -= pagesNeeded;
-
         // Actually move the data in place
-        void *dataPage = d->shm->page(firstPage);
+        void *dataPage = shm->page(firstPage);
         if (Q_UNLIKELY(!dataPage)) {
             throw KSDCCorrupted();
         }
 
         // Verify it will all fit
-        d->m_mapping->verifyProposedMemoryAccess(dataPage, requiredSize);
+        m_mapping->verifyProposedMemoryAccess(dataPage, requiredSize);
 
         // Cast for byte-sized pointer arithmetic
         uchar *startOfPageData = reinterpret_cast<uchar *>(dataPage);
         ::memcpy(startOfPageData, encodedKey.constData(), fileNameLength);
-        ::memcpy(startOfPageData + fileNameLength, data.constData(), data.size());
-
-        return true;
-    } catch (KSDCCorrupted) {
-        d->recoverCorruptedCache();
-        return false;
-    }
-}
+        ::memset(startOfPageData + fileNameLength, 0, dataOffset - fileNameLength);
+        if (headerLength > 0) {
+            ::memcpy(startOfPageData + dataOffset, header.data(), header.size());
+            ::memset(startOfPageData + dataOffset + header.size(), 0, headerLength - header.size());
+        }
+        if (!data.isEmpty()) {
+            ::memcpy(startOfPageData + dataOffset + headerLength, data.data(), data.size());
+        }
 
-bool KSharedDataCache::find(const QString &key, QByteArray *destination) const
-{
-    try {
-        Private::CacheLocker lock(d);
-        if (lock.failed()) {
+        // The checksum covers the header and its padding too, so compute it
+        // from the copy instead of assembling the data first.
+        entry.checksum = SharedMemory::generateHash(QByteArrayView(startOfPageData + dataOffset, requiredSize - dataOffset));
+        if (shm->insertIndexEntry(entry) < 0) {
+            // No room next to the pinned entries of the index table.
+            shm->releaseEntryPages(entry);
+            return false;
+        }
+
+        // Continue compacting the cache a few pages at a time, instead of
+        // having some later insert stall everyone with a full defragmentation.
+        if (m_defragmentPending) {
+            m_defragmentPending = !shm->defragment(m_defragmentBudget);
+        }
+
+        shm->statistics.inserts.fetchAndAddRelaxed(1);
+        return true;
+    }
+
+    // Looks up the entry named by @p encodedKey (hashed to @p keyHash) and
+    // points @p data, if non-null, at its data in shared memory, and sets
+    // @p flags and @p expiryTime, if non-null, to the IndexTableEntry flags
+    // and expiry time of the entry. The cache must already be locked, and
+    // @p data is only valid as long as the lock is held. Throws
+    // KSDCCorrupted if the cache is found to be corrupt.
+    bool findLocked(const QByteArray &encodedKey, uint keyHash, QByteArrayView *data, uint *flags = nullptr, time_t *expiryTime = nullptr) const
+    {
+        shm->recordAccess(keyHash);
+
+        // No need to look at the index if the key filter rules it out.
+        if (!shm->keyFilterMayContain(keyHash)) {
+            shm->statistics.misses.fetchAndAddRelaxed(1);
             return false;
         }
 
         // Search in the index for our data, hashed by key;
+        qint32 entry = shm->findNamedEntry(encodedKey, keyHash);
+
+        // Expired entries are left for the next insert to remove, since we
+        // may only hold the shared lock.
+        if (entry < 0 || shm->indexTable()[entry].isExpired(::time(nullptr))) {
+            shm->statistics.misses.fetchAndAddRelaxed(1);
+            return false;
+        }
+
+        const IndexTableEntry *header = &shm->indexTable()[entry];
+        if (header->flags & IndexTableEntry::Negative) {
+            header->useCount++;
+            header->lastUsedTime = ::time(nullptr);
+            shm->statistics.misses.fetchAndAddRelaxed(1);
+            shm->statistics.negativeHits.fetchAndAddRelaxed(1);
+            if (flags) {
+                *flags = header->flags;
+            }
+            return false;
+        }
+
+        const void *resultPage = shm->page(header->firstPage);
+        if (Q_UNLIKELY(!resultPage)) {
+            throw KSDCCorrupted();
+        }
+
+        m_mapping->verifyProposedMemoryAccess(resultPage, header->totalItemSize);
+
+        header->useCount++;
+        header->lastUsedTime = ::time(nullptr);
+        shm->statistics.hits.fetchAndAddRelaxed(1);
+
+        // Our item is the key followed by the data, so skip past the key,
+        // its trailing null and the padding of Aligned entries.
+        const uint dataOffset = IndexTableEntry::dataOffset(encodedKey.size() + 1, header->flags);
+        if (Q_UNLIKELY(dataOffset > header->totalItemSize)) {
+            throw KSDCCorrupted();
+        }
+
+        if (data) {
+            *data = QByteArrayView(reinterpret_cast<const char *>(resultPage) + dataOffset, header->totalItemSize - dataOffset);
+        }
+        if (flags) {
+            *flags = header->flags;
+        }
+        if (expiryTime) {
+            *expiryTime = header->expiryTime;
+        }
+
+        return true;
+    }
+
+    static quint64 pinKey(uint keyHash, qint32 firstPage)
+    {
+        return (quint64(keyHash) << 32) | quint32(firstPage);
+    }
+
+    // Pins the entry hashed to @p keyHash at @p position for an entry view,
+    // claiming a pin holder slot for this object first if needed. Returns
+    // false if no slot is free. The cache must be locked.
+    bool pinEntryLocked(uint keyHash, qint32 position) const
+    {
+        QMutexLocker locker(&m_pinMutex);
+        const quint32 pid = quint32(QCoreApplication::applicationPid());
+        if (m_pinHolder < 0 || m_pinHolderPid != pid) {
+            // A forked child must not pin entries in the name of its parent.
+            m_pinnedEntries.clear();
+            m_pinHolder = shm->claimPinHolder(pid);
+            m_pinHolderPid = pid;
+            if (m_pinHolder < 0) {
+                return false;
+            }
+        }
+
+        IndexTableEntry &entry = shm->indexTable()[position];
+        if (m_pinnedEntries[pinKey(keyHash, entry.firstPage)]++ == 0) {
+            entry.pinHolders.fetchAndOrRelaxed(1u << m_pinHolder);
+        }
+        m_liveViews.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Drops the pin findView() put on the entry hashed to @p keyHash, which
+    // was stored at @p firstPage, unless the entry was lost in the meantime
+    // along with a corrupted cache.
+    void unpinEntry(uint keyHash, qint32 firstPage) const
+    {
+        // Locked in the same order as by pinEntryLocked()
+        CacheLocker lock(this, ReadLock);
+        QMutexLocker locker(&m_pinMutex);
+
+        // Other views of this object may still read the entry.
+        const auto it = m_pinnedEntries.find(pinKey(keyHash, firstPage));
+        if (it != m_pinnedEntries.end() && --it.value() > 0) {
+            return;
+        }
+        if (it != m_pinnedEntries.end()) {
+            m_pinnedEntries.erase(it);
+        }
+
+        if (lock.failed() || !shm || m_pinHolder < 0) {
+            return;
+        }
+
+        const qint32 position = shm->findEntryByHash(keyHash);
+        if (position >= 0) {
+            IndexTableEntry &entry = shm->indexTable()[position];
+            if (entry.firstPage == firstPage) {
+                entry.pinHolders.fetchAndAndRelaxed(~(1u << m_pinHolder));
+            }
+        }
+    }
+
+    // Returns false if the key hashed to @p keyHash is definitely not in the
+    // cache, which is decided without taking the lock. Counts that as a miss
+    // if @p countMiss is true.
+    bool mayContain(uint keyHash, bool countMiss = true)
+    {
+        // The key filter of a resized cache stops being updated.
+        reattachIfResized();
+
+        if (!shm || shm->version != SharedMemory::PIXMAP_CACHE_VERSION || shm->keyFilterMayContain(keyHash)) {
+            return true;
+        }
+
+        if (countMiss) {
+            shm->recordAccess(keyHash);
+            shm->statistics.misses.fetchAndAddRelaxed(1);
+            shm->statistics.filteredMisses.fetchAndAddRelaxed(1);
+        }
+        return false;
+    }
+
+    enum LockMode {
+        WriteLock, ///< Exclusive, required for anything modifying the cache layout
+        ReadLock, ///< Shared, sufficient for lookups, may be held by several processes
+    };
+
+    class CacheLocker
+    {
+        mutable Private *d;
+        LockMode m_mode;
+
+        bool tryLock()
+        {
+            return m_mode == ReadLock ? d->m_mapping->lockShared() : d->m_mapping->lock();
+        }
+
+        bool cautiousLock()
+        {
+            KTRACE_SCOPE_ARG("KSharedDataCache::lock", "cache", d->m_cacheName);
+            int lockCount = 0;
+
+            // Locking can fail due to a timeout. If it happens too often even though
+            // we're taking corrective action assume there's some disastrous problem
+            // and give up.
+            while (!tryLock() && !d->m_mapping->isLockedCacheSafe()) {
+                d->resetCorruptedCache();
+
+                if (!d->m_mapping->isValid()) {
+                    qCWarning(KCOREADDONS_DEBUG) << "Lost the connection to shared memory for cache" << d->m_cacheName;
+                    return false;
+                }
+
+                if (lockCount++ > 4) {
+                    qCCritical(KCOREADDONS_DEBUG) << "There is a very serious problem with the KDE data cache" << d->m_cacheName
+                                                  << "giving up trying to access cache.";
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+    public:
+        CacheLocker(const Private *_d, LockMode mode = WriteLock)
+            : d(const_cast<Private *>(_d))
+            , m_mode(mode)
+        {
+            if (Q_UNLIKELY(!d)) {
+                return;
+            }
+
+            d->reattachIfResized();
+
+            QElapsedTimer timer;
+            timer.start();
+            if (Q_UNLIKELY(!cautiousLock())) {
+                d = nullptr;
+                return;
+            }
+            if (d->shm) {
+                d->shm->statistics.recordLockWait(timer.nsecsElapsed());
+            }
+        }
+
+        ~CacheLocker()
+        {
+            if (d) {
+                if (m_mode == ReadLock) {
+                    d->m_mapping->unlockShared();
+                } else {
+                    d->m_mapping->unlock();
+                }
+            }
+        }
+
+        CacheLocker(const CacheLocker &) = delete;
+        CacheLocker &operator=(const CacheLocker &) = delete;
+
+        bool failed() const
+        {
+            return !d;
+        }
+
+        // Keeps the cache locked after this locker is destroyed, the caller
+        // becomes responsible for unlocking it.
+        void release()
+        {
+            d = nullptr;
+        }
+    };
+
+    QString m_cacheName;
+    SharedMemory *shm;
+    std::unique_ptr<KSDCMapping> m_mapping;
+    uint m_defaultCacheSize;
+    uint m_expectedItemSize;
+    uint m_defragmentBudget = 0;
+    bool m_defragmentPending = false;
+    uint m_compressionThreshold = 0;
+    bool m_hugePagesEnabled = false;
+    std::vector<std::unique_ptr<KSharedDataCache>> m_sizeClasses;
+    QList<unsigned> m_sizeClassPageSizes;
+    // Polls invalidationCount() for setInvalidationCallback()
+    std::unique_ptr<QTimer> m_invalidationTimer;
+    // The entry views pointing into the mapping, which must stay in place for them
+    mutable std::atomic<int> m_liveViews = 0;
+    // Guards the pin bookkeeping below, taken after the cache lock
+    mutable QMutex m_pinMutex;
+    // The slot in SharedMemory::pinHolderPids of this object, or -1, and the
+    // process it was claimed for
+    mutable int m_pinHolder = -1;
+    mutable quint32 m_pinHolderPid = 0;
+    // The number of views of each entry pinned by this object, see pinKey()
+    mutable QHash<quint64, int> m_pinnedEntries;
+    // Set while inserts are queued, see setWriteBehindLimit()
+    std::unique_ptr<WriteBehindQueue> m_writeBehind;
+    // Set while found entries are kept, see setFrontCacheSize()
+    std::unique_ptr<FrontCache> m_frontCache;
+};
+
+KSharedDataCache::KSharedDataCache(const QString &cacheName, unsigned defaultCacheSize, unsigned expectedItemSize)
+    : d(nullptr)
+{
+    try {
+        d = new Private(cacheName, defaultCacheSize, expectedItemSize);
+    } catch (KSDCCorrupted) {
+        qCCritical(KCOREADDONS_DEBUG) << "Failed to initialize KSharedDataCache!";
+        d = nullptr; // Just in case
+    }
+}
+
+KSharedDataCache::KSharedDataCache(const QString &cacheName, unsigned defaultCacheSize, const QList<unsigned> &expectedItemSizes)
+    : d(nullptr)
+{
+    try {
+        d = new Private(cacheName, defaultCacheSize, expectedItemSizes);
+    } catch (KSDCCorrupted) {
+        qCCritical(KCOREADDONS_DEBUG) << "Failed to initialize KSharedDataCache!";
+        d = nullptr; // Just in case
+    }
+}
+
+QFuture<QSharedPointer<KSharedDataCache>> KSharedDataCache::open(const QString &cacheName, unsigned defaultCacheSize, unsigned expectedItemSize)
+{
+    auto promise = std::make_shared<QPromise<QSharedPointer<KSharedDataCache>>>();
+    QFuture<QSharedPointer<KSharedDataCache>> future = promise->future();
+    promise->start();
+
+    QThreadPool::globalInstance()->start([promise, cacheName, defaultCacheSize, expectedItemSize]() {
+        QSharedPointer<KSharedDataCache> cache(new KSharedDataCache(cacheName, defaultCacheSize, expectedItemSize));
+        if (cache->d) {
+            cache->d->prefault();
+        }
+
+        promise->addResult(cache);
+        promise->finish();
+    });
+
+    return future;
+}
+
+KSharedDataCache::~KSharedDataCache()
+{
+    if (!d) {
+        return;
+    }
+
+    // Entry views refer to the cache, see EntryView.
+    Q_ASSERT(d->m_liveViews.load(std::memory_order_acquire) == 0);
+
+    flush();
+    d->releasePinHolder();
+    delete d;
+}
+
+bool KSharedDataCache::insert(const QString &key, const QByteArray &data)
+{
+    return insert(key, data, 0);
+}
+
+bool KSharedDataCache::insert(const QString &key, const QByteArray &data, unsigned ttl)
+{
+    if (d && d->m_writeBehind) {
+        return d->m_writeBehind->enqueue(key, data, ttl);
+    }
+
+    return insertImmediately(key, data, ttl);
+}
+
+bool KSharedDataCache::insertImmediately(const QString &key, const QByteArray &data, unsigned ttl)
+{
+    if (d && d->hasSizeClasses()) {
+        // Make sure no outdated entry of another size remains in another class
+        KSharedDataCache *target = d->sizeClassFor(Private::requiredSize(key, data));
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            if (sizeClass.get() != target) {
+                if (sizeClass->d && !sizeClass->d->removeKeys({key})) {
+                    return false;
+                }
+            }
+        }
+        return target->insert(key, data, ttl);
+    }
+
+    if (!d) {
+        return false;
+    }
+
+    try {
+        // Compress before taking the lock, it may take a while.
+        uint flags = 0;
+        const QByteArray encodedData = d->encodeData(data, &flags);
+
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return false;
+        }
+
+        QByteArray encodedKey = key.toUtf8();
+        const time_t expiryTime = ttl > 0 ? ::time(nullptr) + ttl : 0;
+        return d->insertLocked(key, encodedKey, SharedMemory::generateHash(encodedKey), encodedData, flags, expiryTime);
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return false;
+    }
+}
+
+bool KSharedDataCache::insertNegative(const QString &key, unsigned ttl)
+{
+    if (d && d->hasSizeClasses()) {
+        KSharedDataCache *target = d->sizeClassFor(Private::requiredSize(key, QByteArray()));
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            if (sizeClass.get() != target) {
+                if (sizeClass->d && !sizeClass->d->removeKeys({key})) {
+                    return false;
+                }
+            }
+        }
+        return target->insertNegative(key, ttl);
+    }
+
+    try {
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return false;
+        }
+
+        QByteArray encodedKey = key.toUtf8();
+        const time_t expiryTime = ttl > 0 ? ::time(nullptr) + ttl : 0;
+        return d->insertLocked(key, encodedKey, SharedMemory::generateHash(encodedKey), QByteArray(), IndexTableEntry::Negative, expiryTime);
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return false;
+    }
+}
+
+int KSharedDataCache::insertMany(const QList<QPair<QString, QByteArray>> &entries)
+{
+    if (d && d->hasSizeClasses()) {
+        QHash<KSharedDataCache *, QList<QPair<QString, QByteArray>>> entriesByClass;
+        for (const auto &entry : entries) {
+            entriesByClass[d->sizeClassFor(Private::requiredSize(entry.first, entry.second))].append(entry);
+        }
+
+        // The entries whose old version can't be removed from another size
+        // class are not inserted, like by insert()
+        QSet<QString> pinnedKeys;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            QStringList otherKeys;
+            for (auto it = entriesByClass.cbegin(); it != entriesByClass.cend(); ++it) {
+                if (it.key() != sizeClass.get()) {
+                    for (const auto &entry : it.value()) {
+                        otherKeys.append(entry.first);
+                    }
+                }
+            }
+            if (sizeClass->d) {
+                sizeClass->d->removeKeys(otherKeys, &pinnedKeys);
+            }
+        }
+
+        int inserted = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            QList<QPair<QString, QByteArray>> classEntries = entriesByClass.value(sizeClass.get());
+            if (!pinnedKeys.isEmpty()) {
+                classEntries.removeIf([&pinnedKeys](const QPair<QString, QByteArray> &entry) {
+                    return pinnedKeys.contains(entry.first);
+                });
+            }
+            inserted += sizeClass->insertMany(classEntries);
+        }
+        return inserted;
+    }
+
+    if (entries.isEmpty()) {
+        return 0;
+    }
+
+    // Encode and hash everything before taking the lock to keep the
+    // critical section as short as possible.
+    QList<QByteArray> encodedKeys;
+    QList<uint> keyHashes;
+    QList<QByteArray> encodedData;
+    QList<uint> flags;
+    encodedKeys.reserve(entries.size());
+    keyHashes.reserve(entries.size());
+    encodedData.reserve(entries.size());
+    flags.reserve(entries.size());
+    for (const auto &entry : entries) {
+        encodedKeys.append(entry.first.toUtf8());
+        keyHashes.append(SharedMemory::generateHash(encodedKeys.constLast()));
+        flags.append(0);
+        encodedData.append(d ? d->encodeData(entry.second, &flags.last()) : entry.second);
+    }
+
+    int inserted = 0;
+    try {
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return 0;
+        }
+
+        for (qsizetype i = 0; i < entries.size(); ++i) {
+            if (d->insertLocked(entries.at(i).first, encodedKeys.at(i), keyHashes.at(i), encodedData.at(i), flags.at(i))) {
+                ++inserted;
+            }
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    return inserted;
+}
+
+bool KSharedDataCache::insertAligned(const QString &key, QByteArrayView header, QByteArrayView data)
+{
+    QByteArray encodedKey = key.toUtf8();
+
+    if (d && d->hasSizeClasses()) {
+        const uint size = IndexTableEntry::alignUp(encodedKey.size() + 1) + alignedDataOffset(header.size()) + data.size();
+        KSharedDataCache *target = d->sizeClassFor(size);
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            if (sizeClass.get() != target) {
+                if (sizeClass->d && !sizeClass->d->removeKeys({key})) {
+                    return false;
+                }
+            }
+        }
+        return target->insertAligned(key, header, data);
+    }
+
+    try {
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return false;
+        }
+
+        return d->insertLocked(key, encodedKey, SharedMemory::generateHash(encodedKey), data, IndexTableEntry::Aligned, 0, header);
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return false;
+    }
+}
+
+qsizetype KSharedDataCache::alignedDataOffset(qsizetype headerSize)
+{
+    return IndexTableEntry::alignUp(headerSize);
+}
+
+bool KSharedDataCache::find(const QString &key, QByteArray *destination) const
+{
+    if (d && d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            if (sizeClass->find(key, destination)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    try {
+        QByteArray encodedKey = key.toUtf8();
+        const uint keyHash = SharedMemory::generateHash(encodedKey);
+        if (d && !d->mayContain(keyHash)) {
+            return false;
+        }
+
+        // A current copy saves taking the lock and decoding the data again.
+        FrontCache *frontCache = d && d->shm ? d->m_frontCache.get() : nullptr;
+        const quint64 generation = frontCache ? d->shm->generationOf(keyHash) : 0;
+        if (frontCache && frontCache->find(key, generation, destination)) {
+            d->shm->recordAccess(keyHash);
+            d->shm->statistics.hits.fetchAndAddRelaxed(1);
+            return true;
+        }
+
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return false;
+        }
+
+        QByteArrayView data;
+        uint flags = 0;
+        time_t expiryTime = 0;
+        if (d->findLocked(encodedKey, keyHash, destination || frontCache ? &data : nullptr, &flags, &expiryTime)) {
+            if (frontCache) {
+                const QByteArray decoded = Private::decodeData(data, flags);
+                frontCache->insert(key, decoded, generation, expiryTime);
+                if (destination) {
+                    *destination = decoded;
+                }
+            } else if (destination) {
+                *destination = Private::decodeData(data, flags);
+            }
+            return true;
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    return false;
+}
+
+KSharedDataCache::EntryView KSharedDataCache::findView(const QString &key) const
+{
+    if (d && d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            EntryView view = sizeClass->findView(key);
+            if (view.isValid()) {
+                return view;
+            }
+        }
+        return EntryView();
+    }
+
+    EntryView view;
+
+    try {
         QByteArray encodedKey = key.toUtf8();
-        qint32 entry = d->shm->findNamedEntry(encodedKey);
+        const uint keyHash = SharedMemory::generateHash(encodedKey);
+        if (d && !d->mayContain(keyHash)) {
+            return view;
+        }
+
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return view;
+        }
+
+        uint flags = 0;
+        if (d->findLocked(encodedKey, keyHash, &view.m_data, &flags)) {
+            if (flags & IndexTableEntry::Compressed) {
+                // There is nothing to point at in shared memory, so the view
+                // owns the decompressed copy and the lock can go.
+                view.m_buffer = Private::decodeData(view.m_data, flags);
+                view.m_data = view.m_buffer;
+            } else if (const qint32 position = d->shm->findEntryByHash(keyHash); d->pinEntryLocked(keyHash, position)) {
+                // The entry is pinned so that its pages stay in place once
+                // the lock is released, see IndexTableEntry::pinHolders.
+                view.d = d;
+                view.m_keyHash = keyHash;
+                view.m_firstPage = d->shm->indexTable()[position].firstPage;
+            } else {
+                // Too many objects pin entries, so fall back to a copy.
+                view.m_buffer = view.m_data.toByteArray();
+                view.m_data = view.m_buffer;
+            }
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    return view;
+}
+
+int KSharedDataCache::findMany(const QStringList &keys, QHash<QString, QByteArray> *destination) const
+{
+    if (d && d->hasSizeClasses()) {
+        QStringList remainingKeys = keys;
+        int found = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            if (remainingKeys.isEmpty()) {
+                break;
+            }
+            QHash<QString, QByteArray> results;
+            found += sizeClass->findMany(remainingKeys, &results);
+            for (auto it = results.cbegin(); it != results.cend(); ++it) {
+                remainingKeys.removeAll(it.key());
+                if (destination) {
+                    destination->insert(it.key(), it.value());
+                }
+            }
+        }
+        return found;
+    }
+
+    if (keys.isEmpty()) {
+        return 0;
+    }
+
+    QList<QByteArray> encodedKeys;
+    QList<uint> keyHashes;
+    encodedKeys.reserve(keys.size());
+    keyHashes.reserve(keys.size());
+    for (const QString &key : keys) {
+        encodedKeys.append(key.toUtf8());
+        keyHashes.append(SharedMemory::generateHash(encodedKeys.constLast()));
+    }
+
+    int found = 0;
+    try {
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return 0;
+        }
+
+        QByteArrayView data;
+        uint flags = 0;
+        for (qsizetype i = 0; i < keys.size(); ++i) {
+            if (d->findLocked(encodedKeys.at(i), keyHashes.at(i), destination ? &data : nullptr, &flags)) {
+                if (destination) {
+                    destination->insert(keys.at(i), Private::decodeData(data, flags));
+                }
+                ++found;
+            }
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    return found;
+}
+
+int KSharedDataCache::prefetch(const QStringList &keys) const
+{
+    if (d && d->hasSizeClasses()) {
+        int found = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            found += sizeClass->prefetch(keys);
+        }
+        return found;
+    }
+
+    if (keys.isEmpty()) {
+        return 0;
+    }
+
+    int found = 0;
+    try {
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return 0;
+        }
+
+        // Unlike findLocked(), neither the statistics nor the use of the
+        // entries are touched, the finds following later do that.
+        struct Range {
+            const char *start;
+            quintptr length;
+        };
+        std::vector<Range> ranges;
+        ranges.reserve(keys.size());
+        const time_t now = ::time(nullptr);
+        for (const QString &key : keys) {
+            const QByteArray encodedKey = key.toUtf8();
+            const uint keyHash = SharedMemory::generateHash(encodedKey);
+            if (!d->shm->keyFilterMayContain(keyHash)) {
+                continue;
+            }
+
+            const qint32 entry = d->shm->findNamedEntry(encodedKey, keyHash);
+            if (entry < 0) {
+                continue;
+            }
+            const IndexTableEntry &header = d->shm->indexTable()[entry];
+            if (header.isExpired(now) || (header.flags & IndexTableEntry::Negative)) {
+                continue;
+            }
+
+            const void *firstPage = d->shm->page(header.firstPage);
+            if (Q_UNLIKELY(!firstPage)) {
+                throw KSDCCorrupted();
+            }
+            d->m_mapping->verifyProposedMemoryAccess(firstPage, header.totalItemSize);
+            ranges.push_back({static_cast<const char *>(firstPage), header.totalItemSize});
+            ++found;
+        }
+
+        // Entries stored next to each other, e.g. as inserted together, are
+        // read in with a single request.
+        std::sort(ranges.begin(), ranges.end(), [](const Range &l, const Range &r) {
+            return l.start < r.start;
+        });
+        for (std::size_t i = 0; i < ranges.size();) {
+            const char *start = ranges.at(i).start;
+            const char *end = start + ranges.at(i).length;
+            for (++i; i < ranges.size() && ranges.at(i).start <= end + d->shm->cachePageSize(); ++i) {
+                end = std::max(end, ranges.at(i).start + ranges.at(i).length);
+            }
+            d->m_mapping->adviseWillNeed(start, end - start);
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    return found;
+}
+
+int KSharedDataCache::forEachEntry(const std::function<bool(const EntryInfo &info, QByteArrayView data)> &callback) const
+{
+    if (d && d->hasSizeClasses()) {
+        int visited = 0;
+        bool stopped = false;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            visited += sizeClass->forEachEntry([&callback, &stopped](const EntryInfo &info, QByteArrayView data) {
+                stopped = !callback(info, data);
+                return !stopped;
+            });
+            if (stopped) {
+                break;
+            }
+        }
+        return visited;
+    }
+
+    // The entries are copied out in batches, and @p callback is called with
+    // the lock released, so that it may well use the cache itself. Entries
+    // removed in the meantime are skipped.
+    QList<QByteArray> keys;
+    try {
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return 0;
+        }
+
+        const SharedMemory *shm = d->shm;
+        const IndexTableEntry *indices = shm->indexTable();
+        const PageTableEntry *pages = shm->pageTable();
+        const time_t now = ::time(nullptr);
+
+        // Walk the page table instead of the index table, so the pages are
+        // read in ascending order.
+        uint page = 0;
+        while (page < shm->pageTableSize()) {
+            const qint32 index = pages[page].index;
+            if (index < 0 || static_cast<uint>(index) >= shm->indexTableSize() || indices[index].firstPage != static_cast<pageID>(page)) {
+                ++page;
+                continue;
+            }
+
+            const IndexTableEntry &entry = indices[index];
+            page += qMax(1u, SharedMemory::intCeil(entry.totalItemSize, shm->cachePageSize()));
+            if (entry.isExpired(now) || (entry.flags & IndexTableEntry::Negative)) {
+                continue;
+            }
+            keys.append(d->storedKey(entry).toByteArray());
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return 0;
+    }
+
+    struct CopiedEntry {
+        EntryInfo info;
+        QByteArray data;
+    };
+
+    int visited = 0;
+    for (qsizetype first = 0; first < keys.size(); first += s_forEachBatchSize) {
+        std::vector<CopiedEntry> batch;
+        try {
+            Private::CacheLocker lock(d, Private::ReadLock);
+            if (lock.failed()) {
+                return visited;
+            }
+
+            const SharedMemory *shm = d->shm;
+            const time_t now = ::time(nullptr);
+            const qsizetype last = qMin(first + s_forEachBatchSize, keys.size());
+            for (qsizetype i = first; i < last; ++i) {
+                const qint32 index = shm->findNamedEntry(keys.at(i));
+                if (index < 0) {
+                    continue;
+                }
+                const IndexTableEntry &entry = shm->indexTable()[index];
+                if (entry.isExpired(now) || (entry.flags & IndexTableEntry::Negative)) {
+                    continue;
+                }
+
+                const QByteArrayView key = d->storedKey(entry);
+                const char *item = key.data();
+                const uint dataOffset = IndexTableEntry::dataOffset(key.size() + 1, entry.flags);
+                if (Q_UNLIKELY(dataOffset > entry.totalItemSize)) {
+                    throw KSDCCorrupted();
+                }
+
+                const QByteArrayView storedData(item + dataOffset, entry.totalItemSize - dataOffset);
+                CopiedEntry copy;
+                copy.data = (entry.flags & IndexTableEntry::Compressed) ? Private::decodeData(storedData, entry.flags) : storedData.toByteArray();
+                copy.info.key = QString::fromUtf8(key);
+                copy.info.size = copy.data.size();
+                copy.info.useCount = entry.useCount;
+                copy.info.addTime = QDateTime::fromSecsSinceEpoch(entry.addTime);
+                copy.info.lastUsedTime = QDateTime::fromSecsSinceEpoch(entry.lastUsedTime);
+                if (entry.expiryTime != 0) {
+                    copy.info.expiryTime = QDateTime::fromSecsSinceEpoch(entry.expiryTime);
+                }
+                batch.push_back(std::move(copy));
+            }
+        } catch (KSDCCorrupted) {
+            d->recoverCorruptedCache();
+            return visited;
+        }
+
+        for (const CopiedEntry &copy : batch) {
+            ++visited;
+            if (!callback(copy.info, copy.data)) {
+                return visited;
+            }
+        }
+    }
+
+    return visited;
+}
+
+int KSharedDataCache::importFrom(const KSharedDataCache &source)
+{
+    if (&source == this) {
+        return 0;
+    }
+
+    // Copy everything first, the source may well share its lock with us
+    QList<QPair<QString, QByteArray>> entries;
+    QList<QPair<QString, QByteArray>> expiringEntries;
+    QList<unsigned> ttls;
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    source.forEachEntry([&](const EntryInfo &info, QByteArrayView data) {
+        if (!info.expiryTime.isValid()) {
+            entries.append(qMakePair(info.key, data.toByteArray()));
+        } else if (info.expiryTime.toSecsSinceEpoch() > now) {
+            expiringEntries.append(qMakePair(info.key, data.toByteArray()));
+            ttls.append(info.expiryTime.toSecsSinceEpoch() - now);
+        }
+        return true;
+    });
+
+    int inserted = insertMany(entries);
+    for (qsizetype i = 0; i < expiringEntries.size(); ++i) {
+        if (insert(expiringEntries.at(i).first, expiringEntries.at(i).second, ttls.at(i))) {
+            ++inserted;
+        }
+    }
+    return inserted;
+}
+
+KSharedDataCache::EntryView::EntryView() = default;
+
+KSharedDataCache::EntryView::~EntryView()
+{
+    if (d) {
+        d->unpinEntry(m_keyHash, m_firstPage);
+        d->m_liveViews.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+KSharedDataCache::EntryView::EntryView(EntryView &&other) noexcept
+    : d(std::exchange(other.d, nullptr))
+    , m_data(std::exchange(other.m_data, {}))
+    , m_buffer(std::move(other.m_buffer))
+    , m_keyHash(other.m_keyHash)
+    , m_firstPage(other.m_firstPage)
+{
+}
+
+KSharedDataCache::EntryView &KSharedDataCache::EntryView::operator=(EntryView &&other) noexcept
+{
+    if (this != &other) {
+        if (d) {
+            d->unpinEntry(m_keyHash, m_firstPage);
+            d->m_liveViews.fetch_sub(1, std::memory_order_release);
+        }
+        d = std::exchange(other.d, nullptr);
+        m_data = std::exchange(other.m_data, {});
+        m_buffer = std::move(other.m_buffer);
+        m_keyHash = other.m_keyHash;
+        m_firstPage = other.m_firstPage;
+    }
+    return *this;
+}
+
+bool KSharedDataCache::EntryView::isValid() const
+{
+    return d != nullptr || !m_buffer.isNull();
+}
+
+QByteArrayView KSharedDataCache::EntryView::data() const
+{
+    return m_data;
+}
+
+KSharedDataCache::Namespace KSharedDataCache::openNamespace(const QString &name, unsigned quota)
+{
+    Namespace result;
+    if (!d || d->hasSizeClasses()) {
+        return result;
+    }
+
+    // Hashes are never 0, which marks unused namespaces.
+    const quint32 nameHash = SharedMemory::generateHash(name.toUtf8()) | 1;
+    try {
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return result;
+        }
+
+        const uint namespaceId = d->shm->registerNamespace(nameHash, quota);
+        if (namespaceId == 0) {
+            qCWarning(KCOREADDONS_DEBUG) << "No room for namespace" << name << "in cache" << d->m_cacheName;
+            return result;
+        }
+        d->shm->namespaces[namespaceId - 1].quota = quota;
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return result;
+    }
+
+    result.m_cache = this;
+    result.m_name = name;
+    result.m_prefix = QChar(0x1f) + name + QChar(0x1f);
+    result.m_nameHash = nameHash;
+    result.m_quota = quota;
+    return result;
+}
+
+KSharedDataCache::Namespace::Namespace() = default;
+
+bool KSharedDataCache::Namespace::isValid() const
+{
+    return m_cache && m_cache->d;
+}
+
+QString KSharedDataCache::Namespace::name() const
+{
+    return m_name;
+}
+
+bool KSharedDataCache::Namespace::insert(const QString &key, const QByteArray &data, unsigned ttl)
+{
+    if (!isValid()) {
+        return false;
+    }
 
-        if (entry >= 0) {
-            const IndexTableEntry *header = &d->shm->indexTable()[entry];
-            const void *resultPage = d->shm->page(header->firstPage);
-            if (Q_UNLIKELY(!resultPage)) {
-                throw KSDCCorrupted();
-            }
+    Private *d = m_cache->d;
+    try {
+        uint flags = 0;
+        const QByteArray encodedData = d->encodeData(data, &flags);
+
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return false;
+        }
 
-            d->m_mapping->verifyProposedMemoryAccess(resultPage, header->totalItemSize);
+        // Registers the namespace again if the cache was recreated meanwhile.
+        const uint namespaceId = d->shm->registerNamespace(m_nameHash, m_quota);
+        if (namespaceId == 0) {
+            return false;
+        }
 
-            header->useCount++;
-            header->lastUsedTime = ::time(nullptr);
+        const QString prefixedKey = m_prefix + key;
+        const QByteArray encodedKey = prefixedKey.toUtf8();
+        const time_t expiryTime = ttl > 0 ? ::time(nullptr) + ttl : 0;
+        if (!d->insertLocked(prefixedKey, encodedKey, SharedMemory::generateHash(encodedKey), encodedData, flags, expiryTime, {}, namespaceId)) {
+            return false;
+        }
+        d->shm->namespaces[namespaceId - 1].inserts.fetchAndAddRelaxed(1);
+        return true;
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return false;
+    }
+}
+
+bool KSharedDataCache::Namespace::find(const QString &key, QByteArray *destination) const
+{
+    if (!isValid()) {
+        return false;
+    }
 
-            // Our item is the key followed immediately by the data, so skip
-            // past the key.
-            const char *cacheData = reinterpret_cast<const char *>(resultPage);
-            cacheData += encodedKey.size();
-            cacheData++; // Skip trailing null -- now we're pointing to start of data
+    const bool found = m_cache->find(m_prefix + key, destination);
+    if (SharedNamespace *cacheNamespace = m_cache->d->findNamespace(m_nameHash)) {
+        (found ? cacheNamespace->hits : cacheNamespace->misses).fetchAndAddRelaxed(1);
+    }
+    return found;
+}
 
-            if (destination) {
-                *destination = QByteArray(cacheData, header->totalItemSize - encodedKey.size() - 1);
-            }
+bool KSharedDataCache::Namespace::contains(const QString &key) const
+{
+    return isValid() && m_cache->contains(m_prefix + key);
+}
 
-            return true;
+int KSharedDataCache::Namespace::prefetch(const QStringList &keys) const
+{
+    if (!isValid()) {
+        return 0;
+    }
+
+    QStringList prefixedKeys;
+    prefixedKeys.reserve(keys.size());
+    for (const QString &key : keys) {
+        prefixedKeys.append(m_prefix + key);
+    }
+    return m_cache->prefetch(prefixedKeys);
+}
+
+void KSharedDataCache::Namespace::clear()
+{
+    if (!isValid()) {
+        return;
+    }
+
+    Private *d = m_cache->d;
+    try {
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return;
+        }
+
+        if (const uint namespaceId = d->shm->findNamespace(m_nameHash)) {
+            d->shm->removeNamespaceEntries(namespaceId);
         }
     } catch (KSDCCorrupted) {
         d->recoverCorruptedCache();
     }
+}
 
-    return false;
+unsigned KSharedDataCache::Namespace::quota() const
+{
+    const SharedNamespace *cacheNamespace = isValid() ? m_cache->d->findNamespace(m_nameHash) : nullptr;
+    return cacheNamespace ? cacheNamespace->quota : m_quota;
+}
+
+unsigned KSharedDataCache::Namespace::usedSize() const
+{
+    const SharedNamespace *cacheNamespace = isValid() ? m_cache->d->findNamespace(m_nameHash) : nullptr;
+    return cacheNamespace ? cacheNamespace->usedPages * m_cache->d->shm->cachePageSize() : 0;
+}
+
+KSharedDataCache::Statistics KSharedDataCache::Namespace::statistics() const
+{
+    Statistics result;
+    if (const SharedNamespace *cacheNamespace = isValid() ? m_cache->d->findNamespace(m_nameHash) : nullptr) {
+        result.hits = cacheNamespace->hits.loadRelaxed();
+        result.misses = cacheNamespace->misses.loadRelaxed();
+        result.inserts = cacheNamespace->inserts.loadRelaxed();
+        result.evictions = cacheNamespace->evictions.loadRelaxed();
+    }
+    return result;
 }
 
 void KSharedDataCache::clear()
 {
+    if (d && d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            sizeClass->clear();
+        }
+        return;
+    }
+
     try {
         Private::CacheLocker lock(d);
 
         if (!lock.failed()) {
             d->shm->clear();
+            // All of the cache is free now, the memory is not needed until it fills up again
+            d->m_mapping->releaseUnusedPages();
         }
     } catch (KSDCCorrupted) {
         d->recoverCorruptedCache();
@@ -396,13 +1909,59 @@ void KSharedDataCache::clear()
 
 bool KSharedDataCache::contains(const QString &key) const
 {
+    if (d && d->hasSizeClasses()) {
+        return std::any_of(d->m_sizeClasses.cbegin(), d->m_sizeClasses.cend(), [&key](const auto &sizeClass) {
+            return sizeClass->contains(key);
+        });
+    }
+
     try {
-        Private::CacheLocker lock(d);
+        const QByteArray encodedKey = key.toUtf8();
+        const uint keyHash = SharedMemory::generateHash(encodedKey);
+        if (d && !d->mayContain(keyHash, false)) {
+            return false;
+        }
+
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return false;
+        }
+
+        const qint32 entry = d->shm->findNamedEntry(encodedKey, keyHash);
+        if (entry < 0) {
+            return false;
+        }
+
+        const IndexTableEntry &header = d->shm->indexTable()[entry];
+        return !header.isExpired(::time(nullptr)) && !(header.flags & IndexTableEntry::Negative);
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return false;
+    }
+}
+
+bool KSharedDataCache::containsNegative(const QString &key) const
+{
+    if (d && d->hasSizeClasses()) {
+        return std::any_of(d->m_sizeClasses.cbegin(), d->m_sizeClasses.cend(), [&key](const auto &sizeClass) {
+            return sizeClass->containsNegative(key);
+        });
+    }
+
+    try {
+        const QByteArray encodedKey = key.toUtf8();
+        const uint keyHash = SharedMemory::generateHash(encodedKey);
+        if (d && !d->mayContain(keyHash)) {
+            return false;
+        }
+
+        Private::CacheLocker lock(d, Private::ReadLock);
         if (lock.failed()) {
             return false;
         }
 
-        return d->shm->findNamedEntry(key.toUtf8()) >= 0;
+        uint flags = 0;
+        return !d->findLocked(encodedKey, keyHash, nullptr, &flags) && (flags & IndexTableEntry::Negative);
     } catch (KSDCCorrupted) {
         d->recoverCorruptedCache();
         return false;
@@ -411,19 +1970,36 @@ bool KSharedDataCache::contains(const QString &key) const
 
 void KSharedDataCache::deleteCache(const QString &cacheName)
 {
-    QString cachePath = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/") + cacheName + QLatin1String(".kcache");
+    QString cachePath = cacheFilePath(cacheName);
 
     // Note that it is important to simply unlink the file, and not truncate it
     // smaller first to avoid SIGBUS errors and similar with shared memory
     // attached to the underlying inode.
     qCDebug(KCOREADDONS_DEBUG) << "Removing cache at" << cachePath;
     QFile::remove(cachePath);
+
+    // Remove the caches of the size classes as well, if any
+    const QFileInfo cacheInfo(cachePath);
+    const QDir cacheDir = cacheInfo.dir();
+    const QString sizeClassPattern = QFileInfo(cacheName).fileName() + QLatin1String(".sizeclass*.kcache");
+    const QStringList sizeClassFiles = cacheDir.entryList({sizeClassPattern}, QDir::Files);
+    for (const QString &sizeClassFile : sizeClassFiles) {
+        QFile::remove(cacheDir.filePath(sizeClassFile));
+    }
 }
 
 unsigned KSharedDataCache::totalSize() const
 {
+    if (d && d->hasSizeClasses()) {
+        unsigned size = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            size += sizeClass->totalSize();
+        }
+        return size;
+    }
+
     try {
-        Private::CacheLocker lock(d);
+        Private::CacheLocker lock(d, Private::ReadLock);
         if (lock.failed()) {
             return 0u;
         }
@@ -437,8 +2013,16 @@ unsigned KSharedDataCache::totalSize() const
 
 unsigned KSharedDataCache::freeSize() const
 {
+    if (d && d->hasSizeClasses()) {
+        unsigned size = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            size += sizeClass->freeSize();
+        }
+        return size;
+    }
+
     try {
-        Private::CacheLocker lock(d);
+        Private::CacheLocker lock(d, Private::ReadLock);
         if (lock.failed()) {
             return 0u;
         }
@@ -450,8 +2034,212 @@ unsigned KSharedDataCache::freeSize() const
     }
 }
 
+qint64 KSharedDataCache::releaseFreeMemory()
+{
+    if (d && d->hasSizeClasses()) {
+        qint64 released = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            released += sizeClass->releaseFreeMemory();
+        }
+        return released;
+    }
+
+    try {
+        Private::CacheLocker lock(d);
+        if (lock.failed()) {
+            return 0;
+        }
+
+        return d->m_mapping->releaseUnusedPages();
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+        return 0;
+    }
+}
+
+unsigned KSharedDataCache::defragmentationBudget() const
+{
+    return d ? d->m_defragmentBudget : 0;
+}
+
+void KSharedDataCache::setDefragmentationBudget(unsigned pageCount)
+{
+    if (d) {
+        d->m_defragmentBudget = pageCount;
+        d->m_defragmentPending = false;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            sizeClass->setDefragmentationBudget(pageCount);
+        }
+    }
+}
+
+unsigned KSharedDataCache::compressionThreshold() const
+{
+    return d ? d->m_compressionThreshold : 0;
+}
+
+void KSharedDataCache::setCompressionThreshold(unsigned size)
+{
+    if (d) {
+        d->m_compressionThreshold = size;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            sizeClass->setCompressionThreshold(size);
+        }
+    }
+}
+
+uint KSharedDataCache::frontCacheSize() const
+{
+    if (d && d->hasSizeClasses()) {
+        uint size = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            size += sizeClass->frontCacheSize();
+        }
+        return size;
+    }
+
+    return d && d->m_frontCache ? uint(d->m_frontCache->entries.maxCost()) : 0;
+}
+
+void KSharedDataCache::setFrontCacheSize(uint size)
+{
+    if (!d) {
+        return;
+    }
+
+    if (d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            sizeClass->setFrontCacheSize(size / d->m_sizeClasses.size());
+        }
+    } else if (size == 0) {
+        d->m_frontCache.reset();
+    } else if (d->m_frontCache) {
+        QMutexLocker locker(&d->m_frontCache->mutex);
+        d->m_frontCache->entries.setMaxCost(size);
+    } else {
+        d->m_frontCache = std::make_unique<FrontCache>(size);
+    }
+}
+
+uint KSharedDataCache::writeBehindLimit() const
+{
+    return d && d->m_writeBehind ? d->m_writeBehind->maxQueuedBytes : 0;
+}
+
+void KSharedDataCache::setWriteBehindLimit(uint size)
+{
+    if (!d) {
+        return;
+    }
+
+    if (size == 0) {
+        flush();
+        d->m_writeBehind.reset();
+    } else if (d->m_writeBehind) {
+        d->m_writeBehind->maxQueuedBytes = size;
+    } else {
+        d->m_writeBehind = std::make_unique<WriteBehindQueue>(this, size);
+    }
+}
+
+void KSharedDataCache::flush()
+{
+    if (d && d->m_writeBehind) {
+        d->m_writeBehind->apply(this);
+    }
+}
+
+bool KSharedDataCache::hugePagesEnabled() const
+{
+    return d && d->m_hugePagesEnabled;
+}
+
+bool KSharedDataCache::setHugePagesEnabled(bool enable)
+{
+    if (!d) {
+        return false;
+    }
+
+    if (d->hasSizeClasses()) {
+        bool result = true;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            result = sizeClass->setHugePagesEnabled(enable) && result;
+        }
+        d->m_hugePagesEnabled = enable && result;
+        return result;
+    }
+
+    if (!d->m_mapping || !d->m_mapping->adviseHugePages(enable)) {
+        d->m_hugePagesEnabled = false;
+        return false;
+    }
+
+    d->m_hugePagesEnabled = enable;
+    return true;
+}
+
+KSharedDataCache::Statistics KSharedDataCache::statistics() const
+{
+    Statistics result;
+
+    if (d && d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            const Statistics classStatistics = sizeClass->statistics();
+            result.hits += classStatistics.hits;
+            result.misses += classStatistics.misses;
+            result.negativeHits += classStatistics.negativeHits;
+            result.filteredMisses += classStatistics.filteredMisses;
+            result.inserts += classStatistics.inserts;
+            result.rejections += classStatistics.rejections;
+            result.evictions += classStatistics.evictions;
+            result.collisionEvictions += classStatistics.collisionEvictions;
+            result.expirations += classStatistics.expirations;
+            result.defragmentations += classStatistics.defragmentations;
+            result.defragmentationTime += classStatistics.defragmentationTime;
+            result.lockWaitTime += classStatistics.lockWaitTime;
+            result.lockWaitHistogram.resize(classStatistics.lockWaitHistogram.size());
+            for (qsizetype i = 0; i < classStatistics.lockWaitHistogram.size(); ++i) {
+                result.lockWaitHistogram[i] += classStatistics.lockWaitHistogram.at(i);
+            }
+        }
+        return result;
+    }
+
+    try {
+        Private::CacheLocker lock(d, Private::ReadLock);
+        if (lock.failed()) {
+            return result;
+        }
+
+        const SharedStatistics &statistics = d->shm->statistics;
+        result.hits = statistics.hits.loadRelaxed();
+        result.misses = statistics.misses.loadRelaxed();
+        result.negativeHits = statistics.negativeHits.loadRelaxed();
+        result.filteredMisses = statistics.filteredMisses.loadRelaxed();
+        result.inserts = statistics.inserts.loadRelaxed();
+        result.rejections = statistics.rejections.loadRelaxed();
+        result.evictions = statistics.evictions.loadRelaxed();
+        result.collisionEvictions = statistics.collisionEvictions.loadRelaxed();
+        result.expirations = statistics.expirations.loadRelaxed();
+        result.defragmentations = statistics.defragmentations.loadRelaxed();
+        result.defragmentationTime = statistics.defragmentationTime.loadRelaxed();
+        result.lockWaitTime = statistics.lockWaitTime.loadRelaxed();
+        for (const auto &bucket : statistics.lockWaitHistogram) {
+            result.lockWaitHistogram.append(bucket.loadRelaxed());
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    return result;
+}
+
 KSharedDataCache::EvictionPolicy KSharedDataCache::evictionPolicy() const
 {
+    if (d && d->hasSizeClasses()) {
+        return d->m_sizeClasses.front()->evictionPolicy();
+    }
+
     if (d && d->shm) {
         return static_cast<EvictionPolicy>(d->shm->evictionPolicy.fetchAndAddAcquire(0));
     }
@@ -461,6 +2249,13 @@ KSharedDataCache::EvictionPolicy KSharedDataCache::evictionPolicy() const
 
 void KSharedDataCache::setEvictionPolicy(EvictionPolicy newPolicy)
 {
+    if (d && d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            sizeClass->setEvictionPolicy(newPolicy);
+        }
+        return;
+    }
+
     if (d && d->shm) {
         d->shm->evictionPolicy.fetchAndStoreRelease(static_cast<int>(newPolicy));
     }
@@ -468,6 +2263,10 @@ void KSharedDataCache::setEvictionPolicy(EvictionPolicy newPolicy)
 
 unsigned KSharedDataCache::timestamp() const
 {
+    if (d && d->hasSizeClasses()) {
+        return d->m_sizeClasses.front()->timestamp();
+    }
+
     if (d && d->shm) {
         return static_cast<unsigned>(d->shm->cacheTimestamp.fetchAndAddAcquire(0));
     }
@@ -477,7 +2276,130 @@ unsigned KSharedDataCache::timestamp() const
 
 void KSharedDataCache::setTimestamp(unsigned newTimestamp)
 {
+    if (d && d->hasSizeClasses()) {
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            sizeClass->setTimestamp(newTimestamp);
+        }
+        return;
+    }
+
+    if (d && d->shm) {
+        if (d->shm->cacheTimestamp.fetchAndStoreRelease(static_cast<int>(newTimestamp)) != static_cast<int>(newTimestamp)) {
+            d->shm->invalidations.fetchAndAddRelease(1);
+            d->shm->cacheGeneration.fetchAndAddRelease(1);
+        }
+    }
+}
+
+bool KSharedDataCache::resize(unsigned newCacheSize)
+{
+    if (d && d->hasSizeClasses()) {
+        const unsigned classCacheSize = newCacheSize / d->m_sizeClasses.size();
+        bool resized = true;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            resized = sizeClass->resize(classCacheSize) && resized;
+        }
+        return resized;
+    }
+
+    if (!d) {
+        return false;
+    }
+    d->reattachIfResized();
+    if (!d->shm) {
+        return false;
+    }
+    if (d->m_liveViews.load(std::memory_order_acquire) > 0) {
+        qCWarning(KCOREADDONS_DEBUG) << "Not resizing cache" << d->m_cacheName << "while entry views are in use";
+        return false;
+    }
+
+    // The entries are copied into a cache of the new size next to ours, which
+    // then replaces ours on disk. Processes that still use ours move over the
+    // next time they lock it, the mapping they have until then stays valid.
+    const QString resizingName = d->m_cacheName + QLatin1String(".resizing") + QString::number(QCoreApplication::applicationPid());
+    KSharedDataCache::deleteCache(resizingName);
+    {
+        KSharedDataCache resized(resizingName, newCacheSize, d->shm->cachePageSize());
+        if (!resized.d || !resized.d->shm || resized.d->shm->cachePageSize() != d->shm->cachePageSize()) {
+            KSharedDataCache::deleteCache(resizingName);
+            return false;
+        }
+        resized.setEvictionPolicy(evictionPolicy());
+        resized.d->shm->cacheTimestamp.storeRelease(static_cast<int>(timestamp()));
+        resized.importFrom(*this);
+
+        if (!replaceFile(cacheFilePath(resizingName), cacheFilePath(d->m_cacheName))) {
+            KSharedDataCache::deleteCache(resizingName);
+            return false;
+        }
+    }
+
+    try {
+        Private::CacheLocker lock(d);
+        if (!lock.failed()) {
+            d->shm->resizedTo.storeRelease(qMax(newCacheSize, 1u));
+            // What others keep caching in here until they notice would be lost anyway
+            d->shm->invalidations.fetchAndAddRelease(1);
+            d->shm->cacheGeneration.fetchAndAddRelease(1);
+        }
+    } catch (KSDCCorrupted) {
+        d->recoverCorruptedCache();
+    }
+
+    d->m_defaultCacheSize = newCacheSize;
+    d->createMemoryMapping();
+    return true;
+}
+
+quint64 KSharedDataCache::invalidationCount() const
+{
+    if (d && d->hasSizeClasses()) {
+        quint64 count = 0;
+        for (const auto &sizeClass : d->m_sizeClasses) {
+            count += sizeClass->invalidationCount();
+        }
+        return count;
+    }
+
     if (d && d->shm) {
-        d->shm->cacheTimestamp.fetchAndStoreRelease(static_cast<int>(newTimestamp));
+        return d->shm->invalidations.loadAcquire();
+    }
+
+    return 0;
+}
+
+void KSharedDataCache::setInvalidationCallback(const std::function<void()> &callback, std::chrono::milliseconds interval)
+{
+    if (!d) {
+        return;
+    }
+
+    d->m_invalidationTimer.reset();
+    if (!callback) {
+        return;
     }
+
+    // The counter lives in the shared memory, so checking it is one atomic read per interval.
+    // Waiting for it in another thread instead would race with the cache being remapped.
+    d->m_invalidationTimer = std::make_unique<QTimer>();
+    d->m_invalidationTimer->setInterval(interval);
+    QObject::connect(d->m_invalidationTimer.get(), &QTimer::timeout, d->m_invalidationTimer.get(), [this, callback, seen = invalidationCount()]() mutable {
+        const quint64 count = invalidationCount();
+        if (count != seen) {
+            seen = count;
+            callback();
+        }
+    });
+    d->m_invalidationTimer->start();
+}
+
+KMemoryFootprint::Subsystem KMemoryFootprintPrivate::sharedDataCache()
+{
+    return {
+        QStringLiteral("KSharedDataCache"),
+        KSDCMapping::s_mappingCount.load(std::memory_order_relaxed),
+        KSDCMapping::s_mappedBytes.load(std::memory_order_relaxed),
+        false,
+    };
 }
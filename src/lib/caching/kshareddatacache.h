@@ -11,8 +11,18 @@
 
 #include <kcoreaddons_export.h>
 
-class QString;
-class QByteArray;
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QDateTime>
+#include <QFuture>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include <chrono>
+#include <functional>
 
 /**
  * @class KSharedDataCache kshareddatacache.h KSharedDataCache
@@ -67,6 +77,50 @@ public:
      *   system.
      */
     KSharedDataCache(const QString &cacheName, unsigned defaultCacheSize, unsigned expectedItemSize = 0);
+
+    /**
+     * Attaches to a shared cache holding items of widely differing sizes,
+     * creating it if necessary.
+     *
+     * Instead of using a single page size, one page size ("size class") is
+     * chosen for each of the given item sizes and every item is stored using
+     * the size class that wastes the least space for it. This avoids small
+     * items each taking up a large page, or large items being spread over
+     * many small pages.
+     *
+     * Each size class is kept in its own cache file named after @p cacheName,
+     * the given @p defaultCacheSize is split evenly among them.
+     *
+     * @param cacheName Name of the cache to use/share.
+     * @param defaultCacheSize Amount of data to be able to store, in bytes, in
+     *   all size classes together.
+     * @param expectedItemSizes The typical sizes of the items that will be
+     *   stored in the cache, in bytes. If these all map to the same page size
+     *   this is equivalent to the constructor above.
+     *
+     * @since 6.0
+     */
+    KSharedDataCache(const QString &cacheName, unsigned defaultCacheSize, const QList<unsigned> &expectedItemSizes);
+
+    /**
+     * Attaches to a shared cache like the constructor, but does so in a
+     * background thread, also reading in the parts of the cache needed by
+     * every lookup. Use this to avoid blocking the main thread while the
+     * cache file is opened and mapped, which can take a noticeable time on a
+     * cold disk.
+     *
+     * @code
+     * auto future = KSharedDataCache::open(QStringLiteral("myapp-cache"), 10 * 1024 * 1024);
+     * future.then(this, [this](const QSharedPointer<KSharedDataCache> &cache) {
+     *     m_cache = cache;
+     * });
+     * @endcode
+     *
+     * @return A future for the cache, see the constructor for the parameters.
+     * @since 6.0
+     */
+    static QFuture<QSharedPointer<KSharedDataCache>> open(const QString &cacheName, unsigned defaultCacheSize, unsigned expectedItemSize = 0);
+
     ~KSharedDataCache();
 
     KSharedDataCache(const KSharedDataCache &) = delete;
@@ -79,8 +133,80 @@ public:
         EvictLeastRecentlyUsed,
         EvictLeastOftenUsed,
         EvictOldest,
+        /**
+         * Evicts the least recently used entries like EvictLeastRecentlyUsed,
+         * but only if the entry to insert was used more often recently than
+         * each of the entries it would replace, otherwise insert() fails.
+         * Uses of keys, both lookups and inserts, are counted in an estimate
+         * that fades over time, so that entries which are only used once,
+         * for example while scanning a large directory, can't push out the
+         * entries which are in use all the time.
+         *
+         * @since 6.0
+         */
+        AdmitFrequentlyUsed,
+    };
+
+    /**
+     * @return true if huge pages were requested for the shared cache.
+     * @see setHugePagesEnabled()
+     * @since 6.0
+     */
+    bool hugePagesEnabled() const;
+
+    /**
+     * Asks the system to back the shared cache with huge pages (2 MiB on
+     * x86-64) instead of regular pages. For large caches this greatly reduces
+     * the TLB misses caused by lookups scattered over the cache.
+     *
+     * This is only a hint, only supported on Linux with transparent huge
+     * pages, and takes effect for the memory of this process only.
+     *
+     * @param enable Whether to use huge pages.
+     * @return true if the request was passed on to the system.
+     * @since 6.0
+     */
+    bool setHugePagesEnabled(bool enable);
+
+    /**
+     * Usage statistics of the shared cache, as returned by statistics().
+     *
+     * The numbers are shared by all processes using the cache and count from
+     * when the cache was created.
+     *
+     * @since 6.0
+     */
+    struct Statistics {
+        quint64 hits = 0; ///< Lookups of data that was found in the cache
+        quint64 misses = 0; ///< Lookups of data that was not found in the cache
+        quint64 negativeHits = 0; ///< Misses of keys recorded by insertNegative()
+        quint64 filteredMisses = 0; ///< Misses answered without taking the cache lock
+        quint64 inserts = 0; ///< Entries successfully inserted
+        quint64 rejections = 0; ///< Entries not inserted, see AdmitFrequentlyUsed
+        quint64 evictions = 0; ///< Entries removed per the EvictionPolicy to make room
+        quint64 collisionEvictions = 0; ///< Entries removed since the index was too crowded
+        quint64 expirations = 0; ///< Expired entries removed, see insert()
+        quint64 defragmentations = 0; ///< Times the cache was compacted
+        quint64 defragmentationTime = 0; ///< Total time spent compacting the cache, in ns
+        quint64 lockWaitTime = 0; ///< Total time spent acquiring the cache lock, in ns
+
+        /**
+         * The number of times acquiring the cache lock took a given time:
+         * the first element counts the waits under 1 µs and every following
+         * one the waits up to twice as long as the previous one, i.e. element
+         * N counts the waits from 2^(N-1) up to 2^N µs. The last element also
+         * counts all longer waits. Empty if not available.
+         */
+        QList<quint64> lockWaitHistogram;
     };
 
+    /**
+     * @return The usage statistics of the shared cache, or all zeroes if
+     *         these are not available.
+     * @since 6.0
+     */
+    Statistics statistics() const;
+
     /**
      * @return The removal policy in use by the shared cache.
      * @see EvictionPolicy
@@ -95,15 +221,219 @@ public:
      */
     void setEvictionPolicy(EvictionPolicy newPolicy);
 
+    /**
+     * @return The maximum number of pages a single insert() moves when
+     *         compacting the cache, 0 if unlimited.
+     * @see setDefragmentationBudget()
+     * @since 6.0
+     */
+    unsigned defragmentationBudget() const;
+
+    /**
+     * Limits how much work a single insert() may spend compacting the cache.
+     *
+     * When an entry does not fit into any contiguous run of free space the
+     * cache is defragmented, which with the default of no limit moves every
+     * used page and stalls all processes using the cache meanwhile. With a
+     * limit set, at most about @p pageCount pages are moved per insert and
+     * the compaction continues with subsequent inserts, keeping the pauses
+     * short. If not enough room was made yet, entries are evicted instead.
+     *
+     * This setting only affects this KSharedDataCache object, not other
+     * processes using the same cache.
+     *
+     * @param pageCount The maximum number of pages to move per insert, or 0
+     *                  for no limit.
+     * @since 6.0
+     */
+    void setDefragmentationBudget(unsigned pageCount);
+
+    /**
+     * @return The size in bytes from which on inserted entries are
+     *         compressed, 0 if compression is disabled.
+     * @see setCompressionThreshold()
+     * @since 6.0
+     */
+    unsigned compressionThreshold() const;
+
+    /**
+     * Enables transparent compression of entries of at least @p size bytes,
+     * allowing to store more data in the same amount of memory at the cost
+     * of some CPU time in insert() and find(). Entries that do not become
+     * smaller are stored as is. The default is no compression.
+     *
+     * Compressed entries are decompressed transparently by every process
+     * using the cache, regardless of its own setting. This setting only
+     * affects the entries inserted through this KSharedDataCache object.
+     *
+     * Note that findView() has to return a decompressed copy of compressed
+     * entries instead of referencing the shared memory directly.
+     *
+     * @param size The minimum size of entries to compress, in bytes, or 0 to
+     *             disable compression.
+     * @since 6.0
+     */
+    void setCompressionThreshold(unsigned size);
+
+    /**
+     * @return The maximum size in bytes of the front cache, 0 if it is
+     *         disabled.
+     * @see setFrontCacheSize()
+     * @since 6.0
+     */
+    uint frontCacheSize() const;
+
+    /**
+     * Enables a front cache of this process, keeping decoded copies of the
+     * entries recently found by find(), up to @p size bytes of keys and data.
+     * The least recently used copies are dropped first.
+     *
+     * Finding a key again returns its copy without taking the shared lock or
+     * decoding the data, as long as no process stored a new entry for the key
+     * in the meantime, or cleared the cache or changed its timestamp. Checking
+     * that takes no lock either.
+     *
+     * Copies of entries that were merely evicted from the shared cache may
+     * still be found, as their data did not change. Finding a copy counts
+     * as a hit in statistics(), but does not update the use count and time
+     * of the entry used by the EvictionPolicy.
+     *
+     * @param size The maximum number of bytes to keep, or 0 to disable the
+     *             front cache, which is the default.
+     * @since 6.0
+     */
+    void setFrontCacheSize(uint size);
+
+    /**
+     * @return The maximum number of bytes queued by insert() in write-behind
+     *         mode, 0 if write-behind is disabled.
+     * @see setWriteBehindLimit()
+     * @since 6.0
+     */
+    uint writeBehindLimit() const;
+
+    /**
+     * Enables the write-behind mode, in which insert() only queues the entry
+     * and returns immediately, so it never waits for the lock, for evictions
+     * or for defragmenting the cache. The queued entries are inserted once
+     * control returns to the event loop of the thread calling this, in
+     * batches taking the shared lock only once.
+     *
+     * Queued entries are not found by lookups until they were inserted, call
+     * flush() to insert them right away. While more than @p size bytes of
+     * keys and data are queued, insert() does not cache further entries and
+     * returns false. Other functions modifying the cache, like insertMany(),
+     * are not queued.
+     *
+     * @param size The maximum number of bytes to queue, or 0 to insert
+     *             entries right away, which is the default.
+     * @see flush()
+     * @since 6.0
+     */
+    void setWriteBehindLimit(uint size);
+
+    /**
+     * Inserts all entries queued by insert() in write-behind mode into the
+     * cache. Does nothing if write-behind is disabled.
+     *
+     * The destructor flushes the queue as well.
+     *
+     * @see setWriteBehindLimit()
+     * @since 6.0
+     */
+    void flush();
+
     /**
      * Attempts to insert the entry @p data into the shared cache, named by
      * @p key, and returns true only if successful.
      *
      * Note that even if the insert was successful, that the newly added entry
-     * may be evicted by other processes contending for the cache.
+     * may be evicted by other processes contending for the cache. In
+     * write-behind mode the entry is only queued, see setWriteBehindLimit().
      */
     bool insert(const QString &key, const QByteArray &data);
 
+    /**
+     * Same as above, but the entry expires @p ttl seconds from now.
+     *
+     * Expired entries are no longer found by find() and the other lookup
+     * functions, and are the first ones removed when room is needed for new
+     * entries, regardless of the eviction policy. This allows to refresh
+     * entries individually instead of invalidating the whole cache at once.
+     *
+     * @param ttl The time in seconds until the entry expires, 0 for never.
+     * @since 6.0
+     */
+    bool insert(const QString &key, const QByteArray &data, unsigned ttl);
+
+    /**
+     * Records that there is no data for @p key, so that applications can
+     * avoid repeating an expensive lookup that is known to fail, and returns
+     * true only if successful. Any entry previously stored for @p key is
+     * replaced.
+     *
+     * The key remains recorded until it expires, is evicted or overwritten by
+     * insert(). find() and contains() do not find it, use containsNegative()
+     * instead. Such an entry occupies no more room than its key.
+     *
+     * @param ttl The time in seconds until the entry expires, 0 for never.
+     * @since 6.0
+     */
+    bool insertNegative(const QString &key, unsigned ttl = 0);
+
+    /**
+     * Inserts all of the given (key, data) pairs into the shared cache, as if by
+     * calling insert() for each of them, but taking the shared lock only once
+     * for the whole batch.
+     *
+     * This is much cheaper than repeated calls to insert() when populating the
+     * cache with many entries at once, as other processes contend for the lock
+     * only once.
+     *
+     * @param entries The pairs of key and data to insert.
+     * @return The number of entries that were successfully inserted.
+     * @see insert()
+     * @since 6.0
+     */
+    int insertMany(const QList<QPair<QString, QByteArray>> &entries);
+
+    /**
+     * Inserts an entry made of @p header followed by @p data under @p key,
+     * laid out so that both start at a 64 byte boundary of the shared memory.
+     * This allows to use the result of findView() in place, e.g. as the
+     * pixel buffer of an image described by @p header, since the data is
+     * suitably aligned for vectorized access. The entry is never compressed.
+     *
+     * The data of the entry as returned by find() and findView() is
+     * @p header, padded with zeros up to alignedDataOffset(), followed by
+     * @p data.
+     *
+     * Example:
+     * @code
+     * cache->insertAligned(key, headerOf(image), QByteArrayView(image.constBits(), image.sizeInBytes()));
+     * // ...
+     * if (auto view = cache->findView(key); view.isValid()) {
+     *     const QByteArrayView pixels = view.data().sliced(KSharedDataCache::alignedDataOffset(sizeof(Header)));
+     *     // Use the pixels, as long as view is alive
+     * }
+     * @endcode
+     *
+     * @param key The key of the entry.
+     * @param header The header of the entry, may be empty.
+     * @param data The rest of the data of the entry.
+     * @return true if the entry was inserted.
+     * @see alignedDataOffset()
+     * @since 6.0
+     */
+    bool insertAligned(const QString &key, QByteArrayView header, QByteArrayView data);
+
+    /**
+     * @return The offset of the data following a header of @p headerSize bytes
+     * in an entry inserted with insertAligned().
+     * @since 6.0
+     */
+    static qsizetype alignedDataOffset(qsizetype headerSize);
+
     /**
      * Returns the data in the cache named by @p key (even if it's some other
      * process's data named with the same key!), stored in @p destination. If there is
@@ -123,7 +453,131 @@ public:
     bool find(const QString &key, QByteArray *destination) const;
 
     /**
-     * Removes all entries from the cache.
+     * Looks up all of the given @p keys in the cache, as if by calling find()
+     * for each of them, but taking the shared lock only once for the whole
+     * batch.
+     *
+     * Every key that is present in the cache is inserted into @p destination
+     * along with its data. Keys which are not present are left out of
+     * @p destination; existing entries in @p destination are not removed.
+     *
+     * @param keys The keys to find in the cache.
+     * @param destination Receives the found entries, may be nullptr if only the
+     *                    number of present keys is of interest.
+     * @return The number of keys that were present in the cache.
+     * @see find()
+     * @since 6.0
+     */
+    int findMany(const QStringList &keys, QHash<QString, QByteArray> *destination) const;
+
+    /**
+     * Tells the system that the entries named by @p keys will be looked up
+     * soon, e.g. the thumbnails of the next page of a view. The pages holding
+     * them are read in in the background, so that the following find() calls
+     * don't wait for them one page fault at a time.
+     *
+     * Nothing is copied and the entries don't count as used, so this is cheap
+     * even for keys that end up not being looked up. The keys are resolved
+     * taking the shared lock only once for the whole batch.
+     *
+     * @param keys The keys of the entries to prefetch.
+     * @return The number of keys that were present in the cache.
+     * @since 6.0
+     */
+    int prefetch(const QStringList &keys) const;
+
+    /**
+     * Information about an entry of the cache, as passed to forEachEntry().
+     * @since 6.0
+     */
+    struct EntryInfo {
+        QString key;
+        unsigned size = 0; ///< The size of the data, in bytes
+        unsigned useCount = 0; ///< How often the entry was looked up, roughly
+        QDateTime addTime; ///< When the entry was inserted
+        QDateTime lastUsedTime; ///< When the entry was last looked up
+        QDateTime expiryTime; ///< When the entry expires, invalid if never
+    };
+
+    /**
+     * Calls @p callback for every entry in the cache, in the order the entries
+     * are stored in memory so that the cache is read sequentially, until
+     * @p callback returns false.
+     *
+     * The entries are copied out of the cache in batches, and @p callback is
+     * called without the cache locked, so it may use the cache as well.
+     * Entries removed in the meantime are skipped, as are expired ones.
+     *
+     * @param callback Receives the information and the data of each entry,
+     *                 the data is only valid during the call.
+     * @return The number of entries @p callback was called for.
+     * @see importFrom()
+     * @since 6.0
+     */
+    int forEachEntry(const std::function<bool(const EntryInfo &info, QByteArrayView data)> &callback) const;
+
+    /**
+     * Inserts all entries of the cache @p source into this cache, for instance
+     * to carry over the contents of a cache with a different name or size
+     * after an upgrade. The remaining time to live of the entries is kept.
+     *
+     * @return The number of entries inserted.
+     * @see forEachEntry()
+     * @since 6.0
+     */
+    int importFrom(const KSharedDataCache &source);
+
+    class EntryView;
+
+    /**
+     * Looks up the entry named by @p key like find(), but instead of copying
+     * the data it returns a view directly on the shared memory holding it.
+     * This avoids a copy for large entries which are decoded right away.
+     *
+     * Example:
+     * @code
+     * if (auto view = cache->findView(key); view.isValid()) {
+     *     image.loadFromData(view.data());
+     * }
+     * @endcode
+     *
+     * @param key The key to find in the cache.
+     * @return A view on the data of the entry, invalid if @p key is not present.
+     * @see EntryView
+     * @since 6.0
+     */
+    EntryView findView(const QString &key) const;
+
+    class Namespace;
+
+    /**
+     * Opens the namespace @p name of this cache, registering it if no process
+     * did so yet. The entries of each namespace are kept apart from those of
+     * the other namespaces and from the entries inserted into the cache
+     * directly, but they all share the memory of the cache, so that memory is
+     * not left unused by one namespace while another one needs it.
+     *
+     * This allows applications to use a single cache for several kinds of
+     * data, instead of one small cache for each kind.
+     *
+     * A cache holds up to 32 namespaces, which stay registered until the cache
+     * is deleted. Namespaces are not supported for caches with size classes.
+     *
+     * @param name The name of the namespace.
+     * @param quota The maximum size in bytes of the entries of the namespace,
+     *   0 for no limit. When an entry does not fit anymore, the least recently
+     *   used entries of the namespace are evicted. The quota is shared by all
+     *   processes using the namespace, the one opening it last decides.
+     * @return The namespace, invalid if there is no room for another one.
+     * @see Namespace
+     * @since 6.0
+     */
+    Namespace openNamespace(const QString &name, unsigned quota = 0);
+
+    /**
+     * Removes all entries from the cache, except for those a live EntryView
+     * refers to, and returns their memory to the system like
+     * releaseFreeMemory().
      */
     void clear();
 
@@ -146,6 +600,14 @@ public:
      */
     bool contains(const QString &key) const;
 
+    /**
+     * Returns true if the cache currently records that there is no data for
+     * @p key, as inserted by insertNegative().
+     *
+     * @since 6.0
+     */
+    bool containsNegative(const QString &key) const;
+
     /**
      * Returns the usable cache size in bytes. The actual amount of memory
      * used will be slightly larger than this to account for required
@@ -161,6 +623,28 @@ public:
      */
     unsigned freeSize() const;
 
+    /**
+     * Returns the memory of the free space in the cache to the system.
+     *
+     * Pages freed by evictions or removals otherwise stay in memory, and count
+     * towards the memory of every process using the cache, until new entries
+     * are written to them. Call this e.g. when the system is short on memory:
+     * @code
+     * connect(&sampler, &KMemoryInfoSampler::memoryPressure, this, [cache]() {
+     *     cache->releaseFreeMemory();
+     * });
+     * @endcode
+     *
+     * The memory is released for all processes using the cache. Only supported
+     * on Linux, with caches on file systems that can punch holes into files,
+     * e.g. ext4, XFS, Btrfs or tmpfs. The disk space of the released memory
+     * stays reserved for the cache.
+     *
+     * @return the number of bytes released, 0 if not supported
+     * @since 6.0
+     */
+    qint64 releaseFreeMemory();
+
     /**
      * @return The shared timestamp of the cache. The interpretation of the
      *         timestamp returned is up to the application. KSharedDataCache
@@ -205,9 +689,194 @@ public:
      */
     void setTimestamp(unsigned newTimestamp);
 
+    /**
+     * Changes the size of the cache to @p newCacheSize bytes, keeping its
+     * entries, as far as they fit.
+     *
+     * The entries are copied into a new cache file, which then replaces the
+     * current one. Other processes using the cache move over to the new file
+     * the next time they access it. Entries they insert in the meantime may
+     * get lost.
+     *
+     * Resizing fails while an EntryView returned by findView() is alive.
+     *
+     * @return true if the cache was resized
+     * @since 6.0
+     */
+    bool resize(unsigned newCacheSize);
+
+    /**
+     * Returns a counter that changes whenever entries of the cache become
+     * invalid in any of the processes sharing it: when the cache is cleared,
+     * its timestamp changes, or an entry is replaced or removed. Entries that
+     * are merely evicted to make room don't count.
+     *
+     * Reading it is cheap and takes no lock. Applications keeping decoded
+     * copies of cached entries can compare it to the value they saw last,
+     * instead of validating their copies on every access.
+     *
+     * @see setInvalidationCallback()
+     * @since 6.0
+     */
+    quint64 invalidationCount() const;
+
+    /**
+     * Calls @p callback whenever invalidationCount() changed, no matter which
+     * process invalidated the entries.
+     *
+     * The cache looks for changes every @p interval, using a timer in the
+     * calling thread, which therefore needs to run an event loop. The callback
+     * is called in that thread. Pass an empty function to stop.
+     *
+     * @see invalidationCount()
+     * @since 6.0
+     */
+    void setInvalidationCallback(const std::function<void()> &callback, std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+
 private:
+    friend struct WriteBehindQueue;
+    bool insertImmediately(const QString &key, const QByteArray &data, unsigned ttl);
+
     class Private;
     Private *d;
 };
 
+/**
+ * @class KSharedDataCache::EntryView kshareddatacache.h KSharedDataCache
+ *
+ * A read-only view on the data of a single cache entry, as returned by
+ * findView(). The view refers directly to the shared memory of the cache,
+ * so the data is not copied.
+ *
+ * While a valid view exists its entry is pinned in place: the cache is not
+ * locked and can be used as usual, but the entry is neither evicted nor
+ * moved, and inserting or removing its key fails until the view is
+ * destroyed. Views should therefore be kept only as long as needed to decode
+ * the data, since their pages can't make room for other entries.
+ *
+ * A view must be destroyed before the KSharedDataCache it was found in. While
+ * views are alive the cache is not reset or resized, even if found corrupt.
+ * The data of a view may also be a copy, if too many caches in all processes
+ * pin entries at the same time.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KSharedDataCache::EntryView
+{
+public:
+    EntryView();
+    ~EntryView();
+
+    EntryView(EntryView &&other) noexcept;
+    EntryView &operator=(EntryView &&other) noexcept;
+    EntryView(const EntryView &) = delete;
+    EntryView &operator=(const EntryView &) = delete;
+
+    /**
+     * @return true if the entry was found, false otherwise.
+     */
+    bool isValid() const;
+
+    /**
+     * @return The data of the entry, valid as long as this view is alive.
+     *         Empty if the view is not valid.
+     */
+    QByteArrayView data() const;
+
+private:
+    friend class KSharedDataCache;
+    const KSharedDataCache::Private *d = nullptr;
+    QByteArrayView m_data;
+    QByteArray m_buffer; // The data if not referencing the shared memory
+    uint m_keyHash = 0; // Identifies the pinned entry, with m_firstPage
+    qint32 m_firstPage = -1;
+};
+
+/**
+ * @class KSharedDataCache::Namespace kshareddatacache.h KSharedDataCache
+ *
+ * A namespace of entries within a KSharedDataCache, as returned by
+ * KSharedDataCache::openNamespace(). Keys of different namespaces never
+ * clash, and each namespace keeps its own quota and usage statistics.
+ *
+ * A namespace refers to the KSharedDataCache it was opened from and must not
+ * be used after that was destroyed.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KSharedDataCache::Namespace
+{
+public:
+    /**
+     * Constructs an invalid namespace.
+     */
+    Namespace();
+
+    /**
+     * @return true if the namespace can be used.
+     */
+    bool isValid() const;
+
+    /**
+     * @return The name of the namespace.
+     */
+    QString name() const;
+
+    /**
+     * Inserts the entry @p data named by @p key into the namespace, like
+     * KSharedDataCache::insert(), and returns true only if successful.
+     * Entries are inserted right away, even in write-behind mode.
+     */
+    bool insert(const QString &key, const QByteArray &data, unsigned ttl = 0);
+
+    /**
+     * Looks up the entry named by @p key in the namespace, like
+     * KSharedDataCache::find().
+     */
+    bool find(const QString &key, QByteArray *destination) const;
+
+    /**
+     * @return true if the namespace contains an entry named by @p key.
+     */
+    bool contains(const QString &key) const;
+
+    /**
+     * Prefetches the entries named by @p keys in the namespace, like
+     * KSharedDataCache::prefetch().
+     */
+    int prefetch(const QStringList &keys) const;
+
+    /**
+     * Removes all entries of the namespace from the cache.
+     */
+    void clear();
+
+    /**
+     * @return The maximum size in bytes of the entries of the namespace, 0
+     *         if not limited.
+     */
+    unsigned quota() const;
+
+    /**
+     * @return The size in bytes of the entries of the namespace, counted in
+     *         pages of the cache.
+     */
+    unsigned usedSize() const;
+
+    /**
+     * @return The usage statistics of the namespace. Only the hits, misses,
+     *         inserts and evictions are counted per namespace, evictions
+     *         including those to make room in the whole cache.
+     */
+    Statistics statistics() const;
+
+private:
+    friend class KSharedDataCache;
+    KSharedDataCache *m_cache = nullptr;
+    QString m_name;
+    QString m_prefix; // Prepended to the keys of the namespace
+    quint32 m_nameHash = 0;
+    unsigned m_quota = 0;
+};
+
 #endif
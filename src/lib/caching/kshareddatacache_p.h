@@ -11,9 +11,19 @@
 
 #include "kcoreaddons_debug.h"
 
+#include <QDir>
+#include <QFile>
+
 #include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#else
 #include <fcntl.h>
 #include <unistd.h> // for _POSIX_ADVISORY_INFO
+#endif
 
 // posix_fallocate is used to ensure that the file used for the cache is
 // actually fully committed to disk before attempting to use the file.
@@ -27,7 +37,13 @@
 
 static bool ensureFileAllocated(int fd, size_t fileSize)
 {
-#ifdef KSDC_POSIX_FALLOCATE_SUPPORTED
+#if defined(Q_OS_WIN)
+    // Extending a file on Windows allocates the space unless the file was
+    // explicitly made sparse, so resizing it is enough.
+    Q_UNUSED(fd);
+    Q_UNUSED(fileSize);
+    return true;
+#elif defined(KSDC_POSIX_FALLOCATE_SUPPORTED)
     int result;
     while ((result = ::posix_fallocate(fd, 0, fileSize)) == EINTR) {
         ;
@@ -63,4 +79,26 @@ static bool ensureFileAllocated(int fd, size_t fileSize)
 #endif // KSDC_POSIX_FALLOCATE_SUPPORTED
 }
 
+// Atomically replaces the file @p to with the file @p from, even while other
+// processes have @p to mapped.
+static bool replaceFile(const QString &from, const QString &to)
+{
+#ifdef Q_OS_WIN
+    // Works as the mappings keep the file open with FILE_SHARE_DELETE, see
+    // KSDCMapping::mapMemory().
+    if (!::MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(to).utf16()),
+                       MOVEFILE_REPLACE_EXISTING)) {
+        qCWarning(KCOREADDONS_DEBUG) << "Failed to replace" << to << "with" << from << ":" << ::GetLastError();
+        return false;
+    }
+#else
+    if (::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) != 0) {
+        qCWarning(KCOREADDONS_DEBUG) << "Failed to replace" << to << "with" << from << ":" << strerror(errno);
+        return false;
+    }
+#endif
+    return true;
+}
+
 #endif /* KSHAREDDATACACHE_P_H */
@@ -1,3 +1,7 @@
 #cmakedefine01 HAVE_SYS_INOTIFY_H
+#cmakedefine01 HAVE_SYS_FANOTIFY_H
+#cmakedefine01 HAVE_FSEVENTS
+#cmakedefine01 HAVE_READDIRECTORYCHANGESW
+#cmakedefine01 HAVE_STATX
 
 #cmakedefine01 HAVE_QTDBUS
@@ -22,9 +22,18 @@ static const int maxNameLength = NAME_MAX;
 #include "krandom.h"
 #include <QCoreApplication>
 #include <QDir>
+#include <QDirIterator>
 #include <QLatin1Char>
 #include <QLockFile>
+#include <QMutex>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+
+#include <chrono>
+#include <optional>
 
 class KAutoSaveFilePrivate
 {
@@ -34,26 +43,106 @@ public:
     };
 
     QString tempFileName();
+
+    // Starts writing the pending snapshot in the thread pool, with snapshotMutex locked
+    void startWritingSnapshot();
+    // Writes the pending snapshots, in the thread pool
+    void writeSnapshots();
+    // Drops the pending snapshot, and waits for the one being written
+    void cancelSnapshots();
+
     QUrl managedFile;
     QLockFile *lock = nullptr;
     bool managedFileNameChanged = false;
+
+    struct Snapshot {
+        QByteArray data;
+        QString fileName;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    QTimer *snapshotTimer = nullptr;
+    int snapshotInterval = 1000;
+    // Guards the members below, which are shared with the thread writing the snapshots
+    mutable QMutex snapshotMutex;
+    QWaitCondition snapshotsWritten;
+    std::optional<Snapshot> pendingSnapshot;
+    bool writingSnapshots = false;
+    KAutoSaveFile::SnapshotStatistics snapshotStatistics;
 };
 
-static QStringList findAllStales(const QString &appName)
+void KAutoSaveFilePrivate::startWritingSnapshot()
+{
+    if (!pendingSnapshot || writingSnapshots) {
+        // A snapshot passed while one is being written is written right after it
+        return;
+    }
+    writingSnapshots = true;
+    QThreadPool::globalInstance()->start([this]() {
+        writeSnapshots();
+    });
+}
+
+void KAutoSaveFilePrivate::writeSnapshots()
+{
+    QMutexLocker locker(&snapshotMutex);
+    while (pendingSnapshot) {
+        const Snapshot snapshot = std::move(*pendingSnapshot);
+        pendingSnapshot.reset();
+        locker.unlock();
+
+        // Written to a temporary file, which then replaces the autosave file
+        QSaveFile file(snapshot.fileName);
+        file.setDirectWriteFallback(false);
+        const bool written = file.open(QIODevice::WriteOnly) && file.write(snapshot.data) == snapshot.data.size() && file.commit();
+        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - snapshot.time);
+
+        locker.relock();
+        if (written) {
+            ++snapshotStatistics.writtenCount;
+            snapshotStatistics.lastLatency = latency.count();
+            snapshotStatistics.maxLatency = std::max(snapshotStatistics.maxLatency, snapshotStatistics.lastLatency);
+        } else {
+            ++snapshotStatistics.failedCount;
+            qCWarning(KCOREADDONS_DEBUG) << "Could not write snapshot to" << snapshot.fileName << file.errorString();
+        }
+    }
+    writingSnapshots = false;
+    snapshotsWritten.wakeAll();
+}
+
+void KAutoSaveFilePrivate::cancelSnapshots()
+{
+    if (snapshotTimer) {
+        snapshotTimer->stop();
+    }
+    QMutexLocker locker(&snapshotMutex);
+    if (pendingSnapshot) {
+        pendingSnapshot.reset();
+        ++snapshotStatistics.droppedCount;
+    }
+    while (writingSnapshots) {
+        snapshotsWritten.wait(&snapshotMutex);
+    }
+}
+
+// Lists the stale files of appName, only the ones whose name starts with
+// namePrefix if it isn't empty
+static QStringList findAllStales(const QString &appName, const QString &namePrefix = QString())
 {
     const QStringList dirs = QStandardPaths::standardLocations(QStandardPaths::GenericDataLocation);
     QStringList files;
 
+    // The names are percent-encoded, so there are no wildcard characters in namePrefix.
+    // A QDirIterator doesn't sort the names like QDir::entryList() would.
+    const QStringList nameFilters = namePrefix.isEmpty() ? QStringList() : QStringList{namePrefix + QLatin1Char('*')};
     const QString suffix = QLatin1String("/stalefiles/") + appName;
     for (const QString &dir : dirs) {
-        QDir appDir(dir + suffix);
-        const QString absPath = appDir.absolutePath() + QLatin1Char('/');
-        qCDebug(KCOREADDONS_DEBUG) << "Looking in" << appDir.absolutePath();
-        QStringList listFiles = appDir.entryList(QDir::Files);
-        for (QString &file : listFiles) {
-            file.prepend(absPath);
+        qCDebug(KCOREADDONS_DEBUG) << "Looking in" << dir + suffix;
+        QDirIterator it(dir + suffix, nameFilters, QDir::Files | QDir::CaseSensitive);
+        while (it.hasNext()) {
+            files.append(QDir::cleanPath(it.next()));
         }
-        files += listFiles;
     }
     return files;
 }
@@ -116,6 +205,9 @@ void KAutoSaveFile::setManagedFile(const QUrl &filename)
 
 void KAutoSaveFile::releaseLock()
 {
+    // Snapshots would otherwise write the file again after it got removed
+    d->cancelSnapshots();
+
     if (d->lock && d->lock->isLocked()) {
         delete d->lock;
         d->lock = nullptr;
@@ -164,6 +256,62 @@ bool KAutoSaveFile::open(OpenMode openmode)
     return false;
 }
 
+bool KAutoSaveFile::writeSnapshot(const QByteArray &data)
+{
+    if (!d->lock || !d->lock->isLocked()) {
+        return false;
+    }
+
+    if (!d->snapshotTimer) {
+        d->snapshotTimer = new QTimer(this);
+        d->snapshotTimer->setSingleShot(true);
+        connect(d->snapshotTimer, &QTimer::timeout, this, [this]() {
+            QMutexLocker locker(&d->snapshotMutex);
+            d->startWritingSnapshot();
+        });
+    }
+
+    QMutexLocker locker(&d->snapshotMutex);
+    if (d->pendingSnapshot) {
+        ++d->snapshotStatistics.droppedCount;
+    }
+    d->pendingSnapshot = KAutoSaveFilePrivate::Snapshot{data, fileName(), std::chrono::steady_clock::now()};
+    locker.unlock();
+
+    if (!d->snapshotTimer->isActive()) {
+        d->snapshotTimer->start(d->snapshotInterval);
+    }
+    return true;
+}
+
+void KAutoSaveFile::flushSnapshot()
+{
+    if (d->snapshotTimer) {
+        d->snapshotTimer->stop();
+    }
+    QMutexLocker locker(&d->snapshotMutex);
+    d->startWritingSnapshot();
+    while (d->writingSnapshots) {
+        d->snapshotsWritten.wait(&d->snapshotMutex);
+    }
+}
+
+void KAutoSaveFile::setSnapshotInterval(int msecs)
+{
+    d->snapshotInterval = std::max(msecs, 0);
+}
+
+int KAutoSaveFile::snapshotInterval() const
+{
+    return d->snapshotInterval;
+}
+
+KAutoSaveFile::SnapshotStatistics KAutoSaveFile::snapshotStatistics() const
+{
+    QMutexLocker locker(&d->snapshotMutex);
+    return d->snapshotStatistics;
+}
+
 static QUrl extractManagedFilePath(const QString &staleFileName)
 {
     const QStringView stale{staleFileName};
@@ -203,14 +351,14 @@ QList<KAutoSaveFile *> KAutoSaveFile::staleFiles(const QUrl &filename, const QSt
         appName = QCoreApplication::instance()->applicationName();
     }
 
-    // get stale files
-    const QStringList files = findAllStales(appName);
+    // get stale files, the ones of filename begin with its encoded name
+    const QStringList files = findAllStales(appName, filename.isEmpty() ? QString() : QString::fromLatin1(QUrl::toPercentEncoding(filename.fileName())));
 
     QList<KAutoSaveFile *> list;
 
     // contruct a KAutoSaveFile for stale files corresponding given filename
     for (const QString &file : files) {
-        if (file.endsWith(QLatin1String(".lock")) || (!filename.isEmpty() && !staleMatchesManaged(QFileInfo(file).fileName(), filename))) {
+        if (file.endsWith(QLatin1String(".lock")) || (!filename.isEmpty() && !staleMatchesManaged(file.mid(file.lastIndexOf(QLatin1Char('/')) + 1), filename))) {
             continue;
         }
 
@@ -193,6 +193,76 @@ public:
      */
     bool open(OpenMode openmode) override;
 
+    /**
+     * Statistics about the snapshots written by writeSnapshot().
+     *
+     * @see snapshotStatistics()
+     * @since 6.0
+     */
+    struct SnapshotStatistics {
+        /** The number of snapshots written to the autosave file */
+        int writtenCount = 0;
+        /** The number of snapshots dropped because a newer one was passed before they were written */
+        int droppedCount = 0;
+        /** The number of snapshots that could not be written */
+        int failedCount = 0;
+        /** The time from passing the last snapshot written to writeSnapshot() until it was written, in microseconds */
+        qint64 lastLatency = 0;
+        /** The longest time from passing a snapshot to writeSnapshot() until it was written, in microseconds */
+        qint64 maxLatency = 0;
+    };
+
+    /**
+     * Replaces the contents of the autosave file with @p data, without
+     * blocking the calling thread.
+     *
+     * The snapshot is written in a thread of the global QThreadPool, after
+     * the snapshot interval (see setSnapshotInterval()) passed. If another
+     * snapshot is passed before, only the newer one is written. The snapshot
+     * is written to a temporary file first, which then replaces the autosave
+     * file, so that the autosave file always holds a complete snapshot.
+     *
+     * The file has to be opened with open() first, for it to be locked. Don't
+     * write to it through QFile as well.
+     *
+     * This needs an event loop running in the thread of the KAutoSaveFile.
+     *
+     * @param data the whole content of the autosave file
+     * @return @c false if the file isn't locked, @c true otherwise
+     * @see flushSnapshot()
+     * @since 6.0
+     */
+    bool writeSnapshot(const QByteArray &data);
+
+    /**
+     * Writes the snapshot passed to writeSnapshot() right away, if it isn't
+     * written yet, and waits until it is.
+     *
+     * @since 6.0
+     */
+    void flushSnapshot();
+
+    /**
+     * Sets the time to wait after writeSnapshot() before writing the snapshot.
+     * The default is one second.
+     *
+     * @param msecs the interval in milliseconds
+     * @since 6.0
+     */
+    void setSnapshotInterval(int msecs);
+
+    /**
+     * @return the time to wait after writeSnapshot() before writing the snapshot, in milliseconds
+     * @since 6.0
+     */
+    int snapshotInterval() const;
+
+    /**
+     * @return statistics about the snapshots passed to writeSnapshot()
+     * @since 6.0
+     */
+    SnapshotStatistics snapshotStatistics() const;
+
     /**
      * Checks for stale autosave files for the file @p url. Returns a list
      * of autosave files that contain autosaved data left behind by
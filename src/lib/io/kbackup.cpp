@@ -15,9 +15,101 @@
 #include <QDir>
 #include <QFileInfo>
 
+#include <algorithm>
+#include <optional>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Same as QFile::copy(), but lets the file system share the data of the files
+// (FICLONE) or at least copies it in the kernel on Linux
+static bool copyFile(const QString &from, const QString &to, KBackup::CopyMethod *method = nullptr)
+{
+#ifdef Q_OS_LINUX
+    const int in = open(QFile::encodeName(from).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        return false;
+    }
+    struct stat buf;
+    // Like QFile::copy(), fails if the target exists already
+    const int out = fstat(in, &buf) == 0 ? open(QFile::encodeName(to).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600) : -1;
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    // Copies all of in to out with copy, which returns the number of bytes copied
+    // from offset on, or -1 on failure
+    const auto copyAll = [&](const auto &copy) {
+        for (off_t offset = 0; offset < buf.st_size;) {
+            const ssize_t n = copy(offset, buf.st_size - offset);
+            if (n <= 0) {
+                // Drop what got copied, for the next method to start over
+                const int truncated = ftruncate(out, 0);
+                Q_UNUSED(truncated)
+                return false;
+            }
+            offset += n;
+        }
+        return true;
+    };
+
+    std::optional<KBackup::CopyMethod> usedMethod;
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0) {
+        usedMethod = KBackup::Reflink;
+    }
+#endif
+    if (!usedMethod && copyAll([&](off_t offset, size_t count) {
+            off_t inOffset = offset;
+            off_t outOffset = offset;
+            return copy_file_range(in, &inOffset, out, &outOffset, count, 0);
+        })) {
+        usedMethod = KBackup::CopyFileRange;
+    }
+    // sendfile() writes at the offset of out, which the methods above left at 0
+    if (!usedMethod && copyAll([&](off_t offset, size_t count) {
+            return sendfile(out, in, &offset, count);
+        })) {
+        usedMethod = KBackup::SendFile;
+    }
+    // Like QFile::copy(), the copy gets the permissions of the original
+    const bool copied = usedMethod && fchmod(out, buf.st_mode & 07777) == 0;
+    close(out);
+    close(in);
+    if (copied) {
+        if (method) {
+            *method = *usedMethod;
+        }
+        return true;
+    }
+
+    // e.g. none of the methods is supported, or the file changed while copying
+    QFile::remove(to);
+#endif
+    if (!QFile::copy(from, to)) {
+        return false;
+    }
+    if (method) {
+        *method = KBackup::ReadWrite;
+    }
+    return true;
+}
+
 namespace KBackup
 {
 bool simpleBackupFile(const QString &qFilename, const QString &backupDir, const QString &backupExtension)
+{
+    return simpleBackupFile(qFilename, backupDir, backupExtension, nullptr);
+}
+
+bool simpleBackupFile(const QString &qFilename, const QString &backupDir, const QString &backupExtension, CopyMethod *method)
 {
     QString backupFileName = qFilename + backupExtension;
 
@@ -28,7 +120,7 @@ bool simpleBackupFile(const QString &qFilename, const QString &backupDir, const
 
     //    qCDebug(KCOREADDONS_DEBUG) << "KBackup copying " << qFilename << " to " << backupFileName;
     QFile::remove(backupFileName);
-    return QFile::copy(qFilename, backupFileName);
+    return copyFile(qFilename, backupFileName, method);
 }
 
 bool numberedBackupFile(const QString &qFilename, const QString &backupDir, const QString &backupExtension, const uint maxBackups)
@@ -85,7 +177,56 @@ bool numberedBackupFile(const QString &qFilename, const QString &backupDir, cons
 
     // Finally create most recent backup by copying the file to backup number 1.
     //    qCDebug(KCOREADDONS_DEBUG) << "KBackup copying " << qFilename << " to " << sTemplate.arg(1);
-    return QFile::copy(qFilename, sTemplate.arg(1));
+    return copyFile(qFilename, sTemplate.arg(1));
+}
+
+bool sequencedBackupFile(const QString &qFilename, const QString &backupDir, const QString &backupExtension, const uint maxBackups)
+{
+    QFileInfo fileInfo(qFilename);
+
+    // The backup file name template.
+    QString sTemplate;
+    if (backupDir.isEmpty()) {
+        sTemplate = qFilename + QLatin1String(".%1") + backupExtension;
+    } else {
+        sTemplate = backupDir + QLatin1Char('/') + fileInfo.fileName() + QLatin1String(".%1") + backupExtension;
+    }
+
+    // Find the numbers of the existing backup files, only their names are needed
+    QDir d = backupDir.isEmpty() ? fileInfo.dir() : backupDir;
+    const QString prefix = fileInfo.fileName() + QLatin1Char('.');
+    const QStringList names =
+        d.entryList(QStringList(prefix + QLatin1Char('*') + backupExtension), QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDir::NoSort);
+    QList<uint> numbers;
+    numbers.reserve(names.size());
+    for (const QString &name : names) {
+        if (name.size() > prefix.size() + backupExtension.size() && name.startsWith(prefix) && name.endsWith(backupExtension)) {
+            bool ok;
+            const uint num = QStringView(name).mid(prefix.size(), name.size() - prefix.size() - backupExtension.size()).toUInt(&ok);
+            if (ok) {
+                numbers.append(num);
+            }
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    // The next number might have been taken since listing, by another process
+    // backing up the same file
+    uint number = numbers.isEmpty() ? 1 : numbers.last() + 1;
+    bool copied = false;
+    for (int attempt = 0; attempt < 3 && !copied && number != 0; ++attempt, ++number) {
+        copied = copyFile(qFilename, sTemplate.arg(number));
+    }
+    if (!copied) {
+        return false;
+    }
+
+    // Finally remove the oldest backups, keeping the new one
+    const qsizetype keep = std::max(maxBackups, 1u) - 1;
+    for (qsizetype i = 0; i < numbers.size() - keep; ++i) {
+        QFile::remove(sTemplate.arg(numbers.at(i)));
+    }
+    return true;
 }
 
 }
@@ -33,6 +33,35 @@ namespace KBackup
  */
 KCOREADDONS_EXPORT bool simpleBackupFile(const QString &filename, const QString &backupDir = QString(), const QString &backupExtension = QStringLiteral("~"));
 
+/**
+ * The ways a backup file can be created, from the cheapest to the most expensive one.
+ *
+ * @see simpleBackupFile(const QString &, const QString &, const QString &, CopyMethod *)
+ * @since 6.0
+ */
+enum CopyMethod {
+    Reflink, ///< The backup shares the data of the file, as supported by btrfs or XFS (FICLONE on Linux)
+    CopyFileRange, ///< The data got copied by the kernel, or the file system (copy_file_range() on Linux)
+    SendFile, ///< The data got copied by the kernel (sendfile() on Linux)
+    ReadWrite, ///< The data got read and written by the application
+};
+
+/**
+ * @brief Function to create a backup file for a given filename.
+ *
+ * Same as simpleBackupFile(const QString &, const QString &, const QString &),
+ * but reports how the backup file was created.
+ *
+ * @param filename the file to backup
+ * @param backupDir directory where to save the backup file in.
+ * If empty, the backup will be in the same directory as @p filename.
+ * @param backupExtension the extension to append to @p filename
+ * @param method set to the way the backup was created if successful, may be @c nullptr
+ * @return true if successful, or false if an error has occurred.
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT bool simpleBackupFile(const QString &filename, const QString &backupDir, const QString &backupExtension, CopyMethod *method);
+
 /**
  * @brief Function to create a backup file for a given filename.
  *
@@ -64,6 +93,38 @@ KCOREADDONS_EXPORT bool numberedBackupFile(const QString &filename,
                                            const QString &backupDir = QString(),
                                            const QString &backupExtension = QStringLiteral("~"),
                                            const uint maxBackups = 10);
+
+/**
+ * @brief Function to create a backup file for a given filename.
+ *
+ * Like numberedBackupFile(), this function creates a series of numbered
+ * backup files of the form \<name\>.\<number\>\<extension\>, but the
+ * existing backup files are never renamed. Instead the new backup file gets
+ * the number following the highest one found, so the newest backup file has
+ * the highest number. The backup files with the lowest numbers are removed
+ * so that at most @p maxBackups of them are left.
+ *
+ * This is considerably cheaper than numberedBackupFile() on slow file systems,
+ * like network mounts. Where the file system supports it, the backup file
+ * shares the data of @p filename instead of being a full copy (a "reflink").
+ *
+ * Don't mix it with numberedBackupFile() for the same backup files, they
+ * order them differently.
+ *
+ * @param filename the file to backup
+ * @param backupDir optional directory where to save the backup file in.
+ * If empty (the default), the backup will be in the same directory as
+ * @p filename.
+ * @param backupExtension the extension to append to @p filename,
+ * which is "~" by default.  Do not use an extension containing digits.
+ * @param maxBackups the maximum number of backup files permitted, at least 1
+ * @return true if successful, or false if an error has occurred.
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT bool sequencedBackupFile(const QString &filename,
+                                            const QString &backupDir = QString(),
+                                            const QString &backupExtension = QStringLiteral("~"),
+                                            const uint maxBackups = 10);
 }
 
 #endif
@@ -33,14 +33,19 @@
 #include "kcoreaddons_debug.h"
 #include "kdirwatch_p.h"
 #include "kfilesystemtype.h"
+#include "kmemoryfootprint_p.h"
 #include "knetworkmounts.h"
+#include "ktracing_p.h"
 
 #include <io/config-kdirwatch.h>
 
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLoggingCategory>
+#include <QSaveFile>
 #include <QSocketNotifier>
 #include <QThread>
 #include <QThreadStorage>
@@ -53,6 +58,8 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <utility>
 
 #if HAVE_SYS_INOTIFY_H
 #include <fcntl.h>
@@ -70,10 +77,21 @@
 // debug
 #include <sys/ioctl.h>
 
+#include <poll.h>
+
 #include <sys/utsname.h>
 
 #endif // HAVE_SYS_INOTIFY_H
 
+#if HAVE_STATX
+#include <fcntl.h> // AT_FDCWD, AT_STATX_*
+#endif
+
+#if HAVE_SYS_FANOTIFY_H
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+#endif
+
 Q_DECLARE_LOGGING_CATEGORY(KDIRWATCH)
 // logging category for this framework, default: log stuff >= warning
 Q_LOGGING_CATEGORY(KDIRWATCH, "kf.coreaddons.kdirwatch", QtWarningMsg)
@@ -102,6 +120,18 @@ static KDirWatch::Method methodFromString(const QByteArray &method)
         return KDirWatch::Stat;
     } else if (method == "QFSWatch") {
         return KDirWatch::QFSWatch;
+#if HAVE_SYS_FANOTIFY_H
+    } else if (method == "FANotify") {
+        return KDirWatch::FANotify;
+#endif
+#if HAVE_FSEVENTS
+    } else if (method == "FSEvents") {
+        return KDirWatch::FSEvents;
+#endif
+#if HAVE_READDIRECTORYCHANGESW
+    } else if (method == "ReadDirectoryChanges") {
+        return KDirWatch::ReadDirectoryChanges;
+#endif
     } else {
 #if HAVE_SYS_INOTIFY_H
         // inotify supports delete+recreate+modify, which QFSWatch doesn't support
@@ -112,6 +142,13 @@ static KDirWatch::Method methodFromString(const QByteArray &method)
     }
 }
 
+#if HAVE_FSEVENTS
+// The method of m_treeWatcher
+static const KDirWatch::Method s_treeMethod = KDirWatch::FSEvents;
+#elif HAVE_READDIRECTORYCHANGESW
+static const KDirWatch::Method s_treeMethod = KDirWatch::ReadDirectoryChanges;
+#endif
+
 static const char *methodToString(KDirWatch::Method method)
 {
     switch (method) {
@@ -121,6 +158,12 @@ static const char *methodToString(KDirWatch::Method method)
         return "Stat";
     case KDirWatch::QFSWatch:
         return "QFSWatch";
+    case KDirWatch::FANotify:
+        return "FANotify";
+    case KDirWatch::FSEvents:
+        return "FSEvents";
+    case KDirWatch::ReadDirectoryChanges:
+        return "ReadDirectoryChanges";
     }
     // not reached
     return nullptr;
@@ -130,6 +173,74 @@ static const char s_envNfsPoll[] = "KDIRWATCH_NFSPOLLINTERVAL";
 static const char s_envPoll[] = "KDIRWATCH_POLLINTERVAL";
 static const char s_envMethod[] = "KDIRWATCH_METHOD";
 static const char s_envNfsMethod[] = "KDIRWATCH_NFSMETHOD";
+static const char s_envCoalesce[] = "KDIRWATCH_COALESCEINTERVAL";
+static const char s_envInotifyBudget[] = "KDIRWATCH_MAXINOTIFYWATCHES";
+static const char s_envInotifyThread[] = "KDIRWATCH_INOTIFYTHREAD";
+
+// How often slotRebalanceWatches() hands the inotify watches of the least
+// active entries to the most active ones waiting for one, in ms
+static const int s_rebalanceInterval = 30000;
+
+// The number of bytes at the start and at the end of a file that are part of
+// its fingerprint, see contentFingerprint()
+static const qint64 s_fingerprintBlockSize = 4096;
+
+// The number of entries slotRegisterPending() adds per event loop iteration
+static const int s_registrationBatchSize = 256;
+
+// The number of entries slotRecoverOverflow() scans per event loop iteration
+static const int s_overflowBatchSize = 256;
+
+// The number of threads, and the maximum number of entries per job, of the
+// stat() calls run by slotStatRescan()
+static const int s_statThreadCount = 4;
+static const int s_statBatchSize = 64;
+
+// On network filesystems, only every this many StatMode scans of an entry ask
+// the server, the others take the attributes cached by the client
+static const int s_networkSyncInterval = 4;
+
+// The format of KDirWatch::saveState()
+static const quint32 s_stateMagic = 0x4b445753; // "KDWS"
+static const quint32 s_stateVersion = 1;
+
+#if HAVE_SYS_FANOTIFY_H
+// The events of the filesystems marked for fanotify, see useFANotify()
+static const uint64_t s_fanotifyMask =
+    FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_MODIFY | FAN_ATTRIB | FAN_DELETE_SELF | FAN_MOVE_SELF | FAN_ONDIR;
+
+// The key of a directory in m_fanotifyDirectories: the fsid of its filesystem
+// followed by its struct file_handle, laid out as in the fanotify_event_info_fid
+// of its events, so that these are looked up without copying
+static QByteArray fanotifyEventKey(const fanotify_event_info_fid *info)
+{
+    const auto *handle = reinterpret_cast<const file_handle *>(info->handle);
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(&info->fsid), sizeof(info->fsid) + sizeof(file_handle) + handle->handle_bytes);
+}
+
+// The key of the directory @p path in m_fanotifyDirectories, and in @p fsid the
+// key of its filesystem in m_fanotifyFilesystems. Empty if the filesystem
+// doesn't support file handles.
+static QByteArray fanotifyDirectoryKey(const QByteArray &path, QByteArray *fsid)
+{
+    struct statfs fs;
+    if (statfs(path.constData(), &fs) != 0) {
+        return QByteArray();
+    }
+    static_assert(sizeof(fs.f_fsid) == sizeof(fanotify_event_info_fid::fsid), "fanotify reports the fsid of statfs()");
+
+    alignas(file_handle) char buffer[sizeof(file_handle) + MAX_HANDLE_SZ];
+    auto *handle = reinterpret_cast<file_handle *>(buffer);
+    handle->handle_bytes = MAX_HANDLE_SZ;
+    int mountId;
+    if (name_to_handle_at(AT_FDCWD, path.constData(), handle, &mountId, AT_SYMLINK_FOLLOW) != 0) {
+        return QByteArray();
+    }
+
+    *fsid = QByteArray(reinterpret_cast<const char *>(&fs.f_fsid), sizeof(fs.f_fsid));
+    return *fsid + QByteArray(buffer, sizeof(file_handle) + handle->handle_bytes);
+}
+#endif
 
 //
 // Class KDirWatchPrivate (singleton)
@@ -157,6 +268,10 @@ static const char s_envNfsMethod[] = "KDIRWATCH_NFSMETHOD";
  *   introduced. You're now able to watch arbitrary inode's
  *   for changes, and even get notification when they're
  *   unmounted.
+ * - FANOTIFY: Since LINUX 5.9, the changes of a whole filesystem
+ *   can be reported by directory file handle and name, with a single
+ *   mark needing CAP_SYS_ADMIN. The handles of the watched directories
+ *   are looked up in m_fanotifyDirectories.
  */
 
 KDirWatchPrivate::KDirWatchPrivate()
@@ -171,6 +286,11 @@ KDirWatchPrivate::KDirWatchPrivate()
 #if HAVE_SYS_INOTIFY_H
     mSn(nullptr)
     ,
+#endif
+#if HAVE_SYS_FANOTIFY_H
+    mFanotifySn(nullptr)
+    , m_fanotify_fd(-1)
+    ,
 #endif
     _isStopped(false)
 {
@@ -179,10 +299,15 @@ KDirWatchPrivate::KDirWatchPrivate()
         s_verboseDebug = true;
     }
     m_statRescanTimer.setObjectName(QStringLiteral("KDirWatchPrivate::timer"));
-    connect(&m_statRescanTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotRescan);
+    connect(&m_statRescanTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotStatRescan);
+    m_scanClock.start();
+    m_statPool.setObjectName(QStringLiteral("KDirWatchPrivate::stat_pool"));
+    m_statPool.setMaxThreadCount(s_statThreadCount);
 
     m_nfsPollInterval = qEnvironmentVariableIsSet(s_envNfsPoll) ? qEnvironmentVariableIntValue(s_envNfsPoll) : 5000;
     m_PollInterval = qEnvironmentVariableIsSet(s_envPoll) ? qEnvironmentVariableIntValue(s_envPoll) : 500;
+    m_coalesceInterval = qEnvironmentVariableIsSet(s_envCoalesce) ? qEnvironmentVariableIntValue(s_envCoalesce) : 0;
+    m_inotifyBudget = qEnvironmentVariableIsSet(s_envInotifyBudget) ? qEnvironmentVariableIntValue(s_envInotifyBudget) : 0;
 
     m_preferredMethod = methodFromString(qEnvironmentVariableIsSet(s_envMethod) ? qgetenv(s_envMethod) : "inotify");
     // The nfs method defaults to the normal (local) method
@@ -197,6 +322,25 @@ KDirWatchPrivate::KDirWatchPrivate()
     rescan_timer.setSingleShot(true);
     connect(&rescan_timer, &QTimer::timeout, this, &KDirWatchPrivate::slotRescan);
 
+    m_emitTimer.setObjectName(QStringLiteral("KDirWatchPrivate::emit_timer"));
+    m_emitTimer.setSingleShot(true);
+    connect(&m_emitTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotEmitPending);
+
+    m_deliveryTimer.setObjectName(QStringLiteral("KDirWatchPrivate::delivery_timer"));
+    m_deliveryTimer.setSingleShot(true);
+    connect(&m_deliveryTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotEmitPending);
+
+    m_registrationTimer.setObjectName(QStringLiteral("KDirWatchPrivate::registration_timer"));
+    m_registrationTimer.setSingleShot(true);
+    connect(&m_registrationTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotRegisterPending);
+
+    m_rebalanceTimer.setObjectName(QStringLiteral("KDirWatchPrivate::rebalance_timer"));
+    connect(&m_rebalanceTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotRebalanceWatches);
+
+    m_overflowRecoveryTimer.setObjectName(QStringLiteral("KDirWatchPrivate::overflow_recovery_timer"));
+    m_overflowRecoveryTimer.setSingleShot(true);
+    connect(&m_overflowRecoveryTimer, &QTimer::timeout, this, &KDirWatchPrivate::slotRecoverOverflow);
+
 #if HAVE_SYS_INOTIFY_H
     m_inotify_fd = inotify_init();
     supports_inotify = m_inotify_fd > 0;
@@ -207,8 +351,40 @@ KDirWatchPrivate::KDirWatchPrivate()
         availableMethods << "INotify";
         (void)fcntl(m_inotify_fd, F_SETFD, FD_CLOEXEC);
 
-        mSn = new QSocketNotifier(m_inotify_fd, QSocketNotifier::Read, this);
-        connect(mSn, &QSocketNotifier::activated, this, &KDirWatchPrivate::inotifyEventReceived);
+        if (qEnvironmentVariableIntValue(s_envInotifyThread) > 0) {
+            m_inotifyReader = std::make_unique<KDirWatchInotifyReader>(m_inotify_fd, this);
+            m_inotifyReader->start();
+        } else {
+            mSn = new QSocketNotifier(m_inotify_fd, QSocketNotifier::Read, this);
+            connect(mSn, &QSocketNotifier::activated, this, &KDirWatchPrivate::inotifyEventReceived);
+        }
+    }
+#endif
+#if HAVE_SYS_FANOTIFY_H
+    // Only set up when asked for, as it takes a privileged mark per filesystem
+    if (m_preferredMethod == KDirWatch::FANotify || m_nfsPreferredMethod == KDirWatch::FANotify) {
+        m_fanotify_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE);
+        if (m_fanotify_fd < 0) {
+            qCDebug(KDIRWATCH) << "Can't use FANotify:" << strerror(errno);
+        } else {
+            availableMethods << "FANotify";
+            mFanotifySn = new QSocketNotifier(m_fanotify_fd, QSocketNotifier::Read, this);
+            connect(mFanotifySn, &QSocketNotifier::activated, this, &KDirWatchPrivate::fanotifyEventReceived);
+        }
+    }
+#endif
+#if HAVE_TREEWATCHER
+    m_treeWatcher = KDirWatchTreeWatcher::create(
+        [this](const QString &path) {
+            treePathChanged(path);
+        },
+        [this](const QString &path) {
+            ++m_statistics.queueOverflows;
+            qCWarning(KDIRWATCH) << "Changes below" << path << "were lost, rescanning all entries";
+            recoverFromOverflow();
+        });
+    if (m_treeWatcher) {
+        availableMethods << methodToString(s_treeMethod);
     }
 #endif
 #if HAVE_QFILESYSTEMWATCHER
@@ -224,10 +400,13 @@ KDirWatchPrivate::~KDirWatchPrivate()
 {
     m_statRescanTimer.stop();
 
+    // The results are posted to us, make sure that happens before we are gone
+    // so that they are discarded.
+    m_statPool.waitForDone();
+
     // Unset us as d pointer. This indicates to the KDirWatch that the private has already been destroyed and therefore
     // needs no additional cleanup from its destructor.
-    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end(); it++) {
-        auto &entry = it.value();
+    for (auto &[path, entry] : m_mapEntries) {
         for (auto &client : entry.m_clients) {
             client.instance->d = nullptr;
         }
@@ -238,10 +417,21 @@ KDirWatchPrivate::~KDirWatchPrivate()
     }
 
 #if HAVE_SYS_INOTIFY_H
+    // The reader must be done with the descriptor before it is closed
+    m_inotifyReader.reset();
     if (supports_inotify) {
         QT_CLOSE(m_inotify_fd);
     }
 #endif
+#if HAVE_SYS_FANOTIFY_H
+    if (m_fanotify_fd >= 0) {
+        // Removes the marks too
+        QT_CLOSE(m_fanotify_fd);
+    }
+#endif
+#if HAVE_TREEWATCHER
+    m_treeWatcher.reset();
+#endif
 #if HAVE_QFILESYSTEMWATCHER
     delete fsWatcher;
 #endif
@@ -254,165 +444,605 @@ void KDirWatchPrivate::inotifyEventReceived()
         return;
     }
 
-    int pending = -1;
-    int offsetStartRead = 0; // where we read into buffer
-    char buf[8192];
-    assert(m_inotify_fd > -1);
-    ioctl(m_inotify_fd, FIONREAD, &pending);
+    // With a reader thread the events were read already
+    processInotifyEvents(m_inotifyReader ? m_inotifyReader->takeEvents() : readInotifyEvents(m_inotify_fd));
+#endif
+}
 
-    while (pending > 0) {
-        const int bytesToRead = qMin<int>(pending, sizeof(buf) - offsetStartRead);
+#if HAVE_SYS_INOTIFY_H
+// The most bytes of events KDirWatchInotifyReader queues for the watching
+// thread, about 100000 events with short names.
+static const qsizetype s_maxQueuedInotifyBytes = 4 * 1024 * 1024;
 
-        int bytesAvailable = read(m_inotify_fd, &buf[offsetStartRead], bytesToRead);
-        pending -= bytesAvailable;
-        bytesAvailable += offsetStartRead;
-        offsetStartRead = 0;
+KDirWatchInotifyReader::KDirWatchInotifyReader(int inotifyFd, KDirWatchPrivate *watcher)
+    : m_inotifyFd(inotifyFd)
+    , m_watcher(watcher)
+{
+    setObjectName(QStringLiteral("KDirWatch inotify reader"));
+    if (pipe2(m_wakeupFds, O_CLOEXEC) != 0) {
+        qCWarning(KDIRWATCH) << "Can't create the pipe to stop the inotify reader:" << strerror(errno);
+        m_wakeupFds[0] = m_wakeupFds[1] = -1;
+    }
+}
 
-        int offsetCurrent = 0;
-        while (bytesAvailable >= int(sizeof(struct inotify_event))) {
-            const struct inotify_event *const event = reinterpret_cast<inotify_event *>(&buf[offsetCurrent]);
+KDirWatchInotifyReader::~KDirWatchInotifyReader()
+{
+    if (m_wakeupFds[1] >= 0) {
+        const char wakeup = 0;
+        (void)QT_WRITE(m_wakeupFds[1], &wakeup, 1);
+    }
+    wait();
 
-            if (event->mask & IN_Q_OVERFLOW) {
-                qCWarning(KDIRWATCH) << "Inotify Event queue overflowed, check max_queued_events value";
-                return;
+    for (int fd : m_wakeupFds) {
+        if (fd >= 0) {
+            QT_CLOSE(fd);
+        }
+    }
+}
+
+QByteArray KDirWatchInotifyReader::takeEvents()
+{
+    QMutexLocker locker(&m_mutex);
+    return std::exchange(m_events, QByteArray());
+}
+
+void KDirWatchInotifyReader::run()
+{
+    if (m_wakeupFds[0] < 0) {
+        return;
+    }
+
+    for (;;) {
+        pollfd fds[2] = {{m_inotifyFd, POLLIN, 0}, {m_wakeupFds[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            qCWarning(KDIRWATCH) << "Polling the inotify descriptor failed:" << strerror(errno);
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        const QByteArray events = KDirWatchPrivate::readInotifyEvents(m_inotifyFd);
+        if (events.isEmpty()) {
+            continue;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        const bool wasEmpty = m_events.isEmpty();
+        if (m_events.size() + events.size() <= s_maxQueuedInotifyBytes) {
+            m_events += events;
+            m_overflowed = false;
+        } else if (!m_overflowed) {
+            // Behave like the kernel queue, see KDirWatchPrivate::processInotifyEvents()
+            inotify_event overflow = {};
+            overflow.wd = -1;
+            overflow.mask = IN_Q_OVERFLOW;
+            m_events.append(reinterpret_cast<const char *>(&overflow), sizeof(overflow));
+            m_overflowed = true;
+        }
+        locker.unlock();
 
-            const int eventSize = sizeof(struct inotify_event) + event->len;
-            if (bytesAvailable < eventSize) {
-                break;
+        if (wasEmpty) {
+            QMetaObject::invokeMethod(m_watcher, &KDirWatchPrivate::inotifyEventReceived, Qt::QueuedConnection);
+        }
+    }
+}
+
+/* Returns all events queued for the inotify descriptor @p fd. The kernel only
+ * hands out whole events.
+ */
+QByteArray KDirWatchPrivate::readInotifyEvents(int fd)
+{
+    int pending = 0;
+    ioctl(fd, FIONREAD, &pending);
+    if (pending <= 0) {
+        return QByteArray();
+    }
+
+    QByteArray events(pending, Qt::Uninitialized);
+    const ssize_t bytesRead = read(fd, events.data(), pending);
+    events.truncate(qMax<ssize_t>(bytesRead, 0));
+    return events;
+}
+
+void KDirWatchPrivate::processInotifyEvents(const QByteArray &events)
+{
+    // the previous event, to skip repeated modifications of the same file
+    int lastWd = -1;
+    uint32_t lastMask = 0;
+    QByteArray lastName;
+    // The kernel queues both halves of a rename at once, so they are read together
+    std::vector<PendingMove> moves;
+    const auto flushMoves = [this, &moves]() {
+        // Moved out of the watched directories
+        for (const PendingMove &move : moves) {
+            if (Entry *from = m_inotify_wd_to_entry.value(move.wd)) {
+                emitEvent(from, Deleted, move.path, move.isDir);
             }
+        }
+        moves.clear();
+    };
+
+    qsizetype bytesAvailable = events.size();
+    qsizetype offsetCurrent = 0;
+    while (bytesAvailable >= qsizetype(sizeof(struct inotify_event))) {
+        const struct inotify_event *const event = reinterpret_cast<const inotify_event *>(events.constData() + offsetCurrent);
+
+        if (event->mask & IN_Q_OVERFLOW) {
+            ++m_statistics.queueOverflows;
+            qCWarning(KDIRWATCH) << "Inotify Event queue overflowed, check max_queued_events value";
+            flushMoves();
+            recoverFromOverflow();
+            return;
+        }
 
-            bytesAvailable -= eventSize;
-            offsetCurrent += eventSize;
+        const qsizetype eventSize = sizeof(struct inotify_event) + event->len;
+        if (bytesAvailable < eventSize) {
+            break;
+        }
+
+        bytesAvailable -= eventSize;
+        offsetCurrent += eventSize;
+        ++m_statistics.eventsReceived;
+
+        Entry *e = m_inotify_wd_to_entry.value(event->wd);
+        if (!e) {
+            continue;
+        }
 
-            QString path;
-            // strip trailing null chars, see inotify_event documentation
-            // these must not end up in the final QString version of path
-            int len = event->len;
-            while (len > 1 && !event->name[len - 1]) {
-                --len;
+        QString path;
+        // strip trailing null chars, see inotify_event documentation
+        // these must not end up in the final QString version of path
+        int len = event->len;
+        while (len > 1 && !event->name[len - 1]) {
+            --len;
+        }
+        if (len && e->m_entries.isEmpty() && !e->m_clients.empty()) {
+            // Drop the names no client is interested in before decoding them
+            const QByteArrayView name(event->name, len);
+            const bool isDir = event->mask & IN_ISDIR;
+            if (std::none_of(e->m_clients.cbegin(), e->m_clients.cend(), [name, isDir](const Client &client) {
+                    return client.accepts(name, isDir);
+                })) {
+                ++m_statistics.eventsFiltered;
+                continue;
             }
-            QByteArray cpath(event->name, len);
-            if (len) {
-                path = QFile::decodeName(cpath);
+        }
+        QByteArray cpath(event->name, len);
+        if (len) {
+            path = QFile::decodeName(cpath);
+        }
+
+        if (!path.isEmpty() && isNoisyFile(cpath.data())) {
+            continue;
+        }
+
+        // Writing a file in several chunks gives an IN_MODIFY for every
+        // chunk, only the first of a run of those needs handling.
+        const bool isRepeat = event->wd == lastWd && event->mask == lastMask && cpath == lastName;
+        lastWd = event->wd;
+        lastMask = event->mask;
+        lastName = cpath;
+        if (isRepeat && !(event->mask & ~(IN_MODIFY | IN_ATTRIB | IN_ISDIR))) {
+            ++m_statistics.eventsCoalesced;
+            continue;
+        }
+
+        // Is set to true if the new event is a directory, false otherwise. This prevents a stat call in clientsForFileOrDir
+        const bool isDir = (event->mask & (IN_ISDIR));
+
+        const bool wasDirty = e->dirty;
+        e->dirty = true;
+
+        const QString tpath = e->path + QLatin1Char('/') + path;
+
+        if (!path.isEmpty()) {
+            // A file sharing the watch of this directory, see useParentINotify()
+            Entry *sub_entry = e->m_entries.value(path);
+            if (sub_entry && sub_entry->m_status == Normal) {
+                sub_entry->dirty = true;
             }
+        }
 
-            if (!path.isEmpty() && isNoisyFile(cpath.data())) {
-                continue;
+        qCDebug(KDIRWATCH).nospace() << "got event " << inotifyEventName(event) << " for entry " << e->path
+                                     << (event->mask & IN_ISDIR ? " [directory] " : " [file] ") << path;
+
+        if (event->mask & IN_DELETE_SELF) {
+            e->m_status = NonExistent;
+            m_inotify_wd_to_entry.remove(e->wd);
+            e->wd = -1;
+            e->m_ctime = invalid_ctime;
+            emitEvent(e, Deleted);
+            // If the parent dir was already watched, tell it something changed
+            Entry *parentEntry = entry(e->parentDirectory());
+            if (parentEntry) {
+                parentEntry->dirty = true;
+            }
+            // Add entry to parent dir to notice if the entry gets recreated
+            addEntry(nullptr, e->parentDirectory(), e, true /*isDir*/);
+        }
+        if (event->mask & IN_IGNORED) {
+            // Causes bug #207361 with kernels 2.6.31 and 2.6.32!
+            // e->wd = -1;
+        }
+        const auto pendingMove = std::find_if(moves.cbegin(), moves.cend(), [event](const PendingMove &candidate) {
+            return candidate.cookie == event->cookie;
+        });
+        if ((event->mask & IN_MOVED_TO) && event->cookie != 0 && pendingMove != moves.cend()) {
+            const PendingMove move = *pendingMove;
+            moves.erase(pendingMove);
+            inotifyRenamed(move, e, tpath, isDir);
+        } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            Entry *sub_entry = e->findSubEntry(tpath);
+
+            qCDebug(KDIRWATCH) << "-->got CREATE signal for" << (tpath) << "sub_entry=" << sub_entry;
+
+            if (sub_entry) {
+                // We were waiting for this new file/dir to be created
+                sub_entry->dirty = true;
+                rescan_timer.start(0); // process this asap, to start watching that dir
+            } else if (e->isDir && !e->m_clients.empty()) {
+                childCreated(e, tpath, path, isDir);
+            }
+        }
+        if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if ((e->isDir) && (!e->m_clients.empty())) {
+                // A file in this directory has been removed.  It wasn't an explicitly
+                // watched file as it would have its own watch descriptor, so
+                // no addEntry/ removeEntry bookkeeping should be required.  Emit
+                // the event immediately if any clients are interested.
+                const KDirWatch::WatchModes flag = isDir ? KDirWatch::WatchSubDirs : KDirWatch::WatchFiles;
+                int counter = std::count_if(e->m_clients.cbegin(), e->m_clients.cend(), [flag](const Client &client) {
+                    return client.m_watchModes & flag;
+                });
+
+                if (counter == 0) {
+                    // Nobody interested
+                } else if ((event->mask & IN_MOVED_FROM) && event->cookie != 0) {
+                    moves.push_back({event->cookie, event->wd, tpath, isDir});
+                } else {
+                    emitEvent(e, Deleted, tpath, isDir);
+                }
+            }
+        }
+        if (event->mask & (IN_MODIFY | IN_ATTRIB)) {
+            if ((e->isDir) && (!e->m_clients.empty())) {
+                // A file in this directory has been changed.  No
+                // addEntry/ removeEntry bookkeeping should be required.
+                // Add the path to the list of pending file changes if
+                // there are any interested clients.
+                // QT_STATBUF stat_buf;
+                // QByteArray tpath = QFile::encodeName(e->path+'/'+path);
+                // QT_STAT(tpath, &stat_buf);
+                // bool isDir = S_ISDIR(stat_buf.st_mode);
+
+                // The API doc is somewhat vague as to whether we should emit
+                // dirty() for implicitly watched files when WatchFiles has
+                // not been specified - we'll assume they are always interested,
+                // regardless.
+                // Don't worry about duplicates for the time
+                // being; this is handled in slotRescan.
+                e->m_pendingFileChanges.append(tpath);
+                // Avoid stat'ing the directory if only an entry inside it changed.
+                e->dirty = (wasDirty || (path.isEmpty() && (event->mask & IN_ATTRIB)));
             }
+        }
 
-            // Is set to true if the new event is a directory, false otherwise. This prevents a stat call in clientsForFileOrDir
-            const bool isDir = (event->mask & (IN_ISDIR));
+        if (!rescan_timer.isActive()) {
+            rescan_timer.start(m_PollInterval); // singleshot
+        }
+    }
+    flushMoves();
+}
+#endif
 
-            Entry *e = m_inotify_wd_to_entry.value(event->wd);
-            if (!e) {
-                continue;
+#if HAVE_SYS_INOTIFY_H
+/* Reports the new file or directory @p tpath, named @p name, in the watched
+ * directory @p e, and watches the new directory for the clients watching the
+ * subdirectories of @p e.
+ */
+void KDirWatchPrivate::childCreated(Entry *e, const QString &tpath, const QString &name, bool isDir)
+{
+    const QList<const Client *> clients = e->inotifyClientsForFileOrDir(isDir);
+    // See discussion in addEntry for why we don't addEntry for individual
+    // files in WatchFiles mode with inotify.
+    if (isDir) {
+        for (const Client *client : clients) {
+            if (client->accepts(QStringView(name), isDir)) {
+                addEntry(client->instance, tpath, nullptr, isDir, client->m_watchModes, client->m_nameMatcher);
             }
-            const bool wasDirty = e->dirty;
-            e->dirty = true;
+        }
+    }
+    if (!clients.isEmpty()) {
+        emitEvent(e, Created, tpath, isDir);
+        qCDebug(KDIRWATCH).nospace() << clients.count() << " instance(s) monitoring the new " << (isDir ? "dir " : "file ") << tpath;
+    }
+    e->m_pendingFileChanges.append(e->path);
+    if (!rescan_timer.isActive()) {
+        rescan_timer.start(m_PollInterval); // singleshot
+    }
+}
+#endif
 
-            const QString tpath = e->path + QLatin1Char('/') + path;
+void KDirWatchPrivate::fanotifyEventReceived()
+{
+#if HAVE_SYS_FANOTIFY_H
+    if (m_fanotify_fd < 0) {
+        return;
+    }
 
-            qCDebug(KDIRWATCH).nospace() << "got event " << inotifyEventName(event) << " for entry " << e->path
-                                         << (event->mask & IN_ISDIR ? " [directory] " : " [file] ") << path;
+    alignas(fanotify_event_metadata) char buf[16384];
+    // the previous event, to skip repeated modifications of the same file
+    QString lastDir;
+    QByteArray lastName;
+    uint64_t lastMask = 0;
 
-            if (event->mask & IN_DELETE_SELF) {
-                e->m_status = NonExistent;
-                m_inotify_wd_to_entry.remove(e->wd);
-                e->wd = -1;
-                e->m_ctime = invalid_ctime;
-                emitEvent(e, Deleted);
-                // If the parent dir was already watched, tell it something changed
-                Entry *parentEntry = entry(e->parentDirectory());
-                if (parentEntry) {
-                    parentEntry->dirty = true;
-                }
-                // Add entry to parent dir to notice if the entry gets recreated
-                addEntry(nullptr, e->parentDirectory(), e, true /*isDir*/);
+    for (;;) {
+        ssize_t bytesAvailable = read(m_fanotify_fd, buf, sizeof(buf));
+        if (bytesAvailable < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesAvailable <= 0) {
+            // EAGAIN, all events were read
+            break;
+        }
+
+        for (auto *event = reinterpret_cast<const fanotify_event_metadata *>(buf); FAN_EVENT_OK(event, bytesAvailable);
+             event = FAN_EVENT_NEXT(event, bytesAvailable)) {
+            if (event->vers != FANOTIFY_METADATA_VERSION) {
+                qCWarning(KDIRWATCH) << "Unsupported fanotify metadata version" << event->vers;
+                return;
             }
-            if (event->mask & IN_IGNORED) {
-                // Causes bug #207361 with kernels 2.6.31 and 2.6.32!
-                // e->wd = -1;
+            if (event->fd >= 0) {
+                QT_CLOSE(event->fd);
             }
-            if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
-                Entry *sub_entry = e->findSubEntry(tpath);
 
-                qCDebug(KDIRWATCH) << "-->got CREATE signal for" << (tpath) << "sub_entry=" << sub_entry;
+            if (event->mask & FAN_Q_OVERFLOW) {
+                ++m_statistics.queueOverflows;
+                qCWarning(KDIRWATCH) << "FANotify Event queue overflowed, rescanning all entries";
+                recoverFromOverflow();
+                continue;
+            }
+            ++m_statistics.eventsReceived;
 
-                if (sub_entry) {
-                    // We were waiting for this new file/dir to be created
-                    sub_entry->dirty = true;
-                    rescan_timer.start(0); // process this asap, to start watching that dir
-                } else if (e->isDir && !e->m_clients.empty()) {
-                    const QList<const Client *> clients = e->inotifyClientsForFileOrDir(isDir);
-                    // See discussion in addEntry for why we don't addEntry for individual
-                    // files in WatchFiles mode with inotify.
-                    if (isDir) {
-                        for (const Client *client : clients) {
-                            addEntry(client->instance, tpath, nullptr, isDir, isDir ? client->m_watchModes : KDirWatch::WatchDirOnly);
-                        }
-                    }
-                    if (!clients.isEmpty()) {
-                        emitEvent(e, Created, tpath);
-                        qCDebug(KDIRWATCH).nospace() << clients.count() << " instance(s) monitoring the new " << (isDir ? "dir " : "file ") << tpath;
-                    }
-                    e->m_pendingFileChanges.append(e->path);
-                    if (!rescan_timer.isActive()) {
-                        rescan_timer.start(m_PollInterval); // singleshot
-                    }
-                }
+            // With FAN_REPORT_DFID_NAME, the directory and the name of the event
+            const auto *info = reinterpret_cast<const fanotify_event_info_fid *>(reinterpret_cast<const char *>(event) + event->metadata_len);
+            if (event->event_len < event->metadata_len + sizeof(*info) + sizeof(file_handle)
+                || (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME && info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID)) {
+                continue;
             }
-            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
-                if ((e->isDir) && (!e->m_clients.empty())) {
-                    // A file in this directory has been removed.  It wasn't an explicitly
-                    // watched file as it would have its own watch descriptor, so
-                    // no addEntry/ removeEntry bookkeeping should be required.  Emit
-                    // the event immediately if any clients are interested.
-                    const KDirWatch::WatchModes flag = isDir ? KDirWatch::WatchSubDirs : KDirWatch::WatchFiles;
-                    int counter = std::count_if(e->m_clients.cbegin(), e->m_clients.cend(), [flag](const Client &client) {
-                        return client.m_watchModes & flag;
-                    });
-
-                    if (counter != 0) {
-                        emitEvent(e, Deleted, tpath);
-                    }
-                }
+            const auto *handle = reinterpret_cast<const file_handle *>(info->handle);
+            const std::size_t handleEnd = sizeof(*info) + sizeof(file_handle) + handle->handle_bytes;
+            if (info->hdr.len < handleEnd) {
+                continue;
+            }
+            const auto dir = m_fanotifyDirectories.constFind(fanotifyEventKey(info));
+            if (dir == m_fanotifyDirectories.cend()) {
+                // Somewhere else on the filesystem
+                continue;
             }
-            if (event->mask & (IN_MODIFY | IN_ATTRIB)) {
-                if ((e->isDir) && (!e->m_clients.empty())) {
-                    // A file in this directory has been changed.  No
-                    // addEntry/ removeEntry bookkeeping should be required.
-                    // Add the path to the list of pending file changes if
-                    // there are any interested clients.
-                    // QT_STATBUF stat_buf;
-                    // QByteArray tpath = QFile::encodeName(e->path+'/'+path);
-                    // QT_STAT(tpath, &stat_buf);
-                    // bool isDir = S_ISDIR(stat_buf.st_mode);
-
-                    // The API doc is somewhat vague as to whether we should emit
-                    // dirty() for implicitly watched files when WatchFiles has
-                    // not been specified - we'll assume they are always interested,
-                    // regardless.
-                    // Don't worry about duplicates for the time
-                    // being; this is handled in slotRescan.
-                    e->m_pendingFileChanges.append(tpath);
-                    // Avoid stat'ing the directory if only an entry inside it changed.
-                    e->dirty = (wasDirty || (path.isEmpty() && (event->mask & IN_ATTRIB)));
+
+            QByteArray name;
+            if (info->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                // "." for the directory itself
+                const char *rawName = reinterpret_cast<const char *>(info) + handleEnd;
+                name = QByteArray(rawName, qstrnlen(rawName, info->hdr.len - handleEnd));
+                if (name == ".") {
+                    name.clear();
                 }
             }
 
-            if (!rescan_timer.isActive()) {
-                rescan_timer.start(m_PollInterval); // singleshot
+            // See inotifyEventReceived()
+            const bool isRepeat = event->mask == lastMask && name == lastName && dir->path == lastDir;
+            lastDir = dir->path;
+            lastMask = event->mask;
+            lastName = name;
+            if (isRepeat && !(event->mask & ~uint64_t(FAN_MODIFY | FAN_ATTRIB | FAN_ONDIR))) {
+                ++m_statistics.eventsCoalesced;
+                continue;
             }
+
+            // Copied, as handling the event may watch new directories
+            fanotifyEvent(lastDir, name, event->mask);
         }
-        if (bytesAvailable > 0) {
-            // copy partial event to beginning of buffer
-            memmove(buf, &buf[offsetCurrent], bytesAvailable);
-            offsetStartRead = bytesAvailable;
+    }
+#endif
+}
+
+#if HAVE_SYS_FANOTIFY_H
+/* Handles the fanotify event @p mask for @p name in the directory @p dirPath,
+ * or for the directory itself if @p name is empty, the way inotifyEventReceived()
+ * handles the events of a watch. Renames are reported as deletion and creation,
+ * fanotify doesn't pair the halves with FAN_REPORT_DFID_NAME alone.
+ */
+void KDirWatchPrivate::fanotifyEvent(const QString &dirPath, const QByteArray &name, quint64 mask)
+{
+    if (!rescan_timer.isActive()) {
+        rescan_timer.start(m_PollInterval); // singleshot
+    }
+
+    Entry *e = entry(dirPath);
+    if (name.isEmpty()) {
+        // The directory itself changed, was deleted or moved away
+        if (e) {
+            e->dirty = true;
         }
+        return;
     }
+
+    const bool isDir = mask & FAN_ONDIR;
+    const QString path = QFile::decodeName(name);
+    const QString tpath = dirPath + QLatin1Char('/') + path;
+
+    // A file or directory watched itself, see useFANotify()
+    Entry *watched = entry(tpath);
+    if (watched && watched->m_mode == FANotifyMode && watched->m_status == Normal) {
+        watched->dirty = true;
+    }
+
+    if (!e || e->m_mode != FANotifyMode) {
+        return;
+    }
+    if (e->m_entries.isEmpty() && !e->m_clients.empty()) {
+        if (std::none_of(e->m_clients.cbegin(), e->m_clients.cend(), [&name, isDir](const Client &client) {
+                return client.accepts(QByteArrayView(name), isDir);
+            })) {
+            ++m_statistics.eventsFiltered;
+            return;
+        }
+    }
+    if (isNoisyFile(name.constData())) {
+        return;
+    }
+
+    const bool wasDirty = e->dirty;
+    e->dirty = true;
+
+    if (mask & (FAN_CREATE | FAN_MOVED_TO)) {
+        if (Entry *sub_entry = e->findSubEntry(tpath)) {
+            // We were waiting for this new file/dir to be created
+            sub_entry->dirty = true;
+            rescan_timer.start(0); // process this asap, to start watching that dir
+        } else if (e->isDir && !e->m_clients.empty()) {
+            childCreated(e, tpath, path, isDir);
+        }
+    }
+    if ((mask & (FAN_DELETE | FAN_MOVED_FROM)) && e->isDir) {
+        const KDirWatch::WatchModes flag = isDir ? KDirWatch::WatchSubDirs : KDirWatch::WatchFiles;
+        if (std::any_of(e->m_clients.cbegin(), e->m_clients.cend(), [flag](const Client &client) {
+                return client.m_watchModes & flag;
+            })) {
+            emitEvent(e, Deleted, tpath, isDir);
+        }
+    }
+    if ((mask & (FAN_MODIFY | FAN_ATTRIB)) && e->isDir && !e->m_clients.empty()) {
+        // Reported by slotRescan(), see inotifyEventReceived()
+        e->m_pendingFileChanges.append(tpath);
+        e->dirty = wasDirty;
+    }
+}
 #endif
+
+#if HAVE_SYS_INOTIFY_H
+/* Handles both halves of a rename from @p move to @p newPath in @p to:
+ * the instances watching both directories get renamed(), the others
+ * deleted() or created(). A watched directory is moved in place with its
+ * subtree, as its inotify watches follow it.
+ */
+void KDirWatchPrivate::inotifyRenamed(const PendingMove &move, Entry *to, const QString &newPath, bool isDir)
+{
+    Entry *from = m_inotify_wd_to_entry.value(move.wd);
+    const bool moved = from && isDir && moveEntries(move.path, newPath, to);
+    const auto baseName = [](const QString &path) {
+        return QStringView(path).mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+    };
+    const QStringView newName = baseName(newPath);
+
+    // Like for deletions and creations, all clients of a directory are told
+    // if any of them watches its files or subdirectories
+    const KDirWatch::WatchModes flag = isDir ? KDirWatch::WatchSubDirs : KDirWatch::WatchFiles;
+    const auto isInterested = [flag](const Client &client) {
+        return client.m_watchModes & flag;
+    };
+    const auto instances = [&isInterested, isDir](Entry *e, QStringView name) {
+        QSet<KDirWatch *> result;
+        if (e && e->isDir && std::any_of(e->m_clients.cbegin(), e->m_clients.cend(), isInterested)) {
+            ++e->m_activity;
+            for (const Client &client : e->m_clients) {
+                if (client.instance && client.count > 0 && !client.watchingStopped && client.accepts(name, isDir)) {
+                    result.insert(client.instance);
+                }
+            }
+        }
+        return result;
+    };
+    QSet<KDirWatch *> fromInstances = instances(from, baseName(move.path));
+    const QSet<KDirWatch *> toInstances = instances(to, newName);
+
+    for (KDirWatch *instance : toInstances) {
+        if (fromInstances.remove(instance)) {
+            queueEvent(instance, Renamed, move.path, newPath);
+        } else {
+            queueEvent(instance, Created, newPath);
+        }
+    }
+    for (KDirWatch *instance : std::as_const(fromInstances)) {
+        queueEvent(instance, Deleted, move.path);
+    }
+
+    if (isDir && !moved) {
+        const QList<const Client *> clients = to->inotifyClientsForFileOrDir(true);
+        for (const Client *client : clients) {
+            if (client->accepts(newName, true)) {
+                addEntry(client->instance, newPath, nullptr, true, client->m_watchModes, client->m_nameMatcher);
+            }
+        }
+    }
+
+    if (Entry *sub_entry = to->findSubEntry(newPath)) {
+        // We were waiting for this new file/dir to be created
+        sub_entry->dirty = true;
+        rescan_timer.start(0);
+    }
+}
+
+/* Moves the entry of the directory @p oldPath and the ones below it to
+ * @p newPath, if all of its clients watch the subdirectories of @p to anyway.
+ * Otherwise the entries are left for the usual bookkeeping of deleted and
+ * created directories.
+ */
+bool KDirWatchPrivate::moveEntries(const QString &oldPath, const QString &newPath, const Entry *to)
+{
+    const auto it = m_mapEntries.find(oldPath);
+    if (it == m_mapEntries.end() || it->second.m_mode != INotifyMode || it->second.wd == -1 || m_mapEntries.count(newPath)) {
+        return false;
+    }
+    // The subtree keeps the name filters it was added with
+    const QStringView newName = QStringView(newPath).mid(newPath.lastIndexOf(QLatin1Char('/')) + 1);
+    for (const Client &client : it->second.m_clients) {
+        const auto recursiveClient = std::find_if(to->m_clients.cbegin(), to->m_clients.cend(), [&client, newName](const Client &toClient) {
+            return toClient.instance == client.instance && (toClient.m_watchModes & KDirWatch::WatchSubDirs)
+                && toClient.m_nameMatcher == client.m_nameMatcher && toClient.accepts(newName, true);
+        });
+        if (recursiveClient == to->m_clients.cend()) {
+            return false;
+        }
+    }
+
+    const QString oldPrefix = oldPath + QLatin1Char('/');
+    QStringList paths{oldPath};
+    for (const auto &[path, entry] : m_mapEntries) {
+        if (path.startsWith(oldPrefix)) {
+            if (m_mapEntries.count(newPath + path.mid(oldPath.size()))) {
+                return false;
+            }
+            paths.append(path);
+        }
+    }
+
+    // Moving the nodes keeps the entries at their addresses
+    for (const QString &path : std::as_const(paths)) {
+        auto node = m_mapEntries.extract(path);
+        node.key() = newPath + path.mid(oldPath.size());
+        Entry &e = node.mapped();
+        e.path = node.key();
+        e.m_encodedPath.clear();
+        const auto inserted = m_mapEntries.insert(std::move(node));
+        if (e.m_mode == StatMode) {
+            // The scan queue refers to entries by path
+            scheduleScan(&inserted.position->second, e.m_nextScan);
+        }
+    }
+    qCDebug(KDIRWATCH) << "Moved" << paths.size() << "entries from" << oldPath << "to" << newPath;
+    return true;
 }
+#endif
 
 KDirWatchPrivate::Entry::~Entry()
 {
@@ -425,7 +1055,8 @@ KDirWatchPrivate::Entry::~Entry()
 void KDirWatchPrivate::Entry::propagate_dirty()
 {
     for (Entry *sub_entry : std::as_const(m_entries)) {
-        if (!sub_entry->dirty) {
+        // The files sharing the inotify watch are only dirty if their name is reported
+        if (!sub_entry->dirty && sub_entry->m_status == NonExistent) {
             sub_entry->dirty = true;
             sub_entry->propagate_dirty();
         }
@@ -435,7 +1066,7 @@ void KDirWatchPrivate::Entry::propagate_dirty()
 /* A KDirWatch instance is interested in getting events for
  * this file/Dir entry.
  */
-void KDirWatchPrivate::Entry::addClient(KDirWatch *instance, KDirWatch::WatchModes watchModes)
+void KDirWatchPrivate::Entry::addClient(KDirWatch *instance, KDirWatch::WatchModes watchModes, const NameMatcherPtr &nameMatcher)
 {
     if (instance == nullptr) {
         return;
@@ -446,10 +1077,11 @@ void KDirWatchPrivate::Entry::addClient(KDirWatch *instance, KDirWatch::WatchMod
         Client &client = *it;
         ++client.count;
         client.m_watchModes = watchModes;
+        client.m_nameMatcher = nameMatcher;
         return;
     }
 
-    m_clients.emplace_back(instance, watchModes);
+    m_clients.emplace_back(instance, watchModes, nameMatcher);
 }
 
 void KDirWatchPrivate::Entry::removeClient(KDirWatch *instance)
@@ -475,11 +1107,40 @@ int KDirWatchPrivate::Entry::clientCount() const
     return clients;
 }
 
+bool KDirWatchPrivate::Entry::watchesContent() const
+{
+    if (isDir) {
+        return false;
+    }
+    return std::any_of(m_clients.cbegin(), m_clients.cend(), [](const Client &client) {
+        return client.m_watchModes.testFlag(KDirWatch::WatchContentChanges);
+    });
+}
+
 QString KDirWatchPrivate::Entry::parentDirectory() const
 {
     return QDir::cleanPath(path + QLatin1String("/.."));
 }
 
+const QByteArray &KDirWatchPrivate::Entry::encodedPath()
+{
+    if (m_encodedPath.isEmpty()) {
+        m_encodedPath = QFile::encodeName(path);
+    }
+    return m_encodedPath;
+}
+
+// Whether the next StatMode scan has to ask the server of a network
+// filesystem, rather than take the attributes it cached, see statEntry()
+bool KDirWatchPrivate::Entry::scanSyncs()
+{
+    if (!m_onNetworkFs || ++m_unsyncedScans >= s_networkSyncInterval) {
+        m_unsyncedScans = 0;
+        return true;
+    }
+    return false;
+}
+
 QList<const KDirWatchPrivate::Client *> KDirWatchPrivate::Entry::clientsForFileOrDir(const QString &tpath, bool *isDir) const
 {
     QList<const Client *> ret;
@@ -527,13 +1188,14 @@ QDebug operator<<(QDebug debug, const KDirWatch & /* watch */)
 
 QDebug operator<<(QDebug debug, const KDirWatchPrivate &dwp)
 {
+    const KDirWatch::Statistics &statistics = dwp.m_statistics;
+    debug << "Events received:" << statistics.eventsReceived << "coalesced:" << statistics.eventsCoalesced << "filtered:" << statistics.eventsFiltered << "queue overflows:" << statistics.queueOverflows
+          << "fallbacks:" << statistics.fallbacks;
     debug << "Entries watched:";
-    if (dwp.m_mapEntries.count() == 0) {
+    if (dwp.m_mapEntries.empty()) {
         debug << "  None.";
     } else {
-        auto it = dwp.m_mapEntries.cbegin();
-        for (; it != dwp.m_mapEntries.cend(); ++it) {
-            const KDirWatchPrivate::Entry &e = it.value();
+        for (const auto &[path, e] : dwp.m_mapEntries) {
             debug << "  " << e;
 
             for (const KDirWatchPrivate::Client &c : e.m_clients) {
@@ -558,9 +1220,10 @@ QDebug operator<<(QDebug debug, const KDirWatchPrivate &dwp)
             if (!e.m_entries.isEmpty()) {
                 debug << "    dependent entries:";
                 for (KDirWatchPrivate::Entry *d : e.m_entries) {
-                    debug << "      " << d << d->path << (d->m_status == KDirWatchPrivate::NonExistent ? "NonExistent" : "EXISTS this is an ERROR!");
+                    debug << "      " << d << d->path << (d->m_status == KDirWatchPrivate::NonExistent ? "NonExistent" : "sharing the watch");
                     if (s_verboseDebug) {
-                        Q_ASSERT(d->m_status == KDirWatchPrivate::NonExistent); // it doesn't belong here otherwise
+                        // it doesn't belong here otherwise
+                        Q_ASSERT(d->m_status == KDirWatchPrivate::NonExistent || (e.m_mode == KDirWatchPrivate::INotifyMode && !d->isDir));
                     }
                 }
             }
@@ -578,6 +1241,8 @@ QDebug operator<<(QDebug debug, const KDirWatchPrivate::Entry &entry)
     debug << ", using "
           << ((entry.m_mode == KDirWatchPrivate::INotifyMode)        ? "INotify"
                   : (entry.m_mode == KDirWatchPrivate::QFSWatchMode) ? "QFSWatch"
+                  : (entry.m_mode == KDirWatchPrivate::FANotifyMode) ? "FANotify"
+                  : (entry.m_mode == KDirWatchPrivate::TreeMode)     ? "Tree"
                   : (entry.m_mode == KDirWatchPrivate::StatMode)     ? "Stat"
                                                                      : "Unknown Method");
 #if HAVE_SYS_INOTIFY_H
@@ -588,7 +1253,7 @@ QDebug operator<<(QDebug debug, const KDirWatchPrivate::Entry &entry)
     debug << ", has " << entry.m_clients.size() << " clients";
     debug.space();
     if (!entry.m_entries.isEmpty()) {
-        debug << ", nonexistent subentries:";
+        debug << ", dependent subentries:";
         for (KDirWatchPrivate::Entry *subEntry : std::as_const(entry.m_entries)) {
             debug << subEntry << subEntry->path;
         }
@@ -610,7 +1275,7 @@ KDirWatchPrivate::Entry *KDirWatchPrivate::entry(const QString &_path)
     }
 
     auto it = m_mapEntries.find(path);
-    return it != m_mapEntries.end() ? &it.value() : nullptr;
+    return it != m_mapEntries.end() ? &it->second : nullptr;
 }
 
 // set polling frequency for a entry and adjust global freq if needed
@@ -646,11 +1311,22 @@ bool KDirWatchPrivate::useINotify(Entry *e)
         return true;
     }
 
+    if (!e->isDir && useParentINotify(e)) {
+        return true;
+    }
+
+    if (m_inotifyBudget > 0 && m_inotify_wd_to_entry.size() >= m_inotifyBudget) {
+        qCDebug(KDIRWATCH) << "inotify watch budget of" << m_inotifyBudget << "exhausted, not using it for" << e->path;
+        waitForINotify(e);
+        return false;
+    }
+
     // May as well register for almost everything - it's free!
     int mask = IN_DELETE | IN_DELETE_SELF | IN_CREATE | IN_MOVE | IN_MOVE_SELF | IN_DONT_FOLLOW | IN_MOVED_FROM | IN_MODIFY | IN_ATTRIB;
 
-    if ((e->wd = inotify_add_watch(m_inotify_fd, QFile::encodeName(e->path).data(), mask)) != -1) {
+    if ((e->wd = inotify_add_watch(m_inotify_fd, e->encodedPath().constData(), mask)) != -1) {
         m_inotify_wd_to_entry.insert(e->wd, e);
+        e->m_waitingForINotify = false;
         if (s_verboseDebug) {
             qCDebug(KDIRWATCH) << "inotify successfully used for monitoring" << e->path << "wd=" << e->wd;
         }
@@ -664,11 +1340,237 @@ bool KDirWatchPrivate::useINotify(Entry *e)
                              << "Because it reached its max_user_watches,\n"
                              << "you can increase the maximum number of file watches per user,\n"
                              << "by setting an appropriate fs.inotify.max_user_watches parameter in your /etc/sysctl.conf";
+        waitForINotify(e);
     } else {
         qCDebug(KDIRWATCH) << "inotify failed for monitoring" << e->path << ":" << strerror(errno) << " (errno:" << errno << ")";
     }
     return false;
 }
+
+/* Watches the file of @p e with the inotify watch of its directory, which
+ * reports the changes of its files by name as well. This way watching many
+ * files of the same directory takes a single watch, and the events are
+ * dispatched through the m_entries of the directory.
+ */
+bool KDirWatchPrivate::useParentINotify(Entry *e)
+{
+    const QString parentPath = e->parentDirectory();
+    addEntry(nullptr, parentPath, e, true);
+    Entry *parent = entry(parentPath);
+    if (!parent) {
+        return false;
+    }
+    if (parent->m_mode != INotifyMode || parent->wd == -1) {
+        // Not watched with inotify itself, the file needs a watch of its own
+        removeEntry(nullptr, parent, e);
+        return false;
+    }
+    if (s_verboseDebug) {
+        qCDebug(KDIRWATCH) << "inotify watch of" << parentPath << "shared for monitoring" << e->path;
+    }
+    return true;
+}
+#endif
+#if HAVE_SYS_FANOTIFY_H
+/* Watches e with the fanotify mark of its filesystem, marking the filesystem
+ * if it is the first one watched on it. The events of a file are reported for
+ * its directory, so what is looked up by handle is the directory.
+ * Returns false if not possible, e.g. without CAP_SYS_ADMIN.
+ */
+bool KDirWatchPrivate::useFANotify(Entry *e)
+{
+    e->dirty = false;
+
+    if (m_fanotify_fd < 0) {
+        return false;
+    }
+
+    e->m_mode = FANotifyMode;
+
+    if (e->m_status == NonExistent) {
+        addEntry(nullptr, e->parentDirectory(), e, true);
+        return true;
+    }
+
+    const QString dirPath = e->isDir ? e->path : e->parentDirectory();
+    const QByteArray encodedDirPath = QFile::encodeName(dirPath);
+    QByteArray fsid;
+    const QByteArray key = fanotifyDirectoryKey(encodedDirPath, &fsid);
+    if (key.isEmpty()) {
+        qCDebug(KDIRWATCH) << "fanotify failed for monitoring" << e->path << ":" << strerror(errno);
+        return false;
+    }
+
+    auto fs = m_fanotifyFilesystems.find(fsid);
+    if (fs == m_fanotifyFilesystems.end()) {
+        if (fanotify_mark(m_fanotify_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, s_fanotifyMask, AT_FDCWD, encodedDirPath.constData()) != 0) {
+            const int error = errno;
+            qCDebug(KDIRWATCH) << "fanotify failed for monitoring" << e->path << ":" << strerror(error) << " (errno:" << error << ")";
+            if (error == EPERM && m_fanotifyFilesystems.isEmpty()) {
+                // Not privileged, don't try again for every entry
+                qCDebug(KDIRWATCH) << "FANotify needs CAP_SYS_ADMIN, falling back";
+                delete mFanotifySn;
+                mFanotifySn = nullptr;
+                QT_CLOSE(m_fanotify_fd);
+                m_fanotify_fd = -1;
+            }
+            return false;
+        }
+        fs = m_fanotifyFilesystems.insert(fsid, {encodedDirPath, 0});
+        qCDebug(KDIRWATCH) << "fanotify mark added for the filesystem of" << dirPath;
+    }
+    ++fs->entries;
+
+    auto dir = m_fanotifyDirectories.find(key);
+    if (dir == m_fanotifyDirectories.end()) {
+        dir = m_fanotifyDirectories.insert(key, {dirPath, 0});
+    }
+    ++dir->entries;
+    e->m_fanotifyHandle = key;
+
+    if (s_verboseDebug) {
+        qCDebug(KDIRWATCH) << "fanotify successfully used for monitoring" << e->path;
+    }
+    return true;
+}
+
+// Stops looking up the events of e, removing the mark of its filesystem
+// with the last entry watched on it
+void KDirWatchPrivate::releaseFANotify(Entry *e)
+{
+    if (e->m_fanotifyHandle.isEmpty()) {
+        return;
+    }
+
+    const auto dir = m_fanotifyDirectories.find(e->m_fanotifyHandle);
+    if (dir != m_fanotifyDirectories.end() && --dir->entries == 0) {
+        m_fanotifyDirectories.erase(dir);
+    }
+
+    const auto fs = m_fanotifyFilesystems.find(e->m_fanotifyHandle.left(sizeof(fanotify_event_info_fid::fsid)));
+    if (fs != m_fanotifyFilesystems.end() && --fs->entries == 0) {
+        // Fails if the directory is gone, then the mark is kept until the
+        // filesystem is unmounted and its events are just not looked up
+        (void)fanotify_mark(m_fanotify_fd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM, s_fanotifyMask, AT_FDCWD, fs->path.constData());
+        m_fanotifyFilesystems.erase(fs);
+    }
+
+    e->m_fanotifyHandle.clear();
+}
+#endif
+#if HAVE_TREEWATCHER
+/* Watches e with the tree of m_treeWatcher containing its directory, adding
+ * the tree of the directory if there is none yet. Unlike with QFSWatch, the
+ * files and subdirectories of a watched directory don't take a handle of
+ * their own this way.
+ */
+bool KDirWatchPrivate::useTreeWatcher(Entry *e)
+{
+    e->dirty = false;
+
+    if (!m_treeWatcher) {
+        return false;
+    }
+
+    e->m_mode = TreeMode;
+
+    if (e->m_status == NonExistent) {
+        addEntry(nullptr, e->parentDirectory(), e, true);
+        return true;
+    }
+
+    const QString dirPath = e->isDir ? e->path : e->parentDirectory();
+    QString tree;
+    for (QString path = dirPath;;) {
+        if (m_trees.contains(path)) {
+            tree = path;
+            break;
+        }
+        const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+        if (slash < 0 || path.length() == 1) {
+            break;
+        }
+        path = slash == 0 ? QStringLiteral("/") : path.left(slash);
+    }
+
+    if (tree.isEmpty()) {
+        if (!m_treeWatcher->addTree(dirPath)) {
+            qCDebug(KDIRWATCH) << methodToString(s_treeMethod) << "failed for monitoring" << e->path;
+            return false;
+        }
+        tree = dirPath;
+        qCDebug(KDIRWATCH) << "Watching the tree" << tree << "with" << methodToString(s_treeMethod);
+    }
+
+    ++m_trees[tree];
+    e->m_tree = tree;
+    return true;
+}
+
+void KDirWatchPrivate::releaseTree(Entry *e)
+{
+    const auto it = m_trees.find(e->m_tree);
+    if (it != m_trees.end() && --it.value() == 0) {
+        m_treeWatcher->removeTree(it.key());
+        m_trees.erase(it);
+    }
+    e->m_tree.clear();
+}
+
+/* Handles the change of @p path somewhere in a tree watched by m_treeWatcher.
+ * The entry of the path and the one of its directory are scanned, and a new
+ * file or subdirectory is watched and reported for the clients of the
+ * directory that watch those, like addEntry() does for the existing ones.
+ */
+void KDirWatchPrivate::treePathChanged(const QString &path)
+{
+    Entry *e = entry(path);
+    const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+    Entry *dir = slash > 0 ? entry(path.left(slash)) : nullptr;
+    if (dir && (dir->m_mode != TreeMode || !dir->isDir)) {
+        dir = nullptr;
+    }
+    if ((!e || e->m_mode != TreeMode) && !dir) {
+        // Somewhere else in the tree
+        return;
+    }
+    ++m_statistics.eventsReceived;
+
+    if (!rescan_timer.isActive()) {
+        rescan_timer.start(m_PollInterval); // singleshot
+    }
+
+    if (e && e->m_mode == TreeMode) {
+        e->dirty = true;
+    }
+    if (!dir) {
+        return;
+    }
+    dir->dirty = true;
+
+    const QFileInfo info(path);
+    if (e || dir->m_clients.empty() || !(info.exists() || info.isSymLink())) {
+        return;
+    }
+
+    // treat symlinks as files--don't follow them.
+    const bool isDir = info.isDir() && !info.isSymLink();
+    const QString name = info.fileName();
+    if (isNoisyFile(QFile::encodeName(name).constData())) {
+        return;
+    }
+    const KDirWatch::WatchModes flag = isDir ? KDirWatch::WatchSubDirs : KDirWatch::WatchFiles;
+    bool reported = false;
+    for (const Client &client : std::as_const(dir->m_clients)) {
+        if (client.instance && (client.m_watchModes & flag) && client.accepts(QStringView(name), isDir)) {
+            addEntry(client.instance, path, nullptr, isDir, isDir ? client.m_watchModes : KDirWatch::WatchDirOnly, client.m_nameMatcher);
+            reported = true;
+        }
+    }
+    if (reported) {
+        emitEvent(dir, Created, path, isDir);
+    }
+}
 #endif
 #if HAVE_QFILESYSTEMWATCHER
 bool KDirWatchPrivate::useQFSWatch(Entry *e)
@@ -687,22 +1589,35 @@ bool KDirWatchPrivate::useQFSWatch(Entry *e)
         connect(fsWatcher, &QFileSystemWatcher::directoryChanged, this, &KDirWatchPrivate::fswEventReceived);
         connect(fsWatcher, &QFileSystemWatcher::fileChanged, this, &KDirWatchPrivate::fswEventReceived);
     }
-    fsWatcher->addPath(e->path);
+    if (m_pendingFswPaths) {
+        // Added by addEntries() in one go
+        m_pendingFswPaths->append(e->path);
+    } else {
+        fsWatcher->addPath(e->path);
+    }
     return true;
 }
 #endif
 
 bool KDirWatchPrivate::useStat(Entry *e)
 {
-    if (KFileSystemType::fileSystemType(e->path) == KFileSystemType::Nfs) { // TODO: or Smbfs?
+    if (e->m_mode == StatMode && --m_statFrequencies[e->freq] == 0) {
+        m_statFrequencies.erase(e->freq);
+    }
+
+    const KFileSystemType::Type fsType = KFileSystemType::fileSystemType(e->path);
+    if (fsType == KFileSystemType::Nfs) { // TODO: or Smbfs?
         useFreq(e, m_nfsPollInterval);
     } else {
         useFreq(e, m_PollInterval);
     }
+    e->m_onNetworkFs = fsType == KFileSystemType::Nfs || fsType == KFileSystemType::Smbfs;
+    ++m_statFrequencies[e->freq];
 
     if (e->m_mode != StatMode) {
         e->m_mode = StatMode;
         statEntries++;
+        scheduleScan(e, e->m_nextScan);
 
         if (statEntries == 1) {
             // if this was first STAT entry (=timer was stopped)
@@ -711,9 +1626,50 @@ bool KDirWatchPrivate::useStat(Entry *e)
         }
     }
 
-    qCDebug(KDIRWATCH) << " Setup Stat (freq " << e->freq << ") for " << e->path;
+    qCDebug(KDIRWATCH) << " Setup Stat (freq " << e->freq << ") for " << e->path;
+
+    return true;
+}
+
+/* Creates the entry for the new <path>, which is in the state <stat_buf>, without
+ * any clients and without a notification method set up yet.
+ */
+KDirWatchPrivate::Entry *KDirWatchPrivate::insertEntry(const QString &path, bool isDir, const StatResult &stat_buf)
+{
+    Entry *e = &m_mapEntries.try_emplace(path).first->second;
+
+    if (stat_buf.exists) {
+        e->isDir = stat_buf.isDir;
+#ifdef Q_OS_WIN
+        // ctime is the 'creation time' on windows - use mtime instead
+        e->m_ctime = stat_buf.mtime;
+#else
+        e->m_ctime = stat_buf.ctime;
+#endif
+        e->m_status = Normal;
+        e->m_nlink = stat_buf.nlink;
+        e->m_ino = stat_buf.ino;
+    } else {
+        e->isDir = isDir;
+        e->m_ctime = invalid_ctime;
+        e->m_status = NonExistent;
+        e->m_nlink = 0;
+        e->m_ino = 0;
+    }
+
+    e->path = path;
+    e->m_fingerprint = 0;
 
-    return true;
+    // the notification method is set up by addWatch()
+    e->m_mode = UnknownMode;
+    e->m_nextScan = 0;
+    e->m_scanInProgress = false;
+    e->m_activity = 0;
+    e->m_waitingForINotify = false;
+    e->m_onNetworkFs = false;
+    e->m_unsyncedScans = 0;
+
+    return e;
 }
 
 /* If <instance> !=0, this KDirWatch instance wants to watch at <_path>,
@@ -721,7 +1677,13 @@ bool KDirWatchPrivate::useStat(Entry *e)
  * Sometimes, entries are dependent on each other: if <sub_entry> !=0,
  * this entry needs another entry to watch itself (when notExistent).
  */
-void KDirWatchPrivate::addEntry(KDirWatch *instance, const QString &_path, Entry *sub_entry, bool isDir, KDirWatch::WatchModes watchModes)
+void KDirWatchPrivate::addEntry(KDirWatch *instance,
+                                const QString &_path,
+                                Entry *sub_entry,
+                                bool isDir,
+                                KDirWatch::WatchModes watchModes,
+                                const NameMatcherPtr &nameMatcher,
+                                const StatResult *knownStat)
 {
     QString path(_path);
     if (path.startsWith(QLatin1String(":/"))) {
@@ -743,14 +1705,18 @@ void KDirWatchPrivate::addEntry(KDirWatch *instance, const QString &_path, Entry
 
     auto it = m_mapEntries.find(path);
     if (it != m_mapEntries.end()) {
-        Entry &entry = it.value();
+        Entry &entry = it->second;
         if (sub_entry) {
-            entry.m_entries.append(sub_entry);
+            entry.addSubEntry(sub_entry);
             if (s_verboseDebug) {
                 qCDebug(KDIRWATCH) << "Added already watched Entry" << path << "(for" << sub_entry->path << ")";
             }
         } else {
-            entry.addClient(instance, watchModes);
+            if ((watchModes & KDirWatch::WatchContentChanges) && !entry.watchesContent()) {
+                entry.m_fingerprint = contentFingerprint(&entry);
+            }
+            entry.addClient(instance, watchModes, nameMatcher);
+            m_instanceEntries[instance].insert(&entry);
             if (s_verboseDebug) {
                 qCDebug(KDIRWATCH) << "Added already watched Entry" << path << "(now" << entry.clientCount() << "clients)"
                                    << QStringLiteral("[%1]").arg(instance->objectName());
@@ -761,62 +1727,35 @@ void KDirWatchPrivate::addEntry(KDirWatch *instance, const QString &_path, Entry
 
     // we have a new path to watch
 
-    QT_STATBUF stat_buf;
-    bool exists = (QT_STAT(QFile::encodeName(path).constData(), &stat_buf) == 0);
-
-    auto newIt = m_mapEntries.insert(path, Entry());
-    // the insert does a copy, so we have to use <e> now
-    Entry *e = &(*newIt);
+    const StatResult stat_buf = knownStat ? *knownStat : statNewEntry(path, isDir);
+    const bool exists = stat_buf.exists;
 
     if (exists) {
-        e->isDir = (stat_buf.st_mode & QT_STAT_MASK) == QT_STAT_DIR;
-
-#ifndef Q_OS_WIN
-        if (e->isDir && !isDir) {
-            if (QT_LSTAT(QFile::encodeName(path).constData(), &stat_buf) == 0) {
-                if ((stat_buf.st_mode & QT_STAT_MASK) == QT_STAT_LNK) {
-                    // if it's a symlink, don't follow it
-                    e->isDir = false;
-                }
-            }
-        }
-#endif
-
-        if (e->isDir && !isDir) {
+        if (stat_buf.isDir && !isDir) {
             qCWarning(KCOREADDONS_DEBUG) << "KDirWatch:" << path << "is a directory. Use addDir!";
-        } else if (!e->isDir && isDir) {
+        } else if (!stat_buf.isDir && isDir) {
             qCWarning(KCOREADDONS_DEBUG) << "KDirWatch:" << path << "is a file. Use addFile!";
         }
 
-        if (!e->isDir && (watchModes != KDirWatch::WatchDirOnly)) {
+        if (!stat_buf.isDir && (watchModes & ~KDirWatch::WatchModes(KDirWatch::WatchContentChanges)) != KDirWatch::WatchDirOnly) {
             qCWarning(KCOREADDONS_DEBUG) << "KDirWatch:" << path
                                          << "is a file. You can't use recursive or "
                                             "watchFiles options";
-            watchModes = KDirWatch::WatchDirOnly;
+            watchModes &= KDirWatch::WatchContentChanges;
         }
-
-#ifdef Q_OS_WIN
-        // ctime is the 'creation time' on windows - use mtime instead
-        e->m_ctime = stat_buf.st_mtime;
-#else
-        e->m_ctime = stat_buf.st_ctime;
-#endif
-        e->m_status = Normal;
-        e->m_nlink = stat_buf.st_nlink;
-        e->m_ino = stat_buf.st_ino;
-    } else {
-        e->isDir = isDir;
-        e->m_ctime = invalid_ctime;
-        e->m_status = NonExistent;
-        e->m_nlink = 0;
-        e->m_ino = 0;
     }
 
-    e->path = path;
+    Entry *e = insertEntry(path, isDir, stat_buf);
     if (sub_entry) {
-        e->m_entries.append(sub_entry);
+        e->addSubEntry(sub_entry);
     } else {
-        e->addClient(instance, watchModes);
+        e->addClient(instance, watchModes, nameMatcher);
+        if (watchModes & KDirWatch::WatchContentChanges) {
+            e->m_fingerprint = contentFingerprint(e);
+        }
+        if (instance) {
+            m_instanceEntries[instance].insert(e);
+        }
     }
 
     if (s_verboseDebug) {
@@ -824,10 +1763,6 @@ void KDirWatchPrivate::addEntry(KDirWatch *instance, const QString &_path, Entry
                                      << (sub_entry ? sub_entry->path : QString()) << " [" << (instance ? instance->objectName() : QString()) << "]";
     }
 
-    // now setup the notification method
-    e->m_mode = UnknownMode;
-    e->msecLeft = 0;
-
     if (isNoisyFile(QFile::encodeName(path).data())) {
         return;
     }
@@ -845,7 +1780,7 @@ void KDirWatchPrivate::addEntry(KDirWatch *instance, const QString &_path, Entry
         }
 
 #if HAVE_SYS_INOTIFY_H
-        if (m_preferredMethod == KDirWatch::INotify) {
+        if (m_preferredMethod == KDirWatch::INotify || m_preferredMethod == KDirWatch::FANotify) {
             // qCDebug(KDIRWATCH) << "Ignoring WatchFiles directive - this is implicit with inotify";
             // Placing a watch on individual files is redundant with inotify
             // (inotify gives us WatchFiles functionality "for free") and indeed
@@ -854,19 +1789,97 @@ void KDirWatchPrivate::addEntry(KDirWatch *instance, const QString &_path, Entry
         }
 #endif
 
+        const bool inBackground = watchModes & KDirWatch::WatchSubDirsInBackground;
+
         QDir basedir(e->path);
         const QFileInfoList contents = basedir.entryInfoList(filters);
         for (const QFileInfo &fileInfo : contents) {
             // treat symlinks as files--don't follow them.
             bool isDir = fileInfo.isDir() && !fileInfo.isSymLink();
+            if (nameMatcher && !nameMatcher->accepts(fileInfo.fileName(), isDir)) {
+                continue;
+            }
+
+            if (inBackground) {
+                m_pendingRegistrations.push_back({instance, fileInfo.absoluteFilePath(), isDir, isDir ? watchModes : KDirWatch::WatchDirOnly, nameMatcher});
+            } else {
+                addEntry(instance, fileInfo.absoluteFilePath(), nullptr, isDir, isDir ? watchModes : KDirWatch::WatchDirOnly, nameMatcher);
+            }
+        }
 
-            addEntry(instance, fileInfo.absoluteFilePath(), nullptr, isDir, isDir ? watchModes : KDirWatch::WatchDirOnly);
+        if (!m_pendingRegistrations.empty() && !m_registrationTimer.isActive()) {
+            m_registrationTimer.start(0);
         }
     }
 
     addWatch(e);
 }
 
+/* Like addEntry() for each of @p paths, but stat()s the new ones up front,
+ * several at a time if there are many, and registers the QFileSystemWatcher
+ * watches with a single call.
+ */
+void KDirWatchPrivate::addEntries(KDirWatch *instance,
+                                  const QStringList &paths,
+                                  bool isDir,
+                                  KDirWatch::WatchModes watchModes,
+                                  const NameMatcherPtr &nameMatcher)
+{
+    QStringList sortedPaths;
+    sortedPaths.reserve(paths.size());
+    for (const QString &path : paths) {
+        sortedPaths.append(path.length() > 1 && path.endsWith(QLatin1Char('/')) ? path.chopped(1) : path);
+    }
+    sortedPaths.sort();
+    sortedPaths.erase(std::unique(sortedPaths.begin(), sortedPaths.end()), sortedPaths.end());
+
+    QStringList newPaths;
+    for (const QString &path : std::as_const(sortedPaths)) {
+        if (m_mapEntries.find(path) != m_mapEntries.end()) {
+            addEntry(instance, path, nullptr, isDir, watchModes, nameMatcher);
+        } else {
+            newPaths.append(path);
+        }
+    }
+
+    std::vector<StatResult> results(newPaths.size());
+    const auto statBatch = [&newPaths, &results, isDir](qsizetype start) {
+        const qsizetype end = std::min(newPaths.size(), start + s_statBatchSize);
+        for (qsizetype i = start; i < end; ++i) {
+            results[i] = statNewEntry(newPaths.at(i), isDir);
+        }
+    };
+    if (newPaths.size() > s_statBatchSize) {
+        // Every job writes different elements, which were allocated before
+        QThreadPool pool;
+        pool.setMaxThreadCount(s_statThreadCount);
+        for (qsizetype start = 0; start < newPaths.size(); start += s_statBatchSize) {
+            pool.start([&statBatch, start]() {
+                statBatch(start);
+            });
+        }
+        pool.waitForDone();
+    } else if (!newPaths.isEmpty()) {
+        statBatch(0);
+    }
+
+#if HAVE_QFILESYSTEMWATCHER
+    QStringList fswPaths;
+    m_pendingFswPaths = &fswPaths;
+#endif
+    for (qsizetype i = 0; i < newPaths.size(); ++i) {
+        // Possibly added as the subdir of an earlier one in the meantime
+        const bool added = m_mapEntries.find(newPaths.at(i)) != m_mapEntries.end();
+        addEntry(instance, newPaths.at(i), nullptr, isDir, watchModes, nameMatcher, added ? nullptr : &results[i]);
+    }
+#if HAVE_QFILESYSTEMWATCHER
+    m_pendingFswPaths = nullptr;
+    if (!fswPaths.isEmpty()) {
+        fsWatcher->addPaths(fswPaths);
+    }
+#endif
+}
+
 void KDirWatchPrivate::addWatch(Entry *e)
 {
     // If the watch is on a network filesystem use the nfsPreferredMethod as the
@@ -909,10 +1922,28 @@ void KDirWatchPrivate::addWatch(Entry *e)
     case KDirWatch::Stat:
         entryAdded = useStat(e);
         break;
+#if HAVE_SYS_FANOTIFY_H
+    case KDirWatch::FANotify:
+        entryAdded = useFANotify(e);
+        break;
+#else
+    case KDirWatch::FANotify:
+        entryAdded = false;
+        break;
+#endif
+    case KDirWatch::FSEvents:
+    case KDirWatch::ReadDirectoryChanges:
+#if HAVE_TREEWATCHER
+        entryAdded = preferredMethod == s_treeMethod && useTreeWatcher(e);
+#else
+        entryAdded = false;
+#endif
+        break;
     }
 
     // Failing that try in order INotify, QFSWatch, Stat
     if (!entryAdded) {
+        ++m_statistics.fallbacks;
 #if HAVE_SYS_INOTIFY_H
         if (preferredMethod != KDirWatch::INotify && useINotify(e)) {
             return;
@@ -929,10 +1960,117 @@ void KDirWatchPrivate::addWatch(Entry *e)
     }
 }
 
+// Stops watching e, so that addWatch() can set up another method. Unlike
+// removeWatch() this also forgets about the StatMode polling.
+void KDirWatchPrivate::releaseWatch(Entry *e)
+{
+    removeWatch(e);
+#if HAVE_SYS_INOTIFY_H
+    e->wd = -1;
+#endif
+
+    if (e->m_mode == StatMode) {
+        statEntries--;
+        if (--m_statFrequencies[e->freq] == 0) {
+            m_statFrequencies.erase(e->freq);
+        }
+        if (statEntries == 0) {
+            m_statRescanTimer.stop();
+        }
+    }
+    e->m_mode = UnknownMode;
+}
+
+#if HAVE_SYS_INOTIFY_H
+// Notes that e could not get an inotify watch, so that slotRebalanceWatches()
+// considers giving it one
+void KDirWatchPrivate::waitForINotify(Entry *e)
+{
+    e->m_waitingForINotify = true;
+    if (!m_rebalanceTimer.isActive()) {
+        m_rebalanceTimer.start(s_rebalanceInterval);
+    }
+}
+#endif
+
+/* With more entries than inotify watches available (see KDIRWATCH_MAXINOTIFYWATCHES
+ * and fs.inotify.max_user_watches), hands the watches of the entries
+ * that changed least since the last call to those that changed most of the
+ * entries left to the fallback methods.
+ */
+void KDirWatchPrivate::slotRebalanceWatches()
+{
+#if HAVE_SYS_INOTIFY_H
+    // The files sharing the watch of their directory, see useParentINotify(), and
+    // the missing entries waiting for their creation, are only told about by it
+    const auto hasDependents = [](const Entry &entry) {
+        return std::any_of(entry.m_entries.cbegin(), entry.m_entries.cend(), [](const Entry *sub_entry) {
+            return sub_entry->m_mode == INotifyMode && sub_entry->wd == -1;
+        });
+    };
+
+    std::vector<Entry *> watched;
+    std::vector<Entry *> waiting;
+    for (auto &[path, entry] : m_mapEntries) {
+        if (entry.m_mode == INotifyMode && entry.wd != -1) {
+            if (!hasDependents(entry)) {
+                watched.push_back(&entry);
+            }
+        } else if (entry.m_waitingForINotify && entry.m_status == Normal && entry.isValid()) {
+            waiting.push_back(&entry);
+        }
+    }
+
+    if (waiting.empty()) {
+        m_rebalanceTimer.stop();
+    }
+
+    const std::size_t maxSwaps = std::min(watched.size(), waiting.size());
+    const auto lessActive = [](const Entry *a, const Entry *b) {
+        return a->m_activity < b->m_activity;
+    };
+    std::partial_sort(watched.begin(), watched.begin() + maxSwaps, watched.end(), lessActive);
+    std::partial_sort(waiting.begin(), waiting.begin() + maxSwaps, waiting.end(), [&lessActive](const Entry *a, const Entry *b) {
+        return lessActive(b, a);
+    });
+
+    int swaps = 0;
+    for (std::size_t i = 0; i < maxSwaps; ++i) {
+        Entry *idle = watched[i];
+        Entry *active = waiting[i];
+        if (active->m_activity <= idle->m_activity) {
+            break;
+        }
+
+        releaseWatch(idle);
+        releaseWatch(active);
+        if (!useINotify(active)) {
+            // Taken by another process in the meantime
+            addWatch(active);
+            addWatch(idle);
+            break;
+        }
+        addWatch(idle);
+        ++swaps;
+    }
+
+    if (swaps > 0) {
+        qCDebug(KDIRWATCH) << "Moved" << swaps << "inotify watches to more active entries";
+    }
+
+    // Only recent activity counts
+    for (auto &[path, entry] : m_mapEntries) {
+        entry.m_activity /= 2;
+    }
+#endif
+}
+
 void KDirWatchPrivate::removeWatch(Entry *e)
 {
 #if HAVE_SYS_INOTIFY_H
-    if (e->m_mode == INotifyMode) {
+    if (e->sharesParentWatch()) {
+        removeEntry(nullptr, e->parentDirectory(), e);
+    } else if (e->m_mode == INotifyMode) {
         m_inotify_wd_to_entry.remove(e->wd);
         (void)inotify_rm_watch(m_inotify_fd, e->wd);
         if (s_verboseDebug) {
@@ -940,6 +2078,16 @@ void KDirWatchPrivate::removeWatch(Entry *e)
         }
     }
 #endif
+#if HAVE_SYS_FANOTIFY_H
+    if (e->m_mode == FANotifyMode) {
+        releaseFANotify(e);
+    }
+#endif
+#if HAVE_TREEWATCHER
+    if (e->m_mode == TreeMode) {
+        releaseTree(e);
+    }
+#endif
 #if HAVE_QFILESYSTEMWATCHER
     if (e->m_mode == QFSWatchMode && fsWatcher) {
         if (s_verboseDebug) {
@@ -954,20 +2102,69 @@ void KDirWatchPrivate::removeEntry(KDirWatch *instance, const QString &_path, En
 {
     qCDebug(KDIRWATCH) << "path=" << _path << "sub_entry:" << sub_entry;
 
+    if (instance && !sub_entry) {
+        dropPendingRegistrations(instance, _path);
+    }
+
     Entry *e = entry(_path);
     if (e) {
         removeEntry(instance, e, sub_entry);
     }
 }
 
+// Forgets about registering the contents of @p path for @p instance in the
+// background, or everything of @p instance if @p path is empty.
+void KDirWatchPrivate::dropPendingRegistrations(KDirWatch *instance, const QString &path)
+{
+    if (m_pendingRegistrations.empty()) {
+        return;
+    }
+
+    QString prefix = path;
+    if (!prefix.endsWith(QLatin1Char('/'))) {
+        prefix += QLatin1Char('/');
+    }
+
+    auto it = std::remove_if(m_pendingRegistrations.begin(), m_pendingRegistrations.end(), [&](const PendingRegistration &registration) {
+        return registration.instance == instance && (path.isEmpty() || registration.path.startsWith(prefix));
+    });
+    m_pendingRegistrations.erase(it, m_pendingRegistrations.end());
+}
+
+void KDirWatchPrivate::slotRegisterPending()
+{
+    // Registering a dir may well queue its own contents
+    for (int i = 0; i < s_registrationBatchSize && !m_pendingRegistrations.empty(); ++i) {
+        const PendingRegistration registration = std::move(m_pendingRegistrations.front());
+        m_pendingRegistrations.pop_front();
+
+        if (registration.instance) {
+            addEntry(registration.instance, registration.path, nullptr, registration.isDir, registration.watchModes, registration.nameMatcher);
+        }
+    }
+
+    if (!m_pendingRegistrations.empty()) {
+        m_registrationTimer.start(0);
+    }
+}
+
 void KDirWatchPrivate::removeEntry(KDirWatch *instance, Entry *e, Entry *sub_entry)
 {
     removeList.remove(e);
 
     if (sub_entry) {
-        e->m_entries.removeAll(sub_entry);
+        e->removeSubEntry(sub_entry);
     } else {
         e->removeClient(instance);
+        if (e->findInstance(instance) == e->m_clients.end()) {
+            auto it = m_instanceEntries.find(instance);
+            if (it != m_instanceEntries.end()) {
+                it->remove(e);
+                if (it->isEmpty()) {
+                    m_instanceEntries.erase(it);
+                }
+            }
+        }
     }
 
     if (!e->m_clients.empty() || !e->m_entries.empty()) {
@@ -993,6 +2190,9 @@ void KDirWatchPrivate::removeEntry(KDirWatch *instance, Entry *e, Entry *sub_ent
 
     if (e->m_mode == StatMode) {
         statEntries--;
+        if (--m_statFrequencies[e->freq] == 0) {
+            m_statFrequencies.erase(e->freq);
+        }
         if (statEntries == 0) {
             m_statRescanTimer.stop(); // stop timer if lists are empty
             qCDebug(KDIRWATCH) << " Stopped Polling Timer";
@@ -1003,11 +2203,14 @@ void KDirWatchPrivate::removeEntry(KDirWatch *instance, Entry *e, Entry *sub_ent
         qCDebug(KDIRWATCH).nospace() << "Removed " << (e->isDir ? "Dir " : "File ") << e->path << " for " << (sub_entry ? sub_entry->path : QString()) << " ["
                                      << (instance ? instance->objectName() : QString()) << "]";
     }
-    QString p = e->path; // take a copy, QMap::remove takes a reference and deletes, since e points into the map
+    QString p = e->path; // take a copy, erase() takes a reference and deletes, since e points into the map
 #if HAVE_SYS_INOTIFY_H
     m_inotify_wd_to_entry.remove(e->wd);
 #endif
-    m_mapEntries.remove(p); // <e> not valid any more
+#if HAVE_SYS_FANOTIFY_H
+    releaseFANotify(e);
+#endif
+    m_mapEntries.erase(p); // <e> not valid any more
 }
 
 /* Called from KDirWatch destructor:
@@ -1015,18 +2218,17 @@ void KDirWatchPrivate::removeEntry(KDirWatch *instance, Entry *e, Entry *sub_ent
  */
 void KDirWatchPrivate::removeEntries(KDirWatch *instance)
 {
-    int minfreq = 3600000;
+    dropPendingRegistrations(instance, QString());
+    m_pendingRestores.remove(instance);
 
     QStringList pathList;
     // put all entries where instance is a client in list
-    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end(); ++it) {
-        Entry &entry = it.value();
-        auto clientIt = entry.findInstance(instance);
-        if (clientIt != entry.m_clients.end()) {
+    const QSet<Entry *> entries = m_instanceEntries.value(instance);
+    for (Entry *entry : entries) {
+        auto clientIt = entry->findInstance(instance);
+        if (clientIt != entry->m_clients.end()) {
             clientIt->count = 1; // forces deletion of instance as client
-            pathList.append(entry.path);
-        } else if (entry.m_mode == StatMode && entry.freq < minfreq) {
-            minfreq = entry.freq;
+            pathList.append(entry->path);
         }
     }
 
@@ -1034,6 +2236,7 @@ void KDirWatchPrivate::removeEntries(KDirWatch *instance)
         removeEntry(instance, path, nullptr);
     }
 
+    const int minfreq = m_statFrequencies.empty() ? 3600000 : m_statFrequencies.cbegin()->first;
     if (minfreq > freq) {
         // we can decrease the global polling frequency
         freq = minfreq;
@@ -1044,6 +2247,205 @@ void KDirWatchPrivate::removeEntries(KDirWatch *instance)
     }
 }
 
+bool KDirWatchPrivate::saveState(KDirWatch *instance, const QString &fileName) const
+{
+    QList<const NameMatcher *> nameMatchers;
+    std::vector<SavedEntry> entries;
+    const QSet<Entry *> instanceEntries = m_instanceEntries.value(instance);
+    for (const Entry *e : instanceEntries) {
+        const auto client = std::find_if(e->m_clients.cbegin(), e->m_clients.cend(), [instance](const Client &client) {
+            return client.instance == instance;
+        });
+        if (client == e->m_clients.cend()) {
+            continue;
+        }
+
+        int nameFilter = -1;
+        if (client->m_nameMatcher) {
+            nameFilter = nameMatchers.indexOf(client->m_nameMatcher.get());
+            if (nameFilter == -1) {
+                nameFilter = nameMatchers.size();
+                nameMatchers.append(client->m_nameMatcher.get());
+            }
+        }
+        entries.push_back({e->path, client->m_watchModes, client->count, nameFilter, e->isDir, e->m_status == Normal, e->m_ctime, e->m_ino, e->m_nlink});
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(KDIRWATCH) << "Cannot save the state to" << fileName << file.errorString();
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+    stream << s_stateMagic << s_stateVersion;
+    stream << qint32(nameMatchers.size());
+    for (const NameMatcher *nameMatcher : std::as_const(nameMatchers)) {
+        const KDirWatch::NameFilter filter = nameMatcher->nameFilter();
+        stream << filter.includePatterns << filter.excludePatterns;
+    }
+    stream << qint32(entries.size());
+    for (const SavedEntry &entry : entries) {
+        stream << entry.path << qint32(entry.watchModes.toInt()) << qint32(entry.count) << qint32(entry.nameFilter) << entry.isDir << entry.exists
+               << entry.ctime << entry.ino << qint32(entry.nlink);
+    }
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+bool KDirWatchPrivate::restoreState(KDirWatch *instance, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_5);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != s_stateMagic || version != s_stateVersion) {
+        qCWarning(KDIRWATCH) << fileName << "does not contain a saved state";
+        return false;
+    }
+
+    qint32 count = 0;
+    stream >> count;
+    QList<NameMatcherPtr> nameMatchers;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        KDirWatch::NameFilter filter;
+        stream >> filter.includePatterns >> filter.excludePatterns;
+        nameMatchers.append(std::make_shared<const NameMatcher>(filter));
+    }
+    stream >> count;
+    std::vector<SavedEntry> entries;
+    for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        SavedEntry entry;
+        qint32 watchModes = 0;
+        qint32 clientCount = 0;
+        qint32 nameFilter = 0;
+        qint32 nlink = 0;
+        stream >> entry.path >> watchModes >> clientCount >> nameFilter >> entry.isDir >> entry.exists >> entry.ctime >> entry.ino >> nlink;
+        entry.watchModes = KDirWatch::WatchModes::fromInt(watchModes);
+        entry.count = qMax(1, clientCount);
+        entry.nameFilter = nameFilter < nameMatchers.size() ? nameFilter : -1;
+        entry.nlink = nlink;
+        entries.push_back(std::move(entry));
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qCWarning(KDIRWATCH) << "The saved state in" << fileName << "is corrupt";
+        return false;
+    }
+
+    // Like slotStatRescan(), but the entries are only added once checked
+    PendingRestore &restore = m_pendingRestores[instance];
+    for (size_t start = 0; start < entries.size(); start += s_statBatchSize) {
+        ++restore.batches;
+        const auto end = entries.cbegin() + std::min(entries.size(), start + s_statBatchSize);
+        m_statPool.start([this, instance = QPointer<KDirWatch>(instance), batch = std::vector<SavedEntry>(entries.cbegin() + start, end), nameMatchers]() {
+            QList<StatResult> results;
+            results.reserve(batch.size());
+            for (const SavedEntry &entry : batch) {
+                results.append(statEntry(entry.path));
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this, instance, batch, nameMatchers, results]() {
+                    if (instance) {
+                        restoreEntries(instance, batch, nameMatchers, results);
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+    }
+    if (entries.empty()) {
+        ++restore.batches;
+        QMetaObject::invokeMethod(
+            this,
+            [this, instance = QPointer<KDirWatch>(instance)]() {
+                if (instance) {
+                    restoreEntries(instance, {}, {}, {});
+                }
+            },
+            Qt::QueuedConnection);
+    }
+    return true;
+}
+
+/* Watches @p entries again with the state in @p results, which differs from the
+ * saved one if they were changed since, and emits KDirWatch::stateRestored() once
+ * the last batch of the instance arrived.
+ */
+void KDirWatchPrivate::restoreEntries(KDirWatch *instance,
+                                      const std::vector<SavedEntry> &entries,
+                                      const QList<NameMatcherPtr> &nameMatchers,
+                                      const QList<StatResult> &results)
+{
+    const auto restore = m_pendingRestores.find(instance);
+    if (restore == m_pendingRestores.end()) {
+        // removed in the meantime
+        return;
+    }
+
+    QList<const SavedEntry *> changedDirs;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const SavedEntry &saved = entries[i];
+        const StatResult &result = results.at(i);
+        const time_t ctime = result.exists ? qMax(result.ctime, result.mtime) : invalid_ctime;
+        const bool changed = saved.exists != result.exists
+            || (result.exists && (ctime != time_t(saved.ctime) || result.ino != ino_t(saved.ino) || result.nlink != saved.nlink));
+        if (changed) {
+            restore->changedPaths.append(saved.path);
+            if (saved.isDir && result.exists && (saved.watchModes & KDirWatch::WatchSubDirs)) {
+                changedDirs.append(&saved);
+            }
+        }
+
+        const NameMatcherPtr nameMatcher = saved.nameFilter >= 0 ? nameMatchers.at(saved.nameFilter) : NameMatcherPtr();
+        Entry *e = entry(saved.path);
+        if (!e) {
+            // Like addEntry(), with the state just stat()ed. The saved
+            // entries include those of the subdirectories already.
+            e = insertEntry(saved.path, saved.isDir, result);
+            e->addClient(instance, saved.watchModes, nameMatcher);
+            if (saved.watchModes & KDirWatch::WatchContentChanges) {
+                e->m_fingerprint = contentFingerprint(e);
+            }
+            addWatch(e);
+        } else {
+            // Watched by another instance as well
+            if ((saved.watchModes & KDirWatch::WatchContentChanges) && !e->watchesContent()) {
+                e->m_fingerprint = contentFingerprint(e);
+            }
+            e->addClient(instance, saved.watchModes, nameMatcher);
+        }
+        e->findInstance(instance)->count += saved.count - 1;
+        m_instanceEntries[instance].insert(e);
+    }
+
+    // Subdirectories created in the meantime
+    for (const SavedEntry *saved : std::as_const(changedDirs)) {
+        const NameMatcherPtr nameMatcher = saved->nameFilter >= 0 ? nameMatchers.at(saved->nameFilter) : NameMatcherPtr();
+        const QFileInfoList contents = QDir(saved->path).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+        for (const QFileInfo &fileInfo : contents) {
+            const Entry *e = entry(fileInfo.absoluteFilePath());
+            if ((!e || std::none_of(e->m_clients.cbegin(), e->m_clients.cend(), [instance](const Client &client) {
+                    return client.instance == instance;
+                }))
+                && (!nameMatcher || nameMatcher->accepts(fileInfo.fileName(), true))) {
+                addEntry(instance, fileInfo.absoluteFilePath(), nullptr, true, saved->watchModes, nameMatcher);
+            }
+        }
+    }
+
+    if (--restore->batches == 0) {
+        const QStringList changedPaths = restore->changedPaths;
+        m_pendingRestores.erase(restore);
+        qCDebug(KDIRWATCH) << "Restored the state of" << instance << "with" << changedPaths.size() << "changed paths";
+        Q_EMIT instance->stateRestored(changedPaths);
+    }
+}
+
 // instance ==0: stop scanning for all instances
 bool KDirWatchPrivate::stopEntryScan(KDirWatch *instance, Entry *e)
 {
@@ -1096,18 +2498,17 @@ bool KDirWatchPrivate::restartEntryScan(KDirWatch *instance, Entry *e, bool noti
     int ev = NoChange;
     if (wasWatching == 0) {
         if (!notify) {
-            QT_STATBUF stat_buf;
-            bool exists = (QT_STAT(QFile::encodeName(e->path).constData(), &stat_buf) == 0);
-            if (exists) {
+            const StatResult stat_buf = statEntry(e->encodedPath());
+            if (stat_buf.exists) {
                 // ctime is the 'creation time' on windows, but with qMax
                 // we get the latest change of any kind, on any platform.
-                e->m_ctime = qMax(stat_buf.st_ctime, stat_buf.st_mtime);
+                e->m_ctime = qMax(stat_buf.ctime, stat_buf.mtime);
                 e->m_status = Normal;
                 if (s_verboseDebug) {
                     qCDebug(KDIRWATCH) << "Setting status to Normal for" << e << e->path;
                 }
-                e->m_nlink = stat_buf.st_nlink;
-                e->m_ino = stat_buf.st_ino;
+                e->m_nlink = stat_buf.nlink;
+                e->m_ino = stat_buf.ino;
 
                 // Same as in scanEntry: ensure no subentry in parent dir
                 removeEntry(nullptr, e->parentDirectory(), e);
@@ -1120,7 +2521,7 @@ bool KDirWatchPrivate::restartEntryScan(KDirWatch *instance, Entry *e, bool noti
                 }
             }
         }
-        e->msecLeft = 0;
+        e->m_nextScan = 0;
         ev = scanEntry(e);
     }
     emitEvent(e, ev);
@@ -1131,8 +2532,8 @@ bool KDirWatchPrivate::restartEntryScan(KDirWatch *instance, Entry *e, bool noti
 // instance ==0: stop scanning for all instances
 void KDirWatchPrivate::stopScan(KDirWatch *instance)
 {
-    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end(); ++it) {
-        stopEntryScan(instance, &it.value());
+    for (auto &[path, entry] : m_mapEntries) {
+        stopEntryScan(instance, &entry);
     }
 }
 
@@ -1142,8 +2543,16 @@ void KDirWatchPrivate::startScan(KDirWatch *instance, bool notify, bool skippedT
         resetList(instance, skippedToo);
     }
 
-    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end(); ++it) {
-        restartEntryScan(instance, &it.value(), notify);
+    if (instance) {
+        // Only entries with instance as a client can be affected
+        const QSet<Entry *> entries = m_instanceEntries.value(instance);
+        for (Entry *entry : entries) {
+            restartEntryScan(instance, entry, notify);
+        }
+    } else {
+        for (auto &[path, entry] : m_mapEntries) {
+            restartEntryScan(instance, &entry, notify);
+        }
     }
 
     // timer should still be running when in polling mode
@@ -1154,8 +2563,8 @@ void KDirWatchPrivate::resetList(KDirWatch *instance, bool skippedToo)
 {
     Q_UNUSED(instance);
 
-    for (auto it = m_mapEntries.begin(); it != m_mapEntries.end(); ++it) {
-        for (Client &client : it.value().m_clients) {
+    for (auto &[path, entry] : m_mapEntries) {
+        for (Client &client : entry.m_clients) {
             if (!client.watchingStopped || skippedToo) {
                 client.pending = NoChange;
             }
@@ -1172,7 +2581,7 @@ int KDirWatchPrivate::scanEntry(Entry *e)
         return NoChange;
     }
 
-    if (e->m_mode == INotifyMode) {
+    if (e->m_mode == INotifyMode || e->m_mode == FANotifyMode || e->m_mode == TreeMode) {
         // we know nothing has changed, no need to stat
         if (!e->dirty) {
             return NoChange;
@@ -1181,26 +2590,91 @@ int KDirWatchPrivate::scanEntry(Entry *e)
     }
 
     if (e->m_mode == StatMode) {
-        // only scan if timeout on entry timer happens;
+        // only scan if the entry is due;
         // e.g. when using 500msec global timer, a entry
         // with freq=5000 is only watched every 10th time
-
-        e->msecLeft -= freq;
-        if (e->msecLeft > 0) {
+        const qint64 now = m_scanClock.elapsed();
+        if (now < e->m_nextScan) {
             return NoChange;
         }
-        e->msecLeft += e->freq;
+        scheduleScan(e, now + e->freq);
     }
 
+    return applyStatResult(e, statEntry(e->encodedPath(), e->m_mode != StatMode || e->scanSyncs()));
+}
+
+// Thread-safe
+KDirWatchPrivate::StatResult KDirWatchPrivate::statEntry(const QString &path)
+{
+    return statEntry(QFile::encodeName(path));
+}
+
+// Thread-safe. Unless @p sync, a network filesystem may answer from the
+// attributes it cached instead of asking the server.
+KDirWatchPrivate::StatResult KDirWatchPrivate::statEntry(const QByteArray &encodedPath, bool sync)
+{
+    StatResult result;
+#if HAVE_STATX
+    // Only what applyStatResult() compares, and the type for addEntry()
+    struct statx statx_buf;
+    const unsigned int mask = STATX_TYPE | STATX_CTIME | STATX_MTIME | STATX_INO | STATX_NLINK;
+    if (statx(AT_FDCWD, encodedPath.constData(), sync ? AT_STATX_SYNC_AS_STAT : AT_STATX_DONT_SYNC, mask, &statx_buf) == 0) {
+        result.exists = true;
+        result.ctime = statx_buf.stx_ctime.tv_sec;
+        result.mtime = statx_buf.stx_mtime.tv_sec;
+        result.ino = statx_buf.stx_ino;
+        result.nlink = statx_buf.stx_nlink;
+        result.isDir = S_ISDIR(statx_buf.stx_mode);
+        return result;
+    }
+    if (errno != ENOSYS) {
+        return result;
+    }
+    // Not supported by the kernel
+#else
+    Q_UNUSED(sync)
+#endif
     QT_STATBUF stat_buf;
-    const bool exists = (QT_STAT(QFile::encodeName(e->path).constData(), &stat_buf) == 0);
-    if (exists) {
+    result.exists = (QT_STAT(encodedPath.constData(), &stat_buf) == 0);
+    if (result.exists) {
+        result.ctime = stat_buf.st_ctime;
+        result.mtime = stat_buf.st_mtime;
+        result.ino = stat_buf.st_ino;
+        result.nlink = stat_buf.st_nlink;
+        result.isDir = (stat_buf.st_mode & QT_STAT_MASK) == QT_STAT_DIR;
+    }
+    return result;
+}
+
+// Like statEntry(), but a symlink to a dir is not taken for a dir unless @p isDir
+KDirWatchPrivate::StatResult KDirWatchPrivate::statNewEntry(const QString &path, bool isDir)
+{
+    StatResult result = statEntry(path);
+#ifndef Q_OS_WIN
+    if (result.isDir && !isDir) {
+        QT_STATBUF stat_buf;
+        if (QT_LSTAT(QFile::encodeName(path).constData(), &stat_buf) == 0) {
+            if ((stat_buf.st_mode & QT_STAT_MASK) == QT_STAT_LNK) {
+                // if it's a symlink, don't follow it
+                result.isDir = false;
+            }
+        }
+    }
+#endif
+    return result;
+}
+
+// Compares @p result of stat()ing <e> with what we knew about it,
+// returns the event that happened on <e>
+int KDirWatchPrivate::applyStatResult(Entry *e, const StatResult &stat_buf)
+{
+    if (stat_buf.exists) {
         if (e->m_status == NonExistent) {
             // ctime is the 'creation time' on windows, but with qMax
             // we get the latest change of any kind, on any platform.
-            e->m_ctime = qMax(stat_buf.st_ctime, stat_buf.st_mtime);
+            e->m_ctime = qMax(stat_buf.ctime, stat_buf.mtime);
             e->m_status = Normal;
-            e->m_ino = stat_buf.st_ino;
+            e->m_ino = stat_buf.ino;
             if (s_verboseDebug) {
                 qCDebug(KDIRWATCH) << "Setting status to Normal for just created" << e << e->path;
             }
@@ -1215,29 +2689,28 @@ int KDirWatchPrivate::scanEntry(Entry *e)
             struct tm *tmp = localtime(&e->m_ctime);
             char outstr[200];
             strftime(outstr, sizeof(outstr), "%H:%M:%S", tmp);
-            qCDebug(KDIRWATCH) << e->path << "e->m_ctime=" << e->m_ctime << outstr << "stat_buf.st_ctime=" << stat_buf.st_ctime
-                               << "stat_buf.st_mtime=" << stat_buf.st_mtime << "e->m_nlink=" << e->m_nlink << "stat_buf.st_nlink=" << stat_buf.st_nlink
-                               << "e->m_ino=" << e->m_ino << "stat_buf.st_ino=" << stat_buf.st_ino;
+            qCDebug(KDIRWATCH) << e->path << "e->m_ctime=" << e->m_ctime << outstr << "stat_buf.ctime=" << stat_buf.ctime << "stat_buf.mtime=" << stat_buf.mtime
+                               << "e->m_nlink=" << e->m_nlink << "stat_buf.nlink=" << stat_buf.nlink << "e->m_ino=" << e->m_ino << "stat_buf.ino=" << stat_buf.ino;
         }
 #endif
 
         if ((e->m_ctime != invalid_ctime)
-            && (qMax(stat_buf.st_ctime, stat_buf.st_mtime) != e->m_ctime || stat_buf.st_ino != e->m_ino
-                || int(stat_buf.st_nlink) != int(e->m_nlink)
+            && (qMax(stat_buf.ctime, stat_buf.mtime) != e->m_ctime || stat_buf.ino != e->m_ino
+                || stat_buf.nlink != int(e->m_nlink)
 #ifdef Q_OS_WIN
                 // on Windows, we trust QFSW to get it right, the ctime comparisons above
                 // fail for example when adding files to directories on Windows
                 // which doesn't change the mtime of the directory
-                || e->m_mode == QFSWatchMode
+                || e->m_mode == QFSWatchMode || e->m_mode == TreeMode
 #endif
                 )) {
-            e->m_ctime = qMax(stat_buf.st_ctime, stat_buf.st_mtime);
-            e->m_nlink = stat_buf.st_nlink;
-            if (e->m_ino != stat_buf.st_ino) {
+            e->m_ctime = qMax(stat_buf.ctime, stat_buf.mtime);
+            e->m_nlink = stat_buf.nlink;
+            if (e->m_ino != stat_buf.ino) {
                 // The file got deleted and recreated. We need to watch it again.
                 removeWatch(e);
                 addWatch(e);
-                e->m_ino = stat_buf.st_ino;
+                e->m_ino = stat_buf.ino;
                 return (Deleted | Created);
             } else {
                 return Changed;
@@ -1265,8 +2738,13 @@ int KDirWatchPrivate::scanEntry(Entry *e)
  * and stored pending events. When watching is stopped, the event is
  * added to the pending events.
  */
-void KDirWatchPrivate::emitEvent(Entry *e, int event, const QString &fileName)
+void KDirWatchPrivate::emitEvent(Entry *e, int event, const QString &fileName, bool isDir)
 {
+    if (event != NoChange) {
+        // see slotRebalanceWatches()
+        ++e->m_activity;
+    }
+
     QString path(e->path);
     if (!fileName.isEmpty()) {
         if (!QDir::isRelativePath(fileName)) {
@@ -1285,6 +2763,21 @@ void KDirWatchPrivate::emitEvent(Entry *e, int event, const QString &fileName)
         qCDebug(KDIRWATCH) << event << path << e->m_clients.size() << "clients";
     }
 
+    // The file or subdirectory of e the event is about, for the clients filtering names
+    QStringView name;
+    if (path != e->path) {
+        name = QStringView(path).mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+    }
+
+    // Whether only the timestamps of the file changed, for the clients
+    // watching with KDirWatch::WatchContentChanges
+    bool sameContent = false;
+    if (event != NoChange && fileName.isEmpty() && e->watchesContent()) {
+        const quint64 fingerprint = contentFingerprint(e);
+        sameContent = event == Changed && fingerprint == e->m_fingerprint;
+        e->m_fingerprint = fingerprint;
+    }
+
     for (Client &c : e->m_clients) {
         if (c.instance == nullptr || c.count == 0) {
             continue;
@@ -1294,45 +2787,190 @@ void KDirWatchPrivate::emitEvent(Entry *e, int event, const QString &fileName)
             // Do not add event to a list of pending events, the docs say restartDirScan won't emit!
             continue;
         }
+        if (sameContent && c.m_watchModes.testFlag(KDirWatch::WatchContentChanges)) {
+            continue;
+        }
+        if (!name.isEmpty() && !c.accepts(name, isDir)) {
+            continue;
+        }
         // not stopped
         if (event == NoChange || event == Changed) {
             event |= c.pending;
         }
-        c.pending = NoChange;
-        if (event == NoChange) {
-            continue;
+        c.pending = NoChange;
+        if (event == NoChange) {
+            continue;
+        }
+
+        // Emit the signals delayed, to avoid unexpected re-entrance from the slots (#220153)
+        queueEvent(c.instance, event, path);
+    }
+}
+
+/* The fingerprint of the contents of the file of @p e for
+ * KDirWatch::WatchContentChanges: a hash of its size and of its first and
+ * last s_fingerprintBlockSize bytes, or 0 if it can't be read.
+ */
+quint64 KDirWatchPrivate::contentFingerprint(const Entry *e)
+{
+    QFile file(e->path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    const qint64 size = file.size();
+    const QByteArray head = file.read(s_fingerprintBlockSize);
+    QByteArray tail;
+    if (size > s_fingerprintBlockSize && file.seek(qMax<qint64>(s_fingerprintBlockSize, size - s_fingerprintBlockSize))) {
+        tail = file.read(s_fingerprintBlockSize);
+    }
+    // Never 0, which stands for an unreadable file
+    return qHashMulti(0, size, head, tail) | 1;
+}
+
+/* Queues @p event of @p path for delivery to @p instance by slotEmitPending(),
+ * dropping it if the last event queued for @p path is the same. This way a
+ * storm of changes to the same files (e.g. from "git checkout") results in
+ * a single signal per file.
+ */
+void KDirWatchPrivate::queueEvent(KDirWatch *instance, int event, const QString &path, const QString &newPath)
+{
+    PendingEvents &pending = (m_queueRecoveredEvents ? m_recoveredEvents : m_pendingEvents)[instance];
+    if (!pending.instance) {
+        // New or left over by a deleted instance at the same address
+        pending = PendingEvents();
+        pending.instance = instance;
+    }
+
+    // Also for the coalesced events, which still postpone a debounced delivery
+    const qint64 now = m_scanClock.elapsed();
+    if (pending.events.empty()) {
+        pending.firstQueued = now;
+    }
+    pending.lastQueued = now;
+
+    const auto last = pending.lastEvent.constFind(path);
+    if (last != pending.lastEvent.constEnd() && pending.events[last.value()].event == event && pending.events[last.value()].newPath == newPath) {
+        ++m_statistics.eventsCoalesced;
+        return;
+    }
+
+    pending.lastEvent.insert(path, qsizetype(pending.events.size()));
+    pending.events.push_back({path, event, newPath});
+
+    if (!m_emitTimer.isActive() && !m_queueRecoveredEvents) {
+        m_emitTimer.start(m_coalesceInterval);
+    }
+}
+
+void KDirWatchPrivate::slotEmitPending()
+{
+    // The slots may well queue more events, or delete the instances
+    QHash<KDirWatch *, PendingEvents> pendingEvents = std::exchange(m_pendingEvents, {});
+
+    // The events of the instances limiting their delivery stay queued until due,
+    // ahead of the ones the slots queue
+    if (!m_deliveryLimits.isEmpty()) {
+        const qint64 now = m_scanClock.elapsed();
+        qint64 nextDue = -1;
+        for (auto it = pendingEvents.begin(); it != pendingEvents.end();) {
+            const auto limits = m_deliveryLimits.find(it.key());
+            if (!it->instance || limits == m_deliveryLimits.end()) {
+                ++it;
+                continue;
+            }
+            const qint64 due = deliveryDue(it.key(), *it);
+            if (due > now) {
+                nextDue = nextDue < 0 ? due : qMin(nextDue, due);
+                m_pendingEvents.insert(it.key(), std::move(*it));
+                it = pendingEvents.erase(it);
+            } else {
+                limits->lastDelivery = now;
+                ++it;
+            }
+        }
+        if (nextDue >= 0) {
+            m_deliveryTimer.start(nextDue - now);
         }
+    }
 
-        // Emit the signals delayed, to avoid unexpected re-entrance from the slots (#220153)
+    for (const PendingEvents &pending : std::as_const(pendingEvents)) {
+        QStringList paths;
+        QSet<QString> renamedPaths;
+        for (std::size_t i = 0; i < pending.events.size() && pending.instance; ++i) {
+            const PendingEvent &pendingEvent = pending.events[i];
 
-        if (event & Deleted) {
-            QMetaObject::invokeMethod(
-                c.instance,
-                [c, path]() {
-                    c.instance->setDeleted(path);
-                },
-                Qt::QueuedConnection);
+            if (pendingEvent.event & Deleted) {
+                pending.instance->setDeleted(pendingEvent.path);
+            }
+
+            if ((pendingEvent.event & Created) && pending.instance) {
+                pending.instance->setCreated(pendingEvent.path);
+                // possible emit Change event after creation
+            }
+
+            if ((pendingEvent.event & Changed) && pending.instance) {
+                pending.instance->setDirty(pendingEvent.path);
+            }
+
+            if ((pendingEvent.event & Renamed) && pending.instance) {
+                qCDebug(KDIRWATCH) << pending.instance->objectName() << "emitting renamed" << pendingEvent.path << pendingEvent.newPath;
+                Q_EMIT pending.instance->renamed(pendingEvent.path, pendingEvent.newPath);
+            }
+
+            // List every path once, in the order of their last events
+            if (pending.lastEvent.value(pendingEvent.path) == qsizetype(i)) {
+                paths.append(pendingEvent.path);
+            }
+            // New paths of renames without events of their own
+            if (!pendingEvent.newPath.isEmpty() && !pending.lastEvent.contains(pendingEvent.newPath) && !renamedPaths.contains(pendingEvent.newPath)) {
+                renamedPaths.insert(pendingEvent.newPath);
+                paths.append(pendingEvent.newPath);
+            }
         }
 
-        if (event & Created) {
-            QMetaObject::invokeMethod(
-                c.instance,
-                [c, path]() {
-                    c.instance->setCreated(path);
-                },
-                Qt::QueuedConnection);
-            // possible emit Change event after creation
+        if (pending.instance && !paths.isEmpty()) {
+            Q_EMIT pending.instance->pathsChanged(paths);
         }
+    }
+}
 
-        if (event & Changed) {
-            QMetaObject::invokeMethod(
-                c.instance,
-                [c, path]() {
-                    c.instance->setDirty(path);
-                },
-                Qt::QueuedConnection);
+/* Returns when the events @p pending of @p instance may be delivered, in ms
+ * of m_scanClock, considering the limits the instance set: not before the
+ * delivery interval passed since the last delivery, and once debounced, not
+ * before no events came for the debounce interval, or the delivery interval
+ * passed since the first one.
+ */
+qint64 KDirWatchPrivate::deliveryDue(KDirWatch *instance, const PendingEvents &pending) const
+{
+    const auto limits = m_deliveryLimits.constFind(instance);
+    if (limits == m_deliveryLimits.cend()) {
+        return 0;
+    }
+
+    qint64 due = 0;
+    if (limits->debounce > 0) {
+        due = pending.lastQueued + limits->debounce;
+        if (limits->interval > 0) {
+            due = qMin(due, pending.firstQueued + limits->interval);
         }
     }
+    if (limits->interval > 0 && limits->lastDelivery >= 0) {
+        due = qMax(due, limits->lastDelivery + limits->interval);
+    }
+    return due;
+}
+
+void KDirWatchPrivate::deliveryLimitsChanged(KDirWatch *instance)
+{
+    const auto limits = m_deliveryLimits.constFind(instance);
+    if (limits != m_deliveryLimits.cend() && limits->interval == 0 && limits->debounce == 0) {
+        m_deliveryLimits.erase(limits);
+    }
+    // The events held back may be due earlier now
+    if (m_pendingEvents.contains(instance)) {
+        m_emitTimer.start(m_coalesceInterval);
+    }
 }
 
 // Remove entries which were marked to be removed
@@ -1353,12 +2991,41 @@ void KDirWatchPrivate::slotRemoveDelayed()
  */
 void KDirWatchPrivate::slotRescan()
 {
+    KTRACE_SCOPE_ARG("KDirWatch::rescan", "entries", qulonglong(m_mapEntries.size()));
     if (s_verboseDebug) {
         qCDebug(KDIRWATCH);
     }
 
-    EntryMap::Iterator it;
+    if (rescan_all) {
+        // mark all as dirty
+        for (auto &[path, entry] : m_mapEntries) {
+            entry.dirty = true;
+        }
+        rescan_all = false;
+    } else {
+        // propagate dirty flag to dependent entries (e.g. file watches)
+        for (auto &[path, entry] : m_mapEntries) {
+            if ((entry.m_mode == INotifyMode || entry.m_mode == QFSWatchMode || entry.m_mode == FANotifyMode || entry.m_mode == TreeMode) && entry.dirty) {
+                entry.propagate_dirty();
+            }
+        }
+    }
+
+    // addEntry() in rescanEntries() may rehash m_mapEntries, which invalidates
+    // iterators but not the entries themselves. These are not removed either,
+    // while delayRemove is set.
+    std::vector<Entry *> entries;
+    entries.reserve(m_mapEntries.size());
+    for (auto &[path, entry] : m_mapEntries) {
+        entries.push_back(&entry);
+    }
+    rescanEntries(entries);
+}
 
+// Scans @p entries and sets up the watches of the ones created or deleted,
+// for slotRescan() and slotRecoverOverflow()
+void KDirWatchPrivate::rescanEntries(const std::vector<Entry *> &entries)
+{
     // People can do very long things in the slot connected to dirty(),
     // like showing a message box. We don't want to keep polling during
     // that time, otherwise the value of 'delayRemove' will be reset.
@@ -1373,32 +3040,14 @@ void KDirWatchPrivate::slotRescan()
     // ### TODO: now the emitEvent delays emission, this can be cleaned up
     delayRemove = true;
 
-    if (rescan_all) {
-        // mark all as dirty
-        it = m_mapEntries.begin();
-        for (; it != m_mapEntries.end(); ++it) {
-            (*it).dirty = true;
-        }
-        rescan_all = false;
-    } else {
-        // propagate dirty flag to dependent entries (e.g. file watches)
-        it = m_mapEntries.begin();
-        for (; it != m_mapEntries.end(); ++it) {
-            if (((*it).m_mode == INotifyMode || (*it).m_mode == QFSWatchMode) && (*it).dirty) {
-                (*it).propagate_dirty();
-            }
-        }
-    }
-
 #if HAVE_SYS_INOTIFY_H
     QList<Entry *> cList;
 #endif
 
-    it = m_mapEntries.begin();
-    for (; it != m_mapEntries.end(); ++it) {
-        // we don't check invalid entries (i.e. remove delayed)
-        Entry *entry = &(*it);
-        if (!entry->isValid()) {
+    for (Entry *entry : entries) {
+        // we don't check invalid entries (i.e. remove delayed), and
+        // StatMode entries are scanned by slotStatRescan() in the background
+        if (!entry->isValid() || entry->m_mode == StatMode) {
             continue;
         }
 
@@ -1420,11 +3069,33 @@ void KDirWatchPrivate::slotRescan()
                     qCDebug(KDIRWATCH) << "scanEntry says" << entry->path << "was created. wd=" << entry->wd;
                 }
                 if (entry->wd < 0) {
-                    cList.append(entry);
                     addWatch(entry);
+                    if (!entry->sharesParentWatch()) {
+                        cList.append(entry);
+                    }
                 }
             }
             break;
+#endif
+#if HAVE_SYS_FANOTIFY_H
+        case FANotifyMode:
+            if (ev == Deleted) {
+                releaseFANotify(entry);
+                addEntry(nullptr, entry->parentDirectory(), entry, true);
+            } else if (ev == Created) {
+                addWatch(entry);
+            }
+            break;
+#endif
+#if HAVE_TREEWATCHER
+        case TreeMode:
+            if (ev == Deleted) {
+                releaseTree(entry);
+                addEntry(nullptr, entry->parentDirectory(), entry, true);
+            } else if (ev == Created) {
+                addWatch(entry);
+            }
+            break;
 #endif
         case QFSWatchMode:
             if (ev == Created) {
@@ -1448,7 +3119,8 @@ void KDirWatchPrivate::slotRescan()
                 if (s_verboseDebug) {
                     qCDebug(KDIRWATCH) << "processing pending file change for" << changedFilename;
                 }
-                emitEvent(entry, Changed, changedFilename);
+                const Entry *changed = changedFilename != entry->path ? this->entry(changedFilename) : nullptr;
+                emitEvent(entry, Changed, changedFilename, changed && changed->isDir);
             }
             entry->m_pendingFileChanges.clear();
         }
@@ -1473,6 +3145,172 @@ void KDirWatchPrivate::slotRescan()
     QTimer::singleShot(0, this, &KDirWatchPrivate::slotRemoveDelayed);
 }
 
+/* Called when the kernel dropped events, so any of the entries watched with
+ * inotify or fanotify may have changed unnoticed. Instead of stat()ing all of
+ * them at once like rescan_all, slotRecoverOverflow() scans them in batches,
+ * the most active ones first as these most likely missed an event.
+ */
+void KDirWatchPrivate::recoverFromOverflow()
+{
+    std::vector<const Entry *> entries;
+    for (const auto &[path, entry] : m_mapEntries) {
+        if (entry.isValid() && (entry.m_mode == INotifyMode || entry.m_mode == FANotifyMode || entry.m_mode == TreeMode)) {
+            entries.push_back(&entry);
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry *a, const Entry *b) {
+        return a->m_activity > b->m_activity;
+    });
+
+    // A repeated overflow starts over, with the current activity
+    m_overflowRecovery.clear();
+    for (const Entry *e : entries) {
+        m_overflowRecovery.push_back(e->path);
+    }
+
+    if (!m_overflowRecovery.empty()) {
+        m_overflowRecoveryTimer.start(0);
+    }
+}
+
+void KDirWatchPrivate::slotRecoverOverflow()
+{
+    KTRACE_SCOPE_ARG("KDirWatch::recoverOverflow", "remaining", qulonglong(m_overflowRecovery.size()));
+
+    // Only the entries of this batch are scanned, along with the missing ones
+    // waiting for their creation in them
+    std::vector<Entry *> batch;
+    for (int i = 0; i < s_overflowBatchSize && !m_overflowRecovery.empty(); ++i) {
+        Entry *e = entry(m_overflowRecovery.front());
+        m_overflowRecovery.pop_front();
+        if (e && (e->m_mode == INotifyMode || e->m_mode == FANotifyMode || e->m_mode == TreeMode)) {
+            e->dirty = true;
+            batch.push_back(e);
+            for (Entry *sub_entry : std::as_const(e->m_entries)) {
+                if (sub_entry->m_status == NonExistent) {
+                    sub_entry->dirty = true;
+                    batch.push_back(sub_entry);
+                }
+            }
+        }
+    }
+
+    // The events found are held back until the last batch, so that the
+    // instances get a single notification. The events of the other entries
+    // are delivered as usual meanwhile.
+    m_queueRecoveredEvents = true;
+    rescanEntries(batch);
+    m_queueRecoveredEvents = false;
+
+    if (!m_overflowRecovery.empty()) {
+        m_overflowRecoveryTimer.start(0);
+        return;
+    }
+    const QHash<KDirWatch *, PendingEvents> recoveredEvents = std::exchange(m_recoveredEvents, {});
+    for (const PendingEvents &pending : recoveredEvents) {
+        if (!pending.instance) {
+            continue;
+        }
+        for (const PendingEvent &event : pending.events) {
+            queueEvent(pending.instance, event.event, event.path, event.newPath);
+        }
+    }
+}
+
+void KDirWatchPrivate::scheduleScan(Entry *e, qint64 due)
+{
+    e->m_nextScan = due;
+    m_scanQueue.emplace(due, e->path);
+}
+
+// Scans the StatMode entries that are due, instead of visiting all entries
+// like slotRescan() does. The stat() calls run on m_statPool, and the
+// results are handled by statResultsReceived().
+void KDirWatchPrivate::slotStatRescan()
+{
+    struct StatRequest {
+        QString path;
+        QByteArray encodedPath;
+        bool sync;
+    };
+    QList<StatRequest> requests;
+    const qint64 now = m_scanClock.elapsed();
+    while (!m_scanQueue.empty() && m_scanQueue.top().first <= now) {
+        const auto [due, path] = m_scanQueue.top();
+        m_scanQueue.pop();
+
+        Entry *e = entry(path);
+        if (!e || e->m_mode != StatMode || e->m_nextScan != due) {
+            // removed, or rescheduled in the meantime
+            continue;
+        }
+
+        scheduleScan(e, now + e->freq);
+        if (!e->isValid() || e->m_scanInProgress) {
+            // remove delayed (but possibly re-added before it happens), or
+            // still waiting for the previous scan
+            continue;
+        }
+
+        e->m_scanInProgress = true;
+        requests.append({e->path, e->encodedPath(), e->scanSyncs()});
+    }
+
+    for (qsizetype start = 0; start < requests.size(); start += s_statBatchSize) {
+        m_statPool.start([this, batch = requests.mid(start, s_statBatchSize)]() {
+            KNetworkMounts *networkMounts = KNetworkMounts::self();
+            QElapsedTimer timer;
+            QList<QPair<QString, StatResult>> results;
+            results.reserve(batch.size());
+            for (const StatRequest &request : batch) {
+                timer.start();
+                results.append(qMakePair(request.path, statEntry(request.encodedPath, request.sync)));
+                // For KNetworkMounts::AdaptiveSlowPathDetection, the others
+                // were answered from the cache of the client
+                if (request.sync) {
+                    networkMounts->recordLatency(request.path, std::chrono::microseconds(timer.nsecsElapsed() / 1000));
+                }
+            }
+
+            QMetaObject::invokeMethod(
+                this,
+                [this, results]() {
+                    statResultsReceived(results);
+                },
+                Qt::QueuedConnection);
+        });
+    }
+}
+
+void KDirWatchPrivate::statResultsReceived(const QList<QPair<QString, StatResult>> &results)
+{
+    // See slotRescan()
+    delayRemove = true;
+
+    for (const auto &[path, result] : results) {
+        Entry *e = entry(path);
+        if (!e || !e->m_scanInProgress) {
+            // removed in the meantime
+            continue;
+        }
+        e->m_scanInProgress = false;
+        if (e->m_mode != StatMode || !e->isValid()) {
+            continue;
+        }
+
+        const int ev = applyStatResult(e, result);
+        if (s_verboseDebug) {
+            qCDebug(KDIRWATCH) << "scanEntry for" << e->path << "says" << ev;
+        }
+        if (ev != NoChange) {
+            ++m_statistics.eventsReceived;
+            emitEvent(e, ev);
+        }
+    }
+
+    QTimer::singleShot(0, this, &KDirWatchPrivate::slotRemoveDelayed);
+}
+
 bool KDirWatchPrivate::isNoisyFile(const char *filename)
 {
     // $HOME/.X.err grows with debug output, so don't notify change
@@ -1494,6 +3332,92 @@ bool KDirWatchPrivate::isNoisyFile(const char *filename)
     return false;
 }
 
+// Skips the rest of the character starting at @p i, for '?' to match whole UTF-8 sequences
+static qsizetype nextCharacter(QByteArrayView name, qsizetype i)
+{
+    ++i;
+    while (i < name.size() && (uchar(name[i]) & 0xc0) == 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+static qsizetype nextCharacter(QStringView, qsizetype i)
+{
+    return i + 1;
+}
+
+/* Whether @p name matches the wildcard @p pattern, where '*' matches any
+ * number of characters and '?' one. On a mismatch after a '*', the match
+ * is retried with the '*' covering one more character, which is linear for
+ * the usual patterns with a single '*'.
+ */
+template<typename View, typename Pattern>
+static bool wildcardMatches(const Pattern &pattern, View name)
+{
+    qsizetype p = 0;
+    qsizetype n = 0;
+    qsizetype starPattern = -1;
+    qsizetype starName = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && pattern[p] == u'?') {
+            ++p;
+            n = nextCharacter(name, n);
+        } else if (p < pattern.size() && pattern[p] == u'*') {
+            starPattern = ++p;
+            starName = n;
+        } else if (p < pattern.size() && pattern[p] == name[n]) {
+            ++p;
+            ++n;
+        } else if (starPattern != -1) {
+            p = starPattern;
+            n = starName = nextCharacter(name, starName);
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == u'*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+template<typename View, typename Patterns>
+static bool anyMatches(const Patterns &patterns, View name)
+{
+    return std::any_of(patterns.cbegin(), patterns.cend(), [name](const auto &pattern) {
+        return wildcardMatches(pattern, name);
+    });
+}
+
+KDirWatchPrivate::NameMatcher::NameMatcher(const KDirWatch::NameFilter &filter)
+    : m_includes(filter.includePatterns)
+    , m_excludes(filter.excludePatterns)
+{
+    for (const QString &pattern : std::as_const(m_includes)) {
+        m_encodedIncludes.append(QFile::encodeName(pattern));
+    }
+    for (const QString &pattern : std::as_const(m_excludes)) {
+        m_encodedExcludes.append(QFile::encodeName(pattern));
+    }
+}
+
+bool KDirWatchPrivate::NameMatcher::accepts(QStringView name, bool isDir) const
+{
+    if (anyMatches(m_excludes, name)) {
+        return false;
+    }
+    return isDir || m_includes.isEmpty() || anyMatches(m_includes, name);
+}
+
+bool KDirWatchPrivate::NameMatcher::accepts(QByteArrayView name, bool isDir) const
+{
+    if (anyMatches(m_encodedExcludes, name)) {
+        return false;
+    }
+    return isDir || m_encodedIncludes.isEmpty() || anyMatches(m_encodedIncludes, name);
+}
+
 void KDirWatchPrivate::ref(KDirWatch *watch)
 {
     m_referencesObjects.push_back(watch);
@@ -1502,6 +3426,8 @@ void KDirWatchPrivate::ref(KDirWatch *watch)
 void KDirWatchPrivate::unref(KDirWatch *watch)
 {
     m_referencesObjects.removeOne(watch);
+    m_pendingEvents.remove(watch);
+    m_deliveryLimits.remove(watch);
     if (m_referencesObjects.isEmpty()) {
         destroyPrivate();
     }
@@ -1552,10 +3478,11 @@ void KDirWatchPrivate::fswEventReceived(const QString &path)
     if (s_verboseDebug) {
         qCDebug(KDIRWATCH) << path;
     }
+    ++m_statistics.eventsReceived;
 
     auto it = m_mapEntries.find(path);
     if (it != m_mapEntries.end()) {
-        Entry *entry = &it.value();
+        Entry *entry = &it->second;
         entry->dirty = true;
         const int ev = scanEntry(entry);
         if (s_verboseDebug) {
@@ -1633,17 +3560,66 @@ KDirWatch::~KDirWatch()
 }
 
 void KDirWatch::addDir(const QString &_path, WatchModes watchModes)
+{
+    addDir(_path, watchModes, NameFilter());
+}
+
+void KDirWatch::addDir(const QString &_path, WatchModes watchModes, const NameFilter &filter)
 {
     if (KNetworkMounts::self()->isOptionEnabledForPath(_path, KNetworkMounts::KDirWatchDontAddWatches)) {
         return;
     }
 
+    if (watchModes & WatchSubDirsInBackground) {
+        watchModes |= WatchSubDirs;
+    }
+
+    if (d) {
+        KDirWatchPrivate::NameMatcherPtr nameMatcher;
+        if (!filter.includePatterns.isEmpty() || !filter.excludePatterns.isEmpty()) {
+            nameMatcher = std::make_shared<const KDirWatchPrivate::NameMatcher>(filter);
+        }
+        d->addEntry(this, _path, nullptr, true, watchModes, nameMatcher);
+    }
+}
+
+// The paths addDir() and addFile() would not skip
+static QStringList filterNetworkMounts(const QStringList &paths)
+{
+    QStringList ret;
+    ret.reserve(paths.size());
+    for (const QString &path : paths) {
+        if (!KNetworkMounts::self()->isOptionEnabledForPath(path, KNetworkMounts::KDirWatchDontAddWatches)) {
+            ret.append(path);
+        }
+    }
+    return ret;
+}
+
+void KDirWatch::addDirs(const QStringList &paths, WatchModes watchModes)
+{
+    if (watchModes & WatchSubDirsInBackground) {
+        watchModes |= WatchSubDirs;
+    }
+
+    if (d) {
+        d->addEntries(this, filterNetworkMounts(paths), true, watchModes, KDirWatchPrivate::NameMatcherPtr());
+    }
+}
+
+void KDirWatch::addFiles(const QStringList &files, WatchModes watchModes)
+{
     if (d) {
-        d->addEntry(this, _path, nullptr, true, watchModes);
+        d->addEntries(this, filterNetworkMounts(files), false, watchModes & WatchContentChanges, KDirWatchPrivate::NameMatcherPtr());
     }
 }
 
 void KDirWatch::addFile(const QString &_path)
+{
+    addFile(_path, WatchDirOnly);
+}
+
+void KDirWatch::addFile(const QString &_path, WatchModes watchModes)
 {
     if (KNetworkMounts::self()->isOptionEnabledForPath(_path, KNetworkMounts::KDirWatchDontAddWatches)) {
         return;
@@ -1653,7 +3629,7 @@ void KDirWatch::addFile(const QString &_path)
         return;
     }
 
-    d->addEntry(this, _path, nullptr, false);
+    d->addEntry(this, _path, nullptr, false, watchModes & WatchContentChanges);
 }
 
 QDateTime KDirWatch::ctime(const QString &_path) const
@@ -1742,6 +3718,42 @@ bool KDirWatch::contains(const QString &_path) const
     return false;
 }
 
+bool KDirWatch::saveState(const QString &fileName) const
+{
+    return d && d->saveState(const_cast<KDirWatch *>(this), fileName);
+}
+
+bool KDirWatch::restoreState(const QString &fileName)
+{
+    return d && d->restoreState(this, fileName);
+}
+
+void KDirWatch::setDeliveryInterval(std::chrono::milliseconds interval)
+{
+    if (d) {
+        d->m_deliveryLimits[this].interval = qMax<qint64>(0, interval.count());
+        d->deliveryLimitsChanged(this);
+    }
+}
+
+std::chrono::milliseconds KDirWatch::deliveryInterval() const
+{
+    return std::chrono::milliseconds(d ? d->m_deliveryLimits.value(const_cast<KDirWatch *>(this)).interval : 0);
+}
+
+void KDirWatch::setDebounceInterval(std::chrono::milliseconds interval)
+{
+    if (d) {
+        d->m_deliveryLimits[this].debounce = qMax<qint64>(0, interval.count());
+        d->deliveryLimitsChanged(this);
+    }
+}
+
+std::chrono::milliseconds KDirWatch::debounceInterval() const
+{
+    return std::chrono::milliseconds(d ? d->m_deliveryLimits.value(const_cast<KDirWatch *>(this)).debounce : 0);
+}
+
 void KDirWatch::setCreated(const QString &_file)
 {
     qCDebug(KDIRWATCH) << objectName() << "emitting created" << _file;
@@ -1778,6 +3790,21 @@ KDirWatch::Method KDirWatch::internalMethod() const
 #endif
     case KDirWatch::Stat:
         return KDirWatch::Stat;
+    case KDirWatch::FANotify:
+#if HAVE_SYS_FANOTIFY_H
+        if (d->m_fanotify_fd >= 0) {
+            return KDirWatch::FANotify;
+        }
+#endif
+        break;
+    case KDirWatch::FSEvents:
+    case KDirWatch::ReadDirectoryChanges:
+#if HAVE_TREEWATCHER
+        if (d->m_preferredMethod == s_treeMethod && d->m_treeWatcher) {
+            return s_treeMethod;
+        }
+#endif
+        break;
     }
 
 #if HAVE_SYS_INOTIFY_H
@@ -1792,6 +3819,37 @@ KDirWatch::Method KDirWatch::internalMethod() const
 #endif
 }
 
+KDirWatch::Statistics KDirWatch::statistics() const
+{
+    if (!d) {
+        return Statistics();
+    }
+
+    Statistics statistics = d->m_statistics;
+#if HAVE_SYS_INOTIFY_H
+    statistics.inotifyWatches = int(d->m_inotify_wd_to_entry.size());
+#endif
+#if HAVE_QFILESYSTEMWATCHER
+    if (d->fsWatcher) {
+        statistics.qfsWatches = int(d->fsWatcher->files().size() + d->fsWatcher->directories().size());
+    }
+#endif
+    statistics.statWatches = d->statEntries;
+#if HAVE_SYS_FANOTIFY_H
+    for (const KDirWatchPrivate::FANotifyFilesystem &fs : std::as_const(d->m_fanotifyFilesystems)) {
+        statistics.fanotifyWatches += fs.entries;
+    }
+    statistics.fanotifyMarks = int(d->m_fanotifyFilesystems.size());
+#endif
+#if HAVE_TREEWATCHER
+    for (int entries : std::as_const(d->m_trees)) {
+        statistics.treeWatches += entries;
+    }
+    statistics.trees = int(d->m_trees.size());
+#endif
+    return statistics;
+}
+
 bool KDirWatch::event(QEvent *event)
 {
     if (Q_LIKELY(event->type() != QEvent::ThreadChange)) {
@@ -1822,6 +3880,26 @@ bool KDirWatch::event(QEvent *event)
     return QObject::event(event);
 }
 
+KMemoryFootprint::Subsystem KMemoryFootprintPrivate::dirWatch()
+{
+    KMemoryFootprint::Subsystem subsystem{QStringLiteral("KDirWatch"), 0, 0, false};
+    const KDirWatchPrivate *dwp = dwp_self.hasLocalData() ? dwp_self.localData() : nullptr;
+    if (!dwp) {
+        return subsystem;
+    }
+    subsystem.objects = qsizetype(dwp->m_mapEntries.size());
+    for (const auto &[path, entry] : dwp->m_mapEntries) {
+        // The path is shared by the key and the entry
+        subsystem.bytes += qint64(sizeof(path) + sizeof(entry)) + KMemoryFootprintPrivate::stringBytes(path);
+        subsystem.bytes += entry.m_entries.size() * qint64(sizeof(QString) + sizeof(KDirWatchPrivate::Entry *));
+        // Only more than one client is allocated, see ClientList
+        if (entry.m_clients.capacity() > 1) {
+            subsystem.bytes += entry.m_clients.capacity() * qint64(sizeof(KDirWatchPrivate::Client));
+        }
+    }
+    return subsystem;
+}
+
 #include "moc_kdirwatch.cpp"
 #include "moc_kdirwatch_p.cpp"
 
@@ -11,9 +11,12 @@
 #include <QDateTime>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 
 #include <kcoreaddons_export.h>
 
+#include <chrono>
+
 class KDirWatchPrivate;
 
 /**
@@ -47,7 +50,40 @@ class KDirWatchPrivate;
  * DirWatch/PollInterval and DirWatch/NFSPollInterval for NFS mounted
  * directories.
  * The choice of implementation can be adjusted by the user, with the key
- * [DirWatch] PreferredMethod={Stat|QFSWatch|inotify}
+ * [DirWatch] PreferredMethod={Stat|QFSWatch|inotify|FANotify|FSEvents|ReadDirectoryChanges}
+ *
+ * The FANotify method, for watching large trees like whole home directories,
+ * takes a single fanotify mark per filesystem instead of a watch per directory.
+ * It needs the CAP_SYS_ADMIN capability, without it the paths are watched with
+ * inotify.
+ *
+ * On macOS and Windows the FSEvents and ReadDirectoryChanges methods can be
+ * chosen instead of the default QFSWatch by setting the environment variable
+ * KDIRWATCH_METHOD. They watch a whole directory tree with a single FSEvents
+ * stream or directory handle, instead of one per watched file or directory
+ * like QFSWatch does.
+ *
+ * Signals are delivered in batches, repeated identical notifications of the
+ * same path being merged into one. By default a batch is delivered as soon as
+ * control returns to the event loop; setting the environment variable
+ * KDIRWATCH_COALESCEINTERVAL to a number of milliseconds waits that long for
+ * more notifications to merge instead, see pathsChanged().
+ *
+ * Setting the environment variable KDIRWATCH_MAXINOTIFYWATCHES limits the
+ * number of inotify watches used, the other paths falling back to the next
+ * method. Then, as well as when running out of inotify watches system-wide,
+ * the watches are periodically moved to the paths that changed most recently.
+ * See statistics() for how many paths use which method.
+ *
+ * The inotify events are read by the event loop of the watching thread. If
+ * that is busy for a long time, the kernel may drop events, as counted by
+ * Statistics::queueOverflows. Setting the environment variable
+ * KDIRWATCH_INOTIFYTHREAD to 1 reads them in a thread of its own instead,
+ * which queues them for the watching thread.
+ *
+ * After the kernel dropped events, all paths are checked again, the ones that
+ * changed most recently first, spread over several event loop iterations. The
+ * changes found are then reported together.
  *
  * @see self()
  * @author Sven Radej (in 1998)
@@ -65,12 +101,30 @@ public:
         WatchDirOnly = 0, ///< Watch just the specified directory
         WatchFiles = 0x01, ///< Watch also all files contained by the directory
         WatchSubDirs = 0x02, ///< Watch also all the subdirs contained by the directory
+        WatchSubDirsInBackground = 0x04, ///< Like WatchSubDirs, but register the subdirs in the background, see addDir(). @since 6.0
+        WatchContentChanges = 0x08, ///< Only report changes of a file that changed its contents, see addFile(). @since 6.0
     };
     /**
      * Stores a combination of #WatchMode values.
      */
     Q_DECLARE_FLAGS(WatchModes, WatchMode)
 
+    /**
+     * Which files and subdirectories of a directory to report, see addDir().
+     *
+     * The patterns are wildcards matched against the names of the files and subdirectories,
+     * where @c * matches any number of characters and @c ? a single character,
+     * e.g. @c *.swp, @c *~ or @c build.
+     *
+     * @since 6.0
+     */
+    struct NameFilter {
+        /// If not empty, only files with a name matching one of these are reported, subdirectories are not affected
+        QStringList includePatterns;
+        /// Files and subdirectories with a name matching one of these are not reported, nor watched with WatchSubDirs
+        QStringList excludePatterns;
+    };
+
     /**
      * Constructor.
      *
@@ -101,6 +155,12 @@ public:
      * If the @p path points to a symlink to a directory, the target directory
      * is watched instead. If you want to watch the link, use @p addFile().
      *
+     * Registering every subdir of a large tree takes a while, when @p watchModes
+     * includes WatchSubDirsInBackground this function returns right after
+     * registering @p path itself instead, and the subdirs are registered a
+     * few at a time from the event loop. Until then, changes in them are not
+     * noticed and contains() returns false for them.
+     *
      * @param path the path to watch
      * @param watchModes watch modes
      *
@@ -108,6 +168,34 @@ public:
      */
     void addDir(const QString &path, WatchModes watchModes = WatchDirOnly);
 
+    /**
+     * Adds a directory to be watched, like addDir(const QString &, WatchModes), reporting
+     * only the files and subdirectories passing @p filter. With WatchSubDirs, the subdirectories
+     * are watched with the same filter, and excluded subdirectories are not watched at all.
+     *
+     * With inotify, the names are matched before the events are even decoded, so that excluding
+     * e.g. swap files or build directories saves waking up the application for changes no one is
+     * interested in. The changes of the directory itself are still reported, except for those
+     * only caused by names filtered out for all of its watchers.
+     *
+     * @param path the path to watch
+     * @param watchModes watch modes
+     * @param filter the names to report
+     * @since 6.0
+     */
+    void addDir(const QString &path, WatchModes watchModes, const NameFilter &filter);
+
+    /**
+     * Adds several directories to be watched, like calling addDir() for each of @p paths,
+     * but faster for many paths: they are checked several at a time, and the watches are
+     * registered in one go.
+     *
+     * @param paths the paths to watch, duplicates are ignored
+     * @param watchModes watch modes, see addDir()
+     * @since 6.0
+     */
+    void addDirs(const QStringList &paths, WatchModes watchModes = WatchDirOnly);
+
     /**
      * Adds a file to be watched.
      * If it's a symlink to a directory, it watches the symlink itself.
@@ -115,6 +203,32 @@ public:
      */
     void addFile(const QString &file);
 
+    /**
+     * Adds a file to be watched, like addFile(const QString &).
+     *
+     * On network and FUSE filesystems the timestamps KDirWatch checks change
+     * without the file changing, and the other way around. With @p watchModes
+     * set to WatchContentChanges, dirty() is only emitted for @p file when a
+     * fingerprint of its contents changed: its size and a hash of its first
+     * and last few KiB, which is cheap to compute even for large files but
+     * does not notice changes elsewhere in a file of the same size.
+     *
+     * @param file the file to watch
+     * @param watchModes WatchDirOnly or WatchContentChanges
+     * @since 6.0
+     */
+    void addFile(const QString &file, WatchModes watchModes);
+
+    /**
+     * Adds several files to be watched, like calling addFile() for each of @p files,
+     * but faster for many files, see addDirs().
+     *
+     * @param files the files to watch, duplicates are ignored
+     * @param watchModes WatchDirOnly or WatchContentChanges, see addFile()
+     * @since 6.0
+     */
+    void addFiles(const QStringList &files, WatchModes watchModes = WatchDirOnly);
+
     /**
      * Returns the time the directory/file was last changed.
      * @param path the file to check
@@ -206,10 +320,90 @@ public:
      */
     bool contains(const QString &path) const;
 
+    /**
+     * Saves the paths watched by this instance to @p fileName, together with their
+     * last observed state, for restoreState().
+     *
+     * This allows a long-running service to add its watches again after a restart
+     * without stat()ing every path first, and without missing the changes made in the meantime.
+     *
+     * @param fileName the file to write the state to
+     * @return whether the state was written
+     * @since 6.0
+     */
+    bool saveState(const QString &fileName) const;
+
+    /**
+     * Adds the watches saved by saveState() to @p fileName, with their watch modes and name
+     * filters. It replaces adding them with addDir() and addFile(), as calling both adds the
+     * watches twice.
+     *
+     * The paths are checked in the background and watched once checked, after which stateRestored()
+     * is emitted with the ones changed since the state was saved. The contents of directories watched
+     * with WatchSubDirs are not listed again, except for the changed directories, so that
+     * new subdirectories are watched as well.
+     *
+     * @param fileName the file to read the state from
+     * @return whether the state was read, otherwise nothing is watched
+     * @since 6.0
+     */
+    bool restoreState(const QString &fileName);
+
+    /**
+     * Limits how often this instance emits its signals, for clients that reload
+     * something expensive on every change, e.g. while a file is being written.
+     *
+     * The first changes after a quiet period are reported right away. The ones
+     * following within @p interval are collected, and reported together once
+     * @p interval passed since the previous batch of signals. As usual, the
+     * repeated identical changes of a path are reported once.
+     *
+     * This only affects this instance, not the others watching the same paths.
+     *
+     * @param interval the minimum time between two batches of signals, 0 for no limit, the default
+     * @see setDebounceInterval()
+     * @since 6.0
+     */
+    void setDeliveryInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @return the minimum time between two batches of signals of this instance
+     * @see setDeliveryInterval()
+     * @since 6.0
+     */
+    std::chrono::milliseconds deliveryInterval() const;
+
+    /**
+     * Holds the signals of this instance back until no changes were reported
+     * for @p interval, so that a burst of changes results in a single batch
+     * of signals after it ended.
+     *
+     * If a delivery interval is set as well, changes are held back for at most
+     * that long, so that a file written to all the time is still reported
+     * every setDeliveryInterval().
+     *
+     * This only affects this instance, not the others watching the same paths.
+     *
+     * @param interval how long no changes must be reported before the signals
+     *   are emitted, 0 to emit them right away, the default
+     * @since 6.0
+     */
+    void setDebounceInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @return how long no changes must be reported before this instance emits its signals
+     * @see setDebounceInterval()
+     * @since 6.0
+     */
+    std::chrono::milliseconds debounceInterval() const;
+
     enum Method {
         INotify,
         Stat,
         QFSWatch,
+        FANotify, ///< @since 6.0
+        FSEvents, ///< macOS only. @since 6.0
+        ReadDirectoryChanges, ///< Windows only. @since 6.0
     };
     /**
      * Returns the preferred internal method to
@@ -217,6 +411,36 @@ public:
      */
     Method internalMethod() const;
 
+    /**
+     * Counters for diagnosing the watching, e.g. when running out of inotify
+     * watches makes KDirWatch fall back to polling.
+     *
+     * All the KDirWatch instances of a thread share their watches, so the
+     * numbers cover all of them, counting from when the first one was created.
+     *
+     * @since 6.0
+     */
+    struct Statistics {
+        int inotifyWatches = 0; ///< Paths currently watched with INotify
+        int qfsWatches = 0; ///< Paths currently watched with QFSWatch
+        int statWatches = 0; ///< Paths currently polled with Stat
+        int fanotifyWatches = 0; ///< Paths currently watched with FANotify
+        int fanotifyMarks = 0; ///< Filesystems currently marked for FANotify
+        int treeWatches = 0; ///< Paths currently watched with FSEvents or ReadDirectoryChanges
+        int trees = 0; ///< Directory trees currently watched with FSEvents or ReadDirectoryChanges
+        quint64 eventsReceived = 0; ///< Changes reported by the watching methods
+        quint64 eventsCoalesced = 0; ///< Changes merged into an identical earlier one
+        quint64 eventsFiltered = 0; ///< Changes dropped by the NameFilter of every watcher
+        quint64 queueOverflows = 0; ///< Times the inotify event queue overflowed, losing changes
+        quint64 fallbacks = 0; ///< Times a path could not be watched with the preferred method
+    };
+
+    /**
+     * @return The usage statistics of the watching in the calling thread.
+     * @since 6.0
+     */
+    Statistics statistics() const;
+
     /**
      * The KDirWatch instance usually globally used in an application.
      * It is automatically deleted when the application exits.
@@ -294,6 +518,40 @@ Q_SIGNALS:
      */
     void deleted(const QString &path);
 
+    /**
+     * Emitted when a file or directory in a watched directory is renamed, or moved to another
+     * directory watched by this instance, instead of deleted() for @p oldPath and created() for
+     * @p newPath. Directories watched with KDirWatch::WatchSubDirs stay watched at their new path.
+     *
+     * This is only emitted by the KDirWatch::INotify method, which reports both paths at once.
+     * As before, dirty() is emitted for the directories containing the paths.
+     *
+     * @param oldPath the previous path of the file or directory
+     * @param newPath the new path of the file or directory
+     * @since 6.0
+     */
+    void renamed(const QString &oldPath, const QString &newPath);
+
+    /**
+     * Emitted after every batch of dirty(), created(), deleted() and renamed() signals,
+     * useful for applications that would rather handle many changes at once.
+     *
+     * @param paths the paths of all the signals of the batch, each listed once
+     * @since 6.0
+     */
+    void pathsChanged(const QStringList &paths);
+
+    /**
+     * Emitted once the paths read by restoreState() were checked and are watched again.
+     *
+     * No dirty(), created() or deleted() signals are emitted for the changes made while
+     * the state was saved, they are only listed here.
+     *
+     * @param changedPaths the restored paths which were changed, created or deleted since the state was saved
+     * @since 6.0
+     */
+    void stateRestored(const QStringList &changedPaths);
+
 private:
     KDirWatchPrivate *d;
     friend class KDirWatchPrivate;
@@ -26,15 +26,29 @@
 #define HAVE_QFILESYSTEMWATCHER 0
 #endif
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QList>
-#include <QMap>
+#include <QMutex>
 #include <QObject>
+#include <QPair>
+#include <QPointer>
 #include <QSet>
 #include <QString>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
+#include <QVarLengthArray>
 class QSocketNotifier;
 
 #include <ctime>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
 #include <sys/types.h> // time_t, ino_t
 
 #define invalid_ctime (static_cast<time_t>(-1))
@@ -43,8 +57,41 @@ class QSocketNotifier;
 #include <QFileSystemWatcher>
 #endif // HAVE_QFILESYSTEMWATCHER
 
+#define HAVE_TREEWATCHER (HAVE_FSEVENTS || HAVE_READDIRECTORYCHANGESW)
+#if HAVE_TREEWATCHER
+#include "kdirwatch_treewatcher_p.h"
+#endif
+
 #if HAVE_SYS_INOTIFY_H
 struct inotify_event;
+
+class KDirWatchPrivate;
+
+/* Reads the inotify events in a thread of its own when the environment
+ * variable KDIRWATCH_INOTIFYTHREAD is set, so that the kernel queue doesn't
+ * overflow while the watching thread is busy. The events are handed to the
+ * watching thread, which still resolves and reports them.
+ */
+class KDirWatchInotifyReader : public QThread
+{
+public:
+    KDirWatchInotifyReader(int inotifyFd, KDirWatchPrivate *watcher);
+    ~KDirWatchInotifyReader() override;
+
+    // Returns the events read since the last call
+    QByteArray takeEvents();
+
+protected:
+    void run() override;
+
+private:
+    const int m_inotifyFd;
+    KDirWatchPrivate *const m_watcher;
+    int m_wakeupFds[2];
+    QMutex m_mutex;
+    QByteArray m_events;
+    bool m_overflowed = false;
+};
 #endif
 
 /* KDirWatchPrivate is a singleton and does the watching
@@ -54,33 +101,69 @@ class KDirWatchPrivate : public QObject
 {
     Q_OBJECT
 public:
-    enum entryStatus {
+    // Small, as they are part of every Entry
+    enum entryStatus : quint8 {
         Normal = 0,
         NonExistent,
     };
-    enum entryMode {
+    enum entryMode : quint8 {
         UnknownMode = 0,
         StatMode,
         INotifyMode,
         QFSWatchMode,
+        FANotifyMode,
+        // FSEvents or ReadDirectoryChanges, see useTreeWatcher()
+        TreeMode,
     };
     enum {
         NoChange = 0,
         Changed = 1,
         Created = 2,
         Deleted = 4,
+        // Only queued on its own, with the new path in PendingEvent::newPath
+        Renamed = 8,
     };
 
+    // A KDirWatch::NameFilter prepared for matching the raw names of inotify
+    // events too, shared by all entries added with it
+    class NameMatcher
+    {
+    public:
+        explicit NameMatcher(const KDirWatch::NameFilter &filter);
+        bool accepts(QStringView name, bool isDir) const;
+        bool accepts(QByteArrayView name, bool isDir) const;
+        KDirWatch::NameFilter nameFilter() const
+        {
+            return {m_includes, m_excludes};
+        }
+
+    private:
+        QStringList m_includes;
+        QStringList m_excludes;
+        // in the encoding of QFile::encodeName()
+        QList<QByteArray> m_encodedIncludes;
+        QList<QByteArray> m_encodedExcludes;
+    };
+    typedef std::shared_ptr<const NameMatcher> NameMatcherPtr;
+
     struct Client {
-        Client(KDirWatch *inst, KDirWatch::WatchModes watchModes)
+        Client(KDirWatch *inst, KDirWatch::WatchModes watchModes, const NameMatcherPtr &nameMatcher)
             : instance(inst)
             , count(1)
             , watchingStopped(inst->isStopped())
             , pending(NoChange)
             , m_watchModes(watchModes)
+            , m_nameMatcher(nameMatcher)
         {
         }
 
+        // whether the events of the file or subdirectory @p name are reported to this client
+        template<typename Name>
+        bool accepts(Name name, bool isDir) const
+        {
+            return !m_nameMatcher || m_nameMatcher->accepts(name, isDir);
+        }
+
         // The compiler needs a copy ctor for Client when Entry is inserted into m_mapEntries
         // (even though the vector of clients is empty at that point, so no performance penalty there)
         // Client(const Client &) = delete;
@@ -93,48 +176,87 @@ public:
         // did the instance stop watching
         bool watchingStopped;
         // events blocked when stopped
-        int pending;
+        quint8 pending;
         KDirWatch::WatchModes m_watchModes;
+        // null if all names are reported
+        NameMatcherPtr m_nameMatcher;
     };
 
+    // Almost all entries have one client, which this stores without
+    // allocating memory
+    typedef QVarLengthArray<Client, 1> ClientList;
+
     class Entry
     {
     public:
         ~Entry();
         // instances interested in events
-        std::vector<Client> m_clients;
-        // nonexistent entries of this directory
-        QList<Entry *> m_entries;
+        ClientList m_clients;
+        // the entries of this directory depending on its watch, by file name: the
+        // nonexistent ones, and with inotify also the files sharing its watch
+        QHash<QString, Entry *> m_entries;
+        // shares its data with the key in m_mapEntries
         QString path;
+        // path for the system calls, empty until needed, see encodedPath()
+        QByteArray m_encodedPath;
 
         // the last observed modification time
         time_t m_ctime;
         // last observed inode
         ino_t m_ino;
+        // when to scan the entry next in StatMode, see scheduleScan()
+        qint64 m_nextScan;
+        // for KDirWatch::WatchContentChanges, see contentFingerprint()
+        quint64 m_fingerprint;
         // the last observed link count
         int m_nlink;
+        int freq;
+        // the number of changes, halved by every slotRebalanceWatches()
+        quint32 m_activity;
         entryStatus m_status;
         entryMode m_mode;
-        int msecLeft, freq;
+        // whether a StatMode scan is running on m_statPool
+        bool m_scanInProgress;
+        // whether the entry fell back from INotifyMode for lack of watches
+        bool m_waitingForINotify;
+        // whether it is polled on a network filesystem, see scanSyncs()
+        bool m_onNetworkFs;
+        // the StatMode scans since the last one asking the server, see scanSyncs()
+        quint8 m_unsyncedScans;
         bool isDir;
 
         QString parentDirectory() const;
-        void addClient(KDirWatch *, KDirWatch::WatchModes);
+        const QByteArray &encodedPath();
+        bool scanSyncs();
+        void addClient(KDirWatch *, KDirWatch::WatchModes, const NameMatcherPtr &);
         void removeClient(KDirWatch *);
         int clientCount() const;
+        bool watchesContent() const;
         bool isValid()
         {
             return !m_clients.empty() || !m_entries.empty();
         }
 
-        Entry *findSubEntry(const QString &path) const
+        // the key of @p path in m_entries of its directory
+        static QString subEntryName(const QString &path)
+        {
+            return path.mid(path.lastIndexOf(QLatin1Char('/')) + 1);
+        }
+        void addSubEntry(Entry *sub_entry)
         {
-            for (Entry *sub_entry : std::as_const(m_entries)) {
-                if (sub_entry->path == path) {
-                    return sub_entry;
-                }
+            m_entries.insert(subEntryName(sub_entry->path), sub_entry);
+        }
+        void removeSubEntry(Entry *sub_entry)
+        {
+            const auto it = m_entries.constFind(subEntryName(sub_entry->path));
+            if (it != m_entries.cend() && it.value() == sub_entry) {
+                m_entries.erase(it);
             }
-            return nullptr;
+        }
+        Entry *findSubEntry(const QString &path) const
+        {
+            Entry *sub_entry = m_entries.value(subEntryName(path));
+            return sub_entry && sub_entry->path == path ? sub_entry : nullptr;
         }
 
         bool dirty;
@@ -143,7 +265,7 @@ public:
         QList<const Client *> clientsForFileOrDir(const QString &tpath, bool *isDir) const;
         QList<const Client *> inotifyClientsForFileOrDir(bool isDir) const;
 
-        std::vector<Client>::iterator findInstance(KDirWatch *other)
+        ClientList::iterator findInstance(KDirWatch *other)
         {
             return std::find_if(m_clients.begin(), m_clients.end(), [other](const Client &client) {
                 return client.instance == other;
@@ -151,6 +273,12 @@ public:
         }
 
 #if HAVE_SYS_INOTIFY_H
+        // whether this file is watched with the watch of its directory, see useINotify()
+        bool sharesParentWatch() const
+        {
+            return m_mode == INotifyMode && wd == -1 && m_status == Normal && !isDir;
+        }
+
         int wd;
         // Creation and Deletion of files happens infrequently, so
         // can safely be reported as they occur.  File changes i.e. those that emit "dirty()" can
@@ -159,16 +287,87 @@ public:
         // This will be unused if the Entry is not a directory.
         QList<QString> m_pendingFileChanges;
 #endif
+#if HAVE_SYS_FANOTIFY_H
+        // the key of the directory watched for this entry in m_fanotifyDirectories,
+        // itself or its parent, empty if none, see useFANotify()
+        QByteArray m_fanotifyHandle;
+#endif
+#if HAVE_TREEWATCHER
+        // the watched tree in m_trees this entry is part of, empty if none
+        QString m_tree;
+#endif
+    };
+
+    // Entries must stay in place when others are added or removed, since
+    // they are referenced by pointer, which rules out QHash.
+    typedef std::unordered_map<QString, Entry> EntryMap;
+
+    // The outcome of stat()ing an entry, see scanEntry()
+    struct StatResult {
+        bool exists = false;
+        time_t ctime = 0;
+        time_t mtime = 0;
+        ino_t ino = 0;
+        int nlink = 0;
+        bool isDir = false;
     };
 
-    typedef QMap<QString, Entry> EntryMap;
+    // An event emitEvent() queued for delivery by slotEmitPending()
+    struct PendingEvent {
+        QString path;
+        int event;
+        QString newPath;
+    };
+
+    // A path watched by an instance, as written by KDirWatch::saveState()
+    struct SavedEntry {
+        QString path;
+        KDirWatch::WatchModes watchModes;
+        int count = 1;
+        // index in the saved name filters, or -1
+        int nameFilter = -1;
+        bool isDir = false;
+        bool exists = false;
+        qint64 ctime = 0;
+        quint64 ino = 0;
+        int nlink = 0;
+    };
+
+    // The events queued for one KDirWatch instance, of which only the first of
+    // a run of identical events of the same path is kept.
+    struct PendingEvents {
+        QPointer<KDirWatch> instance;
+        std::vector<PendingEvent> events;
+        // index in events of the last event of every path
+        QHash<QString, qsizetype> lastEvent;
+        // when the first and the last event were queued, in ms of m_scanClock
+        qint64 firstQueued = 0;
+        qint64 lastQueued = 0;
+    };
+
+    // The limits of an instance set by KDirWatch::setDeliveryInterval()
+    // and KDirWatch::setDebounceInterval(), in ms
+    struct DeliveryLimits {
+        qint64 interval = 0;
+        qint64 debounce = 0;
+        // when the instance was last delivered events, in ms of m_scanClock, -1 if never
+        qint64 lastDelivery = -1;
+    };
 
     KDirWatchPrivate();
     ~KDirWatchPrivate() override;
 
     void resetList(KDirWatch *instance, bool skippedToo);
     void useFreq(Entry *e, int newFreq);
-    void addEntry(KDirWatch *instance, const QString &_path, Entry *sub_entry, bool isDir, KDirWatch::WatchModes watchModes = KDirWatch::WatchDirOnly);
+    Entry *insertEntry(const QString &path, bool isDir, const StatResult &stat_buf);
+    void addEntry(KDirWatch *instance,
+                  const QString &_path,
+                  Entry *sub_entry,
+                  bool isDir,
+                  KDirWatch::WatchModes watchModes = KDirWatch::WatchDirOnly,
+                  const NameMatcherPtr &nameMatcher = NameMatcherPtr(),
+                  const StatResult *knownStat = nullptr);
+    void addEntries(KDirWatch *instance, const QStringList &paths, bool isDir, KDirWatch::WatchModes watchModes, const NameMatcherPtr &nameMatcher);
     void removeEntry(KDirWatch *instance, const QString &path, Entry *sub_entry);
     void removeEntry(KDirWatch *instance, Entry *e, Entry *sub_entry);
     bool stopEntryScan(KDirWatch *instance, Entry *e);
@@ -180,9 +379,25 @@ public:
 
     void addWatch(Entry *entry);
     void removeWatch(Entry *entry);
+    void releaseWatch(Entry *entry);
     Entry *entry(const QString &_path);
     int scanEntry(Entry *e);
-    void emitEvent(Entry *e, int event, const QString &fileName = QString());
+    void rescanEntries(const std::vector<Entry *> &entries);
+    static StatResult statEntry(const QString &path);
+    static StatResult statEntry(const QByteArray &encodedPath, bool sync = true);
+    static StatResult statNewEntry(const QString &path, bool isDir);
+    int applyStatResult(Entry *e, const StatResult &result);
+    void statResultsReceived(const QList<QPair<QString, StatResult>> &results);
+    void scheduleScan(Entry *e, qint64 due);
+    void emitEvent(Entry *e, int event, const QString &fileName = QString(), bool isDir = false);
+    static quint64 contentFingerprint(const Entry *e);
+    void dropPendingRegistrations(KDirWatch *instance, const QString &path);
+    void queueEvent(KDirWatch *instance, int event, const QString &path, const QString &newPath = QString());
+    qint64 deliveryDue(KDirWatch *instance, const PendingEvents &pending) const;
+    void deliveryLimitsChanged(KDirWatch *instance);
+    bool saveState(KDirWatch *instance, const QString &fileName) const;
+    bool restoreState(KDirWatch *instance, const QString &fileName);
+    void restoreEntries(KDirWatch *instance, const std::vector<SavedEntry> &entries, const QList<NameMatcherPtr> &nameMatchers, const QList<StatResult> &results);
 
     static bool isNoisyFile(const char *filename);
 
@@ -195,8 +410,14 @@ public:
 
 public Q_SLOTS:
     void slotRescan();
+    void slotStatRescan();
     void inotifyEventReceived(); // for inotify
+    void fanotifyEventReceived(); // for fanotify
     void slotRemoveDelayed();
+    void slotEmitPending();
+    void slotRegisterPending();
+    void slotRebalanceWatches();
+    void slotRecoverOverflow();
     void fswEventReceived(const QString &path); // for QFileSystemWatcher
 
 public:
@@ -209,6 +430,24 @@ public:
     int m_nfsPollInterval, m_PollInterval;
     bool useStat(Entry *e);
 
+    // The number of StatMode entries using each polling frequency, to find
+    // the lowest one quickly
+    std::map<int, int> m_statFrequencies;
+
+    // The entries every instance is a client of, so that removeEntries()
+    // doesn't have to look at all of them
+    QHash<KDirWatch *, QSet<Entry *>> m_instanceEntries;
+
+    // The StatMode entries by the time they are due to be scanned next, in
+    // ms of m_scanClock. Entries are not removed when rescheduled, so an
+    // element is only current if it matches Entry::m_nextScan.
+    QElapsedTimer m_scanClock;
+    std::priority_queue<std::pair<qint64, QString>, std::vector<std::pair<qint64, QString>>, std::greater<>> m_scanQueue;
+
+    // Runs the stat() calls of slotStatRescan(), which may block for a long
+    // time on network mounts
+    QThreadPool m_statPool;
+
     // removeList is allowed to contain any entry at most once
     QSet<Entry *> removeList;
     bool delayRemove;
@@ -216,16 +455,117 @@ public:
     bool rescan_all;
     QTimer rescan_timer;
 
+    // Events are delivered to the instances in batches, at most every
+    // m_coalesceInterval ms, see queueEvent()
+    int m_coalesceInterval;
+    QTimer m_emitTimer;
+    QHash<KDirWatch *, PendingEvents> m_pendingEvents;
+
+    // The instances limiting how often they are delivered events, whose events
+    // slotEmitPending() holds back until m_deliveryTimer fires
+    QHash<KDirWatch *, DeliveryLimits> m_deliveryLimits;
+    QTimer m_deliveryTimer;
+
+    // A file or dir that addEntry() left for slotRegisterPending() to add, see
+    // KDirWatch::WatchSubDirsInBackground
+    struct PendingRegistration {
+        QPointer<KDirWatch> instance;
+        QString path;
+        bool isDir;
+        KDirWatch::WatchModes watchModes;
+        NameMatcherPtr nameMatcher;
+    };
+    std::deque<PendingRegistration> m_pendingRegistrations;
+    QTimer m_registrationTimer;
+
+    // The paths KDirWatch::restoreState() is checking in the background, see restoreEntries()
+    struct PendingRestore {
+        int batches = 0;
+        QStringList changedPaths;
+    };
+    QHash<KDirWatch *, PendingRestore> m_pendingRestores;
+
+    // The watch counts are filled in by KDirWatch::statistics()
+    KDirWatch::Statistics m_statistics;
+
+    // At most this many inotify watches are used if > 0, see
+    // slotRebalanceWatches() for how they are distributed
+    int m_inotifyBudget;
+    QTimer m_rebalanceTimer;
+
+    // The paths of the entries slotRecoverOverflow() has yet to scan after
+    // the kernel dropped events, most active first, see recoverFromOverflow()
+    std::deque<QString> m_overflowRecovery;
+    QTimer m_overflowRecoveryTimer;
+    // The events found by slotRecoverOverflow(), queued by queueEvent() while
+    // m_queueRecoveredEvents is set and delivered once the last batch is done
+    QHash<KDirWatch *, PendingEvents> m_recoveredEvents;
+    bool m_queueRecoveredEvents = false;
+    void recoverFromOverflow();
+
 #if HAVE_SYS_INOTIFY_H
     QSocketNotifier *mSn;
     bool supports_inotify;
     int m_inotify_fd;
     QHash<int, Entry *> m_inotify_wd_to_entry;
+    // Reads the events instead of mSn, see KDirWatchInotifyReader
+    std::unique_ptr<KDirWatchInotifyReader> m_inotifyReader;
+
+    static QByteArray readInotifyEvents(int fd);
+    void processInotifyEvents(const QByteArray &events);
 
     bool useINotify(Entry *e);
+    bool useParentINotify(Entry *e);
+    void waitForINotify(Entry *e);
+
+    // The IN_MOVED_FROM half of a rename, waiting for the IN_MOVED_TO with the same cookie
+    struct PendingMove {
+        uint32_t cookie;
+        int wd;
+        QString path;
+        bool isDir;
+    };
+    void inotifyRenamed(const PendingMove &move, Entry *to, const QString &newPath, bool isDir);
+    void childCreated(Entry *e, const QString &tpath, const QString &name, bool isDir);
+    bool moveEntries(const QString &oldPath, const QString &newPath, const Entry *to);
+#endif
+#if HAVE_SYS_FANOTIFY_H
+    QSocketNotifier *mFanotifySn;
+    int m_fanotify_fd;
+
+    // A filesystem marked for fanotify, by its fsid
+    struct FANotifyFilesystem {
+        // a directory on it, for removing the mark
+        QByteArray path;
+        int entries;
+    };
+    QHash<QByteArray, FANotifyFilesystem> m_fanotifyFilesystems;
+    // A directory the events are reported for, by its fsid and file handle,
+    // so that events are dispatched without resolving the handles
+    struct FANotifyDirectory {
+        QString path;
+        int entries;
+    };
+    QHash<QByteArray, FANotifyDirectory> m_fanotifyDirectories;
+
+    bool useFANotify(Entry *e);
+    void releaseFANotify(Entry *e);
+    void fanotifyEvent(const QString &dirPath, const QByteArray &name, quint64 mask);
+#endif
+#if HAVE_TREEWATCHER
+    std::unique_ptr<KDirWatchTreeWatcher> m_treeWatcher;
+    // The directories watched by m_treeWatcher, with the number of entries
+    // watched with each
+    QHash<QString, int> m_trees;
+
+    bool useTreeWatcher(Entry *e);
+    void releaseTree(Entry *e);
+    void treePathChanged(const QString &path);
 #endif
 #if HAVE_QFILESYSTEMWATCHER
     QFileSystemWatcher *fsWatcher;
+    // Collects the paths for QFileSystemWatcher::addPaths() during addEntries()
+    QStringList *m_pendingFswPaths = nullptr;
     bool useQFSWatch(Entry *e);
 #endif
 
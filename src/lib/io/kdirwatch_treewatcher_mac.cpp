@@ -0,0 +1,205 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include "kdirwatch_treewatcher_p.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMetaObject>
+#include <QStringList>
+
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+
+// How long FSEvents collects the changes of a tree before reporting them, in seconds
+static const CFTimeInterval s_latency = 0.05;
+
+class KDirWatchTreeWatcher::Private
+{
+public:
+    struct Tree {
+        // The path FSEvents reports the changes below, with symlinks resolved
+        QString canonicalPath;
+        FSEventStreamRef stream;
+    };
+
+    static void streamCallback(ConstFSEventStreamRef stream,
+                               void *info,
+                               size_t numEvents,
+                               void *eventPaths,
+                               const FSEventStreamEventFlags eventFlags[],
+                               const FSEventStreamEventId eventIds[]);
+    void report(const QStringList &changed, const QStringList &lost);
+    QString requestedPath(const QString &canonicalPath) const;
+    static void releaseStream(FSEventStreamRef stream);
+
+    KDirWatchTreeWatcher *q = nullptr;
+    PathChanged pathChanged;
+    ChangesLost changesLost;
+    // The callbacks of all streams run on this serial queue
+    dispatch_queue_t queue = nullptr;
+    // By the path the tree was added with
+    QHash<QString, Tree> trees;
+};
+
+// Runs on the dispatch queue, the paths are mapped back in the watching thread
+void KDirWatchTreeWatcher::Private::streamCallback(ConstFSEventStreamRef,
+                                                   void *info,
+                                                   size_t numEvents,
+                                                   void *eventPaths,
+                                                   const FSEventStreamEventFlags eventFlags[],
+                                                   const FSEventStreamEventId[])
+{
+    auto *d = static_cast<Private *>(info);
+    const auto *paths = static_cast<const char *const *>(eventPaths);
+
+    QStringList changed;
+    QStringList lost;
+    for (size_t i = 0; i < numEvents; ++i) {
+        QString path = QFile::decodeName(paths[i]);
+        if (path.length() > 1 && path.endsWith(QLatin1Char('/'))) {
+            path.chop(1);
+        }
+        if (eventFlags[i] & (kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagKernelDropped | kFSEventStreamEventFlagUserDropped)) {
+            lost.append(path);
+        } else {
+            changed.append(path);
+        }
+    }
+
+    QMetaObject::invokeMethod(
+        d->q,
+        [d, changed, lost]() {
+            d->report(changed, lost);
+        },
+        Qt::QueuedConnection);
+}
+
+void KDirWatchTreeWatcher::Private::report(const QStringList &changed, const QStringList &lost)
+{
+    // The callbacks may remove trees
+    QStringList changedPaths;
+    for (const QString &path : changed) {
+        const QString requested = requestedPath(path);
+        if (!requested.isEmpty()) {
+            changedPaths.append(requested);
+        }
+    }
+    QStringList lostPaths;
+    for (const QString &path : lost) {
+        const QString requested = requestedPath(path);
+        if (!requested.isEmpty()) {
+            lostPaths.append(requested);
+        }
+    }
+
+    for (const QString &path : std::as_const(changedPaths)) {
+        pathChanged(path);
+    }
+    for (const QString &path : std::as_const(lostPaths)) {
+        changesLost(path);
+    }
+}
+
+// Maps @p canonicalPath reported by FSEvents to the path below the tree as it was added,
+// e.g. /private/var/... for /var/..., empty if it is not in any tree
+QString KDirWatchTreeWatcher::Private::requestedPath(const QString &canonicalPath) const
+{
+    for (auto it = trees.cbegin(); it != trees.cend(); ++it) {
+        const QString &root = it->canonicalPath;
+        if (canonicalPath == root) {
+            return it.key();
+        }
+        if (canonicalPath.startsWith(root) && (root.endsWith(QLatin1Char('/')) || canonicalPath.at(root.length()) == QLatin1Char('/'))) {
+            const QString relativePath = canonicalPath.mid(root.length() + (root.endsWith(QLatin1Char('/')) ? 0 : 1));
+            return it.key().endsWith(QLatin1Char('/')) ? it.key() + relativePath : it.key() + QLatin1Char('/') + relativePath;
+        }
+    }
+    return QString();
+}
+
+void KDirWatchTreeWatcher::Private::releaseStream(FSEventStreamRef stream)
+{
+    FSEventStreamStop(stream);
+    FSEventStreamInvalidate(stream);
+    FSEventStreamRelease(stream);
+}
+
+std::unique_ptr<KDirWatchTreeWatcher> KDirWatchTreeWatcher::create(const PathChanged &pathChanged, const ChangesLost &changesLost)
+{
+    auto d = std::make_unique<Private>();
+    d->pathChanged = pathChanged;
+    d->changesLost = changesLost;
+    d->queue = dispatch_queue_create("org.kde.kdirwatch.fsevents", DISPATCH_QUEUE_SERIAL);
+    if (!d->queue) {
+        return nullptr;
+    }
+    return std::unique_ptr<KDirWatchTreeWatcher>(new KDirWatchTreeWatcher(std::move(d)));
+}
+
+KDirWatchTreeWatcher::KDirWatchTreeWatcher(std::unique_ptr<Private> dd)
+    : d(std::move(dd))
+{
+    d->q = this;
+}
+
+KDirWatchTreeWatcher::~KDirWatchTreeWatcher()
+{
+    for (const Private::Tree &tree : std::as_const(d->trees)) {
+        Private::releaseStream(tree.stream);
+    }
+    // Wait for a callback that may still be running, the ones it posted
+    // to us are discarded with us
+    dispatch_sync_f(d->queue, nullptr, [](void *) {});
+    dispatch_release(d->queue);
+}
+
+bool KDirWatchTreeWatcher::addTree(const QString &path)
+{
+    if (d->trees.contains(path)) {
+        return true;
+    }
+
+    const QString canonicalPath = QFileInfo(path).canonicalFilePath();
+    if (canonicalPath.isEmpty()) {
+        return false;
+    }
+
+    CFStringRef cfPath = canonicalPath.toCFString();
+    CFArrayRef paths = CFArrayCreate(kCFAllocatorDefault, reinterpret_cast<const void **>(&cfPath), 1, &kCFTypeArrayCallBacks);
+    CFRelease(cfPath);
+
+    FSEventStreamContext context{0, d.get(), nullptr, nullptr, nullptr};
+    // File events, so that the changes of files are reported by path
+    // and not just as a change of their directory
+    const FSEventStreamCreateFlags flags = kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagWatchRoot | kFSEventStreamCreateFlagNoDefer;
+    FSEventStreamRef stream = FSEventStreamCreate(kCFAllocatorDefault, &Private::streamCallback, &context, paths, kFSEventStreamEventIdSinceNow, s_latency, flags);
+    CFRelease(paths);
+    if (!stream) {
+        return false;
+    }
+
+    FSEventStreamSetDispatchQueue(stream, d->queue);
+    if (!FSEventStreamStart(stream)) {
+        FSEventStreamInvalidate(stream);
+        FSEventStreamRelease(stream);
+        return false;
+    }
+
+    d->trees.insert(path, {canonicalPath, stream});
+    return true;
+}
+
+void KDirWatchTreeWatcher::removeTree(const QString &path)
+{
+    const auto it = d->trees.constFind(path);
+    if (it == d->trees.cend()) {
+        return;
+    }
+    Private::releaseStream(it->stream);
+    d->trees.erase(it);
+}
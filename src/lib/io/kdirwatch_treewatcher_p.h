@@ -0,0 +1,49 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#ifndef KDIRWATCH_TREEWATCHER_P_H
+#define KDIRWATCH_TREEWATCHER_P_H
+
+#include <QObject>
+#include <QString>
+
+#include <functional>
+#include <memory>
+
+/* Watches whole directory trees with a single handle of the system each: an
+ * FSEvents stream on macOS, a directory handle read with ReadDirectoryChangesW()
+ * and bWatchSubtree on Windows. The system reports the paths that changed
+ * anywhere below a tree, coalescing repeated changes, and KDirWatchPrivate
+ * looks them up in its entries, see KDirWatchPrivate::useTreeWatcher().
+ *
+ * The callbacks are invoked in the thread that created the watcher.
+ */
+class KDirWatchTreeWatcher : public QObject
+{
+public:
+    // The absolute path of a file or directory in a watched tree that was
+    // created, changed, removed or renamed
+    using PathChanged = std::function<void(const QString &path)>;
+    // The directory below which the changes were not all reported
+    using ChangesLost = std::function<void(const QString &path)>;
+
+    // nullptr if the system does not support watching trees
+    static std::unique_ptr<KDirWatchTreeWatcher> create(const PathChanged &pathChanged, const ChangesLost &changesLost);
+
+    ~KDirWatchTreeWatcher() override;
+
+    bool addTree(const QString &path);
+    void removeTree(const QString &path);
+
+    class Private;
+
+private:
+    explicit KDirWatchTreeWatcher(std::unique_ptr<Private> dd);
+
+    std::unique_ptr<Private> const d;
+};
+
+#endif
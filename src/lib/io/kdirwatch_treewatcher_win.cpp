@@ -0,0 +1,178 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+#include "kdirwatch_treewatcher_p.h"
+
+#include <QDir>
+#include <QHash>
+#include <QStringList>
+#include <QWinEventNotifier>
+
+#include <vector>
+
+#include <windows.h>
+
+// The changes ReadDirectoryChangesW() reports, the ones stat() would notice
+static const DWORD s_notifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE
+    | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+// The size of the buffer the changes of a tree are read into. If more changes
+// pile up before they are read, they are lost and the tree is rescanned.
+static const DWORD s_bufferSize = 64 * 1024;
+
+class KDirWatchTreeWatcher::Private
+{
+public:
+    struct Tree {
+        QString path;
+        HANDLE dir = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped = {};
+        // whether the system may write to the buffer
+        bool pending = false;
+        // DWORD aligned, as ReadDirectoryChangesW() requires
+        std::vector<DWORD> buffer = std::vector<DWORD>(s_bufferSize / sizeof(DWORD));
+        std::unique_ptr<QWinEventNotifier> notifier;
+    };
+
+    bool requestChanges(Tree *tree);
+    void readChanges(Tree *tree);
+    static void releaseTree(Tree *tree);
+
+    KDirWatchTreeWatcher *q = nullptr;
+    PathChanged pathChanged;
+    ChangesLost changesLost;
+    // By the path the tree was added with
+    QHash<QString, std::shared_ptr<Tree>> trees;
+};
+
+bool KDirWatchTreeWatcher::Private::requestChanges(Tree *tree)
+{
+    tree->pending = ReadDirectoryChangesW(tree->dir, tree->buffer.data(), s_bufferSize, TRUE, s_notifyFilter, nullptr, &tree->overlapped, nullptr);
+    return tree->pending;
+}
+
+void KDirWatchTreeWatcher::Private::readChanges(Tree *tree)
+{
+    // Copied, as the callbacks may remove the tree
+    const QString treePath = tree->path;
+    QStringList changed;
+    bool lost = false;
+
+    DWORD bytes = 0;
+    const bool ok = GetOverlappedResult(tree->dir, &tree->overlapped, &bytes, FALSE);
+    tree->pending = false;
+    ResetEvent(tree->overlapped.hEvent);
+    if (!ok) {
+        // E.g. the directory was deleted, which the scan of its entry notices
+        changed.append(treePath);
+    } else if (bytes == 0) {
+        // The buffer overflowed
+        lost = true;
+    } else {
+        const auto *data = reinterpret_cast<const char *>(tree->buffer.data());
+        for (DWORD offset = 0;;) {
+            const auto *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(data + offset);
+            const QString name = QString::fromWCharArray(info->FileName, info->FileNameLength / sizeof(WCHAR));
+            changed.append(treePath + QLatin1Char('/') + QDir::fromNativeSeparators(name));
+            if (info->NextEntryOffset == 0) {
+                break;
+            }
+            offset += info->NextEntryOffset;
+        }
+    }
+
+    // Before the buffer is reused
+    if (ok && !requestChanges(tree)) {
+        changed.append(treePath);
+    }
+
+    for (const QString &path : std::as_const(changed)) {
+        pathChanged(path);
+    }
+    if (lost) {
+        changesLost(treePath);
+    }
+}
+
+void KDirWatchTreeWatcher::Private::releaseTree(Tree *tree)
+{
+    if (tree->notifier) {
+        // Possibly removed from its activated() signal
+        tree->notifier->setEnabled(false);
+        tree->notifier.release()->deleteLater();
+    }
+    if (tree->pending) {
+        // The buffer must not go away while the system may still write to it
+        CancelIoEx(tree->dir, &tree->overlapped);
+        DWORD bytes = 0;
+        GetOverlappedResult(tree->dir, &tree->overlapped, &bytes, TRUE);
+        tree->pending = false;
+    }
+    if (tree->dir != INVALID_HANDLE_VALUE) {
+        CloseHandle(tree->dir);
+    }
+    if (tree->overlapped.hEvent) {
+        CloseHandle(tree->overlapped.hEvent);
+    }
+}
+
+std::unique_ptr<KDirWatchTreeWatcher> KDirWatchTreeWatcher::create(const PathChanged &pathChanged, const ChangesLost &changesLost)
+{
+    auto d = std::make_unique<Private>();
+    d->pathChanged = pathChanged;
+    d->changesLost = changesLost;
+    return std::unique_ptr<KDirWatchTreeWatcher>(new KDirWatchTreeWatcher(std::move(d)));
+}
+
+KDirWatchTreeWatcher::KDirWatchTreeWatcher(std::unique_ptr<Private> dd)
+    : d(std::move(dd))
+{
+    d->q = this;
+}
+
+KDirWatchTreeWatcher::~KDirWatchTreeWatcher()
+{
+    for (const auto &tree : std::as_const(d->trees)) {
+        Private::releaseTree(tree.get());
+    }
+}
+
+bool KDirWatchTreeWatcher::addTree(const QString &path)
+{
+    if (d->trees.contains(path)) {
+        return true;
+    }
+
+    auto tree = std::make_shared<Private::Tree>();
+    tree->path = path;
+    tree->dir = CreateFileW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(path).utf16()),
+                            FILE_LIST_DIRECTORY,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                            nullptr);
+    tree->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (tree->dir == INVALID_HANDLE_VALUE || !tree->overlapped.hEvent || !d->requestChanges(tree.get())) {
+        Private::releaseTree(tree.get());
+        return false;
+    }
+
+    tree->notifier = std::make_unique<QWinEventNotifier>(tree->overlapped.hEvent);
+    QObject::connect(tree->notifier.get(), &QWinEventNotifier::activated, this, [this, treePtr = tree.get()]() {
+        d->readChanges(treePtr);
+    });
+    d->trees.insert(path, tree);
+    return true;
+}
+
+void KDirWatchTreeWatcher::removeTree(const QString &path)
+{
+    const std::shared_ptr<Private::Tree> tree = d->trees.take(path);
+    if (tree) {
+        Private::releaseTree(tree.get());
+    }
+}
@@ -16,15 +16,20 @@
 
 #include <QCoreApplication>
 #include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
 
 #include <array>
+#include <future>
+#include <optional>
 
 struct FsInfo {
     KFileSystemType::Type type = KFileSystemType::Unknown;
     const char *name = nullptr;
 };
 
-static const std::array<FsInfo, 19> s_fsMap = {{
+static constexpr std::array<FsInfo, 18> s_fsMap = {{
     {KFileSystemType::Nfs, "nfs"},
     {KFileSystemType::Smb, "smb"},
     {KFileSystemType::Fat, "fat"},
@@ -45,13 +50,65 @@ static const std::array<FsInfo, 19> s_fsMap = {{
     {KFileSystemType::Fuse, "fuseblk"},
 }};
 
+// A perfect hash of the names in s_fsMap, FNV-1a with a seed found by trying, see s_fsNameTable
+static constexpr quint32 s_fsNameHashSeed = 288;
+static constexpr int s_fsNameHashBits = 5;
+
+static constexpr quint32 fsNameHash(const char *name, qsizetype size)
+{
+    quint32 hash = 2166136261u ^ s_fsNameHashSeed;
+    for (qsizetype i = 0; i < size; ++i) {
+        hash ^= quint8(name[i]);
+        hash *= 16777619u;
+    }
+    return hash >> (32 - s_fsNameHashBits);
+}
+
+static constexpr qsizetype fsNameLength(const char *name)
+{
+    qsizetype length = 0;
+    while (name[length] != '\0') {
+        ++length;
+    }
+    return length;
+}
+
+// The index in s_fsMap of the name with each hash, -1 for none, or -2 if several names share it
+static constexpr std::array<qint8, 1 << s_fsNameHashBits> s_fsNameTable = []() {
+    std::array<qint8, 1 << s_fsNameHashBits> table{};
+    for (qint8 &index : table) {
+        index = -1;
+    }
+    for (qsizetype i = 0; i < qsizetype(s_fsMap.size()); ++i) {
+        qint8 &index = table[fsNameHash(s_fsMap[i].name, fsNameLength(s_fsMap[i].name))];
+        index = index == -1 ? qint8(i) : -2;
+    }
+    return table;
+}();
+
+static constexpr bool isPerfectFsNameHash()
+{
+    for (const qint8 index : s_fsNameTable) {
+        if (index == -2) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(isPerfectFsNameHash(), "Names in s_fsMap share a hash, try another s_fsNameHashSeed");
+
 #ifndef Q_OS_WIN
 inline KFileSystemType::Type kde_typeFromName(const QLatin1String name)
 {
-    auto it = std::find_if(s_fsMap.cbegin(), s_fsMap.cend(), [name](const auto &fsInfo) {
-        return QLatin1String(fsInfo.name) == name;
-    });
-    return it != s_fsMap.cend() ? it->type : KFileSystemType::Other;
+    // E.g. FUSE block devices whose type udev doesn't know
+    if (name.isEmpty()) {
+        return KFileSystemType::Unknown;
+    }
+    const qint8 index = s_fsNameTable[fsNameHash(name.data(), name.size())];
+    if (index >= 0 && QLatin1String(s_fsMap[index].name) == name) {
+        return s_fsMap[index].type;
+    }
+    return KFileSystemType::Other;
 }
 
 inline KFileSystemType::Type kde_typeFromName(const char *c)
@@ -205,6 +262,114 @@ static KFileSystemType::Type determineFileSystemTypeImpl(const QByteArray &path)
     }
 }
 
+#ifdef Q_OS_LINUX
+
+#include <chrono>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Caches the types by path, as statfs() and probing FUSE block devices are
+// expensive, and file managers ask again and again for the same directories.
+// The cache is dropped when anything gets mounted or unmounted, which the kernel
+// signals with POLLPRI on /proc/self/mountinfo. That is only checked every now
+// and then, so that a lookup in the cache usually doesn't need any syscall.
+class FileSystemTypeCache
+{
+public:
+    FileSystemTypeCache()
+        : m_mountInfo(open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC))
+    {
+    }
+
+    ~FileSystemTypeCache()
+    {
+        if (m_mountInfo >= 0) {
+            close(m_mountInfo);
+        }
+    }
+
+    KFileSystemType::Type type(const QByteArray &path)
+    {
+        // Without mountinfo there is no telling when the cache would become stale
+        if (m_mountInfo < 0) {
+            return determineFileSystemTypeImpl(path);
+        }
+
+        QMutexLocker locker(&m_mutex);
+        dropIfMountsChanged();
+
+        const auto it = m_types.constFind(path);
+        if (it != m_types.cend()) {
+            return *it;
+        }
+        locker.unlock();
+
+        const KFileSystemType::Type type = determineFileSystemTypeImpl(path);
+        // Don't cache errors, the path might just not exist yet
+        if (type != KFileSystemType::Unknown) {
+            locker.relock();
+            if (m_types.size() >= s_maxSize) {
+                m_types.clear();
+            }
+            m_types.insert(path, type);
+        }
+        return type;
+    }
+
+    // Like type(), but never probes, so it can't block on a hung mount
+    bool cachedType(const QByteArray &path, KFileSystemType::Type *type)
+    {
+        if (m_mountInfo < 0) {
+            return false;
+        }
+
+        QMutexLocker locker(&m_mutex);
+        dropIfMountsChanged();
+
+        const auto it = m_types.constFind(path);
+        if (it == m_types.cend()) {
+            return false;
+        }
+        *type = *it;
+        return true;
+    }
+
+private:
+    static constexpr qsizetype s_maxSize = 10000;
+
+    // With m_mutex locked
+    void dropIfMountsChanged()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - m_lastCheck >= std::chrono::seconds(1)) {
+            m_lastCheck = now;
+            pollfd pfd{m_mountInfo, POLLPRI, 0};
+            if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR))) {
+                m_types.clear();
+            }
+        }
+    }
+
+    const int m_mountInfo;
+    QMutex m_mutex;
+    std::chrono::steady_clock::time_point m_lastCheck;
+    QHash<QByteArray, KFileSystemType::Type> m_types;
+};
+
+static FileSystemTypeCache &fileSystemTypeCache()
+{
+    static FileSystemTypeCache s_cache;
+    return s_cache;
+}
+
+static KFileSystemType::Type cachedFileSystemType(const QByteArray &path)
+{
+    return fileSystemTypeCache().type(path);
+}
+#endif
+
 #elif defined(Q_OS_AIX) || defined(Q_OS_HPUX) || defined(Q_OS_QNX) || defined(Q_OS_SCO) || defined(Q_OS_UNIXWARE) || defined(Q_OS_RELIANT)                     \
     || defined(Q_OS_NETBSD)
 #include <sys/statvfs.h>
@@ -229,15 +394,112 @@ KFileSystemType::Type determineFileSystemTypeImpl(const QByteArray &path)
 }
 #endif
 
-KFileSystemType::Type KFileSystemType::fileSystemType(const QString &path)
+static KFileSystemType::Type probeFileSystemType(const QByteArray &path)
+{
+#ifdef Q_OS_LINUX
+    return cachedFileSystemType(path);
+#else
+    return determineFileSystemTypeImpl(path);
+#endif
+}
+
+// The configured type of @p path, if it is a configured slow path
+static bool configuredFileSystemType(const QString &path, KFileSystemType::Type *type)
 {
     if (KNetworkMounts::self()->isSlowPath(path, KNetworkMounts::KNetworkMountsType::SmbPaths)) {
-        return KFileSystemType::Smb;
+        *type = KFileSystemType::Smb;
+        return true;
     } else if (KNetworkMounts::self()->isSlowPath(path, KNetworkMounts::KNetworkMountsType::NfsPaths)) {
-        return KFileSystemType::Nfs;
-    } else {
-        return determineFileSystemTypeImpl(QFile::encodeName(path));
+        *type = KFileSystemType::Nfs;
+        return true;
+    }
+    return false;
+}
+
+KFileSystemType::Type KFileSystemType::fileSystemType(const QString &path)
+{
+    KFileSystemType::Type type;
+    if (configuredFileSystemType(path, &type)) {
+        return type;
     }
+    return probeFileSystemType(QFile::encodeName(path));
+}
+
+// Runs the probes of fileSystemType() with a timeout. A probe of a path on a
+// hung mount may never finish, so another call for the same path waits for
+// the probe already running instead of tying up another thread. Probes are
+// never queued behind stuck ones, so only the running probes are kept.
+class FileSystemTypeProber
+{
+public:
+    FileSystemTypeProber()
+    {
+        m_pool.setMaxThreadCount(s_maxThreads);
+        // Keep the threads, most of all the ones that are stuck
+        m_pool.setExpiryTimeout(-1);
+    }
+
+    // The running probe of @p path, or none if all threads are busy
+    std::optional<std::shared_future<KFileSystemType::Type>> probe(const QByteArray &path)
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_probes.constFind(path);
+        if (it != m_probes.cend()) {
+            return *it;
+        }
+
+        auto promise = std::make_shared<std::promise<KFileSystemType::Type>>();
+        std::shared_future<KFileSystemType::Type> future = promise->get_future().share();
+        // Removed by the probe itself, which has to wait for the mutex until then
+        m_probes.insert(path, future);
+        const bool started = m_pool.tryStart([this, path, promise]() {
+            promise->set_value(probeFileSystemType(path));
+            QMutexLocker locker(&m_mutex);
+            m_probes.remove(path);
+        });
+        if (!started) {
+            m_probes.remove(path);
+            return std::nullopt;
+        }
+        return future;
+    }
+
+private:
+    // So that a few hung mounts don't keep the others from being probed
+    static constexpr int s_maxThreads = 4;
+
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QHash<QByteArray, std::shared_future<KFileSystemType::Type>> m_probes;
+};
+
+KFileSystemType::Type KFileSystemType::fileSystemType(const QString &path, std::chrono::milliseconds timeout)
+{
+    KFileSystemType::Type type;
+    if (configuredFileSystemType(path, &type)) {
+        return type;
+    }
+
+    const QByteArray encodedPath = QFile::encodeName(path);
+#ifdef Q_OS_LINUX
+    if (fileSystemTypeCache().cachedType(encodedPath, &type)) {
+        return type;
+    }
+#endif
+
+    // Never deleted, as deleting it would wait for the probes stuck on hung mounts
+    static FileSystemTypeProber *s_prober = new FileSystemTypeProber;
+    const std::optional<std::shared_future<KFileSystemType::Type>> future = s_prober->probe(encodedPath);
+    if (!future) {
+        // Stuck on other paths, which says nothing about this one
+        return KFileSystemType::Unknown;
+    }
+    if (future->wait_for(timeout) == std::future_status::ready) {
+        return future->get();
+    }
+
+    KNetworkMounts::self()->recordUnresponsive(path);
+    return KFileSystemType::Unknown;
 }
 
 QString KFileSystemType::fileSystemName(KFileSystemType::Type type)
@@ -13,6 +13,8 @@
 
 #include <QString>
 
+#include <chrono>
+
 /**
  * @namespace KFileSystemType
  * Provides utility functions for the type of file systems.
@@ -41,10 +43,28 @@ enum Type {
  * For a given @p path, returns the filesystem type, one of @ref KFileSystemType::Type
  * values. If the type can't be determined, @c KFileSystemType::Unknown is returned.
  *
+ * On Linux, the types are cached by path until something gets mounted or unmounted.
+ *
  * @since 5.0
  */
 KCOREADDONS_EXPORT Type fileSystemType(const QString &path);
 
+/**
+ * Like fileSystemType(const QString &), but gives up after @p timeout, so that
+ * a hung network mount can't block the calling thread.
+ *
+ * The filesystem is probed on a worker thread. If that doesn't finish in time,
+ * @c KFileSystemType::Unknown is returned and the path is recorded as
+ * unresponsive with KNetworkMounts::recordUnresponsive(), which treats its mount
+ * as slow if KNetworkMounts::AdaptiveSlowPathDetection is enabled. The probe
+ * goes on, and on Linux later calls get its result from the cache once it is done.
+ * While all worker threads are stuck on hung mounts, @c KFileSystemType::Unknown is
+ * returned right away, without recording the path.
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT Type fileSystemType(const QString &path, std::chrono::milliseconds timeout);
+
 /**
  * Returns the possibly translated name of a filesystem corresponding to a
  * value from @ref KFileSystemType::Type.
@@ -8,13 +8,28 @@
 */
 
 #include "kfileutils.h"
+#include "kparallel_p.h"
 
+#include <QDir>
 #include <QDirIterator>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QMimeDatabase>
 #include <QRegularExpression>
+#include <QSemaphore>
+#include <QSet>
+#include <QThreadPool>
 
+#include <atomic>
+#include <limits>
 #include <set>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
 
 QString KFileUtils::makeSuggestedName(const QString &oldName)
 {
@@ -69,6 +84,84 @@ QString KFileUtils::suggestName(const QUrl &baseURL, const QString &oldName)
     return suggestedName;
 }
 
+QStringList KFileUtils::suggestNames(const QUrl &baseURL, const QStringList &oldNames)
+{
+#if defined(Q_OS_WIN) || defined(Q_OS_MACOS)
+    // Like QFileInfo::exists() on the usual file systems there
+    const auto nameKey = [](const QString &name) {
+        return name.toCaseFolded();
+    };
+#else
+    const auto nameKey = [](const QString &name) {
+        return name;
+    };
+#endif
+
+    QSet<QString> takenNames;
+    if (baseURL.isLocalFile()) {
+        const QStringList entries = QDir(baseURL.toLocalFile()).entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        takenNames.reserve(entries.size() + oldNames.size());
+        for (const QString &entry : entries) {
+            takenNames.insert(nameKey(entry));
+        }
+    }
+
+    // makeSuggestedName() only ever increments the number in "(N)", so the names
+    // it suggests for a name form a chain of numbers in an otherwise fixed text.
+    // For every chain, the numbers known to be taken are kept as a range, so that
+    // many files of the same name don't need to try all the names before theirs.
+    struct TakenRange {
+        int first;
+        int last;
+    };
+    QHash<QString, TakenRange> takenRanges;
+    static const QRegularExpression re(QStringLiteral("\\((\\d+)\\)"));
+
+    QStringList names;
+    names.reserve(oldNames.size());
+    for (const QString &oldName : oldNames) {
+        QString name = makeSuggestedName(oldName);
+
+        QRegularExpressionMatch match;
+        const qsizetype numberIndex = name.lastIndexOf(re, -1, &match);
+        const QString prefix = name.left(match.capturedStart(1));
+        const QString suffix = name.mid(match.capturedEnd(1));
+        const auto nameWithNumber = [&](int number) {
+            return prefix + QString::number(number) + suffix;
+        };
+        bool ok = false;
+        const int number = match.captured(1).toInt(&ok);
+
+        // Some corner cases, like a number in the extension, don't form such a chain
+        if (numberIndex == -1 || !ok || number == std::numeric_limits<int>::max() || makeSuggestedName(name) != nameWithNumber(number + 1)) {
+            while (takenNames.contains(nameKey(name))) {
+                name = makeSuggestedName(name);
+            }
+            takenNames.insert(nameKey(name));
+            names.append(name);
+            continue;
+        }
+
+        const QString chain = prefix + QChar() + suffix;
+        auto rangeIt = takenRanges.find(chain);
+        const bool inRange = rangeIt != takenRanges.end() && number >= rangeIt->first && number <= rangeIt->last + 1;
+        int freeNumber = inRange ? rangeIt->last + 1 : number;
+        QString freeName = nameWithNumber(freeNumber);
+        while (takenNames.contains(nameKey(freeName))) {
+            freeName = nameWithNumber(++freeNumber);
+        }
+
+        if (inRange) {
+            rangeIt->last = freeNumber;
+        } else {
+            takenRanges.insert(chain, TakenRange{number, freeNumber});
+        }
+        takenNames.insert(nameKey(freeName));
+        names.append(freeName);
+    }
+    return names;
+}
+
 QStringList KFileUtils::findAllUniqueFiles(const QStringList &dirs, const QStringList &nameFilters)
 {
     QStringList foundFilePaths;
@@ -85,3 +178,110 @@ QStringList KFileUtils::findAllUniqueFiles(const QStringList &dirs, const QStrin
     }
     return foundFilePaths;
 }
+
+// Lists the files in @p dir matching any of @p nameFilters like a QDirIterator
+// with QDir::Files would, but without the QFileInfo for every entry on Unix
+static QStringList listFiles(const QString &dir, const QList<QRegularExpression> &nameFilters, const QStringList &nameFilterStrings)
+{
+    QStringList filePaths;
+#ifdef Q_OS_UNIX
+    Q_UNUSED(nameFilterStrings)
+    const QByteArray encodedDir = QFile::encodeName(dir);
+    DIR *d = opendir(encodedDir.constData());
+    if (!d) {
+        return filePaths;
+    }
+    const QString dirPrefix = dir.endsWith(QLatin1Char('/')) ? dir : dir + QLatin1Char('/');
+    while (const dirent *entry = readdir(d)) {
+        // Hidden files are skipped without QDir::Hidden, which takes care of "." and ".." too
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        const QString name = QFile::decodeName(entry->d_name);
+        if (!nameFilters.isEmpty()) {
+            const bool matches = std::any_of(nameFilters.cbegin(), nameFilters.cend(), [&name](const QRegularExpression &filter) {
+                return filter.match(name).hasMatch();
+            });
+            if (!matches) {
+                continue;
+            }
+        }
+        // Only the entries whose type isn't known from readdir(), like symlinks, need a stat()
+        bool isFile = false;
+#ifdef DT_REG
+        if (entry->d_type == DT_REG) {
+            isFile = true;
+        } else if (entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+#endif
+        if (!isFile) {
+            struct stat buf;
+            if (fstatat(dirfd(d), entry->d_name, &buf, 0) != 0 || !S_ISREG(buf.st_mode)) {
+                continue;
+            }
+        }
+        filePaths.append(dirPrefix + name);
+    }
+    closedir(d);
+#else
+    Q_UNUSED(nameFilters)
+    QDirIterator it(dir, nameFilterStrings, QDir::Files);
+    while (it.hasNext()) {
+        filePaths.append(it.next());
+    }
+#endif
+    return filePaths;
+}
+
+void KFileUtils::findAllUniqueFiles(const QStringList &dirs, const QStringList &nameFilters, const std::function<void(const QString &filePath)> &callback)
+{
+    QList<QRegularExpression> nameFilterExpressions;
+    nameFilterExpressions.reserve(nameFilters.size());
+    for (const QString &nameFilter : nameFilters) {
+        nameFilterExpressions.append(QRegularExpression::fromWildcard(nameFilter, Qt::CaseInsensitive));
+    }
+
+    // Every thread lists the next directory until none are left
+    const qsizetype count = dirs.size();
+    std::vector<QStringList> filePaths(count);
+    std::vector<QSemaphore> listed(count);
+    std::atomic<qsizetype> next = 0;
+    const auto listNext = [&]() {
+        const qsizetype i = next++;
+        if (i >= count) {
+            return false;
+        }
+        filePaths[i] = listFiles(dirs.at(i), nameFilterExpressions, nameFilters);
+        listed[i].release();
+        return true;
+    };
+    const auto listAll = [&listNext](int) {
+        while (listNext()) { }
+    };
+
+    // The files are passed on in the order of the directories. While waiting
+    // for a directory, the calling thread lists the next ones itself; as they
+    // are taken in order, the one waited for is always taken already once
+    // there are none left.
+    const auto passOn = [&]() {
+        QSet<QString> foundFileNames;
+        for (qsizetype i = 0; i < count; ++i) {
+            while (!listed[i].tryAcquire()) {
+                if (!listNext()) {
+                    listed[i].acquire();
+                    break;
+                }
+            }
+            for (const QString &filePath : std::as_const(filePaths[i])) {
+                const QString fileName = filePath.mid(filePath.lastIndexOf(QLatin1Char('/')) + 1);
+                if (!foundFileNames.contains(fileName)) {
+                    foundFileNames.insert(fileName);
+                    callback(filePath);
+                }
+            }
+            filePaths[i].clear();
+        }
+    };
+    KParallel::run(int(qMin<qsizetype>(count, QThreadPool::globalInstance()->maxThreadCount())), listAll, passOn);
+}
@@ -12,8 +12,11 @@
 #include "kcoreaddons_export.h"
 
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 
+#include <functional>
+
 /**
  * @short A namespace for KFileUtils globals
  *
@@ -39,6 +42,19 @@ namespace KFileUtils
  */
 KCOREADDONS_EXPORT QString suggestName(const QUrl &baseURL, const QString &oldName);
 
+/**
+ * Same as suggestName(), but suggests names for all of @p oldNames at once, e.g.
+ * for files pasted into @p baseURL.
+ *
+ * The suggested names differ from each other, and for local URLs also from the
+ * files and directories in @p baseURL. The directory is only listed once for
+ * all names, instead of checking every candidate name separately.
+ *
+ * @return the suggested names, in the order of @p oldNames
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QStringList suggestNames(const QUrl &baseURL, const QStringList &oldNames);
+
 /**
  * Given a string, "foo", representing a file/directory (which usually exists already),
  * this function returns a suggested name for a file/directory in the form "foo (1)",
@@ -70,5 +86,27 @@ KCOREADDONS_EXPORT QString makeSuggestedName(const QString &oldName);
  * @since 5.85
  */
 KCOREADDONS_EXPORT QStringList findAllUniqueFiles(const QStringList &dirs, const QStringList &nameFilters = {});
+
+/**
+ * Same as findAllUniqueFiles(const QStringList &, const QStringList &), but lists
+ * the @p dirs concurrently, and passes the found files to @p callback instead of
+ * collecting them.
+ *
+ * @p callback is called in the calling thread, for the files of each directory
+ * as soon as it and all directories before it are listed, so in the same order
+ * as the list returned by findAllUniqueFiles(const QStringList &, const QStringList &).
+ *
+ * @code
+    KFileUtils::findAllUniqueFiles(dirs, QStringList{QStringLiteral("*.desktop")}, [this](const QString &filePath) {
+        addService(filePath);
+    });
+ * @endcode
+ * @param dirs the directories to list, the earlier ones taking precedence
+ * @param nameFilters wildcard patterns the file names have to match, case-insensitively
+ * @param callback called with the absolute path of every file found
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT void
+findAllUniqueFiles(const QStringList &dirs, const QStringList &nameFilters, const std::function<void(const QString &filePath)> &callback);
 }
 #endif
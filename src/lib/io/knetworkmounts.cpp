@@ -9,17 +9,183 @@
 #include "knetworkmounts_p.h"
 
 #include <QCoreApplication>
-#include <QGlobalStatic>
 
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFile>
 #include <QStandardPaths>
+#include <QStorageInfo>
+
+// The weight of a new latency in the average of its mount point
+static const double s_latencyWeight = 0.25;
+// The latencies a mount point needs before it is classified
+static const int s_minLatencySamples = 3;
+// The default for AdaptiveSlowPathThreshold, in milliseconds
+static const qint64 s_defaultSlowThresholdMs = 100;
+// How long the mount points are taken as they were read, mounts come and go
+static const std::chrono::seconds s_mountPointsMaxAge(10);
 
 KNetworkMountsPrivate::KNetworkMountsPrivate(KNetworkMounts *qq)
     : q(qq)
 {
 }
 
+void KNetworkMountsPrivate::updateMatchers()
+{
+    auto matchers = std::make_unique<KNetworkMountsMatchers>();
+    for (const auto type : {KNetworkMounts::NfsPaths, KNetworkMounts::SmbPaths, KNetworkMounts::SymlinkDirectory, KNetworkMounts::SymlinkToNetworkMount}) {
+        matchers->byType[type] = KNetworkMountsPrefixMatcher(q->paths(type));
+    }
+    matchers->byType[KNetworkMounts::Any] = KNetworkMountsPrefixMatcher(q->paths(KNetworkMounts::Any));
+
+    QMutexLocker locker(&m_matchersMutex);
+    m_matchers.storeRelease(matchers.get());
+    m_allMatchers.push_back(std::move(matchers));
+    locker.unlock();
+
+    m_symlinkCache.clear();
+}
+
+void KNetworkMountsPrivate::updateAdaptiveSettings()
+{
+    m_adaptive.store(q->isEnabled() && q->isOptionEnabled(KNetworkMounts::AdaptiveSlowPathDetection, false), std::memory_order_relaxed);
+    const qint64 thresholdMs = m_settings->value(QStringLiteral("AdaptiveSlowPathThreshold"), s_defaultSlowThresholdMs).toLongLong();
+    m_adaptiveThresholdUsecs.store(std::max<qint64>(thresholdMs, 1) * 1000, std::memory_order_relaxed);
+}
+
+void KNetworkMountsPrivate::updateDetectedMatcher()
+{
+    // Listed with m_matchersMutex locked, so that concurrent updates can't
+    // publish an outdated list last
+    QMutexLocker locker(&m_matchersMutex);
+    std::shared_ptr<const KNetworkMountsPrefixMatcher> matcher = std::make_shared<KNetworkMountsPrefixMatcher>(m_latencyTracker.slowMountPoints());
+    std::atomic_store_explicit(&m_detectedMatcher, std::move(matcher), std::memory_order_release);
+}
+
+bool KNetworkMountsLatencyTracker::record(const QString &path, std::chrono::microseconds latency, std::chrono::microseconds threshold)
+{
+    QMutexLocker locker(&m_mutex);
+    const QString mount = mountPoint(path);
+    if (mount.isEmpty()) {
+        return false;
+    }
+
+    Mount &m = m_mounts[mount];
+    const double usecs = double(latency.count());
+    m.averageUsecs = m.samples == 0 ? usecs : m.averageUsecs + (usecs - m.averageUsecs) * s_latencyWeight;
+    if (m.samples < s_minLatencySamples) {
+        ++m.samples;
+    }
+    if (m.samples < s_minLatencySamples) {
+        return false;
+    }
+
+    const double limit = m.slow ? double(threshold.count()) / 4 : double(threshold.count());
+    const bool slow = m.averageUsecs >= limit;
+    if (slow == m.slow) {
+        return false;
+    }
+    m.slow = slow;
+    return true;
+}
+
+bool KNetworkMountsLatencyTracker::recordUnresponsive(const QString &path, std::chrono::microseconds threshold)
+{
+    QMutexLocker locker(&m_mutex);
+    const QString mount = mountPoint(path);
+    if (mount.isEmpty()) {
+        return false;
+    }
+
+    // As if it had been slow for a while, so that it takes a few quick
+    // operations to be classified as fast again
+    Mount &m = m_mounts[mount];
+    m.averageUsecs = std::max(m.averageUsecs, double(threshold.count()) * 4);
+    m.samples = s_minLatencySamples;
+    if (m.slow) {
+        return false;
+    }
+    m.slow = true;
+    return true;
+}
+
+bool KNetworkMountsLatencyTracker::isSlow(const QString &path)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_mounts.value(mountPoint(path)).slow;
+}
+
+QStringList KNetworkMountsLatencyTracker::slowMountPoints() const
+{
+    QMutexLocker locker(&m_mutex);
+    QStringList mountPoints;
+    for (auto it = m_mounts.cbegin(); it != m_mounts.cend(); ++it) {
+        if (it->slow) {
+            mountPoints.append(it.key());
+        }
+    }
+    return mountPoints;
+}
+
+QString KNetworkMountsLatencyTracker::mountPoint(const QString &path)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (m_mountPointsRead == std::chrono::steady_clock::time_point() || now - m_mountPointsRead >= s_mountPointsMaxAge) {
+        m_mountPointsRead = now;
+        QStringList mountPoints = systemMountPoints();
+        std::sort(mountPoints.begin(), mountPoints.end(), [](const QString &a, const QString &b) {
+            return a.size() > b.size();
+        });
+        m_mountPoints = KNetworkMountsPrefixMatcher(mountPoints);
+    }
+    return m_mountPoints.match(path);
+}
+
+QStringList KNetworkMountsLatencyTracker::systemMountPoints()
+{
+    QStringList mountPoints;
+#ifdef Q_OS_LINUX
+    // Unlike QStorageInfo, this doesn't statvfs() the mounts, which might be the slow ones
+    QFile mountInfo(QStringLiteral("/proc/self/mountinfo"));
+    if (mountInfo.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = mountInfo.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            // "36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw",
+            // the mount point is the fifth field, with blanks escaped like \040
+            const QList<QByteArray> fields = line.split(' ');
+            if (fields.size() < 5) {
+                continue;
+            }
+            const QByteArray &escaped = fields.at(4);
+            QByteArray mountPoint;
+            mountPoint.reserve(escaped.size());
+            for (qsizetype i = 0; i < escaped.size(); ++i) {
+                if (escaped.at(i) == '\\' && i + 3 < escaped.size()) {
+                    mountPoint.append(char(escaped.mid(i + 1, 3).toInt(nullptr, 8)));
+                    i += 3;
+                } else {
+                    mountPoint.append(escaped.at(i));
+                }
+            }
+            mountPoints.append(QFile::decodeName(mountPoint));
+        }
+    }
+#endif
+    if (mountPoints.isEmpty()) {
+        const QList<QStorageInfo> volumes = QStorageInfo::mountedVolumes();
+        for (const QStorageInfo &volume : volumes) {
+            mountPoints.append(volume.rootPath());
+        }
+    }
+    ensureTrailingSlashes(&mountPoints);
+    return mountPoints;
+}
+
+// Set once self() is created, for looking at its cache without creating it
+static std::atomic<KNetworkMountsPrivate *> s_created = nullptr;
+
 KNetworkMounts *KNetworkMounts::self()
 {
     static KNetworkMounts s_self;
@@ -40,15 +206,61 @@ KNetworkMounts::KNetworkMounts()
             d->m_settings->setValue(typeStr, slowPaths);
         }
     }
+
+    d->updateMatchers();
+    d->updateDetectedMatcher();
+    d->updateAdaptiveSettings();
+    s_created.store(d.get(), std::memory_order_release);
 }
 
 KNetworkMounts::~KNetworkMounts()
 {
+    s_created.store(nullptr, std::memory_order_release);
 }
 
 bool KNetworkMounts::isSlowPath(const QString &path, KNetworkMountsType type)
 {
-    return !getMatchingPath(path, paths(type)).isEmpty();
+    if (!d->matcher(type).match(path).isEmpty()) {
+        return true;
+    }
+    // Detected slow mounts have no type
+    return type == Any && d->m_adaptive.load(std::memory_order_relaxed) && !d->detectedMatcher()->match(path).isEmpty();
+}
+
+void KNetworkMounts::recordLatency(const QString &path, std::chrono::microseconds latency)
+{
+    if (!d->m_adaptive.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const std::chrono::microseconds threshold(d->m_adaptiveThresholdUsecs.load(std::memory_order_relaxed));
+    if (d->m_latencyTracker.record(path, latency, threshold)) {
+        d->updateDetectedMatcher();
+    }
+}
+
+void KNetworkMounts::recordUnresponsive(const QString &path)
+{
+    if (!d->m_adaptive.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const std::chrono::microseconds threshold(d->m_adaptiveThresholdUsecs.load(std::memory_order_relaxed));
+    if (d->m_latencyTracker.recordUnresponsive(path, threshold)) {
+        d->updateDetectedMatcher();
+    }
+}
+
+bool KNetworkMounts::probePath(const QString &path)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QFileInfo::exists(path);
+    recordLatency(path, std::chrono::microseconds(timer.nsecsElapsed() / 1000));
+    return d->m_adaptive.load(std::memory_order_relaxed) && d->m_latencyTracker.isSlow(path);
+}
+
+QStringList KNetworkMounts::detectedSlowPaths() const
+{
+    return d->m_latencyTracker.slowMountPoints();
 }
 
 bool KNetworkMounts::isOptionEnabledForPath(const QString &path, KNetworkMountOption option)
@@ -72,6 +284,7 @@ bool KNetworkMounts::isEnabled() const
 void KNetworkMounts::setEnabled(const bool value)
 {
     d->m_settings->setValue(QStringLiteral("EnableOptimizations"), value);
+    d->updateAdaptiveSettings();
 }
 
 bool KNetworkMounts::isOptionEnabled(const KNetworkMountOption option, const bool defaultValue) const
@@ -82,6 +295,7 @@ bool KNetworkMounts::isOptionEnabled(const KNetworkMountOption option, const boo
 void KNetworkMounts::setOption(const KNetworkMountOption option, const bool value)
 {
     d->m_settings->setValue(enumToString(option), value);
+    d->updateAdaptiveSettings();
 }
 
 QStringList KNetworkMounts::paths(KNetworkMountsType type) const
@@ -104,6 +318,7 @@ void KNetworkMounts::setPaths(const QStringList &paths, KNetworkMountsType type)
     QStringList _paths(paths);
     ensureTrailingSlashes(&_paths);
     d->m_settings->setValue(enumToString(type), _paths);
+    d->updateMatchers();
 }
 
 void KNetworkMounts::addPath(const QString &path, KNetworkMountsType type)
@@ -113,23 +328,21 @@ void KNetworkMounts::addPath(const QString &path, KNetworkMountsType type)
     QStringList newPaths = paths(type);
     newPaths.append(_path);
     d->m_settings->setValue(enumToString(type), newPaths);
+    d->updateMatchers();
 }
 
-typedef QHash<QString /*symlink*/, QString /*canonical path*/> symlinkCanonicalPathHash;
-Q_GLOBAL_STATIC(symlinkCanonicalPathHash, s_canonicalLinkSpacePaths)
-
 QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
 {
     bool useCache = isOptionEnabled(KNetworkMountOption::SymlinkPathsUseCache, true);
     if (useCache) {
-        const QString resolved = s_canonicalLinkSpacePaths->value(path);
+        const QString resolved = d->m_symlinkCache.value(path);
 
         if (!resolved.isEmpty()) {
             return resolved;
         }
     }
 
-    QString symlinkPath = getMatchingPath(path, paths(KNetworkMountsType::SymlinkToNetworkMount));
+    QString symlinkPath = d->matcher(KNetworkMountsType::SymlinkToNetworkMount).match(path);
     if (!symlinkPath.isEmpty()) {
         // remove trailing slash
         symlinkPath.chop(1);
@@ -141,7 +354,7 @@ QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
         if (target.isEmpty()) {
             // not a symlink
             if (useCache) {
-                s_canonicalLinkSpacePaths->insert(path, path);
+                d->m_symlinkCache.insert(path, path);
             }
             return path;
         } else {
@@ -151,13 +364,13 @@ QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
             linkPath.replace(0, symlinkPath.size(), target);
 
             if (useCache) {
-                s_canonicalLinkSpacePaths->insert(path, linkPath);
+                d->m_symlinkCache.insert(path, linkPath);
             }
             return linkPath;
         }
     }
 
-    QString linkSpacePath = getMatchingPath(path, paths(KNetworkMountsType::SymlinkDirectory));
+    QString linkSpacePath = d->matcher(KNetworkMountsType::SymlinkDirectory).match(path);
     if (!linkSpacePath.isEmpty()) {
         QString _path = path;
         if (!_path.endsWith(QLatin1Char('/'))) {
@@ -166,7 +379,7 @@ QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
 
         if (_path == linkSpacePath) {
             if (useCache) {
-                s_canonicalLinkSpacePaths->insert(path, path);
+                d->m_symlinkCache.insert(path, path);
             }
             return path;
         }
@@ -175,11 +388,12 @@ QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
         int linkIndex = path.indexOf(QLatin1Char('/'), linkSpacePath.length());
         const QString symlink = path.left(linkIndex);
 
-        if (useCache && s_canonicalLinkSpacePaths->contains(symlink)) {
+        const QString resolvedSymlink = useCache ? d->m_symlinkCache.value(symlink) : QString();
+        if (!resolvedSymlink.isEmpty()) {
             QString linkPath(path);
             // replace only the first occurence of symlink in linkPath
-            linkPath.replace(0, symlink.size(), s_canonicalLinkSpacePaths->value(symlink));
-            s_canonicalLinkSpacePaths->insert(path, linkPath);
+            linkPath.replace(0, symlink.size(), resolvedSymlink);
+            d->m_symlinkCache.insert(path, linkPath);
             return linkPath;
         } else {
             QFileInfo link(symlink);
@@ -190,12 +404,12 @@ QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
                 linkPath.replace(0, symlink.size(), link.symLinkTarget());
 
                 if (useCache) {
-                    s_canonicalLinkSpacePaths->insert(path, linkPath);
+                    d->m_symlinkCache.insert(path, linkPath);
                 }
                 return linkPath;
             } else {
                 if (useCache) {
-                    s_canonicalLinkSpacePaths->insert(path, path);
+                    d->m_symlinkCache.insert(path, path);
                 }
             }
         }
@@ -206,14 +420,32 @@ QString KNetworkMounts::canonicalSymlinkPath(const QString &path)
 
 void KNetworkMounts::clearCache()
 {
-    if (s_canonicalLinkSpacePaths.exists()) {
-        s_canonicalLinkSpacePaths->clear();
+    d->m_symlinkCache.clear();
+}
+
+KMemoryFootprint::Subsystem KMemoryFootprintPrivate::networkMounts()
+{
+    KMemoryFootprint::Subsystem subsystem{QStringLiteral("KNetworkMounts"), 0, 0, true};
+    if (const KNetworkMountsPrivate *d = s_created.load(std::memory_order_acquire)) {
+        subsystem.objects = qsizetype(d->m_symlinkCache.size());
+        subsystem.bytes = d->m_symlinkCache.bytes();
+    }
+    return subsystem;
+}
+
+void KMemoryFootprintPrivate::releaseNetworkMounts()
+{
+    if (KNetworkMountsPrivate *d = s_created.load(std::memory_order_acquire)) {
+        d->m_symlinkCache.clear();
     }
 }
 
 void KNetworkMounts::sync()
 {
     d->m_settings->sync();
+    // Other processes may have changed the paths
+    d->updateMatchers();
+    d->updateAdaptiveSettings();
 }
 
 #include "moc_knetworkmounts.cpp"
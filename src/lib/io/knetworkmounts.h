@@ -7,6 +7,7 @@
 #ifndef KNETWORKMOUNTS_H
 #define KNETWORKMOUNTS_H
 
+#include <chrono>
 #include <memory>
 
 #include <QObject>
@@ -47,6 +48,9 @@
  *   }
  * @endcode
  *
+ * Mounts that are not configured can also be found slow by measuring how long
+ * metadata operations on them take, see @ref AdaptiveSlowPathDetection.
+ *
  * If called for the first time, this creates a singleton instance and reads
  * the config file. Subsequent calls just use this instance without reading
  * the config file again.
@@ -92,7 +96,10 @@ public:
                                         ///< Ignore recent files on slow paths
         StrongSideEffectsOptimizations, ///< Turn off symbolic link resolution
         KDirWatchDontAddWatches, ///< Disables dir watching completely for slow paths, avoids stat() calls on added dirs and subdirs
-        SymlinkPathsUseCache ///< Cache resolved symlink paths
+        SymlinkPathsUseCache, ///< Cache resolved symlink paths
+        AdaptiveSlowPathDetection, ///< Classify mount points as slow paths by the latencies recorded with @ref recordLatency, off by default.<br>
+                                   ///< A mount point becomes slow once its operations take 100 ms on average, or the milliseconds
+                                   ///< configured as AdaptiveSlowPathThreshold, and fast again below a quarter of that. @since 6.0
     };
     Q_ENUM(KNetworkMountOption)
 
@@ -121,12 +128,61 @@ public:
      */
     bool isSlowPath(const QString &path, KNetworkMountsType type = Any);
 
+    /**
+     * Records that a metadata operation like stat() on @p path took @p latency
+     *
+     * If @ref AdaptiveSlowPathDetection is enabled, the mount point of @p path is
+     * classified as slow once these operations take long on average. @ref isSlowPath
+     * then returns @c true for any path on it with type @ref Any, as if it was
+     * configured, until it is classified as fast again. KDirWatch records the
+     * latencies of the polling of its watched paths itself.
+     *
+     * This can be called from any thread.
+     *
+     * @param path the path the operation was done on
+     * @param latency how long the operation took
+     * @since 6.0
+     */
+    void recordLatency(const QString &path, std::chrono::microseconds latency);
+
+    /**
+     * Records that a metadata operation on @p path did not finish in time, e.g.
+     * because its mount is hung
+     *
+     * If @ref AdaptiveSlowPathDetection is enabled, the mount point of @p path is
+     * classified as slow right away, see @ref recordLatency. This is used by
+     * KFileSystemType::fileSystemType() when its probe times out.
+     *
+     * This can be called from any thread.
+     *
+     * @param path the path the operation was done on
+     * @since 6.0
+     */
+    void recordUnresponsive(const QString &path);
+
+    /**
+     * Measures how long stat() on @p path takes and records it, see @ref recordLatency
+     *
+     * @param path the path to probe
+     * @return @c true if the mount point of @p path is classified as slow
+     * @since 6.0
+     */
+    bool probePath(const QString &path);
+
+    /**
+     * The mount points classified as slow by @ref AdaptiveSlowPathDetection
+     *
+     * @return the mount points, with trailing slashes
+     * @since 6.0
+     */
+    QStringList detectedSlowPaths() const;
+
     /**
      * Query if @p path is configured to be a slow path and @p option is enabled
      *
      * @param path the path to query
      * @param option the option to query
-     * @return @c true if @p path is a configured slow path and option @p option is enabled
+     * @return @c true if @p path is a configured or detected slow path and option @p option is enabled
      */
     bool isOptionEnabledForPath(const QString &path, KNetworkMountOption option);
 
@@ -7,21 +7,318 @@
 #ifndef KNETWORKMOUNTS_P_H
 #define KNETWORKMOUNTS_P_H
 
+#include "kmemoryfootprint_p.h"
 #include "knetworkmounts.h"
 
+#include <QAtomicPointer>
+#include <QHash>
 #include <QMetaEnum>
+#include <QMutex>
+#include <QReadWriteLock>
 #include <QSettings>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Finds the configured slow path matching a path like getMatchingPath(), but in
+// a prefix tree of the slow paths, so in time linear to the length of the path.
+// It never changes after being built, so it can be used from any thread.
+class KNetworkMountsPrefixMatcher
+{
+public:
+    KNetworkMountsPrefixMatcher() = default;
+
+    explicit KNetworkMountsPrefixMatcher(const QStringList &slowPaths)
+        : m_paths(slowPaths)
+    {
+        m_nodes.emplace_back();
+        for (int i = 0; i < m_paths.size(); ++i) {
+            const QString &slowPath = m_paths.at(i);
+            // An empty slow path never counts as a match, see getMatchingPath()
+            if (slowPath.isEmpty()) {
+                continue;
+            }
+
+            size_t node = 0;
+            for (const QChar c : slowPath) {
+                auto &edges = m_nodes[node].edges;
+                auto it = std::lower_bound(edges.begin(), edges.end(), c.unicode(), [](const Edge &edge, char16_t ch) {
+                    return edge.c < ch;
+                });
+                if (it == edges.end() || it->c != c.unicode()) {
+                    it = edges.insert(it, Edge{c.unicode(), m_nodes.size()});
+                    node = it->node;
+                    m_nodes.emplace_back();
+                } else {
+                    node = it->node;
+                }
+            }
+            // The first of duplicate slow paths wins, like in the list
+            if (m_nodes[node].pathIndex < 0) {
+                m_nodes[node].pathIndex = i;
+            }
+        }
+    }
+
+    // Same as getMatchingPath(path, slowPaths)
+    QString match(QStringView path) const
+    {
+        if (m_nodes.empty()) {
+            return QString();
+        }
+
+        int pathIndex = -1;
+        size_t node = 0;
+        const auto step = [&](char16_t c) {
+            const auto &edges = m_nodes[node].edges;
+            const auto it = std::lower_bound(edges.cbegin(), edges.cend(), c, [](const Edge &edge, char16_t ch) {
+                return edge.c < ch;
+            });
+            if (it == edges.cend() || it->c != c) {
+                return false;
+            }
+            node = it->node;
+            // The slow path coming first in the list wins, like in getMatchingPath()
+            const int index = m_nodes[node].pathIndex;
+            if (index >= 0 && (pathIndex < 0 || index < pathIndex)) {
+                pathIndex = index;
+            }
+            return true;
+        };
+
+        bool walking = true;
+        for (const QChar c : path) {
+            if (!step(c.unicode())) {
+                walking = false;
+                break;
+            }
+        }
+        // getMatchingPath() matches against the path with a trailing slash
+        if (walking && !path.endsWith(QLatin1Char('/'))) {
+            step(u'/');
+        }
+
+        return pathIndex < 0 ? QString() : m_paths.at(pathIndex);
+    }
+
+private:
+    struct Edge {
+        char16_t c;
+        size_t node;
+    };
+    struct Node {
+        std::vector<Edge> edges; // sorted by c
+        int pathIndex = -1;
+    };
+
+    QStringList m_paths;
+    std::vector<Node> m_nodes;
+};
+
+// The matchers for all KNetworkMountsType values, indexed by them
+struct KNetworkMountsMatchers {
+    KNetworkMountsPrefixMatcher byType[KNetworkMounts::Any + 1];
+};
+
+// The resolved symlink paths of KNetworkMounts::canonicalSymlinkPath()
+//
+// Lookups only take a read lock, so they can run concurrently. The entries
+// remember when they were used last, and once the cache is full, the half of
+// them used least recently is dropped.
+class KNetworkMountsSymlinkCache
+{
+public:
+    explicit KNetworkMountsSymlinkCache(size_t maxSize = 4096)
+        : m_maxSize(std::max<size_t>(maxSize, 2))
+    {
+    }
+
+    // Returns the resolved path of @p path, or an empty string if it isn't cached
+    QString value(const QString &path) const
+    {
+        QReadLocker locker(&m_lock);
+        const auto it = m_entries.find(path);
+        if (it == m_entries.cend()) {
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return QString();
+        }
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        it->second.lastUsed.store(m_clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        return it->second.resolved;
+    }
+
+    void insert(const QString &path, const QString &resolved)
+    {
+        QWriteLocker locker(&m_lock);
+        auto it = m_entries.find(path);
+        if (it == m_entries.end()) {
+            if (m_entries.size() >= m_maxSize) {
+                evict();
+            }
+            it = m_entries.try_emplace(path).first;
+        }
+        it->second.resolved = resolved;
+        it->second.lastUsed.store(m_clock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+        QWriteLocker locker(&m_lock);
+        m_entries.clear();
+    }
+
+    size_t size() const
+    {
+        QReadLocker locker(&m_lock);
+        return m_entries.size();
+    }
+
+    // About the memory taken by the entries, see KMemoryFootprint
+    qint64 bytes() const
+    {
+        QReadLocker locker(&m_lock);
+        qint64 bytes = 0;
+        for (const auto &[path, entry] : m_entries) {
+            bytes += qint64(sizeof(path) + sizeof(entry)) + KMemoryFootprintPrivate::stringBytes(path) + KMemoryFootprintPrivate::stringBytes(entry.resolved);
+        }
+        return bytes;
+    }
+
+    quint64 hits() const
+    {
+        return m_hits.load(std::memory_order_relaxed);
+    }
+
+    quint64 misses() const
+    {
+        return m_misses.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Entry {
+        QString resolved;
+        mutable std::atomic<quint64> lastUsed{0};
+    };
+
+    // Drops the half of the entries used least recently, with m_lock locked for writing
+    void evict()
+    {
+        std::vector<quint64> lastUsed;
+        lastUsed.reserve(m_entries.size());
+        for (const auto &[path, entry] : m_entries) {
+            lastUsed.push_back(entry.lastUsed.load(std::memory_order_relaxed));
+        }
+        const auto median = lastUsed.begin() + lastUsed.size() / 2;
+        std::nth_element(lastUsed.begin(), median, lastUsed.end());
+        const quint64 threshold = *median;
+
+        for (auto it = m_entries.begin(); it != m_entries.end();) {
+            if (it->second.lastUsed.load(std::memory_order_relaxed) < threshold) {
+                it = m_entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    const size_t m_maxSize;
+    mutable QReadWriteLock m_lock;
+    std::unordered_map<QString, Entry> m_entries;
+    mutable std::atomic<quint64> m_clock = 0;
+    mutable std::atomic<quint64> m_hits = 0;
+    mutable std::atomic<quint64> m_misses = 0;
+};
+
+// Classifies mount points as slow by the latencies of the metadata operations
+// recorded for the paths on them, see KNetworkMounts::recordLatency()
+//
+// The latencies are averaged per mount point with an exponential moving average,
+// and a mount point needs a few of them before it is classified. To not flip
+// back and forth, it is only classified as fast again once the average fell well
+// below the threshold.
+class KNetworkMountsLatencyTracker
+{
+public:
+    // Returns whether the mount point of @p path was classified anew
+    bool record(const QString &path, std::chrono::microseconds latency, std::chrono::microseconds threshold);
+    // Classifies the mount point of @p path as slow at once, see record()
+    bool recordUnresponsive(const QString &path, std::chrono::microseconds threshold);
+
+    bool isSlow(const QString &path);
+
+    QStringList slowMountPoints() const;
+
+    // The mount points on the system, with trailing slashes
+    static QStringList systemMountPoints();
+
+private:
+    struct Mount {
+        double averageUsecs = 0;
+        int samples = 0;
+        bool slow = false;
+    };
+
+    // The mount point of @p path, with m_mutex locked
+    QString mountPoint(const QString &path);
+
+    mutable QMutex m_mutex;
+    // The longest mount points first, so that the matcher finds the innermost one
+    KNetworkMountsPrefixMatcher m_mountPoints;
+    std::chrono::steady_clock::time_point m_mountPointsRead;
+    QHash<QString, Mount> m_mounts;
+};
+
 class KNetworkMountsPrivate
 {
 public:
     KNetworkMountsPrivate(KNetworkMounts *);
 
+    // Builds the matchers from the settings, and publishes them for matcher().
+    // Also drops the resolved symlinks, as they depend on the paths.
+    void updateMatchers();
+
+    const KNetworkMountsPrefixMatcher &matcher(KNetworkMounts::KNetworkMountsType type) const
+    {
+        return m_matchers.loadAcquire()->byType[type];
+    }
+
+    // Reads the AdaptiveSlowPathDetection settings for recordLatency(), which
+    // may be called from any thread and so must not touch m_settings
+    void updateAdaptiveSettings();
+
+    // Publishes the mount points classified as slow for detectedMatcher()
+    void updateDetectedMatcher();
+
+    // Kept alive by the caller, as it may be replaced meanwhile
+    std::shared_ptr<const KNetworkMountsPrefixMatcher> detectedMatcher() const
+    {
+        return std::atomic_load_explicit(&m_detectedMatcher, std::memory_order_acquire);
+    }
+
     KNetworkMounts *q;
 
     QSettings *m_settings = nullptr;
 
+    KNetworkMountsSymlinkCache m_symlinkCache;
+
+    KNetworkMountsLatencyTracker m_latencyTracker;
+    std::atomic<bool> m_adaptive = false;
+    std::atomic<qint64> m_adaptiveThresholdUsecs = 0;
+
 private:
+    QAtomicPointer<const KNetworkMountsMatchers> m_matchers;
+    // Serializes updateMatchers(), and keeps all matchers ever published alive,
+    // as they might still be in use by other threads. They are only updated
+    // when the configuration changes, so there are hardly ever more than a few.
+    QMutex m_matchersMutex;
+    std::vector<std::unique_ptr<const KNetworkMountsMatchers>> m_allMatchers;
+    // Changes whenever a mount point is classified anew, which may be over and
+    // over for flapping mounts, so it is freed by the last thread using it
+    std::shared_ptr<const KNetworkMountsPrefixMatcher> m_detectedMatcher;
 };
 
 // Append trailing slashes to path string if missing
@@ -51,6 +51,31 @@ KProcess::OutputChannelMode KProcess::outputChannelMode() const
     return static_cast<OutputChannelMode>(QProcess::processChannelMode());
 }
 
+void KProcess::setStandardOutputSink(const std::function<void(const QByteArray &data)> &sink)
+{
+    Q_D(KProcess);
+
+    disconnect(d->sinkReadConnection);
+    disconnect(d->sinkFinishedConnection);
+    d->standardOutputSink = sink;
+    if (!sink) {
+        return;
+    }
+
+    // The chunks of QIODevice's buffer are handed out without copying them,
+    // if they are read whole
+    const auto passOn = [this]() {
+        Q_D(KProcess);
+        const QByteArray data = readAllStandardOutput();
+        if (!data.isEmpty()) {
+            d->standardOutputSink(data);
+        }
+    };
+    d->sinkReadConnection = connect(this, &QProcess::readyReadStandardOutput, this, passOn);
+    // Whatever is left when the process exits
+    d->sinkFinishedConnection = connect(this, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, passOn);
+}
+
 void KProcess::setNextOpenMode(QIODevice::OpenMode mode)
 {
     Q_D(KProcess);
@@ -13,6 +13,7 @@
 
 #include <QProcess>
 
+#include <functional>
 #include <memory>
 
 class KProcessPrivate;
@@ -28,6 +29,11 @@ class KProcessPrivate;
  * Only use KProcess if you need the extra features, otherwise QProcess
  * is the preferred way of spawning child processes.
  *
+ * KProcess doesn't set a child process modifier on QProcess, so on Linux the
+ * child is started with vfork() semantics and tracked through a pidfd where
+ * available, instead of copying the parent's page tables. Setting one, e.g.
+ * through QProcess::setChildProcessModifier(), loses that.
+ *
  * @author Oswald Buddenhagen <ossi@kde.org>
  **/
 class KCOREADDONS_EXPORT KProcess : public QProcess
@@ -85,6 +91,27 @@ public:
      */
     OutputChannelMode outputChannelMode() const;
 
+    /**
+     * Passes the standard output of the child process to @p sink as it arrives,
+     * instead of collecting it in the process.
+     *
+     * @p sink is called with every chunk read, so processes writing a lot
+     * of output don't make the whole of it pile up in memory. With
+     * MergedChannels, the standard error is part of the standard output.
+     * Pass an empty function to stop passing the output on.
+     *
+     * To write the output to a file, use QProcess::setStandardOutputFile()
+     * instead, the child process then writes to the file directly.
+     *
+     * This function must be called before starting the process, and
+     * before connecting to QProcess::finished() for the sink to get all
+     * output before.
+     *
+     * @param sink the function to pass the output to
+     * @since 6.0
+     */
+    void setStandardOutputSink(const std::function<void(const QByteArray &data)> &sink);
+
     /**
      * Set the QIODevice open mode the process will be opened in.
      *
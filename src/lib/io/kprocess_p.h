@@ -23,6 +23,11 @@ protected:
 
     QIODevice::OpenMode openMode;
 
+    // See setStandardOutputSink()
+    std::function<void(const QByteArray &)> standardOutputSink;
+    QMetaObject::Connection sinkReadConnection;
+    QMetaObject::Connection sinkFinishedConnection;
+
     KProcess *q_ptr;
 };
 
@@ -0,0 +1,235 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kprocesspool.h"
+#include "kcoreaddons_debug.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QList>
+#include <QTimer>
+
+#include <stdlib.h>
+
+// Set in the environment of pooled instances, so receiveTask() knows to wait for a task
+static const char s_workerVariable[] = "KPROCESSPOOL_WORKER";
+// Starts the task on the standard input, also guards against unrelated input
+static const quint32 s_taskMagic = 0x4b505031; // "KPP1"
+
+// How long to wait before replacing an instance that exited without a task,
+// so a broken helper isn't restarted over and over
+static const int s_respawnDelay = 1000;
+
+class KProcessPoolPrivate
+{
+public:
+    KProcessPoolPrivate(KProcessPool *qq)
+        : q(qq)
+    {
+        refillTimer.setSingleShot(true);
+    }
+
+    KProcess *startInstance();
+    void refill();
+    void scheduleRefill(int delay);
+    void dropIdle(KProcess *process);
+    void trimIdle(int count);
+
+    KProcessPool *const q;
+    QString program;
+    QStringList arguments;
+    int size = 1;
+    KProcess::OutputChannelMode outputChannelMode = KProcess::ForwardedChannels;
+    QList<KProcess *> idle;
+    QTimer refillTimer;
+};
+
+KProcess *KProcessPoolPrivate::startInstance()
+{
+    auto *process = new KProcess;
+    process->setOutputChannelMode(outputChannelMode);
+    process->setProgram(program, arguments);
+    process->setEnv(QLatin1String(s_workerVariable), QStringLiteral("1"));
+    process->start();
+    return process;
+}
+
+void KProcessPoolPrivate::refill()
+{
+    while (idle.size() < size) {
+        KProcess *process = startInstance();
+        process->setParent(q);
+        // Without a task, an instance exiting failed to start or to initialize
+        QObject::connect(process, &QProcess::finished, q, [this, process]() {
+            dropIdle(process);
+        });
+        QObject::connect(process, &QProcess::errorOccurred, q, [this, process](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                qCWarning(KCOREADDONS_DEBUG) << "KProcessPool: failed to start" << program << process->errorString();
+                dropIdle(process);
+            }
+        });
+        idle.append(process);
+    }
+}
+
+void KProcessPoolPrivate::scheduleRefill(int delay)
+{
+    if (!refillTimer.isActive() || refillTimer.remainingTime() > delay) {
+        refillTimer.start(delay);
+    }
+}
+
+void KProcessPoolPrivate::dropIdle(KProcess *process)
+{
+    if (!idle.removeOne(process)) {
+        return;
+    }
+    process->disconnect(q);
+    process->deleteLater();
+    scheduleRefill(s_respawnDelay);
+}
+
+// Ends the instances waiting for a task beyond @p count
+void KProcessPoolPrivate::trimIdle(int count)
+{
+    while (idle.size() > count) {
+        KProcess *process = idle.takeLast();
+        process->disconnect(q);
+        // A helper waiting for its task sees the end of its input and exits,
+        // it is deleted then or killed along with the pool
+        process->closeWriteChannel();
+        QObject::connect(process, &QProcess::finished, process, &QObject::deleteLater);
+    }
+}
+
+KProcessPool::KProcessPool(const QString &program, const QStringList &arguments, QObject *parent)
+    : QObject(parent)
+    , d(new KProcessPoolPrivate(this))
+{
+    d->program = program;
+    d->arguments = arguments;
+    connect(&d->refillTimer, &QTimer::timeout, this, [this]() {
+        d->refill();
+    });
+    d->scheduleRefill(0);
+}
+
+KProcessPool::~KProcessPool()
+{
+    d->refillTimer.stop();
+    for (KProcess *process : std::as_const(d->idle)) {
+        process->disconnect(this);
+        // A helper waiting for its task sees the end of its input
+        process->closeWriteChannel();
+    }
+    for (KProcess *process : std::as_const(d->idle)) {
+        if (!process->waitForFinished(100)) {
+            process->kill();
+            process->waitForFinished(-1);
+        }
+        delete process;
+    }
+}
+
+void KProcessPool::setSize(int size)
+{
+    d->size = qMax(0, size);
+    d->trimIdle(d->size);
+    d->scheduleRefill(0);
+}
+
+int KProcessPool::size() const
+{
+    return d->size;
+}
+
+int KProcessPool::idleCount() const
+{
+    return d->idle.size();
+}
+
+void KProcessPool::setOutputChannelMode(KProcess::OutputChannelMode mode)
+{
+    if (mode == d->outputChannelMode) {
+        return;
+    }
+    d->outputChannelMode = mode;
+    d->trimIdle(0);
+    d->scheduleRefill(0);
+}
+
+KProcess::OutputChannelMode KProcessPool::outputChannelMode() const
+{
+    return d->outputChannelMode;
+}
+
+KProcess *KProcessPool::start(const QStringList &arguments, const QProcessEnvironment &environment)
+{
+    KProcess *process = nullptr;
+    while (!d->idle.isEmpty()) {
+        KProcess *candidate = d->idle.takeFirst();
+        candidate->disconnect(this);
+        if (candidate->state() != QProcess::NotRunning) {
+            candidate->setParent(nullptr);
+            process = candidate;
+            break;
+        }
+        // Exited in the meantime, its signal is still pending
+        candidate->deleteLater();
+    }
+    if (!process) {
+        process = d->startInstance();
+    }
+
+    QByteArray task;
+    QDataStream stream(&task, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_5);
+    stream << s_taskMagic << arguments << environment.toStringList();
+    process->write(task);
+
+    // Outside of start(), so handing out a task doesn't wait for the next instance
+    d->scheduleRefill(0);
+    return process;
+}
+
+// static
+bool KProcessPool::receiveTask(QStringList *arguments)
+{
+    if (qEnvironmentVariableIsEmpty(s_workerVariable)) {
+        return false;
+    }
+    // Not passed on to the processes of the helper
+    qunsetenv(s_workerVariable);
+
+    // By descriptor and unbuffered, to read exactly the task and leave what
+    // follows to the helper, which stdio would read ahead otherwise
+    QFile input;
+    if (!input.open(0, QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::DontCloseHandle)) {
+        return false;
+    }
+    QDataStream stream(&input);
+    stream.setVersion(QDataStream::Qt_6_5);
+    quint32 magic = 0;
+    QStringList taskArguments;
+    QStringList environment;
+    stream >> magic >> taskArguments >> environment;
+    if (stream.status() != QDataStream::Ok || magic != s_taskMagic) {
+        // The pool ended the instance before handing out a task
+        exit(0);
+    }
+
+    arguments->append(taskArguments);
+    for (const QString &variable : std::as_const(environment)) {
+        const qsizetype separator = variable.indexOf(QLatin1Char('='));
+        if (separator > 0) {
+            qputenv(variable.left(separator).toLocal8Bit().constData(), variable.mid(separator + 1).toLocal8Bit());
+        }
+    }
+    return true;
+}
+
+#include "moc_kprocesspool.cpp"
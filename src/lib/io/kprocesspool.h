@@ -0,0 +1,134 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPROCESSPOOL_H
+#define KPROCESSPOOL_H
+
+#include <kcoreaddons_export.h>
+#include <kprocess.h>
+
+#include <QObject>
+#include <QProcessEnvironment>
+#include <QStringList>
+
+#include <memory>
+
+class KProcessPoolPrivate;
+
+/**
+ * \class KProcessPool kprocesspool.h <KProcessPool>
+ *
+ * Keeps instances of a helper program started ahead of time, so that the
+ * cost of starting it, i.e. creating the process, loading and linking the
+ * program and initializing it, is not paid when a task is handed to it.
+ *
+ * The helper has to cooperate: a pooled instance is started with the fixed
+ * arguments of the pool and waits for its task, i.e. the arguments and
+ * environment of the invocation, to arrive on its standard input. Helpers
+ * fetch their task with receiveTask() before doing anything specific to it:
+ * \code
+ * int main(int argc, char **argv)
+ * {
+ *     QCoreApplication app(argc, argv);
+ *     // initialize, load plugins, ...
+ *     QStringList arguments = app.arguments().mid(1);
+ *     KProcessPool::receiveTask(&arguments);
+ *     // do the task
+ * }
+ * \endcode
+ * Outside of a pool receiveTask() returns immediately, so the helper also
+ * works when started directly.
+ *
+ * Every instance handles a single task and exits, the pool starts another
+ * one in its place in the background:
+ * \code
+ * KProcessPool pool(QStringLiteral("my-thumbnailer"));
+ * pool.setSize(4);
+ * ...
+ * KProcess *process = pool.start({path, QStringLiteral("--size=256")});
+ * connect(process, &QProcess::finished, process, &QObject::deleteLater);
+ * \endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KProcessPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Creates a pool of instances of @p program, each started with @p arguments,
+     * before the ones of the task.
+     */
+    explicit KProcessPool(const QString &program, const QStringList &arguments = QStringList(), QObject *parent = nullptr);
+
+    /**
+     * Ends the instances that are waiting for a task. The ones handed out
+     * by start() are not affected.
+     */
+    ~KProcessPool() override;
+
+    /**
+     * Sets the number of instances waiting for a task, 1 by default.
+     * 0 starts every instance on demand only, like a plain KProcess.
+     */
+    void setSize(int size);
+
+    /**
+     * @return the number of instances waiting for a task
+     * @see setSize()
+     */
+    int size() const;
+
+    /**
+     * @return the number of instances that are started and waiting for a task,
+     * at most size()
+     */
+    int idleCount() const;
+
+    /**
+     * Sets how the output channels of the instances are handled, which is
+     * KProcess::ForwardedChannels by default like for KProcess.
+     * Instances waiting for a task are replaced with ones using @p mode.
+     */
+    void setOutputChannelMode(KProcess::OutputChannelMode mode);
+
+    /**
+     * @return how the output channels of the instances are handled
+     */
+    KProcess::OutputChannelMode outputChannelMode() const;
+
+    /**
+     * Hands a task to an instance waiting for one, or to a newly started
+     * instance if none is waiting.
+     *
+     * @param arguments the arguments of the task, passed to the instance
+     *   after the ones of the pool
+     * @param environment variables added to the environment of the instance
+     * @return the running process, which is owned by the caller. Input written
+     *   to it reaches the helper after its task, once it called receiveTask().
+     */
+    KProcess *start(const QStringList &arguments, const QProcessEnvironment &environment = QProcessEnvironment());
+
+    /**
+     * Called by the helper program to receive its task when started by a pool.
+     * Blocks until the task arrives on the standard input, then appends its
+     * arguments to @p arguments and adds its variables to the environment of
+     * the process.
+     *
+     * If the pool ends the instance before handing out a task, this exits
+     * the process.
+     *
+     * @return @c true if the process was started by a pool, @c false if it was
+     *   started directly, @p arguments are left as they are then
+     */
+    static bool receiveTask(QStringList *arguments);
+
+private:
+    std::unique_ptr<KProcessPoolPrivate> const d;
+};
+
+#endif
@@ -17,15 +17,25 @@
 #include <unistd.h>
 #endif
 
+#include <atomic>
 #include <optional>
 
+#include <QCoreApplication>
+#include <QHash>
 #include <QMimeData>
+#include <QPointer>
 #include <QStringList>
+#include <QThread>
 
 #include "kcoreaddons_debug.h"
 #if HAVE_QTDBUS
 #include "org.freedesktop.portal.FileTransfer.h"
 #include "org.kde.KIOFuse.VFS.h"
+
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
 #endif
 
 static QString kdeUriListMime()
@@ -36,9 +46,19 @@ static QString kdeUriListMime()
 static QByteArray uriListData(const QList<QUrl> &urls)
 {
     // compatible with qmimedata.cpp encoding of QUrls
+    QByteArrayList encodedUrls;
+    encodedUrls.reserve(urls.size());
+    qsizetype size = 0;
+    for (const QUrl &url : urls) {
+        encodedUrls.append(url.toEncoded());
+        size += encodedUrls.constLast().size() + 2;
+    }
+
+    // Encoding everything first allows writing the list without growing it
     QByteArray result;
-    for (int i = 0; i < urls.size(); ++i) {
-        result += urls.at(i).toEncoded();
+    result.reserve(size);
+    for (const QByteArray &encodedUrl : std::as_const(encodedUrls)) {
+        result += encodedUrl;
         result += "\r\n";
     }
     return result;
@@ -74,14 +94,19 @@ static QList<QUrl> extractKdeUriList(const QMimeData *mimeData)
 {
     QList<QUrl> uris;
     const QByteArray ba = mimeData->data(kdeUriListMime());
-    // Code from qmimedata.cpp
-    QList<QByteArray> urls = ba.split('\n');
-    uris.reserve(urls.size());
-    for (int i = 0; i < urls.size(); ++i) {
-        QByteArray data = urls.at(i).trimmed();
-        if (!data.isEmpty()) {
-            uris.append(QUrl::fromEncoded(data));
+    // Like qmimedata.cpp, but looks at the lines in place instead of splitting them up
+    uris.reserve(ba.count('\n') + 1);
+    qsizetype start = 0;
+    while (start < ba.size()) {
+        qsizetype end = ba.indexOf('\n', start);
+        if (end < 0) {
+            end = ba.size();
+        }
+        const QByteArrayView line = QByteArrayView(ba).sliced(start, end - start).trimmed();
+        if (!line.isEmpty()) {
+            uris.append(QUrl::fromEncoded(QByteArray::fromRawData(line.data(), line.size())));
         }
+        start = end + 1;
     }
     return uris;
 }
@@ -97,18 +122,140 @@ static QString portalServiceName()
     return QStringLiteral("org.freedesktop.portal.Documents");
 }
 
+namespace
+{
+/**
+ * Keeps track of whether KIOFuse and the documents portal can be reached on the session bus.
+ *
+ * The bus is only ever asked asynchronously, so that drag and drop doesn't wait for a round-trip
+ * in the middle of the operation. GUI applications start the probe while they start up, by the time
+ * anything gets dragged the answer has long arrived. Until then the services count as unavailable.
+ * A service that appears on the bus counts as available right away, one that disappears is probed again.
+ */
+class KUrlMimeDataServiceProbe
+{
+public:
+    enum State {
+        Unknown,
+        Available,
+        Unavailable,
+    };
+
+    static KUrlMimeDataServiceProbe &instance()
+    {
+        static KUrlMimeDataServiceProbe probe;
+        return probe;
+    }
+
+    bool isKIOFuseAvailable()
+    {
+        ensureProbed();
+        return m_kioFuse.load(std::memory_order_relaxed) == Available;
+    }
+
+    bool isDocumentsPortalAvailable()
+    {
+        ensureProbed();
+        return m_portal.load(std::memory_order_relaxed) == Available;
+    }
+
+    void ensureProbed()
+    {
+        if (m_probed.exchange(true)) {
+            return;
+        }
+        QCoreApplication *app = QCoreApplication::instance();
+        if (!app) {
+            m_probed = false;
+            return;
+        }
+        // The replies and the service watcher need to live in a thread with an event loop
+        if (app->thread() == QThread::currentThread()) {
+            probe();
+        } else {
+            QMetaObject::invokeMethod(app, [this]() {
+                probe();
+            });
+        }
+    }
+
+private:
+    std::atomic<State> &stateOf(const QString &serviceName)
+    {
+        return serviceName == kioFuseServiceName() ? m_kioFuse : m_portal;
+    }
+
+    void probe()
+    {
+        QCoreApplication *app = QCoreApplication::instance();
+        QDBusConnection bus = QDBusConnection::sessionBus();
+        if (!bus.isConnected()) {
+            m_kioFuse = Unavailable;
+            m_portal = Unavailable;
+            return;
+        }
+
+        if (!m_serviceWatcher) {
+            m_serviceWatcher = new QDBusServiceWatcher({kioFuseServiceName(), portalServiceName()}, bus, QDBusServiceWatcher::WatchForOwnerChange, app);
+            QObject::connect(m_serviceWatcher, &QDBusServiceWatcher::serviceRegistered, app, [this](const QString &serviceName) {
+                stateOf(serviceName) = Available;
+            });
+            QObject::connect(m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered, app, [this](const QString &serviceName) {
+                // It may still be activatable
+                stateOf(serviceName) = Unknown;
+                probe();
+            });
+        }
+
+        const QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                                    QStringLiteral("/org/freedesktop/DBus"),
+                                                                    QStringLiteral("org.freedesktop.DBus"),
+                                                                    QStringLiteral("ListActivatableNames"));
+        auto *watcher = new QDBusPendingCallWatcher(bus.asyncCall(message), app);
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished, app, [this](QDBusPendingCallWatcher *watcher) {
+            watcher->deleteLater();
+            const QDBusPendingReply<QStringList> reply = *watcher;
+            if (reply.isError()) {
+                qCDebug(KCOREADDONS_DEBUG) << "Could not list the activatable D-Bus services" << reply.error();
+            }
+            const QStringList names = reply.isError() ? QStringList() : reply.value();
+            for (const QString &serviceName : {kioFuseServiceName(), portalServiceName()}) {
+                if (names.contains(serviceName)) {
+                    stateOf(serviceName) = Available;
+                } else {
+                    // Don't override a service that registered while we were waiting
+                    State expected = Unknown;
+                    stateOf(serviceName).compare_exchange_strong(expected, Unavailable);
+                }
+            }
+        });
+    }
+
+    std::atomic<bool> m_probed = false;
+    std::atomic<State> m_kioFuse = Unknown;
+    std::atomic<State> m_portal = Unknown;
+    QPointer<QDBusServiceWatcher> m_serviceWatcher;
+};
+
+void startServiceProbe()
+{
+    // Only GUI applications drag and drop
+    if (QCoreApplication::instance()->inherits("QGuiApplication")) {
+        KUrlMimeDataServiceProbe::instance().ensureProbed();
+    }
+}
+}
+
+Q_COREAPP_STARTUP_FUNCTION(startServiceProbe)
+
 static bool isKIOFuseAvailable()
 {
-    static bool available = QDBusConnection::sessionBus().interface()
-        && QDBusConnection::sessionBus().interface()->activatableServiceNames().value().contains(kioFuseServiceName());
-    return available;
+    return KUrlMimeDataServiceProbe::instance().isKIOFuseAvailable();
 }
 
 static bool isDocumentsPortalAvailable()
 {
-    static bool available =
-        QDBusConnection::sessionBus().interface() && QDBusConnection::sessionBus().interface()->activatableServiceNames().value().contains(portalServiceName());
-    return available;
+    return KUrlMimeDataServiceProbe::instance().isDocumentsPortalAvailable();
 }
 
 static QString portalFormat()
@@ -199,7 +346,7 @@ static QStringList urlListToStringList(const QList<QUrl> urls)
     return list;
 }
 
-static std::optional<QStringList> fuseRedirect(QList<QUrl> urls, bool onlyLocalFiles)
+static std::optional<QStringList> fuseRedirect(const QList<QUrl> &urls, bool onlyLocalFiles)
 {
     qCDebug(KCOREADDONS_DEBUG) << "mounting urls with fuse" << urls;
 
@@ -209,40 +356,58 @@ static std::optional<QStringList> fuseRedirect(QList<QUrl> urls, bool onlyLocalF
     }
 
     OrgKdeKIOFuseVFSInterface kiofuse_iface(kioFuseServiceName(), QStringLiteral("/org/kde/KIOFuse"), QDBusConnection::sessionBus());
-    struct MountRequest {
-        QDBusPendingReply<QString> reply;
-        int urlIndex;
-        QString basename;
+    struct RedirectedUrl {
+        qsizetype mountIndex; // -1 for local files
+        QString path; // the local path, or the path within the mount
     };
-    QList<MountRequest> requests;
-    requests.reserve(urls.count());
-    for (int i = 0; i < urls.count(); ++i) {
-        QUrl url = urls.at(i);
-        if (!url.isLocalFile()) {
-            const QString path(url.path());
-            const int slashes = path.count(QLatin1Char('/'));
-            QString basename;
-            if (slashes > 1) {
-                url.setPath(path.section(QLatin1Char('/'), 0, slashes - 1));
-                basename = path.section(QLatin1Char('/'), slashes, slashes);
-            }
-            requests.push_back({kiofuse_iface.mountUrl(url.toString()), i, basename});
+    // All mount requests are sent before waiting for any reply, and the files of a
+    // directory share one mount, so that dropping many remote files doesn't pay the
+    // D-Bus round-trip for each of them
+    QList<QDBusPendingReply<QString>> mounts;
+    QHash<QUrl, qsizetype> mountIndexOfUrl;
+    QList<RedirectedUrl> redirectedUrls;
+    redirectedUrls.reserve(urls.count());
+    for (QUrl url : urls) {
+        if (url.isLocalFile()) {
+            redirectedUrls.push_back({-1, url.toLocalFile()});
+            continue;
+        }
+        const QString path(url.path());
+        const int slashes = path.count(QLatin1Char('/'));
+        QString basename;
+        if (slashes > 1) {
+            url.setPath(path.section(QLatin1Char('/'), 0, slashes - 1));
+            basename = path.section(QLatin1Char('/'), slashes, slashes);
         }
+        auto it = mountIndexOfUrl.constFind(url);
+        if (it == mountIndexOfUrl.cend()) {
+            it = mountIndexOfUrl.insert(url, mounts.size());
+            mounts.push_back(kiofuse_iface.mountUrl(url.toString()));
+        }
+        redirectedUrls.push_back({it.value(), basename});
     }
 
-    for (auto &request : requests) {
-        request.reply.waitForFinished();
-        if (request.reply.isError()) {
-            qWarning() << "FUSE request failed:" << request.reply.error();
+    for (auto &mount : mounts) {
+        mount.waitForFinished();
+        if (mount.isError()) {
+            qWarning() << "FUSE request failed:" << mount.error();
             return std::nullopt;
         }
+    }
 
-        urls[request.urlIndex] = QUrl::fromLocalFile(request.reply.value() + QLatin1Char('/') + request.basename);
-    };
+    QStringList paths;
+    paths.reserve(redirectedUrls.size());
+    for (const RedirectedUrl &redirectedUrl : std::as_const(redirectedUrls)) {
+        if (redirectedUrl.mountIndex < 0) {
+            paths << redirectedUrl.path;
+        } else {
+            paths << mounts.at(redirectedUrl.mountIndex).value() + QLatin1Char('/') + redirectedUrl.path;
+        }
+    }
 
-    qCDebug(KCOREADDONS_DEBUG) << "mounted urls with fuse, maybe" << urls;
+    qCDebug(KCOREADDONS_DEBUG) << "mounted urls with fuse, maybe" << paths;
 
-    return urlListToStringList(urls);
+    return paths;
 }
 #endif
 
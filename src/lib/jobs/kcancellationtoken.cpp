@@ -0,0 +1,38 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kcancellationtoken.h"
+#include "kcancellationtoken_p.h"
+
+KCancellationToken::KCancellationToken()
+    : d(std::make_shared<KCancellationTokenPrivate>())
+{
+}
+
+KCancellationToken::~KCancellationToken() = default;
+
+KCancellationToken::KCancellationToken(const KCancellationToken &other) = default;
+
+KCancellationToken &KCancellationToken::operator=(const KCancellationToken &other) = default;
+
+void KCancellationToken::cancel()
+{
+    if (!d->isCanceled.exchange(true)) {
+        Q_EMIT d->canceled();
+    }
+}
+
+bool KCancellationToken::isCanceled() const
+{
+    return d->isCanceled;
+}
+
+bool KCancellationToken::operator==(const KCancellationToken &other) const
+{
+    return d == other.d;
+}
+
+#include "moc_kcancellationtoken_p.cpp"
@@ -0,0 +1,80 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCANCELLATIONTOKEN_H
+#define KCANCELLATIONTOKEN_H
+
+#include <kcoreaddons_export.h>
+
+#include <memory>
+
+class KCancellationTokenPrivate;
+
+/**
+ * @class KCancellationToken kcancellationtoken.h KCancellationToken
+ *
+ * A token for canceling a group of jobs at once, e.g. all prefetch jobs of a view
+ * that was closed.
+ *
+ * Copies of a token share its state. Once cancel() was called on any of them, the jobs
+ * set up with KJob::setCancellationToken() are killed with KJob::EmitResult, in their threads.
+ * Canceling only flips a flag, so jobs which did not start yet don't do any work: KJobScheduler
+ * doesn't start them and KThreadedJob doesn't run their work function.
+ *
+ * @code
+ * KCancellationToken prefetching;
+ * for (const QUrl &url : visibleUrls) {
+ *     auto job = new PreviewJob(url);
+ *     job->setCancellationToken(prefetching);
+ *     scheduler->addJob(job);
+ * }
+ * ...
+ * // The view changed
+ * prefetching.cancel();
+ * @endcode
+ *
+ * All methods are thread-safe.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KCancellationToken
+{
+public:
+    /**
+     * Creates a new token, which was not canceled.
+     */
+    KCancellationToken();
+    ~KCancellationToken();
+    KCancellationToken(const KCancellationToken &other);
+    KCancellationToken &operator=(const KCancellationToken &other);
+
+    /**
+     * Cancels the jobs using this token. Canceling a token more than once does nothing.
+     */
+    void cancel();
+
+    /**
+     * @return whether cancel() was called on this token or one of its copies
+     */
+    bool isCanceled() const;
+
+    /**
+     * @return whether both tokens are copies of the same token
+     */
+    bool operator==(const KCancellationToken &other) const;
+    bool operator!=(const KCancellationToken &other) const
+    {
+        return !operator==(other);
+    }
+
+private:
+    friend class KJob;
+    friend class KJobScheduler;
+    friend class KThreadedJob;
+    std::shared_ptr<KCancellationTokenPrivate> d;
+};
+
+#endif
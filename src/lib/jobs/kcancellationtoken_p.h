@@ -0,0 +1,29 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KCANCELLATIONTOKEN_P_H
+#define KCANCELLATIONTOKEN_P_H
+
+#include "kcancellationtoken.h"
+
+#include <QObject>
+
+#include <atomic>
+
+// Shared by the copies of a token and the jobs using it
+class KCancellationTokenPrivate : public QObject
+{
+    Q_OBJECT
+
+public:
+    std::atomic<bool> isCanceled = false;
+
+Q_SIGNALS:
+    // The jobs using the token are connected to this, so that they are killed in their threads
+    void canceled();
+};
+
+#endif
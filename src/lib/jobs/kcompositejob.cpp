@@ -9,6 +9,8 @@
 #include "kcompositejob.h"
 #include "kcompositejob_p.h"
 
+#include <algorithm>
+
 KCompositeJobPrivate::KCompositeJobPrivate()
 {
 }
@@ -34,11 +36,16 @@ KCompositeJob::~KCompositeJob()
 bool KCompositeJob::addSubjob(KJob *job)
 {
     Q_D(KCompositeJob);
-    if (job == nullptr || d->subjobs.contains(job)) {
+    if (job == nullptr || d->subjobIndex.contains(job)) {
         return false;
     }
 
     job->setParent(this);
+    if (d->cancellationToken && !job->cancellationToken()) {
+        job->setCancellationToken(*d->cancellationToken);
+    }
+    d->subjobIndex.insert(job, d->nextSubjobSequence);
+    d->subjobSequences.append(d->nextSubjobSequence++);
     d->subjobs.append(job);
     connect(job, &KJob::result, this, &KCompositeJob::slotResult);
 
@@ -52,18 +59,29 @@ bool KCompositeJob::removeSubjob(KJob *job)
 {
     Q_D(KCompositeJob);
     // remove only Subjobs that are on the list
-    if (d->subjobs.removeAll(job) > 0) {
-        job->setParent(nullptr);
-        disconnect(job, &KJob::result, this, &KCompositeJob::slotResult);
-        disconnect(job, &KJob::infoMessage, this, &KCompositeJob::slotInfoMessage);
-        return true;
+    const auto it = d->subjobIndex.constFind(job);
+    if (it == d->subjobIndex.cend()) {
+        return false;
     }
-    return false;
+
+    // Jobs usually finish in about the order they were added, and removing
+    // from either end of a QList doesn't move the other elements
+    const auto sequence = std::lower_bound(d->subjobSequences.cbegin(), d->subjobSequences.cend(), it.value());
+    const qsizetype position = sequence - d->subjobSequences.cbegin();
+    Q_ASSERT(d->subjobs.at(position) == job);
+    d->subjobs.removeAt(position);
+    d->subjobSequences.removeAt(position);
+    d->subjobIndex.erase(it);
+
+    job->setParent(nullptr);
+    disconnect(job, &KJob::result, this, &KCompositeJob::slotResult);
+    disconnect(job, &KJob::infoMessage, this, &KCompositeJob::slotInfoMessage);
+    return true;
 }
 
 bool KCompositeJob::hasSubjobs() const
 {
-    return !d_func()->subjobs.isEmpty();
+    return !d_func()->subjobIndex.isEmpty();
 }
 
 const QList<KJob *> &KCompositeJob::subjobs() const
@@ -80,6 +98,8 @@ void KCompositeJob::clearSubjobs()
         disconnect(job, &KJob::infoMessage, this, &KCompositeJob::slotInfoMessage);
     }
     d->subjobs.clear();
+    d->subjobSequences.clear();
+    d->subjobIndex.clear();
 }
 
 void KCompositeJob::slotResult(KJob *job)
@@ -46,6 +46,9 @@ protected:
      *
      * Note that the composite job takes ownership of @p job
      *
+     * If @p job has no cancellation token, it gets the one of this job,
+     * see KJob::setCancellationToken().
+     *
      * @param job the subjob to add
      * @return true if the job has been added correctly, false otherwise
      */
@@ -13,6 +13,8 @@
 
 #include "kjob_p.h"
 
+#include <QHash>
+
 // This is a private class, but it's exported for
 // KIO::Job's usage. Other Job classes in kdelibs may
 // use it too.
@@ -22,7 +24,13 @@ public:
     KCompositeJobPrivate();
     ~KCompositeJobPrivate() override;
 
+    // The subjobs in insertion order, without any gaps, as KIO uses it as well
     QList<KJob *> subjobs;
+    // The sequence numbers of the subjobs, ascending in the order of subjobs,
+    // so that the position of a job is found by a binary search
+    QList<qsizetype> subjobSequences;
+    QHash<KJob *, qsizetype> subjobIndex;
+    qsizetype nextSubjobSequence = 0;
 
     Q_DECLARE_PUBLIC(KCompositeJob)
 };
@@ -11,10 +11,12 @@
 #include "kjob.h"
 #include "kjob_p.h"
 
+#include "kcancellationtoken_p.h"
 #include "kcoreaddons_debug.h"
 #include "kjobuidelegate.h"
 
 #include <QEventLoop>
+#include <QMetaMethod>
 #include <QTimer>
 
 KJobPrivate::KJobPrivate()
@@ -91,6 +93,12 @@ void KJob::finishJob(bool emitResult)
         d->eventLoop->quit();
     }
 
+    // The final progress comes before the job is done
+    if (d->progressTimer) {
+        d->progressTimer->stop();
+    }
+    d->emitPendingProgress();
+
     // If we are displaying a progress dialog, remove it first.
     Q_EMIT finished(this, QPrivateSignal());
 
@@ -276,11 +284,21 @@ void KJob::setProcessedAmount(Unit unit, qulonglong amount)
     processed = amount;
 
     if (should_emit) {
-        Q_EMIT processedAmountChanged(this, unit, amount, QPrivateSignal{});
+        const bool throttled = d->isProgressThrottled();
+        if (throttled) {
+            d->pendingProcessedAmounts.set(unit);
+        } else {
+            Q_EMIT processedAmountChanged(this, unit, amount, QPrivateSignal{});
+        }
         if (unit == d->progressUnit) {
-            Q_EMIT processedSize(this, amount);
+            if (!throttled) {
+                Q_EMIT processedSize(this, amount);
+            }
             emitPercent(processed, total);
         }
+        if (!throttled) {
+            d->throttleProgress();
+        }
     }
 }
 
@@ -319,7 +337,12 @@ void KJob::setPercent(unsigned long percentage)
     Q_D(KJob);
     if (d->percentage != percentage) {
         d->percentage = percentage;
-        Q_EMIT percentChanged(this, percentage, QPrivateSignal{});
+        if (d->isProgressThrottled()) {
+            d->pendingPercent = true;
+        } else {
+            Q_EMIT percentChanged(this, percentage, QPrivateSignal{});
+            d->throttleProgress();
+        }
     }
 }
 
@@ -340,6 +363,11 @@ void KJob::emitPercent(qulonglong processedAmount, qulonglong totalAmount)
 void KJob::emitSpeed(unsigned long value)
 {
     Q_D(KJob);
+    // Without a tracker, neither the signal nor the timer resetting it are of use
+    static const QMetaMethod speedSignal = QMetaMethod::fromSignal(&KJob::speed);
+    if (!d->speedTimer && !isSignalConnected(speedSignal)) {
+        return;
+    }
     if (!d->speedTimer) {
         d->speedTimer = new QTimer(this);
         connect(d->speedTimer, &QTimer::timeout, this, [d]() {
@@ -351,6 +379,53 @@ void KJob::emitSpeed(unsigned long value)
     d->speedTimer->start(5000); // 5 seconds interval should be enough
 }
 
+bool KJobPrivate::isProgressThrottled() const
+{
+    return progressTimer && progressTimer->isActive();
+}
+
+void KJobPrivate::throttleProgress()
+{
+    Q_Q(KJob);
+    if (progressEmissionInterval <= 0) {
+        return;
+    }
+    if (!progressTimer) {
+        progressTimer = new QTimer(q);
+        progressTimer->setSingleShot(true);
+        QObject::connect(progressTimer, &QTimer::timeout, q, [this]() {
+            const bool emitted = pendingProcessedAmounts.any() || pendingPercent;
+            emitPendingProgress();
+            // Changes right after these are delayed as well
+            if (emitted && !isFinished) {
+                throttleProgress();
+            }
+        });
+    }
+    if (!progressTimer->isActive()) {
+        progressTimer->start(progressEmissionInterval);
+    }
+}
+
+void KJobPrivate::emitPendingProgress()
+{
+    Q_Q(KJob);
+    for (int unit = 0; unit < KJob::UnitsCount; ++unit) {
+        if (pendingProcessedAmounts.test(unit)) {
+            const qulonglong amount = m_jobAmounts[unit].processedAmount;
+            Q_EMIT q->processedAmountChanged(q, KJob::Unit(unit), amount, KJob::QPrivateSignal{});
+            if (unit == progressUnit) {
+                Q_EMIT q->processedSize(q, amount);
+            }
+        }
+    }
+    pendingProcessedAmounts.reset();
+    if (pendingPercent) {
+        pendingPercent = false;
+        Q_EMIT q->percentChanged(q, percentage, KJob::QPrivateSignal{});
+    }
+}
+
 void KJobPrivate::speedTimeout()
 {
     Q_Q(KJob);
@@ -360,6 +435,65 @@ void KJobPrivate::speedTimeout()
     speedTimer->stop();
 }
 
+void KJob::setProgressEmissionInterval(int msecs)
+{
+    Q_D(KJob);
+    d->progressEmissionInterval = qMax(0, msecs);
+    if (d->progressEmissionInterval == 0 && d->progressTimer) {
+        d->progressTimer->stop();
+        d->emitPendingProgress();
+    }
+}
+
+int KJob::progressEmissionInterval() const
+{
+    Q_D(const KJob);
+    return d->progressEmissionInterval;
+}
+
+void KJob::setPriority(int priority)
+{
+    Q_D(KJob);
+    if (d->priority != priority) {
+        d->priority = priority;
+        Q_EMIT priorityChanged(this, priority, QPrivateSignal());
+    }
+}
+
+int KJob::priority() const
+{
+    Q_D(const KJob);
+    return d->priority;
+}
+
+void KJob::setCancellationToken(const KCancellationToken &token)
+{
+    Q_D(KJob);
+    if (d->cancellationToken == token) {
+        return;
+    }
+    disconnect(d->cancellationConnection);
+    d->cancellationToken = token;
+    // Queued when the token is canceled from another thread
+    d->cancellationConnection = connect(token.d.get(), &KCancellationTokenPrivate::canceled, this, [this]() {
+        kill(EmitResult);
+    });
+    if (token.isCanceled()) {
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                kill(EmitResult);
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+std::optional<KCancellationToken> KJob::cancellationToken() const
+{
+    Q_D(const KJob);
+    return d->cancellationToken;
+}
+
 bool KJob::isAutoDelete() const
 {
     Q_D(const KJob);
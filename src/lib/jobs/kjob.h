@@ -13,8 +13,10 @@
 
 #include <QObject>
 #include <QPair>
+#include <kcancellationtoken.h>
 #include <kcoreaddons_export.h>
 #include <memory>
+#include <optional>
 
 class KJobUiDelegate;
 
@@ -78,6 +80,7 @@ class KCOREADDONS_EXPORT KJob : public QObject
     Q_PROPERTY(QString errorString READ errorString NOTIFY result)
     Q_PROPERTY(ulong percent READ percent NOTIFY percentChanged) // KF6 TODO: make "int", is enough
     Q_PROPERTY(Capabilities capabilities READ capabilities CONSTANT)
+    Q_PROPERTY(int priority READ priority WRITE setPriority NOTIFY priorityChanged)
 
 public:
     /**
@@ -370,6 +373,64 @@ public:
      */
     bool isAutoDelete() const;
 
+    /**
+     * Limits how often the processedAmountChanged() and percentChanged() signals are emitted.
+     * After one of them was emitted, changes within the next @p msecs milliseconds are only
+     * emitted once that interval elapsed, with the latest values. Pending changes are always
+     * emitted before finished() and result().
+     *
+     * Use this for jobs updating their progress very often, e.g. after every block of data.
+     * The default of 0 emits every change at once.
+     *
+     * @param msecs the minimum interval between two progress emissions in milliseconds
+     * @since 6.0
+     */
+    void setProgressEmissionInterval(int msecs);
+
+    /**
+     * @return the minimum interval between two progress emissions in milliseconds
+     * @see setProgressEmissionInterval()
+     * @since 6.0
+     */
+    int progressEmissionInterval() const;
+
+    /**
+     * Sets the priority of this job. Jobs running other jobs, like KJobScheduler,
+     * start the ready jobs with higher priorities first, KThreadedJob passes it on
+     * to its thread pool. Changing it doesn't affect running jobs.
+     *
+     * The default is 0.
+     *
+     * @param priority the priority, higher values are more important
+     * @since 6.0
+     */
+    void setPriority(int priority);
+
+    /**
+     * @return the priority of this job
+     * @see setPriority()
+     * @since 6.0
+     */
+    int priority() const;
+
+    /**
+     * Sets the token canceling this job. Once @p token is canceled, this job is killed
+     * with KJob::EmitResult, right away if it is canceled already.
+     *
+     * A KCompositeJob passes its token on to the subjobs added without one.
+     *
+     * @param token the token, which can be shared with other jobs
+     * @see KCancellationToken
+     * @since 6.0
+     */
+    void setCancellationToken(const KCancellationToken &token);
+
+    /**
+     * @return the token set with setCancellationToken(), if any
+     * @since 6.0
+     */
+    std::optional<KCancellationToken> cancellationToken() const;
+
     /**
      * This method can be used to indicate to classes listening to signals from a job
      * that they should ideally show a progress bar, but not a finished notification.
@@ -618,6 +679,23 @@ Q_SIGNALS:
 #endif
     );
 
+    /**
+     * Emitted when the priority of this job changed.
+     *
+     * @param job the job that emitted this signal
+     * @param priority the new priority
+     *
+     * @see setPriority()
+     * @since 6.0
+     */
+    void priorityChanged(KJob *job,
+                         int priority
+#if !defined(K_DOXYGEN)
+                         ,
+                         QPrivateSignal
+#endif
+    );
+
     /**
      * Emitted to display information about the speed of this job.
      *
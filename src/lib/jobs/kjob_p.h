@@ -16,6 +16,7 @@
 #include <QMap>
 
 #include <array>
+#include <bitset>
 
 class KJobUiDelegate;
 class QTimer;
@@ -32,6 +33,12 @@ public:
 
     void speedTimeout();
 
+    // Whether progress changes are only remembered for now, see KJob::setProgressEmissionInterval()
+    bool isProgressThrottled() const;
+    // Starts the interval after progress was emitted
+    void throttleProgress();
+    void emitPendingProgress();
+
     KJob *q_ptr = nullptr;
 
     KJobUiDelegate *uiDelegate = nullptr;
@@ -47,12 +54,21 @@ public:
     std::array<Amounts, KJob::UnitsCount> m_jobAmounts;
 
     unsigned long percentage = 0;
+    // Both only created once needed, most jobs never use them
     QTimer *speedTimer = nullptr;
+    QTimer *progressTimer = nullptr;
+    // The units with a processed amount that wasn't emitted yet
+    std::bitset<KJob::UnitsCount> pendingProcessedAmounts;
     QEventLoop *eventLoop = nullptr;
     // eventLoopLocker prevents QCoreApplication from exiting when the last
     // window is closed until the job has finished running
     QEventLoopLocker eventLoopLocker;
+    int progressEmissionInterval = 0;
+    int priority = 0;
+    std::optional<KCancellationToken> cancellationToken;
+    QMetaObject::Connection cancellationConnection;
     KJob::Capabilities capabilities = KJob::NoCapabilities;
+    bool pendingPercent = false;
     bool suspended = false;
     bool isAutoDelete = true;
     bool m_hideFinishedNotification = false;
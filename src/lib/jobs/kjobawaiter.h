@@ -0,0 +1,93 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KJOBAWAITER_H
+#define KJOBAWAITER_H
+
+#include <kjob.h>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+
+/**
+ * @class KJobAwaiter kjobawaiter.h KJobAwaiter
+ *
+ * Makes KJob usable with @c co_await in C++20 coroutines, instead of connecting
+ * to KJob::result() or running a nested event loop with KJob::exec().
+ *
+ * Awaiting a job starts it and suspends the coroutine until the job finished.
+ * The result is the error code of the job, KJob::NoError on success.
+ * The job is still valid when the coroutine is resumed, so KJob::errorText() and
+ * other results can be read from it until control returns to the event loop.
+ *
+ * @code
+ * MyTask MyClass::copyAndIndex()
+ * {
+ *     if (const int error = co_await *copyJob) {
+ *         qWarning() << copyJob->errorText();
+ *         co_return;
+ *     }
+ *     co_await *indexJob;
+ * }
+ * @endcode
+ *
+ * The coroutine is resumed when KJob::finished() is emitted, which also happens
+ * when the job is killed quietly or destroyed while running.
+ *
+ * This header only provides the awaiter, the coroutine type has to come from
+ * elsewhere, e.g. the application or a coroutine library.
+ *
+ * @since 6.0
+ */
+class KJobAwaiter
+{
+public:
+    explicit KJobAwaiter(KJob *job)
+        : m_job(job)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        QObject::connect(
+            m_job,
+            &KJob::finished,
+            m_job,
+            [this, handle](KJob *job) {
+                m_error = job->error();
+                handle.resume();
+            },
+            Qt::SingleShotConnection);
+        m_job->start();
+    }
+
+    int await_resume() const noexcept
+    {
+        return m_error;
+    }
+
+private:
+    KJob *const m_job;
+    int m_error = KJob::NoError;
+};
+
+/**
+ * Allows <tt>co_await *job</tt>, see KJobAwaiter.
+ * @since 6.0
+ */
+inline KJobAwaiter operator co_await(KJob &job)
+{
+    return KJobAwaiter(&job);
+}
+
+#endif
+
+#endif
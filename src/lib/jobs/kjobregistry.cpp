@@ -0,0 +1,249 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kjobregistry.h"
+
+#include "kjob_p.h"
+
+#include <QHash>
+#include <QPointer>
+
+#include <utility>
+
+class KSharedJobPrivate : public KJobPrivate
+{
+public:
+    // Follows the progress of the shared job
+    void attach(KJob *job);
+    void detach();
+
+    KJobRegistry *registry = nullptr;
+    QString key;
+    QPointer<KJob> sharedJob;
+
+    Q_DECLARE_PUBLIC(KSharedJob)
+};
+
+class KJobRegistryPrivate
+{
+public:
+    struct Entry {
+        KJob *job = nullptr;
+        QList<KSharedJob *> waiters;
+        bool started = false;
+    };
+
+    explicit KJobRegistryPrivate(KJobRegistry *qq)
+        : q(qq)
+    {
+    }
+
+    // Called when a waiter is killed or deleted before the shared job finished
+    void removeWaiter(KSharedJob *waiter);
+    // Finishes the waiters of the shared job, which finished with error or was deleted
+    void sharedJobFinished(const QString &key, KJob *job, int error, const QString &errorText);
+    static void finishWaiters(const QList<KSharedJob *> &waiters, int error, const QString &errorText);
+
+    KJobRegistry *const q;
+    QHash<QString, Entry> entries;
+};
+
+void KSharedJobPrivate::attach(KJob *job)
+{
+    Q_Q(KSharedJob);
+    sharedJob = job;
+    for (int unit = 0; unit < KJob::UnitsCount; ++unit) {
+        q->setTotalAmount(KJob::Unit(unit), job->totalAmount(KJob::Unit(unit)));
+        q->setProcessedAmount(KJob::Unit(unit), job->processedAmount(KJob::Unit(unit)));
+    }
+    q->setPercent(job->percent());
+
+    QObject::connect(job, &KJob::totalAmountChanged, q, [q](KJob *, KJob::Unit unit, qulonglong amount) {
+        q->setTotalAmount(unit, amount);
+    });
+    QObject::connect(job, &KJob::processedAmountChanged, q, [q](KJob *, KJob::Unit unit, qulonglong amount) {
+        q->setProcessedAmount(unit, amount);
+    });
+    QObject::connect(job, &KJob::percentChanged, q, [q](KJob *, unsigned long percent) {
+        q->setPercent(percent);
+    });
+    QObject::connect(job, &KJob::infoMessage, q, [q](KJob *, const QString &message) {
+        Q_EMIT q->infoMessage(q, message);
+    });
+}
+
+void KSharedJobPrivate::detach()
+{
+    Q_Q(KSharedJob);
+    if (sharedJob) {
+        QObject::disconnect(sharedJob, nullptr, q, nullptr);
+    }
+    registry = nullptr;
+}
+
+void KJobRegistryPrivate::removeWaiter(KSharedJob *waiter)
+{
+    const auto it = entries.find(waiter->key());
+    if (it == entries.end() || it->job != waiter->sharedJob()) {
+        return;
+    }
+    it->waiters.removeOne(waiter);
+    if (!it->waiters.isEmpty()) {
+        return;
+    }
+
+    // Nobody is waiting for the shared job anymore
+    KJob *job = it->job;
+    const bool started = it->started;
+    entries.erase(it);
+    QObject::disconnect(job, nullptr, q, nullptr);
+    if (!job->kill(KJob::Quietly) && !started) {
+        job->deleteLater();
+    }
+}
+
+void KJobRegistryPrivate::sharedJobFinished(const QString &key, KJob *job, int error, const QString &errorText)
+{
+    const auto it = entries.find(key);
+    if (it == entries.end() || it->job != job) {
+        return;
+    }
+
+    // Taken out first, so that new jobs for the key can be started from slots connected to result()
+    const QList<KSharedJob *> waiters = it->waiters;
+    entries.erase(it);
+    QObject::disconnect(job, nullptr, q, nullptr);
+    finishWaiters(waiters, error, errorText);
+}
+
+void KJobRegistryPrivate::finishWaiters(const QList<KSharedJob *> &waiters, int error, const QString &errorText)
+{
+    // Slots connected to result() may delete other waiters
+    QList<QPointer<KSharedJob>> guardedWaiters;
+    for (KSharedJob *waiter : waiters) {
+        guardedWaiters.append(waiter);
+        waiter->d_func()->registry = nullptr;
+    }
+
+    for (const QPointer<KSharedJob> &waiter : std::as_const(guardedWaiters)) {
+        if (!waiter) {
+            continue;
+        }
+        waiter->setError(error);
+        waiter->setErrorText(errorText);
+        waiter->emitResult();
+        if (waiter) {
+            waiter->d_func()->detach();
+        }
+    }
+}
+
+KSharedJob::KSharedJob(KJobRegistry *registry, const QString &key)
+    : KJob(*new KSharedJobPrivate, nullptr)
+{
+    Q_D(KSharedJob);
+    d->registry = registry;
+    d->key = key;
+    setCapabilities(Killable);
+}
+
+KSharedJob::~KSharedJob()
+{
+    Q_D(KSharedJob);
+    if (d->registry) {
+        d->registry->d->removeWaiter(this);
+    }
+}
+
+void KSharedJob::start()
+{
+    Q_D(KSharedJob);
+    if (!d->registry) {
+        return;
+    }
+    const auto it = d->registry->d->entries.find(d->key);
+    if (it != d->registry->d->entries.end() && it->job == d->sharedJob && !it->started) {
+        it->started = true;
+        it->job->start();
+    }
+}
+
+QString KSharedJob::key() const
+{
+    return d_func()->key;
+}
+
+KJob *KSharedJob::sharedJob() const
+{
+    return d_func()->sharedJob;
+}
+
+bool KSharedJob::doKill()
+{
+    Q_D(KSharedJob);
+    if (d->registry) {
+        KJobRegistry *registry = d->registry;
+        d->detach();
+        registry->d->removeWaiter(this);
+    }
+    d->sharedJob = nullptr;
+    return true;
+}
+
+KJobRegistry::KJobRegistry(QObject *parent)
+    : QObject(parent)
+    , d(new KJobRegistryPrivate(this))
+{
+}
+
+KJobRegistry::~KJobRegistry()
+{
+    const auto entries = std::exchange(d->entries, {});
+    for (const KJobRegistryPrivate::Entry &entry : entries) {
+        disconnect(entry.job, nullptr, this, nullptr);
+        entry.job->kill(KJob::Quietly);
+        KJobRegistryPrivate::finishWaiters(entry.waiters, KJob::KilledJobError, QString());
+    }
+}
+
+KSharedJob *KJobRegistry::job(const QString &key, const std::function<KJob *()> &factory)
+{
+    auto it = d->entries.find(key);
+    if (it == d->entries.end()) {
+        KJob *job = factory();
+        if (!job) {
+            return nullptr;
+        }
+        job->setParent(this);
+        job->setAutoDelete(true);
+        connect(job, &KJob::finished, this, [this, key](KJob *job) {
+            d->sharedJobFinished(key, job, job->error(), job->errorText());
+        });
+        // Deleted without finishing
+        connect(job, &QObject::destroyed, this, [this, key, job]() {
+            d->sharedJobFinished(key, job, KJob::KilledJobError, QString());
+        });
+        it = d->entries.insert(key, {job, {}, false});
+    }
+
+    auto waiter = new KSharedJob(this, key);
+    waiter->d_func()->attach(it->job);
+    it->waiters.append(waiter);
+    return waiter;
+}
+
+bool KJobRegistry::contains(const QString &key) const
+{
+    return d->entries.contains(key);
+}
+
+int KJobRegistry::waiterCount(const QString &key) const
+{
+    const auto it = d->entries.constFind(key);
+    return it != d->entries.cend() ? int(it->waiters.size()) : 0;
+}
+
+#include "moc_kjobregistry.cpp"
@@ -0,0 +1,137 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KJOBREGISTRY_H
+#define KJOBREGISTRY_H
+
+#include <kcoreaddons_export.h>
+#include <kjob.h>
+
+#include <functional>
+#include <memory>
+
+class KJobRegistryPrivate;
+class KSharedJobPrivate;
+
+/**
+ * @class KSharedJob kjobregistry.h KJobRegistry
+ *
+ * A job waiting for a job shared through a KJobRegistry.
+ *
+ * It finishes together with the shared job, with its error, and follows its progress.
+ * Killing or deleting it only detaches it from the shared job, which is killed
+ * once it has no waiters left.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KSharedJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    ~KSharedJob() override;
+
+    /**
+     * Starts the shared job, unless it was started already by another waiter.
+     */
+    void start() override;
+
+    /**
+     * @return the key the shared job was started with
+     */
+    QString key() const;
+
+    /**
+     * @return the shared job, for getting its results in a slot connected to result().
+     * It is @c nullptr once the shared job was deleted or this job was detached from it.
+     */
+    KJob *sharedJob() const;
+
+protected:
+    /**
+     * Detaches this job from the shared job, killing the shared job if this was its last waiter.
+     */
+    bool doKill() override;
+
+private:
+    friend class KJobRegistry;
+    friend class KJobRegistryPrivate;
+    explicit KSharedJob(KJobRegistry *registry, const QString &key);
+
+    Q_DECLARE_PRIVATE(KSharedJob)
+};
+
+/**
+ * @class KJobRegistry kjobregistry.h KJobRegistry
+ *
+ * Shares identical jobs running at the same time, e.g. listing the same directory
+ * or fetching the same metadata from several places in an application.
+ *
+ * Every job is started under a key identifying what it does. While a job with that key
+ * is in flight, starting another one attaches the caller to the running job instead of
+ * creating a new one. Every caller gets a KSharedJob of its own, finishing with the shared job.
+ * The shared job is only killed once all of its waiters were killed or deleted.
+ *
+ * @code
+ * KSharedJob *job = registry->job(QLatin1String("list:") + url.toString(), [url]() {
+ *     return new ListJob(url);
+ * });
+ * connect(job, &KJob::result, this, [](KJob *job) {
+ *     auto listJob = static_cast<ListJob *>(static_cast<KSharedJob *>(job)->sharedJob());
+ *     ...
+ * });
+ * job->start();
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KJobRegistry : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Creates a new KJobRegistry
+     *
+     * @param parent the parent object
+     */
+    explicit KJobRegistry(QObject *parent = nullptr);
+
+    /**
+     * Destroys a KJobRegistry, killing the jobs in flight. Their waiters finish with KJob::KilledJobError,
+     * no new jobs may be requested from their slots.
+     */
+    ~KJobRegistry() override;
+
+    /**
+     * Returns a new waiter on the job in flight for @p key. If there is none, the job is
+     * created with @p factory, and started once the first of its waiters is started.
+     *
+     * The shared job becomes a child of the registry and deletes itself once finished.
+     *
+     * @param key what the job does
+     * @param factory creates the job, it may return @c nullptr on failure
+     * @return the waiter, which deletes itself once finished unless changed with KJob::setAutoDelete(),
+     * or @c nullptr if @p factory failed
+     */
+    KSharedJob *job(const QString &key, const std::function<KJob *()> &factory);
+
+    /**
+     * @return whether a job is in flight for @p key
+     */
+    bool contains(const QString &key) const;
+
+    /**
+     * @return the number of waiters on the job in flight for @p key
+     */
+    int waiterCount(const QString &key) const;
+
+private:
+    friend class KSharedJob;
+    std::unique_ptr<KJobRegistryPrivate> const d;
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kjobscheduler.h"
+#include "kjobscheduler_p.h"
+
+#include "kcancellationtoken_p.h"
+
+#include <QThread>
+
+// Canceled jobs are killed through their token, maybe only later when it was canceled from another thread
+static bool isCanceled(KJob *job)
+{
+    const std::optional<KCancellationToken> token = job->cancellationToken();
+    return token && token->isCanceled();
+}
+
+KJobSchedulerPrivate::KJobSchedulerPrivate()
+    : maximumConcurrentJobs(qMax(1, QThread::idealThreadCount()))
+{
+}
+
+KJobSchedulerPrivate::~KJobSchedulerPrivate()
+{
+}
+
+void KJobSchedulerPrivate::makeReady(KJob *job, Subjob &subjob)
+{
+    removeFromReady(subjob);
+    subjob.readyKey = ReadyKey(-qint64(job->priority()), subjob.sequence);
+    readyJobs.emplace(*subjob.readyKey, job);
+}
+
+void KJobSchedulerPrivate::removeFromReady(Subjob &subjob)
+{
+    if (subjob.readyKey) {
+        readyJobs.erase(*subjob.readyKey);
+        subjob.readyKey.reset();
+    }
+}
+
+void KJobSchedulerPrivate::startReadyJobs()
+{
+    Q_Q(KJobScheduler);
+    if (!started || suspended || isFinished) {
+        return;
+    }
+    // Only the jobs that became ready are looked at. Jobs finishing right away change the queue.
+    while (runningJobs < maximumConcurrentJobs && !readyJobs.empty()) {
+        KJob *const job = readyJobs.begin()->second;
+        Subjob &subjob = jobs[job];
+        removeFromReady(subjob);
+        // Maybe canceled from another thread, without the signal delivered yet
+        if (isCanceled(job)) {
+            dropJob(job);
+            continue;
+        }
+        subjob.state = Running;
+        ++runningJobs;
+        running.append(job);
+        job->start();
+        // A job may finish right away, or the scheduler may have been killed meanwhile
+        if (isFinished) {
+            return;
+        }
+    }
+    if (!q->hasSubjobs()) {
+        q->emitResult();
+    }
+}
+
+void KJobSchedulerPrivate::dropJob(KJob *job)
+{
+    Q_Q(KJobScheduler);
+    const auto it = jobs.find(job);
+    if (it == jobs.end() || it->state != Waiting) {
+        return;
+    }
+    it->state = Done;
+    removeFromReady(*it);
+    const QList<KJob *> dependents = it->dependents;
+    q->removeSubjob(job);
+    // Still owned by the scheduler, in case the job can't be killed as it was never started
+    job->setParent(q);
+    job->kill(KJob::EmitResult);
+
+    for (KJob *dependent : dependents) {
+        dropJob(dependent);
+    }
+}
+
+void KJobSchedulerPrivate::dropCanceledJobs()
+{
+    QList<KJob *> canceled;
+    for (auto it = jobs.cbegin(); it != jobs.cend(); ++it) {
+        if (it->state == Waiting && isCanceled(it.key())) {
+            canceled.append(it.key());
+        }
+    }
+    for (KJob *job : std::as_const(canceled)) {
+        dropJob(job);
+    }
+}
+
+void KJobSchedulerPrivate::updateAmount(KJob *job, KJob::Unit unit, qulonglong amount, bool total)
+{
+    Q_Q(KJobScheduler);
+    const auto it = jobs.find(job);
+    if (it == jobs.end()) {
+        return;
+    }
+    qulonglong &previous = total ? it->amounts[unit].totalAmount : it->amounts[unit].processedAmount;
+    const qulonglong sum = (total ? m_jobAmounts[unit].totalAmount : m_jobAmounts[unit].processedAmount) - previous + amount;
+    previous = amount;
+    if (total) {
+        q->setTotalAmount(unit, sum);
+    } else {
+        q->setProcessedAmount(unit, sum);
+    }
+}
+
+KJobScheduler::KJobScheduler(QObject *parent)
+    : KCompositeJob(*new KJobSchedulerPrivate, parent)
+{
+    setCapabilities(Killable | Suspendable);
+}
+
+KJobScheduler::~KJobScheduler()
+{
+}
+
+void KJobScheduler::setMaximumConcurrentJobs(int count)
+{
+    Q_D(KJobScheduler);
+    d->maximumConcurrentJobs = qMax(1, count);
+    d->startReadyJobs();
+}
+
+int KJobScheduler::maximumConcurrentJobs() const
+{
+    return d_func()->maximumConcurrentJobs;
+}
+
+bool KJobScheduler::addJob(KJob *job, const QList<KJob *> &dependencies)
+{
+    Q_D(KJobScheduler);
+    if (job == nullptr || d->jobs.contains(job) || isFinished()) {
+        return false;
+    }
+    for (KJob *dependency : dependencies) {
+        if (!d->jobs.contains(dependency)) {
+            return false;
+        }
+    }
+    if (!KCompositeJob::addSubjob(job)) {
+        return false;
+    }
+
+    KJobSchedulerPrivate::Subjob &subjob = d->jobs[job];
+    subjob.sequence = d->nextSequence++;
+    for (KJob *dependency : dependencies) {
+        KJobSchedulerPrivate::Subjob &dependencySubjob = d->jobs[dependency];
+        if (dependencySubjob.state != KJobSchedulerPrivate::Done) {
+            ++subjob.pendingDependencies;
+            dependencySubjob.dependents.append(job);
+        }
+    }
+    if (subjob.pendingDependencies == 0) {
+        d->makeReady(job, subjob);
+    }
+
+    if (const std::optional<KCancellationToken> token = job->cancellationToken()) {
+        if (!d->cancellationTokens.contains(token->d.get())) {
+            d->cancellationTokens.insert(token->d.get(), token->d);
+            connect(token->d.get(), &KCancellationTokenPrivate::canceled, this, [d]() {
+                d->dropCanceledJobs();
+                d->startReadyJobs();
+            });
+        }
+    }
+
+    connect(job, &KJob::totalAmountChanged, this, [d](KJob *job, KJob::Unit unit, qulonglong amount) {
+        d->updateAmount(job, unit, amount, true);
+    });
+    connect(job, &KJob::processedAmountChanged, this, [d](KJob *job, KJob::Unit unit, qulonglong amount) {
+        d->updateAmount(job, unit, amount, false);
+    });
+    connect(job, &KJob::priorityChanged, this, [d](KJob *job) {
+        const auto it = d->jobs.find(job);
+        if (it != d->jobs.end() && it->readyKey) {
+            d->makeReady(job, *it);
+        }
+    });
+    // Finished jobs are kept to be dependencies of jobs added later, until they are gone
+    connect(job, &QObject::destroyed, this, [d, job]() {
+        const auto it = d->jobs.constFind(job);
+        if (it != d->jobs.cend() && it->state == KJobSchedulerPrivate::Done) {
+            d->jobs.erase(it);
+        }
+    });
+
+    d->startReadyJobs();
+    return true;
+}
+
+bool KJobScheduler::addSubjob(KJob *job)
+{
+    return addJob(job);
+}
+
+void KJobScheduler::start()
+{
+    Q_D(KJobScheduler);
+    d->started = true;
+    d->startReadyJobs();
+}
+
+bool KJobScheduler::doKill()
+{
+    Q_D(KJobScheduler);
+    bool killed = true;
+    const QList<KJob *> running = d->running;
+    for (KJob *job : running) {
+        killed = job->kill(Quietly) && killed;
+    }
+    return killed;
+}
+
+bool KJobScheduler::doSuspend()
+{
+    Q_D(KJobScheduler);
+    for (KJob *job : std::as_const(d->running)) {
+        if (job->capabilities() & Suspendable) {
+            job->suspend();
+        }
+    }
+    return true;
+}
+
+bool KJobScheduler::doResume()
+{
+    Q_D(KJobScheduler);
+    for (KJob *job : std::as_const(d->running)) {
+        if (job->isSuspended()) {
+            job->resume();
+        }
+    }
+    // Jobs that became ready meanwhile, suspended is only reset after this returns
+    QMetaObject::invokeMethod(
+        this,
+        [d]() {
+            d->startReadyJobs();
+        },
+        Qt::QueuedConnection);
+    return true;
+}
+
+void KJobScheduler::slotResult(KJob *job)
+{
+    Q_D(KJobScheduler);
+    const auto it = d->jobs.find(job);
+    if (it == d->jobs.end()) {
+        return;
+    }
+    // Jobs canceled through their token may not have been started
+    if (it->state == KJobSchedulerPrivate::Running) {
+        --d->runningJobs;
+        d->running.removeOne(job);
+    }
+    it->state = KJobSchedulerPrivate::Done;
+    d->removeFromReady(*it);
+    const QList<KJob *> dependents = it->dependents;
+    removeSubjob(job);
+
+    // Canceling is no failure of the scheduler, only the jobs depending on the canceled one are dropped
+    if (job->error() == KilledJobError && isCanceled(job)) {
+        for (KJob *dependent : dependents) {
+            d->dropJob(dependent);
+        }
+        d->startReadyJobs();
+        return;
+    }
+
+    if (job->error()) {
+        if (!error()) {
+            setError(job->error());
+            setErrorText(job->errorText());
+        }
+        doKill();
+        emitResult();
+        return;
+    }
+
+    for (KJob *dependent : dependents) {
+        KJobSchedulerPrivate::Subjob &subjob = d->jobs[dependent];
+        if (--subjob.pendingDependencies == 0 && subjob.state == KJobSchedulerPrivate::Waiting) {
+            d->makeReady(dependent, subjob);
+        }
+    }
+    d->startReadyJobs();
+}
+
+#include "moc_kjobscheduler.cpp"
@@ -0,0 +1,117 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KJOBSCHEDULER_H
+#define KJOBSCHEDULER_H
+
+#include <kcompositejob.h>
+#include <kcoreaddons_export.h>
+
+class KJobSchedulerPrivate;
+/**
+ * @class KJobScheduler kjobscheduler.h KJobScheduler
+ *
+ * A job running its subjobs in the order given by their dependencies,
+ * at most maximumConcurrentJobs() of them at once.
+ *
+ * A subjob is started once all the jobs it depends on finished successfully.
+ * As the dependencies of a job have to be added before it, the jobs can't
+ * depend on each other in a cycle.
+ *
+ * @code
+ * auto scheduler = new KJobScheduler(this);
+ * scheduler->setMaximumConcurrentJobs(4);
+ * KJob *download = ...;
+ * scheduler->addJob(download);
+ * scheduler->addJob(extractJob, {download});
+ * connect(scheduler, &KJob::result, this, &MyClass::slotAllDone);
+ * scheduler->start();
+ * @endcode
+ *
+ * Of the subjobs ready at once, the ones with the higher KJob::priority() are started first.
+ *
+ * The first subjob failing ends the scheduler with its error, the running
+ * subjobs are killed then and the remaining ones are not started.
+ * Subjobs canceled through their KJob::cancellationToken() are not started, or
+ * killed if they are running, without failing the scheduler. The subjobs depending
+ * on them are killed with KJob::EmitResult instead of being started.
+ * Killing, suspending and resuming the scheduler does the same to the running subjobs.
+ * The processed and total amounts of the scheduler are the sums of the ones of its subjobs.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KJobScheduler : public KCompositeJob
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Creates a new KJobScheduler object.
+     *
+     * @param parent the parent QObject
+     */
+    explicit KJobScheduler(QObject *parent = nullptr);
+
+    /**
+     * Destroys a KJobScheduler object.
+     */
+    ~KJobScheduler() override;
+
+    /**
+     * Sets how many subjobs run at once at most.
+     * The default is QThread::idealThreadCount().
+     *
+     * @param count the maximum number of running subjobs, at least 1
+     */
+    void setMaximumConcurrentJobs(int count);
+
+    /**
+     * @return how many subjobs run at once at most
+     */
+    int maximumConcurrentJobs() const;
+
+    /**
+     * Adds a subjob, which is started once all of @p dependencies finished.
+     * Jobs can be added while the scheduler is running too.
+     *
+     * Note that the scheduler takes ownership of @p job
+     *
+     * @param job the subjob to add
+     * @param dependencies jobs added to this scheduler before, which have to finish before @p job starts
+     * @return true if the job has been added correctly, false otherwise, e.g. if a dependency is not part of this scheduler
+     */
+    bool addJob(KJob *job, const QList<KJob *> &dependencies = {});
+
+    /**
+     * Starts the subjobs without dependencies.
+     */
+    void start() override;
+
+protected:
+    /**
+     * Adds a subjob without dependencies, see addJob().
+     */
+    bool addSubjob(KJob *job) override;
+
+    bool doKill() override;
+    bool doSuspend() override;
+    bool doResume() override;
+
+protected Q_SLOTS:
+    /**
+     * Called whenever a subjob finishes.
+     * Starts the jobs depending on @p job, or ends the scheduler if
+     * @p job failed or was the last one.
+     *
+     * @param job the subjob
+     */
+    void slotResult(KJob *job) override;
+
+private:
+    Q_DECLARE_PRIVATE(KJobScheduler)
+};
+
+#endif
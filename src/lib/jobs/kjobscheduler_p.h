@@ -0,0 +1,73 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KJOBSCHEDULER_P_H
+#define KJOBSCHEDULER_P_H
+
+#include "kjobscheduler.h"
+
+#include "kcompositejob_p.h"
+
+#include <QHash>
+
+#include <map>
+#include <memory>
+#include <optional>
+
+class KCancellationTokenPrivate;
+
+class KJobSchedulerPrivate : public KCompositeJobPrivate
+{
+public:
+    KJobSchedulerPrivate();
+    ~KJobSchedulerPrivate() override;
+
+    enum SubjobState {
+        Waiting,
+        Running,
+        Done,
+    };
+
+    // The position of a job in readyJobs: the higher priority first, then in the order the jobs were added
+    using ReadyKey = std::pair<qint64, qsizetype>;
+
+    struct Subjob {
+        SubjobState state = Waiting;
+        // The number of dependencies which didn't finish yet
+        int pendingDependencies = 0;
+        QList<KJob *> dependents;
+        // The number of the job in the order the jobs were added
+        qsizetype sequence = 0;
+        // Set while the job is in readyJobs
+        std::optional<ReadyKey> readyKey;
+        // The latest amounts reported by the job
+        std::array<Amounts, KJob::UnitsCount> amounts;
+    };
+
+    // Queues a waiting job without pending dependencies to be started
+    void makeReady(KJob *job, Subjob &subjob);
+    void removeFromReady(Subjob &subjob);
+    void startReadyJobs();
+    // Removes a job which won't be started, because a job it depends on was canceled
+    void dropJob(KJob *job);
+    void dropCanceledJobs();
+    void updateAmount(KJob *job, KJob::Unit unit, qulonglong amount, bool total);
+
+    QHash<KJob *, Subjob> jobs;
+    // The waiting jobs without pending dependencies, in the order they are started in
+    std::map<ReadyKey, KJob *> readyJobs;
+    QList<KJob *> running;
+    qsizetype nextSequence = 0;
+    // The tokens of the subjobs, to drop the waiting subjobs once they are canceled
+    QHash<KCancellationTokenPrivate *, std::shared_ptr<KCancellationTokenPrivate>> cancellationTokens;
+    int maximumConcurrentJobs;
+    int runningJobs = 0;
+    bool started = false;
+
+    Q_DECLARE_PUBLIC(KJobScheduler)
+};
+
+#endif
@@ -0,0 +1,213 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kjobtracingtracker.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <optional>
+
+class KJobTracingTrackerPrivate
+{
+public:
+    // Times in microseconds since the tracker was created
+    struct Trace {
+        int id = 0;
+        QString className;
+        qint64 registered = 0;
+        std::optional<qint64> started;
+        qint64 finished = 0;
+        // Start and end of every suspension, the last end is missing while suspended
+        QList<qint64> suspensions;
+        qulonglong processedBytes = 0;
+        int error = KJob::NoError;
+    };
+
+    qint64 now() const
+    {
+        return clock.nsecsElapsed() / 1000;
+    }
+
+    void markStarted(KJob *job)
+    {
+        const auto it = runningJobs.find(job);
+        if (it != runningJobs.end() && !it->started) {
+            it->started = now();
+        }
+    }
+
+    QElapsedTimer clock;
+    int nextId = 1;
+    QHash<KJob *, Trace> runningJobs;
+    QList<Trace> finishedJobs;
+};
+
+KJobTracingTracker::KJobTracingTracker(QObject *parent)
+    : KJobTrackerInterface(parent)
+    , d(new KJobTracingTrackerPrivate)
+{
+    d->clock.start();
+}
+
+KJobTracingTracker::~KJobTracingTracker() = default;
+
+void KJobTracingTracker::registerJob(KJob *job)
+{
+    KJobTrackerInterface::registerJob(job);
+    KJobTracingTrackerPrivate::Trace &trace = d->runningJobs[job];
+    trace.id = d->nextId++;
+    trace.className = QString::fromLatin1(job->metaObject()->className());
+    trace.registered = d->now();
+}
+
+// Called when the job finished, before finished()
+void KJobTracingTracker::unregisterJob(KJob *job)
+{
+    KJobTrackerInterface::unregisterJob(job);
+
+    const auto it = d->runningJobs.find(job);
+    if (it == d->runningJobs.end()) {
+        return;
+    }
+    KJobTracingTrackerPrivate::Trace trace = it.value();
+    d->runningJobs.erase(it);
+    trace.finished = d->now();
+    if (!trace.started) {
+        trace.started = trace.finished;
+    }
+    if (trace.suspensions.size() % 2 != 0) {
+        trace.suspensions.append(trace.finished);
+    }
+    trace.processedBytes = qMax(trace.processedBytes, job->processedAmount(KJob::Bytes));
+    trace.error = job->error();
+    d->finishedJobs.append(trace);
+}
+
+void KJobTracingTracker::suspended(KJob *job)
+{
+    d->markStarted(job);
+    const auto it = d->runningJobs.find(job);
+    if (it != d->runningJobs.end() && it->suspensions.size() % 2 == 0) {
+        it->suspensions.append(d->now());
+    }
+}
+
+void KJobTracingTracker::resumed(KJob *job)
+{
+    const auto it = d->runningJobs.find(job);
+    if (it != d->runningJobs.end() && it->suspensions.size() % 2 != 0) {
+        it->suspensions.append(d->now());
+    }
+}
+
+void KJobTracingTracker::description(KJob *job, const QString &title, const QPair<QString, QString> &field1, const QPair<QString, QString> &field2)
+{
+    Q_UNUSED(title)
+    Q_UNUSED(field1)
+    Q_UNUSED(field2)
+    d->markStarted(job);
+}
+
+void KJobTracingTracker::infoMessage(KJob *job, const QString &message)
+{
+    Q_UNUSED(message)
+    d->markStarted(job);
+}
+
+void KJobTracingTracker::totalAmount(KJob *job, KJob::Unit unit, qulonglong amount)
+{
+    Q_UNUSED(unit)
+    Q_UNUSED(amount)
+    d->markStarted(job);
+}
+
+void KJobTracingTracker::processedAmount(KJob *job, KJob::Unit unit, qulonglong amount)
+{
+    d->markStarted(job);
+    const auto it = d->runningJobs.find(job);
+    if (it != d->runningJobs.end() && unit == KJob::Bytes) {
+        it->processedBytes = amount;
+    }
+}
+
+void KJobTracingTracker::percent(KJob *job, unsigned long percent)
+{
+    Q_UNUSED(percent)
+    d->markStarted(job);
+}
+
+QHash<QString, KJobTracingTracker::Statistics> KJobTracingTracker::statistics() const
+{
+    QHash<QString, Statistics> ret;
+    for (const KJobTracingTrackerPrivate::Trace &trace : std::as_const(d->finishedJobs)) {
+        Statistics &statistics = ret[trace.className];
+        ++statistics.jobCount;
+        if (trace.error != KJob::NoError) {
+            ++statistics.errorCount;
+        }
+        const qint64 runTime = (trace.finished - *trace.started) / 1000;
+        statistics.totalWaitTime += (*trace.started - trace.registered) / 1000;
+        statistics.totalRunTime += runTime;
+        statistics.processedBytes += trace.processedBytes;
+
+        int bucket = 0;
+        while (bucket < 63 && runTime >= (qint64(1) << bucket)) {
+            ++bucket;
+        }
+        if (statistics.runTimeHistogram.size() <= bucket) {
+            statistics.runTimeHistogram.resize(bucket + 1);
+        }
+        ++statistics.runTimeHistogram[bucket];
+    }
+    return ret;
+}
+
+QByteArray KJobTracingTracker::toChromeTrace() const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+    for (const KJobTracingTrackerPrivate::Trace &trace : std::as_const(d->finishedJobs)) {
+        // Every job in its own row, as jobs overlap arbitrarily
+        events.append(QJsonObject{
+            {QStringLiteral("name"), trace.className},
+            {QStringLiteral("cat"), QStringLiteral("job")},
+            {QStringLiteral("ph"), QStringLiteral("X")},
+            {QStringLiteral("ts"), *trace.started},
+            {QStringLiteral("dur"), trace.finished - *trace.started},
+            {QStringLiteral("pid"), pid},
+            {QStringLiteral("tid"), trace.id},
+            {QStringLiteral("args"),
+             QJsonObject{
+                 {QStringLiteral("waitTime"), *trace.started - trace.registered},
+                 {QStringLiteral("error"), trace.error},
+                 {QStringLiteral("processedBytes"), qint64(trace.processedBytes)},
+             }},
+        });
+        for (qsizetype i = 0; i < trace.suspensions.size(); ++i) {
+            events.append(QJsonObject{
+                {QStringLiteral("name"), i % 2 == 0 ? QStringLiteral("suspended") : QStringLiteral("resumed")},
+                {QStringLiteral("cat"), QStringLiteral("job")},
+                {QStringLiteral("ph"), QStringLiteral("i")},
+                {QStringLiteral("s"), QStringLiteral("t")},
+                {QStringLiteral("ts"), trace.suspensions.at(i)},
+                {QStringLiteral("pid"), pid},
+                {QStringLiteral("tid"), trace.id},
+            });
+        }
+    }
+    return QJsonDocument(QJsonObject{{QStringLiteral("traceEvents"), events}}).toJson(QJsonDocument::Compact);
+}
+
+void KJobTracingTracker::clear()
+{
+    d->finishedJobs.clear();
+}
+
+#include "moc_kjobtracingtracker.cpp"
@@ -0,0 +1,119 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KJOBTRACINGTRACKER_H
+#define KJOBTRACINGTRACKER_H
+
+#include <kcoreaddons_export.h>
+#include <kjobtrackerinterface.h>
+
+#include <QHash>
+#include <QList>
+
+class KJobTracingTrackerPrivate;
+
+/**
+ * @class KJobTracingTracker kjobtracingtracker.h KJobTracingTracker
+ *
+ * A job tracker recording when the registered jobs ran, for profiling applications using many jobs.
+ *
+ * For every job, the time it was registered, the time it started, its suspensions and the time
+ * it finished, or was unregistered, are recorded. As KJob has no notification of being started, a job counts as
+ * started on its first progress, description or info message, or else when it finishes.
+ *
+ * The recorded jobs are available as statistics per job class, or as a trace in the
+ * Chrome trace event format, which can be viewed with e.g. Perfetto or chrome://tracing.
+ *
+ * @code
+ * auto tracer = new KJobTracingTracker(this);
+ * tracer->registerJob(job);
+ * ...
+ * QFile file(QStringLiteral("jobs.json"));
+ * if (file.open(QIODevice::WriteOnly)) {
+ *     file.write(tracer->toChromeTrace());
+ * }
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KJobTracingTracker : public KJobTrackerInterface
+{
+    Q_OBJECT
+
+public:
+    /**
+     * What was recorded for the finished jobs of one class
+     */
+    struct Statistics {
+        /// The number of finished jobs
+        int jobCount = 0;
+        /// The number of jobs which finished with an error
+        int errorCount = 0;
+        /// The sum of the times from registering the jobs until they started, in milliseconds
+        qint64 totalWaitTime = 0;
+        /// The sum of the times from starting the jobs until they finished, in milliseconds
+        qint64 totalRunTime = 0;
+        /// The sum of the processed amounts in KJob::Bytes
+        qulonglong processedBytes = 0;
+        /**
+         * The number of jobs by run time. The first entry counts the jobs which ran less than 1 ms,
+         * entry @c i the jobs which ran at least 2^(i - 1) and less than 2^i ms.
+         */
+        QList<int> runTimeHistogram;
+
+        /// @return the processed bytes per second of run time
+        double throughput() const
+        {
+            return totalRunTime > 0 ? processedBytes * 1000.0 / totalRunTime : 0;
+        }
+    };
+
+    /**
+     * Creates a new KJobTracingTracker
+     *
+     * @param parent the parent object
+     */
+    explicit KJobTracingTracker(QObject *parent = nullptr);
+
+    /**
+     * Destroys a KJobTracingTracker
+     */
+    ~KJobTracingTracker() override;
+
+    /**
+     * @return the statistics of the finished jobs by the class name of the jobs
+     */
+    QHash<QString, Statistics> statistics() const;
+
+    /**
+     * @return the finished jobs in the Chrome trace event format, as a JSON document.
+     * Every job is a complete event named by its class, with its suspensions as instant events.
+     */
+    QByteArray toChromeTrace() const;
+
+    /**
+     * Forgets the finished jobs.
+     */
+    void clear();
+
+public Q_SLOTS:
+    void registerJob(KJob *job) override;
+    void unregisterJob(KJob *job) override;
+
+protected Q_SLOTS:
+    void suspended(KJob *job) override;
+    void resumed(KJob *job) override;
+    void description(KJob *job, const QString &title, const QPair<QString, QString> &field1, const QPair<QString, QString> &field2) override;
+    void infoMessage(KJob *job, const QString &message) override;
+    void totalAmount(KJob *job, KJob::Unit unit, qulonglong amount) override;
+    void processedAmount(KJob *job, KJob::Unit unit, qulonglong amount) override;
+    void percent(KJob *job, unsigned long percent) override;
+
+private:
+    std::unique_ptr<KJobTracingTrackerPrivate> const d;
+};
+
+#endif
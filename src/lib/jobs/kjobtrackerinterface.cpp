@@ -10,15 +10,238 @@
 
 #include "kjob.h"
 
+#include <QHash>
+#include <QMap>
+#include <QTimer>
+
+#include <optional>
+
 class KJobTrackerInterfacePrivate
 {
 public:
     KJobTrackerInterfacePrivate(KJobTrackerInterface *interface)
         : q(interface)
     {
+        progressTimer.setSingleShot(true);
+        QObject::connect(&progressTimer, &QTimer::timeout, q, [this]() {
+            flushAll();
+        });
+    }
+
+    // The latest progress of a job which wasn't passed on yet
+    struct PendingProgress {
+        QMap<KJob::Unit, qulonglong> totalAmounts;
+        QMap<KJob::Unit, qulonglong> processedAmounts;
+        std::optional<unsigned long> percent;
+        std::optional<unsigned long> speed;
+        std::optional<std::pair<int, int>> childJobs;
+    };
+
+    // A job registered with registerChildJobs(), and its latest amounts.
+    // The job may be registered on its own as well, so only the connections
+    // made for it as a child are taken apart again.
+    struct Child {
+        KJob *parent;
+        QMap<KJob::Unit, qulonglong> processedAmounts;
+        QMap<KJob::Unit, qulonglong> totalAmounts;
+        QList<QMetaObject::Connection> connections;
+    };
+
+    static void disconnectChild(const Child &child)
+    {
+        for (const QMetaObject::Connection &connection : child.connections) {
+            QObject::disconnect(connection);
+        }
+    }
+
+    // The amounts of a job with children, its own ones and the sums of the children
+    struct Family {
+        QMap<KJob::Unit, qulonglong> ownProcessedAmounts;
+        QMap<KJob::Unit, qulonglong> ownTotalAmounts;
+        QMap<KJob::Unit, qulonglong> childProcessedAmounts;
+        QMap<KJob::Unit, qulonglong> childTotalAmounts;
+        int childCount = 0;
+        int finishedCount = 0;
+    };
+
+    PendingProgress *pendingProgress(KJob *job)
+    {
+        if (!progressTimer.isActive()) {
+            progressTimer.start(progressUpdateInterval);
+        }
+        return &pendingProgresses[job];
+    }
+
+    void flush(KJob *job)
+    {
+        const auto it = pendingProgresses.find(job);
+        if (it == pendingProgresses.end()) {
+            return;
+        }
+        const PendingProgress progress = it.value();
+        pendingProgresses.erase(it);
+        for (auto amount = progress.totalAmounts.cbegin(); amount != progress.totalAmounts.cend(); ++amount) {
+            q->totalAmount(job, amount.key(), amount.value());
+        }
+        for (auto amount = progress.processedAmounts.cbegin(); amount != progress.processedAmounts.cend(); ++amount) {
+            q->processedAmount(job, amount.key(), amount.value());
+        }
+        if (progress.percent) {
+            q->percent(job, *progress.percent);
+        }
+        if (progress.speed) {
+            q->speed(job, *progress.speed);
+        }
+        if (progress.childJobs) {
+            q->childJobsChanged(job, progress.childJobs->first, progress.childJobs->second);
+        }
+    }
+
+    void flushAll()
+    {
+        const QList<KJob *> jobs = pendingProgresses.keys();
+        for (KJob *job : jobs) {
+            flush(job);
+        }
+    }
+
+    void passProcessedAmount(KJob *job, KJob::Unit unit, qulonglong amount)
+    {
+        if (progressUpdateInterval > 0) {
+            pendingProgress(job)->processedAmounts.insert(unit, amount);
+        } else {
+            q->processedAmount(job, unit, amount);
+        }
+    }
+
+    void passPercent(KJob *job, unsigned long value)
+    {
+        if (progressUpdateInterval > 0) {
+            pendingProgress(job)->percent = value;
+        } else {
+            q->percent(job, value);
+        }
+    }
+
+    // Only coalesced for families, a job on its own doesn't change its total that often
+    void passTotalAmount(KJob *job, KJob::Unit unit, qulonglong amount)
+    {
+        if (progressUpdateInterval > 0 && families.contains(job)) {
+            pendingProgress(job)->totalAmounts.insert(unit, amount);
+        } else {
+            q->totalAmount(job, unit, amount);
+        }
+    }
+
+    void passChildJobs(KJob *job, const Family &family)
+    {
+        if (progressUpdateInterval > 0) {
+            pendingProgress(job)->childJobs = std::make_pair(family.finishedCount, family.childCount);
+        } else {
+            q->childJobsChanged(job, family.finishedCount, family.childCount);
+        }
+    }
+
+    // Passes on the summed amounts of @p units of @p parent, and its percentage
+    void passFamilyProgress(KJob *parent, const Family &family, const QList<KJob::Unit> &units)
+    {
+        for (const KJob::Unit unit : units) {
+            passTotalAmount(parent, unit, family.ownTotalAmounts.value(unit) + family.childTotalAmounts.value(unit));
+            passProcessedAmount(parent, unit, family.ownProcessedAmounts.value(unit) + family.childProcessedAmounts.value(unit));
+        }
+        // In the first unit there is a total for, as the progress unit of a job isn't public
+        for (const KJob::Unit unit : {KJob::Bytes, KJob::Files, KJob::Items, KJob::Directories}) {
+            const qulonglong total = family.ownTotalAmounts.value(unit) + family.childTotalAmounts.value(unit);
+            if (total > 0) {
+                const qulonglong processed = family.ownProcessedAmounts.value(unit) + family.childProcessedAmounts.value(unit);
+                passPercent(parent, static_cast<unsigned long>(qMin(100.0, 100.0 * double(processed) / double(total))));
+                return;
+            }
+        }
+    }
+
+    // The own amounts of a registered job, summed up with the ones of its children if it has any
+    void ownAmountChanged(KJob *job, KJob::Unit unit, qulonglong amount, bool isTotal)
+    {
+        const auto it = families.find(job);
+        if (it == families.end()) {
+            if (isTotal) {
+                passTotalAmount(job, unit, amount);
+            } else {
+                passProcessedAmount(job, unit, amount);
+            }
+            return;
+        }
+        (isTotal ? it->ownTotalAmounts : it->ownProcessedAmounts).insert(unit, amount);
+        passFamilyProgress(job, *it, {unit});
+    }
+
+    void childAmountChanged(KJob *job, KJob::Unit unit, qulonglong amount, bool isTotal)
+    {
+        const auto child = children.find(job);
+        if (child == children.end()) {
+            return;
+        }
+        Family &family = families[child->parent];
+        qulonglong &previous = (isTotal ? child->totalAmounts : child->processedAmounts)[unit];
+        qulonglong &sum = (isTotal ? family.childTotalAmounts : family.childProcessedAmounts)[unit];
+        sum = sum - previous + amount;
+        previous = amount;
+        passFamilyProgress(child->parent, family, {unit});
+    }
+
+    // Stops tracking child @p job. Unless it finished, its amounts no longer count.
+    // Returns the units of its parent that changed.
+    QList<KJob::Unit> removeChild(KJob *job, bool finished)
+    {
+        const auto child = children.find(job);
+        if (child == children.end()) {
+            return {};
+        }
+        disconnectChild(*child);
+        Family &family = families[child->parent];
+        QList<KJob::Unit> units;
+        if (finished) {
+            ++family.finishedCount;
+        } else {
+            --family.childCount;
+            for (auto it = child->totalAmounts.cbegin(); it != child->totalAmounts.cend(); ++it) {
+                family.childTotalAmounts[it.key()] -= it.value();
+                units.append(it.key());
+            }
+            for (auto it = child->processedAmounts.cbegin(); it != child->processedAmounts.cend(); ++it) {
+                family.childProcessedAmounts[it.key()] -= it.value();
+                if (!units.contains(it.key())) {
+                    units.append(it.key());
+                }
+            }
+        }
+        children.erase(child);
+        return units;
+    }
+
+    // Stops tracking the children of @p parent, once it is unregistered itself
+    void removeFamily(KJob *parent)
+    {
+        if (!families.remove(parent)) {
+            return;
+        }
+        for (auto it = children.begin(); it != children.end();) {
+            if (it->parent == parent) {
+                disconnectChild(*it);
+                it = children.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
     KJobTrackerInterface *const q;
+    int progressUpdateInterval = 0;
+    QTimer progressTimer;
+    QHash<KJob *, PendingProgress> pendingProgresses;
+    QHash<KJob *, Child> children;
+    QHash<KJob *, Family> families;
 };
 
 KJobTrackerInterface::KJobTrackerInterface(QObject *parent)
@@ -31,8 +254,30 @@ KJobTrackerInterface::KJobTrackerInterface(QObject *parent)
 
 KJobTrackerInterface::~KJobTrackerInterface() = default;
 
+void KJobTrackerInterface::setProgressUpdateInterval(int msecs)
+{
+    d->progressUpdateInterval = qMax(0, msecs);
+    if (d->progressUpdateInterval == 0) {
+        d->progressTimer.stop();
+        d->flushAll();
+    }
+}
+
+int KJobTrackerInterface::progressUpdateInterval() const
+{
+    return d->progressUpdateInterval;
+}
+
 void KJobTrackerInterface::registerJob(KJob *job)
 {
+    // Before anything else, so that the last progress is passed on before the job is finished
+    connect(job, &KJob::finished, this, [this](KJob *job) {
+        d->flush(job);
+    });
+    connect(job, &KJob::suspended, this, [this](KJob *job) {
+        d->flush(job);
+    });
+
     connect(job, &KJob::finished, this, &KJobTrackerInterface::unregisterJob);
     connect(job, &KJob::finished, this, &KJobTrackerInterface::finished);
     connect(job, &KJob::suspended, this, &KJobTrackerInterface::suspended);
@@ -41,17 +286,147 @@ void KJobTrackerInterface::registerJob(KJob *job)
     connect(job, &KJob::description, this, &KJobTrackerInterface::description);
     connect(job, &KJob::infoMessage, this, &KJobTrackerInterface::infoMessage);
     connect(job, &KJob::warning, this, &KJobTrackerInterface::warning);
-    connect(job, &KJob::totalAmountChanged, this, &KJobTrackerInterface::totalAmount);
-    connect(job, &KJob::processedAmountChanged, this, &KJobTrackerInterface::processedAmount);
-    connect(job, &KJob::percentChanged, this, &KJobTrackerInterface::percent);
-    connect(job, &KJob::speed, this, &KJobTrackerInterface::speed);
+    connect(job, &KJob::totalAmountChanged, this, [this](KJob *job, KJob::Unit unit, qulonglong amount) {
+        d->ownAmountChanged(job, unit, amount, true);
+    });
+    connect(job, &KJob::processedAmountChanged, this, [this](KJob *job, KJob::Unit unit, qulonglong amount) {
+        d->ownAmountChanged(job, unit, amount, false);
+    });
+    connect(job, &KJob::percentChanged, this, [this](KJob *job, unsigned long value) {
+        // Computed from the summed amounts for a job with children
+        if (!d->families.contains(job)) {
+            d->passPercent(job, value);
+        }
+    });
+    connect(job, &KJob::speed, this, [this](KJob *job, unsigned long value) {
+        if (d->progressUpdateInterval > 0) {
+            d->pendingProgress(job)->speed = value;
+        } else {
+            speed(job, value);
+        }
+    });
 }
 
 void KJobTrackerInterface::unregisterJob(KJob *job)
 {
+    d->pendingProgresses.remove(job);
+    d->removeFamily(job);
     job->disconnect(this);
 }
 
+void KJobTrackerInterface::registerChildJobs(KJob *parent, const QList<KJob *> &jobs)
+{
+    if (!parent) {
+        return;
+    }
+
+    auto familyIt = d->families.find(parent);
+    if (familyIt == d->families.end()) {
+        familyIt = d->families.insert(parent, {});
+        for (int unit = 0; unit < KJob::UnitsCount; ++unit) {
+            if (const qulonglong total = parent->totalAmount(KJob::Unit(unit))) {
+                familyIt->ownTotalAmounts.insert(KJob::Unit(unit), total);
+            }
+            if (const qulonglong processed = parent->processedAmount(KJob::Unit(unit))) {
+                familyIt->ownProcessedAmounts.insert(KJob::Unit(unit), processed);
+            }
+        }
+    }
+    KJobTrackerInterfacePrivate::Family &family = *familyIt;
+
+    QList<KJob::Unit> units;
+    for (KJob *job : jobs) {
+        if (!job || job == parent || d->children.contains(job) || d->families.contains(job)) {
+            continue;
+        }
+        KJobTrackerInterfacePrivate::Child child{parent, {}, {}, {}};
+        for (int unit = 0; unit < KJob::UnitsCount; ++unit) {
+            const KJob::Unit u = KJob::Unit(unit);
+            const qulonglong total = job->totalAmount(u);
+            const qulonglong processed = job->processedAmount(u);
+            if (total || processed) {
+                child.totalAmounts.insert(u, total);
+                child.processedAmounts.insert(u, processed);
+                family.childTotalAmounts[u] += total;
+                family.childProcessedAmounts[u] += processed;
+                if (!units.contains(u)) {
+                    units.append(u);
+                }
+            }
+        }
+        child.connections = {
+            connect(job,
+                    &KJob::totalAmountChanged,
+                    this,
+                    [this](KJob *job, KJob::Unit unit, qulonglong amount) {
+                        d->childAmountChanged(job, unit, amount, true);
+                    }),
+            connect(job,
+                    &KJob::processedAmountChanged,
+                    this,
+                    [this](KJob *job, KJob::Unit unit, qulonglong amount) {
+                        d->childAmountChanged(job, unit, amount, false);
+                    }),
+            connect(job,
+                    &KJob::finished,
+                    this,
+                    [this](KJob *job) {
+                        const auto child = d->children.constFind(job);
+                        if (child == d->children.cend()) {
+                            return;
+                        }
+                        KJob *const parent = child->parent;
+                        d->removeChild(job, true);
+                        d->passChildJobs(parent, d->families[parent]);
+                    }),
+        };
+        d->children.insert(job, child);
+        ++family.childCount;
+    }
+
+    if (!units.isEmpty()) {
+        d->passFamilyProgress(parent, family, units);
+    }
+    d->passChildJobs(parent, family);
+}
+
+void KJobTrackerInterface::unregisterJobs(const QList<KJob *> &jobs)
+{
+    // The changes of each parent are passed on once for all of its children
+    QHash<KJob *, QList<KJob::Unit>> changedParents;
+    for (KJob *job : jobs) {
+        if (KJob *parent = parentJob(job)) {
+            QList<KJob::Unit> &units = changedParents[parent];
+            const QList<KJob::Unit> changedUnits = d->removeChild(job, false);
+            for (const KJob::Unit unit : changedUnits) {
+                if (!units.contains(unit)) {
+                    units.append(unit);
+                }
+            }
+        } else if (job) {
+            unregisterJob(job);
+        }
+    }
+
+    for (auto it = changedParents.cbegin(); it != changedParents.cend(); ++it) {
+        const auto family = d->families.constFind(it.key());
+        if (family == d->families.cend()) {
+            // unregistered along with its children
+            continue;
+        }
+        if (!it.value().isEmpty()) {
+            d->passFamilyProgress(it.key(), *family, it.value());
+        }
+        d->passChildJobs(it.key(), *family);
+    }
+}
+
+KJob *KJobTrackerInterface::parentJob(KJob *job) const
+{
+    const auto child = d->children.constFind(job);
+    return child != d->children.cend() ? child->parent : nullptr;
+}
+
 void KJobTrackerInterface::finished(KJob *job)
 {
     Q_UNUSED(job)
@@ -113,4 +488,11 @@ void KJobTrackerInterface::speed(KJob *job, unsigned long value)
     Q_UNUSED(value)
 }
 
+void KJobTrackerInterface::childJobsChanged(KJob *job, int finishedCount, int totalCount)
+{
+    Q_UNUSED(job)
+    Q_UNUSED(finishedCount)
+    Q_UNUSED(totalCount)
+}
+
 #include "moc_kjobtrackerinterface.cpp"
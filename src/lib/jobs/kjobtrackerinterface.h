@@ -39,6 +39,65 @@ public:
      */
     ~KJobTrackerInterface() override;
 
+    /**
+     * Sets the minimum interval between two progress updates of a job, i.e. calls of
+     * processedAmount(), percent() and speed() for it. Updates arriving in between are
+     * coalesced, only the latest value of each is passed on once the interval elapsed.
+     * Pending updates of a job are passed on before it is suspended or finished.
+     *
+     * Use this if every update is expensive, e.g. sent to another process.
+     * The default of 0 passes on every update at once.
+     *
+     * @param msecs the interval in milliseconds, for example 100 for at most 10 updates per second
+     * @since 6.0
+     */
+    void setProgressUpdateInterval(int msecs);
+
+    /**
+     * @return the minimum interval between two progress updates of a job in milliseconds
+     * @see setProgressUpdateInterval()
+     * @since 6.0
+     */
+    int progressUpdateInterval() const;
+
+    /**
+     * Registers @p jobs as children of @p parent, e.g. the subjobs of a KCompositeJob,
+     * all in one go.
+     *
+     * The children are not tracked one by one, none of the protected slots is called
+     * for them. Their processed and total amounts are added to the ones of @p parent
+     * instead, which the slots get as the amounts of @p parent, along with a percentage
+     * computed from these sums. childJobsChanged() tells how many of the children
+     * finished. So a tracker shows a single entry for @p parent, and its overhead
+     * doesn't grow with the number of children.
+     *
+     * @p parent is meant to be registered with registerJob() as well. Children are
+     * unregistered once they finish, with unregisterJobs(), or when @p parent is
+     * unregistered.
+     *
+     * @param parent the job the children belong to
+     * @param jobs the children to register
+     * @see parentJob()
+     * @since 6.0
+     */
+    void registerChildJobs(KJob *parent, const QList<KJob *> &jobs);
+
+    /**
+     * Unregisters many jobs in one go, the children registered with registerChildJobs()
+     * as well as the jobs registered with registerJob(). Unregistered children that
+     * didn't finish no longer count towards the amounts of their parent.
+     *
+     * @param jobs the jobs to unregister
+     * @since 6.0
+     */
+    void unregisterJobs(const QList<KJob *> &jobs);
+
+    /**
+     * @return the parent @p job was registered with by registerChildJobs(), or @c nullptr
+     * @since 6.0
+     */
+    KJob *parentJob(KJob *job) const;
+
 public Q_SLOTS:
     /**
      * Register a new job in this tracker.
@@ -172,7 +231,20 @@ protected Q_SLOTS:
      */
     virtual void speed(KJob *job, unsigned long value);
 
+    /**
+     * Called when children of @p job were registered, unregistered or finished,
+     * see registerChildJobs(). Like the progress, this is coalesced as set with
+     * setProgressUpdateInterval().
+     *
+     * @param job the parent of the children
+     * @param finishedCount how many of the children finished
+     * @param totalCount how many children were registered and not unregistered before they finished
+     * @since 6.0
+     */
+    virtual void childJobsChanged(KJob *job, int finishedCount, int totalCount);
+
 private:
+    friend class KJobTrackerInterfacePrivate;
     std::unique_ptr<class KJobTrackerInterfacePrivate> const d;
 };
 
@@ -0,0 +1,207 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kthreadedjob.h"
+
+#include "kcancellationtoken_p.h"
+#include "kjob_p.h"
+
+#include <QMutex>
+#include <QThreadPool>
+
+#include <atomic>
+#include <bitset>
+
+// Shared between the job and its work, which may outlive the job
+struct KThreadedJobState {
+    bool isCanceled() const
+    {
+        return canceled || (cancellationToken && cancellationToken->isCanceled);
+    }
+
+    std::atomic<bool> canceled = false;
+    // The token of the job when it was started, checked directly as killing the job takes a round trip through its thread
+    std::shared_ptr<KCancellationTokenPrivate> cancellationToken;
+
+    QMutex mutex;
+    // Guarded by mutex, reset when the job is destroyed
+    KThreadedJob *job = nullptr;
+    std::array<KJobPrivate::Amounts, KJob::UnitsCount> amounts;
+    std::bitset<KJob::UnitsCount> changedProcessedAmounts;
+    std::bitset<KJob::UnitsCount> changedTotalAmounts;
+    // Whether passing the changes on to the job is queued already
+    bool updateQueued = false;
+    int error = KJob::NoError;
+    QString errorText;
+};
+
+class KThreadedJobPrivate : public KJobPrivate
+{
+public:
+    // Passes the changes of the work on to the job, in its thread
+    void applyUpdate();
+    // Queues applyUpdate(), state->mutex has to be locked
+    static void queueUpdate(KThreadedJobState *state);
+    void workDone();
+
+    std::function<void(KThreadedJob::Context &)> work;
+    std::shared_ptr<KThreadedJobState> state = std::make_shared<KThreadedJobState>();
+    QThreadPool *threadPool = nullptr;
+
+    Q_DECLARE_PUBLIC(KThreadedJob)
+};
+
+void KThreadedJobPrivate::applyUpdate()
+{
+    Q_Q(KThreadedJob);
+    std::array<Amounts, KJob::UnitsCount> amounts;
+    std::bitset<KJob::UnitsCount> changedProcessedAmounts;
+    std::bitset<KJob::UnitsCount> changedTotalAmounts;
+    {
+        QMutexLocker locker(&state->mutex);
+        state->updateQueued = false;
+        amounts = state->amounts;
+        std::swap(changedProcessedAmounts, state->changedProcessedAmounts);
+        std::swap(changedTotalAmounts, state->changedTotalAmounts);
+    }
+    if (isFinished) {
+        return;
+    }
+    for (int unit = 0; unit < KJob::UnitsCount; ++unit) {
+        if (changedTotalAmounts.test(unit)) {
+            q->setTotalAmount(KJob::Unit(unit), amounts[unit].totalAmount);
+        }
+        if (changedProcessedAmounts.test(unit)) {
+            q->setProcessedAmount(KJob::Unit(unit), amounts[unit].processedAmount);
+        }
+    }
+}
+
+void KThreadedJobPrivate::queueUpdate(KThreadedJobState *state)
+{
+    if (state->job && !state->updateQueued) {
+        state->updateQueued = true;
+        KThreadedJob *job = state->job;
+        QMetaObject::invokeMethod(
+            job,
+            [job]() {
+                job->d_func()->applyUpdate();
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+void KThreadedJobPrivate::workDone()
+{
+    Q_Q(KThreadedJob);
+    applyUpdate();
+    if (isFinished) {
+        return;
+    }
+    {
+        QMutexLocker locker(&state->mutex);
+        q->setError(state->error);
+        q->setErrorText(state->errorText);
+    }
+    q->emitResult();
+}
+
+KThreadedJob::Context::Context(const std::shared_ptr<KThreadedJobState> &state)
+    : m_state(state)
+{
+}
+
+bool KThreadedJob::Context::isCanceled() const
+{
+    return m_state->isCanceled();
+}
+
+void KThreadedJob::Context::setProcessedAmount(KJob::Unit unit, qulonglong amount)
+{
+    if (unit >= KJob::UnitsCount) {
+        return;
+    }
+    QMutexLocker locker(&m_state->mutex);
+    m_state->amounts[unit].processedAmount = amount;
+    m_state->changedProcessedAmounts.set(unit);
+    KThreadedJobPrivate::queueUpdate(m_state.get());
+}
+
+void KThreadedJob::Context::setTotalAmount(KJob::Unit unit, qulonglong amount)
+{
+    if (unit >= KJob::UnitsCount) {
+        return;
+    }
+    QMutexLocker locker(&m_state->mutex);
+    m_state->amounts[unit].totalAmount = amount;
+    m_state->changedTotalAmounts.set(unit);
+    KThreadedJobPrivate::queueUpdate(m_state.get());
+}
+
+void KThreadedJob::Context::setError(int errorCode, const QString &errorText)
+{
+    QMutexLocker locker(&m_state->mutex);
+    m_state->error = errorCode;
+    m_state->errorText = errorText;
+}
+
+KThreadedJob::KThreadedJob(const std::function<void(Context &)> &work, QObject *parent)
+    : KJob(*new KThreadedJobPrivate, parent)
+{
+    Q_D(KThreadedJob);
+    d->work = work;
+    d->state->job = this;
+    setCapabilities(Killable);
+}
+
+KThreadedJob::~KThreadedJob()
+{
+    Q_D(KThreadedJob);
+    d->state->canceled = true;
+    QMutexLocker locker(&d->state->mutex);
+    d->state->job = nullptr;
+}
+
+void KThreadedJob::setThreadPool(QThreadPool *pool)
+{
+    Q_D(KThreadedJob);
+    d->threadPool = pool;
+}
+
+void KThreadedJob::start()
+{
+    Q_D(KThreadedJob);
+    QThreadPool *pool = d->threadPool ? d->threadPool : QThreadPool::globalInstance();
+    if (d->cancellationToken) {
+        d->state->cancellationToken = d->cancellationToken->d;
+    }
+    pool->start(
+        [state = d->state, work = d->work]() {
+            if (!state->isCanceled()) {
+                Context context(state);
+                work(context);
+            }
+            QMutexLocker locker(&state->mutex);
+            if (KThreadedJob *job = state->job) {
+                QMetaObject::invokeMethod(
+                    job,
+                    [job]() {
+                        job->d_func()->workDone();
+                    },
+                    Qt::QueuedConnection);
+            }
+        },
+        priority());
+}
+
+bool KThreadedJob::doKill()
+{
+    Q_D(KThreadedJob);
+    d->state->canceled = true;
+    return true;
+}
+
+#include "moc_kthreadedjob.cpp"
@@ -0,0 +1,122 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KTHREADEDJOB_H
+#define KTHREADEDJOB_H
+
+#include <kcoreaddons_export.h>
+#include <kjob.h>
+
+#include <functional>
+#include <memory>
+
+class QThreadPool;
+class KThreadedJobPrivate;
+struct KThreadedJobState;
+
+/**
+ * @class KThreadedJob kthreadedjob.h KThreadedJob
+ *
+ * A job running a function on a thread pool, for CPU-bound work like hashing
+ * or decoding which would otherwise block the thread of the job.
+ *
+ * The function gets a Context to report progress and errors, which are passed
+ * on to the job in its thread. Progress reported faster than the job's thread
+ * handles it is coalesced to the latest values. Killing the job only marks the
+ * work as canceled, the function is expected to check Context::isCanceled()
+ * regularly and return early.
+ *
+ * The work is queued on the thread pool with the priority() of the job. If the
+ * cancellation token of the job is canceled before the work runs, it is skipped.
+ *
+ * @code
+ * auto job = new KThreadedJob([data](KThreadedJob::Context &context) {
+ *     context.setTotalAmount(KJob::Bytes, data.size());
+ *     for (qsizetype offset = 0; offset < data.size() && !context.isCanceled(); offset += 4096) {
+ *         // ... process data.mid(offset, 4096)
+ *         context.setProcessedAmount(KJob::Bytes, offset);
+ *     }
+ * });
+ * connect(job, &KJob::result, this, &MyClass::slotHashed);
+ * job->start();
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KThreadedJob : public KJob
+{
+    Q_OBJECT
+
+public:
+    /**
+     * The interface of the work function to the job.
+     * Its members can be called from any thread.
+     */
+    class KCOREADDONS_EXPORT Context
+    {
+    public:
+        /**
+         * @return whether the job was killed or its cancellation token was canceled,
+         * the work function should return then
+         */
+        bool isCanceled() const;
+
+        /**
+         * Sets the processed amount of the job, see KJob::setProcessedAmount()
+         */
+        void setProcessedAmount(KJob::Unit unit, qulonglong amount);
+
+        /**
+         * Sets the total amount of the job, see KJob::setTotalAmount()
+         */
+        void setTotalAmount(KJob::Unit unit, qulonglong amount);
+
+        /**
+         * Sets the error of the job, which is set once the work function returned
+         */
+        void setError(int errorCode, const QString &errorText = QString());
+
+    private:
+        friend class KThreadedJob;
+        explicit Context(const std::shared_ptr<KThreadedJobState> &state);
+        std::shared_ptr<KThreadedJobState> m_state;
+    };
+
+    /**
+     * Creates a job running @p work once started.
+     *
+     * @param work the function to run on the thread pool
+     * @param parent the parent QObject
+     */
+    explicit KThreadedJob(const std::function<void(Context &)> &work, QObject *parent = nullptr);
+
+    /**
+     * Destroys the job, canceling the work if it is still running.
+     */
+    ~KThreadedJob() override;
+
+    /**
+     * Sets the thread pool to run the work on, QThreadPool::globalInstance() by default.
+     * This has to be called before start().
+     */
+    void setThreadPool(QThreadPool *pool);
+
+    /**
+     * Starts running the work function on the thread pool.
+     */
+    void start() override;
+
+protected:
+    /**
+     * Marks the work as canceled and finishes the job.
+     */
+    bool doKill() override;
+
+private:
+    Q_DECLARE_PRIVATE(KThreadedJob)
+};
+
+#endif
@@ -22,12 +22,14 @@
 #include <QJsonObject>
 #include <QList>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QSharedData>
 #include <QStandardPaths>
 #include <QTextStream>
 #include <QUrl>
 
 #include <algorithm>
+#include <optional>
 
 Q_DECLARE_LOGGING_CATEGORY(KABOUTDATA)
 // logging category for this framework, default: log stuff >= warning
@@ -205,6 +207,37 @@ void KAboutLicense::setLicenseFromText(const QString &licenseText)
     d->_licenseText = licenseText;
 }
 
+static QString readLicenseFile(const QString &pathToFile)
+{
+    QFile file(pathToFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QTextStream str(&file);
+    return str.readAll();
+}
+
+// The texts of the licenses installed in kf6/licenses/, looked up and read once per process
+// and shared by all KAboutLicense instances. Returns nullopt when the license isn't installed.
+static std::optional<QString> installedLicenseText(const QString &fileName)
+{
+    static QMutex mutex;
+    static QHash<QString, QString> texts;
+
+    QMutexLocker locker(&mutex);
+    if (const auto it = texts.constFind(fileName); it != texts.cend()) {
+        return it.value();
+    }
+    const QString pathToFile = QStandardPaths::locate(QStandardPaths::GenericDataLocation, QStringLiteral("kf6/licenses/") + fileName);
+    if (pathToFile.isEmpty()) {
+        // Not remembered, it may still get installed
+        return std::nullopt;
+    }
+    const QString text = readLicenseFile(pathToFile);
+    texts.insert(fileName, text);
+    return text;
+}
+
 QString KAboutLicense::text() const
 {
     QString result;
@@ -268,19 +301,13 @@ QString KAboutLicense::text() const
     }
 
     if (knownLicense) {
-        pathToFile = QStandardPaths::locate(QStandardPaths::GenericDataLocation, QStringLiteral("kf6/licenses/") + pathToFile);
+        const std::optional<QString> licenseText = installedLicenseText(pathToFile);
         result += QCoreApplication::translate("KAboutLicense", "This program is distributed under the terms of the %1.").arg(name(KAboutLicense::ShortName));
-        if (!pathToFile.isEmpty()) {
-            result += lineFeed;
-        }
-    }
-
-    if (!pathToFile.isEmpty()) {
-        QFile file(pathToFile);
-        if (file.open(QIODevice::ReadOnly)) {
-            QTextStream str(&file);
-            result += str.readAll();
+        if (licenseText.has_value()) {
+            result += lineFeed + *licenseText;
         }
+    } else if (!pathToFile.isEmpty()) {
+        result += readLicenseFile(pathToFile);
     }
 
     return result;
@@ -12,8 +12,35 @@
 #include "kpluginfactory_p.h"
 
 #include "kcoreaddons_debug.h"
+#include "kplugintrace_p.h"
+#include <QCoreApplication>
+#include <QMutex>
 #include <QPluginLoader>
+#include <QPromise>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
 #include <algorithm>
+#include <map>
+#include <memory>
+
+// Loading libraries is serialized by the dynamic linker anyway, one thread is enough
+static QThreadPool *libraryLoaderPool()
+{
+    static QThreadPool pool;
+    static const bool initialized = [] {
+        pool.setMaxThreadCount(1);
+        pool.setThreadPriority(QThread::LowPriority);
+        return true;
+    }();
+    Q_UNUSED(initialized)
+    return &pool;
+}
+
+// Preloading yields to the libraries which are waited for
+static const int s_preloadPriority = 0;
+static const int s_loadFactoryAsyncPriority = 1;
 
 KPluginFactory::KPluginFactory()
     : d(new KPluginFactoryPrivate)
@@ -22,26 +49,27 @@ KPluginFactory::KPluginFactory()
 
 KPluginFactory::~KPluginFactory() = default;
 
-KPluginFactory::Result<KPluginFactory> KPluginFactory::loadFactory(const KPluginMetaData &data)
+// Loads the factory of the plugin described by @p data, using @p loader unless it is a static plugin
+static KPluginFactory::Result<KPluginFactory> loadFactoryWith(const KPluginMetaData &data, QPluginLoader &loader)
 {
-    Result<KPluginFactory> result;
+    KPluginFactory::Result<KPluginFactory> result;
     QObject *obj = nullptr;
     if (data.isStaticPlugin()) {
         obj = data.staticPlugin().instance();
     } else {
         if (data.fileName().isEmpty()) {
-            result.errorString = tr("Could not find plugin %1").arg(data.requestedFileName());
+            result.errorString = KPluginFactory::tr("Could not find plugin %1").arg(data.requestedFileName());
             result.errorText = QStringLiteral("Could not find plugin %1").arg(data.requestedFileName());
-            result.errorReason = INVALID_PLUGIN;
+            result.errorReason = KPluginFactory::INVALID_PLUGIN;
             qCWarning(KCOREADDONS_DEBUG) << result.errorText;
             return result;
         }
-        QPluginLoader loader(data.fileName());
+        loader.setFileName(data.fileName());
         obj = loader.instance();
         if (!obj) {
-            result.errorString = tr("Could not load plugin from %1: %2").arg(data.fileName(), loader.errorString());
+            result.errorString = KPluginFactory::tr("Could not load plugin from %1: %2").arg(data.fileName(), loader.errorString());
             result.errorText = QStringLiteral("Could not load plugin from %1: %2").arg(data.fileName(), loader.errorString());
-            result.errorReason = INVALID_PLUGIN;
+            result.errorReason = KPluginFactory::INVALID_PLUGIN;
             qCWarning(KCOREADDONS_DEBUG) << result.errorText;
             return result;
         }
@@ -50,8 +78,8 @@ KPluginFactory::Result<KPluginFactory> KPluginFactory::loadFactory(const KPlugin
     KPluginFactory *factory = qobject_cast<KPluginFactory *>(obj);
 
     if (factory == nullptr) {
-        result.errorString = tr("The library %1 does not offer a KPluginFactory.").arg(data.fileName());
-        result.errorReason = INVALID_FACTORY;
+        result.errorString = KPluginFactory::tr("The library %1 does not offer a KPluginFactory.").arg(data.fileName());
+        result.errorReason = KPluginFactory::INVALID_FACTORY;
         qCWarning(KCOREADDONS_DEBUG) << "Expected a KPluginFactory, got a" << obj->metaObject()->className();
         delete obj;
         return result;
@@ -62,6 +90,272 @@ KPluginFactory::Result<KPluginFactory> KPluginFactory::loadFactory(const KPlugin
     return result;
 }
 
+KPluginFactory::Result<KPluginFactory> KPluginFactory::loadFactory(const KPluginMetaData &data)
+{
+    const KPluginTrace::Scope trace(KPluginTrace::FactoryLoad, data.fileName());
+    QPluginLoader loader;
+    return loadFactoryWith(data, loader);
+}
+
+QFuture<KPluginFactory::Result<KPluginFactory>> KPluginFactory::loadFactoryAsync(const KPluginMetaData &data)
+{
+    if (data.isStaticPlugin() || data.fileName().isEmpty()) {
+        // Nothing to load, also reporting errors right away
+        QPromise<Result<KPluginFactory>> promise;
+        promise.start();
+        promise.addResult(loadFactory(data));
+        promise.finish();
+        return promise.future();
+    }
+
+    auto loaded = std::make_shared<QPromise<void>>();
+    loaded->start();
+    const QString fileName = data.fileName();
+    libraryLoaderPool()->start(
+        [loaded, fileName] {
+            // The library stays loaded after the loader is gone, instance() then only resolves the root object
+            QPluginLoader loader(fileName);
+            loader.load();
+            loaded->finish();
+        },
+        s_loadFactoryAsyncPriority);
+
+    // Lives in the calling thread, so that the continuation runs there
+    auto context = new QObject;
+    return loaded->future().then(context, [data, context] {
+        context->deleteLater();
+        return loadFactory(data);
+    });
+}
+
+void KPluginFactory::preload(const QList<KPluginMetaData> &plugins)
+{
+    for (const KPluginMetaData &data : plugins) {
+        if (data.isStaticPlugin() || data.fileName().isEmpty()) {
+            continue;
+        }
+        const QString fileName = data.fileName();
+        libraryLoaderPool()->start(
+            [fileName] {
+                QPluginLoader loader(fileName);
+                if (!loader.load()) {
+                    qCDebug(KCOREADDONS_DEBUG) << "Could not preload plugin" << fileName << loader.errorString();
+                }
+            },
+            s_preloadPriority);
+    }
+}
+
+namespace
+{
+// A library loaded through loadFactoryHandle(). Unloaded once neither
+// handles nor the objects created through them refer to it for its idle
+// timeout.
+struct LoadedLibrary {
+    std::unique_ptr<QPluginLoader> loader; // null while unloaded
+    KPluginFactory *factory = nullptr;
+    std::chrono::milliseconds idleTimeout{0};
+    int handles = 0;
+    int instances = 0;
+    int loadCount = 0;
+    quint64 generation = 0; // bumped whenever the library becomes unused
+    QThread *loadingThread = nullptr; // set while loaded without the mutex held
+};
+
+// Guarded by s_managedLibrariesMutex, keyed by file name. The entries stay
+// for the statistics, and they must not move as handles point to them.
+using LoadedLibraries = std::map<QString, LoadedLibrary>;
+Q_GLOBAL_STATIC(LoadedLibraries, s_managedLibraries)
+QMutex s_managedLibrariesMutex;
+// Woken whenever a library finished loading
+QWaitCondition s_libraryLoaded;
+
+void unloadIfUnused(const QString &fileName, quint64 generation)
+{
+    const QMutexLocker locker(&s_managedLibrariesMutex);
+    if (s_managedLibraries.isDestroyed()) {
+        return;
+    }
+    const auto it = s_managedLibraries->find(fileName);
+    if (it == s_managedLibraries->end()) {
+        return;
+    }
+    LoadedLibrary &library = it->second;
+    if (library.generation != generation || library.handles > 0 || library.instances > 0 || !library.loader) {
+        return;
+    }
+
+    // Only really unloads, deleting the factory, if nothing else loaded the library as well
+    qCDebug(KCOREADDONS_DEBUG) << "Unloading unused plugin" << fileName;
+    library.loader->unload();
+    library.loader.reset();
+    library.factory = nullptr;
+}
+
+// Drops a reference of the library named @p fileName, with the mutex held
+void releaseLocked(const QString &fileName, LoadedLibrary &library)
+{
+    if (library.handles > 0 || library.instances > 0 || !library.loader) {
+        return;
+    }
+
+    // Without an application there is no event loop to unload in, keep it around then
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+
+    const quint64 generation = ++library.generation;
+    const std::chrono::milliseconds idleTimeout = library.idleTimeout;
+    QMetaObject::invokeMethod(
+        app,
+        [fileName, generation, idleTimeout] {
+            QTimer::singleShot(idleTimeout, QCoreApplication::instance(), [fileName, generation] {
+                unloadIfUnused(fileName, generation);
+            });
+        },
+        Qt::QueuedConnection);
+}
+}
+
+class KPluginFactoryHandlePrivate
+{
+public:
+    ~KPluginFactoryHandlePrivate()
+    {
+        if (!library) {
+            return;
+        }
+        const QMutexLocker locker(&s_managedLibrariesMutex);
+        --library->handles;
+        releaseLocked(fileName, *library);
+    }
+
+    KPluginFactory::Result<KPluginFactory> result;
+    // Null for static plugins and if loading failed
+    LoadedLibrary *library = nullptr;
+    QString fileName;
+};
+
+KPluginFactory::Handle::Handle() = default;
+KPluginFactory::Handle::~Handle() = default;
+KPluginFactory::Handle::Handle(const Handle &other) = default;
+KPluginFactory::Handle::Handle(Handle &&other) noexcept = default;
+KPluginFactory::Handle &KPluginFactory::Handle::operator=(const Handle &other) = default;
+KPluginFactory::Handle &KPluginFactory::Handle::operator=(Handle &&other) noexcept = default;
+
+bool KPluginFactory::Handle::isValid() const
+{
+    return d && d->result.plugin;
+}
+
+KPluginFactory *KPluginFactory::Handle::factory() const
+{
+    return d ? d->result.plugin : nullptr;
+}
+
+QString KPluginFactory::Handle::errorString() const
+{
+    return d ? d->result.errorString : QString();
+}
+
+QString KPluginFactory::Handle::errorText() const
+{
+    return d ? d->result.errorText : QString();
+}
+
+KPluginFactory::ResultErrorReason KPluginFactory::Handle::errorReason() const
+{
+    return d ? d->result.errorReason : INVALID_PLUGIN;
+}
+
+void KPluginFactory::Handle::track(QObject *instance) const
+{
+    if (!d->library) {
+        return;
+    }
+
+    const QMutexLocker locker(&s_managedLibrariesMutex);
+    ++d->library->instances;
+    QObject::connect(instance, &QObject::destroyed, [library = d->library, fileName = d->fileName] {
+        const QMutexLocker locker(&s_managedLibrariesMutex);
+        if (s_managedLibraries.isDestroyed()) {
+            return;
+        }
+        --library->instances;
+        releaseLocked(fileName, *library);
+    });
+}
+
+KPluginFactory::Handle KPluginFactory::loadFactoryHandle(const KPluginMetaData &data, std::chrono::milliseconds idleTimeout)
+{
+    Handle handle;
+    handle.d = std::make_shared<KPluginFactoryHandlePrivate>();
+    if (data.isStaticPlugin() || data.fileName().isEmpty()) {
+        handle.d->result = loadFactory(data);
+        return handle;
+    }
+
+    QMutexLocker locker(&s_managedLibrariesMutex);
+    LoadedLibrary &library = (*s_managedLibraries)[data.fileName()];
+    library.idleTimeout = idleTimeout;
+    while (library.loadingThread) {
+        // The plugin asked for itself while being loaded
+        if (library.loadingThread == QThread::currentThread()) {
+            handle.d->result.errorString = KPluginFactory::tr("The plugin %1 is already being loaded.").arg(data.fileName());
+            handle.d->result.errorText = QStringLiteral("The plugin %1 is already being loaded.").arg(data.fileName());
+            handle.d->result.errorReason = KPluginFactory::INVALID_PLUGIN;
+            return handle;
+        }
+        s_libraryLoaded.wait(&s_managedLibrariesMutex);
+    }
+    if (library.loader) {
+        library.factory->setMetaData(data);
+        handle.d->result.plugin = library.factory;
+    } else {
+        // Loaded with the mutex released, so that the plugin may load other plugins,
+        // and other libraries can be used meanwhile. Other threads asking for this
+        // one wait for the result.
+        library.loadingThread = QThread::currentThread();
+        locker.unlock();
+        auto loader = std::make_unique<QPluginLoader>();
+        {
+            const KPluginTrace::Scope trace(KPluginTrace::FactoryLoad, data.fileName());
+            handle.d->result = loadFactoryWith(data, *loader);
+        }
+        locker.relock();
+        library.loadingThread = nullptr;
+        s_libraryLoaded.wakeAll();
+        if (!handle.d->result) {
+            return handle;
+        }
+        library.loader = std::move(loader);
+        library.factory = handle.d->result.plugin;
+        ++library.loadCount;
+    }
+
+    ++library.handles;
+    handle.d->library = &library;
+    handle.d->fileName = data.fileName();
+    return handle;
+}
+
+QList<KPluginFactory::ManagedLibrary> KPluginFactory::managedLibraries()
+{
+    QList<ManagedLibrary> result;
+    const QMutexLocker locker(&s_managedLibrariesMutex);
+    for (const auto &[fileName, library] : *s_managedLibraries) {
+        ManagedLibrary info;
+        info.fileName = fileName;
+        info.isLoaded = library.loader != nullptr;
+        info.handleCount = library.handles;
+        info.instanceCount = library.instances;
+        info.loadCount = library.loadCount;
+        result.append(info);
+    }
+    return result;
+}
+
 KPluginMetaData KPluginFactory::metaData() const
 {
     return d->metaData;
@@ -78,27 +372,34 @@ void KPluginFactory::registerPlugin(const QMetaObject *metaObject, CreateInstanc
     const QMetaObject *superClass = metaObject->superClass();
     Q_ASSERT(superClass);
 
-    for (const KPluginFactoryPrivate::PluginWithMetadata &plugin : d->createInstanceWithMetaDataHash) {
-        for (const QMetaObject *otherSuper = plugin.first->superClass(); otherSuper; otherSuper = otherSuper->superClass()) {
-            if (superClass == otherSuper) {
-                qCWarning(KCOREADDONS_DEBUG).nospace() << "Two plugins with the same interface (" << superClass->className()
-                                                       << ") were registered in the KPluginFactory " << this->metaObject()->className() << ". "
-                                                       << "This might be due to a missing Q_OBJECT macro in one of the registered classes";
-            }
+    const auto warnAmbiguous = [this](const QMetaObject *sharedInterface) {
+        qCWarning(KCOREADDONS_DEBUG).nospace() << "Two plugins with the same interface (" << sharedInterface->className() << ") were registered in the KPluginFactory "
+                                               << this->metaObject()->className() << ". "
+                                               << "This might be due to a missing Q_OBJECT macro in one of the registered classes";
+    };
+
+    // check the interface of the newly registered plugin against the hierarchies of all registered classes
+    if (d->pluginSuperClasses.contains(superClass)) {
+        warnAmbiguous(superClass);
+    }
+    // check hierarchy of newly registered plugin against the interfaces of all registered classes
+    for (const QMetaObject *otherSuper = superClass; otherSuper; otherSuper = otherSuper->superClass()) {
+        if (d->pluginInterfaces.contains(otherSuper)) {
+            warnAmbiguous(otherSuper);
         }
     }
-    // check hierarchy of newly newly registered plugin against all registered classes
-    for (const KPluginFactoryPrivate::PluginWithMetadata &plugin : d->createInstanceWithMetaDataHash) {
-        superClass = plugin.first->superClass();
-        for (const QMetaObject *otherSuper = metaObject->superClass(); otherSuper; otherSuper = otherSuper->superClass()) {
-            if (superClass == otherSuper) {
-                qCWarning(KCOREADDONS_DEBUG).nospace() << "Two plugins with the same interface (" << superClass->className()
-                                                       << ") were registered in the KPluginFactory " << this->metaObject()->className() << ". "
-                                                       << "This might be due to a missing Q_OBJECT macro in one of the registered classes";
-            }
+
+    d->pluginInterfaces.insert(superClass);
+    for (const QMetaObject *current = metaObject; current; current = current->superClass()) {
+        if (current != metaObject) {
+            d->pluginSuperClasses.insert(current);
+        }
+        // create() picks the first registered plugin implementing an interface
+        const QByteArray className(current->className());
+        if (!d->instanceFunctionsByInterface.contains(className)) {
+            d->instanceFunctionsByInterface.insert(className, instanceFunction);
         }
     }
-    d->createInstanceWithMetaDataHash.push_back({metaObject, instanceFunction});
 }
 
 void KPluginFactory::logFailedInstantiationMessage(KPluginMetaData data)
@@ -112,15 +413,17 @@ void KPluginFactory::logFailedInstantiationMessage(const char *className, KPlugi
 
 QObject *KPluginFactory::create(const char *iface, QWidget *parentWidget, QObject *parent, const QVariantList &args)
 {
-    for (const KPluginFactoryPrivate::PluginWithMetadata &plugin : d->createInstanceWithMetaDataHash) {
-        for (const QMetaObject *current = plugin.first; current; current = current->superClass()) {
-            if (0 == qstrcmp(iface, current->className())) {
-                return plugin.second(parentWidget, parent, d->metaData, args);
-            }
-        }
+    if (!iface) {
+        return nullptr;
+    }
+
+    const auto it = d->instanceFunctionsByInterface.constFind(QByteArray::fromRawData(iface, qstrlen(iface)));
+    if (it == d->instanceFunctionsByInterface.cend()) {
+        return nullptr;
     }
 
-    return nullptr;
+    const KPluginTrace::Scope trace(KPluginTrace::PluginCreation, d->metaData.fileName());
+    return it.value()(parentWidget, parent, d->metaData, args);
 }
 
 #include "moc_kpluginfactory.cpp"
@@ -14,14 +14,17 @@
 #include "kcoreaddons_export.h"
 #include "kpluginmetadata.h"
 
+#include <QFuture>
 #include <QObject>
 #include <QVariant>
 
+#include <chrono>
 #include <memory>
 #include <type_traits>
 
 class QWidget;
 class KPluginFactoryPrivate;
+class KPluginFactoryHandlePrivate;
 
 namespace KParts
 {
@@ -338,6 +341,128 @@ public:
         }
     };
 
+    /**
+     * A reference to a factory loaded by loadFactoryHandle(), which keeps the library of the
+     * plugin loaded. Copies refer to the same factory.
+     *
+     * The library also remains loaded while objects created through create() exist, objects
+     * created directly through factory() are not accounted for.
+     * @since 6.0
+     */
+    class KCOREADDONS_EXPORT Handle
+    {
+    public:
+        /**
+         * Creates an invalid handle.
+         */
+        Handle();
+        ~Handle();
+        Handle(const Handle &other);
+        Handle(Handle &&other) noexcept;
+        Handle &operator=(const Handle &other);
+        Handle &operator=(Handle &&other) noexcept;
+
+        /**
+         * @return Whether the factory was loaded.
+         */
+        bool isValid() const;
+
+        explicit operator bool() const
+        {
+            return isValid();
+        }
+
+        /**
+         * @return The factory, valid as long as this handle or any object created through
+         * create() exists. Null if loading the factory failed.
+         */
+        KPluginFactory *factory() const;
+
+        /// translated, user-visible error string if loading the factory failed
+        QString errorString() const;
+        /// untranslated error text if loading the factory failed
+        QString errorText() const;
+        ResultErrorReason errorReason() const;
+
+        /**
+         * Creates an object like KPluginFactory::create(), and keeps the library of the
+         * plugin loaded until the object is destroyed.
+         */
+        template<typename T>
+        T *create(QObject *parent = nullptr, const QVariantList &args = {}) const
+        {
+            T *t = isValid() ? factory()->create<T>(parent, args) : nullptr;
+            if (t) {
+                track(t);
+            }
+            return t;
+        }
+
+        /**
+         * Same as above, with an additional @p parentWidget argument used by some plugins.
+         */
+        template<typename T>
+        T *create(QWidget *parentWidget, QObject *parent, const QVariantList &args = {}) const
+        {
+            T *t = isValid() ? factory()->create<T>(parentWidget, parent, args) : nullptr;
+            if (t) {
+                track(t);
+            }
+            return t;
+        }
+
+    private:
+        friend class KPluginFactory;
+        void track(QObject *instance) const;
+        std::shared_ptr<KPluginFactoryHandlePrivate> d;
+    };
+
+    /**
+     * Describes a library loaded through loadFactoryHandle(), see managedLibraries().
+     * @since 6.0
+     */
+    struct ManagedLibrary {
+        QString fileName; ///< The file name of the library
+        bool isLoaded = false; ///< Whether the library is currently loaded
+        int handleCount = 0; ///< The number of handles referring to its factory
+        int instanceCount = 0; ///< The number of objects created through those handles that still exist
+        int loadCount = 0; ///< How often the library was loaded, i.e. unloaded and loaded again plus one
+    };
+
+    /**
+     * Loads the factory like loadFactory(), but returns a handle which allows to unload the
+     * library of the plugin again when it's no longer used.
+     *
+     * Once every handle to the factory and every object created through them have been
+     * destroyed, the library is unloaded after it stayed unused for @p idleTimeout. This
+     * requires a running event loop in the main thread. The factory is loaded again by the
+     * next call for the same plugin.
+     *
+     * This is meant for plugins used only briefly in long running processes, e.g. settings
+     * modules, to get rid of their code and data. Make sure nothing refers to code of the
+     * plugin when it's unloaded, e.g. objects not created through the handle or pending
+     * queued calls. Static plugins are never unloaded, and neither are libraries which are
+     * also loaded by other means, e.g. through loadFactory().
+     *
+     * @code
+        if (const auto handle = KPluginFactory::loadFactoryHandle(metaData)) {
+            auto module = handle.create<MyModule>(this);
+            // The library remains loaded until module is deleted
+        }
+     * @endcode
+     * @param data KPluginMetaData from which the plugin should be loaded
+     * @param idleTimeout Time for which the library is kept when it is no longer used.
+     * @since 6.0
+     */
+    static Handle loadFactoryHandle(const KPluginMetaData &data, std::chrono::milliseconds idleTimeout = std::chrono::seconds(30));
+
+    /**
+     * @return The libraries ever loaded through loadFactoryHandle(), including the ones which
+     * have been unloaded since.
+     * @since 6.0
+     */
+    static QList<ManagedLibrary> managedLibraries();
+
     /**
      * Attempts to load the KPluginFactory from the given metadata.
      * The errors will be logged using the `kf.coreaddons` debug category.
@@ -347,6 +472,33 @@ public:
      */
     static Result<KPluginFactory> loadFactory(const KPluginMetaData &data);
 
+    /**
+     * Like loadFactory(), but the library of the plugin is loaded on a worker thread, so that its relocations
+     * and static initializers don't block the calling thread.
+     * The returned future finishes in the calling thread, which needs to run an event loop, once the factory
+     * was created there. Like with loadFactory(), the factory lives in the thread it was created in.
+     * @code
+        KPluginFactory::loadFactoryAsync(metaData).then(this, [this](const KPluginFactory::Result<KPluginFactory> &result) {
+            if (result) {
+                // result.plugin contains the factory
+            }
+        });
+     * @endcode
+     * @param data KPluginMetaData from which the plugin should be loaded
+     * @return future holding the Result of loading the factory
+     * @since 6.0
+     */
+    static QFuture<Result<KPluginFactory>> loadFactoryAsync(const KPluginMetaData &data);
+
+    /**
+     * Loads the libraries of the given plugins on a low priority worker thread, without creating their factories.
+     * Use this during startup for plugins that are likely needed later on, so that loadFactory() doesn't have to wait
+     * for the library being loaded when the plugin is first used.
+     * Static plugins and plugins without a library are skipped.
+     * @since 6.0
+     */
+    static void preload(const QList<KPluginMetaData> &plugins);
+
     /**
      * Attempts to load the KPluginFactory and create a @p T instance from the given metadata
      * KCoreAddons will log error messages automatically, meaning you only need to implement your
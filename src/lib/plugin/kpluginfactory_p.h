@@ -14,12 +14,20 @@
 #include "kpluginfactory.h"
 #include <KPluginMetaData>
 
+#include <QHash>
+#include <QSet>
+
 class KPluginFactoryPrivate
 {
 public:
-    using PluginWithMetadata = QPair<const QMetaObject *, KPluginFactory::CreateInstanceWithMetaDataFunction>;
     KPluginMetaData metaData;
-    std::vector<PluginWithMetadata> createInstanceWithMetaDataHash;
+    // The first registered plugin implementing it, for the class name of
+    // each interface (including the plugin classes themselves)
+    QHash<QByteArray, KPluginFactory::CreateInstanceWithMetaDataFunction> instanceFunctionsByInterface;
+    // The direct superclasses of the registered plugins, and all of their
+    // superclasses, to detect ambiguous registrations
+    QSet<const QMetaObject *> pluginInterfaces;
+    QSet<const QMetaObject *> pluginSuperClasses;
 };
 
 #endif // KPLUGINFACTORY_P_H
@@ -8,41 +8,89 @@
 */
 
 #include "kpluginmetadata.h"
+#include "kpluginmetadatareader_p.h"
+#include "kplugintrace_p.h"
 #include "kstaticpluginhelpers_p.h"
+#include "ktracing_p.h"
 
 #include "kcoreaddons_debug.h"
 #include "kjsonutils.h"
+#include "kjsonutils_p.h"
+#include "kmemoryfootprint_p.h"
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QLocale>
 #include <QMimeDatabase>
+#include <QMutex>
 #include <QPluginLoader>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QThreadPool>
 
 #include "kaboutdata.h"
 
 #include <optional>
 #include <unordered_map>
 
-using PluginCache = std::unordered_map<QString, std::vector<KPluginMetaData>>;
+struct PluginNamespaceCache {
+    // The plugins by absolute file path
+    std::unordered_map<QString, KPluginMetaData> plugins;
+    // The modification time of every plugin directory when it was last listed
+    QHash<QString, qint64> directoryMtimes;
+};
+using PluginCache = std::unordered_map<QString, PluginNamespaceCache>;
 Q_GLOBAL_STATIC(PluginCache, s_pluginNamespaceCache)
 
+// The valid metadata of the static plugins of a namespace, built once for every set of options
+struct StaticPluginNamespaceCache {
+    int registrationCount = -1;
+    QList<KPluginMetaData> plugins;
+};
+using StaticPluginCache = QHash<std::pair<QString, int>, StaticPluginNamespaceCache>;
+Q_GLOBAL_STATIC(StaticPluginCache, s_staticPluginCache)
+Q_GLOBAL_STATIC(QMutex, s_staticPluginCacheMutex)
+
+// The keys of the index of KPluginMetaData::PersistentCache
+static const int s_indexVersion = 2;
+static const QLatin1String s_indexVersionKey("version");
+static const QLatin1String s_indexDirectoryKey("directory");
+static const QLatin1String s_indexPluginsKey("plugins");
+static const QLatin1String s_indexMimeTypesKey("mimeTypes");
+static const QLatin1String s_indexFormFactorsKey("formFactors");
+// of every plugin in "plugins", and of the directory too
+static const QLatin1String s_indexMtimeKey("mtime");
+static const QLatin1String s_indexFileKey("file");
+static const QLatin1String s_indexSizeKey("size");
+static const QLatin1String s_indexMetaDataKey("metadata");
+static const QLatin1String s_indexEnabledByDefaultKey("enabledByDefault");
+
 class KPluginMetaDataPrivate : public QSharedData
 {
 public:
     KPluginMetaDataPrivate(const QJsonObject &obj, const QString &fileName, KPluginMetaData::KPluginMetaDataOptions options = {})
         : m_metaData(obj)
         , m_rootObj(obj.value(QLatin1String("KPlugin")).toObject())
+        , m_mimeTypes(KJsonUtils::internedStrings(m_rootObj.value(QLatin1String("MimeTypes")).toVariant().toStringList()))
+        , m_formFactors(KJsonUtils::internedStrings(m_rootObj.value(QLatin1String("FormFactors")).toVariant().toStringList()))
         , m_fileName(fileName)
         , m_options(options)
     {
     }
     const QJsonObject m_metaData;
     const QJsonObject m_rootObj;
+    // Parsed once, as supportsMimeType() is called for many files, and
+    // interned, as many plugins have the same ones
+    const QStringList m_mimeTypes;
+    const QStringList m_formFactors;
     // If we want to load a file, but it does not exist we want to keep the requested file name for logging
     QString m_requestedFileName;
     const QString m_fileName;
@@ -53,7 +101,64 @@ public:
     QString m_pluginId;
     qint64 m_lastQueriedTs = 0;
 
-    static void forEachPlugin(const QString &directory, std::function<void(const QFileInfo &)> callback)
+    // The translated fields for the locale they were last looked up for,
+    // which saves looking through the keys of every language each time
+    struct TranslatedFields {
+        QLocale locale;
+        QString name;
+        QString description;
+        QString copyrightText;
+    };
+    TranslatedFields translatedFields() const
+    {
+        const QLocale locale;
+        QMutexLocker locker(&m_translatedFieldsMutex);
+        if (!m_translatedFields || m_translatedFields->locale != locale) {
+            const KJsonUtils::TranslatedKeyLookup lookup(locale);
+            const QList<QJsonValue> values = lookup.values(m_rootObj, {u"Name", u"Description", u"Copyright"});
+            m_translatedFields = TranslatedFields{
+                locale,
+                values.at(0).toString(),
+                values.at(1).toString(),
+                values.at(2).toString(),
+            };
+        }
+        return *m_translatedFields;
+    }
+    // KPluginMetaData objects sharing this may be used from several threads
+    mutable QMutex m_translatedFieldsMutex;
+    mutable std::optional<TranslatedFields> m_translatedFields;
+
+    // The value of @p key decoded from the metadata by @p decode, only the first time it is asked for,
+    // since plugin lists look up the same values over and over. std::nullopt stands for the default value.
+    template<typename T, typename Decode>
+    std::optional<T> cachedValue(QHash<QString, std::optional<T>> &values, const QString &key, Decode decode) const
+    {
+        QMutexLocker locker(&m_valuesMutex);
+        auto it = values.constFind(key);
+        if (it == values.cend()) {
+            // The keys are the same few property names for all plugins
+            it = values.insert(KJsonUtils::internedString(key), decode(m_metaData.value(key)));
+        }
+        return it.value();
+    }
+    mutable QMutex m_valuesMutex;
+    mutable QHash<QString, std::optional<QString>> m_stringValues;
+    mutable QHash<QString, std::optional<QStringList>> m_stringListValues;
+
+    // About the memory taken by @p metaData, counting the metadata as large as its JSON
+    static qint64 footprint(const KPluginMetaData &metaData)
+    {
+        const KPluginMetaDataPrivate *d = metaData.d.data();
+        if (!d) {
+            return 0;
+        }
+        return qint64(sizeof(KPluginMetaDataPrivate)) + QJsonDocument(d->m_metaData).toJson(QJsonDocument::Compact).size()
+            + KMemoryFootprintPrivate::stringBytes(d->m_fileName) + KMemoryFootprintPrivate::stringBytes(d->m_pluginId);
+    }
+
+    // The directories to look for plugins of the namespace @p directory in
+    static QStringList pluginDirectories(const QString &directory)
     {
         QStringList dirsToCheck;
 #ifdef Q_OS_ANDROID
@@ -74,22 +179,254 @@ public:
 #endif
 
         qCDebug(KCOREADDONS_DEBUG) << "Checking for plugins in" << dirsToCheck;
+        return dirsToCheck;
+    }
 
-        for (const QString &dir : std::as_const(dirsToCheck)) {
-            QDirIterator it(dir, QDir::Files);
-            while (it.hasNext()) {
-                it.next();
+    // Calls @p callback for the plugins of the namespace @p directory in @p dir
+    static void forEachPluginIn(const QString &directory, const QString &dir, const std::function<void(const QFileInfo &)> &callback)
+    {
+        QDirIterator it(dir, QDir::Files);
+        while (it.hasNext()) {
+            it.next();
 #ifdef Q_OS_ANDROID
-                QString prefix(QLatin1String("libplugins_") + QString(directory).replace(QLatin1Char('/'), QLatin1String("_")));
-                if (!prefix.endsWith(QLatin1Char('_'))) {
-                    prefix.append(QLatin1Char('_'));
-                }
-                if (it.fileName().startsWith(prefix) && QLibrary::isLibrary(it.fileName())) {
+            QString prefix(QLatin1String("libplugins_") + QString(directory).replace(QLatin1Char('/'), QLatin1String("_")));
+            if (!prefix.endsWith(QLatin1Char('_'))) {
+                prefix.append(QLatin1Char('_'));
+            }
+            if (it.fileName().startsWith(prefix) && QLibrary::isLibrary(it.fileName())) {
 #else
-                if (QLibrary::isLibrary(it.fileName())) {
+            Q_UNUSED(directory)
+            if (QLibrary::isLibrary(it.fileName())) {
 #endif
-                    callback(it.fileInfo());
+                callback(it.fileInfo());
+            }
+        }
+    }
+
+    /* The index of the plugins in a directory, see KPluginMetaData::PersistentCache.
+     * It is a CBOR map of the directory path, its modification time and an
+     * array with the file name, modification time, size and metadata of every
+     * plugin in it.
+     */
+    static QString indexFilePath(const QString &dir)
+    {
+        const QByteArray hash = QCryptographicHash::hash(QFile::encodeName(dir), QCryptographicHash::Sha1).toHex();
+        return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + QLatin1String("/kpluginmetadata/") + QString::fromLatin1(hash)
+            + QLatin1String(".cbor");
+    }
+
+    static QCborMap readIndex(const QString &indexPath)
+    {
+        QFile file(indexPath);
+        if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+            return {};
+        }
+        // Mapped rather than read, so that all processes share the pages
+        const uchar *data = file.map(0, file.size());
+        if (!data) {
+            return {};
+        }
+        // Decoding copies the data, the result outlives the mapping
+        return QCborValue::fromCbor(QByteArray::fromRawData(reinterpret_cast<const char *>(data), file.size())).toMap();
+    }
+
+    static void writeIndex(const QString &indexPath, const QCborMap &index)
+    {
+        QDir().mkpath(QFileInfo(indexPath).absolutePath());
+        // Replaces the previous index at once, processes still using it keep their copy
+        QSaveFile file(indexPath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(QCborValue(index).toCbor()) < 0 || !file.commit()) {
+            qCDebug(KCOREADDONS_DEBUG) << "Could not write plugin index" << indexPath << file.errorString();
+        }
+    }
+
+    static KPluginMetaData ofIndexEntry(const QString &dir, const QCborMap &entry, KPluginMetaData::KPluginMetaDataOptions options)
+    {
+        const QFileInfo fileInfo(dir + QLatin1Char('/') + entry.value(s_indexFileKey).toString());
+        auto d = new KPluginMetaDataPrivate(entry.value(s_indexMetaDataKey).toMap().toJsonObject(), fileInfo.absoluteFilePath(), options);
+        d->m_pluginId = fileInfo.completeBaseName();
+        KPluginMetaData data;
+        data.d = d;
+        return data;
+    }
+
+    /* Builds the index of the plugins of the namespace @p directory in @p dir,
+     * only loading the plugins with a different modification time or size than
+     * in @p previousEntries. Besides the plugins, the index maps every MIME type
+     * and form factor to the indexes of the plugins supporting it.
+     */
+    static QCborMap buildIndex(const QString &directory, const QString &dir, qint64 dirMtime, const QCborArray &previousEntries, KPluginMetaData::KPluginMetaDataOptions options)
+    {
+        QHash<QString, QCborMap> previous;
+        for (const QCborValue &entry : previousEntries) {
+            const QCborMap map = entry.toMap();
+            previous.insert(map.value(s_indexFileKey).toString(), map);
+        }
+
+        QCborArray entries;
+        QHash<QString, QCborArray> mimeTypes;
+        QHash<QString, QCborArray> formFactors;
+        QMimeDatabase db;
+        forEachPluginIn(directory, dir, [&](const QFileInfo &pluginInfo) {
+            const qint64 mtime = pluginInfo.lastModified().toMSecsSinceEpoch();
+            QCborMap entry = previous.value(pluginInfo.fileName());
+            if (entry.value(s_indexMtimeKey).toInteger() != mtime || entry.value(s_indexSizeKey).toInteger() != pluginInfo.size()) {
+                std::optional<QJsonObject> metaData = KPluginMetaDataReader::readMetaData(pluginInfo.absoluteFilePath());
+                if (!metaData) {
+                    const QPluginLoader loader(pluginInfo.absoluteFilePath());
+                    metaData = loader.metaData().value(QLatin1String("MetaData")).toObject();
+                }
+                entry = QCborMap();
+                entry.insert(s_indexFileKey, pluginInfo.fileName());
+                entry.insert(s_indexMtimeKey, mtime);
+                entry.insert(s_indexSizeKey, pluginInfo.size());
+                entry.insert(s_indexMetaDataKey, QCborMap::fromJsonObject(*metaData));
+            }
+
+            const qsizetype index = entries.size();
+            const KPluginMetaData metaData = ofIndexEntry(dir, entry, options);
+            entry.insert(s_indexEnabledByDefaultKey, metaData.isEnabledByDefault());
+            const QStringList pluginMimeTypes = metaData.mimeTypes();
+            for (const QString &mimeType : pluginMimeTypes) {
+                mimeTypes[mimeType].append(index);
+                // Queries look up the canonical names of the MIME type and its ancestors
+                const QString canonicalName = db.mimeTypeForName(mimeType).name();
+                if (!canonicalName.isEmpty() && canonicalName != mimeType) {
+                    mimeTypes[canonicalName].append(index);
+                }
+            }
+            const QStringList pluginFormFactors = metaData.formFactors();
+            for (const QString &formFactor : pluginFormFactors) {
+                formFactors[formFactor].append(index);
+            }
+            entries.append(entry);
+        });
+
+        const auto toCbor = [](const QHash<QString, QCborArray> &hash) {
+            QCborMap map;
+            for (auto it = hash.cbegin(); it != hash.cend(); ++it) {
+                map.insert(it.key(), it.value());
+            }
+            return map;
+        };
+        QCborMap index;
+        index.insert(s_indexVersionKey, s_indexVersion);
+        index.insert(s_indexDirectoryKey, dir);
+        index.insert(s_indexMtimeKey, dirMtime);
+        index.insert(s_indexPluginsKey, entries);
+        index.insert(s_indexMimeTypesKey, toCbor(mimeTypes));
+        index.insert(s_indexFormFactorsKey, toCbor(formFactors));
+        return index;
+    }
+
+    // Whether each of the plugins in @p index matches @p criteria, using the lookup tables of the index
+    static std::vector<bool> matchingEntries(const QCborMap &index, const KPluginMetaData::PluginFilter &criteria)
+    {
+        const QCborArray entries = index.value(s_indexPluginsKey).toArray();
+        std::vector<bool> matching(entries.size(), true);
+        const auto keepOnly = [&matching](const QList<QCborArray> &indexLists) {
+            std::vector<bool> listed(matching.size(), false);
+            for (const QCborArray &indexes : indexLists) {
+                for (const QCborValue &index : indexes) {
+                    const qint64 i = index.toInteger(-1);
+                    if (i >= 0 && quint64(i) < listed.size()) {
+                        listed[i] = true;
+                    }
+                }
+            }
+            for (std::size_t i = 0; i < matching.size(); ++i) {
+                matching[i] = matching[i] && listed[i];
+            }
+        };
+
+        if (!criteria.mimeType.isEmpty()) {
+            // Like supportsMimeType(), which matches the MIME type itself and the ones it inherits
+            const QCborMap mimeTypes = index.value(s_indexMimeTypesKey).toMap();
+            QStringList names{criteria.mimeType};
+            const QMimeType mime = QMimeDatabase().mimeTypeForName(criteria.mimeType);
+            if (mime.isValid()) {
+                names << mime.name() << mime.allAncestors();
+            }
+            QList<QCborArray> indexLists;
+            for (const QString &name : std::as_const(names)) {
+                indexLists << mimeTypes.value(name).toArray();
+            }
+            keepOnly(indexLists);
+        }
+        if (!criteria.formFactor.isEmpty()) {
+            keepOnly({index.value(s_indexFormFactorsKey).toMap().value(criteria.formFactor).toArray()});
+        }
+        if (criteria.enabledByDefaultOnly) {
+            for (qsizetype i = 0; i < entries.size(); ++i) {
+                matching[i] = matching[i] && entries.at(i).toMap().value(s_indexEnabledByDefaultKey).toBool();
+            }
+        }
+        return matching;
+    }
+
+    /* The plugins of the namespace @p directory in @p dir, from its index if
+     * the directory didn't change since that was written, otherwise the index
+     * is updated first. If @p criteria is set, only the matching plugins are
+     * read from the index.
+     */
+    static QList<KPluginMetaData> indexedPlugins(const QString &directory,
+                                                 const QString &dir,
+                                                 KPluginMetaData::KPluginMetaDataOptions options,
+                                                 const KPluginMetaData::PluginFilter *criteria = nullptr)
+    {
+        // Before listing it, so that changes during that invalidate the index
+        const QFileInfo dirInfo(dir);
+        if (!dirInfo.isDir()) {
+            return {};
+        }
+        const qint64 dirMtime = dirInfo.lastModified().toMSecsSinceEpoch();
+
+        const QString indexPath = indexFilePath(dir);
+        QCborMap index = readIndex(indexPath);
+        const bool isIndex = index.value(s_indexVersionKey).toInteger() == s_indexVersion && index.value(s_indexDirectoryKey).toString() == dir;
+        if (!isIndex || index.value(s_indexMtimeKey).toInteger() != dirMtime) {
+            index = buildIndex(directory, dir, dirMtime, isIndex ? index.value(s_indexPluginsKey).toArray() : QCborArray(), options);
+            writeIndex(indexPath, index);
+        }
+
+        const QCborArray entries = index.value(s_indexPluginsKey).toArray();
+        const std::vector<bool> matching = criteria ? matchingEntries(index, *criteria) : std::vector<bool>(entries.size(), true);
+        QList<KPluginMetaData> ret;
+        for (qsizetype i = 0; i < entries.size(); ++i) {
+            if (matching[i]) {
+                ret.append(ofIndexEntry(dir, entries.at(i).toMap(), options));
+            }
+        }
+        return ret;
+    }
+
+    static bool matchesFilter(const KPluginMetaData &metaData, const KPluginMetaData::PluginFilter &criteria)
+    {
+        return (criteria.mimeType.isEmpty() || metaData.supportsMimeType(criteria.mimeType))
+            && (criteria.formFactor.isEmpty() || metaData.formFactors().contains(criteria.formFactor))
+            && (!criteria.enabledByDefaultOnly || metaData.isEnabledByDefault());
+    }
+
+    static void findIndexedPlugins(const QString &directory,
+                                   const std::function<bool(const KPluginMetaData &)> &filter,
+                                   const KPluginMetaData::PluginFilter *criteria,
+                                   KPluginMetaData::KPluginMetaDataOptions options,
+                                   QList<KPluginMetaData> &ret)
+    {
+        QSet<QString> addedPluginIds;
+        const QStringList dirsToCheck = pluginDirectories(directory);
+        for (const QString &dir : dirsToCheck) {
+            const QList<KPluginMetaData> plugins = indexedPlugins(directory, dir, options, criteria);
+            for (const KPluginMetaData &metadata : plugins) {
+                if (!metadata.isValid()) {
+                    qCDebug(KCOREADDONS_DEBUG) << metadata.fileName() << "does not contain valid JSON metadata";
+                    continue;
                 }
+                if (addedPluginIds.contains(metadata.pluginId()) || (filter && !filter(metadata))) {
+                    continue;
+                }
+                addedPluginIds << metadata.pluginId();
+                ret.append(metadata);
             }
         }
     }
@@ -112,6 +449,24 @@ public:
         data.d = d;
         return data;
     }
+    static QList<KPluginMetaData> staticPluginsIn(const QString &pluginNamespace, KPluginMetaData::KPluginMetaDataOptions options)
+    {
+        QMutexLocker locker(s_staticPluginCacheMutex());
+        StaticPluginNamespaceCache &cache = (*s_staticPluginCache)[{pluginNamespace, options.toInt()}];
+        const int registrationCount = KStaticPluginHelpers::registrationCount();
+        if (cache.registrationCount != registrationCount) {
+            cache.registrationCount = registrationCount;
+            cache.plugins.clear();
+            const auto staticPlugins = KStaticPluginHelpers::staticPlugins(pluginNamespace);
+            for (auto it = staticPlugins.begin(); it != staticPlugins.end(); ++it) {
+                KPluginMetaData metaData = ofStaticPlugin(pluginNamespace, it.key(), options, it.value());
+                if (metaData.isValid()) {
+                    cache.plugins << metaData;
+                }
+            }
+        }
+        return cache.plugins;
+    }
     static void pluginLoaderForPath(QPluginLoader &loader, const QString &path)
     {
         if (path.startsWith(QLatin1Char('/'))) { // Absolute path, use as it is
@@ -126,6 +481,18 @@ public:
 
     static KPluginMetaDataPrivate *ofPath(const QString &path, KPluginMetaData::KPluginMetaDataOptions options)
     {
+        const KPluginTrace::Scope trace(KPluginTrace::MetaDataRead, path);
+        // Without QPluginLoader if possible, for the files it would use as they are, see pluginLoaderForPath()
+        const QFileInfo fileInfo(path.startsWith(QLatin1Char('/')) ? path : QCoreApplication::applicationDirPath() + QLatin1Char('/') + path);
+        if (fileInfo.isFile()) {
+            const QString fileName = fileInfo.canonicalFilePath();
+            if (const auto metaData = KPluginMetaDataReader::readMetaData(fileName)) {
+                auto ret = new KPluginMetaDataPrivate(*metaData, fileName, options);
+                ret->m_requestedFileName = path;
+                return ret;
+            }
+        }
+
         QPluginLoader loader;
         pluginLoaderForPath(loader, path);
         if (loader.metaData().isEmpty()) {
@@ -202,12 +569,25 @@ KPluginMetaData::KPluginMetaData(const QJsonObject &metaData, const QString &fil
 
 KPluginMetaData KPluginMetaData::findPluginById(const QString &directory, const QString &pluginId, KPluginMetaDataOptions options)
 {
-    QPluginLoader loader;
     const QString fileName = directory + QLatin1Char('/') + pluginId;
-    KPluginMetaDataPrivate::pluginLoaderForPath(loader, fileName);
-    if (loader.load()) {
-        if (KPluginMetaData metaData(loader, options); metaData.isValid()) {
-            return metaData;
+    if (options.testFlags(KPluginMetaData::PersistentCache)) {
+        QList<KPluginMetaData> ret;
+        const auto hasId = [&pluginId](const KPluginMetaData &metaData) {
+            return metaData.pluginId() == pluginId;
+        };
+        KPluginMetaDataPrivate::findIndexedPlugins(directory, hasId, nullptr, options, ret);
+        if (!ret.isEmpty()) {
+            return ret.constFirst();
+        }
+    } else {
+        // Only resolves the file name, reading the metadata does not load the
+        // plugin either. That's left to KPluginFactory::loadFactory().
+        QPluginLoader loader;
+        KPluginMetaDataPrivate::pluginLoaderForPath(loader, fileName);
+        if (!loader.fileName().isEmpty()) {
+            if (KPluginMetaData metaData(loader.fileName(), options); metaData.isValid()) {
+                return metaData;
+            }
         }
     }
 
@@ -249,57 +629,124 @@ QString KPluginMetaData::fileName() const
 QList<KPluginMetaData>
 KPluginMetaData::findPlugins(const QString &directory, std::function<bool(const KPluginMetaData &)> filter, KPluginMetaDataOptions options)
 {
+    const KPluginTrace::Scope trace(KPluginTrace::NamespaceScan, directory);
+    KTRACE_SCOPE_ARG("KPluginMetaData::findPlugins", "namespace", directory);
     QList<KPluginMetaData> ret;
-    const auto staticPlugins = KStaticPluginHelpers::staticPlugins(directory);
-    for (auto it = staticPlugins.begin(); it != staticPlugins.end(); ++it) {
-        KPluginMetaData metaData = KPluginMetaDataPrivate::ofStaticPlugin(directory, it.key(), options, it.value());
-        if (metaData.isValid()) {
-            if (!filter || filter(metaData)) {
-                ret << metaData;
-            }
+    const QList<KPluginMetaData> staticPlugins = KPluginMetaDataPrivate::staticPluginsIn(directory, options);
+    for (const KPluginMetaData &metaData : staticPlugins) {
+        if (!filter || filter(metaData)) {
+            ret << metaData;
         }
     }
+    if (options.testFlags(KPluginMetaData::PersistentCache)) {
+        KPluginMetaDataPrivate::findIndexedPlugins(directory, filter, nullptr, options, ret);
+        return ret;
+    }
+
     QSet<QString> addedPluginIds;
+
     const qint64 nowTs = QDateTime::currentMSecsSinceEpoch(); // For the initial load, stating all files is not needed
     const bool checkCache = options.testFlags(KPluginMetaData::CacheMetaData);
-    std::vector<KPluginMetaData> &cache = (*s_pluginNamespaceCache)[directory];
-    KPluginMetaDataPrivate::forEachPlugin(directory, [&](const QFileInfo &pluginInfo) {
-        const QString pluginFile = pluginInfo.absoluteFilePath();
-
-        KPluginMetaData metadata;
+    PluginNamespaceCache &cache = (*s_pluginNamespaceCache)[directory];
+    const QStringList dirsToCheck = KPluginMetaDataPrivate::pluginDirectories(directory);
+    for (const QString &dir : dirsToCheck) {
+        // If the directory didn't change, neither did the plugins we already know
+        bool dirUnchanged = false;
         if (checkCache) {
-            const auto it = std::find_if(cache.begin(), cache.end(), [&pluginFile](const KPluginMetaData &data) {
-                return pluginFile == data.fileName();
-            });
-            bool isNew = it == cache.cend();
-            if (!isNew) {
-                const qint64 lastQueried = (*it).d->m_lastQueriedTs;
-                Q_ASSERT(lastQueried > 0);
-                isNew = lastQueried < pluginInfo.lastModified().toMSecsSinceEpoch();
+            const qint64 dirMtime = QFileInfo(dir).lastModified().toMSecsSinceEpoch();
+            const auto lastMtime = cache.directoryMtimes.constFind(dir);
+            dirUnchanged = lastMtime != cache.directoryMtimes.cend() && lastMtime.value() == dirMtime;
+            cache.directoryMtimes.insert(dir, dirMtime);
+        }
+
+        QStringList pluginFiles;
+        std::vector<KPluginMetaData> metadatas;
+        // The indexes of the plugins that are not in the cache yet
+        QList<qsizetype> toLoad;
+        KPluginMetaDataPrivate::forEachPluginIn(directory, dir, [&](const QFileInfo &pluginInfo) {
+            const QString pluginFile = pluginInfo.absoluteFilePath();
+            pluginFiles.append(pluginFile);
+            metadatas.emplace_back();
+
+            if (checkCache) {
+                const auto it = cache.plugins.find(pluginFile);
+                bool isNew = it == cache.plugins.end();
+                if (!isNew && !dirUnchanged) {
+                    const qint64 lastQueried = it->second.d->m_lastQueriedTs;
+                    Q_ASSERT(lastQueried > 0);
+                    isNew = lastQueried < pluginInfo.lastModified().toMSecsSinceEpoch();
+                }
+                KPluginTrace::recordCacheLookup(!isNew);
+                if (!isNew) {
+                    metadatas.back() = it->second;
+                    return;
+                }
             }
-            if (!isNew) {
-                metadata = *it;
-            } else {
-                metadata = KPluginMetaData(pluginFile, options);
-                metadata.d->m_lastQueriedTs = nowTs;
-                cache.push_back(metadata);
+            toLoad.append(qsizetype(metadatas.size()) - 1);
+        });
+
+        const auto load = [&](qsizetype index) {
+            metadatas[index] = KPluginMetaData(pluginFiles.at(index), options);
+        };
+        if (options.testFlags(KPluginMetaData::ParallelLoad) && toLoad.size() > 1) {
+            // Every job writes a different element, which was allocated before
+            QThreadPool pool;
+            for (qsizetype index : std::as_const(toLoad)) {
+                pool.start([&load, index]() {
+                    load(index);
+                });
             }
+            pool.waitForDone();
         } else {
-            metadata = KPluginMetaData(pluginFile, options);
+            for (qsizetype index : std::as_const(toLoad)) {
+                load(index);
+            }
         }
-        if (!metadata.isValid()) {
-            qCDebug(KCOREADDONS_DEBUG) << pluginFile << "does not contain valid JSON metadata";
-            return;
+        if (checkCache) {
+            for (qsizetype index : std::as_const(toLoad)) {
+                metadatas[index].d->m_lastQueriedTs = nowTs;
+                cache.plugins.insert_or_assign(pluginFiles.at(index), metadatas[index]);
+            }
         }
-        if (addedPluginIds.contains(metadata.pluginId())) {
-            return;
+
+        // In directory order, so that the first of several plugins with the same id wins
+        for (std::size_t index = 0; index < metadatas.size(); ++index) {
+            const KPluginMetaData &metadata = metadatas[index];
+            if (!metadata.isValid()) {
+                qCDebug(KCOREADDONS_DEBUG) << pluginFiles.at(qsizetype(index)) << "does not contain valid JSON metadata";
+                continue;
+            }
+            if (addedPluginIds.contains(metadata.pluginId())) {
+                continue;
+            }
+            if (filter && !filter(metadata)) {
+                continue;
+            }
+            addedPluginIds << metadata.pluginId();
+            ret.append(metadata);
         }
-        if (filter && !filter(metadata)) {
-            return;
+    }
+    return ret;
+}
+
+QList<KPluginMetaData> KPluginMetaData::findPluginsMatching(const QString &directory, const PluginFilter &filter, KPluginMetaDataOptions options)
+{
+    const auto matches = [&filter](const KPluginMetaData &metaData) {
+        return KPluginMetaDataPrivate::matchesFilter(metaData, filter);
+    };
+    if (!options.testFlags(KPluginMetaData::PersistentCache)) {
+        return findPlugins(directory, matches, options);
+    }
+    const KPluginTrace::Scope trace(KPluginTrace::NamespaceScan, directory);
+
+    QList<KPluginMetaData> ret;
+    const QList<KPluginMetaData> staticPlugins = KPluginMetaDataPrivate::staticPluginsIn(directory, options);
+    for (const KPluginMetaData &metaData : staticPlugins) {
+        if (matches(metaData)) {
+            ret << metaData;
         }
-        addedPluginIds << metadata.pluginId();
-        ret.append(metadata);
-    });
+    }
+    KPluginMetaDataPrivate::findIndexedPlugins(directory, {}, &filter, options, ret);
     return ret;
 }
 
@@ -364,7 +811,7 @@ QString KPluginMetaData::category() const
 
 QString KPluginMetaData::description() const
 {
-    return KJsonUtils::readTranslatedString(d->m_rootObj, QStringLiteral("Description"));
+    return d->translatedFields().description;
 }
 
 QString KPluginMetaData::iconName() const
@@ -384,12 +831,12 @@ QString KPluginMetaData::licenseText() const
 
 QString KPluginMetaData::name() const
 {
-    return KJsonUtils::readTranslatedString(d->m_rootObj, QStringLiteral("Name"));
+    return d->translatedFields().name;
 }
 
 QString KPluginMetaData::copyrightText() const
 {
-    return KJsonUtils::readTranslatedString(d->m_rootObj, QStringLiteral("Copyright"));
+    return d->translatedFields().copyrightText;
 }
 
 QString KPluginMetaData::pluginId() const
@@ -414,7 +861,7 @@ QString KPluginMetaData::bugReportUrl() const
 
 QStringList KPluginMetaData::mimeTypes() const
 {
-    return d->m_rootObj[QLatin1String("MimeTypes")].toVariant().toStringList();
+    return d->m_mimeTypes;
 }
 
 bool KPluginMetaData::supportsMimeType(const QString &mimeType) const
@@ -422,7 +869,10 @@ bool KPluginMetaData::supportsMimeType(const QString &mimeType) const
     // Check for exact matches first. This can delay parsing the full MIME
     // database until later and noticeably speed up application startup on
     // slower systems.
-    const QStringList mimes = mimeTypes();
+    const QStringList &mimes = d->m_mimeTypes;
+    if (mimes.isEmpty()) {
+        return false;
+    }
     if (mimes.contains(mimeType)) {
         return true;
     }
@@ -441,7 +891,7 @@ bool KPluginMetaData::supportsMimeType(const QString &mimeType) const
 
 QStringList KPluginMetaData::formFactors() const
 {
-    return d->m_rootObj.value(QLatin1String("FormFactors")).toVariant().toStringList();
+    return d->m_formFactors;
 }
 
 bool KPluginMetaData::isEnabledByDefault() const
@@ -459,17 +909,19 @@ bool KPluginMetaData::isEnabledByDefault() const
 
 QString KPluginMetaData::value(const QString &key, const QString &defaultValue) const
 {
-    const QJsonValue value = d->m_metaData.value(key);
-    if (value.isString()) {
-        return value.toString(defaultValue);
-    } else if (value.isArray()) {
-        qCWarning(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "in" << d->m_fileName << "to be a single string, but it is an array";
-        return value.toVariant().toStringList().join(QChar::fromLatin1(','));
-    } else if (value.isBool()) {
-        qCWarning(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "in" << d->m_fileName << "to be a single string, but it is a bool";
-        return value.toBool() ? QStringLiteral("true") : QStringLiteral("false");
-    }
-    return defaultValue;
+    const auto decode = [&](const QJsonValue &value) -> std::optional<QString> {
+        if (value.isString()) {
+            return value.toString();
+        } else if (value.isArray()) {
+            qCWarning(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "in" << d->m_fileName << "to be a single string, but it is an array";
+            return value.toVariant().toStringList().join(QChar::fromLatin1(','));
+        } else if (value.isBool()) {
+            qCWarning(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "in" << d->m_fileName << "to be a single string, but it is a bool";
+            return value.toBool() ? QStringLiteral("true") : QStringLiteral("false");
+        }
+        return std::nullopt;
+    };
+    return d->cachedValue(d->m_stringValues, key, decode).value_or(defaultValue);
 }
 
 bool KPluginMetaData::value(const QString &key, bool defaultValue) const
@@ -505,23 +957,25 @@ int KPluginMetaData::value(const QString &key, int defaultValue) const
 }
 QStringList KPluginMetaData::value(const QString &key, const QStringList &defaultValue) const
 {
-    const QJsonValue value = d->m_metaData.value(key);
-    if (value.isUndefined() || value.isNull()) {
-        return defaultValue;
-    } else if (value.isObject()) {
-        qCWarning(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "to be a string list, instead an object was specified in" << d->m_fileName;
-        return defaultValue;
-    } else if (value.isArray()) {
-        return value.toVariant().toStringList();
-    } else {
-        const QString asString = value.isString() ? value.toString() : value.toVariant().toString();
-        if (asString.isEmpty()) {
-            return defaultValue;
+    const auto decode = [&](const QJsonValue &value) -> std::optional<QStringList> {
+        if (value.isUndefined() || value.isNull()) {
+            return std::nullopt;
+        } else if (value.isObject()) {
+            qCWarning(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "to be a string list, instead an object was specified in" << d->m_fileName;
+            return std::nullopt;
+        } else if (value.isArray()) {
+            return KJsonUtils::internedStrings(value.toVariant().toStringList());
+        } else {
+            const QString asString = value.isString() ? value.toString() : value.toVariant().toString();
+            if (asString.isEmpty()) {
+                return std::nullopt;
+            }
+            qCDebug(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "to be a string list in" << d->m_fileName
+                                       << "Treating it as a list with a single entry:" << asString;
+            return QStringList(asString);
         }
-        qCDebug(KCOREADDONS_DEBUG) << "Expected JSON property" << key << "to be a string list in" << d->m_fileName
-                                   << "Treating it as a list with a single entry:" << asString;
-        return QStringList(asString);
-    }
+    };
+    return d->cachedValue(d->m_stringListValues, key, decode).value_or(defaultValue);
 }
 
 bool KPluginMetaData::operator==(const KPluginMetaData &other) const
@@ -546,6 +1000,27 @@ QStaticPlugin KPluginMetaData::staticPlugin() const
     return d->staticPlugin.value();
 }
 
+KMemoryFootprint::Subsystem KMemoryFootprintPrivate::pluginMetaData()
+{
+    KMemoryFootprint::Subsystem subsystem{QStringLiteral("KPluginMetaData"), 0, 0, true};
+    for (const auto &[directory, cache] : std::as_const(*s_pluginNamespaceCache)) {
+        subsystem.objects += qsizetype(cache.plugins.size());
+        subsystem.bytes += qint64(sizeof(PluginNamespaceCache)) + KMemoryFootprintPrivate::stringBytes(directory);
+        for (const auto &[file, metaData] : cache.plugins) {
+            subsystem.bytes += KMemoryFootprintPrivate::stringBytes(file) + KPluginMetaDataPrivate::footprint(metaData);
+        }
+        for (auto it = cache.directoryMtimes.cbegin(); it != cache.directoryMtimes.cend(); ++it) {
+            subsystem.bytes += qint64(sizeof(qint64)) + KMemoryFootprintPrivate::stringBytes(it.key());
+        }
+    }
+    return subsystem;
+}
+
+void KMemoryFootprintPrivate::releasePluginMetaData()
+{
+    s_pluginNamespaceCache->clear();
+}
+
 QDebug operator<<(QDebug debug, const KPluginMetaData &metaData)
 {
     QDebugStateSaver saver(debug);
@@ -75,6 +75,10 @@ class KAboutPerson;
    }
    @endverbatim
  *
+ * To find out where startup time goes, set the environment variable KCOREADDONS_PLUGIN_TRACE=1.
+ * The time spent searching namespaces, reading metadata, loading factories and creating plugins
+ * is then logged to the kf.coreaddons category, with a summary when the application exits.
+ *
  * @sa KAboutPerson::fromJSON()
  * @since 5.1
  */
@@ -112,9 +116,24 @@ public:
         AllowEmptyMetaData = 1, ///< Plugins with empty metaData are considered valid
         /**
          * If KCoreAddons should keep metadata in cache. This makes querying the namespace again faster. Consider using this if you need revalidation of plugins
+         * The plugins are only checked for changes when the modification time of their directory changed since the last query.
          * @since 6.0
          */
         CacheMetaData = 2,
+        /**
+         * If KCoreAddons should keep the metadata of the plugins in a namespace in an index in the cache directory, shared by all processes.
+         * Checking the index only takes looking at the modification time of the plugin directories, so a plugin overwritten in place is
+         * not noticed until a file in its directory is added, removed or renamed. Package managers replace files by renaming, which is noticed.
+         * Only used by findPlugins() and findPluginById().
+         * @since 6.0
+         */
+        PersistentCache = 4,
+        /**
+         * If findPlugins() should read the metadata of several plugins at once, on multiple threads. This speeds up finding many plugins
+         * that aren't cached yet, especially from network mounts. The result is the same as without this option.
+         * @since 6.0
+         */
+        ParallelLoad = 8,
     };
     Q_DECLARE_FLAGS(KPluginMetaDataOptions, KPluginMetaDataOption)
     Q_FLAG(KPluginMetaDataOption)
@@ -179,6 +198,8 @@ public:
      * subdirectory. If an absolute path is given only that directory will be searched.
      * @note Check if the returned KPluginMetaData is valid before continuing to use it.
      *
+     * The plugin is not loaded, only its metadata is read. That happens in KPluginFactory::loadFactory().
+     *
      * @param pluginId The Id of the plugin. The id should be the same as the filename, see KPluginMetaData::pluginId()
      * @param option Added in 6.0, see enum docs
      * @since 5.84
@@ -202,6 +223,34 @@ public:
     static QList<KPluginMetaData>
     findPlugins(const QString &directory, std::function<bool(const KPluginMetaData &)> filter = {}, KPluginMetaDataOptions options = {});
 
+    /**
+     * Criteria for findPluginsMatching(). Empty criteria match all plugins.
+     * @since 6.0
+     */
+    struct PluginFilter {
+        /** If not empty, only plugins for which supportsMimeType() returns @c true for this MIME type match */
+        QString mimeType;
+        /** If not empty, only plugins listing this form factor in formFactors() match */
+        QString formFactor;
+        /** If only plugins that isEnabledByDefault() match */
+        bool enabledByDefaultOnly = false;
+    };
+
+    /**
+     * Find the plugins inside @p directory that match @p filter, like findPlugins() with a callback checking the same.
+     *
+     * Together with PersistentCache, the MIME types and form factors are looked up in the index, so the metadata of the
+     * plugins not matching is never read.
+     *
+     * @param directory The directory to search for plugins, see findPlugins()
+     * @param filter The criteria the plugins have to fulfil
+     * @param option See enum docs
+     *
+     * @return all plugins found in @p directory that fulfil the criteria of @p filter
+     * @since 6.0
+     */
+    static QList<KPluginMetaData> findPluginsMatching(const QString &directory, const PluginFilter &filter, KPluginMetaDataOptions options = {});
+
     /**
      * @return whether this object holds valid information about a plugin.
      * If this is @c true pluginId() will return a non-empty string.
@@ -366,6 +415,9 @@ public:
      * @return the string value for @p key from the metadata or @p defaultValue if the key does not exist
      *
      * if QString is not the correct type for @p key you should use the other overloads or @ref KPluginMetaData::rawData
+     *
+     * The string and string list values are only decoded from the JSON the first time they are asked for,
+     * so looking them up repeatedly, e.g. for sorting plugins, is cheap.
      */
     QString value(const QString &key, const QString &defaultValue = QString()) const;
     QString value(const QString &key, const char *ch) const = delete;
@@ -0,0 +1,159 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kpluginmetadatareader_p.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QFile>
+
+#include <cstring>
+
+#if defined(Q_OF_ELF) && __has_include(<elf.h>)
+#include <elf.h>
+#define HAVE_ELF_H 1
+#else
+#define HAVE_ELF_H 0
+#endif
+
+#if HAVE_ELF_H
+// The header of the metadata (see QPluginMetaData::Header): the format
+// version, the Qt major and minor version and the architecture requirements
+static const qsizetype s_headerSize = 4;
+static const quint8 s_currentMetaDataVersion = 0;
+// The key of the "MetaData" object in the CBOR map following the header,
+// see QtPluginMetaDataKeys
+static const int s_metaDataKey = 4;
+
+static std::optional<QJsonObject> decodeMetaData(const uchar *data, quint64 size)
+{
+    if (size < quint64(s_headerSize)) {
+        return std::nullopt;
+    }
+    // QLibrary refuses to load plugins built with a newer Qt
+    if (data[0] > s_currentMetaDataVersion || data[1] != QT_VERSION_MAJOR || data[2] > QT_VERSION_MINOR) {
+        return std::nullopt;
+    }
+
+    QCborParserError error;
+    const QByteArray payload = QByteArray::fromRawData(reinterpret_cast<const char *>(data + s_headerSize), qsizetype(size) - s_headerSize);
+    const QCborValue metaData = QCborValue::fromCbor(payload, &error);
+    if (error.error != QCborError::NoError || !metaData.isMap()) {
+        return std::nullopt;
+    }
+    return metaData.toMap().value(s_metaDataKey).toMap().toJsonObject();
+}
+
+/* The contents of the ".note.qt.metadata" section, an ELF note named
+ * "qt-project!" of which the descriptor is the header and the metadata
+ */
+static std::optional<QJsonObject> decodeNote(const uchar *data, quint64 size)
+{
+    static const char noteName[] = "qt-project!";
+    quint32 nameSize;
+    quint32 descriptorSize;
+    if (size < 12) {
+        return std::nullopt;
+    }
+    std::memcpy(&nameSize, data, sizeof(nameSize));
+    std::memcpy(&descriptorSize, data + 4, sizeof(descriptorSize));
+    const quint64 descriptorOffset = 12 + ((quint64(nameSize) + 3) & ~quint64(3));
+    if (nameSize != sizeof(noteName) || descriptorOffset + descriptorSize > size || std::memcmp(data + 12, noteName, sizeof(noteName)) != 0) {
+        return std::nullopt;
+    }
+    return decodeMetaData(data + descriptorOffset, descriptorSize);
+}
+
+/* The contents of the ".qtmetadata" section, the magic string followed by
+ * the header and the metadata
+ */
+static std::optional<QJsonObject> decodeSection(const uchar *data, quint64 size)
+{
+    static const char magic[] = "QTMETADATA !";
+    const quint64 magicSize = sizeof(magic) - 1;
+    if (size < magicSize || std::memcmp(data, magic, magicSize) != 0) {
+        return std::nullopt;
+    }
+    return decodeMetaData(data + magicSize, size - magicSize);
+}
+
+template<typename Ehdr, typename Shdr>
+static std::optional<QJsonObject> readElfMetaData(const uchar *data, quint64 size)
+{
+    Ehdr ehdr;
+    if (size < sizeof(ehdr)) {
+        return std::nullopt;
+    }
+    std::memcpy(&ehdr, data, sizeof(ehdr));
+    // Files with more sections than fit e_shnum are left to QPluginLoader
+    if (ehdr.e_shentsize != sizeof(Shdr) || ehdr.e_shoff == 0 || ehdr.e_shstrndx >= ehdr.e_shnum
+        || quint64(ehdr.e_shoff) + quint64(ehdr.e_shnum) * sizeof(Shdr) > size) {
+        return std::nullopt;
+    }
+
+    const auto section = [&](int index) {
+        Shdr shdr;
+        std::memcpy(&shdr, data + ehdr.e_shoff + quint64(index) * sizeof(Shdr), sizeof(shdr));
+        return shdr;
+    };
+    const auto inFile = [size](const Shdr &shdr) {
+        return shdr.sh_type != SHT_NOBITS && quint64(shdr.sh_offset) <= size && quint64(shdr.sh_size) <= size - quint64(shdr.sh_offset);
+    };
+
+    const Shdr names = section(ehdr.e_shstrndx);
+    if (!inFile(names)) {
+        return std::nullopt;
+    }
+    const auto hasName = [&](const Shdr &shdr, const char *name) {
+        const quint64 length = std::strlen(name) + 1;
+        return quint64(shdr.sh_name) + length <= quint64(names.sh_size) && std::memcmp(data + names.sh_offset + shdr.sh_name, name, length) == 0;
+    };
+
+    for (int i = 0; i < ehdr.e_shnum; ++i) {
+        const Shdr shdr = section(i);
+        if (hasName(shdr, ".note.qt.metadata")) {
+            return inFile(shdr) ? decodeNote(data + shdr.sh_offset, shdr.sh_size) : std::nullopt;
+        }
+        if (hasName(shdr, ".qtmetadata")) {
+            return inFile(shdr) ? decodeSection(data + shdr.sh_offset, shdr.sh_size) : std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+#endif
+
+std::optional<QJsonObject> KPluginMetaDataReader::readMetaData(const QString &fileName)
+{
+#if HAVE_ELF_H
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    const quint64 size = quint64(file.size());
+    const uchar *data = size > EI_NIDENT ? file.map(0, qint64(size)) : nullptr;
+    if (!data || std::memcmp(data, ELFMAG, SELFMAG) != 0) {
+        return std::nullopt;
+    }
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    const unsigned char nativeData = ELFDATA2LSB;
+#else
+    const unsigned char nativeData = ELFDATA2MSB;
+#endif
+    // Plugins for other architectures can't be loaded anyway
+    if (data[EI_DATA] != nativeData) {
+        return std::nullopt;
+    }
+    if (QT_POINTER_SIZE == 8 && data[EI_CLASS] == ELFCLASS64) {
+        return readElfMetaData<Elf64_Ehdr, Elf64_Shdr>(data, size);
+    }
+    if (QT_POINTER_SIZE == 4 && data[EI_CLASS] == ELFCLASS32) {
+        return readElfMetaData<Elf32_Ehdr, Elf32_Shdr>(data, size);
+    }
+    return std::nullopt;
+#else
+    Q_UNUSED(fileName)
+    return std::nullopt;
+#endif
+}
@@ -0,0 +1,26 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPLUGINMETADATAREADER_P_H
+#define KPLUGINMETADATAREADER_P_H
+
+#include <QJsonObject>
+#include <QString>
+#include <optional>
+
+namespace KPluginMetaDataReader
+{
+/**
+ * Reads the "MetaData" object embedded by Q_PLUGIN_METADATA in the plugin
+ * at the absolute path @p fileName straight from the mapped file, without
+ * going through QPluginLoader and QLibrary's global lock.
+ *
+ * Returns std::nullopt if this isn't supported for the file format, or the
+ * file is not a plugin compatible with this Qt version, in which case
+ * QPluginLoader should be asked instead.
+ */
+std::optional<QJsonObject> readMetaData(const QString &fileName);
+}
+
+#endif
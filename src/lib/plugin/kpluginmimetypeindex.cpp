@@ -0,0 +1,104 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kpluginmimetypeindex.h"
+
+#include <QHash>
+#include <QMimeDatabase>
+
+#include <algorithm>
+
+class KPluginMimeTypeIndexPrivate
+{
+public:
+    KPluginMimeTypeIndexPrivate(const QString &directory, KPluginMetaData::KPluginMetaDataOptions options)
+        : directory(directory)
+        , options(options)
+    {
+    }
+
+    void setPlugins(const QList<KPluginMetaData> &newPlugins)
+    {
+        plugins = newPlugins;
+        byMimeType.clear();
+        resolved.clear();
+
+        QMimeDatabase db;
+        for (qsizetype i = 0; i < plugins.size(); ++i) {
+            const QStringList mimeTypes = plugins.at(i).mimeTypes();
+            for (const QString &mimeType : mimeTypes) {
+                byMimeType[mimeType].append(i);
+                // Lookups use the canonical names of the MIME type and its ancestors
+                const QString canonicalName = db.mimeTypeForName(mimeType).name();
+                if (!canonicalName.isEmpty() && canonicalName != mimeType) {
+                    byMimeType[canonicalName].append(i);
+                }
+            }
+        }
+    }
+
+    const QString directory;
+    const KPluginMetaData::KPluginMetaDataOptions options;
+    QList<KPluginMetaData> plugins;
+    // The indexes in plugins of the plugins supporting a MIME type, by its declared and canonical name
+    QHash<QString, QList<qsizetype>> byMimeType;
+    // The results of pluginsSupporting()
+    mutable QHash<QString, QList<KPluginMetaData>> resolved;
+};
+
+KPluginMimeTypeIndex::KPluginMimeTypeIndex(const QString &directory, KPluginMetaData::KPluginMetaDataOptions options)
+    : d(new KPluginMimeTypeIndexPrivate(directory, options))
+{
+    d->setPlugins(KPluginMetaData::findPlugins(directory, {}, options));
+}
+
+KPluginMimeTypeIndex::~KPluginMimeTypeIndex() = default;
+
+QList<KPluginMetaData> KPluginMimeTypeIndex::plugins() const
+{
+    return d->plugins;
+}
+
+QList<KPluginMetaData> KPluginMimeTypeIndex::pluginsSupporting(const QString &mimeType) const
+{
+    const auto it = d->resolved.constFind(mimeType);
+    if (it != d->resolved.cend()) {
+        return it.value();
+    }
+
+    // Like supportsMimeType(), which matches the MIME type itself and the ones it inherits
+    QStringList names{mimeType};
+    if (!d->byMimeType.isEmpty()) {
+        const QMimeType mime = QMimeDatabase().mimeTypeForName(mimeType);
+        if (mime.isValid()) {
+            names << mime.name() << mime.allAncestors();
+        }
+    }
+    QList<qsizetype> indexes;
+    for (const QString &name : std::as_const(names)) {
+        indexes << d->byMimeType.value(name);
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+    QList<KPluginMetaData> plugins;
+    plugins.reserve(indexes.size());
+    for (qsizetype index : std::as_const(indexes)) {
+        plugins.append(d->plugins.at(index));
+    }
+    d->resolved.insert(mimeType, plugins);
+    return plugins;
+}
+
+bool KPluginMimeTypeIndex::reload()
+{
+    const QList<KPluginMetaData> plugins = KPluginMetaData::findPlugins(d->directory, {}, d->options);
+    if (plugins == d->plugins) {
+        return false;
+    }
+    d->setPlugins(plugins);
+    return true;
+}
@@ -0,0 +1,74 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPLUGINMIMETYPEINDEX_H
+#define KPLUGINMIMETYPEINDEX_H
+
+#include "kcoreaddons_export.h"
+#include "kpluginmetadata.h"
+
+#include <memory>
+
+class KPluginMimeTypeIndexPrivate;
+
+/**
+ * @class KPluginMimeTypeIndex kpluginmimetypeindex.h KPluginMimeTypeIndex
+ *
+ * Finds the plugins of a namespace supporting a MIME type, for picking a handler for many files.
+ *
+ * The plugins match like with KPluginMetaData::supportsMimeType(), i.e. also if they support a
+ * MIME type the given one inherits from. Unlike calling that for every plugin, the MIME database
+ * is only queried once per MIME type, and the plugins are looked up by the MIME types they support.
+ * The result for every MIME type is kept until the plugins change, see reload().
+ *
+ * @code
+ * KPluginMimeTypeIndex index(QStringLiteral("kf6/thumbcreator"));
+ * for (const QString &file : files) {
+ *     const QList<KPluginMetaData> plugins = index.pluginsSupporting(db.mimeTypeForFile(file).name());
+ *     ...
+ * }
+ * @endcode
+ *
+ * KPluginMimeTypeIndex is reentrant, but not thread-safe.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KPluginMimeTypeIndex
+{
+public:
+    /**
+     * Finds the plugins of the namespace @p directory like KPluginMetaData::findPlugins(),
+     * with @p options.
+     */
+    explicit KPluginMimeTypeIndex(const QString &directory, KPluginMetaData::KPluginMetaDataOptions options = {});
+    ~KPluginMimeTypeIndex();
+
+    KPluginMimeTypeIndex(const KPluginMimeTypeIndex &) = delete;
+    KPluginMimeTypeIndex &operator=(const KPluginMimeTypeIndex &) = delete;
+
+    /**
+     * @return all plugins of the namespace, in the order of KPluginMetaData::findPlugins()
+     */
+    QList<KPluginMetaData> plugins() const;
+
+    /**
+     * @return the plugins supporting @p mimeType, in the order of plugins()
+     */
+    QList<KPluginMetaData> pluginsSupporting(const QString &mimeType) const;
+
+    /**
+     * Finds the plugins of the namespace again. The results of pluginsSupporting()
+     * are only computed again if the plugins changed.
+     *
+     * @return whether the plugins changed
+     */
+    bool reload();
+
+private:
+    std::unique_ptr<KPluginMimeTypeIndexPrivate> const d;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kplugintrace_p.h"
+
+#include "kcoreaddons_debug.h"
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
+
+#include <algorithm>
+#include <vector>
+
+static const char s_envTrace[] = "KCOREADDONS_PLUGIN_TRACE";
+// Number of the slowest plugins listed in the summary
+static const int s_summarySize = 10;
+
+static const char *phaseName(KPluginTrace::Phase phase)
+{
+    switch (phase) {
+    case KPluginTrace::NamespaceScan:
+        return "scanning namespace";
+    case KPluginTrace::MetaDataRead:
+        return "reading metadata of";
+    case KPluginTrace::FactoryLoad:
+        return "loading factory of";
+    case KPluginTrace::PluginCreation:
+        return "creating plugin of";
+    }
+    return "";
+}
+
+struct TraceStatistics {
+    QMutex mutex;
+    // Total time of every phase and name
+    QHash<std::pair<int, QString>, qint64> totals;
+    int cacheHits = 0;
+    int cacheMisses = 0;
+    bool summaryRegistered = false;
+};
+Q_GLOBAL_STATIC(TraceStatistics, s_statistics)
+
+static void logSummary()
+{
+    QMutexLocker locker(&s_statistics->mutex);
+    qCInfo(KCOREADDONS_DEBUG) << "Plugin trace summary:" << s_statistics->cacheHits << "metadata cache hits," << s_statistics->cacheMisses << "misses";
+
+    std::vector<int> phases{KPluginTrace::NamespaceScan, KPluginTrace::MetaDataRead, KPluginTrace::FactoryLoad, KPluginTrace::PluginCreation};
+    for (int phase : phases) {
+        std::vector<std::pair<qint64, QString>> entries;
+        qint64 phaseTotal = 0;
+        for (auto it = s_statistics->totals.cbegin(); it != s_statistics->totals.cend(); ++it) {
+            if (it.key().first == phase) {
+                entries.emplace_back(it.value(), it.key().second);
+                phaseTotal += it.value();
+            }
+        }
+        if (entries.empty()) {
+            continue;
+        }
+        std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+            return a.first > b.first;
+        });
+        qCInfo(KCOREADDONS_DEBUG).nospace() << "  " << phaseName(KPluginTrace::Phase(phase)) << ": " << phaseTotal / 1000000.0 << " ms in total";
+        for (std::size_t i = 0; i < entries.size() && i < std::size_t(s_summarySize); ++i) {
+            qCInfo(KCOREADDONS_DEBUG).nospace() << "    " << entries[i].first / 1000000.0 << " ms " << entries[i].second;
+        }
+    }
+}
+
+bool KPluginTrace::isEnabled()
+{
+    static const bool enabled = qEnvironmentVariableIntValue(s_envTrace) != 0;
+    return enabled;
+}
+
+// The summary is logged while the application is destroyed, when logging still works
+static void registerSummary(TraceStatistics *statistics)
+{
+    if (!statistics->summaryRegistered && QCoreApplication::instance()) {
+        statistics->summaryRegistered = true;
+        qAddPostRoutine(logSummary);
+    }
+}
+
+void KPluginTrace::record(Phase phase, const QString &name, qint64 nsecs)
+{
+    qCInfo(KCOREADDONS_DEBUG).nospace() << "Plugin trace: " << phaseName(phase) << " " << name << " took " << nsecs / 1000000.0 << " ms";
+
+    QMutexLocker locker(&s_statistics->mutex);
+    s_statistics->totals[{int(phase), name}] += nsecs;
+    registerSummary(s_statistics);
+}
+
+void KPluginTrace::recordCacheLookup(bool hit)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker locker(&s_statistics->mutex);
+    ++(hit ? s_statistics->cacheHits : s_statistics->cacheMisses);
+    registerSummary(s_statistics);
+}
@@ -0,0 +1,57 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPLUGINTRACE_P_H
+#define KPLUGINTRACE_P_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+/**
+ * Opt-in timing of plugin discovery and loading, enabled by setting KCOREADDONS_PLUGIN_TRACE=1.
+ * Every measurement is logged to the kf.coreaddons category and a summary is logged when the application exits.
+ */
+namespace KPluginTrace
+{
+enum Phase {
+    NamespaceScan, ///< Finding the plugins of a namespace
+    MetaDataRead, ///< Reading the metadata of a plugin file
+    FactoryLoad, ///< Loading the library of a plugin and creating its factory
+    PluginCreation, ///< Creating a plugin instance using its factory
+};
+
+bool isEnabled();
+/// Only if isEnabled(), see Scope
+void record(Phase phase, const QString &name, qint64 nsecs);
+/// For KPluginMetaData::CacheMetaData
+void recordCacheLookup(bool hit);
+
+/// Records the time until it is destroyed, if tracing is enabled
+class Scope
+{
+public:
+    Scope(Phase phase, const QString &name)
+        : m_phase(phase)
+        , m_name(isEnabled() ? name : QString())
+    {
+        if (isEnabled()) {
+            m_timer.start();
+        }
+    }
+    ~Scope()
+    {
+        if (m_timer.isValid()) {
+            record(m_phase, m_name, m_timer.nsecsElapsed());
+        }
+    }
+    Q_DISABLE_COPY(Scope)
+
+private:
+    const Phase m_phase;
+    const QString m_name;
+    QElapsedTimer m_timer;
+};
+}
+
+#endif
@@ -8,12 +8,18 @@
 
 typedef QHash<QString, QMap<QString, QStaticPlugin>> StaticPluginMap;
 Q_GLOBAL_STATIC(StaticPluginMap, s_staticPlugins)
+static int s_registrationCount = 0;
 
 QMap<QString, QStaticPlugin> KStaticPluginHelpers::staticPlugins(const QString &directory)
 {
     return s_staticPlugins->value(directory);
 }
 
+int KStaticPluginHelpers::registrationCount()
+{
+    return s_registrationCount;
+}
+
 std::optional<QStaticPlugin> KStaticPluginHelpers::findById(const QString &directory, const QString &pluginId)
 {
     const auto staticPlugins = s_staticPlugins->value(directory);
@@ -25,4 +31,5 @@ std::optional<QStaticPlugin> KStaticPluginHelpers::findById(const QString &direc
 KCOREADDONS_EXPORT void kRegisterStaticPluginFunction(const QString &pluginId, const QString &directory, QStaticPlugin plugin)
 {
     (*s_staticPlugins)[directory].insert(pluginId, plugin);
+    ++s_registrationCount;
 }
@@ -16,4 +16,6 @@ namespace KStaticPluginHelpers
 std::optional<QStaticPlugin> findById(const QString &directory, const QString &pluginId);
 /// Map of pluginId and actual plugin
 QMap<QString, QStaticPlugin> staticPlugins(const QString &directory);
+/// Number of plugins registered so far, for invalidating what was looked up before
+int registrationCount();
 }
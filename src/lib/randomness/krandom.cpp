@@ -27,7 +27,38 @@
 #include <QThread>
 #include <QThreadStorage>
 
+#include <algorithm>
+#include <iterator>
+
+// Fills @p out with @p length random characters out of [A-Za-z0-9]
+static void fillRandomString(QChar *out, qsizetype length, QRandomGenerator *generator)
+{
+    static constexpr char alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    static constexpr uchar alphabetSize = sizeof(alphabet) - 1;
+    // Bytes from 248 = 4 * 62 on would favor the first characters, they are rejected
+    static constexpr uchar rejectFrom = (256 / alphabetSize) * alphabetSize;
+
+    // Ask the generator for many bytes at once, about 3% of them get rejected
+    quint32 words[64];
+    while (length > 0) {
+        const qsizetype wordCount = std::min<qsizetype>(std::size(words), (length + length / 16) / 4 + 1);
+        generator->fillRange(words, wordCount);
+        const auto *bytes = reinterpret_cast<const uchar *>(words);
+        for (qsizetype i = 0; i < wordCount * qsizetype(sizeof(quint32)) && length > 0; ++i) {
+            if (bytes[i] < rejectFrom) {
+                *out++ = QLatin1Char(alphabet[bytes[i] % alphabetSize]);
+                --length;
+            }
+        }
+    }
+}
+
 QString KRandom::randomString(int length)
+{
+    return randomString(length, QRandomGenerator::global());
+}
+
+QString KRandom::randomString(int length, QRandomGenerator *generator)
 {
     if (length <= 0) {
         return QString();
@@ -35,18 +66,12 @@ QString KRandom::randomString(int length)
 
     QString str;
     str.resize(length);
-    int i = 0;
-    while (length--) {
-        int r = QRandomGenerator::global()->bounded(62);
-        r += 48;
-        if (r > 57) {
-            r += 7;
-        }
-        if (r > 90) {
-            r += 6;
-        }
-        str[i++] = QLatin1Char(char(r));
-        // so what if I work backwards?
-    }
+    fillRandomString(str.data(), length, generator);
     return str;
 }
+
+QRandomGenerator *KRandom::threadGenerator()
+{
+    static thread_local QRandomGenerator generator(QRandomGenerator::global()->generate());
+    return &generator;
+}
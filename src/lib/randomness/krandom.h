@@ -36,6 +36,35 @@ namespace KRandom
  */
 KCOREADDONS_EXPORT QString randomString(int length);
 
+/**
+ * Generates a random string using the given random number generator.
+ * It operates in the range [A-Za-z0-9]
+ *
+ * The random data is fetched from @p generator in bulk rather than for each character.
+ * Pass threadGenerator() when many strings are needed that don't have to be
+ * hard to predict, e.g. names of temporary files.
+ *
+ * @param length Generate a string of this length.
+ * @param generator the random number generator to use
+ * @return the random string
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QString randomString(int length, QRandomGenerator *generator);
+
+/**
+ * A random number generator for the current thread.
+ *
+ * Unlike QRandomGenerator::global(), which is shared by all threads and backed
+ * by the system, it is never locked and never asks the system for entropy after
+ * having been seeded from QRandomGenerator::global().
+ *
+ * @warning Its output can be predicted, do not use it for anything security
+ * related.
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QRandomGenerator *threadGenerator();
+
 /**
  * Reorders the elements of the given container randomly using the given random number generator.
  *
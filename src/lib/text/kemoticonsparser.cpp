@@ -12,7 +12,9 @@
 #include <QDebug>
 #include <QString>
 
+#include <array>
 #include <cstring>
+#include <iterator>
 
 // ### keep sorted by first column and HTML entity-encoded!
 struct Emoticon {
@@ -144,19 +146,56 @@ static constexpr const Emoticon emoticons_map[] = {
     {"}:-)", "😈"},
 };
 
+// Whether @p prefix is a prefix of @p str, or @p str comes before it
+static constexpr bool isPrefixOrBefore(const char *str, const char *prefix)
+{
+    for (; *prefix; ++str, ++prefix) {
+        if (*str != *prefix) {
+            return uchar(*str) < uchar(*prefix);
+        }
+    }
+    return true;
+}
+
+// findEmoticon() relies on at most one emoticon matching at any position
+static constexpr bool isSortedWithoutPrefixes()
+{
+    for (std::size_t i = 1; i < std::size(emoticons_map); ++i) {
+        if (isPrefixOrBefore(emoticons_map[i].match, emoticons_map[i - 1].match)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(isSortedWithoutPrefixes(), "emoticons_map must be sorted, and no emoticon may start with another one");
+
+// The emoticons starting with each ASCII character, which are next to each other
+struct EmoticonRange {
+    quint8 begin = 0;
+    quint8 end = 0;
+};
+static constexpr auto s_emoticonsByFirstChar = [] {
+    std::array<EmoticonRange, 128> ranges{};
+    for (std::size_t i = 0; i < std::size(emoticons_map); ++i) {
+        EmoticonRange &range = ranges[uchar(emoticons_map[i].match[0])];
+        if (range.begin == range.end) {
+            range.begin = quint8(i);
+        }
+        range.end = quint8(i + 1);
+    }
+    return ranges;
+}();
+
 static const Emoticon *findEmoticon(QStringView s)
 {
-    auto it = std::lower_bound(std::begin(emoticons_map), std::end(emoticons_map), s, [](const auto &emoticon, auto s) {
-        return QLatin1String(emoticon.match) < s;
-    });
-    if (it != std::end(emoticons_map) && s.startsWith(QLatin1String((*it).match))) {
-        return it;
+    if (s.isEmpty() || s.front().unicode() >= 128) {
+        return nullptr;
     }
-    // if we don't have an exact match but a prefix, that will be in the item before the one returned by lower_bound
-    if (it != std::begin(emoticons_map)) {
-        it = std::prev(it);
-        if (s.startsWith(QLatin1String((*it).match))) {
-            return it;
+    // Only the few emoticons starting with the same character can match
+    const EmoticonRange range = s_emoticonsByFirstChar[s.front().unicode()];
+    for (quint8 i = range.begin; i < range.end; ++i) {
+        if (s.startsWith(QLatin1String(emoticons_map[i].match))) {
+            return &emoticons_map[i];
         }
     }
     return nullptr;
@@ -230,6 +269,9 @@ QString KEmoticonsParser::parseEmoticons(const QString &message)
             }
 
             if (found) {
+                if (result.isEmpty()) {
+                    result.reserve(message.length());
+                }
                 result += QStringView(message).mid(previousPos, pos - previousPos);
                 result += QString::fromUtf8(emoticon->replacement);
 
@@ -7,21 +7,130 @@
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
 #include "kfuzzymatcher.h"
+#include "kparallel_p.h"
 
+#include <QByteArray>
+#include <QDataStream>
 #include <QList>
 #include <QString>
+#include <QStringList>
 #include <QStringView>
+#include <QThreadPool>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Strings are matched after folding both the pattern and the string, so that
+ * "e" matches 'e', 'E', 'é' and 'Ê'. Folding a character maps it to its simple
+ * case folding, after stripping the combining marks of its canonical decomposition.
+ * Every string is folded once before matching, ASCII strings with a table of
+ * their own, all others with a table of the whole BMP built on first use.
+ * Folding keeps the length, so that matched positions are those of the string.
+ */
+static constexpr std::array<char16_t, 128> s_asciiFoldTable = []() {
+    std::array<char16_t, 128> table{};
+    for (char16_t c = 0; c < 128; ++c) {
+        table[c] = c >= u'A' && c <= u'Z' ? c - u'A' + u'a' : c;
+    }
+    return table;
+}();
+
+static const char16_t *unicodeFoldTable()
+{
+    static const std::unique_ptr<char16_t[]> table = []() {
+        auto table = std::make_unique<char16_t[]>(0x10000);
+        for (char32_t c = 0; c < 0x10000; ++c) {
+            char16_t base = char16_t(c);
+            // A surrogate is half of a character, which is left as is
+            while (!QChar::isSurrogate(base) && QChar::decompositionTag(base) == QChar::Canonical) {
+                const QString decomposition = QChar::decomposition(base);
+                if (decomposition.isEmpty() || decomposition.at(0).isSurrogate()) {
+                    break;
+                }
+                // Only diacritics are stripped, e.g. Hangul syllables decompose into letters
+                const bool marksOnly = std::all_of(decomposition.cbegin() + 1, decomposition.cend(), [](QChar mark) {
+                    return mark.isMark();
+                });
+                if (!marksOnly) {
+                    break;
+                }
+                base = decomposition.at(0).unicode();
+            }
+            const char32_t folded = QChar::isSurrogate(base) ? base : QChar::toCaseFolded(char32_t(base));
+            table[c] = folded < 0x10000 ? char16_t(folded) : base;
+        }
+        return table;
+    }();
+    return table.get();
+}
+
+static inline char16_t foldChar(char16_t c)
+{
+    return c < 128 ? s_asciiFoldTable[c] : unicodeFoldTable()[c];
+}
+
+// The folding of @p str, with the table chosen once for the whole string
+template<qsizetype Prealloc>
+static void foldString(QStringView str, QVarLengthArray<char16_t, Prealloc> &folded)
+{
+    const char16_t *const chars = str.utf16();
+    const qsizetype size = str.size();
+    folded.resize(size);
+    char16_t bits = 0;
+    for (qsizetype i = 0; i < size; ++i) {
+        bits |= chars[i];
+    }
+    const char16_t *const table = bits < 128 ? s_asciiFoldTable.data() : unicodeFoldTable();
+    for (qsizetype i = 0; i < size; ++i) {
+        folded[i] = table[chars[i]];
+    }
+}
+
+// The scoring of a match, shared by both scorers
+static constexpr int sequentialBonus = 25;
+static constexpr int separatorBonus = 25; // bonus if match occurs after a separator
+static constexpr int camelBonus = 25; // bonus if match is uppercase and prev is lower
+static constexpr int firstLetterBonus = 15; // bonus if the first letter is matched
+
+static constexpr int leadingLetterPenalty = -5; // penalty applied for every letter in str before the first match
+static constexpr int maxLeadingLetterPenalty = -15; // maximum penalty for leading letters
+static constexpr int unmatchedLetterPenalty = -1; // penalty for every letter that doesn't matter
+
+static constexpr int nonBeginSequenceBonus = 10;
 
 /**
- * Custom toLower function which is much faster than
- * c.toLower() directly
+ * The folded pattern, along with the ASCII characters matchSimple() compares
+ * ASCII strings with, for matching many strings without folding the pattern
+ * every time
  */
-static inline constexpr QChar toLower(QChar c)
+struct FoldedPattern {
+    QVarLengthArray<char16_t, 64> lower;
+    QVarLengthArray<char16_t, 64> upper;
+};
+
+static FoldedPattern foldPattern(QStringView pattern)
 {
-    return c.isLower() ? c : c.toLower();
+    FoldedPattern folded;
+    foldString(pattern, folded.lower);
+    for (const char16_t l : std::as_const(folded.lower)) {
+        folded.upper.append(l >= u'a' && l <= u'z' ? l - u'a' + u'A' : l);
+    }
+    return folded;
 }
 
 // internal
+// @p pattern and @p str iterate over the folded characters, the bonuses are
+// given for the characters of @p original
 // clang-format off
 static bool match_recursive(QStringView::const_iterator pattern,
                             QStringView::const_iterator str,
@@ -33,7 +142,8 @@ static bool match_recursive(QStringView::const_iterator pattern,
                             uint8_t *matches,
                             int nextMatch,
                             int &totalMatches,
-                            int &recursionCount)
+                            int &recursionCount,
+                            const QChar *original)
 {
     static constexpr int recursionLimit = 10;
     // max number of matches allowed, this should be enough
@@ -57,12 +167,12 @@ static bool match_recursive(QStringView::const_iterator pattern,
 
     // Loop through pattern and str looking for a match
     bool firstMatch = true;
-    QChar currentPatternChar = toLower(*pattern);
+    QChar currentPatternChar = *pattern;
     // Are we matching in sequence start from start?
     bool matchingInSequence = true;
     while (pattern != patternEnd && str != strEnd) {
         // Found match
-        if (currentPatternChar == toLower(*str)) {
+        if (currentPatternChar == *str) {
             // Supplied matches buffer was too short
             if (nextMatch >= maxMatches) {
                 return false;
@@ -80,7 +190,7 @@ static bool match_recursive(QStringView::const_iterator pattern,
             const auto strNextChar = std::next(str);
             if (!matchingInSequence && match_recursive(pattern, strNextChar, recursiveScore, strBegin,
                                 strEnd, patternEnd, matches, recursiveMatches,
-                                nextMatch, totalMatches, recursionCount)) {
+                                nextMatch, totalMatches, recursionCount, original)) {
                 // Pick best recursive score
                 if (!recursiveMatch || recursiveScore > bestRecursiveScore) {
                     memcpy(bestRecursiveMatches, recursiveMatches, maxMatches);
@@ -92,7 +202,9 @@ static bool match_recursive(QStringView::const_iterator pattern,
             // Advance
             matches[nextMatch++] = (uint8_t)(std::distance(strBegin, str));
             ++pattern;
-            currentPatternChar = toLower(*pattern);
+            if (pattern != patternEnd) {
+                currentPatternChar = *pattern;
+            }
         } else {
             matchingInSequence = false;
         }
@@ -104,17 +216,6 @@ static bool match_recursive(QStringView::const_iterator pattern,
 
     // Calculate score
     if (matched) {
-        static constexpr int sequentialBonus = 25;
-        static constexpr int separatorBonus = 25; // bonus if match occurs after a separator
-        static constexpr int camelBonus = 25; // bonus if match is uppercase and prev is lower
-        static constexpr int firstLetterBonus = 15; // bonus if the first letter is matched
-
-        static constexpr int leadingLetterPenalty = -5; // penalty applied for every letter in str before the first match
-        static constexpr int maxLeadingLetterPenalty = -15; // maximum penalty for leading letters
-        static constexpr int unmatchedLetterPenalty = -1; // penalty for every letter that doesn't matter
-
-        static constexpr int nonBeginSequenceBonus = 10;
-
         // Initialize score
         outScore = 100;
 
@@ -152,8 +253,8 @@ static bool match_recursive(QStringView::const_iterator pattern,
             // Check for bonuses based on neighbor character value
             if (currIdx > 0) {
                 // Camel case
-                const QChar neighbor = *(strBegin + currIdx - 1);
-                const QChar curr = *(strBegin + currIdx);
+                const QChar neighbor = original[currIdx - 1];
+                const QChar curr = original[currIdx];
                 if (neighbor.isLower() && curr.isUpper()) {
                     outScore += camelBonus;
                 }
@@ -189,66 +290,214 @@ static bool match_recursive(QStringView::const_iterator pattern,
 }
 // clang-format on
 
-static bool match_internal(QStringView pattern, QStringView str, int &outScore, unsigned char *matches)
+static bool match_internal(const FoldedPattern &pattern, QStringView str, int &outScore, unsigned char *matches, int &totalMatches)
 {
-    if (pattern.isEmpty()) {
+    if (pattern.lower.isEmpty()) {
         return true;
     }
 
     int recursionCount = 0;
 
-    auto strIt = str.cbegin();
-    auto patternIt = pattern.cbegin();
-    const auto patternEnd = pattern.cend();
-    const auto strEnd = str.cend();
+    QVarLengthArray<char16_t, 256> foldedStr;
+    foldString(str, foldedStr);
+    const QStringView folded(foldedStr.constData(), foldedStr.size());
+    const QStringView lower(pattern.lower.constData(), pattern.lower.size());
+    auto strIt = folded.cbegin();
+    auto patternIt = lower.cbegin();
+    const auto patternEnd = lower.cend();
+    const auto strEnd = folded.cend();
 
+    return match_recursive(patternIt, strIt, outScore, strIt, strEnd, patternEnd, nullptr, matches, 0, totalMatches, recursionCount, str.data());
+}
+
+static bool match_internal(const FoldedPattern &pattern, QStringView str, int &outScore, unsigned char *matches)
+{
     int total = 0;
-    return match_recursive(patternIt, strIt, outScore, strIt, strEnd, patternEnd, nullptr, matches, 0, total, recursionCount);
+    return match_internal(pattern, str, outScore, matches, total);
 }
 
-/**************************************************************/
+/**
+ * Scores @p str with the same rules as match_recursive(), but considers every
+ * possible way of matching the pattern instead of giving up after a few tries.
+ *
+ * Every row holds the best score so far with the current pattern character
+ * matched at each position of @p str. Only two rows are kept, on the stack
+ * for strings of usual length, so this takes O(n·m) time and O(n) memory.
+ */
+static bool match_optimal(const FoldedPattern &pattern, QStringView str, int &outScore)
+{
+    const qsizetype patternSize = pattern.lower.size();
+    const qsizetype size = str.size();
+    if (patternSize == 0) {
+        return true;
+    }
+    if (size < patternSize) {
+        return false;
+    }
 
-bool KFuzzyMatcher::matchSimple(QStringView pattern, QStringView str)
+    static constexpr int noMatch = std::numeric_limits<int>::min() / 2;
+
+    // The folded characters, and the bonus for matching them
+    QVarLengthArray<char16_t, 256> lowered;
+    foldString(str, lowered);
+    QVarLengthArray<int, 256> bonus(size);
+    for (qsizetype j = 0; j < size; ++j) {
+        const QChar c = str[j];
+        if (j == 0) {
+            bonus[j] = firstLetterBonus;
+            continue;
+        }
+        const QChar neighbor = str[j - 1];
+        bonus[j] = 0;
+        if (neighbor.isLower() && c.isUpper()) {
+            bonus[j] += camelBonus;
+        }
+        if (neighbor == QLatin1Char('_') || neighbor == QLatin1Char(' ')) {
+            bonus[j] += separatorBonus;
+        }
+    }
+
+    QVarLengthArray<int, 512> rows(2 * size);
+    int *previous = rows.data();
+    int *current = previous + size;
+    for (qsizetype j = 0; j < size; ++j) {
+        current[j] = lowered[j] == pattern.lower[0] ? bonus[j] + int(std::max<qsizetype>(leadingLetterPenalty * j, maxLeadingLetterPenalty)) : noMatch;
+    }
+
+    for (qsizetype i = 1; i < patternSize; ++i) {
+        std::swap(previous, current);
+        const char16_t patternChar = pattern.lower[i];
+        // The best score of the previous character matched before j - 1
+        int bestBefore = noMatch;
+        for (qsizetype j = 0; j < size; ++j) {
+            if (j >= 2) {
+                bestBefore = std::max(bestBefore, previous[j - 2]);
+            }
+            current[j] = noMatch;
+            if (j == 0 || lowered[j] != patternChar) {
+                continue;
+            }
+            int best = bestBefore;
+            if (previous[j - 1] != noMatch) {
+                // In sequence with the previous character, from the start of str if j == i
+                best = std::max(best, previous[j - 1] + (j == i ? sequentialBonus : nonBeginSequenceBonus));
+            }
+            if (best != noMatch) {
+                current[j] = best + bonus[j];
+            }
+        }
+    }
+
+    const int best = *std::max_element(current, current + size);
+    if (best == noMatch) {
+        return false;
+    }
+    outScore = 100 + best + unmatchedLetterPenalty * int(size - patternSize);
+    return true;
+}
+
+// The first of @p a or @p b in [@p it, @p end), or @p end
+static const char16_t *findEither(const char16_t *it, const char16_t *end, char16_t a, char16_t b)
 {
-    auto patternIt = pattern.cbegin();
-    /**
-     * Instead of doing
-     *
-     *      strIt.toLower() == patternIt.toLower()
-     *
-     * we convert patternIt to Upper / Lower as needed and compare with strIt. This
-     * saves us from calling toLower() on both strings, making things a little bit faster
-     */
-    bool lower = patternIt->isLower();
-    QChar cUp = lower ? patternIt->toUpper() : *patternIt;
-    QChar cLow = lower ? *patternIt : patternIt->toLower();
-    for (auto strIt = str.cbegin(); strIt != str.cend() && patternIt != pattern.cend(); ++strIt) {
-        if (*strIt == cLow || *strIt == cUp) {
-            ++patternIt;
-            lower = patternIt->isLower();
-            cUp = lower ? patternIt->toUpper() : *patternIt;
-            cLow = lower ? *patternIt : patternIt->toLower();
+#ifdef __SSE2__
+    const __m128i needleA = _mm_set1_epi16(short(a));
+    const __m128i needleB = _mm_set1_epi16(short(b));
+    for (; end - it >= 8; it += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(chunk, needleA), _mm_cmpeq_epi16(chunk, needleB)));
+        if (mask != 0) {
+            // Two mask bits for every UTF-16 code unit
+            return it + qCountTrailingZeroBits(uint(mask)) / 2;
+        }
+    }
+#endif
+    for (; it != end; ++it) {
+        if (*it == a || *it == b) {
+            return it;
+        }
+    }
+    return end;
+}
+
+// The same as matchSimple()
+static bool matchSimpleFolded(const FoldedPattern &pattern, QStringView str)
+{
+    const char16_t *it = str.utf16();
+    const char16_t *const end = it + str.size();
+    char16_t bits = 0;
+    for (const char16_t *c = it; c != end; ++c) {
+        bits |= *c;
+    }
+    if (bits >= 128) {
+        // Any character may fold to a pattern character
+        const char16_t *const table = unicodeFoldTable();
+        qsizetype i = 0;
+        for (; it != end && i < pattern.lower.size(); ++it) {
+            if (table[*it] == pattern.lower[i]) {
+                ++i;
+            }
         }
+        return i == pattern.lower.size();
     }
 
-    return patternIt == pattern.cend();
+    // Only the ASCII characters of the pattern can match, in either case
+    for (qsizetype i = 0; i < pattern.lower.size(); ++i) {
+        it = findEither(it, end, pattern.lower[i], pattern.upper[i]);
+        if (it == end) {
+            return false;
+        }
+        ++it;
+    }
+    return true;
 }
 
-KFuzzyMatcher::Result KFuzzyMatcher::match(QStringView pattern, QStringView str)
+// Below this, spreading the scoring over threads costs more than it saves
+static const qsizetype s_parallelMatchThreshold = 4096;
+static const qsizetype s_parallelMatchChunkSize = 1024;
+
+// The number of threads forEachChunk() may use for @p count items
+static int chunkWorkerCount(qsizetype count)
 {
-    /**
-     * Simple substring matching to flush out non-matching strings
-     */
-    const bool simpleMatch = matchSimple(pattern, str);
+    if (count < s_parallelMatchThreshold) {
+        return 1;
+    }
+    const qsizetype chunkCount = (count + s_parallelMatchChunkSize - 1) / s_parallelMatchChunkSize;
+    return int(qBound<qsizetype>(1, chunkCount, QThreadPool::globalInstance()->maxThreadCount()));
+}
+
+/**
+ * Calls @p work(begin, end, worker) for chunks of the items [0, @p count), up to
+ * chunkWorkerCount() of them at once, numbered by @p worker from 0.
+ *
+ * Every thread takes the next chunk until none are left, see KParallel::run().
+ */
+template<typename Work>
+static void forEachChunk(qsizetype count, const Work &work)
+{
+    const int workerCount = chunkWorkerCount(count);
+    if (workerCount == 1) {
+        work(0, count, 0);
+        return;
+    }
+
+    const qsizetype chunkCount = (count + s_parallelMatchChunkSize - 1) / s_parallelMatchChunkSize;
+    std::atomic<qsizetype> nextChunk = 0;
+    const auto worker = [&](int workerIndex) {
+        for (qsizetype chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            work(chunk * s_parallelMatchChunkSize, qMin(count, (chunk + 1) * s_parallelMatchChunkSize), workerIndex);
+        }
+    };
+    KParallel::run(workerCount, worker, [&worker]() {
+        worker(0);
+    });
+}
 
+static KFuzzyMatcher::Result matchFolded(const FoldedPattern &pattern, QStringView str)
+{
     KFuzzyMatcher::Result result;
     result.matched = false;
     result.score = 0;
 
-    if (!simpleMatch) {
-        return result;
-    }
-
     // actual algorithm
     int score = 0;
     uint8_t matches[256];
@@ -258,29 +507,126 @@ KFuzzyMatcher::Result KFuzzyMatcher::match(QStringView pattern, QStringView str)
     return result;
 }
 
-QList<KFuzzyMatcher::Range> KFuzzyMatcher::matchedRanges(QStringView pattern, QStringView str, RangeType type)
+// The same as matchFolded(), matching into the buffer of @p positions
+static KFuzzyMatcher::Result matchFolded(const FoldedPattern &pattern, QStringView str, KFuzzyMatcher::MatchPositions &positions)
 {
-    QList<KFuzzyMatcher::Range> ranges;
-    if (pattern.isEmpty()) {
-        return ranges;
-    }
+    static_assert(KFuzzyMatcher::MatchPositions::capacity == 256, "match_recursive() fills up to 256 matches");
 
+    KFuzzyMatcher::Result result;
+    int score = 0;
     int totalMatches = 0;
+    result.matched = match_internal(pattern, str, score, positions.positions, totalMatches);
+    result.score = score;
+    positions.count = result.matched ? totalMatches : 0;
+    return result;
+}
+
+static KFuzzyMatcher::Result matchOptimalFolded(const FoldedPattern &pattern, QStringView str)
+{
+    KFuzzyMatcher::Result result;
     int score = 0;
-    int recursionCount = 0;
+    result.matched = match_optimal(pattern, str, score);
+    result.score = result.matched ? score : 0;
+    return result;
+}
 
-    auto strIt = str.cbegin();
-    auto patternIt = pattern.cbegin();
-    const auto patternEnd = pattern.cend();
-    const auto strEnd = str.cend();
+static QList<KFuzzyMatcher::Result> matchAllFolded(const FoldedPattern &pattern, const QList<QStringView> &strings)
+{
+    using Result = KFuzzyMatcher::Result;
 
-    uint8_t matches[256];
-    auto res = match_recursive(patternIt, strIt, score, strIt, strEnd, patternEnd, nullptr, matches, 0, totalMatches, recursionCount);
-    // didn't match? => We don't care about results
-    if (!res && type == RangeType::FullyMatched) {
+    QList<Result> results(strings.size());
+    if (pattern.lower.isEmpty()) {
+        for (Result &result : results) {
+            result.matched = true;
+        }
+        return results;
+    }
+
+    QList<qsizetype> candidates;
+    for (qsizetype i = 0; i < strings.size(); ++i) {
+        if (matchSimpleFolded(pattern, strings.at(i))) {
+            candidates.append(i);
+        }
+    }
+
+    Result *const out = results.data();
+    forEachChunk(candidates.size(), [&](qsizetype begin, qsizetype end, int) {
+        uint8_t matches[256];
+        for (qsizetype i = begin; i < end; ++i) {
+            const qsizetype index = candidates.at(i);
+            int score = 0;
+            out[index].matched = match_internal(pattern, strings.at(index), score, matches);
+            out[index].score = score;
+        }
+    });
+    return results;
+}
+
+// A match of rankFolded()
+struct RankedMatch {
+    int score;
+    int index;
+};
+
+// Better matches first, the first candidate first among those with the same score
+static bool isBetterMatch(const RankedMatch &a, const RankedMatch &b)
+{
+    return a.score > b.score || (a.score == b.score && a.index < b.index);
+}
+
+// Keeps the @p count best matches so far in @p heap, with the worst of them on top
+static void keepBestMatch(QList<RankedMatch> &heap, const RankedMatch &match, int count)
+{
+    if (heap.size() < count) {
+        heap.append(match);
+        std::push_heap(heap.begin(), heap.end(), isBetterMatch);
+    } else if (isBetterMatch(match, heap.first())) {
+        std::pop_heap(heap.begin(), heap.end(), isBetterMatch);
+        heap.last() = match;
+        std::push_heap(heap.begin(), heap.end(), isBetterMatch);
+    }
+}
+
+static QList<int> rankFolded(const FoldedPattern &pattern, const QList<QStringView> &candidates, int count)
+{
+    if (count <= 0) {
         return {};
     }
 
+    // Every thread keeps the best matches of the chunks it scored, which are merged afterwards
+    QList<QList<RankedMatch>> heaps(chunkWorkerCount(candidates.size()));
+    QList<RankedMatch> *const threadHeaps = heaps.data();
+    forEachChunk(candidates.size(), [&](qsizetype begin, qsizetype end, int worker) {
+        QList<RankedMatch> &heap = threadHeaps[worker];
+        uint8_t matches[256];
+        for (qsizetype i = begin; i < end; ++i) {
+            const QStringView candidate = candidates.at(i);
+            int score = 0;
+            if (matchSimpleFolded(pattern, candidate) && match_internal(pattern, candidate, score, matches)) {
+                keepBestMatch(heap, {score, int(i)}, count);
+            }
+        }
+    });
+
+    QList<RankedMatch> best = std::move(heaps.first());
+    for (qsizetype i = 1; i < heaps.size(); ++i) {
+        for (const RankedMatch &match : std::as_const(heaps.at(i))) {
+            keepBestMatch(best, match, count);
+        }
+    }
+    std::sort_heap(best.begin(), best.end(), isBetterMatch);
+
+    QList<int> top;
+    top.reserve(best.size());
+    for (const RankedMatch &match : std::as_const(best)) {
+        top.append(match.index);
+    }
+    return top;
+}
+
+static QList<KFuzzyMatcher::Range> rangesOf(const uint8_t *matches, int totalMatches)
+{
+    QList<KFuzzyMatcher::Range> ranges;
     int previousMatch = 0;
     for (int i = 0; i < totalMatches; ++i) {
         auto matchPos = matches[i];
@@ -302,3 +648,508 @@ QList<KFuzzyMatcher::Range> KFuzzyMatcher::matchedRanges(QStringView pattern, QS
 
     return ranges;
 }
+
+static QList<KFuzzyMatcher::Range> matchedRangesFolded(const FoldedPattern &pattern, QStringView str, KFuzzyMatcher::RangeType type)
+{
+    if (pattern.lower.isEmpty()) {
+        return {};
+    }
+
+    int totalMatches = 0;
+    int score = 0;
+
+    uint8_t matches[256];
+    auto res = match_internal(pattern, str, score, matches, totalMatches);
+    // didn't match? => We don't care about results
+    if (!res && type == KFuzzyMatcher::RangeType::FullyMatched) {
+        return {};
+    }
+
+    return rangesOf(matches, totalMatches);
+}
+
+/**************************************************************/
+
+bool KFuzzyMatcher::matchSimple(QStringView pattern, QStringView str)
+{
+    return matchSimpleFolded(foldPattern(pattern), str);
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::match(QStringView pattern, QStringView str)
+{
+    /**
+     * Simple substring matching to flush out non-matching strings
+     */
+    const FoldedPattern folded = foldPattern(pattern);
+    const bool simpleMatch = matchSimpleFolded(folded, str);
+
+    if (!simpleMatch) {
+        return Result{};
+    }
+
+    return matchFolded(folded, str);
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::match(QStringView pattern, QStringView str, MatchPositions &positions)
+{
+    positions.count = 0;
+    const FoldedPattern folded = foldPattern(pattern);
+    if (!matchSimpleFolded(folded, str)) {
+        return Result{};
+    }
+
+    return matchFolded(folded, str, positions);
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::matchOptimal(QStringView pattern, QStringView str)
+{
+    const FoldedPattern folded = foldPattern(pattern);
+    if (!matchSimpleFolded(folded, str)) {
+        return Result{};
+    }
+
+    return matchOptimalFolded(folded, str);
+}
+
+QList<KFuzzyMatcher::Result> KFuzzyMatcher::matchAll(QStringView pattern, const QList<QStringView> &strings)
+{
+    return matchAllFolded(foldPattern(pattern), strings);
+}
+
+QList<int> KFuzzyMatcher::rank(QStringView pattern, const QList<QStringView> &candidates, int count)
+{
+    return rankFolded(foldPattern(pattern), candidates, count);
+}
+
+QList<KFuzzyMatcher::Range> KFuzzyMatcher::matchedRanges(QStringView pattern, QStringView str, RangeType type)
+{
+    return matchedRangesFolded(foldPattern(pattern), str, type);
+}
+
+QList<KFuzzyMatcher::Range> KFuzzyMatcher::MatchPositions::ranges() const
+{
+    return rangesOf(positions, count);
+}
+
+class KFuzzyMatcher::PatternPrivate : public QSharedData
+{
+public:
+    QString pattern;
+    FoldedPattern folded;
+};
+
+KFuzzyMatcher::Pattern::Pattern(QStringView pattern)
+    : d(new PatternPrivate)
+{
+    d->pattern = pattern.toString();
+    d->folded = foldPattern(pattern);
+}
+
+KFuzzyMatcher::Pattern::Pattern(const Pattern &other) = default;
+
+KFuzzyMatcher::Pattern &KFuzzyMatcher::Pattern::operator=(const Pattern &other) = default;
+
+KFuzzyMatcher::Pattern::~Pattern() = default;
+
+QString KFuzzyMatcher::Pattern::pattern() const
+{
+    return d->pattern;
+}
+
+bool KFuzzyMatcher::Pattern::isEmpty() const
+{
+    return d->pattern.isEmpty();
+}
+
+bool KFuzzyMatcher::Pattern::matchSimple(QStringView str) const
+{
+    return matchSimpleFolded(d->folded, str);
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::Pattern::match(QStringView str) const
+{
+    if (!matchSimpleFolded(d->folded, str)) {
+        return Result{};
+    }
+    return matchFolded(d->folded, str);
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::Pattern::match(QStringView str, MatchPositions &positions) const
+{
+    positions.count = 0;
+    if (!matchSimpleFolded(d->folded, str)) {
+        return Result{};
+    }
+    return matchFolded(d->folded, str, positions);
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::Pattern::matchOptimal(QStringView str) const
+{
+    if (!matchSimpleFolded(d->folded, str)) {
+        return Result{};
+    }
+    return matchOptimalFolded(d->folded, str);
+}
+
+QList<KFuzzyMatcher::Result> KFuzzyMatcher::Pattern::matchAll(const QList<QStringView> &strings) const
+{
+    return matchAllFolded(d->folded, strings);
+}
+
+QList<int> KFuzzyMatcher::Pattern::rank(const QList<QStringView> &candidates, int count) const
+{
+    return rankFolded(d->folded, candidates, count);
+}
+
+QList<KFuzzyMatcher::Range> KFuzzyMatcher::Pattern::matchedRanges(QStringView str, RangeType type) const
+{
+    return matchedRangesFolded(d->folded, str, type);
+}
+
+class KFuzzyMatcher::FilterPrivate
+{
+public:
+    void match(const QList<int> &indexes);
+
+    QStringList candidates;
+    QString pattern;
+    // In the same order, the matching candidates and their scores
+    QList<int> matches;
+    QList<int> scores;
+};
+
+void KFuzzyMatcher::FilterPrivate::match(const QList<int> &indexes)
+{
+    QList<QStringView> strings;
+    strings.reserve(indexes.size());
+    for (int index : indexes) {
+        strings.append(candidates.at(index));
+    }
+    const QList<Result> results = Pattern(pattern).matchAll(strings);
+
+    QList<int> newMatches;
+    QList<int> newScores;
+    for (qsizetype i = 0; i < results.size(); ++i) {
+        if (results.at(i).matched) {
+            newMatches.append(indexes.at(i));
+            newScores.append(results.at(i).score);
+        }
+    }
+    matches = std::move(newMatches);
+    scores = std::move(newScores);
+}
+
+KFuzzyMatcher::Filter::Filter(const QStringList &candidates)
+    : d(new FilterPrivate)
+{
+    setCandidates(candidates);
+}
+
+KFuzzyMatcher::Filter::~Filter() = default;
+
+void KFuzzyMatcher::Filter::setCandidates(const QStringList &candidates)
+{
+    d->candidates = candidates;
+    QList<int> indexes(candidates.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    d->match(indexes);
+}
+
+QStringList KFuzzyMatcher::Filter::candidates() const
+{
+    return d->candidates;
+}
+
+void KFuzzyMatcher::Filter::setPattern(QStringView pattern)
+{
+    if (pattern == d->pattern) {
+        return;
+    }
+
+    // Whatever matches the longer pattern also matches the previous one
+    const bool extended = pattern.startsWith(d->pattern);
+    d->pattern = pattern.toString();
+    if (extended) {
+        d->match(d->matches);
+    } else {
+        QList<int> indexes(d->candidates.size());
+        std::iota(indexes.begin(), indexes.end(), 0);
+        d->match(indexes);
+    }
+}
+
+QString KFuzzyMatcher::Filter::pattern() const
+{
+    return d->pattern;
+}
+
+QList<int> KFuzzyMatcher::Filter::matches() const
+{
+    return d->matches;
+}
+
+KFuzzyMatcher::Result KFuzzyMatcher::Filter::result(int index) const
+{
+    const auto it = std::lower_bound(d->matches.cbegin(), d->matches.cend(), index);
+    if (it == d->matches.cend() || *it != index) {
+        return Result{};
+    }
+    Result result;
+    result.matched = true;
+    result.score = d->scores.at(std::distance(d->matches.cbegin(), it));
+    return result;
+}
+
+QList<int> KFuzzyMatcher::Filter::topMatches(int count) const
+{
+    if (count <= 0) {
+        return {};
+    }
+
+    // Positions in d->matches, ordered from the best to the worst match
+    const auto better = [this](qsizetype a, qsizetype b) {
+        const int scoreA = d->scores.at(a);
+        const int scoreB = d->scores.at(b);
+        return scoreA > scoreB || (scoreA == scoreB && a < b);
+    };
+
+    // A heap of the best matches so far, with the worst of them on top
+    QList<qsizetype> heap;
+    heap.reserve(qMin<qsizetype>(count, d->matches.size()));
+    for (qsizetype i = 0; i < d->matches.size(); ++i) {
+        if (heap.size() < count) {
+            heap.append(i);
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(i, heap.first())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.last() = i;
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), better);
+
+    QList<int> top;
+    top.reserve(heap.size());
+    for (qsizetype i : std::as_const(heap)) {
+        top.append(d->matches.at(i));
+    }
+    return top;
+}
+
+// Starts stored indexes, with the version of their format
+static const quint32 s_indexMagic = 0x4b464931; // "KFI1"
+
+/**
+ * The candidates containing each folded character, as sorted lists of their
+ * indexes stored one after the other in postings: those containing
+ * characters[i] are postings[offsets[i]] up to postings[offsets[i + 1]].
+ */
+class KFuzzyMatcher::IndexPrivate : public QSharedData
+{
+public:
+    void build();
+    bool isValid() const;
+    // nullptr if no candidate contains @p c
+    const quint32 *postingsOf(char16_t c, qsizetype *count) const;
+    QList<int> preselect(const FoldedPattern &pattern) const;
+
+    QStringList candidates;
+    QList<quint16> characters;
+    QList<quint32> offsets;
+    QList<quint32> postings;
+};
+
+void KFuzzyMatcher::IndexPrivate::build()
+{
+    // The folded characters of every candidate, each once, as (character, candidate) pairs
+    QList<std::pair<char16_t, quint32>> occurrences;
+    QVarLengthArray<char16_t, 256> folded;
+    for (qsizetype i = 0; i < candidates.size(); ++i) {
+        foldString(QStringView(candidates.at(i)), folded);
+        std::sort(folded.begin(), folded.end());
+        const auto end = std::unique(folded.begin(), folded.end());
+        for (auto it = folded.begin(); it != end; ++it) {
+            occurrences.append({*it, quint32(i)});
+        }
+    }
+    // Stable, so the candidates of a character stay sorted
+    std::stable_sort(occurrences.begin(), occurrences.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+
+    characters.clear();
+    offsets.clear();
+    postings.clear();
+    postings.reserve(occurrences.size());
+    for (const auto &[c, candidate] : std::as_const(occurrences)) {
+        if (characters.isEmpty() || characters.last() != c) {
+            characters.append(c);
+            offsets.append(quint32(postings.size()));
+        }
+        postings.append(candidate);
+    }
+    offsets.append(quint32(postings.size()));
+}
+
+// Whether the lists of a loaded index stay within their bounds
+bool KFuzzyMatcher::IndexPrivate::isValid() const
+{
+    if (offsets.size() != characters.size() + 1 || offsets.first() != 0 || offsets.last() != quint32(postings.size())) {
+        return false;
+    }
+    if (!std::is_sorted(characters.cbegin(), characters.cend()) || !std::is_sorted(offsets.cbegin(), offsets.cend())) {
+        return false;
+    }
+    return std::all_of(postings.cbegin(), postings.cend(), [this](quint32 candidate) {
+        return candidate < quint32(candidates.size());
+    });
+}
+
+const quint32 *KFuzzyMatcher::IndexPrivate::postingsOf(char16_t c, qsizetype *count) const
+{
+    const auto it = std::lower_bound(characters.cbegin(), characters.cend(), c);
+    if (it == characters.cend() || *it != c) {
+        return nullptr;
+    }
+    const qsizetype i = std::distance(characters.cbegin(), it);
+    *count = offsets.at(i + 1) - offsets.at(i);
+    return postings.constData() + offsets.at(i);
+}
+
+QList<int> KFuzzyMatcher::IndexPrivate::preselect(const FoldedPattern &pattern) const
+{
+    QList<int> selected;
+    if (pattern.lower.isEmpty()) {
+        selected.resize(candidates.size());
+        std::iota(selected.begin(), selected.end(), 0);
+        return selected;
+    }
+
+    QVarLengthArray<char16_t, 64> chars(pattern.lower.cbegin(), pattern.lower.cend());
+    std::sort(chars.begin(), chars.end());
+    chars.erase(std::unique(chars.begin(), chars.end()), chars.end());
+
+    struct Postings {
+        const quint32 *begin;
+        const quint32 *end;
+    };
+    QVarLengthArray<Postings, 64> lists;
+    for (const char16_t c : std::as_const(chars)) {
+        qsizetype count = 0;
+        const quint32 *list = postingsOf(c, &count);
+        if (!list) {
+            return selected;
+        }
+        lists.append({list, list + count});
+    }
+    // Starting with the shortest list, the others are only searched for its entries
+    std::sort(lists.begin(), lists.end(), [](const Postings &a, const Postings &b) {
+        return a.end - a.begin < b.end - b.begin;
+    });
+
+    for (const quint32 *candidate = lists.first().begin; candidate != lists.first().end; ++candidate) {
+        bool inAll = true;
+        for (qsizetype i = 1; i < lists.size(); ++i) {
+            // The entries are sorted, so the next search starts where this one ended
+            Postings &list = lists[i];
+            list.begin = std::lower_bound(list.begin, list.end, *candidate);
+            if (list.begin == list.end) {
+                return selected;
+            }
+            if (*list.begin != *candidate) {
+                inAll = false;
+                break;
+            }
+        }
+        if (inAll) {
+            selected.append(int(*candidate));
+        }
+    }
+    return selected;
+}
+
+KFuzzyMatcher::Index::Index(const QStringList &candidates)
+    : d(new IndexPrivate)
+{
+    d->candidates = candidates;
+    d->build();
+}
+
+KFuzzyMatcher::Index::Index(const Index &other) = default;
+
+KFuzzyMatcher::Index &KFuzzyMatcher::Index::operator=(const Index &other) = default;
+
+KFuzzyMatcher::Index::~Index() = default;
+
+QStringList KFuzzyMatcher::Index::candidates() const
+{
+    return d->candidates;
+}
+
+QList<int> KFuzzyMatcher::Index::preselect(const Pattern &pattern) const
+{
+    return d->preselect(pattern.d->folded);
+}
+
+QList<int> KFuzzyMatcher::Index::matches(const Pattern &pattern) const
+{
+    const QList<int> selected = preselect(pattern);
+    QList<QStringView> strings;
+    strings.reserve(selected.size());
+    for (int index : selected) {
+        strings.append(d->candidates.at(index));
+    }
+    const QList<Result> results = matchAllFolded(pattern.d->folded, strings);
+
+    QList<int> matching;
+    for (qsizetype i = 0; i < results.size(); ++i) {
+        if (results.at(i).matched) {
+            matching.append(selected.at(i));
+        }
+    }
+    return matching;
+}
+
+QList<int> KFuzzyMatcher::Index::rank(const Pattern &pattern, int count) const
+{
+    const QList<int> selected = preselect(pattern);
+    QList<QStringView> strings;
+    strings.reserve(selected.size());
+    for (int index : selected) {
+        strings.append(d->candidates.at(index));
+    }
+    // The preselected candidates keep their order, so ties are still broken by it
+    QList<int> top = rankFolded(pattern.d->folded, strings, count);
+    for (int &index : top) {
+        index = selected.at(index);
+    }
+    return top;
+}
+
+QByteArray KFuzzyMatcher::Index::toData() const
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_5);
+    stream << s_indexMagic << d->candidates << d->characters << d->offsets << d->postings;
+    return data;
+}
+
+KFuzzyMatcher::Index KFuzzyMatcher::Index::fromData(const QByteArray &data)
+{
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_6_5);
+    quint32 magic = 0;
+    stream >> magic;
+    if (magic != s_indexMagic) {
+        return Index();
+    }
+
+    Index index;
+    IndexPrivate *d = index.d.data();
+    stream >> d->candidates >> d->characters >> d->offsets >> d->postings;
+    if (stream.status() != QDataStream::Ok || !d->isValid()) {
+        return Index();
+    }
+    return index;
+}
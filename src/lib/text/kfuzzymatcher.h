@@ -11,9 +11,13 @@
 
 #include <kcoreaddons_export.h>
 
+#include <QSharedDataPointer>
 #include <QtContainerFwd>
 #include <QtGlobal>
 
+#include <memory>
+
+class QByteArray;
 class QString;
 class QStringView;
 
@@ -29,7 +33,8 @@ class QStringView;
  * All character matches will happen sequentially. That means that this function is not
  * typo tolerant i.e., "gti" will not match "git", but "gt" will. All methods in here are
  * stateless i.e., the input string will not be modified. Also note that strings in all the
- * functions in this namespace will be matched case-insensitively.
+ * functions in this namespace will be matched case-insensitively, and since 6.0 also
+ * ignoring diacritics, e.g. "cafe" matches "Café".
  *
  * Limitations:
  * - Currently this will match only strings with length < 256 correctly. This is because we
@@ -101,6 +106,40 @@ struct KCOREADDONS_EXPORT Range {
     int length;
 };
 
+/**
+ * @brief The positions of the characters of a string matched by a pattern
+ *
+ * The overloads of match() taking it fill it along with the score, so that a
+ * filter highlighting the visible matches doesn't need to call matchedRanges()
+ * and match them once more. It holds its positions itself, and can be kept on
+ * the stack or reused for every string:
+ *
+ * @code
+ * KFuzzyMatcher::MatchPositions positions;
+ * const KFuzzyMatcher::Result result = pattern.match(str, positions);
+ * for (int i = 0; i < positions.count; ++i) {
+ *     // str.at(positions.positions[i]) matched
+ * }
+ * @endcode
+ *
+ * @since 6.0
+ */
+struct KCOREADDONS_EXPORT MatchPositions {
+    /** The maximum number of positions, see the limitations of KFuzzyMatcher */
+    static constexpr int capacity = 256;
+
+    /** The matched positions in the string, in increasing order */
+    quint8 positions[capacity];
+    /** The number of matched positions, zero if the pattern didn't match or was empty */
+    int count = 0;
+
+    /**
+     * @return the positions merged into ranges, the same as matchedRanges()
+     * returns for a fully matched string
+     */
+    QList<Range> ranges() const;
+};
+
 /**
  * @brief The type of matches to consider when requesting for ranges.
  * @see matchedRanges
@@ -120,6 +159,249 @@ enum class RangeType : unsigned char {
     All
 };
 
+class PatternPrivate;
+class FilterPrivate;
+class IndexPrivate;
+
+/**
+ * @brief A pattern prepared once for matching against many strings
+ *
+ * The functions in this namespace prepare the pattern again for every
+ * string they are called with, e.g. case fold its characters. A Pattern
+ * does this once, so that a filter matching the text entered by the user
+ * against a whole list only pays for it once per keystroke:
+ *
+ * @code
+ * const KFuzzyMatcher::Pattern pattern(filterText);
+ * for (const QString &action : actions) {
+ *     const KFuzzyMatcher::Result result = pattern.match(action);
+ *     // ...
+ * }
+ * @endcode
+ *
+ * The results are the same as those of the corresponding functions in
+ * this namespace.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT Pattern
+{
+public:
+    /**
+     * Prepares @p pattern for matching
+     */
+    explicit Pattern(QStringView pattern = {});
+    Pattern(const Pattern &other);
+    Pattern &operator=(const Pattern &other);
+    ~Pattern();
+
+    /**
+     * @return the pattern this was created with
+     */
+    QString pattern() const;
+
+    /**
+     * @return @c true if the pattern is empty, which matches every string
+     */
+    bool isEmpty() const;
+
+    /**
+     * The same as KFuzzyMatcher::matchSimple() with this pattern
+     */
+    bool matchSimple(QStringView str) const;
+
+    /**
+     * The same as KFuzzyMatcher::match() with this pattern
+     */
+    Result match(QStringView str) const;
+
+    /**
+     * The same as KFuzzyMatcher::match() with this pattern, also returning
+     * the matched positions in @p positions
+     */
+    Result match(QStringView str, MatchPositions &positions) const;
+
+    /**
+     * The same as KFuzzyMatcher::matchOptimal() with this pattern
+     */
+    Result matchOptimal(QStringView str) const;
+
+    /**
+     * The same as KFuzzyMatcher::matchAll() with this pattern
+     */
+    QList<Result> matchAll(const QList<QStringView> &strings) const;
+
+    /**
+     * The same as KFuzzyMatcher::rank() with this pattern
+     */
+    QList<int> rank(const QList<QStringView> &candidates, int count) const;
+
+    /**
+     * The same as KFuzzyMatcher::matchedRanges() with this pattern
+     */
+    QList<Range> matchedRanges(QStringView str, RangeType type = RangeType::FullyMatched) const;
+
+private:
+    friend class Index;
+    QSharedDataPointer<PatternPrivate> d;
+};
+
+/**
+ * @brief Fuzzy filtering of a list of strings as the user types
+ *
+ * A Filter remembers which candidates matched the last pattern. When the
+ * new pattern starts with the previous one, e.g. "kdirw" after "kdir", only
+ * those are matched again, as no other candidate can match it. The work done
+ * for every keystroke thus shrinks as the pattern gets longer.
+ *
+ * @code
+ * KFuzzyMatcher::Filter filter(actionNames);
+ * // whenever the text of the search field changes
+ * filter.setPattern(searchText);
+ * for (int index : filter.topMatches(20)) {
+ *     // show actionNames.at(index)
+ * }
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT Filter
+{
+public:
+    /**
+     * Creates a filter over @p candidates, with an empty pattern matching
+     * all of them
+     */
+    explicit Filter(const QStringList &candidates = {});
+    ~Filter();
+
+    /**
+     * Replaces the strings to filter, and matches them against the current
+     * pattern again
+     */
+    void setCandidates(const QStringList &candidates);
+
+    /**
+     * @return the strings being filtered
+     */
+    QStringList candidates() const;
+
+    /**
+     * Matches the candidates against @p pattern. If it starts with the
+     * previous pattern, only the candidates which matched that are tried.
+     */
+    void setPattern(QStringView pattern);
+
+    /**
+     * @return the current pattern
+     */
+    QString pattern() const;
+
+    /**
+     * @return the indexes of the candidates matching the current pattern,
+     * in the order of the candidates
+     */
+    QList<int> matches() const;
+
+    /**
+     * @return the result of matching the candidate at @p index
+     */
+    Result result(int index) const;
+
+    /**
+     * @return the indexes of the at most @p count best matching candidates,
+     * the best one first. Candidates with the same score keep their order.
+     *
+     * This only sorts the returned candidates, not all of the matching ones.
+     */
+    QList<int> topMatches(int count) const;
+
+private:
+    Q_DISABLE_COPY(Filter)
+    std::unique_ptr<FilterPrivate> const d;
+};
+
+/**
+ * @brief An index of a fixed list of strings, for matching many patterns against it
+ *
+ * A string can only match a pattern if it contains all characters of the
+ * pattern. The index lists the strings containing every character, so that
+ * a pattern is only matched against the strings in all of the lists of its
+ * characters, instead of against every string. This pays off for long lists
+ * that rarely change, e.g. the installed applications or the files of a
+ * project, where most strings lack one of the characters typed.
+ *
+ * Building the index takes a pass over all strings. An index can be stored,
+ * e.g. in a KSharedDataCache, and loaded again without building it:
+ *
+ * @code
+ * QByteArray data;
+ * KFuzzyMatcher::Index index;
+ * if (cache->find(key, &data)) {
+ *     index = KFuzzyMatcher::Index::fromData(data);
+ * }
+ * if (index.candidates() != fileNames) {
+ *     index = KFuzzyMatcher::Index(fileNames);
+ *     cache->insert(key, index.toData());
+ * }
+ * // on every keystroke
+ * const QList<int> best = index.rank(KFuzzyMatcher::Pattern(searchText), 20);
+ * @endcode
+ *
+ * The results are the same as those of the corresponding functions of Pattern
+ * for the whole list.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT Index
+{
+public:
+    /**
+     * Builds the index of @p candidates
+     */
+    explicit Index(const QStringList &candidates = {});
+    Index(const Index &other);
+    Index &operator=(const Index &other);
+    ~Index();
+
+    /**
+     * @return the indexed strings
+     */
+    QStringList candidates() const;
+
+    /**
+     * @return the indexes of the candidates which may match @p pattern, in the
+     * order of the candidates. These contain all of the matching ones, but not
+     * all of them need to match.
+     */
+    QList<int> preselect(const Pattern &pattern) const;
+
+    /**
+     * @return the indexes of the candidates matching @p pattern, in the order
+     * of the candidates
+     */
+    QList<int> matches(const Pattern &pattern) const;
+
+    /**
+     * The same as Pattern::rank() for all candidates
+     */
+    QList<int> rank(const Pattern &pattern, int count) const;
+
+    /**
+     * @return the index as data which fromData() loads again
+     */
+    QByteArray toData() const;
+
+    /**
+     * Loads an index stored with toData()
+     * @return the index, or an empty one if @p data isn't a stored index
+     */
+    static Index fromData(const QByteArray &data);
+
+private:
+    QSharedDataPointer<IndexPrivate> d;
+};
+
 /**
  * @brief Simple fuzzy matching of chars in @p pattern with chars in @p str
  * sequentially. If there is a match, it will return true and false otherwise.
@@ -143,6 +425,8 @@ KCOREADDONS_EXPORT bool matchSimple(QStringView pattern, QStringView str);
  * The return value of this function contains Result#score which should be used to
  * sort the results. Without sorting of the results this function won't very effective.
  *
+ * When matching many strings against the same pattern, use Pattern::match() instead.
+ *
  * If @p pattern is empty, the function will return @c true
  *
  * @param pattern to search for. For e.g., text entered by a user to filter a
@@ -156,6 +440,82 @@ KCOREADDONS_EXPORT bool matchSimple(QStringView pattern, QStringView str);
  */
 KCOREADDONS_EXPORT Result match(QStringView pattern, QStringView str);
 
+/**
+ * @brief Scored fuzzy matching like match(), which also returns the
+ * positions in @p str matched by @p pattern.
+ *
+ * This is cheaper than calling match() and matchedRanges() for the same
+ * string, which matches it twice, and doesn't allocate memory.
+ *
+ * @param pattern to search for. For e.g., text entered by a user to filter a
+ * list or model
+ * @param str the current string from your list of strings
+ * @param positions filled with the matched positions, empty if there is no match
+ * @return the same as match()
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT Result match(QStringView pattern, QStringView str, MatchPositions &positions);
+
+/**
+ * @brief Scored fuzzy matching like match(), which always finds the best score.
+ *
+ * match() only tries a limited number of ways to match @p pattern, and can't
+ * match strings of 256 characters or more. This function scores every possible
+ * way with the same rules, so that its score is never lower than that of match(),
+ * and has no limit on the length of @p str. Its running time grows with the
+ * length of @p pattern times the length of @p str, which makes it the better
+ * choice for long strings like file paths.
+ *
+ * If @p pattern is empty, the function will return @c true
+ *
+ * @param pattern to search for. For e.g., text entered by a user to filter a
+ * list or model
+ * @param str the current string from your list of strings
+ * @return A Result type with the best score of this match and whether the match
+ * was successful. If there is no match, score is zero.
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT Result matchOptimal(QStringView pattern, QStringView str);
+
+/**
+ * @brief Scored fuzzy matching of @p pattern against every string in @p strings,
+ * with the same results as calling match() for each of them.
+ *
+ * Use this when matching against many strings at once, e.g. a whole list of
+ * actions or files on every keystroke. The case folding of @p pattern is only
+ * done once, the strings not containing it are rejected with a vectorized scan
+ * where possible, and only the remaining ones are scored, on several threads
+ * for long lists.
+ *
+ * @param pattern to search for. For e.g., text entered by a user to filter a
+ * list or model
+ * @param strings the strings to match against
+ * @return the Result of every string in @p strings, in the same order
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QList<Result> matchAll(QStringView pattern, const QList<QStringView> &strings);
+
+/**
+ * @brief The best matches of @p pattern among @p candidates, as scored by match().
+ *
+ * This is cheaper than sorting the results of matchAll(): the candidates are
+ * matched on several threads for long lists, every thread only keeps its
+ * @p count best matches, and only those are merged and sorted.
+ *
+ * @param pattern to search for. For e.g., text entered by a user to filter a
+ * list or model
+ * @param candidates the strings to match against
+ * @param count the maximum number of matches to return
+ * @return the indexes in @p candidates of the at most @p count best matching
+ * ones, the best one first. Candidates with the same score keep their order.
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QList<int> rank(QStringView pattern, const QList<QStringView> &candidates, int count);
+
 /**
  * @brief A function which returns the positions + lengths where the @p pattern matched
  * inside the @p str. The resulting ranges can then be utilized to show the user where
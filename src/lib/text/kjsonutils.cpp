@@ -6,30 +6,156 @@
 */
 
 #include "kjsonutils.h"
+#include "kjsonutils_p.h"
 
 #include <QJsonObject>
+#include <QMutex>
+#include <QSet>
+#include <QVarLengthArray>
 
-QJsonValue KJsonUtils::readTranslatedValue(const QJsonObject &jo, const QString &key, const QJsonValue &defaultValue)
+#include <algorithm>
+#include <optional>
+
+class KJsonUtils::TranslatedKeyLookupPrivate : public QSharedData
 {
-    QString languageWithCountry = QLocale().name();
-    auto it = jo.constFind(key + QLatin1Char('[') + languageWithCountry + QLatin1Char(']'));
-    if (it != jo.constEnd()) {
-        return it.value();
+public:
+    explicit TranslatedKeyLookupPrivate(const QLocale &locale)
+        : locale(locale)
+    {
+        const QString languageWithCountry = locale.name();
+        const QStringView language = QStringView(languageWithCountry).mid(0, languageWithCountry.indexOf(QLatin1Char('_')));
+        withCountrySuffix = QLatin1Char('[') + languageWithCountry + QLatin1Char(']');
+        // e.g. for the C locale, there is no separate language to fall back to
+        if (language.size() != languageWithCountry.size()) {
+            languageSuffix = QLatin1Char('[') + language + QLatin1Char(']');
+        }
     }
-    const QStringView language = QStringView(languageWithCountry).mid(0, languageWithCountry.indexOf(QLatin1Char('_')));
-    it = jo.constFind(key + QLatin1Char('[') + language + QLatin1Char(']'));
+
+    QJsonObject::const_iterator find(const QJsonObject &jo, QStringView key) const;
+
+    const QLocale locale;
+    // "[de_DE]" and "[de]"
+    QString withCountrySuffix;
+    QString languageSuffix;
+};
+
+// Key buffer that doesn't need to allocate for the usual keys
+using KeyBuffer = QVarLengthArray<QChar, 64>;
+
+static QStringView suffixedKey(KeyBuffer &buffer, QStringView key, QStringView suffix)
+{
+    buffer.resize(key.size() + suffix.size());
+    std::copy(key.begin(), key.end(), buffer.begin());
+    std::copy(suffix.begin(), suffix.end(), buffer.begin() + key.size());
+    return QStringView(buffer.constData(), buffer.size());
+}
+
+QJsonObject::const_iterator KJsonUtils::TranslatedKeyLookupPrivate::find(const QJsonObject &jo, QStringView key) const
+{
+    KeyBuffer buffer;
+    auto it = jo.constFind(suffixedKey(buffer, key, withCountrySuffix));
     if (it != jo.constEnd()) {
-        return it.value();
+        return it;
+    }
+    if (!languageSuffix.isEmpty()) {
+        it = jo.constFind(suffixedKey(buffer, key, languageSuffix));
+        if (it != jo.constEnd()) {
+            return it;
+        }
     }
     // no translated value found -> check key
-    it = jo.constFind(key);
-    if (it != jo.constEnd()) {
-        return jo.value(key);
+    return jo.constFind(key);
+}
+
+KJsonUtils::TranslatedKeyLookup::TranslatedKeyLookup(const QLocale &locale)
+    : d(new TranslatedKeyLookupPrivate(locale))
+{
+}
+
+KJsonUtils::TranslatedKeyLookup::TranslatedKeyLookup(const TranslatedKeyLookup &other) = default;
+
+KJsonUtils::TranslatedKeyLookup &KJsonUtils::TranslatedKeyLookup::operator=(const TranslatedKeyLookup &other) = default;
+
+KJsonUtils::TranslatedKeyLookup::~TranslatedKeyLookup() = default;
+
+QLocale KJsonUtils::TranslatedKeyLookup::locale() const
+{
+    return d->locale;
+}
+
+QJsonValue KJsonUtils::TranslatedKeyLookup::value(const QJsonObject &jo, QStringView key, const QJsonValue &defaultValue) const
+{
+    const auto it = d->find(jo, key);
+    return it != jo.constEnd() ? it.value() : defaultValue;
+}
+
+QString KJsonUtils::TranslatedKeyLookup::string(const QJsonObject &jo, QStringView key, const QString &defaultValue) const
+{
+    return value(jo, key, defaultValue).toString(defaultValue);
+}
+
+QList<QJsonValue> KJsonUtils::TranslatedKeyLookup::values(const QJsonObject &jo, const QList<QStringView> &keys) const
+{
+    QList<QJsonValue> result;
+    result.reserve(keys.size());
+    for (const QStringView key : keys) {
+        const auto it = d->find(jo, key);
+        result.append(it != jo.constEnd() ? it.value() : QJsonValue(QJsonValue::Undefined));
     }
-    return defaultValue;
+    return result;
+}
+
+// The lookup for the default locale, kept until that changes
+static const KJsonUtils::TranslatedKeyLookup &defaultLookup()
+{
+    thread_local std::optional<KJsonUtils::TranslatedKeyLookup> lookup;
+    const QLocale locale;
+    if (!lookup || lookup->locale() != locale) {
+        lookup.emplace(locale);
+    }
+    return *lookup;
+}
+
+QJsonValue KJsonUtils::readTranslatedValue(const QJsonObject &jo, const QString &key, const QJsonValue &defaultValue)
+{
+    return defaultLookup().value(jo, key, defaultValue);
 }
 
 QString KJsonUtils::readTranslatedString(const QJsonObject &jo, const QString &key, const QString &defaultValue)
 {
     return KJsonUtils::readTranslatedValue(jo, key, defaultValue).toString(defaultValue);
 }
+
+namespace
+{
+struct InternedStrings {
+    QMutex mutex;
+    QSet<QString> strings;
+};
+}
+Q_GLOBAL_STATIC(InternedStrings, s_internedStrings)
+
+QString KJsonUtils::internedString(const QString &string)
+{
+    if (string.isEmpty()) {
+        return string;
+    }
+    InternedStrings *interned = s_internedStrings();
+    if (!interned) {
+        return string; // during shutdown
+    }
+    QMutexLocker locker(&interned->mutex);
+    auto it = interned->strings.constFind(string);
+    if (it == interned->strings.cend()) {
+        it = interned->strings.insert(string);
+    }
+    return *it;
+}
+
+QStringList KJsonUtils::internedStrings(QStringList strings)
+{
+    for (QString &string : strings) {
+        string = internedString(string);
+    }
+    return strings;
+}
@@ -11,12 +11,17 @@
 #include "kcoreaddons_export.h"
 
 #include <QJsonValue>
+#include <QList>
+#include <QLocale>
+#include <QSharedDataPointer>
 
 class QJsonObject;
 class QString;
 
 namespace KJsonUtils
 {
+class TranslatedKeyLookupPrivate;
+
 /**
  * Reads a value from @p jo but unlike QJsonObject::value() it allows different entries for each locale
  * This is done by appending the locale identifier in brackets to the key (e.g. "[de_DE]" or "[es]")
@@ -34,6 +39,66 @@ KCOREADDONS_EXPORT QJsonValue readTranslatedValue(const QJsonObject &jo, const Q
  * @since 5.88
  */
 KCOREADDONS_EXPORT QString readTranslatedString(const QJsonObject &jo, const QString &key, const QString &defaultValue = QString());
+
+/**
+ * Looks up translated values the same way as readTranslatedValue(), for a
+ * locale fixed when it is created.
+ *
+ * The locale specific key suffixes are built only once, so a lookup can be
+ * reused for all the translated values that need to be read, e.g. of a whole
+ * list of plugins.
+ *
+ * Example:
+ * @code
+ * const KJsonUtils::TranslatedKeyLookup lookup;
+ * for (const QJsonObject &plugin : plugins) {
+ *     const QList<QJsonValue> values = lookup.values(plugin, {u"Name", u"Description"});
+ *     ...
+ * }
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT TranslatedKeyLookup
+{
+public:
+    /**
+     * Creates a lookup for the translations into @p locale
+     */
+    explicit TranslatedKeyLookup(const QLocale &locale = QLocale());
+    TranslatedKeyLookup(const TranslatedKeyLookup &other);
+    TranslatedKeyLookup &operator=(const TranslatedKeyLookup &other);
+    ~TranslatedKeyLookup();
+
+    /**
+     * @return the locale the translations are looked up for
+     */
+    QLocale locale() const;
+
+    /**
+     * @return the translated value for @p key from @p jo or @p defaultValue if @p key was not found
+     * @see readTranslatedValue()
+     */
+    QJsonValue value(const QJsonObject &jo, QStringView key, const QJsonValue &defaultValue = QJsonValue()) const;
+
+    /**
+     * @return the translated value of @p key from @p jo as a string or @p defaultValue if @p key was not found
+     * or the value for @p key is not of type string
+     * @see readTranslatedString()
+     */
+    QString string(const QJsonObject &jo, QStringView key, const QString &defaultValue = QString()) const;
+
+    /**
+     * Looks up the translated values of all of @p keys in @p jo at once.
+     *
+     * @return the translated value for each of @p keys, in the same order, with
+     * an undefined QJsonValue for the keys that were not found
+     */
+    QList<QJsonValue> values(const QJsonObject &jo, const QList<QStringView> &keys) const;
+
+private:
+    QSharedDataPointer<TranslatedKeyLookupPrivate> d;
+};
 }
 
 #endif // KJSONUTILS_H
@@ -0,0 +1,29 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KJSONUTILS_P_H
+#define KJSONUTILS_P_H
+
+#include <QStringList>
+
+namespace KJsonUtils
+{
+/**
+ * @return @p string sharing its data with all equal strings interned before.
+ *
+ * For the keys and short enum-like values read from metadata that are kept
+ * around and recur in many objects, like the MIME types or service types of
+ * plugins, so that their memory scales with the number of distinct values.
+ * The interned strings are kept for the lifetime of the process, so don't
+ * use this for free text, like translated descriptions, which hardly recurs.
+ */
+QString internedString(const QString &string);
+
+/// Interns all strings of @p strings, see internedString()
+QStringList internedStrings(QStringList strings);
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include "kmacroexpander_p.h"
 
 #include <QHash>
+#include <QVarLengthArray>
 
 KMacroExpanderBase::KMacroExpanderBase(QChar c)
     : d(new KMacroExpanderBasePrivate(c))
@@ -108,6 +109,17 @@ static bool isIdentifier(ushort c)
     return c == '_' || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
 }
 
+// Looks the macro name at @p key up without copying it out of the string.
+// QHash<QString> can't be searched with a QStringView in all supported Qt
+// versions, but with a QString referring to the data of another one.
+template<typename VT>
+static const VT *lookUpMacro(const QHash<QString, VT> &map, const QChar *key, int length)
+{
+    const QString rawKey = QString::fromRawData(key, length);
+    const auto it = map.constFind(rawKey);
+    return it != map.constEnd() ? &it.value() : nullptr;
+}
+
 ////////
 
 template<typename VT>
@@ -190,9 +202,8 @@ int KMacroMapExpander<QString, VT>::expandPlainMacro(const QString &str, int pos
     if (!sl) {
         return 0;
     }
-    typename QHash<QString, VT>::const_iterator it = macromap.constFind(str.mid(pos, sl));
-    if (it != macromap.constEnd()) {
-        ret += it.value();
+    if (const VT *value = lookUpMacro(macromap, str.unicode() + pos, sl)) {
+        ret += *value;
         return sl;
     }
     return 0;
@@ -229,9 +240,8 @@ int KMacroMapExpander<QString, VT>::expandEscapedMacro(const QString &str, int p
     if (!sl) {
         return 0;
     }
-    typename QHash<QString, VT>::const_iterator it = macromap.constFind(str.mid(rpos, sl));
-    if (it != macromap.constEnd()) {
-        ret += it.value();
+    if (const VT *value = lookUpMacro(macromap, str.unicode() + rpos, sl)) {
+        ret += *value;
         return rsl;
     }
     return 0;
@@ -319,13 +329,150 @@ int KWordMacroExpander::expandEscapedMacro(const QString &str, int pos, QStringL
 
 ////////////
 
+static qsizetype valueLength(const QString &value)
+{
+    return value.length();
+}
+
+static qsizetype valueLength(const QStringList &value)
+{
+    qsizetype length = qMax<qsizetype>(0, value.size() - 1);
+    for (const QString &str : value) {
+        length += str.length();
+    }
+    return length;
+}
+
+static void appendValue(QString &result, const QString &value)
+{
+    result += value;
+}
+
+static void appendValue(QString &result, const QStringList &value)
+{
+    for (qsizetype i = 0; i < value.size(); ++i) {
+        if (i > 0) {
+            result += QLatin1Char(' ');
+        }
+        result += value.at(i);
+    }
+}
+
+// A macro found by findMacro(), the escaped escape char if there is no value
+template<typename VT>
+struct KMacroHit {
+    int pos;
+    int length;
+    const VT *value;
+};
+
+// The same as KMacroMapExpander<QChar, VT>::expandPlainMacro() and expandEscapedMacro()
+template<typename VT>
+static int findMacro(const QHash<QChar, VT> &map, const QChar *uc, int length, int pos, ushort ec, const VT **value)
+{
+    if (ec == 0) {
+        const auto it = map.constFind(uc[pos]);
+        *value = it != map.constEnd() ? &it.value() : nullptr;
+        return *value ? 1 : 0;
+    }
+    if (uc[pos].unicode() != ec || pos + 1 >= length) {
+        return 0;
+    }
+    if (uc[pos + 1].unicode() == ec) {
+        *value = nullptr;
+        return 2;
+    }
+    const auto it = map.constFind(uc[pos + 1]);
+    *value = it != map.constEnd() ? &it.value() : nullptr;
+    return *value ? 2 : 0;
+}
+
+// The same as KMacroMapExpander<QString, VT>::expandPlainMacro() and expandEscapedMacro()
+template<typename VT>
+static int findMacro(const QHash<QString, VT> &map, const QChar *uc, int length, int pos, ushort ec, const VT **value)
+{
+    if (ec == 0) {
+        if (pos && isIdentifier(uc[pos - 1].unicode())) {
+            return 0;
+        }
+        int sl;
+        for (sl = 0; pos + sl < length && isIdentifier(uc[pos + sl].unicode()); sl++) {
+            ;
+        }
+        *value = sl ? lookUpMacro(map, uc + pos, sl) : nullptr;
+        return *value ? sl : 0;
+    }
+    if (uc[pos].unicode() != ec || pos + 1 >= length) {
+        return 0;
+    }
+    if (uc[pos + 1].unicode() == ec) {
+        *value = nullptr;
+        return 2;
+    }
+    int sl;
+    int rsl;
+    int rpos;
+    if (uc[pos + 1].unicode() == '{') {
+        rpos = pos + 2;
+        for (sl = 0; rpos + sl < length && uc[rpos + sl].unicode() != '}'; ++sl) {
+            ;
+        }
+        if (rpos + sl >= length) {
+            return 0;
+        }
+        rsl = sl + 3;
+    } else {
+        rpos = pos + 1;
+        for (sl = 0; rpos + sl < length && isIdentifier(uc[rpos + sl].unicode()); ++sl) {
+            ;
+        }
+        rsl = sl + 1;
+    }
+    *value = sl ? lookUpMacro(map, uc + rpos, sl) : nullptr;
+    return *value ? rsl : 0;
+}
+
+// Does what KMacroMapExpander::expandMacros() does, but finds all the macros
+// in the original string first, so that the result is allocated once and
+// written in one go, instead of replacing each macro in a copy of it.
 template<typename KT, typename VT>
 inline QString TexpandMacros(const QString &ostr, const QHash<KT, VT> &map, QChar c)
 {
-    QString str(ostr);
-    KMacroMapExpander<KT, VT> kmx(map, c);
-    kmx.expandMacros(str);
-    return str;
+    const ushort ec = c.unicode();
+    const QChar *const uc = ostr.unicode();
+    const int length = ostr.length();
+
+    QVarLengthArray<KMacroHit<VT>, 16> hits;
+    qsizetype resultLength = length;
+    for (int pos = 0; pos < length;) {
+        const VT *value = nullptr;
+        const int macroLength = findMacro(map, uc, length, pos, ec, &value);
+        if (!macroLength) {
+            ++pos;
+            continue;
+        }
+        hits.append({pos, macroLength, value});
+        resultLength += (value ? valueLength(*value) : 1) - macroLength;
+        pos += macroLength;
+    }
+    if (hits.isEmpty()) {
+        return ostr;
+    }
+
+    QString result;
+    result.reserve(resultLength);
+    int literalStart = 0;
+    for (const KMacroHit<VT> &hit : hits) {
+        result += QStringView(ostr).mid(literalStart, hit.pos - literalStart);
+        if (hit.value) {
+            appendValue(result, *hit.value);
+        } else {
+            result += c;
+        }
+        literalStart = hit.pos + hit.length;
+    }
+    result += QStringView(ostr).mid(literalStart);
+    return result;
 }
 
 template<typename KT, typename VT>
@@ -376,3 +523,174 @@ QString expandMacrosShellQuote(const QString &ostr, const QHash<QString, QString
 }
 
 } // namespace
+
+////////////
+
+void KMacroTemplatePrivate::parse()
+{
+    const ushort ec = escapechar.unicode();
+    const QChar *const uc = str.unicode();
+    const int length = str.length();
+
+    int literalStart = 0;
+    const auto addLiteral = [&](int end) {
+        if (end > literalStart) {
+            segments.append({literalStart, end - literalStart, false, false, QChar(), QString()});
+            literalLength += end - literalStart;
+        }
+    };
+    const auto addMacro = [&](int pos, int macroLength, QChar charKey, const QString &wordKey) {
+        addLiteral(pos);
+        const bool nested = QStringView(str).mid(pos + 1, macroLength - 1).contains(escapechar);
+        segments.append({pos, macroLength, true, nested, charKey, wordKey});
+        literalStart = pos + macroLength;
+    };
+
+    for (int pos = 0; ec != 0 && pos + 1 < length;) {
+        if (uc[pos].unicode() != ec) {
+            ++pos;
+            continue;
+        }
+        if (uc[pos + 1].unicode() == ec) {
+            // The escaped escape char, keep the second one
+            addLiteral(pos);
+            literalStart = pos + 1;
+            pos += 2;
+            continue;
+        }
+        if (type == KMacroTemplate::CharMacros) {
+            addMacro(pos, 2, uc[pos + 1], QString());
+            pos += 2;
+            continue;
+        }
+
+        // The same as KMacroMapExpander<QString, VT>::expandEscapedMacro()
+        int rpos;
+        int sl;
+        int rsl;
+        if (uc[pos + 1].unicode() == '{') {
+            rpos = pos + 2;
+            if ((sl = str.indexOf(QLatin1Char('}'), rpos)) < 0) {
+                ++pos;
+                continue;
+            }
+            sl -= rpos;
+            rsl = sl + 3;
+        } else {
+            rpos = pos + 1;
+            for (sl = 0; rpos + sl < length && isIdentifier(uc[rpos + sl].unicode()); ++sl) {
+                ;
+            }
+            rsl = sl + 1;
+        }
+        if (!sl) {
+            ++pos;
+            continue;
+        }
+        addMacro(pos, rsl, QChar(), str.mid(rpos, sl));
+        pos += rsl;
+    }
+    addLiteral(length);
+}
+
+static QChar macroKey(const KMacroTemplatePrivate::Segment &segment, QChar)
+{
+    return segment.charKey;
+}
+
+static const QString &macroKey(const KMacroTemplatePrivate::Segment &segment, const QString &)
+{
+    return segment.wordKey;
+}
+
+template<typename KT, typename VT>
+static QString expandTemplate(const KMacroTemplatePrivate &d, const QHash<KT, VT> &map, KMacroTemplate::MacroType type)
+{
+    if (d.type != type || d.escapechar.isNull()) {
+        return TexpandMacros(d.str, map, d.escapechar);
+    }
+
+    // Look the values up once for the size of the result, so that it is
+    // only allocated once
+    QVarLengthArray<const VT *, 16> values;
+    qsizetype length = d.literalLength;
+    for (const KMacroTemplatePrivate::Segment &segment : d.segments) {
+        if (!segment.isMacro) {
+            continue;
+        }
+        const auto it = map.constFind(macroKey(segment, KT()));
+        const VT *value = it != map.constEnd() ? &it.value() : nullptr;
+        values.append(value);
+        // Unknown macros are kept, or might expand to anything if they contain other macros
+        length += value ? valueLength(*value) : segment.length;
+    }
+
+    QString result;
+    result.reserve(length);
+    qsizetype macro = 0;
+    for (const KMacroTemplatePrivate::Segment &segment : d.segments) {
+        if (!segment.isMacro) {
+            result += QStringView(d.str).mid(segment.start, segment.length);
+        } else if (const VT *value = values.at(macro++)) {
+            appendValue(result, *value);
+        } else if (segment.nested) {
+            // Scanning carries on right after the escape char, the same as
+            // expanding the rest of the macro on its own
+            result += d.escapechar;
+            result += TexpandMacros(d.str.mid(segment.start + 1, segment.length - 1), map, d.escapechar);
+        } else {
+            result += QStringView(d.str).mid(segment.start, segment.length);
+        }
+    }
+    return result;
+}
+
+KMacroTemplate::KMacroTemplate(const QString &str, MacroType type, QChar c)
+    : d(new KMacroTemplatePrivate)
+{
+    d->str = str;
+    d->type = type;
+    d->escapechar = c;
+    d->parse();
+}
+
+KMacroTemplate::KMacroTemplate(const KMacroTemplate &other) = default;
+
+KMacroTemplate &KMacroTemplate::operator=(const KMacroTemplate &other) = default;
+
+KMacroTemplate::~KMacroTemplate() = default;
+
+QString KMacroTemplate::templateString() const
+{
+    return d->str;
+}
+
+KMacroTemplate::MacroType KMacroTemplate::macroType() const
+{
+    return d->type;
+}
+
+QChar KMacroTemplate::escapeChar() const
+{
+    return d->escapechar;
+}
+
+QString KMacroTemplate::expand(const QHash<QChar, QString> &map) const
+{
+    return expandTemplate(*d, map, CharMacros);
+}
+
+QString KMacroTemplate::expand(const QHash<QChar, QStringList> &map) const
+{
+    return expandTemplate(*d, map, CharMacros);
+}
+
+QString KMacroTemplate::expand(const QHash<QString, QString> &map) const
+{
+    return expandTemplate(*d, map, WordMacros);
+}
+
+QString KMacroTemplate::expand(const QHash<QString, QStringList> &map) const
+{
+    return expandTemplate(*d, map, WordMacros);
+}
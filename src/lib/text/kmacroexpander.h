@@ -10,6 +10,7 @@
 #define KMACROEXPANDER_H
 
 #include <QChar>
+#include <QSharedDataPointer>
 #include <QStringList>
 
 #include <kcoreaddons_export.h>
@@ -19,6 +20,7 @@ class QString;
 template<typename KT, typename VT>
 class QHash;
 class KMacroExpanderBasePrivate;
+class KMacroTemplatePrivate;
 
 /**
  * \class KMacroExpanderBase kmacroexpander.h <KMacroExpander>
@@ -271,6 +273,99 @@ protected:
     virtual bool expandMacro(QChar chr, QStringList &ret) = 0;
 };
 
+/**
+ * \class KMacroTemplate kmacroexpander.h <KMacroExpander>
+ *
+ * A string with macros which is parsed once, for expanding it many times.
+ *
+ * KMacroExpander::expandMacros() looks for the macros in the string on every
+ * call. A KMacroTemplate does this once, and then only puts the text between
+ * the macros and their values together, e.g. when expanding the same command
+ * line for many files:
+ *
+ * \code
+ * const KMacroTemplate command(QStringLiteral("kwrite %f"), KMacroTemplate::CharMacros);
+ * for (const QString &file : files) {
+ *     const QString line = command.expand(QHash<QChar, QString>{{QLatin1Char('f'), file}});
+ *     // ...
+ * }
+ * \endcode
+ *
+ * The results are the same as those of KMacroExpander::expandMacros() with
+ * the same map. There is no shell quoting, as what needs quoting depends on
+ * which macros are expanded.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KMacroTemplate
+{
+public:
+    /**
+     * The kind of macros in the template
+     */
+    enum MacroType {
+        /** Single character macros, for maps with QChar keys */
+        CharMacros,
+        /** Word macros, for maps with QString keys */
+        WordMacros,
+    };
+
+    /**
+     * Parses @p str for macros of @p type.
+     * @param str the string with the macros
+     * @param type the kind of macros in @p str
+     * @param c escape char indicating start of macros, or QChar::null for none
+     */
+    KMacroTemplate(const QString &str, MacroType type, QChar c = QLatin1Char('%'));
+    KMacroTemplate(const KMacroTemplate &other);
+    KMacroTemplate &operator=(const KMacroTemplate &other);
+    ~KMacroTemplate();
+
+    /**
+     * @return the string this template was created from
+     */
+    QString templateString() const;
+
+    /**
+     * @return the kind of macros in the template
+     */
+    MacroType macroType() const;
+
+    /**
+     * @return the escape char indicating start of macros
+     */
+    QChar escapeChar() const;
+
+    /**
+     * Expands the macros of the template with the values in @p map.
+     *
+     * For templates of WordMacros, this falls back to
+     * KMacroExpander::expandMacros() on the template string.
+     */
+    QString expand(const QHash<QChar, QString> &map) const;
+
+    /**
+     * @copydoc expand(const QHash<QChar, QString> &) const
+     */
+    QString expand(const QHash<QChar, QStringList> &map) const;
+
+    /**
+     * Expands the macros of the template with the values in @p map.
+     *
+     * For templates of CharMacros, this falls back to
+     * KMacroExpander::expandMacros() on the template string.
+     */
+    QString expand(const QHash<QString, QString> &map) const;
+
+    /**
+     * @copydoc expand(const QHash<QString, QString> &) const
+     */
+    QString expand(const QHash<QString, QStringList> &map) const;
+
+private:
+    QSharedDataPointer<KMacroTemplatePrivate> d;
+};
+
 /**
  * A group of functions providing macro expansion (substitution) in strings,
  * optionally with quoting appropriate for shell execution.
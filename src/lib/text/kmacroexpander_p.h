@@ -21,4 +21,30 @@ public:
     QChar escapechar;
 };
 
+class KMacroTemplatePrivate : public QSharedData
+{
+public:
+    // The text between the macros, or a macro
+    struct Segment {
+        // Where the text or the whole macro is in the template
+        int start;
+        int length;
+        bool isMacro;
+        // The macro contains the escape char again, which can start
+        // another macro if it isn't expanded itself
+        bool nested;
+        QChar charKey;
+        QString wordKey;
+    };
+
+    void parse();
+
+    QString str;
+    KMacroTemplate::MacroType type;
+    QChar escapechar;
+    QList<Segment> segments;
+    // The length of all the text between the macros
+    int literalLength = 0;
+};
+
 #endif
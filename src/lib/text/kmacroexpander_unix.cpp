@@ -8,8 +8,8 @@
 */
 
 #include "kmacroexpander_p.h"
+#include "kshell.h"
 
-#include <QRegularExpression>
 #include <QStack>
 #include <QStringList>
 
@@ -38,38 +38,16 @@ typedef struct {
 
 using namespace KMacroExpander;
 
-// #pragma message("TODO: Import these methods into Qt")
-
-inline static bool isSpecial(QChar cUnicode)
-{
-    static const uchar iqm[] = {0xff, 0xff, 0xff, 0xff, 0xdf, 0x07, 0x00, 0xd8, 0x00, 0x00, 0x00, 0x38, 0x01, 0x00, 0x00, 0x78}; // 0-32 \'"$`<>|;&(){}*?#!~[]
-
-    uint c = cUnicode.unicode();
-    return (c < sizeof(iqm) * 8) && (iqm[c / 8] & (1 << (c & 7)));
-}
-
-static QString quoteArg(const QString &arg)
-{
-    if (!arg.length()) {
-        return QStringLiteral("''");
-    }
-    for (int i = 0; i < arg.length(); i++) {
-        if (isSpecial(arg.unicode()[i])) {
-            QChar q(QLatin1Char('\''));
-            return q + QString(arg).replace(q, QLatin1String("'\\''")) + q;
-        }
-    }
-    return arg;
-}
-
-static QString joinArgs(const QStringList &args)
+// Puts a backslash in front of each of @p chars in @p str
+static QString escapeChars(const QString &str, QLatin1String chars)
 {
     QString ret;
-    for (QStringList::ConstIterator it = args.begin(); it != args.end(); ++it) {
-        if (!ret.isEmpty()) {
-            ret.append(QLatin1Char(' '));
+    ret.reserve(str.length() + 8);
+    for (const QChar c : str) {
+        if (chars.contains(c)) {
+            ret.append(QLatin1Char('\\'));
         }
-        ret.append(quoteArg(*it));
+        ret.append(c);
     }
     return ret;
 }
@@ -104,11 +82,9 @@ bool KMacroExpanderBase::expandMacrosShellQuote(QString &str, int &pos)
             continue;
         }
         if (state.dquote) {
-            rsts = rst.join(QLatin1Char(' '));
-            rsts.replace(QRegularExpression(QStringLiteral("([$`\"\\\\])")), QStringLiteral("\\\\1"));
+            rsts = escapeChars(rst.join(QLatin1Char(' ')), QLatin1String("$`\"\\"));
         } else if (state.current == dollarquote) {
-            rsts = rst.join(QLatin1Char(' '));
-            rsts.replace(QRegularExpression(QStringLiteral("(['\\\\])")), QStringLiteral("\\\\1"));
+            rsts = escapeChars(rst.join(QLatin1Char(' ')), QLatin1String("'\\"));
         } else if (state.current == singlequote) {
             rsts = rst.join(QLatin1Char(' '));
             rsts.replace(QLatin1Char('\''), QLatin1String("'\\''"));
@@ -117,7 +93,7 @@ bool KMacroExpanderBase::expandMacrosShellQuote(QString &str, int &pos)
                 str.remove(pos, len);
                 continue;
             } else {
-                rsts = joinArgs(rst);
+                rsts = KShell::joinArgs(rst);
             }
         }
         rst.clear();
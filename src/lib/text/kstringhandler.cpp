@@ -15,6 +15,10 @@
 #include <QList>
 #include <QRegularExpression>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 //
 // Capitalization routines
 //
@@ -73,31 +77,109 @@ QString KStringHandler::rsqueeze(const QString &str, const int maxlen)
     }
 }
 
-QStringList KStringHandler::perlSplit(const QStringView sep, const QStringView str, int max)
+// The number of characters of @p str kept by lsqueeze() and rsqueeze(), which keep all for a negative part
+static qsizetype squeezedPart(qsizetype length, int maxlen)
 {
-    const bool ignoreMax = max == 0;
+    const int part = maxlen - 3;
+    return part < 0 || part >= length ? length : part;
+}
 
-    const int sepLength = sep.size();
+void KStringHandler::lsqueeze(QStringList &list, const int maxlen)
+{
+    for (QString &str : list) {
+        if (str.length() > maxlen) {
+            const qsizetype part = squeezedPart(str.length(), maxlen);
+            str.replace(0, str.length() - part, QLatin1String("..."));
+        }
+    }
+}
 
-    QStringList list;
-    int searchStart = 0;
-    int sepIndex = str.indexOf(sep, searchStart);
+void KStringHandler::csqueeze(QStringList &list, const int maxlen)
+{
+    if (maxlen <= 3) {
+        return;
+    }
+    const int part = (maxlen - 3) / 2;
+    for (QString &str : list) {
+        if (str.length() > maxlen) {
+            str.replace(part, str.length() - 2 * part, QLatin1String("..."));
+        }
+    }
+}
 
-    while (sepIndex != -1 && (ignoreMax || list.count() < max - 1)) {
-        const auto chunk = str.mid(searchStart, sepIndex - searchStart);
-        if (!chunk.isEmpty()) {
-            list.append(chunk.toString());
+void KStringHandler::rsqueeze(QStringList &list, const int maxlen)
+{
+    for (QString &str : list) {
+        if (str.length() > maxlen) {
+            str.truncate(squeezedPart(str.length(), maxlen));
+            str.append(QLatin1String("..."));
         }
+    }
+}
 
-        searchStart = sepIndex + sepLength;
-        sepIndex = str.indexOf(sep, searchStart);
+KStringHandler::PerlSplitIterator::PerlSplitIterator(QStringView sep, QStringView str, int max)
+    : m_sep(sep)
+    , m_str(str)
+    , m_max(max)
+{
+    advance();
+}
+
+QStringView KStringHandler::PerlSplitIterator::next()
+{
+    const QStringView token = m_next;
+    ++m_count;
+    advance();
+    return token;
+}
+
+void KStringHandler::PerlSplitIterator::advance()
+{
+    m_hasNext = false;
+    while (!m_atEnd) {
+        // an empty separator would match at the same position forever
+        const qsizetype sepIndex = (m_max == 0 || m_count < m_max - 1) && !m_sep.isEmpty() ? m_str.indexOf(m_sep, m_position) : -1;
+
+        QStringView chunk;
+        if (sepIndex != -1) {
+            chunk = m_str.mid(m_position, sepIndex - m_position);
+            m_position = sepIndex + m_sep.size();
+        } else {
+            // catch the remainder
+            chunk = m_str.mid(m_position);
+            m_atEnd = true;
+        }
+
+        if (!chunk.isEmpty()) {
+            m_next = chunk;
+            m_hasNext = true;
+            return;
+        }
     }
+}
 
-    const auto lastChunk = str.mid(searchStart, str.length() - searchStart);
-    if (!lastChunk.isEmpty()) {
-        list.append(lastChunk.toString());
+QList<QStringView> KStringHandler::perlSplitView(QStringView sep, QStringView str, int max)
+{
+    QList<QStringView> list;
+    PerlSplitIterator it(sep, str, max);
+    while (it.hasNext()) {
+        list.append(it.next());
     }
+    return list;
+}
 
+QList<QStringView> KStringHandler::perlSplitView(QChar sep, QStringView str, int max)
+{
+    return perlSplitView(QStringView(&sep, 1), str, max);
+}
+
+QStringList KStringHandler::perlSplit(const QStringView sep, const QStringView str, int max)
+{
+    QStringList list;
+    PerlSplitIterator it(sep, str, max);
+    while (it.hasNext()) {
+        list.append(it.next().toString());
+    }
     return list;
 }
 
@@ -111,53 +193,144 @@ QStringList KStringHandler::perlSplit(const QChar &sep, const QString &str, int
     return perlSplit(QStringView(&sep, 1), QStringView(str), max);
 }
 
-QStringList KStringHandler::perlSplit(const QRegularExpression &sep, const QString &str, int max)
+// Returns @p sep with only UseUnicodePropertiesOption set. Setting the option on
+// a copy forces it to be compiled again, so the last one is kept per thread.
+static QRegularExpression unicodeSeparator(const QRegularExpression &sep)
+{
+    if (sep.patternOptions() == QRegularExpression::UseUnicodePropertiesOption) {
+        return sep;
+    }
+
+    thread_local QRegularExpression cached;
+    if (cached.pattern() != sep.pattern() || cached.patternOptions() != QRegularExpression::UseUnicodePropertiesOption) {
+        cached = QRegularExpression(sep.pattern(), QRegularExpression::UseUnicodePropertiesOption);
+    }
+    return cached;
+}
+
+QList<QStringView> KStringHandler::perlSplitView(const QRegularExpression &sep, QStringView str, int max)
 {
     // nothing to split
     if (str.isEmpty()) {
-        return QStringList();
+        return QList<QStringView>();
     }
 
     const bool ignoreMax = max == 0;
 
-    QStringList list;
-
-    int start = 0;
+    QList<QStringView> list;
 
-    const QStringView strView(str);
+    qsizetype start = 0;
 
-    QRegularExpression separator(sep);
-    separator.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption);
+    const QRegularExpression separator = unicodeSeparator(sep);
 
-    QRegularExpressionMatchIterator iter = separator.globalMatch(strView);
-    QRegularExpressionMatch match;
+    QRegularExpressionMatchIterator iter = separator.globalMatchView(str);
     while (iter.hasNext() && (ignoreMax || list.count() < max - 1)) {
-        match = iter.next();
-        const QStringView chunk = strView.mid(start, match.capturedStart() - start);
+        const QRegularExpressionMatch match = iter.next();
+        const QStringView chunk = str.mid(start, match.capturedStart() - start);
         if (!chunk.isEmpty()) {
-            list.append(chunk.toString());
+            list.append(chunk);
         }
 
         start = match.capturedEnd();
     }
 
     // catch the remainder
-    const QStringView lastChunk = strView.mid(start, strView.size() - start);
+    const QStringView lastChunk = str.mid(start);
     if (!lastChunk.isEmpty()) {
-        list.append(lastChunk.toString());
+        list.append(lastChunk);
     }
 
     return list;
 }
 
-QString KStringHandler::tagUrls(const QString &text)
+QStringList KStringHandler::perlSplit(const QRegularExpression &sep, const QString &str, int max)
 {
-    QString richText(text);
+    const QList<QStringView> views = perlSplitView(sep, QStringView(str), max);
+
+    QStringList list;
+    list.reserve(views.size());
+    for (const QStringView view : views) {
+        list.append(view.toString());
+    }
+    return list;
+}
 
+// The first 'w' or ':' in [it, end), where URLs start or have their "://"
+static const char16_t *findUrlCandidate(const char16_t *it, const char16_t *end)
+{
+#ifdef __SSE2__
+    const __m128i w = _mm_set1_epi16(short(u'w'));
+    const __m128i colon = _mm_set1_epi16(short(u':'));
+    for (; end - it >= 8; it += 8) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(chunk, w), _mm_cmpeq_epi16(chunk, colon)));
+        if (mask != 0) {
+            // Two mask bits for every UTF-16 code unit
+            return it + qCountTrailingZeroBits(uint(mask)) / 2;
+        }
+    }
+#endif
+    for (; it != end; ++it) {
+        if (*it == u'w' || *it == u':') {
+            return it;
+        }
+    }
+    return end;
+}
+
+QString KStringHandler::tagUrls(const QString &text)
+{
     static const QRegularExpression urlEx(QStringLiteral(R"((www\.(?!\.)|(fish|ftp|http|https)://[\d\w./,:_~?=&;#@\-+%$()]+))"),
                                           QRegularExpression::UseUnicodePropertiesOption);
-    // The reference \1 is going to be replaced by the matched url
-    richText.replace(urlEx, QStringLiteral("<a href=\"\\1\">\\1</a>"));
+
+    // The expression is only tried where a URL can start, at "www." and up
+    // to five characters before "://", which are found with a fast scan
+    QString richText;
+    qsizetype copied = 0; // the end of the last URL
+    const auto tagUrlAt = [&](qsizetype start) {
+        const QRegularExpressionMatch match = urlEx.match(text, start, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption);
+        if (!match.hasMatch()) {
+            return false;
+        }
+        if (richText.isNull()) {
+            richText.reserve(text.size() + 2 * (text.size() - start) + 15);
+        }
+        const QStringView url = match.capturedView(1);
+        richText += QStringView(text).mid(copied, start - copied);
+        richText += QLatin1String("<a href=\"");
+        richText += url;
+        richText += QLatin1String("\">");
+        richText += url;
+        richText += QLatin1String("</a>");
+        copied = match.capturedEnd(0);
+        return true;
+    };
+
+    const char16_t *const begin = text.utf16();
+    const char16_t *const end = begin + text.size();
+    for (const char16_t *it = findUrlCandidate(begin, end); it != end; it = findUrlCandidate(it, end)) {
+        const qsizetype index = it - begin;
+        const QStringView rest = QStringView(text).mid(index);
+        ++it;
+        if (rest.startsWith(u"www.")) {
+            if (tagUrlAt(index)) {
+                it = begin + copied;
+            }
+        } else if (rest.startsWith(u"://")) {
+            // The schemes have three to five characters
+            for (qsizetype start = qMax(copied, index - 5); start <= index - 3; ++start) {
+                if (tagUrlAt(start)) {
+                    it = begin + copied;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (richText.isNull()) {
+        return text;
+    }
+    richText += QStringView(text).mid(copied);
     return richText;
 }
 
@@ -216,22 +389,54 @@ QString KStringHandler::preProcessWrap(const QString &text)
     return result;
 }
 
+// The first characters of the wide scripts, Hangul Jamo, come after this
+static constexpr char16_t s_lastNarrowCharacter = 0x10ff;
+
 int KStringHandler::logicalLength(const QString &text)
 {
     int length = 0;
-    const auto chrs = text.toUcs4();
-    for (const auto chr : chrs) {
-        const auto script = QChar::script(chr);
-        /* clang-format off */
-        if (script == QChar::Script_Han
-            || script == QChar::Script_Hangul
-            || script == QChar::Script_Hiragana
-            || script == QChar::Script_Katakana
-            || script == QChar::Script_Yi
-            || QChar::isHighSurrogate(chr)) { /* clang-format on */
-            length += 2;
-        } else {
-            length += 1;
+    const char16_t *const chars = text.utf16();
+    const qsizetype size = text.size();
+    qsizetype i = 0;
+    while (i < size) {
+#ifdef __SSE2__
+        // Skip the narrow characters, most of them, eight at a time
+        const __m128i lastNarrow = _mm_set1_epi16(short(s_lastNarrowCharacter));
+        while (size - i >= 8) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(chars + i));
+            // Zero for every character up to the last narrow one
+            const __m128i wide = _mm_subs_epu16(chunk, lastNarrow);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(wide, _mm_setzero_si128())) != 0xffff) {
+                break;
+            }
+            length += 8;
+            i += 8;
+        }
+        // The chunk with the wide character is done one by one, at least
+        const qsizetype chunkEnd = qMin(size, i + 8);
+#else
+        const qsizetype chunkEnd = size;
+#endif
+        while (i < chunkEnd) {
+            char32_t chr = chars[i++];
+            if (chr <= s_lastNarrowCharacter) {
+                length += 1;
+                continue;
+            }
+            if (QChar::isHighSurrogate(chr) && i < size && QChar::isLowSurrogate(chars[i])) {
+                chr = QChar::surrogateToUcs4(char16_t(chr), chars[i++]);
+            }
+            const auto script = QChar::script(chr);
+            /* clang-format off */
+            if (script == QChar::Script_Han
+                || script == QChar::Script_Hangul
+                || script == QChar::Script_Hiragana
+                || script == QChar::Script_Katakana
+                || script == QChar::Script_Yi) { /* clang-format on */
+                length += 2;
+            } else {
+                length += 1;
+            }
         }
     }
     return length;
@@ -86,6 +86,39 @@ KCOREADDONS_EXPORT QString csqueeze(const QString &str, int maxlen = 40);
  */
 KCOREADDONS_EXPORT QString rsqueeze(const QString &str, int maxlen = 40);
 
+/**
+ * Substitutes characters at the start of every string in @p list by "...",
+ * like lsqueeze(const QString &, int).
+ *
+ * The strings are modified in place, reusing their memory unless shared.
+ * @param list the strings to modify
+ * @param maxlen is the maximum length the modified strings will have
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT void lsqueeze(QStringList &list, int maxlen = 40);
+
+/**
+ * Substitutes characters at the middle of every string in @p list by "...",
+ * like csqueeze(const QString &, int).
+ *
+ * The strings are modified in place, reusing their memory unless shared.
+ * @param list the strings to modify
+ * @param maxlen is the maximum length the modified strings will have
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT void csqueeze(QStringList &list, int maxlen = 40);
+
+/**
+ * Substitutes characters at the end of every string in @p list by "...",
+ * like rsqueeze(const QString &, int).
+ *
+ * The strings are modified in place, reusing their memory unless shared.
+ * @param list the strings to modify
+ * @param maxlen is the maximum length the modified strings will have
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT void rsqueeze(QStringList &list, int maxlen = 40);
+
 /**
  * Split a string into a QStringList in a similar fashion to the static
  * QStringList function in Qt, except you can specify a maximum number
@@ -166,6 +199,111 @@ KCOREADDONS_EXPORT QStringList perlSplit(const QChar &sep, const QString &s, int
  */
 KCOREADDONS_EXPORT QStringList perlSplit(const QRegularExpression &sep, const QString &s, int max = 0);
 
+/**
+ * Same as perlSplit(const QStringView, const QStringView, int), except that
+ * the tokens are returned as views into @p str instead of copies.
+ *
+ * The returned views are only valid as long as the data @p str refers to is.
+ *
+ * @param sep is the string to use to delimit @p str
+ * @param str the string to split
+ * @param max the maximum number of extractions to perform, or 0
+ * @return A list of views on the tokens extracted from @p str
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QList<QStringView> perlSplitView(QStringView sep, QStringView str, int max = 0);
+
+/**
+ * Same as perlSplit(const QChar &, const QString &, int), except that
+ * the tokens are returned as views into @p str instead of copies.
+ *
+ * The returned views are only valid as long as the data @p str refers to is.
+ *
+ * @param sep is the character to use to delimit @p str
+ * @param str the string to split
+ * @param max the maximum number of extractions to perform, or 0
+ * @return A list of views on the tokens extracted from @p str
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QList<QStringView> perlSplitView(QChar sep, QStringView str, int max = 0);
+
+/**
+ * Same as perlSplit(const QRegularExpression &, const QString &, int), except
+ * that the tokens are returned as views into @p str instead of copies.
+ *
+ * The returned views are only valid as long as the data @p str refers to is.
+ *
+ * Like perlSplit(), this matches @p sep with only
+ * QRegularExpression::UseUnicodePropertiesOption set. Passing a regular
+ * expression that has exactly this option set avoids having to compile
+ * another one.
+ *
+ * @param sep is the regular expression to use to delimit @p str
+ * @param str the string to split
+ * @param max the maximum number of extractions to perform, or 0
+ * @return A list of views on the tokens extracted from @p str
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QList<QStringView> perlSplitView(const QRegularExpression &sep, QStringView str, int max = 0);
+
+/**
+ * Extracts the tokens of a string one at a time, the same way as
+ * perlSplit(const QStringView, const QStringView, int) does, but without
+ * building up a list.
+ *
+ * Example:
+ * @code
+ * KStringHandler::PerlSplitIterator it(u"=", u"key=some=value", 2);
+ * while (it.hasNext()) {
+ *     const QStringView token = it.next(); // "key", then "some=value"
+ * }
+ * @endcode
+ *
+ * The iterator keeps views on @p sep and @p str, so both need to outlive it.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT PerlSplitIterator
+{
+public:
+    /**
+     * Creates an iterator over the tokens of @p str delimited by @p sep.
+     *
+     * @param sep is the string to use to delimit @p str
+     * @param str the string to split
+     * @param max the maximum number of extractions to perform, or 0
+     */
+    PerlSplitIterator(QStringView sep, QStringView str, int max = 0);
+
+    /**
+     * @return @c true if there is another token, i.e. next() may be called
+     */
+    bool hasNext() const
+    {
+        return m_hasNext;
+    }
+
+    /**
+     * @return the next token, and advances to the one after it
+     */
+    QStringView next();
+
+private:
+    void advance();
+
+    QStringView m_sep;
+    QStringView m_str;
+    QStringView m_next;
+    qsizetype m_position = 0;
+    int m_max;
+    int m_count = 0;
+    bool m_hasNext = false;
+    bool m_atEnd = false;
+};
+
 /**
  * This method auto-detects URLs in strings, and adds HTML markup to them
  * so that richtext or HTML-enabled widgets will display the URL correctly.
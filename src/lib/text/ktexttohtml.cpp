@@ -7,13 +7,21 @@
 
 #include "ktexttohtml.h"
 #include "kemoticonsparser_p.h"
+#include "kparallel_p.h"
 #include "ktexttohtml_p.h"
+#include "ktracing_p.h"
 
 #include <QCoreApplication>
 #include <QFile>
+#include <QIODevice>
 #include <QRegularExpression>
 #include <QStringList>
 
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <string_view>
+
 #include <limits.h>
 
 KTextToHTMLHelper::KTextToHTMLHelper(const QString &plainText, int pos, int maxUrlLen, int maxAddressLen)
@@ -24,70 +32,179 @@ KTextToHTMLHelper::KTextToHTMLHelper(const QString &plainText, int pos, int maxU
 {
 }
 
+// The classes of the ASCII characters, for scanning email addresses without
+// looking every character up in a string
+enum AsciiClass : quint8 {
+    LetterOrNumber = 1,
+    // allowed in a dot-atom (RFC 2822): a-z A-Z 0-9 . ! # $ % & ' * + - / = ? ^ _ ` { | } ~
+    DotAtom = 2,
+    // allowed in a domain: a-z A-Z 0-9 . -
+    Domain = 4,
+};
+
+static constexpr std::array<quint8, 128> s_asciiClasses = []() {
+    std::array<quint8, 128> classes{};
+    for (int c = 0; c < 128; ++c) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            classes[c] = LetterOrNumber | DotAtom | Domain;
+        }
+    }
+    for (const char c : std::string_view(".!#$%&'*+-/=?^_`{|}~")) {
+        classes[uchar(c)] |= DotAtom;
+    }
+    classes['.'] |= Domain;
+    classes['-'] |= Domain;
+    return classes;
+}();
+
+static bool hasAsciiClass(QChar ch, AsciiClass asciiClass)
+{
+    return ch.unicode() < 128 && (s_asciiClasses[ch.unicode()] & asciiClass);
+}
+
 QString KTextToHTMLHelper::getEmailAddress()
 {
-    QString address;
-
-    if (mPos < mText.length() && mText.at(mPos) == QLatin1Char('@')) {
-        // the following characters are allowed in a dot-atom (RFC 2822):
-        // a-z A-Z 0-9 . ! # $ % & ' * + - / = ? ^ _ ` { | } ~
-        const QString allowedSpecialChars = QStringLiteral(".!#$%&'*+-/=?^_`{|}~");
-
-        // determine the local part of the email address
-        int start = mPos - 1;
-        while (start >= 0 && mText.at(start).unicode() < 128
-               && (mText.at(start).isLetterOrNumber() //
-                   || mText.at(start) == QLatin1Char('@') // allow @ to find invalid email addresses
-                   || allowedSpecialChars.indexOf(mText.at(start)) != -1)) {
-            if (mText.at(start) == QLatin1Char('@')) {
-                return QString(); // local part contains '@' -> no email address
-            }
-            --start;
+    if (mPos >= mText.length() || mText.at(mPos) != QLatin1Char('@')) {
+        return QString();
+    }
+
+    // Both scans give up as soon as the address is bound to be longer than
+    // mMaxAddressLen, so that every '@' costs O(mMaxAddressLen) at most, no
+    // matter how long the runs of address characters around it are.
+    const QChar *text = mText.constData();
+
+    // determine the local part of the email address
+    int start = mPos - 1;
+    while (start >= 0 && (hasAsciiClass(text[start], DotAtom) || text[start] == QLatin1Char('@'))) { // allow @ to find invalid email addresses
+        if (text[start] == QLatin1Char('@')) {
+            return QString(); // local part contains '@' -> no email address
         }
+        if (mPos - start > mMaxAddressLen && hasAsciiClass(text[start], LetterOrNumber)) {
+            return QString(); // the address would start here or earlier -> too long
+        }
+        --start;
+    }
+    ++start;
+    // we assume that an email address starts with a letter or a digit
+    while ((start < mPos) && !hasAsciiClass(text[start], LetterOrNumber)) {
         ++start;
-        // we assume that an email address starts with a letter or a digit
-        while ((start < mPos) && !mText.at(start).isLetterOrNumber()) {
-            ++start;
-        }
-        if (start == mPos) {
-            return QString(); // local part is empty -> no email address
-        }
-
-        // determine the domain part of the email address
-        int dotPos = INT_MAX;
-        int end = mPos + 1;
-        while (end < mText.length()
-               && (mText.at(end).isLetterOrNumber() //
-                   || mText.at(end) == QLatin1Char('@') // allow @ to find invalid email addresses
-                   || mText.at(end) == QLatin1Char('.') //
-                   || mText.at(end) == QLatin1Char('-'))) {
-            if (mText.at(end) == QLatin1Char('@')) {
-                return QString(); // domain part contains '@' -> no email address
-            }
-            if (mText.at(end) == QLatin1Char('.')) {
-                dotPos = qMin(dotPos, end); // remember index of first dot in domain
-            }
-            ++end;
+    }
+    if (start == mPos) {
+        return QString(); // local part is empty -> no email address
+    }
+
+    // determine the domain part of the email address
+    int dotPos = INT_MAX;
+    int end = mPos + 1;
+    const int length = mText.length();
+    while (end < length) {
+        const QChar ch = text[end];
+        const bool letterOrNumber = ch.unicode() < 128 ? hasAsciiClass(ch, LetterOrNumber) : ch.isLetterOrNumber();
+        if (!letterOrNumber && !hasAsciiClass(ch, Domain) && ch != QLatin1Char('@')) { // allow @ to find invalid email addresses
+            break;
         }
-        // we assume that an email address ends with a letter or a digit
-        while ((end > mPos) && !mText.at(end - 1).isLetterOrNumber()) {
-            --end;
+        if (ch == QLatin1Char('@')) {
+            return QString(); // domain part contains '@' -> no email address
         }
-        if (end == mPos) {
-            return QString(); // domain part is empty -> no email address
+        if (letterOrNumber && end - start >= mMaxAddressLen) {
+            return QString(); // the address would end here or later -> too long
         }
-        if (dotPos >= end) {
-            return QString(); // domain part doesn't contain a dot
+        if (ch == QLatin1Char('.')) {
+            dotPos = qMin(dotPos, end); // remember index of first dot in domain
         }
+        ++end;
+    }
+    // we assume that an email address ends with a letter or a digit
+    while ((end > mPos) && !text[end - 1].isLetterOrNumber()) {
+        --end;
+    }
+    if (end == mPos) {
+        return QString(); // domain part is empty -> no email address
+    }
+    if (dotPos >= end) {
+        return QString(); // domain part doesn't contain a dot
+    }
+
+    if (end - start > mMaxAddressLen) {
+        return QString(); // too long -> most likely no email address
+    }
+
+    mPos = end - 1;
+    return mText.mid(start, end - start);
+}
+
+// Whether a group of a phone number, an optionally parenthesized number, starts at @p pos of @p text
+static bool atPhoneNumberGroup(QStringView text, int pos)
+{
+    if (pos < text.size() && text[pos] == QLatin1Char('(')) {
+        ++pos;
+    }
+    return pos < text.size() && text[pos].isDigit();
+}
 
-        if (end - start > mMaxAddressLen) {
-            return QString(); // too long -> most likely no email address
+/**
+ * The length of the phone number at @p pos of @p text, or -1 if there's none with
+ * at most @p maxDigits digits, counting the leading '0'.
+ *
+ * This matches what the regular expression [+0](( |( ?[/-] ?)?)\(?\d+\)?+){6,30}
+ * would: a '+' or '0' followed by 6 to 30 groups of digits, every group optionally
+ * separated by a space or by a '/' or '-' with optional spaces around it, and
+ * optionally enclosed in parentheses. With fewer than 6 groups, the regular
+ * expression splits them up, so 6 digits suffice. Unlike with backtracking, every
+ * character is looked at once, and not more than maxDigits digits are scanned.
+ */
+static int phoneNumberLength(QStringView text, int pos, int maxDigits)
+{
+    if (pos >= text.size() || (text[pos] != QLatin1Char('+') && text[pos] != QLatin1Char('0'))) {
+        return -1;
+    }
+
+    int end = pos + 1;
+    int groups = 0;
+    // the leading '0' counts as well
+    const int leadingDigits = text[pos] == QLatin1Char('0') ? 1 : 0;
+    int digits = leadingDigits;
+    while (groups < 30) {
+        // the separator
+        int groupStart = end;
+        if (groupStart < text.size() && text[groupStart] == QLatin1Char(' ') && atPhoneNumberGroup(text, groupStart + 1)) {
+            ++groupStart;
+        } else if (!atPhoneNumberGroup(text, groupStart)) {
+            int separatorEnd = groupStart;
+            if (separatorEnd < text.size() && text[separatorEnd] == QLatin1Char(' ')) {
+                ++separatorEnd;
+            }
+            if (separatorEnd >= text.size() || (text[separatorEnd] != QLatin1Char('/') && text[separatorEnd] != QLatin1Char('-'))) {
+                break;
+            }
+            ++separatorEnd;
+            if (separatorEnd < text.size() && text[separatorEnd] == QLatin1Char(' ') && atPhoneNumberGroup(text, separatorEnd + 1)) {
+                ++separatorEnd;
+            }
+            if (!atPhoneNumberGroup(text, separatorEnd)) {
+                break;
+            }
+            groupStart = separatorEnd;
         }
-        address = mText.mid(start, end - start);
 
-        mPos = end - 1;
+        // the number
+        end = groupStart;
+        if (text[end] == QLatin1Char('(')) {
+            ++end;
+        }
+        while (end < text.size() && text[end].isDigit()) {
+            if (++digits > maxDigits) {
+                return -1;
+            }
+            ++end;
+        }
+        if (end < text.size() && text[end] == QLatin1Char(')')) {
+            ++end;
+        }
+        ++groups;
     }
-    return address;
+
+    return digits - leadingDigits >= 6 ? end - pos : -1;
 }
 
 QString KTextToHTMLHelper::getPhoneNumber()
@@ -96,24 +213,15 @@ QString KTextToHTMLHelper::getPhoneNumber()
         return {};
     }
 
-    const QString allowedBeginSeparators = QStringLiteral(" \r\t\n:");
-    if (mPos > 0 && !allowedBeginSeparators.contains(mText.at(mPos - 1))) {
+    if (mPos > 0 && !QStringView(u" \r\t\n:").contains(mText.at(mPos - 1))) {
         return {};
     }
 
-    // this isn't 100% accurate, we filter stuff below that is too hard to capture with a regexp
-    static const QRegularExpression telPattern(QStringLiteral(R"([+0](( |( ?[/-] ?)?)\(?\d+\)?+){6,30})"));
-    const auto match = telPattern.match(mText, mPos, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption);
-    if (match.hasMatch()) {
-        QStringView matchedText = match.capturedView();
-        // check for maximum number of digits (15), see https://en.wikipedia.org/wiki/Telephone_numbering_plan
-        const int digitsCount = std::count_if(matchedText.cbegin(), matchedText.cend(), [](const QChar c) {
-            return c.isDigit();
-        });
-
-        if (digitsCount > 15) {
-            return {};
-        }
+    // this isn't 100% accurate, we filter stuff below that is too hard to capture while scanning
+    // check for maximum number of digits (15), see https://en.wikipedia.org/wiki/Telephone_numbering_plan
+    const int length = phoneNumberLength(mText, mPos, 15);
+    if (length > 0) {
+        QStringView matchedText = QStringView(mText).mid(mPos, length);
 
         // only one / is allowed, otherwise we trigger on dates
         if (matchedText.count(QLatin1Char('/')) > 1) {
@@ -165,45 +273,66 @@ static QString normalizePhoneNumber(const QString &str)
     return res;
 }
 
-// The following characters are allowed in a dot-atom (RFC 2822):
-// a-z A-Z 0-9 . ! # $ % & ' * + - / = ? ^ _ ` { | } ~
-static const char s_allowedSpecialChars[] = ".!#$%&'*+-/=?^_`{|}~";
-
 bool KTextToHTMLHelper::atUrl() const
 {
     // The character directly before the URL must not be a letter, a number or
     // any other character allowed in a dot-atom (RFC 2822).
     if (mPos > 0) {
         const auto chBefore = mText.at(mPos - 1);
-        if (chBefore.isLetterOrNumber() || QLatin1String(s_allowedSpecialChars).contains(chBefore)) {
+        if (chBefore.isLetterOrNumber() || hasAsciiClass(chBefore, DotAtom)) {
             return false;
         }
     }
 
     const auto segment = QStringView(mText).mid(mPos);
+    if (segment.isEmpty()) {
+        return false;
+    }
+
+    // This is called for every character, so only compare with the schemes
+    // starting with the same character
     /* clang-format off */
-    return segment.startsWith(QLatin1String("http://"))
-        || segment.startsWith(QLatin1String("https://"))
-        || segment.startsWith(QLatin1String("vnc://"))
-        || segment.startsWith(QLatin1String("fish://"))
-        || segment.startsWith(QLatin1String("ftp://"))
-        || segment.startsWith(QLatin1String("ftps://"))
-        || segment.startsWith(QLatin1String("sftp://"))
-        || segment.startsWith(QLatin1String("smb://"))
-        || segment.startsWith(QLatin1String("irc://"))
-        || segment.startsWith(QLatin1String("ircs://"))
-        || segment.startsWith(QLatin1String("mailto:"))
-        || segment.startsWith(QLatin1String("www."))
-        || segment.startsWith(QLatin1String("ftp."))
-        || segment.startsWith(QLatin1String("file://"))
-        || segment.startsWith(QLatin1String("news:"))
-        || segment.startsWith(QLatin1String("tel:"))
-        || segment.startsWith(QLatin1String("xmpp:"));
+    switch (segment.front().unicode()) {
+    case 'f':
+        return segment.startsWith(QLatin1String("ftp://"))
+            || segment.startsWith(QLatin1String("ftps://"))
+            || segment.startsWith(QLatin1String("ftp."))
+            || segment.startsWith(QLatin1String("fish://"))
+            || segment.startsWith(QLatin1String("file://"));
+    case 'h':
+        return segment.startsWith(QLatin1String("http://"))
+            || segment.startsWith(QLatin1String("https://"));
+    case 'i':
+        return segment.startsWith(QLatin1String("irc://"))
+            || segment.startsWith(QLatin1String("ircs://"));
+    case 'm':
+        return segment.startsWith(QLatin1String("mailto:"));
+    case 'n':
+        return segment.startsWith(QLatin1String("news:"));
+    case 's':
+        return segment.startsWith(QLatin1String("sftp://"))
+            || segment.startsWith(QLatin1String("smb://"));
+    case 't':
+        return segment.startsWith(QLatin1String("tel:"));
+    case 'v':
+        return segment.startsWith(QLatin1String("vnc://"));
+    case 'w':
+        return segment.startsWith(QLatin1String("www."));
+    case 'x':
+        return segment.startsWith(QLatin1String("xmpp:"));
+    default:
+        return false;
+    }
     /* clang-format on */
 }
 
 bool KTextToHTMLHelper::isEmptyUrl(const QString &url) const
 {
+    // None of the empty URLs is longer than "https://"
+    if (url.length() > 8) {
+        return false;
+    }
+
     /* clang-format off */
     return url.isEmpty()
         || url == QLatin1String("http://")
@@ -400,17 +529,144 @@ QString KTextToHTMLHelper::highlightedText()
     return QString();
 }
 
-QString KTextToHTML::convertToHtml(const QString &plainText, const KTextToHTML::Options &flags, int maxUrlLen, int maxAddressLen)
+static QString escapeHtml(QStringView text)
+{
+    QString result;
+    for (const QChar ch : text) {
+        if (ch == QLatin1Char('&')) {
+            result += QLatin1String("&amp;");
+        } else if (ch == QLatin1Char('"')) {
+            result += QLatin1String("&quot;");
+        } else if (ch == QLatin1Char('<')) {
+            result += QLatin1String("&lt;");
+        } else if (ch == QLatin1Char('>')) {
+            result += QLatin1String("&gt;");
+        } else {
+            result += ch;
+        }
+    }
+    return result;
+}
+
+// The column and whether the conversion is at the start of a line, for
+// continuing it where it left off
+struct ConversionState {
+    int x = 0;
+    bool startOfLine = true;
+};
+
+/**
+ * Which characters are copied to the HTML as they are, without starting
+ * anything that needs converting with the given options
+ */
+class PlainCharacters
 {
-    KTextToHTMLHelper helper(plainText, 0, maxUrlLen, maxAddressLen);
+public:
+    explicit PlainCharacters(const KTextToHTML::Options &flags)
+    {
+        using namespace KTextToHTML;
+
+        const auto mark = [this](const char *chars, Kind kind) {
+            for (; *chars; ++chars) {
+                m_kinds[uchar(*chars)] = kind;
+            }
+        };
+        std::fill(std::begin(m_kinds), std::end(m_kinds), Plain);
+        mark("\n&\"<>", Special);
+        if (flags & PreserveSpaces) {
+            mark(" \t", Special);
+        }
+        if (!(flags & IgnoreUrls)) {
+            mark("@", Special);
+            mark("fhimnstvwx", UrlStart);
+        }
+        if (flags & ConvertPhoneNumbers) {
+            mark("+0123456789", Special);
+        }
+        if (flags & HighlightText) {
+            mark("/*_-", Special);
+        }
+        m_specialDigits = flags.testFlag(ConvertPhoneNumbers);
+    }
 
+    // Whether @p ch, following @p previous, is copied as it is
+    bool isPlain(QChar ch, QChar previous) const
+    {
+        const char16_t c = ch.unicode();
+        if (c >= 128) {
+            // Only phone numbers can start with other characters than ASCII ones
+            return !m_specialDigits || !ch.isDigit();
+        }
+        switch (m_kinds[c]) {
+        case Plain:
+            return true;
+        case Special:
+            return false;
+        case UrlStart:
+            // A URL has to start after a character not allowed in it, see atUrl()
+            return !previous.isNull() && (previous.isLetterOrNumber() || hasAsciiClass(previous, DotAtom));
+        }
+        return false;
+    }
+
+private:
+    enum Kind : quint8 {
+        Plain,
+        Special,
+        UrlStart,
+    };
+    Kind m_kinds[128];
+    bool m_specialDigits;
+};
+
+/**
+ * The size of the HTML for @p text, without links, highlighting and
+ * non-breaking spaces, for allocating it at once
+ */
+static int htmlSize(QStringView text)
+{
+    int size = text.size();
+    for (const QChar ch : text) {
+        switch (ch.unicode()) {
+        case '&':
+            size += 4;
+            break;
+        case '"':
+            size += 5;
+            break;
+        case '<':
+        case '>':
+            size += 3;
+            break;
+        case '\n':
+            size += 6;
+            break;
+        }
+    }
+    return size;
+}
+
+/**
+ * Converts the text of @p helper from its current position up to @p end,
+ * which is either the end of the text or the start of a line. Constructs
+ * starting before @p end can extend beyond it, leaving the position of
+ * @p helper after them.
+ *
+ * Sets @p badUrl and returns an empty string if a malformed URL was found.
+ */
+static QString convertLines(KTextToHTMLHelper &helper, int end, const KTextToHTML::Options &flags, ConversionState &state, bool *badUrl)
+{
+    using namespace KTextToHTML;
+
+    const PlainCharacters plain(flags);
     QString str;
-    QString result(static_cast<QChar *>(nullptr), helper.mText.length() * 2);
+    QString result;
+    result.reserve(htmlSize(QStringView(helper.mText).mid(helper.mPos, end - helper.mPos)));
     QChar ch;
-    int x;
-    bool startOfLine = true;
+    int &x = state.x;
+    bool &startOfLine = state.startOfLine;
 
-    for (helper.mPos = 0, x = 0; helper.mPos < helper.mText.length(); ++helper.mPos, ++x) {
+    for (; helper.mPos < end; ++helper.mPos, ++x) {
         ch = helper.mText.at(helper.mPos);
         if (flags & PreserveSpaces) {
             if (ch == QLatin1Char(' ')) {
@@ -462,6 +718,23 @@ QString KTextToHTML::convertToHtml(const QString &plainText, const KTextToHTML::
         }
 
         startOfLine = false;
+
+        // Copy text which doesn't need converting at once
+        const auto previous = [&](int pos) {
+            return pos > 0 ? helper.mText.at(pos - 1) : QChar();
+        };
+        if (plain.isPlain(ch, previous(helper.mPos))) {
+            int plainEnd = helper.mPos + 1;
+            while (plainEnd < end && plain.isPlain(helper.mText.at(plainEnd), helper.mText.at(plainEnd - 1))) {
+                ++plainEnd;
+            }
+            const int length = plainEnd - helper.mPos;
+            result += QStringView(helper.mText).mid(helper.mPos, length);
+            helper.mPos += length - 1;
+            x += length - 1;
+            continue;
+        }
+
         if (ch == QLatin1Char('&')) {
             result += QLatin1String("&amp;");
         } else if (ch == QLatin1Char('"')) {
@@ -473,24 +746,9 @@ QString KTextToHTML::convertToHtml(const QString &plainText, const KTextToHTML::
         } else {
             const int start = helper.mPos;
             if (!(flags & IgnoreUrls)) {
-                bool badUrl = false;
-                str = helper.getUrl(&badUrl);
-                if (badUrl) {
-                    QString resultBadUrl;
-                    for (const QChar chBadUrl : std::as_const(helper.mText)) {
-                        if (chBadUrl == QLatin1Char('&')) {
-                            resultBadUrl += QLatin1String("&amp;");
-                        } else if (chBadUrl == QLatin1Char('"')) {
-                            resultBadUrl += QLatin1String("&quot;");
-                        } else if (chBadUrl == QLatin1Char('<')) {
-                            resultBadUrl += QLatin1String("&lt;");
-                        } else if (chBadUrl == QLatin1Char('>')) {
-                            resultBadUrl += QLatin1String("&gt;");
-                        } else {
-                            resultBadUrl += chBadUrl;
-                        }
-                    }
-                    return resultBadUrl;
+                str = helper.getUrl(badUrl);
+                if (*badUrl) {
+                    return QString();
                 }
                 if (!str.isEmpty()) {
                     QString hyperlink;
@@ -547,3 +805,121 @@ QString KTextToHTML::convertToHtml(const QString &plainText, const KTextToHTML::
 
     return result;
 }
+
+// Converts @p plainText as a whole, reusing @p helper
+static QString convertText(KTextToHTMLHelper &helper, const QString &plainText, const KTextToHTML::Options &flags)
+{
+    helper.mText = plainText;
+    helper.mPos = 0;
+
+    ConversionState state;
+    bool badUrl = false;
+    const QString result = convertLines(helper, helper.mText.length(), flags, state, &badUrl);
+    if (badUrl) {
+        return escapeHtml(helper.mText);
+    }
+    return result;
+}
+
+QString KTextToHTML::convertToHtml(const QString &plainText, const KTextToHTML::Options &flags, int maxUrlLen, int maxAddressLen)
+{
+    KTRACE_SCOPE_ARG("KTextToHTML::convertToHtml", "length", qlonglong(plainText.size()));
+    KTextToHTMLHelper helper(QString(), 0, maxUrlLen, maxAddressLen);
+    return convertText(helper, plainText, flags);
+}
+
+QStringList KTextToHTML::convertToHtmlBatch(const QStringList &plainTexts, const KTextToHTML::Options &flags, int maxUrlLen, int maxAddressLen)
+{
+    QStringList results(plainTexts.size());
+    QString *const out = results.data();
+
+    // Every thread converts with a helper of its own
+    KParallel::forEachIndex(plainTexts.size(), [&]() {
+        return [&, helper = KTextToHTMLHelper(QString(), 0, maxUrlLen, maxAddressLen)](qsizetype i) mutable {
+            out[i] = convertText(helper, plainTexts.at(i), flags);
+        };
+    });
+    return results;
+}
+
+class KTextToHTML::ConverterPrivate
+{
+public:
+    ConverterPrivate(const Converter::OutputFunction &output, const Options &options, int maxUrlLen, int maxAddressLen)
+        : output(output)
+        , options(options)
+        , helper(QString(), 0, maxUrlLen, maxAddressLen)
+    {
+    }
+
+    void convert(int end);
+
+    Converter::OutputFunction output;
+    const Options options;
+    // mText holds the text not converted yet, preceded by the last converted
+    // character, if any, for looking back at it
+    KTextToHTMLHelper helper;
+    ConversionState state;
+};
+
+void KTextToHTML::ConverterPrivate::convert(int end)
+{
+    const int start = helper.mPos;
+    bool badUrl = false;
+    QString html = convertLines(helper, end, options, state, &badUrl);
+    if (badUrl) {
+        html = escapeHtml(QStringView(helper.mText).mid(start, end - start));
+        helper.mPos = end;
+        state = ConversionState();
+    }
+    if (!html.isEmpty()) {
+        output(html);
+    }
+
+    const int consumed = qMax(0, helper.mPos - 1);
+    helper.mText.remove(0, consumed);
+    helper.mPos -= consumed;
+}
+
+KTextToHTML::Converter::Converter(const OutputFunction &output, const Options &options, int maxUrlLen, int maxAddressLen)
+    : d(new ConverterPrivate(output, options, maxUrlLen, maxAddressLen))
+{
+}
+
+KTextToHTML::Converter::Converter(QIODevice *output, const Options &options, int maxUrlLen, int maxAddressLen)
+    : Converter(
+        [output](const QString &html) {
+            output->write(html.toUtf8());
+        },
+        options,
+        maxUrlLen,
+        maxAddressLen)
+{
+}
+
+KTextToHTML::Converter::~Converter() = default;
+
+void KTextToHTML::Converter::addText(QStringView text)
+{
+    d->helper.mText += text;
+
+    // Convert up to the last line start which leaves enough text after it to
+    // find the end of a URL continuing on the next lines
+    const int lookAhead = d->helper.mMaxUrlLen;
+    const int last = d->helper.mText.length() - lookAhead;
+    if (last <= d->helper.mPos) {
+        return;
+    }
+    const int end = d->helper.mText.lastIndexOf(QLatin1Char('\n'), last - 1) + 1;
+    if (end > d->helper.mPos) {
+        d->convert(end);
+    }
+}
+
+void KTextToHTML::Converter::finish()
+{
+    d->convert(d->helper.mText.length());
+    d->helper.mText.clear();
+    d->helper.mPos = 0;
+    d->state = ConversionState();
+}
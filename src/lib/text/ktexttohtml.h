@@ -11,6 +11,13 @@
 #include <kcoreaddons_export.h>
 
 #include <QString>
+#include <QStringList>
+
+#include <functional>
+#include <memory>
+
+class QIODevice;
+class KSharedDataCache;
 
 /**
  * @author Dave Corrie \<kde@davecorrie.com\>
@@ -80,6 +87,113 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(Options)
  */
 KCOREADDONS_EXPORT QString convertToHtml(const QString &plainText, const KTextToHTML::Options &options, int maxUrlLen = 4096, int maxAddressLen = 255);
 
+/**
+ * Converts many independent plaintexts into html, like calling convertToHtml()
+ * for each of them, but spread over the idle threads of the global thread pool.
+ *
+ * @param  plainTexts  The texts to be converted into HTML.
+ *
+ * See convertToHtml() for the other parameters.
+ *
+ * @return The HTML versions of @p plainTexts, in the same order.
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QStringList
+convertToHtmlBatch(const QStringList &plainTexts, const KTextToHTML::Options &options, int maxUrlLen = 4096, int maxAddressLen = 255);
+
+/**
+ * Converts plaintext into html like convertToHtml(), but looks the HTML up in
+ * @p cache first, and stores it there if it isn't found.
+ *
+ * The HTML is stored under a hash of @p plainText and the other parameters, so
+ * the processes sharing @p cache, e.g. an indexer and a viewer of the same
+ * mails, convert each text only once between them. Use a cache of its own,
+ * as the keys are not meant to be mixed with others.
+ *
+ * @code
+ * KSharedDataCache cache(QStringLiteral("myapp-messagehtml"), 16 * 1024 * 1024);
+ * const QString html = KTextToHTML::convertToHtmlCached(&cache, body, KTextToHTML::HighlightText);
+ * @endcode
+ *
+ * @param  cache  The cache for the HTML, may be @c nullptr to always convert.
+ *
+ * See convertToHtml() for the other parameters.
+ *
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT QString
+convertToHtmlCached(KSharedDataCache *cache, const QString &plainText, const KTextToHTML::Options &options, int maxUrlLen = 4096, int maxAddressLen = 255);
+
+class ConverterPrivate;
+
+/**
+ * @brief Converts plaintext into html piece by piece
+ *
+ * A Converter produces the same HTML as convertToHtml(), but takes the text
+ * in chunks of any size and passes on the HTML for every complete line as
+ * soon as it is known. Large texts like long mail bodies or logs can thus be
+ * converted while reading them, without holding all of the text and HTML in
+ * memory at once.
+ *
+ * @code
+ * KTextToHTML::Converter converter(&htmlFile, KTextToHTML::HighlightText);
+ * while (!logFile.atEnd()) {
+ *     converter.addText(QString::fromUtf8(logFile.read(64 * 1024)));
+ * }
+ * converter.finish();
+ * @endcode
+ *
+ * A line is converted once the text following it is at least @c maxUrlLen
+ * characters long, so that URLs enclosed in brackets or quotes can still
+ * continue on the next lines. If a malformed URL is found, only the lines
+ * converted along with it are escaped without any markup, instead of
+ * the whole text.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT Converter
+{
+public:
+    /**
+     * Receives the next piece of HTML
+     */
+    using OutputFunction = std::function<void(const QString &html)>;
+
+    /**
+     * Creates a converter passing the HTML on to @p output.
+     *
+     * See convertToHtml() for the other parameters.
+     */
+    Converter(const OutputFunction &output, const KTextToHTML::Options &options, int maxUrlLen = 4096, int maxAddressLen = 255);
+
+    /**
+     * Creates a converter writing the HTML to @p output, encoded as UTF-8.
+     * @p output needs to stay valid as long as the converter is in use.
+     *
+     * See convertToHtml() for the other parameters.
+     */
+    Converter(QIODevice *output, const KTextToHTML::Options &options, int maxUrlLen = 4096, int maxAddressLen = 255);
+
+    ~Converter();
+
+    /**
+     * Appends @p text to the text being converted. This outputs the HTML of
+     * the lines which are complete by now.
+     */
+    void addText(QStringView text);
+
+    /**
+     * Converts the rest of the text. Text added after this is converted as
+     * a new text.
+     */
+    void finish();
+
+private:
+    Q_DISABLE_COPY(Converter)
+    std::unique_ptr<ConverterPrivate> const d;
+};
+
 }
 
 #endif
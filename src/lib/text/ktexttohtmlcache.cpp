@@ -0,0 +1,39 @@
+/*
+    This file is part of the KDE libraries
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// Apart from ktexttohtml.cpp, which is also built into a test without the cache
+
+#include "ktexttohtml.h"
+#include "kcoreaddons_version.h"
+#include "kshareddatacache.h"
+
+#include <QCryptographicHash>
+
+QString KTextToHTML::convertToHtmlCached(KSharedDataCache *cache, const QString &plainText, const KTextToHTML::Options &flags, int maxUrlLen, int maxAddressLen)
+{
+    if (!cache) {
+        return convertToHtml(plainText, flags, maxUrlLen, maxAddressLen);
+    }
+
+    // The version is part of the key, as other versions might convert differently
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(plainText.constData()), plainText.size() * qsizetype(sizeof(QChar))));
+    const QString key = QStringLiteral("KTextToHTML/" KCOREADDONS_VERSION_STRING "/%1/%2/%3/%4")
+                            .arg(int(flags))
+                            .arg(maxUrlLen)
+                            .arg(maxAddressLen)
+                            .arg(QString::fromLatin1(hash.result().toHex()));
+
+    // Stored as UTF-16, so that a hit is just a copy
+    QByteArray data;
+    if (cache->find(key, &data) && data.size() % qsizetype(sizeof(QChar)) == 0) {
+        return QString(reinterpret_cast<const QChar *>(data.constData()), data.size() / qsizetype(sizeof(QChar)));
+    }
+
+    const QString html = convertToHtml(plainText, flags, maxUrlLen, maxAddressLen);
+    cache->insert(key, QByteArray(reinterpret_cast<const char *>(html.constData()), html.size() * qsizetype(sizeof(QChar))));
+    return html;
+}
@@ -11,6 +11,8 @@
 
 #include "kformatprivate_p.h"
 
+#include <QHash>
+
 KFormat::KFormat(const QLocale &locale)
     : d(new KFormatPrivate(locale))
 {
@@ -36,6 +38,16 @@ QString KFormat::formatByteSize(double size, int precision, KFormat::BinaryUnitD
     return d->formatByteSize(size, precision, dialect, units);
 }
 
+void KFormat::appendByteSize(QString &buffer, double size, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const
+{
+    d->appendByteSize(buffer, size, precision, dialect, units);
+}
+
+QStringList KFormat::formatByteSizes(const QList<qint64> &sizes, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const
+{
+    return d->formatByteSizes(sizes, precision, dialect, units);
+}
+
 QString KFormat::formatValue(double value, KFormat::Unit unit, int precision, KFormat::UnitPrefix prefix, KFormat::BinaryUnitDialect dialect) const
 {
     return d->formatValue(value, unit, QString(), precision, prefix, dialect);
@@ -77,4 +89,75 @@ QString KFormat::formatRelativeDateTime(const QDateTime &dateTime, QLocale::Form
     return d->formatRelativeDateTime(dateTime, format);
 }
 
+class KFormatRelativeDateFormatterPrivate
+{
+public:
+    // Dropping everything is good enough, a view hardly shows that many different dates
+    static constexpr qsizetype MaxCachedDates = 10000;
+
+    void refresh()
+    {
+        now = QDateTime::currentDateTime();
+        relativeDates.clear();
+        dates.clear();
+    }
+
+    QSharedDataPointer<KFormatPrivate> format;
+    QLocale::FormatType formatType;
+    QDateTime now;
+    // Both by Julian day, relativeDates holds the results of formatRelativeDate(),
+    // dates the ones of QLocale::toString() for formatRelativeDateTime()
+    QHash<qint64, QString> relativeDates;
+    QHash<qint64, QString> dates;
+};
+
+KFormat::RelativeDateFormatter::RelativeDateFormatter(const KFormat &format, QLocale::FormatType formatType)
+    : d(new KFormatRelativeDateFormatterPrivate)
+{
+    d->format = format.d;
+    d->formatType = formatType;
+    d->refresh();
+}
+
+KFormat::RelativeDateFormatter::~RelativeDateFormatter() = default;
+
+void KFormat::RelativeDateFormatter::refresh()
+{
+    d->refresh();
+}
+
+QDateTime KFormat::RelativeDateFormatter::referenceDateTime() const
+{
+    return d->now;
+}
+
+QString KFormat::RelativeDateFormatter::formatRelativeDate(const QDate &date)
+{
+    if (!date.isValid()) {
+        return d->format->formatRelativeDate(date, d->formatType, d->now.date());
+    }
+
+    auto it = d->relativeDates.constFind(date.toJulianDay());
+    if (it == d->relativeDates.cend()) {
+        if (d->relativeDates.size() >= KFormatRelativeDateFormatterPrivate::MaxCachedDates) {
+            d->relativeDates.clear();
+        }
+        it = d->relativeDates.insert(date.toJulianDay(), d->format->formatRelativeDate(date, d->formatType, d->now.date()));
+    }
+    return *it;
+}
+
+QString KFormat::RelativeDateFormatter::formatRelativeDateTime(const QDateTime &dateTime)
+{
+    const QDate date = dateTime.date();
+    auto it = d->dates.constFind(date.toJulianDay());
+    if (it == d->dates.cend()) {
+        if (d->dates.size() >= KFormatRelativeDateFormatterPrivate::MaxCachedDates) {
+            d->dates.clear();
+        }
+        it = d->dates.insert(date.toJulianDay(), d->format->formatDate(date, d->formatType));
+    }
+    return d->format->formatRelativeDateTime(dateTime, d->formatType, d->now, *it);
+}
+
 #include "moc_kformat.cpp"
@@ -18,6 +18,9 @@
 #include <QLocale>
 #include <QSharedPointer>
 #include <QString>
+#include <QStringList>
+
+#include <memory>
 
 class QDate;
 class QDateTime;
@@ -248,6 +251,45 @@ public:
                            KFormat::BinaryUnitDialect dialect = KFormat::DefaultBinaryDialect,
                            KFormat::BinarySizeUnits units = KFormat::DefaultBinaryUnits) const;
 
+    /**
+     * Converts @p size like formatByteSize(), and appends the result to @p buffer.
+     *
+     * Reusing the same buffer for many sizes, e.g. when rendering a column of a
+     * view, avoids allocating a new string for each of them.
+     *
+     * @param buffer the string to append the converted size to
+     * @param size size in bytes
+     * @param precision number of places after the decimal point to use
+     * @param dialect binary unit standard to use
+     * @param units specific unit size to use in result
+     * @see formatByteSize
+     * @since 6.0
+     */
+    void appendByteSize(QString &buffer,
+                        double size,
+                        int precision = 1,
+                        KFormat::BinaryUnitDialect dialect = KFormat::DefaultBinaryDialect,
+                        KFormat::BinarySizeUnits units = KFormat::DefaultBinaryUnits) const;
+
+    /**
+     * Converts all of @p sizes like formatByteSize().
+     *
+     * This is faster than calling formatByteSize() for each size, as the user's
+     * preferred dialect is only looked up once.
+     *
+     * @param sizes sizes in bytes
+     * @param precision number of places after the decimal point to use
+     * @param dialect binary unit standard to use
+     * @param units specific unit size to use in result
+     * @return the converted sizes, in the same order as @p sizes
+     * @see formatByteSize
+     * @since 6.0
+     */
+    QStringList formatByteSizes(const QList<qint64> &sizes,
+                                int precision = 1,
+                                KFormat::BinaryUnitDialect dialect = KFormat::DefaultBinaryDialect,
+                                KFormat::BinarySizeUnits units = KFormat::DefaultBinaryUnits) const;
+
     /**
      * Given a number of milliseconds, converts that to a string containing
      * the localized equivalent, e.g. 1:23:45
@@ -338,6 +380,66 @@ public:
      */
     QString formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format) const;
 
+    /**
+     * @class RelativeDateFormatter kformat.h KFormat
+     *
+     * Formats many dates like formatRelativeDate() and formatRelativeDateTime(),
+     * e.g. for the items of a view.
+     *
+     * The current date and time are only taken when the formatter is created or
+     * refreshed, so that they are the same for all items. The formatted dates are
+     * cached, which makes formatting the many items with the same date cheap.
+     *
+     * @code
+     * KFormat::RelativeDateFormatter formatter(KFormat(), QLocale::ShortFormat);
+     * for (const QFileInfo &info : files) {
+     *     const QString modified = formatter.formatRelativeDateTime(info.lastModified());
+     * }
+     * // before the next repaint
+     * formatter.refresh();
+     * @endcode
+     *
+     * A formatter is not thread-safe.
+     *
+     * @since 6.0
+     */
+    class KCOREADDONS_EXPORT RelativeDateFormatter
+    {
+    public:
+        /**
+         * Creates a formatter using @p format, with the current date and time as reference.
+         *
+         * @param format the formatter to use for the locale and translations
+         * @param formatType the date format to use
+         */
+        explicit RelativeDateFormatter(const KFormat &format, QLocale::FormatType formatType = QLocale::ShortFormat);
+        ~RelativeDateFormatter();
+
+        /**
+         * Takes the current date and time as the new reference, and drops the cached dates.
+         */
+        void refresh();
+
+        /**
+         * @return the date and time the dates are formatted relative to
+         */
+        QDateTime referenceDateTime() const;
+
+        /**
+         * Formats @p date like KFormat::formatRelativeDate(), relative to referenceDateTime().
+         */
+        QString formatRelativeDate(const QDate &date);
+
+        /**
+         * Formats @p dateTime like KFormat::formatRelativeDateTime(), relative to referenceDateTime().
+         */
+        QString formatRelativeDateTime(const QDateTime &dateTime);
+
+    private:
+        std::unique_ptr<class KFormatRelativeDateFormatterPrivate> const d;
+        Q_DISABLE_COPY(RelativeDateFormatter)
+    };
+
     /**
      * Converts @p value to the appropriate string representation
      *
@@ -13,10 +13,14 @@
 #include "kformatprivate_p.h"
 
 #include <QDateTime>
+#include <QMutexLocker>
 #include <QSettings>
 #include <QStandardPaths>
 
-#include <math.h>
+#include <QtAlgorithms>
+
+#include <cmath>
+#include <iterator>
 
 KFormatPrivate::KFormatPrivate(const QLocale &locale)
     : m_locale(locale)
@@ -32,6 +36,72 @@ constexpr double bpow(int exp)
     return (exp > 0) ? 2.0 * bpow(exp - 1) : (exp < 0) ? 0.5 * bpow(exp + 1) : 1.0;
 }
 
+// The factors of the units of formatByteSize(), which are exact in binary
+static constexpr double s_binaryFactors[] = {1.0, bpow(10), bpow(20), bpow(30), bpow(40), bpow(50), bpow(60), bpow(70), bpow(80)};
+static constexpr double s_decimalFactors[] = {1.0, 1e3, 1e6, 1e9, 1e12, 1e15, 1e18, 1e21, 1e24};
+
+// The power of 1024 (or 1000 for a decimal @p multiplier) that @p value is in,
+// for the common case of a whole number, such as a size in bytes. This is found
+// from the bit length or with integer comparisons, instead of with a chain of
+// divisions. Returns -1 if @p value is not a whole number in [1, 2^64).
+static int integerPower(double value, double multiplier)
+{
+    const double absValue = qAbs(value);
+    if (!(absValue >= 1.0 && absValue < 18446744073709551616.0) || absValue != std::floor(absValue)) {
+        return -1;
+    }
+    const quint64 n = quint64(absValue);
+    if (multiplier == 1024.0) {
+        return (63 - qCountLeadingZeroBits(n)) / 10;
+    }
+    static constexpr quint64 thresholds[] = {1000ULL, 1000000ULL, 1000000000ULL, 1000000000000ULL, 1000000000000000ULL, 1000000000000000000ULL};
+    int power = 0;
+    while (power < int(std::size(thresholds)) && n >= thresholds[power]) {
+        ++power;
+    }
+    return power;
+}
+
+const KFormatPrivate::ValueStrings &KFormatPrivate::valueStrings() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    if (!m_valueStrings) {
+        m_valueStrings.reset(new ValueStrings{
+            {
+                {KFormat::UnitPrefix::Yocto, 1e-24, bpow(-80), tr("y", "SI prefix for 10^⁻24"), QString()},
+                {KFormat::UnitPrefix::Zepto, 1e-21, bpow(-70), tr("z", "SI prefix for 10^⁻21"), QString()},
+                {KFormat::UnitPrefix::Atto, 1e-18, bpow(-60), tr("a", "SI prefix for 10^⁻18"), QString()},
+                {KFormat::UnitPrefix::Femto, 1e-15, bpow(-50), tr("f", "SI prefix for 10^⁻15"), QString()},
+                {KFormat::UnitPrefix::Pico, 1e-12, bpow(-40), tr("p", "SI prefix for 10^⁻12"), QString()},
+                {KFormat::UnitPrefix::Nano, 1e-9, bpow(-30), tr("n", "SI prefix for 10^⁻9"), QString()},
+                {KFormat::UnitPrefix::Micro, 1e-6, bpow(-20), tr("µ", "SI prefix for 10^⁻6"), QString()},
+                {KFormat::UnitPrefix::Milli, 1e-3, bpow(-10), tr("m", "SI prefix for 10^⁻3"), QString()},
+                {KFormat::UnitPrefix::Unity, 1.0, 1.0, QString(), QString()},
+                {KFormat::UnitPrefix::Kilo, 1e3, bpow(10), tr("k", "SI prefix for 10^3"), tr("Ki", "IEC binary prefix for 2^10")},
+                {KFormat::UnitPrefix::Mega, 1e6, bpow(20), tr("M", "SI prefix for 10^6"), tr("Mi", "IEC binary prefix for 2^20")},
+                {KFormat::UnitPrefix::Giga, 1e9, bpow(30), tr("G", "SI prefix for 10^9"), tr("Gi", "IEC binary prefix for 2^30")},
+                {KFormat::UnitPrefix::Tera, 1e12, bpow(40), tr("T", "SI prefix for 10^12"), tr("Ti", "IEC binary prefix for 2^40")},
+                {KFormat::UnitPrefix::Peta, 1e15, bpow(50), tr("P", "SI prefix for 10^15"), tr("Pi", "IEC binary prefix for 2^50")},
+                {KFormat::UnitPrefix::Exa, 1e18, bpow(60), tr("E", "SI prefix for 10^18"), tr("Ei", "IEC binary prefix for 2^60")},
+                {KFormat::UnitPrefix::Zetta, 1e21, bpow(70), tr("Z", "SI prefix for 10^21"), tr("Zi", "IEC binary prefix for 2^70")},
+                {KFormat::UnitPrefix::Yotta, 1e24, bpow(80), tr("Y", "SI prefix for 10^24"), tr("Yi", "IEC binary prefix for 2^80")},
+            },
+            {
+                QString(), // KFormat::Unit::Other
+                tr("bit", "Symbol of binary digit"),
+                tr("B", "Symbol of byte"),
+                tr("m", "Symbol of meter"),
+                tr("Hz", "Symbol of hertz"),
+            },
+            //: value without prefix, format "<val> <unit>"
+            tr("%1 %2", "no Prefix"),
+            //: value with prefix, format "<val> <prefix><unit>"
+            tr("%1 %2%3", "MetricBinaryDialect"),
+        });
+    }
+    return *m_valueStrings;
+}
+
 QString KFormatPrivate::formatValue(double value,
                                     KFormat::Unit unit,
                                     QString unitString,
@@ -53,15 +123,18 @@ QString KFormatPrivate::formatValue(double value,
     }
 
     if (prefix == KFormat::UnitPrefix::AutoAdjust) {
-        int power = 0;
-        double adjustValue = qAbs(value);
-        while (adjustValue >= multiplier) {
-            adjustValue /= multiplier;
-            power += 1;
-        }
-        while (adjustValue && adjustValue < 1.0) {
-            adjustValue *= multiplier;
-            power -= 1;
+        int power = integerPower(value, multiplier);
+        if (power < 0) {
+            power = 0;
+            double adjustValue = qAbs(value);
+            while (adjustValue >= multiplier) {
+                adjustValue /= multiplier;
+                power += 1;
+            }
+            while (adjustValue && adjustValue < 1.0) {
+                adjustValue *= multiplier;
+                power -= 1;
+            }
         }
         const KFormat::UnitPrefix map[] = {
             KFormat::UnitPrefix::Yocto, // -8
@@ -90,59 +163,18 @@ QString KFormatPrivate::formatValue(double value,
         precision = 0;
     }
 
-    struct PrefixMapEntry {
-        KFormat::UnitPrefix prefix;
-        double decimalFactor;
-        double binaryFactor;
-        QString prefixCharSI;
-        QString prefixCharIEC;
-    };
-
-    const PrefixMapEntry map[] = {
-        {KFormat::UnitPrefix::Yocto, 1e-24, bpow(-80), tr("y", "SI prefix for 10^⁻24"), QString()},
-        {KFormat::UnitPrefix::Zepto, 1e-21, bpow(-70), tr("z", "SI prefix for 10^⁻21"), QString()},
-        {KFormat::UnitPrefix::Atto, 1e-18, bpow(-60), tr("a", "SI prefix for 10^⁻18"), QString()},
-        {KFormat::UnitPrefix::Femto, 1e-15, bpow(-50), tr("f", "SI prefix for 10^⁻15"), QString()},
-        {KFormat::UnitPrefix::Pico, 1e-12, bpow(-40), tr("p", "SI prefix for 10^⁻12"), QString()},
-        {KFormat::UnitPrefix::Nano, 1e-9, bpow(-30), tr("n", "SI prefix for 10^⁻9"), QString()},
-        {KFormat::UnitPrefix::Micro, 1e-6, bpow(-20), tr("µ", "SI prefix for 10^⁻6"), QString()},
-        {KFormat::UnitPrefix::Milli, 1e-3, bpow(-10), tr("m", "SI prefix for 10^⁻3"), QString()},
-        {KFormat::UnitPrefix::Unity, 1.0, 1.0, QString(), QString()},
-        {KFormat::UnitPrefix::Kilo, 1e3, bpow(10), tr("k", "SI prefix for 10^3"), tr("Ki", "IEC binary prefix for 2^10")},
-        {KFormat::UnitPrefix::Mega, 1e6, bpow(20), tr("M", "SI prefix for 10^6"), tr("Mi", "IEC binary prefix for 2^20")},
-        {KFormat::UnitPrefix::Giga, 1e9, bpow(30), tr("G", "SI prefix for 10^9"), tr("Gi", "IEC binary prefix for 2^30")},
-        {KFormat::UnitPrefix::Tera, 1e12, bpow(40), tr("T", "SI prefix for 10^12"), tr("Ti", "IEC binary prefix for 2^40")},
-        {KFormat::UnitPrefix::Peta, 1e15, bpow(50), tr("P", "SI prefix for 10^15"), tr("Pi", "IEC binary prefix for 2^50")},
-        {KFormat::UnitPrefix::Exa, 1e18, bpow(60), tr("E", "SI prefix for 10^18"), tr("Ei", "IEC binary prefix for 2^60")},
-        {KFormat::UnitPrefix::Zetta, 1e21, bpow(70), tr("Z", "SI prefix for 10^21"), tr("Zi", "IEC binary prefix for 2^70")},
-        {KFormat::UnitPrefix::Yotta, 1e24, bpow(80), tr("Y", "SI prefix for 10^24"), tr("Yi", "IEC binary prefix for 2^80")},
-    };
-
-    auto entry = std::find_if(std::begin(map), std::end(map), [prefix](const PrefixMapEntry &e) {
+    const ValueStrings &strings = valueStrings();
+    auto entry = std::find_if(std::begin(strings.prefixes), std::end(strings.prefixes), [prefix](const ValueStrings::Prefix &e) {
         return e.prefix == prefix;
     });
 
-    switch (unit) {
-    case KFormat::Unit::Bit:
-        unitString = tr("bit", "Symbol of binary digit");
-        break;
-    case KFormat::Unit::Byte:
-        unitString = tr("B", "Symbol of byte");
-        break;
-    case KFormat::Unit::Meter:
-        unitString = tr("m", "Symbol of meter");
-        break;
-    case KFormat::Unit::Hertz:
-        unitString = tr("Hz", "Symbol of hertz");
-        break;
-    case KFormat::Unit::Other:
-        break;
+    if (unit != KFormat::Unit::Other) {
+        unitString = strings.units[static_cast<int>(unit)];
     }
 
     if (prefix == KFormat::UnitPrefix::Unity) {
         QString numString = m_locale.toString(value, 'f', precision);
-        //: value without prefix, format "<val> <unit>"
-        return tr("%1 %2", "no Prefix").arg(numString, unitString);
+        return strings.noPrefixFormat.arg(numString, unitString);
     }
 
     QString prefixString;
@@ -160,152 +192,220 @@ QString KFormatPrivate::formatValue(double value,
 
     QString numString = m_locale.toString(value, 'f', precision);
 
-    //: value with prefix, format "<val> <prefix><unit>"
-    return tr("%1 %2%3", "MetricBinaryDialect").arg(numString, prefixString, unitString);
+    return strings.prefixFormat.arg(numString, prefixString, unitString);
 }
 
-QString KFormatPrivate::formatByteSize(double size, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const
+// The translated format of a byte size in @p dialect and @p unit, which has a "%1" for the number
+QString KFormatPrivate::byteSizeFormatString(KFormat::BinaryUnitDialect dialect, int unit)
 {
-    // Current KDE default is IECBinaryDialect
-    const auto fallbackDialect = KFormat::IECBinaryDialect;
-
-    if (dialect <= KFormat::DefaultBinaryDialect || dialect > KFormat::LastBinaryDialect) {
-        const auto kdeglobals = QStandardPaths::locate(QStandardPaths::GenericConfigLocation, QStringLiteral("kdeglobals"));
-        QSettings settings(kdeglobals, QSettings::IniFormat);
-        dialect = static_cast<KFormat::BinaryUnitDialect>(settings.value("Locale/BinaryUnitDialect", fallbackDialect).toInt());
-    }
-
-    // Current KDE default is to auto-adjust so the size falls in the range 0 to 1000/1024
-    if (units < KFormat::DefaultBinaryUnits || units > KFormat::UnitLastUnit) {
-        units = KFormat::DefaultBinaryUnits;
-    }
-
-    int unit = 0; // Selects what unit to use
-    double multiplier = 1024.0;
-
-    if (dialect == KFormat::MetricBinaryDialect) {
-        multiplier = 1000.0;
-    }
-
-    // If a specific unit conversion is given, use it directly.  Otherwise
-    // search until the result is in [0, multiplier] (or out of our range).
-    if (units == KFormat::DefaultBinaryUnits) {
-        while (qAbs(size) >= multiplier && unit < int(KFormat::UnitYottaByte)) {
-            size /= multiplier;
-            ++unit;
-        }
-    } else {
-        // A specific unit is in use
-        unit = static_cast<int>(units);
-        if (unit > 0) {
-            size /= pow(multiplier, unit);
-        }
-    }
-
-    // Bytes, no rounding
-    if (unit == 0) {
-        precision = 0;
-    }
-
-    QString numString = m_locale.toString(size, 'f', precision);
-
     // Do not remove "//:" comments below, they are used by the translators.
     // NB: we cannot pass pluralization arguments, as the size may be negative
     if (dialect == KFormat::MetricBinaryDialect) {
         switch (unit) {
         case KFormat::UnitByte:
             //: MetricBinaryDialect size in bytes
-            return tr("%1 B", "MetricBinaryDialect").arg(numString);
+            return tr("%1 B", "MetricBinaryDialect");
         case KFormat::UnitKiloByte:
             //: MetricBinaryDialect size in 1000 bytes
-            return tr("%1 kB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 kB", "MetricBinaryDialect");
         case KFormat::UnitMegaByte:
             //: MetricBinaryDialect size in 10^6 bytes
-            return tr("%1 MB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 MB", "MetricBinaryDialect");
         case KFormat::UnitGigaByte:
             //: MetricBinaryDialect size in 10^9 bytes
-            return tr("%1 GB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 GB", "MetricBinaryDialect");
         case KFormat::UnitTeraByte:
             //: MetricBinaryDialect size in 10^12 bytes
-            return tr("%1 TB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 TB", "MetricBinaryDialect");
         case KFormat::UnitPetaByte:
             //: MetricBinaryDialect size in 10^15 bytes
-            return tr("%1 PB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 PB", "MetricBinaryDialect");
         case KFormat::UnitExaByte:
             //: MetricBinaryDialect size in 10^18 byte
-            return tr("%1 EB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 EB", "MetricBinaryDialect");
         case KFormat::UnitZettaByte:
             //: MetricBinaryDialect size in 10^21 bytes
-            return tr("%1 ZB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 ZB", "MetricBinaryDialect");
         case KFormat::UnitYottaByte:
             //: MetricBinaryDialect size in 10^24 bytes
-            return tr("%1 YB", "MetricBinaryDialect").arg(numString);
+            return tr("%1 YB", "MetricBinaryDialect");
         }
     } else if (dialect == KFormat::JEDECBinaryDialect) {
         switch (unit) {
         case KFormat::UnitByte:
             //: JEDECBinaryDialect memory size in bytes
-            return tr("%1 B", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 B", "JEDECBinaryDialect");
         case KFormat::UnitKiloByte:
             //: JEDECBinaryDialect memory size in 1024 bytes
-            return tr("%1 KB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 KB", "JEDECBinaryDialect");
         case KFormat::UnitMegaByte:
             //: JEDECBinaryDialect memory size in 10^20 bytes
-            return tr("%1 MB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 MB", "JEDECBinaryDialect");
         case KFormat::UnitGigaByte:
             //: JEDECBinaryDialect memory size in 10^30 bytes
-            return tr("%1 GB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 GB", "JEDECBinaryDialect");
         case KFormat::UnitTeraByte:
             //: JEDECBinaryDialect memory size in 10^40 bytes
-            return tr("%1 TB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 TB", "JEDECBinaryDialect");
         case KFormat::UnitPetaByte:
             //: JEDECBinaryDialect memory size in 10^50 bytes
-            return tr("%1 PB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 PB", "JEDECBinaryDialect");
         case KFormat::UnitExaByte:
             //: JEDECBinaryDialect memory size in 10^60 bytes
-            return tr("%1 EB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 EB", "JEDECBinaryDialect");
         case KFormat::UnitZettaByte:
             //: JEDECBinaryDialect memory size in 10^70 bytes
-            return tr("%1 ZB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 ZB", "JEDECBinaryDialect");
         case KFormat::UnitYottaByte:
             //: JEDECBinaryDialect memory size in 10^80 bytes
-            return tr("%1 YB", "JEDECBinaryDialect").arg(numString);
+            return tr("%1 YB", "JEDECBinaryDialect");
         }
     } else { // KFormat::IECBinaryDialect, KFormat::DefaultBinaryDialect
         switch (unit) {
         case KFormat::UnitByte:
             //: IECBinaryDialect size in bytes
-            return tr("%1 B", "IECBinaryDialect").arg(numString);
+            return tr("%1 B", "IECBinaryDialect");
         case KFormat::UnitKiloByte:
             //: IECBinaryDialect size in 1024 bytes
-            return tr("%1 KiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 KiB", "IECBinaryDialect");
         case KFormat::UnitMegaByte:
             //: IECBinaryDialect size in 10^20 bytes
-            return tr("%1 MiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 MiB", "IECBinaryDialect");
         case KFormat::UnitGigaByte:
             //: IECBinaryDialect size in 10^30 bytes
-            return tr("%1 GiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 GiB", "IECBinaryDialect");
         case KFormat::UnitTeraByte:
             //: IECBinaryDialect size in 10^40 bytes
-            return tr("%1 TiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 TiB", "IECBinaryDialect");
         case KFormat::UnitPetaByte:
             //: IECBinaryDialect size in 10^50 bytes
-            return tr("%1 PiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 PiB", "IECBinaryDialect");
         case KFormat::UnitExaByte:
             //: IECBinaryDialect size in 10^60 bytes
-            return tr("%1 EiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 EiB", "IECBinaryDialect");
         case KFormat::UnitZettaByte:
             //: IECBinaryDialect size in 10^70 bytes
-            return tr("%1 ZiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 ZiB", "IECBinaryDialect");
         case KFormat::UnitYottaByte:
             //: IECBinaryDialect size in 10^80 bytes
-            return tr("%1 YiB", "IECBinaryDialect").arg(numString);
+            return tr("%1 YiB", "IECBinaryDialect");
         }
     }
 
     // Should never reach here
     Q_ASSERT(false);
-    return numString;
+    return QStringLiteral("%1");
+}
+
+KFormat::BinaryUnitDialect KFormatPrivate::defaultBinaryDialect() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_defaultBinaryDialect == KFormat::DefaultBinaryDialect) {
+        // Current KDE default is IECBinaryDialect
+        const auto fallbackDialect = KFormat::IECBinaryDialect;
+
+        const auto kdeglobals = QStandardPaths::locate(QStandardPaths::GenericConfigLocation, QStringLiteral("kdeglobals"));
+        QSettings settings(kdeglobals, QSettings::IniFormat);
+        const int dialect = settings.value("Locale/BinaryUnitDialect", fallbackDialect).toInt();
+        m_defaultBinaryDialect = dialect <= KFormat::DefaultBinaryDialect || dialect > KFormat::LastBinaryDialect
+            ? fallbackDialect
+            : static_cast<KFormat::BinaryUnitDialect>(dialect);
+    }
+    return m_defaultBinaryDialect;
+}
+
+KFormatPrivate::ByteSizeFormat KFormatPrivate::byteSizeFormat(KFormat::BinaryUnitDialect dialect, int unit) const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    std::optional<ByteSizeFormat> &format = m_byteSizeFormats[dialect][unit];
+    if (!format) {
+        const QString formatString = byteSizeFormatString(dialect, unit);
+        const qsizetype placeholder = formatString.indexOf(QLatin1String("%1"));
+        if (placeholder < 0) {
+            format = ByteSizeFormat{formatString, QString()};
+        } else {
+            format = ByteSizeFormat{formatString.left(placeholder), formatString.mid(placeholder + 2)};
+        }
+    }
+    return *format;
+}
+
+void KFormatPrivate::appendByteSize(QString &buffer, double size, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const
+{
+    if (dialect <= KFormat::DefaultBinaryDialect || dialect > KFormat::LastBinaryDialect) {
+        dialect = defaultBinaryDialect();
+    }
+
+    // Current KDE default is to auto-adjust so the size falls in the range 0 to 1000/1024
+    if (units < KFormat::DefaultBinaryUnits || units > KFormat::UnitLastUnit) {
+        units = KFormat::DefaultBinaryUnits;
+    }
+
+    int unit = 0; // Selects what unit to use
+    double multiplier = 1024.0;
+
+    if (dialect == KFormat::MetricBinaryDialect) {
+        multiplier = 1000.0;
+    }
+
+    // If a specific unit conversion is given, use it directly.  Otherwise
+    // search until the result is in [0, multiplier] (or out of our range).
+    if (units == KFormat::DefaultBinaryUnits) {
+        unit = integerPower(size, multiplier);
+        if (unit >= 0) {
+            // one division only, which is exact for the binary dialects
+            size /= dialect == KFormat::MetricBinaryDialect ? s_decimalFactors[unit] : s_binaryFactors[unit];
+        } else {
+            unit = 0;
+            while (qAbs(size) >= multiplier && unit < int(KFormat::UnitYottaByte)) {
+                size /= multiplier;
+                ++unit;
+            }
+        }
+    } else {
+        // A specific unit is in use
+        unit = static_cast<int>(units);
+        if (unit > 0) {
+            size /= dialect == KFormat::MetricBinaryDialect ? s_decimalFactors[unit] : s_binaryFactors[unit];
+        }
+    }
+
+    // Bytes, no rounding
+    if (unit == 0) {
+        precision = 0;
+    }
+
+    const ByteSizeFormat format = byteSizeFormat(dialect, unit);
+    buffer += format.before;
+    buffer += m_locale.toString(size, 'f', precision);
+    buffer += format.after;
+}
+
+QString KFormatPrivate::formatByteSize(double size, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const
+{
+    QString ret;
+    appendByteSize(ret, size, precision, dialect, units);
+    return ret;
+}
+
+QStringList KFormatPrivate::formatByteSizes(const QList<qint64> &sizes,
+                                            int precision,
+                                            KFormat::BinaryUnitDialect dialect,
+                                            KFormat::BinarySizeUnits units) const
+{
+    if (dialect <= KFormat::DefaultBinaryDialect || dialect > KFormat::LastBinaryDialect) {
+        dialect = defaultBinaryDialect();
+    }
+
+    QStringList ret;
+    ret.reserve(sizes.size());
+    for (const qint64 size : sizes) {
+        QString formatted;
+        formatted.reserve(16);
+        appendByteSize(formatted, size, precision, dialect, units);
+        ret.append(std::move(formatted));
+    }
+    return ret;
 }
 
 enum TimeConstants {
@@ -418,22 +518,22 @@ static QString formatSingleDuration(DurationUnits units, int n)
         //: @item:intext %n is a whole number
         //~ singular %n day
         //~ plural %n days
-        return KFormatPrivate::tr("%n day(s)", nullptr, n);
+        return tr("%n day(s)", nullptr, n);
     case Hours:
         //: @item:intext %n is a whole number
         //~ singular %n hour
         //~ plural %n hours
-        return KFormatPrivate::tr("%n hour(s)", nullptr, n);
+        return tr("%n hour(s)", nullptr, n);
     case Minutes:
         //: @item:intext %n is a whole number
         //~ singular %n minute
         //~ plural %n minutes
-        return KFormatPrivate::tr("%n minute(s)", nullptr, n);
+        return tr("%n minute(s)", nullptr, n);
     case Seconds:
         //: @item:intext %n is a whole number
         //~ singular %n second
         //~ plural %n seconds
-        return KFormatPrivate::tr("%n second(s)", nullptr, n);
+        return tr("%n second(s)", nullptr, n);
     }
     Q_ASSERT(false);
     return QString();
@@ -479,12 +579,17 @@ QString KFormatPrivate::formatSpelloutDuration(quint64 msecs) const
 }
 
 QString KFormatPrivate::formatRelativeDate(const QDate &date, QLocale::FormatType format) const
+{
+    return formatRelativeDate(date, format, QDate::currentDate());
+}
+
+QString KFormatPrivate::formatRelativeDate(const QDate &date, QLocale::FormatType format, const QDate &today) const
 {
     if (!date.isValid()) {
         return tr("Invalid date", "used when a relative date string can't be generated because the date is invalid");
     }
 
-    const qint64 daysTo = QDate::currentDate().daysTo(date);
+    const qint64 daysTo = today.daysTo(date);
     if (daysTo > 2 || daysTo < -2) {
         return m_locale.toString(date, format);
     }
@@ -507,7 +612,16 @@ QString KFormatPrivate::formatRelativeDate(const QDate &date, QLocale::FormatTyp
 QString KFormatPrivate::formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format) const
 {
     const QDateTime now = QDateTime::currentDateTime();
+    return formatRelativeDateTime(dateTime, format, now, QString());
+}
 
+QString KFormatPrivate::formatDate(const QDate &date, QLocale::FormatType format) const
+{
+    return m_locale.toString(date, format);
+}
+
+QString KFormatPrivate::formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format, const QDateTime &now, const QString &dateString) const
+{
     const auto secsToNow = dateTime.secsTo(now);
     constexpr int secsInAHour = 60 * 60;
     if (secsToNow >= 0 && secsToNow < secsInAHour) {
@@ -524,17 +638,19 @@ QString KFormatPrivate::formatRelativeDateTime(const QDateTime &dateTime, QLocal
 
     const auto timeFormatType = format == QLocale::FormatType::LongFormat ? QLocale::FormatType::ShortFormat : format;
     const qint64 daysToNow = dateTime.daysTo(now);
-    QString dateString;
+    QString relativeDateString;
     if (daysToNow < 2 && daysToNow > -2) {
-        dateString = formatRelativeDate(dateTime.date(), format);
+        relativeDateString = formatRelativeDate(dateTime.date(), format, now.date());
+    } else if (!dateString.isNull()) {
+        relativeDateString = dateString;
     } else {
-        dateString = m_locale.toString(dateTime.date(), format);
+        relativeDateString = m_locale.toString(dateTime.date(), format);
     }
 
     /*: relative datetime with %1 result of QLocale.toString(date, format) or formatRelativeDate
         and %2 result of QLocale.toString(time, timeformatType)
         If this does not fit the grammar of your language please contact the i18n team to solve the problem */
-    QString formattedDate = tr("%1 at %2").arg(dateString, m_locale.toString(dateTime.time(), timeFormatType));
+    QString formattedDate = tr("%1 at %2").arg(relativeDateString, m_locale.toString(dateTime.time(), timeFormatType));
 
     return formattedDate.replace(0, 1, formattedDate.at(0).toUpper());
 }
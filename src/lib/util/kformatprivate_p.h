@@ -16,6 +16,10 @@
 #include "kformat.h"
 
 #include <QCoreApplication> // for Q_DECLARE_TR_FUNCTIONS
+#include <QMutex>
+
+#include <memory>
+#include <optional>
 
 class KFormatPrivate : public QSharedData
 {
@@ -27,6 +31,10 @@ public:
 
     QString formatByteSize(double size, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const;
 
+    void appendByteSize(QString &buffer, double size, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const;
+
+    QStringList formatByteSizes(const QList<qint64> &sizes, int precision, KFormat::BinaryUnitDialect dialect, KFormat::BinarySizeUnits units) const;
+
     QString
     formatValue(double value, KFormat::Unit unit, QString unitString, int precision, KFormat::UnitPrefix prefix, KFormat::BinaryUnitDialect dialect) const;
 
@@ -40,8 +48,49 @@ public:
 
     QString formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format) const;
 
+    // Relative to @p today, see KFormat::RelativeDateFormatter
+    QString formatRelativeDate(const QDate &date, QLocale::FormatType format, const QDate &today) const;
+
+    // Relative to @p now, and with @p dateString as the formatted date unless it has to be relative
+    QString formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format, const QDateTime &now, const QString &dateString) const;
+
+    QString formatDate(const QDate &date, QLocale::FormatType format) const;
+
 private:
+    // A translated byte size format, split around the number
+    struct ByteSizeFormat {
+        QString before;
+        QString after;
+    };
+
+    // The translated strings of formatValue()
+    struct ValueStrings {
+        struct Prefix {
+            KFormat::UnitPrefix prefix;
+            double decimalFactor;
+            double binaryFactor;
+            QString prefixCharSI;
+            QString prefixCharIEC;
+        };
+        Prefix prefixes[17];
+        QString units[5];
+        QString noPrefixFormat;
+        QString prefixFormat;
+    };
+
+    static QString byteSizeFormatString(KFormat::BinaryUnitDialect dialect, int unit);
+    KFormat::BinaryUnitDialect defaultBinaryDialect() const;
+    ByteSizeFormat byteSizeFormat(KFormat::BinaryUnitDialect dialect, int unit) const;
+    const ValueStrings &valueStrings() const;
+
     QLocale m_locale;
+
+    // The translations and the user's settings are looked up once, when first needed,
+    // as the same KFormat is typically used for formatting lots of values
+    mutable QMutex m_cacheMutex;
+    mutable KFormat::BinaryUnitDialect m_defaultBinaryDialect = KFormat::DefaultBinaryDialect;
+    mutable std::optional<ByteSizeFormat> m_byteSizeFormats[KFormat::LastBinaryDialect + 1][KFormat::UnitLastUnit + 1];
+    mutable std::unique_ptr<const ValueStrings> m_valueStrings;
 };
 
 #endif // KFORMATPRIVATE_P_H
@@ -16,7 +16,9 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QHash>
 #include <QLibraryInfo>
+#include <QMutex>
 
 #include <kcoreaddons_debug.h>
 
@@ -41,6 +43,14 @@ static QString libraryPathFromAddress(void *address)
         return {};
     }
 
+    // Looking up the file of a module is comparatively expensive, and the same few modules ask over and over
+    static QMutex mutex;
+    static QHash<HMODULE, QString> modulePaths;
+    QMutexLocker locker(&mutex);
+    if (const auto it = modulePaths.constFind(hModule); it != modulePaths.cend()) {
+        return it.value();
+    }
+
     QVarLengthArray<wchar_t, MAX_PATH> pathArray;
     DWORD pathSize = pathArray.size();
     while (pathSize == pathArray.size()) { // pathSize doesn't include the null byte on success, so this only ever true if we need to grow
@@ -51,7 +61,9 @@ static QString libraryPathFromAddress(void *address)
             return {};
         }
     }
-    return QDir::fromNativeSeparators(QString::fromWCharArray(pathArray.data()));
+    const QString path = QDir::fromNativeSeparators(QString::fromWCharArray(pathArray.data()));
+    modulePaths.insert(hModule, path);
+    return path;
 #else // unsupported
     return {};
 #endif
@@ -60,8 +72,22 @@ static QString libraryPathFromAddress(void *address)
 QString KLibexec::pathFromAddress(const QString &relativePath, void *address)
 {
     const QString libraryPath = libraryPathFromAddress(address);
+
+    // Frameworks look up their helpers repeatedly, remember what the (relativePath, library) pairs resolved to
+    static QMutex mutex;
+    static QHash<std::pair<QString, QString>, QString> libexecPaths;
+    const auto key = std::make_pair(relativePath, libraryPath);
+    QMutexLocker locker(&mutex);
+    if (const auto it = libexecPaths.constFind(key); it != libexecPaths.cend()) {
+        return it.value();
+    }
+    locker.unlock();
+
     const QString absoluteDirPath = QFileInfo(libraryPath).absolutePath();
     const QString libexecPath = QFileInfo(absoluteDirPath + QLatin1Char('/') + relativePath).absoluteFilePath();
+
+    locker.relock();
+    libexecPaths.insert(key, libexecPath);
     return libexecPath;
 }
 
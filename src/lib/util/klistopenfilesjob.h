@@ -29,9 +29,13 @@ class KListOpenFilesJobPrivate;
  * subdirectory of path. When it is done the KJob::result signal is emitted and the result can be retrieved with the
  * processInfoList function.
  *
- * On Unix like systems the lsof utility is used to get the list of processes.
+ * On Unix like systems the lsof utility is used to get the list of processes,
+ * on Linux /proc can be scanned instead, see setBackend().
  * On Windows the listing always fails with error code NotSupported.
  *
+ * The processes are reported with processesFound() as soon as they are found,
+ * before the job finishes.
+ *
  * @since 5.63
  */
 class KCOREADDONS_EXPORT KListOpenFilesJob : public KJob
@@ -47,6 +51,47 @@ public:
      */
     KProcessList::KProcessInfoList processInfoList() const;
 
+    /**
+     * The ways to find the processes
+     *
+     * @since 6.0
+     */
+    enum class Backend {
+        Lsof, ///< Runs the lsof utility, the default
+        /**
+         * Scans the file descriptors, working and root directories and
+         * executables of the processes in /proc, without running lsof.
+         * Only supported on Linux, the job fails with Error::NotSupported
+         * elsewhere.
+         */
+        Proc,
+    };
+
+    /**
+     * Sets how the processes are found. This must be called before start().
+     *
+     * @since 6.0
+     */
+    void setBackend(Backend backend);
+
+    /**
+     * @return how the processes are found
+     * @since 6.0
+     */
+    Backend backend() const;
+
+Q_SIGNALS:
+    /**
+     * Emitted as soon as @p processes are found to have files open in the path,
+     * before the job finishes. processInfoList() holds them as well.
+     *
+     * @since 6.0
+     */
+    void processesFound(const KProcessList::KProcessInfoList &processes);
+
+protected:
+    bool doKill() override;
+
 public:
     /**
      * @brief Special error codes emitted by KListOpenFilesJob
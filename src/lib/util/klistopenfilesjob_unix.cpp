@@ -12,10 +12,21 @@
 #include "klistopenfilesjob.h"
 
 #include <QDir>
+#include <QFile>
 #include <QList>
 #include <QProcess>
-#include <QRegularExpression>
 #include <QStandardPaths>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+
+#ifdef Q_OS_LINUX
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#endif
 
 class KListOpenFilesJobPrivate
 {
@@ -28,11 +39,20 @@ public:
             lsofError(error);
         });
 
+        QObject::connect(&lsofProcess, &QProcess::readyReadStandardOutput, job, [this]() {
+            readLsofOutput();
+        });
+
         QObject::connect(&lsofProcess, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), job, [this](int exitCode, QProcess::ExitStatus exitStatus) {
             lsofFinished(exitCode, exitStatus);
         });
     }
 
+    ~KListOpenFilesJobPrivate()
+    {
+        stopProcScan();
+    }
+
     void start()
     {
         if (!path.exists()) {
@@ -40,6 +60,11 @@ public:
             return;
         }
 
+        if (backend == KListOpenFilesJob::Backend::Proc) {
+            startProcScan();
+            return;
+        }
+
         const QString lsofExec = QStandardPaths::findExecutable(QStringLiteral("lsof"));
         if (lsofExec.isEmpty()) {
             const QString envPath = QString::fromLocal8Bit(qgetenv("PATH"));
@@ -55,13 +80,22 @@ public:
         emitResult(static_cast<int>(KListOpenFilesJob::Error::InternalError), QObject::tr("Failed to execute `lsof'. Error code %1").arg(processError));
     }
 
+    // Parses the complete lines lsof wrote so far, with one PID each
+    void readLsofOutput();
     void lsofFinished(int, QProcess::ExitStatus);
+    void startProcScan();
+    void stopProcScan();
+    void addProcesses(const KProcessList::KProcessInfoList &processes);
     void emitResult(int error, const QString &errorText);
+    bool kill();
 
     KListOpenFilesJob *job;
     const QDir path;
+    KListOpenFilesJob::Backend backend = KListOpenFilesJob::Backend::Lsof;
     bool hasEmittedResult = false;
     QProcess lsofProcess;
+    std::unique_ptr<QThread> procScanThread;
+    std::atomic<bool> procScanCanceled = false;
 
     KProcessList::KProcessInfoList processInfoList;
 };
@@ -84,23 +118,154 @@ static KProcessList::KProcessInfo findInfoForPid(qint64 pid)
 #endif
 }
 
+void KListOpenFilesJobPrivate::readLsofOutput()
+{
+    KProcessList::KProcessInfoList found;
+    while (lsofProcess.canReadLine()) {
+        const qint64 pid = lsofProcess.readLine().trimmed().toLongLong();
+        if (pid) {
+            found << findInfoForPid(pid);
+        }
+    }
+    addProcesses(found);
+}
+
 void KListOpenFilesJobPrivate::lsofFinished(int, QProcess::ExitStatus)
 {
     if (hasEmittedResult) {
         return;
     }
-    const QString out(QString::fromLocal8Bit(lsofProcess.readAll()));
+    readLsofOutput();
+    // The last line might lack the newline
+    const qint64 pid = lsofProcess.readAll().trimmed().toLongLong();
+    if (pid) {
+        addProcesses({findInfoForPid(pid)});
+    }
+    job->emitResult();
+}
 
-    const QRegularExpression re(QStringLiteral("\\s+"));
-    const QList<QStringView> pidList = QStringView(out).split(re, Qt::SkipEmptyParts);
+#ifdef Q_OS_LINUX
+// Whether the link name in dirFd points to dirPath or a file directly in it,
+// like the files lsof +d lists
+static bool linksIntoDir(int dirFd, const char *name, const QByteArray &dirPath)
+{
+    char target[PATH_MAX];
+    const ssize_t length = readlinkat(dirFd, name, target, sizeof(target));
+    if (length <= 0 || length == sizeof(target)) {
+        return false;
+    }
+    const QByteArrayView view(target, length);
+    if (view == QByteArrayView(dirPath)) {
+        return true;
+    }
+    return view.size() > dirPath.size() && view.startsWith(dirPath) && view.at(dirPath.size()) == '/'
+        && view.indexOf('/', dirPath.size() + 1) == -1;
+}
 
-    for (const auto &pidStr : pidList) {
-        const qint64 pid = pidStr.toLongLong();
-        if (pid) {
-            processInfoList << findInfoForPid(pid);
+// Whether the process of procFd has any files open in dirPath
+static bool hasOpenFilesIn(int procFd, const QByteArray &dirPath, const std::atomic<bool> &canceled)
+{
+    for (const char *name : {"cwd", "root", "exe"}) {
+        if (linksIntoDir(procFd, name, dirPath)) {
+            return true;
         }
     }
-    job->emitResult();
+
+    const int fdDirFd = openat(procFd, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fdDirFd < 0) {
+        // e.g. the processes of other users
+        return false;
+    }
+    DIR *fdDir = fdopendir(fdDirFd);
+    if (!fdDir) {
+        close(fdDirFd);
+        return false;
+    }
+    bool found = false;
+    while (const dirent *entry = readdir(fdDir)) {
+        if (canceled) {
+            break;
+        }
+        if (entry->d_name[0] != '.' && linksIntoDir(fdDirFd, entry->d_name, dirPath)) {
+            found = true;
+            break;
+        }
+    }
+    closedir(fdDir);
+    return found;
+}
+#endif
+
+void KListOpenFilesJobPrivate::startProcScan()
+{
+#ifdef Q_OS_LINUX
+    // The links in /proc point to canonical paths
+    const QByteArray dirPath = QFile::encodeName(path.canonicalPath());
+    procScanThread.reset(QThread::create([this, dirPath]() {
+        DIR *procDir = opendir("/proc");
+        if (procDir) {
+            while (const dirent *entry = readdir(procDir)) {
+                if (procScanCanceled) {
+                    break;
+                }
+                bool isPid = false;
+                const qint64 pid = QByteArrayView(entry->d_name).toLongLong(&isPid);
+                if (!isPid) {
+                    continue;
+                }
+                const int procFd = openat(dirfd(procDir), entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (procFd < 0) {
+                    continue;
+                }
+                if (hasOpenFilesIn(procFd, dirPath, procScanCanceled)) {
+                    const KProcessList::KProcessInfo info = findInfoForPid(pid);
+                    QMetaObject::invokeMethod(
+                        job,
+                        [this, info]() {
+                            addProcesses({info});
+                        },
+                        Qt::QueuedConnection);
+                }
+                close(procFd);
+            }
+            closedir(procDir);
+        }
+        QMetaObject::invokeMethod(
+            job,
+            [this]() {
+                procScanThread->wait();
+                if (!hasEmittedResult) {
+                    job->emitResult();
+                }
+            },
+            Qt::QueuedConnection);
+    }));
+    procScanThread->start();
+#else
+    QMetaObject::invokeMethod(
+        job,
+        [this]() {
+            emitResult(static_cast<int>(KListOpenFilesJob::Error::NotSupported), QObject::tr("Scanning /proc is only supported on Linux"));
+        },
+        Qt::QueuedConnection);
+#endif
+}
+
+void KListOpenFilesJobPrivate::stopProcScan()
+{
+    if (procScanThread) {
+        procScanCanceled = true;
+        procScanThread->wait();
+    }
+}
+
+void KListOpenFilesJobPrivate::addProcesses(const KProcessList::KProcessInfoList &processes)
+{
+    if (processes.isEmpty() || hasEmittedResult) {
+        return;
+    }
+    processInfoList += processes;
+    Q_EMIT job->processesFound(processes);
 }
 
 void KListOpenFilesJobPrivate::emitResult(int error, const QString &errorText)
@@ -114,9 +279,22 @@ void KListOpenFilesJobPrivate::emitResult(int error, const QString &errorText)
     hasEmittedResult = true;
 }
 
+bool KListOpenFilesJobPrivate::kill()
+{
+    // KJob takes care of finishing the job
+    hasEmittedResult = true;
+    stopProcScan();
+    if (lsofProcess.state() != QProcess::NotRunning) {
+        QObject::disconnect(&lsofProcess, nullptr, job, nullptr);
+        lsofProcess.kill();
+    }
+    return true;
+}
+
 KListOpenFilesJob::KListOpenFilesJob(const QString &path)
     : d(new KListOpenFilesJobPrivate(this, path))
 {
+    setCapabilities(Killable);
 }
 
 KListOpenFilesJob::~KListOpenFilesJob() = default;
@@ -131,4 +309,19 @@ KProcessList::KProcessInfoList KListOpenFilesJob::processInfoList() const
     return d->processInfoList;
 }
 
+void KListOpenFilesJob::setBackend(Backend backend)
+{
+    d->backend = backend;
+}
+
+KListOpenFilesJob::Backend KListOpenFilesJob::backend() const
+{
+    return d->backend;
+}
+
+bool KListOpenFilesJob::doKill()
+{
+    return d->kill();
+}
+
 #include "moc_klistopenfilesjob.cpp"
@@ -34,4 +34,18 @@ KProcessList::KProcessInfoList KListOpenFilesJob::processInfoList() const
     return KProcessList::KProcessInfoList();
 }
 
+void KListOpenFilesJob::setBackend(Backend)
+{
+}
+
+KListOpenFilesJob::Backend KListOpenFilesJob::backend() const
+{
+    return Backend::Lsof;
+}
+
+bool KListOpenFilesJob::doKill()
+{
+    return false;
+}
+
 #include "moc_klistopenfilesjob.cpp"
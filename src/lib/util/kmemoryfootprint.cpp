@@ -0,0 +1,23 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kmemoryfootprint_p.h"
+
+QList<KMemoryFootprint::Subsystem> KMemoryFootprint::subsystems()
+{
+    return {
+        KMemoryFootprintPrivate::pluginMetaData(),
+        KMemoryFootprintPrivate::dirWatch(),
+        KMemoryFootprintPrivate::networkMounts(),
+        KMemoryFootprintPrivate::sharedDataCache(),
+    };
+}
+
+void KMemoryFootprint::releaseCaches()
+{
+    KMemoryFootprintPrivate::releasePluginMetaData();
+    KMemoryFootprintPrivate::releaseNetworkMounts();
+}
@@ -0,0 +1,70 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KMEMORYFOOTPRINT_H
+#define KMEMORYFOOTPRINT_H
+
+#include <QList>
+#include <QString>
+
+#include <kcoreaddons_export.h>
+
+/**
+ * @brief Reports the memory held by KCoreAddons in the calling process, and releases what can be dropped.
+ *
+ * Meant for diagnostics and for enforcing memory budgets in long-running processes:
+ * @code
+ * for (const KMemoryFootprint::Subsystem &subsystem : KMemoryFootprint::subsystems()) {
+ *     qDebug() << subsystem.name << subsystem.objects << subsystem.bytes;
+ * }
+ * ...
+ * // on memory pressure
+ * KMemoryFootprint::releaseCaches();
+ * @endcode
+ *
+ * The plugin metadata cache and KDirWatch are not thread-safe, so both functions
+ * must be called from the thread using KPluginMetaData::findPlugins() and KDirWatch,
+ * usually the main thread. The KDirWatch instances of other threads aren't reported.
+ *
+ * @since 6.0
+ */
+namespace KMemoryFootprint
+{
+/**
+ * @brief The memory held by one subsystem
+ * @since 6.0
+ */
+struct Subsystem {
+    /// The class the memory belongs to, e.g. "KDirWatch"
+    QString name;
+    /// The number of objects held, what these are depends on the subsystem,
+    /// e.g. the watched paths of KDirWatch or the shared memory mappings of KSharedDataCache
+    qsizetype objects = 0;
+    /// About the number of bytes the objects take, without the overhead of the allocator
+    qint64 bytes = 0;
+    /// Whether releaseCaches() drops the objects
+    bool discardable = false;
+};
+
+/**
+ * @returns the memory held by every subsystem of KCoreAddons, even those holding nothing right now:
+ * @li "KPluginMetaData", the metadata cached by KPluginMetaData::findPlugins() with KPluginMetaData::CacheMetaData
+ * @li "KDirWatch", the watched files and directories
+ * @li "KNetworkMounts", the resolved symlinks cached by KNetworkMounts::canonicalSymlinkPath()
+ * @li "KSharedDataCache", the shared memory mapped by the caches of this process, which
+ * counts towards the memory of every process mapping it
+ */
+KCOREADDONS_EXPORT QList<Subsystem> subsystems();
+
+/**
+ * Drops the objects of the @ref Subsystem::discardable subsystems, which are
+ * looked up again when needed.
+ */
+KCOREADDONS_EXPORT void releaseCaches();
+
+} // namespace KMemoryFootprint
+
+#endif
@@ -0,0 +1,33 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KMEMORYFOOTPRINT_P_H
+#define KMEMORYFOOTPRINT_P_H
+
+#include "kmemoryfootprint.h"
+
+// Implemented next to the data of each subsystem
+namespace KMemoryFootprintPrivate
+{
+// kpluginmetadata.cpp
+KMemoryFootprint::Subsystem pluginMetaData();
+void releasePluginMetaData();
+// kdirwatch.cpp
+KMemoryFootprint::Subsystem dirWatch();
+// knetworkmounts.cpp
+KMemoryFootprint::Subsystem networkMounts();
+void releaseNetworkMounts();
+// kshareddatacache.cpp
+KMemoryFootprint::Subsystem sharedDataCache();
+
+// About the memory of the characters of @p string, if not shared
+inline qint64 stringBytes(const QString &string)
+{
+    return string.capacity() * qint64(sizeof(QChar));
+}
+}
+
+#endif
@@ -9,6 +9,9 @@
 
 #include <QLoggingCategory>
 #include <QSharedData>
+#include <QSocketNotifier>
+
+#include <limits>
 
 Q_DECLARE_LOGGING_CATEGORY(LOG_KMEMORYINFO)
 Q_LOGGING_CATEGORY(LOG_KMEMORYINFO, "kf.coreaddons.kmemoryinfo", QtWarningMsg)
@@ -18,13 +21,15 @@ Q_LOGGING_CATEGORY(LOG_KMEMORYINFO, "kf.coreaddons.kmemoryinfo", QtWarningMsg)
     #include <windows.h>    // Windows.h must stay above Pspapi.h
     #include <psapi.h>
 #elif defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
-    #include <QByteArray>
-    #include <QFile>
     #include <QByteArrayView>
+    #include <QVarLengthArray>
+    #include <fcntl.h>
+    #include <unistd.h>
 #elif defined(Q_OS_MACOS)
     #include <mach/mach.h>
     #include <sys/sysctl.h>
 #elif defined(Q_OS_FREEBSD)
+    #include <QMutex>
     #include <fcntl.h>
     #include <kvm.h>
     #include <sys/sysctl.h>
@@ -45,6 +50,10 @@ public:
     quint64 m_freeSwapFile = 0;
     quint64 m_cached = 0;
     quint64 m_buffers = 0;
+    // only set where control groups are supported, the physical values apply otherwise
+    bool m_hasEffectiveValues = false;
+    quint64 m_effectiveTotalPhysical = 0;
+    quint64 m_effectiveAvailablePhysical = 0;
 };
 
 KMemoryInfo::KMemoryInfo()
@@ -53,6 +62,11 @@ KMemoryInfo::KMemoryInfo()
     update();
 }
 
+KMemoryInfo::KMemoryInfo(KMemoryInfoPrivate *dd)
+    : d(dd)
+{
+}
+
 KMemoryInfo::~KMemoryInfo()
 {
 }
@@ -80,7 +94,9 @@ bool KMemoryInfo::operator==(const KMemoryInfo &other) const
             && d->m_cached == other.d->m_cached
             && d->m_buffers == other.d->m_buffers
             && d->m_totalSwapFile == other.d->m_totalSwapFile
-            && d->m_totalPhysical == other.d->m_totalPhysical);
+            && d->m_totalPhysical == other.d->m_totalPhysical
+            && effectiveTotalPhysical() == other.effectiveTotalPhysical()
+            && effectiveAvailablePhysical() == other.effectiveAvailablePhysical());
     // clang-format on
 }
 
@@ -109,6 +125,16 @@ quint64 KMemoryInfo::availablePhysical() const
     return d->m_availablePhysical;
 }
 
+quint64 KMemoryInfo::effectiveTotalPhysical() const
+{
+    return d->m_hasEffectiveValues ? d->m_effectiveTotalPhysical : d->m_totalPhysical;
+}
+
+quint64 KMemoryInfo::effectiveAvailablePhysical() const
+{
+    return d->m_hasEffectiveValues ? d->m_effectiveAvailablePhysical : d->m_availablePhysical;
+}
+
 quint64 KMemoryInfo::cached() const
 {
     return d->m_cached;
@@ -129,6 +155,47 @@ quint64 KMemoryInfo::freeSwapFile() const
     return d->m_freeSwapFile;
 }
 
+#if defined(Q_OS_MACOS) || defined(Q_OS_FREEBSD)
+/*****************************************************************************
+ * sysctl, shared by macOS and FreeBSD
+ ****************************************************************************/
+
+/**
+ * A sysctl variable read by its name, which is resolved to its MIB once,
+ * instead of on every read like sysctlbyname() does. Meant to be kept in a
+ * static variable, so that sampling the memory often stays cheap.
+ *
+ * A name that doesn't exist, e.g. of a module loaded later, isn't looked up again.
+ */
+class SysctlVariable
+{
+public:
+    explicit SysctlVariable(const char *name)
+    {
+        size_t length = CTL_MAXNAME;
+        if (sysctlnametomib(name, m_mib, &length) == 0) {
+            m_length = u_int(length);
+        }
+    }
+
+    template<class T>
+    bool read(T &var) const
+    {
+        if (m_length == 0) {
+            return false;
+        }
+        auto sz = sizeof(var);
+        // not modified, only some systems declare the MIB as const
+        return sysctl(const_cast<int *>(m_mib), m_length, &var, &sz, NULL, 0) == 0;
+    }
+
+private:
+    int m_mib[CTL_MAXNAME] = {};
+    u_int m_length = 0;
+};
+
+#endif
+
 #if defined(Q_OS_WINDOWS)
 /*****************************************************************************
  * Windows
@@ -185,87 +252,186 @@ bool KMemoryInfo::update()
  * GNU/Linux
  ****************************************************************************/
 
-using ByteArrayView = QByteArrayView;
-
-bool extractBytes(quint64 &value, const QByteArray &buffer, const ByteArrayView &beginPattern, qsizetype &from)
+// Parses the contents of /proc/meminfo, which are lines of "<key>: <value> kB",
+// in one pass
+static bool parseMeminfo(QByteArrayView meminfo, KMemoryInfoPrivate &d)
 {
-    ByteArrayView endPattern("kB");
-    auto beginIdx = buffer.indexOf(beginPattern, from);
-    if (beginIdx > -1) {
-        auto start = beginIdx + beginPattern.size();
-        auto endIdx = buffer.indexOf(endPattern, start);
-        if (endIdx > -1) {
-            from = endIdx + endPattern.size();
-            auto ok = false;
-            value = buffer.mid(start, endIdx - start).toULongLong(&ok) * 1024;
-            return ok;
+    enum Key { MemTotal, MemFree, MemAvailable, Buffers, Cached, SwapTotal, SwapFree, Shmem, SReclaimable, KeyCount };
+    static constexpr QByteArrayView keys[KeyCount] = {
+        "MemTotal",
+        "MemFree",
+        "MemAvailable",
+        "Buffers",
+        "Cached",
+        "SwapTotal",
+        "SwapFree",
+        "Shmem",
+        "SReclaimable",
+    };
+
+    quint64 values[KeyCount] = {};
+    int found = 0;
+    while (!meminfo.isEmpty() && found != (1 << KeyCount) - 1) {
+        qsizetype lineEnd = meminfo.indexOf('\n');
+        if (lineEnd < 0) {
+            lineEnd = meminfo.size();
         }
+        const QByteArrayView line = meminfo.first(lineEnd);
+        meminfo = meminfo.sliced(qMin(lineEnd + 1, meminfo.size()));
+
+        const qsizetype colon = line.indexOf(':');
+        if (colon < 0) {
+            continue;
+        }
+        const QByteArrayView key = line.first(colon);
+        const auto it = std::find_if(std::begin(keys), std::end(keys), [key](QByteArrayView candidate) {
+            return key.compare(candidate) == 0;
+        });
+        if (it == std::end(keys)) {
+            continue;
+        }
+
+        const QByteArrayView value = line.sliced(colon + 1).trimmed();
+        if (!value.endsWith("kB")) {
+            return false;
+        }
+        bool ok = false;
+        values[it - std::begin(keys)] = value.chopped(2).trimmed().toULongLong(&ok) * 1024;
+        if (!ok) {
+            return false;
+        }
+        found |= 1 << (it - std::begin(keys));
     }
-    if (from) { // Wrong order? Restart from the beginning
-        qCWarning(LOG_KMEMORYINFO) << "KMemoryInfo: extractBytes: wrong order when extracting" << beginPattern;
-        from = 0;
-        return extractBytes(value, buffer, beginPattern, from);
+    if (found != (1 << KeyCount) - 1) {
+        qCWarning(LOG_KMEMORYINFO) << "KMemoryInfo: parseMeminfo: missing values in /proc/meminfo";
+        return false;
     }
-    return false;
+
+    // Source HTOP: https://github.com/htop-dev/htop/blob/main/linux/LinuxProcessList.c
+    d.m_totalPhysical = values[MemTotal];
+    // NOTE: another viable solution: d.m_availablePhysical = std::min(availPhys, totalPhys - (committedAs - cached - (swapTotal - swapFree)))
+    d.m_availablePhysical = values[MemAvailable] ? std::min(values[MemAvailable], values[MemTotal]) : values[MemFree];
+    d.m_freePhysical = values[MemFree];
+    d.m_totalSwapFile = values[SwapTotal];
+    d.m_freeSwapFile = values[SwapFree];
+    d.m_cached = values[Cached] + values[SReclaimable] - values[Shmem];
+    d.m_buffers = values[Buffers];
+
+    return true;
 }
 
-bool KMemoryInfo::update()
+// Reads all of @p fd from the start into @p buffer
+static bool preadAll(int fd, QVarLengthArray<char, 4096> &buffer)
 {
-    QFile file(QStringLiteral("/proc/meminfo"));
-    if (!file.open(QFile::ReadOnly)) {
-        return false;
+    buffer.resize(0);
+    for (;;) {
+        if (buffer.size() == buffer.capacity()) {
+            buffer.reserve(buffer.capacity() * 2);
+        }
+        const qsizetype size = buffer.size();
+        buffer.resize(buffer.capacity());
+        const ssize_t bytesRead = ::pread(fd, buffer.data() + size, buffer.size() - size, size);
+        buffer.resize(size + qMax<ssize_t>(bytesRead, 0));
+        if (bytesRead <= 0) {
+            return bytesRead == 0;
+        }
     }
-    auto meminfo = file.readAll();
-    file.close();
+}
 
-    qsizetype miFrom = 0;
-    quint64 totalPhys = 0;
-    if (!extractBytes(totalPhys, meminfo, "MemTotal:", miFrom)) {
-        return false;
+// The directory of the control group of the process in the unified (v2)
+// hierarchy, from "0::<path>" in /proc/self/cgroup, e.g.
+// "/sys/fs/cgroup/user.slice/user-1000.slice/session-2.scope"
+static QByteArray cgroupDirectory()
+{
+    const int fd = ::open("/proc/self/cgroup", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return QByteArray();
     }
-    quint64 freePhys = 0;
-    if (!extractBytes(freePhys, meminfo, "MemFree:", miFrom)) {
-        return false;
+    QVarLengthArray<char, 4096> buffer;
+    const bool read = preadAll(fd, buffer);
+    ::close(fd);
+
+    const QByteArrayView cgroups(buffer.constData(), buffer.size());
+    const qsizetype start = cgroups.indexOf("0::");
+    if (!read || start < 0 || (start > 0 && cgroups.at(start - 1) != '\n')) {
+        return QByteArray();
     }
-    quint64 availPhys = 0;
-    if (!extractBytes(availPhys, meminfo, "MemAvailable:", miFrom)) {
-        return false;
+    QByteArrayView path = cgroups.sliced(start + 3);
+    const qsizetype pathEnd = path.indexOf('\n');
+    if (pathEnd >= 0) {
+        path = path.first(pathEnd);
     }
-    quint64 buffers = 0;
-    if (!extractBytes(buffers, meminfo, "Buffers:", miFrom)) {
-        return false;
+    while (path.endsWith('/')) {
+        path.chop(1);
     }
-    quint64 cached = 0;
-    if (!extractBytes(cached, meminfo, "Cached:", miFrom)) {
+    return "/sys/fs/cgroup" + path.toByteArray();
+}
+
+// Reads a value of a cgroup memory controller file, where "max" means no limit
+static bool readCgroupValue(const QByteArray &fileName, quint64 &value)
+{
+    const int fd = ::open(fileName.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return false;
     }
-    quint64 swapTotal = 0;
-    if (!extractBytes(swapTotal, meminfo, "SwapTotal:", miFrom)) {
+    char buffer[32];
+    const ssize_t size = ::read(fd, buffer, sizeof(buffer));
+    ::close(fd);
+    if (size <= 0) {
         return false;
     }
-    quint64 swapFree = 0;
-    if (!extractBytes(swapFree, meminfo, "SwapFree:", miFrom)) {
-        return false;
+    const QByteArrayView content = QByteArrayView(buffer, size).trimmed();
+    if (content.compare("max") == 0) {
+        value = std::numeric_limits<quint64>::max();
+        return true;
     }
-    quint64 sharedMem = 0;
-    if (!extractBytes(sharedMem, meminfo, "Shmem:", miFrom)) {
-        return false;
+    bool ok = false;
+    value = content.toULongLong(&ok);
+    return ok;
+}
+
+// Limits the effective values to what memory.max and memory.high of the control
+// group of the process and of its parents leave
+static void readCgroupLimits(KMemoryInfoPrivate &d)
+{
+    d.m_hasEffectiveValues = true;
+    d.m_effectiveTotalPhysical = d.m_totalPhysical;
+    d.m_effectiveAvailablePhysical = d.m_availablePhysical;
+
+    const QByteArray root("/sys/fs/cgroup");
+    QByteArray directory = cgroupDirectory();
+    while (directory.startsWith(root)) {
+        quint64 max = std::numeric_limits<quint64>::max();
+        quint64 high = std::numeric_limits<quint64>::max();
+        readCgroupValue(directory + "/memory.max", max);
+        readCgroupValue(directory + "/memory.high", high);
+        const quint64 limit = std::min(max, high);
+        quint64 current = 0;
+        if (limit != std::numeric_limits<quint64>::max() && readCgroupValue(directory + "/memory.current", current)) {
+            d.m_effectiveTotalPhysical = std::min(d.m_effectiveTotalPhysical, limit);
+            d.m_effectiveAvailablePhysical = std::min(d.m_effectiveAvailablePhysical, limit > current ? limit - current : 0);
+        }
+        if (directory.size() == root.size()) {
+            break;
+        }
+        directory.truncate(directory.lastIndexOf('/'));
     }
-    quint64 sReclaimable = 0;
-    if (!extractBytes(sReclaimable, meminfo, "SReclaimable:", miFrom)) {
+}
+
+bool KMemoryInfo::update()
+{
+    const int fd = ::open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         return false;
     }
+    QVarLengthArray<char, 4096> meminfo;
+    const bool read = preadAll(fd, meminfo);
+    ::close(fd);
 
-    // Source HTOP: https://github.com/htop-dev/htop/blob/main/linux/LinuxProcessList.c
-    d->m_totalPhysical = totalPhys;
-    // NOTE: another viable solution: d->m_availablePhysical = std::min(availPhys, totalPhys - (committedAs - cached - (swapTotal - swapFree)))
-    d->m_availablePhysical = availPhys ? std::min(availPhys, totalPhys) : freePhys;
-    d->m_freePhysical = freePhys;
-    d->m_totalSwapFile = swapTotal;
-    d->m_freeSwapFile = swapFree;
-    d->m_cached = cached + sReclaimable - sharedMem;
-    d->m_buffers = buffers;
-
+    if (!read || !parseMeminfo(QByteArrayView(meminfo.constData(), meminfo.size()), *d)) {
+        return false;
+    }
+    readCgroupLimits(*d);
     return true;
 }
 
@@ -274,13 +440,6 @@ bool KMemoryInfo::update()
  * macOS
  ****************************************************************************/
 
-template<class T>
-bool sysctlread(const char *name, T &var)
-{
-    auto sz = sizeof(var);
-    return (sysctlbyname(name, &var, &sz, NULL, 0) == 0);
-}
-
 bool KMemoryInfo::update()
 {
     quint64 memSize = 0;
@@ -311,14 +470,17 @@ bool KMemoryInfo::update()
         return false;
     }
 
+    static const SysctlVariable arcstatsSize("kstat.zfs.misc.arcstats.size");
     quint64 zfs_arcstats_size = 0;
-    if (!sysctlread("kstat.zfs.misc.arcstats.size", zfs_arcstats_size)) {
+    if (!arcstatsSize.read(zfs_arcstats_size)) {
         zfs_arcstats_size = 0; // no ZFS used
     }
 
+    // Every call of mach_host_self() adds a reference to the port
+    static const mach_port_t host = mach_host_self();
     mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
     vm_statistics64_data_t vmstat;
-    if (host_statistics64(mach_host_self(), HOST_VM_INFO64, (host_info64_t)&vmstat, &count) != KERN_SUCCESS) {
+    if (host_statistics64(host, HOST_VM_INFO64, (host_info64_t)&vmstat, &count) != KERN_SUCCESS) {
         return false;
     }
 
@@ -338,11 +500,25 @@ bool KMemoryInfo::update()
  * FreeBSD
  ****************************************************************************/
 
-template<class T>
-bool sysctlread(const char *name, T &var)
+// The totals of all swap devices, in pages. The kvm handle is opened once and,
+// as it isn't thread-safe, used by one thread at a time.
+static bool readSwapPages(quint64 &total, quint64 &used)
 {
-    auto sz = sizeof(var);
-    return (sysctlbyname(name, &var, &sz, NULL, 0) == 0);
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+    static kvm_t *const kd = kvm_open("/dev/null", "/dev/null", "/dev/null", O_RDONLY, "kvm_open");
+    if (!kd) {
+        return false;
+    }
+    struct kvm_swap swap;
+    // if you specify a maxswap value of 1, the function will typically return the
+    // value 0 and the single kvm_swap structure will be filled with the grand total over all swap devices.
+    if (kvm_getswapinfo(kd, &swap, 1, 0) != 0) {
+        return false;
+    }
+    total = swap.ksw_total;
+    used = swap.ksw_used;
+    return true;
 }
 
 bool KMemoryInfo::update()
@@ -367,43 +543,43 @@ bool KMemoryInfo::update()
         return false;
     }
 
+    static const SysctlVariable pageSizeVariable("vm.stats.vm.v_page_size");
+    static const SysctlVariable arcstatsSize("kstat.zfs.misc.arcstats.size");
+    static const SysctlVariable cacheCount("vm.stats.vm.v_cache_count");
+    static const SysctlVariable inactiveCount("vm.stats.vm.v_inactive_count");
+    static const SysctlVariable freeCount("vm.stats.vm.v_free_count");
+    static const SysctlVariable bufspace("vfs.bufspace");
+
     quint32 v_pageSize = 0;
-    if (sysctlread("vm.stats.vm.v_page_size", v_pageSize)) {
+    if (pageSizeVariable.read(v_pageSize)) {
         pageSize = v_pageSize;
     }
     quint64 zfs_arcstats_size = 0;
-    if (!sysctlread("kstat.zfs.misc.arcstats.size", zfs_arcstats_size)) {
+    if (!arcstatsSize.read(zfs_arcstats_size)) {
         zfs_arcstats_size = 0; // no ZFS used
     }
     quint32 v_cache_count = 0;
-    if (!sysctlread("vm.stats.vm.v_cache_count", v_cache_count)) {
+    if (!cacheCount.read(v_cache_count)) {
         return false;
     }
     quint32 v_inactive_count = 0;
-    if (!sysctlread("vm.stats.vm.v_inactive_count", v_inactive_count)) {
+    if (!inactiveCount.read(v_inactive_count)) {
         return false;
     }
     quint32 v_free_count = 0;
-    if (!sysctlread("vm.stats.vm.v_free_count", v_free_count)) {
+    if (!freeCount.read(v_free_count)) {
         return false;
     }
     quint64 vfs_bufspace = 0;
-    if (!sysctlread("vfs.bufspace", vfs_bufspace)) {
+    if (!bufspace.read(vfs_bufspace)) {
         return false;
     }
 
     quint64 swap_tot = 0;
+    quint64 swap_used = 0;
     quint64 swap_free = 0;
-    if (auto kd = kvm_open("/dev/null", "/dev/null", "/dev/null", O_RDONLY, "kvm_open")) {
-        struct kvm_swap swap;
-        // if you specify a maxswap value of 1, the function will typically return the
-        // value 0 and the single kvm_swap structure will be filled with the grand total over all swap devices.
-        auto nswap = kvm_getswapinfo(kd, &swap, 1, 0);
-        if (nswap == 0) {
-            swap_tot = swap.ksw_total;
-            swap_free = swap.ksw_used;
-        }
-        swap_free = (swap_tot - swap_free) * pageSize;
+    if (readSwapPages(swap_tot, swap_used)) {
+        swap_free = (swap_tot - swap_used) * pageSize;
         swap_tot *= pageSize;
     }
 
@@ -431,3 +607,175 @@ bool KMemoryInfo::update()
 }
 
 #endif
+
+/*****************************************************************************
+ * KMemoryInfoSampler
+ ****************************************************************************/
+
+class KMemoryInfoSamplerPrivate
+{
+public:
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+    ~KMemoryInfoSamplerPrivate()
+    {
+        stopPressureMonitoring();
+        if (meminfoFd >= 0) {
+            ::close(meminfoFd);
+        }
+    }
+
+    bool startPressureMonitoring();
+    void stopPressureMonitoring();
+    bool hasCgroupEvents();
+
+    int meminfoFd = -1;
+    QVarLengthArray<char, 4096> buffer;
+
+    // Either a pressure stall information trigger, or the memory.events file
+    // of the control group
+    int pressureFd = -1;
+    bool isCgroupEvents = false;
+    quint64 cgroupEventCount = 0;
+#endif
+    QSocketNotifier *pressureNotifier = nullptr;
+};
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+// The sum of the counters in memory.events that mean pressure: "high", "max",
+// "oom" and "oom_kill"
+static quint64 cgroupEventCount(QByteArrayView events)
+{
+    quint64 count = 0;
+    while (!events.isEmpty()) {
+        qsizetype lineEnd = events.indexOf('\n');
+        if (lineEnd < 0) {
+            lineEnd = events.size();
+        }
+        const QByteArrayView line = events.first(lineEnd);
+        events = events.sliced(qMin(lineEnd + 1, events.size()));
+
+        const qsizetype space = line.indexOf(' ');
+        if (space < 0) {
+            continue;
+        }
+        const QByteArrayView key = line.first(space);
+        if (key.compare("high") == 0 || key.compare("max") == 0 || key.compare("oom") == 0 || key.compare("oom_kill") == 0) {
+            count += line.sliced(space + 1).trimmed().toULongLong();
+        }
+    }
+    return count;
+}
+
+bool KMemoryInfoSamplerPrivate::startPressureMonitoring()
+{
+    // Notify when tasks were stalled on memory for 150ms within 2s, the
+    // shortest window unprivileged processes may use
+    pressureFd = ::open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (pressureFd >= 0) {
+        static const char trigger[] = "some 150000 2000000";
+        if (::write(pressureFd, trigger, sizeof(trigger)) >= 0) {
+            isCgroupEvents = false;
+            return true;
+        }
+        ::close(pressureFd);
+    }
+
+    // Fall back to the events of the control group
+    pressureFd = -1;
+    const QByteArray directory = cgroupDirectory();
+    if (directory.isEmpty()) {
+        return false;
+    }
+    pressureFd = ::open(QByteArray(directory + "/memory.events").constData(), O_RDONLY | O_CLOEXEC);
+    if (pressureFd < 0) {
+        return false;
+    }
+    isCgroupEvents = true;
+    hasCgroupEvents();
+    return true;
+}
+
+void KMemoryInfoSamplerPrivate::stopPressureMonitoring()
+{
+    delete pressureNotifier;
+    pressureNotifier = nullptr;
+    if (pressureFd >= 0) {
+        ::close(pressureFd);
+        pressureFd = -1;
+    }
+}
+
+// Reading memory.events again also rearms the notification
+bool KMemoryInfoSamplerPrivate::hasCgroupEvents()
+{
+    if (!preadAll(pressureFd, buffer)) {
+        return false;
+    }
+    const quint64 count = cgroupEventCount(QByteArrayView(buffer.constData(), buffer.size()));
+    const bool changed = count > cgroupEventCount;
+    cgroupEventCount = count;
+    return changed;
+}
+#endif
+
+KMemoryInfoSampler::KMemoryInfoSampler(QObject *parent)
+    : QObject(parent)
+    , d(new KMemoryInfoSamplerPrivate)
+{
+}
+
+KMemoryInfoSampler::~KMemoryInfoSampler() = default;
+
+KMemoryInfo KMemoryInfoSampler::sample()
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+    if (d->meminfoFd < 0) {
+        d->meminfoFd = ::open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    }
+    // parseMeminfo() leaves it null on errors
+    auto *memoryInfo = new KMemoryInfoPrivate;
+    if (d->meminfoFd >= 0 && preadAll(d->meminfoFd, d->buffer) && parseMeminfo(QByteArrayView(d->buffer.constData(), d->buffer.size()), *memoryInfo)) {
+        readCgroupLimits(*memoryInfo);
+    }
+    return KMemoryInfo(memoryInfo);
+#else
+    return KMemoryInfo();
+#endif
+}
+
+bool KMemoryInfoSampler::startPressureMonitoring()
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+    if (d->pressureNotifier) {
+        return true;
+    }
+    if (!d->startPressureMonitoring()) {
+        qCDebug(LOG_KMEMORYINFO) << "KMemoryInfoSampler: memory pressure can't be monitored";
+        return false;
+    }
+    // Both pressure triggers and changed control group files are signaled as priority events
+    d->pressureNotifier = new QSocketNotifier(d->pressureFd, QSocketNotifier::Exception, this);
+    connect(d->pressureNotifier, &QSocketNotifier::activated, this, [this]() {
+        if (!d->isCgroupEvents || d->hasCgroupEvents()) {
+            Q_EMIT memoryPressure();
+        }
+    });
+    return true;
+#else
+    return false;
+#endif
+}
+
+void KMemoryInfoSampler::stopPressureMonitoring()
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+    d->stopPressureMonitoring();
+#endif
+}
+
+bool KMemoryInfoSampler::isMonitoringPressure() const
+{
+    return d->pressureNotifier;
+}
+
+#include "moc_kmemoryinfo.cpp"
@@ -8,11 +8,15 @@
 #ifndef KMEMORYINFO_H
 #define KMEMORYINFO_H
 
+#include <QObject>
 #include <QSharedDataPointer>
 
 #include <kcoreaddons_export.h>
 
+#include <memory>
+
 class KMemoryInfoPrivate;
+class KMemoryInfoSamplerPrivate;
 
 /**
  * @brief The KMemoryInfo class provides an interface to get memory information (RAM/SWAP).
@@ -96,6 +100,30 @@ public:
      */
     quint64 availablePhysical() const;
 
+    /**
+     * @brief effectiveTotalPhysical
+     *
+     * The RAM the process may use at most. This is the total system RAM, unless the process is
+     * limited to less by the @c memory.max or @c memory.high limits of its control group or of
+     * one of its parents (Linux, cgroup v2), e.g. in a container or a systemd slice.
+     * @note Use this rather than totalPhysical() for sizing caches and the like.
+     * @return The RAM available to the process at most in bytes.
+     * @sa effectiveAvailablePhysical.
+     * @since 6.0
+     */
+    quint64 effectiveTotalPhysical() const;
+
+    /**
+     * @brief effectiveAvailablePhysical
+     *
+     * The available memory as reported by availablePhysical(), unless less than that is left
+     * below the limits of the control group of the process.
+     * @return The memory available to the process in bytes.
+     * @sa effectiveTotalPhysical.
+     * @since 6.0
+     */
+    quint64 effectiveAvailablePhysical() const;
+
     /**
      * @brief cached
      * @return The size of RAM used as cache in bytes.
@@ -122,6 +150,9 @@ public:
     quint64 freeSwapFile() const;
 
 private:
+    friend class KMemoryInfoSampler;
+    KCOREADDONS_NO_EXPORT explicit KMemoryInfo(KMemoryInfoPrivate *dd);
+
     /**
      * @brief update Refresh the memory information.
      * @return @c true on success, otherwise @c false.
@@ -131,4 +162,70 @@ private:
     QSharedDataPointer<KMemoryInfoPrivate> d;
 };
 
+/**
+ * @brief The KMemoryInfoSampler class takes snapshots of the state of the memory repeatedly,
+ * and notifies about memory pressure.
+ *
+ * Keep an instance around to poll the memory information regularly, it keeps what it
+ * needs for that open between the samples.
+ * \code
+ * KMemoryInfoSampler sampler;
+ * connect(&sampler, &KMemoryInfoSampler::memoryPressure, this, &MyCache::shrink);
+ * sampler.startPressureMonitoring();
+ * ...
+ * const KMemoryInfo memInfo = sampler.sample();
+ * \endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KMemoryInfoSampler : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief KMemoryInfoSampler
+     * Constructs a sampler, which doesn't monitor memory pressure yet.
+     */
+    explicit KMemoryInfoSampler(QObject *parent = nullptr);
+    ~KMemoryInfoSampler() override;
+
+    /**
+     * @brief sample
+     * @return A snapshot of the current state of the memory, a null KMemoryInfo if an error occurs.
+     */
+    KMemoryInfo sample();
+
+    /**
+     * @brief startPressureMonitoring
+     * Starts emitting memoryPressure(). On Linux this uses a pressure stall information
+     * trigger where possible, or else the events of the memory control group of the
+     * process. It is not supported on other platforms.
+     * @return @c true if memory pressure is being monitored, otherwise @c false.
+     */
+    bool startPressureMonitoring();
+
+    /**
+     * @brief stopPressureMonitoring
+     * Stops emitting memoryPressure().
+     */
+    void stopPressureMonitoring();
+
+    /**
+     * @brief isMonitoringPressure
+     * @return @c true if memoryPressure() is emitted, otherwise @c false.
+     */
+    bool isMonitoringPressure() const;
+
+Q_SIGNALS:
+    /**
+     * @brief memoryPressure
+     * Emitted when the system or the control group of the process is short of memory,
+     * e.g. for freeing caches.
+     */
+    void memoryPressure();
+
+private:
+    std::unique_ptr<KMemoryInfoSamplerPrivate> const d;
+};
+
 #endif // KMEMORYINFO_H
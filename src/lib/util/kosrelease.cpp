@@ -48,17 +48,6 @@ static void setVar(QStringList *var, const QString &value)
     *var = args;
 }
 
-static QStringList splitEntry(const QString &line)
-{
-    QStringList list;
-    const int separatorIndex = line.indexOf(QLatin1Char('='));
-    list << line.mid(0, separatorIndex);
-    if (separatorIndex != -1) {
-        list << line.mid(separatorIndex + 1, -1);
-    }
-    return list;
-}
-
 static QString defaultFilePath()
 {
     if (QFile::exists(QStringLiteral("/etc/os-release"))) {
@@ -80,25 +69,6 @@ public:
     {
         // Default values for non-optional fields set above ^.
 
-        QHash<QString, QString *> stringHash = {{QStringLiteral("NAME"), &name},
-                                                {QStringLiteral("VERSION"), &version},
-                                                {QStringLiteral("ID"), &id},
-                                                // idLike is not a QString, special handling below!
-                                                {QStringLiteral("VERSION_CODENAME"), &versionCodename},
-                                                {QStringLiteral("VERSION_ID"), &versionId},
-                                                {QStringLiteral("PRETTY_NAME"), &prettyName},
-                                                {QStringLiteral("ANSI_COLOR"), &ansiColor},
-                                                {QStringLiteral("CPE_NAME"), &cpeName},
-                                                {QStringLiteral("HOME_URL"), &homeUrl},
-                                                {QStringLiteral("DOCUMENTATION_URL"), &documentationUrl},
-                                                {QStringLiteral("SUPPORT_URL"), &supportUrl},
-                                                {QStringLiteral("BUG_REPORT_URL"), &bugReportUrl},
-                                                {QStringLiteral("PRIVACY_POLICY_URL"), &privacyPolicyUrl},
-                                                {QStringLiteral("BUILD_ID"), &buildId},
-                                                {QStringLiteral("VARIANT"), &variant},
-                                                {QStringLiteral("VARIANT_ID"), &variantId},
-                                                {QStringLiteral("LOGO"), &logo}};
-
         if (filePath.isEmpty()) {
             filePath = defaultFilePath();
         }
@@ -114,31 +84,36 @@ public:
         // TODO: it might still be handy to indicate to the outside whether
         //       fallback values are being used or not.
         file.open(QIODevice::ReadOnly | QIODevice::Text);
-        QString line;
-        QStringList parts;
-        while (!file.atEnd()) {
+        // The file is tiny, read it at once and look at the lines in place
+        const QByteArray data = file.readAll();
+        qsizetype start = 0;
+        while (start < data.size()) {
+            qsizetype end = data.indexOf('\n', start);
+            if (end < 0) {
+                end = data.size();
+            }
             // Trimmed to handle indented comment lines properly
-            line = QString::fromLatin1(file.readLine()).trimmed();
+            const QByteArrayView line = QByteArrayView(data).sliced(start, end - start).trimmed();
+            start = end + 1;
 
-            if (line.startsWith(QLatin1Char('#'))) {
+            if (line.isEmpty() || line.startsWith('#')) {
                 // Comment line
                 // Lines beginning with "#" shall be ignored as comments.
                 continue;
             }
 
-            parts = splitEntry(line);
-
-            if (parts.size() != 2) {
+            const qsizetype separatorIndex = line.indexOf('=');
+            if (separatorIndex == -1) {
                 // Line has no =, must be invalid.
                 qCDebug(KCOREADDONS_DEBUG) << "Unexpected/invalid os-release line:" << line;
                 continue;
             }
 
-            QString key = parts.at(0);
-            QString value = parts.at(1).trimmed();
+            const QLatin1String key(line.first(separatorIndex));
+            const QString value = QString::fromLatin1(line.sliced(separatorIndex + 1).trimmed());
 
-            if (QString *var = stringHash.value(key, nullptr)) {
-                setVar(var, value);
+            if (QString KOSReleasePrivate::*var = stringField(key)) {
+                setVar(&(this->*var), value);
                 continue;
             }
 
@@ -156,6 +131,36 @@ public:
         }
     }
 
+    static QString KOSReleasePrivate::*stringField(QLatin1String key)
+    {
+        // idLike is not a QString, special handling in the constructor!
+        static const std::pair<QLatin1String, QString KOSReleasePrivate::*> fields[] = {
+            {QLatin1String("NAME"), &KOSReleasePrivate::name},
+            {QLatin1String("VERSION"), &KOSReleasePrivate::version},
+            {QLatin1String("ID"), &KOSReleasePrivate::id},
+            {QLatin1String("VERSION_CODENAME"), &KOSReleasePrivate::versionCodename},
+            {QLatin1String("VERSION_ID"), &KOSReleasePrivate::versionId},
+            {QLatin1String("PRETTY_NAME"), &KOSReleasePrivate::prettyName},
+            {QLatin1String("ANSI_COLOR"), &KOSReleasePrivate::ansiColor},
+            {QLatin1String("CPE_NAME"), &KOSReleasePrivate::cpeName},
+            {QLatin1String("HOME_URL"), &KOSReleasePrivate::homeUrl},
+            {QLatin1String("DOCUMENTATION_URL"), &KOSReleasePrivate::documentationUrl},
+            {QLatin1String("SUPPORT_URL"), &KOSReleasePrivate::supportUrl},
+            {QLatin1String("BUG_REPORT_URL"), &KOSReleasePrivate::bugReportUrl},
+            {QLatin1String("PRIVACY_POLICY_URL"), &KOSReleasePrivate::privacyPolicyUrl},
+            {QLatin1String("BUILD_ID"), &KOSReleasePrivate::buildId},
+            {QLatin1String("VARIANT"), &KOSReleasePrivate::variant},
+            {QLatin1String("VARIANT_ID"), &KOSReleasePrivate::variantId},
+            {QLatin1String("LOGO"), &KOSReleasePrivate::logo},
+        };
+        for (const auto &[fieldKey, field] : fields) {
+            if (fieldKey == key) {
+                return field;
+            }
+        }
+        return nullptr;
+    }
+
     QString name;
     QString version;
     QString id;
@@ -185,6 +190,12 @@ KOSRelease::KOSRelease(const QString &filePath)
 
 KOSRelease::~KOSRelease() = default;
 
+const KOSRelease &KOSRelease::system()
+{
+    static const KOSRelease s_system;
+    return s_system;
+}
+
 QString KOSRelease::name() const
 {
     return d->name;
@@ -29,7 +29,8 @@ class KCOREADDONS_EXPORT KOSRelease final
 public:
     /**
      * Constructs a new OSRelease instance. Parsing happens in the constructor
-     * and the data is not cached across instances.
+     * and the data is not cached across instances. Use system() to share the
+     * information about the running system.
      *
      * @note The format specification makes no assertions about trailing #
      *   comments being supported. They result in undefined behavior.
@@ -41,6 +42,17 @@ public:
     explicit KOSRelease(const QString &filePath = QString());
     ~KOSRelease();
 
+    /**
+     * The os-release information of the running system, as found in the
+     * default file.
+     *
+     * The file is only parsed the first time this is called, all callers in
+     * the process share the result.
+     *
+     * @since 6.0
+     */
+    static const KOSRelease &system();
+
     /** @see https://www.freedesktop.org/software/systemd/man/os-release.html#NAME= */
     QString name() const;
     /** @see https://www.freedesktop.org/software/systemd/man/os-release.html#VERSION= */
@@ -0,0 +1,75 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KPARALLEL_P_H
+#define KPARALLEL_P_H
+
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <atomic>
+
+/**
+ * Spreading work over the idle threads of the global thread pool.
+ *
+ * Helpers are only started on threads of the pool that are idle, so that
+ * waiting for them can't block if the calling thread is part of the pool
+ * itself. Without any idle threads all of the work is left to the calling
+ * thread.
+ *
+ * Threads writing to different elements of an implicitly shared container
+ * must not detach it concurrently, so take its data() pointer beforehand.
+ */
+namespace KParallel
+{
+/**
+ * Calls @p helperWork on up to @p threadCount - 1 idle threads of the pool,
+ * passing it the number of its helper from 1 on, and @p callerWork on the
+ * calling thread. Returns once all of them returned.
+ */
+template<typename HelperWork, typename CallerWork>
+void run(int threadCount, const HelperWork &helperWork, const CallerWork &callerWork)
+{
+    QSemaphore helpersDone;
+    int helperCount = 0;
+    QThreadPool *pool = QThreadPool::globalInstance();
+    for (int i = 1; i < threadCount; ++i) {
+        const bool started = pool->tryStart([&helperWork, &helpersDone, i]() {
+            helperWork(i);
+            helpersDone.release();
+        });
+        if (!started) {
+            break;
+        }
+        ++helperCount;
+    }
+    callerWork();
+    helpersDone.acquire(helperCount);
+}
+
+/**
+ * Calls a worker for each index from 0 to @p count - 1. Every thread gets a
+ * worker of its own from @p makeWorker, which can keep its buffers, and takes
+ * the next index until none are left.
+ */
+template<typename MakeWorker>
+void forEachIndex(qsizetype count, const MakeWorker &makeWorker)
+{
+    std::atomic<qsizetype> next = 0;
+    const auto work = [&]() {
+        auto worker = makeWorker();
+        for (qsizetype i = next++; i < count; i = next++) {
+            worker(i);
+        }
+    };
+    const auto helperWork = [&work](int) {
+        work();
+    };
+    run(int(qMin<qsizetype>(count, QThreadPool::globalInstance()->maxThreadCount())), helperWork, work);
+}
+}
+
+#endif
@@ -10,6 +10,10 @@
 #include "kprocesslist.h"
 #include "kprocesslist_p.h"
 
+#include <QMap>
+
+#include <algorithm>
+
 using namespace KProcessList;
 
 KProcessInfoPrivate::KProcessInfoPrivate()
@@ -30,6 +34,7 @@ KProcessInfo::KProcessInfo(qint64 pid, const QString &command, const QString &na
     : d_ptr(new KProcessInfoPrivate)
 {
     d_ptr->valid = true;
+    d_ptr->fields = CommandField | UserField;
     d_ptr->pid = pid;
     d_ptr->name = name;
     d_ptr->command = command;
@@ -76,3 +81,187 @@ QString KProcessInfo::user() const
 {
     return d_ptr->user;
 }
+
+ProcessInfoFields KProcessInfo::fields() const
+{
+    return d_ptr->fields;
+}
+
+qint64 KProcessInfo::parentPid() const
+{
+    return d_ptr->parentPid;
+}
+
+KProcessInfo::State KProcessInfo::state() const
+{
+    return d_ptr->state;
+}
+
+qint64 KProcessInfo::userTime() const
+{
+    return d_ptr->userTime;
+}
+
+qint64 KProcessInfo::systemTime() const
+{
+    return d_ptr->systemTime;
+}
+
+qint64 KProcessInfo::residentSetSize() const
+{
+    return d_ptr->residentSetSize;
+}
+
+QDateTime KProcessInfo::startTime() const
+{
+    return d_ptr->startTime;
+}
+
+QString KProcessInfo::cgroup() const
+{
+    return d_ptr->cgroup;
+}
+
+void KProcessList::removeInvalid(KProcessInfoList &list)
+{
+    list.erase(std::remove_if(list.begin(),
+                              list.end(),
+                              [](const KProcessInfo &info) {
+                                  return !info.isValid();
+                              }),
+               list.end());
+}
+
+KProcessInfoList KProcessList::processInfoList(const ProcessFilter &filter, ProcessInfoFields fields)
+{
+    KProcessInfoList list;
+    if (filteredProcessInfoList(filter, fields, list)) {
+        return list;
+    }
+
+    // The fields needed to check the criteria
+    if (!filter.name.isEmpty()) {
+        fields |= CommandField;
+    }
+    if (!filter.user.isEmpty()) {
+        fields |= UserField;
+    }
+    list = processInfoList(fields);
+    list.erase(std::remove_if(list.begin(),
+                              list.end(),
+                              [&filter](const KProcessInfo &info) {
+                                  return (!filter.name.isEmpty() && info.name() != filter.name) || (!filter.user.isEmpty() && info.user() != filter.user);
+                              }),
+               list.end());
+    return list;
+}
+
+class KProcessList::SnapshotPrivate
+{
+public:
+    struct Entry {
+        quint64 startTime;
+        KProcessInfo info;
+    };
+
+    void updateFromStartTimes(const QHash<qint64, quint64> &startTimes, Snapshot::Delta &delta);
+    void updateFromList(const KProcessInfoList &list, Snapshot::Delta &delta);
+
+    QMap<qint64, Entry> entries;
+};
+
+static bool isSameProcessInfo(const KProcessInfo &a, const KProcessInfo &b)
+{
+    return a.name() == b.name() && a.command() == b.command() && a.user() == b.user();
+}
+
+void SnapshotPrivate::updateFromStartTimes(const QHash<qint64, quint64> &startTimes, Snapshot::Delta &delta)
+{
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (!startTimes.contains(it.key())) {
+            delta.removed.append(it.key());
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // only the new processes need to be looked up
+    for (auto it = startTimes.cbegin(); it != startTimes.cend(); ++it) {
+        const auto entry = entries.find(it.key());
+        if (entry != entries.end() && entry->startTime == it.value()) {
+            continue;
+        }
+        const KProcessInfo info = processInfo(it.key());
+        if (!info.isValid()) {
+            // exited in between
+            if (entry != entries.end()) {
+                delta.removed.append(it.key());
+                entries.erase(entry);
+            }
+            continue;
+        }
+        if (entry == entries.end()) {
+            delta.added.append(info);
+            entries.insert(it.key(), Entry{it.value(), info});
+        } else {
+            delta.changed.append(info);
+            *entry = Entry{it.value(), info};
+        }
+    }
+}
+
+void SnapshotPrivate::updateFromList(const KProcessInfoList &list, Snapshot::Delta &delta)
+{
+    QMap<qint64, Entry> newEntries;
+    for (const KProcessInfo &info : list) {
+        const auto entry = entries.constFind(info.pid());
+        if (entry == entries.cend()) {
+            delta.added.append(info);
+        } else if (!isSameProcessInfo(entry->info, info)) {
+            delta.changed.append(info);
+        }
+        newEntries.insert(info.pid(), Entry{0, info});
+    }
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        if (!newEntries.contains(it.key())) {
+            delta.removed.append(it.key());
+        }
+    }
+    entries = std::move(newEntries);
+}
+
+Snapshot::Snapshot()
+    : d(new SnapshotPrivate)
+{
+}
+
+Snapshot::~Snapshot() = default;
+
+Snapshot::Delta Snapshot::update()
+{
+    Delta delta;
+    QHash<qint64, quint64> startTimes;
+    if (processStartTimes(startTimes)) {
+        d->updateFromStartTimes(startTimes, delta);
+    } else {
+        d->updateFromList(processInfoList(), delta);
+    }
+    const auto byPid = [](const KProcessInfo &a, const KProcessInfo &b) {
+        return a.pid() < b.pid();
+    };
+    std::sort(delta.added.begin(), delta.added.end(), byPid);
+    std::sort(delta.changed.begin(), delta.changed.end(), byPid);
+    std::sort(delta.removed.begin(), delta.removed.end());
+    return delta;
+}
+
+KProcessInfoList Snapshot::processes() const
+{
+    KProcessInfoList list;
+    list.reserve(d->entries.size());
+    for (const SnapshotPrivate::Entry &entry : std::as_const(d->entries)) {
+        list.append(entry.info);
+    }
+    return list;
+}
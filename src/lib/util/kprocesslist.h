@@ -15,9 +15,74 @@
 #include <QString>
 #include <kcoreaddons_export.h>
 
+#include <memory>
+
+class QDateTime;
+
 namespace KProcessList
 {
 class KProcessInfoPrivate;
+class SnapshotPrivate;
+
+/**
+ * @brief The information about a process which processInfoList() and processInfo()
+ * can be asked to retrieve.
+ * @see ProcessInfoFields
+ * @since 6.0
+ */
+enum ProcessInfoField {
+    /**
+     * The command line, see KProcessInfo::command(). Without it, the possibly truncated
+     * name the process was started as is used for the name and the command.
+     */
+    CommandField = 0x1,
+    /**
+     * The user the process is running under, see KProcessInfo::user()
+     */
+    UserField = 0x2,
+    /**
+     * The status of the process: KProcessInfo::parentPid(), KProcessInfo::state(),
+     * KProcessInfo::userTime(), KProcessInfo::systemTime(), KProcessInfo::residentSetSize()
+     * and KProcessInfo::startTime()
+     */
+    StatusFields = 0x4,
+    /**
+     * The control group of the process, see KProcessInfo::cgroup()
+     */
+    CgroupField = 0x8,
+    /**
+     * The fields retrieved by processInfoList() and processInfo() without any fields given
+     */
+    DefaultFields = CommandField | UserField | StatusFields,
+    AllFields = DefaultFields | CgroupField,
+};
+/**
+ * Stores a combination of #ProcessInfoField values.
+ * @since 6.0
+ */
+Q_DECLARE_FLAGS(ProcessInfoFields, ProcessInfoField)
+Q_DECLARE_OPERATORS_FOR_FLAGS(ProcessInfoFields)
+
+/**
+ * @brief Options for processInfoList()
+ * @see ProcessListOptions
+ * @since 6.0
+ */
+enum ProcessListOption {
+    NoProcessListOptions = 0,
+    /**
+     * Look up the processes on the idle threads of QThreadPool::globalInstance() besides
+     * the calling thread. This pays off with many thousands of processes, where listing
+     * them is bound by the time the system takes to hand out the information of each.
+     */
+    ParallelListing = 0x1,
+};
+/**
+ * Stores a combination of #ProcessListOption values.
+ * @since 6.0
+ */
+Q_DECLARE_FLAGS(ProcessListOptions, ProcessListOption)
+Q_DECLARE_OPERATORS_FOR_FLAGS(ProcessListOptions)
 
 /**
  * @brief Contains information about a process. This class is usually not used alone but rather returned by
@@ -27,6 +92,20 @@ class KProcessInfoPrivate;
 class KCOREADDONS_EXPORT KProcessInfo
 {
 public:
+    /**
+     * @brief The scheduling state of a process
+     * @since 6.0
+     */
+    enum State {
+        UnknownState, ///< The state was not retrieved, or is not known
+        Running, ///< Running or runnable
+        Sleeping, ///< Sleeping in an interruptible wait
+        DiskSleep, ///< Waiting in an uninterruptible sleep, usually for I/O
+        Stopped, ///< Stopped by a signal or being traced
+        Zombie, ///< Exited, but not yet waited for by its parent
+        Idle, ///< An idle kernel thread
+    };
+
     KProcessInfo();
     KProcessInfo(qint64 pid, const QString &command, const QString &user);
     KProcessInfo(qint64 pid, const QString &command, const QString &name, const QString &user);
@@ -60,7 +139,58 @@ public:
      */
     QString command() const;
 
+    /**
+     * @brief The fields that were retrieved for this process. The functions for the
+     * others return their default values.
+     * @since 6.0
+     */
+    ProcessInfoFields fields() const;
+
+    /**
+     * @brief The pid of the parent process, or -1 if it is not known
+     * @since 6.0
+     */
+    qint64 parentPid() const;
+
+    /**
+     * @brief The scheduling state of the process at the time it was retrieved
+     * @since 6.0
+     */
+    State state() const;
+
+    /**
+     * @brief The CPU time the process spent in user mode so far, in milliseconds, or -1 if it is not known
+     * @since 6.0
+     */
+    qint64 userTime() const;
+
+    /**
+     * @brief The CPU time the process spent in kernel mode so far, in milliseconds, or -1 if it is not known
+     * @since 6.0
+     */
+    qint64 systemTime() const;
+
+    /**
+     * @brief The resident set size of the process in bytes, or -1 if it is not known
+     * @since 6.0
+     */
+    qint64 residentSetSize() const;
+
+    /**
+     * @brief The time the process was started at, or an invalid QDateTime if it is not known
+     * @since 6.0
+     */
+    QDateTime startTime() const;
+
+    /**
+     * @brief The path of the control group the process belongs to, e.g.
+     * "/user.slice/user-1000.slice/session-2.scope", or an empty string if it is not known
+     * @since 6.0
+     */
+    QString cgroup() const;
+
 private:
+    friend class KProcessInfoPrivate;
     QSharedDataPointer<KProcessInfoPrivate> d_ptr;
 };
 
@@ -72,6 +202,56 @@ typedef QList<KProcessInfo> KProcessInfoList;
  */
 KCOREADDONS_EXPORT KProcessInfoList processInfoList();
 
+/**
+ * @brief Retrieves the list of currently active processes, with only the information in @p fields.
+ *
+ * Leaving out the fields that are not needed makes retrieving the list faster. Only
+ * the command and the user are available on all platforms, see KProcessInfo::fields().
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT KProcessInfoList processInfoList(ProcessInfoFields fields);
+
+/**
+ * @brief Retrieves the list of currently active processes, with only the information in @p fields,
+ * the way @p options say.
+ * @see processInfoList(ProcessInfoFields)
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT KProcessInfoList processInfoList(ProcessInfoFields fields, ProcessListOptions options);
+
+/**
+ * @brief The processes processInfoList(const ProcessFilter &, ProcessInfoFields) retrieves
+ *
+ * A process has to match all of the criteria which are set.
+ * @since 6.0
+ */
+struct KCOREADDONS_EXPORT ProcessFilter {
+    /**
+     * Only the processes with this name, the file name of their executable
+     * like KProcessInfo::name() returns it. Empty for processes of any name.
+     */
+    QString name;
+    /**
+     * Only the processes of the user with this login name. Empty for the
+     * processes of all users.
+     */
+    QString user;
+};
+
+/**
+ * @brief Retrieves the currently active processes matching @p filter, with the information in @p fields.
+ *
+ * This is faster than filtering the whole processInfoList() where the platform allows
+ * to check the criteria before retrieving the rest of the information. On Linux, the
+ * name and the user are checked with the name the kernel keeps, and the owner of the
+ * process, so only the matching processes are looked up further.
+ * @code
+ * const bool running = !KProcessList::processInfoList({QStringLiteral("kded6"), KUser().loginName()}, {}).isEmpty();
+ * @endcode
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT KProcessInfoList processInfoList(const ProcessFilter &filter, ProcessInfoFields fields = DefaultFields);
+
 /**
  * @brief Retrieves process information for a specific process-id. If the process is not found a KProcessInfo with
  * isValid == false will be returned.
@@ -80,6 +260,86 @@ KCOREADDONS_EXPORT KProcessInfoList processInfoList();
  */
 KCOREADDONS_EXPORT KProcessInfo processInfo(qint64 pid);
 
+/**
+ * @brief Retrieves process information for a specific process-id, with only the information in @p fields.
+ * @see processInfoList(ProcessInfoFields)
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT KProcessInfo processInfo(qint64 pid, ProcessInfoFields fields);
+
+/**
+ * @brief Keeps track of the active processes between calls to update(), and reports
+ * what changed in between.
+ *
+ * This is meant for polling the process list regularly, e.g. in a system monitor.
+ * Where the platform allows telling cheaply whether a process id was reused, only
+ * the new processes are looked up on update(), instead of all of them.
+ *
+ * @code
+ * KProcessList::Snapshot snapshot;
+ * snapshot.update(); // everything is added the first time
+ * ...
+ * const KProcessList::Snapshot::Delta delta = snapshot.update();
+ * for (const KProcessList::KProcessInfo &process : delta.added) {
+ *     ...
+ * }
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT Snapshot
+{
+public:
+    /**
+     * @brief What changed in the process list from one update() to the next
+     */
+    struct Delta {
+        /**
+         * @brief The processes that were started
+         */
+        KProcessInfoList added;
+        /**
+         * @brief The process ids of the processes that exited
+         */
+        QList<qint64> removed;
+        /**
+         * @brief The processes that are different from before under the same process id,
+         * e.g. because the process id was reused
+         */
+        KProcessInfoList changed;
+
+        /**
+         * @brief If nothing changed
+         */
+        bool isEmpty() const
+        {
+            return added.isEmpty() && removed.isEmpty() && changed.isEmpty();
+        }
+    };
+
+    /**
+     * @brief Creates an empty snapshot, call update() to fill it.
+     */
+    Snapshot();
+    ~Snapshot();
+
+    /**
+     * @brief Retrieves the currently active processes, and returns how they differ
+     * from those of the last update.
+     */
+    Delta update();
+
+    /**
+     * @brief The processes as of the last update, ordered by process id.
+     */
+    KProcessInfoList processes() const;
+
+private:
+    std::unique_ptr<SnapshotPrivate> const d;
+
+    Q_DISABLE_COPY(Snapshot)
+};
+
 } // KProcessList namespace
 
 Q_DECLARE_TYPEINFO(KProcessList::KProcessInfo, Q_RELOCATABLE_TYPE);
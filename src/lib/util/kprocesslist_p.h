@@ -11,6 +11,8 @@
 #define KPROCESSLIST_P_H
 
 #include "kprocesslist.h"
+#include <QDateTime>
+#include <QHash>
 #include <QSharedData>
 
 namespace KProcessList
@@ -20,13 +22,52 @@ class KProcessInfoPrivate : public QSharedData
 public:
     KProcessInfoPrivate();
 
+    static KProcessInfoPrivate *get(KProcessInfo &info)
+    {
+        return info.d_ptr.data();
+    }
+
     bool valid = false;
     qint64 pid = -1;
     QString name;
     QString user;
     QString command;
+
+    ProcessInfoFields fields;
+    qint64 parentPid = -1;
+    KProcessInfo::State state = KProcessInfo::UnknownState;
+    qint64 userTime = -1;
+    qint64 systemTime = -1;
+    qint64 residentSetSize = -1;
+    QDateTime startTime;
+    QString cgroup;
 };
 
+/**
+ * Lists the ids of the active processes in @p startTimes, each with the time
+ * the process was started at in whatever unit the platform uses. A different
+ * start time for the same id means that the id was reused.
+ *
+ * Implemented by the platforms which can do this faster than listing the
+ * processes, the others return false.
+ */
+bool processStartTimes(QHash<qint64, quint64> &startTimes);
+
+/**
+ * Lists the processes matching @p filter in @p list, checking the criteria
+ * before looking up the other information.
+ *
+ * Implemented by the platforms which can do this faster than listing all
+ * processes, the others return false.
+ */
+bool filteredProcessInfoList(const ProcessFilter &filter, ProcessInfoFields fields, KProcessInfoList &list);
+
+/**
+ * Removes the invalid entries from @p list, e.g. those of the processes that
+ * exited while being looked up.
+ */
+void removeInvalid(KProcessInfoList &list);
+
 } // KProcessList namespace
 
 #endif // KPROCESSLIST_P_H
@@ -19,11 +19,31 @@
  */
 
 #include "kcoreaddons_debug.h"
+#include "kparallel_p.h"
 #include "kprocesslist.h"
+#include "kprocesslist_p.h"
+#include "ktracing_p.h"
+#include "kuser_p.h"
 
 #include <QDebug>
 #include <QDir>
+#include <QHash>
 #include <QProcess>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #ifdef Q_OS_FREEBSD
 #error This KProcessInfo implementation is not supported on FreeBSD (use procstat)
@@ -33,12 +53,14 @@ using namespace KProcessList;
 
 namespace
 {
+#ifndef Q_OS_LINUX
 bool isUnixProcessId(const QString &procname)
 {
     return std::none_of(procname.cbegin(), procname.cend(), [](const QChar ch) {
         return !ch.isDigit();
     });
 }
+#endif
 
 // Determine UNIX processes by running ps
 KProcessInfoList unixProcessListPS()
@@ -92,6 +114,7 @@ KProcessInfoList unixProcessListPS()
     return rc;
 }
 
+#ifndef Q_OS_LINUX
 bool getProcessInfo(const QString &procId, KProcessInfo &processInfo)
 {
     if (!isUnixProcessId(procId)) {
@@ -146,13 +169,483 @@ bool getProcessInfo(const QString &procId, KProcessInfo &processInfo)
     processInfo = KProcessInfo(pid, command, name, user);
     return true;
 }
+#else
+// Fast path for Linux: the pids are listed with getdents64 directly and the
+// files of each process are read with openat() into stack buffers, so that
+// listing all processes doesn't allocate anything but the results.
+
+// Maps the uids of the processes to user names, as there are usually a lot of
+// processes for only a handful of users
+class UserNameCache
+{
+public:
+    QString userName(uid_t uid)
+    {
+        auto it = m_names.constFind(uid);
+        if (it == m_names.constEnd()) {
+            it = m_names.insert(uid, lookUp(uid));
+        }
+        return it.value();
+    }
+
+private:
+    // the names are shared with KUser, so that other listings don't look them up again
+    static QString lookUp(uid_t uid)
+    {
+        return kuserNameCache().name(KUserId(uid));
+    }
+
+    QHash<uid_t, QString> m_names;
+};
+
+// Reads all of the file @p name in the directory @p dirFd into @p buffer,
+// and if @p st is given, stats it. Returns false if the file can't be read.
+template<qsizetype Prealloc>
+bool readFileAt(int dirFd, const char *name, QVarLengthArray<char, Prealloc> &buffer, struct stat *st = nullptr)
+{
+    const int fd = ::openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (st && ::fstat(fd, st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // the files in /proc have no size, so read until the end
+    buffer.resize(0);
+    for (;;) {
+        if (buffer.size() == buffer.capacity()) {
+            buffer.reserve(buffer.capacity() * 2);
+        }
+        const qsizetype size = buffer.size();
+        buffer.resize(buffer.capacity());
+        const ssize_t bytesRead = ::read(fd, buffer.data() + size, buffer.size() - size);
+        buffer.resize(size + qMax<ssize_t>(bytesRead, 0));
+        if (bytesRead <= 0) {
+            ::close(fd);
+            return bytesRead == 0;
+        }
+    }
+}
+
+// The fields of "/proc/<pid>/stat" that are used here
+struct ProcStat {
+    const char *nameBegin;
+    const char *nameEnd;
+    char state;
+    qint64 parentPid;
+    qint64 userTime;
+    qint64 systemTime;
+    qint64 startTime;
+    qint64 residentSetSize;
+};
+
+qint64 parseNumber(const char *c, const char *end)
+{
+    const bool negative = c != end && *c == '-';
+    if (negative) {
+        ++c;
+    }
+    qint64 number = 0;
+    for (; c != end && *c >= '0' && *c <= '9'; ++c) {
+        number = number * 10 + (*c - '0');
+    }
+    return negative ? -number : number;
+}
+
+// "<pid> (<name>) <state> <ppid> ...", where the name may contain spaces
+// and parentheses itself
+bool parseStat(const char *begin, const char *end, ProcStat &stat)
+{
+    stat.nameBegin = std::find(begin, end, '(');
+    const char *const closing = std::find(std::make_reverse_iterator(end), std::make_reverse_iterator(stat.nameBegin), ')').base();
+    if (stat.nameBegin == end || closing == stat.nameBegin) {
+        return false;
+    }
+    ++stat.nameBegin;
+    stat.nameEnd = closing - 1;
+
+    // the state is field 3, and the ones used here end with the rss as field 24
+    const char *fields[25] = {};
+    int field = 2;
+    for (const char *c = closing; c != end && field < 24; ++c) {
+        if (*c == ' ') {
+            fields[++field] = c + 1;
+        }
+    }
+    if (field < 24) {
+        return false;
+    }
+
+    stat.state = fields[3] != end ? *fields[3] : '\0';
+    stat.parentPid = parseNumber(fields[4], end);
+    stat.userTime = parseNumber(fields[14], end);
+    stat.systemTime = parseNumber(fields[15], end);
+    stat.startTime = parseNumber(fields[22], end);
+    stat.residentSetSize = parseNumber(fields[24], end);
+    return true;
+}
+
+KProcessInfo::State processState(char state)
+{
+    switch (state) {
+    case 'R':
+        return KProcessInfo::Running;
+    case 'S':
+        return KProcessInfo::Sleeping;
+    case 'D':
+        return KProcessInfo::DiskSleep;
+    case 'T':
+    case 't':
+        return KProcessInfo::Stopped;
+    case 'Z':
+        return KProcessInfo::Zombie;
+    case 'I':
+        return KProcessInfo::Idle;
+    default:
+        return KProcessInfo::UnknownState;
+    }
+}
+
+// The time the system was booted at, in milliseconds since the epoch
+qint64 bootTime()
+{
+    static const qint64 time = []() -> qint64 {
+        QVarLengthArray<char, 4096> data;
+        if (!readFileAt(AT_FDCWD, "/proc/stat", data)) {
+            return 0;
+        }
+        static const char key[] = "\nbtime ";
+        const auto it = std::search(data.cbegin(), data.cend(), key, key + sizeof(key) - 1);
+        return it != data.cend() ? parseNumber(it + sizeof(key) - 1, data.cend()) * 1000 : 0;
+    }();
+    return time;
+}
+
+// The path of the unified hierarchy in "/proc/<pid>/cgroup", or else the first one
+QString parseCgroup(const char *begin, const char *end)
+{
+    const char *firstPath = nullptr;
+    const char *firstPathEnd = nullptr;
+    for (const char *line = begin; line != end;) {
+        const char *const lineEnd = std::find(line, end, '\n');
+        // "<hierarchy id>:<controllers>:<path>", the unified hierarchy being "0::<path>"
+        const char *const controllers = std::find(line, lineEnd, ':');
+        const char *const path = controllers == lineEnd ? lineEnd : std::find(controllers + 1, lineEnd, ':');
+        if (path != lineEnd) {
+            if (controllers - line == 1 && *line == '0' && path == controllers + 1) {
+                return QString::fromLocal8Bit(path + 1, lineEnd - (path + 1));
+            }
+            if (!firstPath) {
+                firstPath = path + 1;
+                firstPathEnd = lineEnd;
+            }
+        }
+        line = lineEnd == end ? end : lineEnd + 1;
+    }
+    return firstPath ? QString::fromLocal8Bit(firstPath, firstPathEnd - firstPath) : QString();
+}
+
+bool getProcessInfoAt(int procFd, const char *procId, qint64 pid, ProcessInfoFields fields, UserNameCache &users, KProcessInfo &processInfo)
+{
+    const int pidFd = ::openat(procFd, procId, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (pidFd < 0) {
+        return false; // process may have exited
+    }
+
+    QVarLengthArray<char, 1024> statData;
+    struct stat st;
+    ProcStat stat;
+    if (!readFileAt(pidFd, "stat", statData, fields.testFlag(UserField) ? &st : nullptr) || !parseStat(statData.cbegin(), statData.cend(), stat)) {
+        ::close(pidFd);
+        return false;
+    }
+    QString name = QString::fromLocal8Bit(stat.nameBegin, stat.nameEnd - stat.nameBegin);
+    QString command = name;
+
+    QVarLengthArray<char, 4096> data;
+    if (fields.testFlag(CommandField) && readFileAt(pidFd, "cmdline", data) && !data.isEmpty()) {
+        // extract non-truncated name from cmdline
+        const auto zero = std::find(data.cbegin(), data.cend(), '\0');
+        const auto slash = std::find(std::make_reverse_iterator(zero), data.crend(), '/').base();
+        name = QString::fromLocal8Bit(slash, zero - slash);
+
+        std::replace(data.begin(), data.end(), '\0', ' ');
+        command = QString::fromLocal8Bit(data.constData(), data.size()).trimmed();
+    }
+
+    processInfo = KProcessInfo(pid, command, name, fields.testFlag(UserField) ? users.userName(st.st_uid) : QString());
+    KProcessInfoPrivate *const d = KProcessInfoPrivate::get(processInfo);
+    d->fields = fields & AllFields;
+
+    if (fields.testFlag(StatusFields)) {
+        static const qint64 ticksPerSecond = ::sysconf(_SC_CLK_TCK);
+        static const qint64 pageSize = ::sysconf(_SC_PAGESIZE);
+        d->parentPid = stat.parentPid;
+        d->state = processState(stat.state);
+        d->userTime = stat.userTime * 1000 / ticksPerSecond;
+        d->systemTime = stat.systemTime * 1000 / ticksPerSecond;
+        d->residentSetSize = stat.residentSetSize * pageSize;
+        d->startTime = QDateTime::fromMSecsSinceEpoch(bootTime() + stat.startTime * 1000 / ticksPerSecond);
+    }
+
+    if (fields.testFlag(CgroupField) && readFileAt(pidFd, "cgroup", data)) {
+        d->cgroup = parseCgroup(data.cbegin(), data.cend());
+    }
+
+    ::close(pidFd);
+    return true;
+}
+
+// The layout of the entries returned by getdents64, which glibc only has a
+// wrapper for since 2.30. The name is null terminated, and the entries are
+// d_reclen apart.
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[256];
+};
+
+// Calls @p function with the name of the directory and the pid of each
+// process in /proc, which is open as @p procFd
+template<typename Function>
+void forEachProcess(int procFd, Function function)
+{
+    alignas(LinuxDirent64) char buffer[32768];
+    for (;;) {
+        const long bytesRead = ::syscall(SYS_getdents64, procFd, buffer, sizeof(buffer));
+        if (bytesRead <= 0) {
+            break;
+        }
+        for (long offset = 0; offset < bytesRead;) {
+            const auto *entry = reinterpret_cast<const LinuxDirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+
+            if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) {
+                continue;
+            }
+            qint64 pid = 0;
+            const char *c = entry->d_name;
+            for (; *c >= '0' && *c <= '9'; ++c) {
+                pid = pid * 10 + (*c - '0');
+            }
+            if (c == entry->d_name || *c != '\0') {
+                continue; // not a process
+            }
+
+            function(entry->d_name, pid);
+        }
+    }
+}
+
+// Returns false if there's no /proc
+bool procProcessList(ProcessInfoFields fields, ProcessListOptions options, KProcessInfoList &rc)
+{
+    const int procFd = ::open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd < 0) {
+        return false;
+    }
+
+    if (options.testFlag(ParallelListing)) {
+        QList<qint64> pids;
+        forEachProcess(procFd, [&](const char *, qint64 pid) {
+            pids.append(pid);
+        });
+
+        rc.resize(pids.size());
+        KProcessInfo *const out = rc.data();
+        KParallel::forEachIndex(pids.size(), [&]() {
+            return [&, users = UserNameCache()](qsizetype i) mutable {
+                char procId[24];
+                std::snprintf(procId, sizeof(procId), "%lld", static_cast<long long>(pids.at(i)));
+                getProcessInfoAt(procFd, procId, pids.at(i), fields, users, out[i]);
+            };
+        });
+        // the processes that exited in the meantime are left invalid
+        removeInvalid(rc);
+    } else {
+        UserNameCache users;
+        forEachProcess(procFd, [&](const char *procId, qint64 pid) {
+            KProcessInfo processInfo;
+            if (getProcessInfoAt(procFd, procId, pid, fields, users, processInfo)) {
+                rc.push_back(processInfo);
+            }
+        });
+    }
+
+    ::close(procFd);
+    return true;
+}
+
+// The kernel keeps this many bytes of the name of a process
+const qsizetype s_kernelNameLength = 15;
+
+// Whether the process @p procId is named @p name, read from "/proc/<pid>/stat". Names
+// the kernel cut are checked against the name in "/proc/<pid>/cmdline" as well.
+bool hasProcessName(int procFd, const char *procId, const QByteArray &name)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "%s/stat", procId);
+    const int fd = ::openat(procFd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false; // process may have exited
+    }
+    char statData[1024];
+    const ssize_t size = ::read(fd, statData, sizeof(statData));
+    ::close(fd);
+    ProcStat stat;
+    if (size <= 0 || !parseStat(statData, statData + size, stat)) {
+        return false;
+    }
+
+    const QByteArrayView kernelName(stat.nameBegin, stat.nameEnd - stat.nameBegin);
+    if (name.size() <= s_kernelNameLength) {
+        return kernelName == name;
+    }
+    if (kernelName != QByteArrayView(name).first(s_kernelNameLength)) {
+        return false;
+    }
+
+    std::snprintf(path, sizeof(path), "%s/cmdline", procId);
+    QVarLengthArray<char, 4096> data;
+    if (!readFileAt(procFd, path, data)) {
+        return false;
+    }
+    // The same name as getProcessInfoAt() extracts
+    const auto zero = std::find(data.cbegin(), data.cend(), '\0');
+    const auto slash = std::find(std::make_reverse_iterator(zero), data.crend(), '/').base();
+    return QByteArrayView(slash, zero - slash) == name;
+}
+
+// Returns false if there's no /proc
+bool procFilteredProcessList(const ProcessFilter &filter, ProcessInfoFields fields, KProcessInfoList &rc)
+{
+    const int procFd = ::open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd < 0) {
+        return false;
+    }
+
+    KUserId user;
+    if (!filter.user.isEmpty()) {
+        user = KUserId::fromName(filter.user);
+        if (!user.isValid()) {
+            // no such user, so no processes of it
+            ::close(procFd);
+            return true;
+        }
+    }
+    const QByteArray name = filter.name.toLocal8Bit();
+
+    UserNameCache users;
+    forEachProcess(procFd, [&](const char *procId, qint64 pid) {
+        // The owner of the directory of a process is the one of its files
+        struct stat st;
+        if (user.isValid() && (::fstatat(procFd, procId, &st, 0) != 0 || st.st_uid != user.nativeId())) {
+            return;
+        }
+        if (!name.isEmpty() && !hasProcessName(procFd, procId, name)) {
+            return;
+        }
+        KProcessInfo processInfo;
+        if (getProcessInfoAt(procFd, procId, pid, fields, users, processInfo)) {
+            rc.push_back(processInfo);
+        }
+    });
+
+    ::close(procFd);
+    return true;
+}
+
+// Reads the start time, field 22 of "/proc/<pid>/stat", in clock ticks since boot
+bool readStartTime(int procFd, const char *procId, quint64 &startTime)
+{
+    char path[64];
+    std::snprintf(path, sizeof(path), "%s/stat", procId);
+    const int fd = ::openat(procFd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false; // process may have exited
+    }
+    char statData[1024];
+    const ssize_t size = ::read(fd, statData, sizeof(statData));
+    ::close(fd);
+    if (size <= 0) {
+        return false;
+    }
+
+    ProcStat stat;
+    if (!parseStat(statData, statData + size, stat)) {
+        return false;
+    }
+    startTime = stat.startTime;
+    return true;
+}
+#endif
 
 } // unnamed namespace
 
+bool KProcessList::processStartTimes(QHash<qint64, quint64> &startTimes)
+{
+#ifdef Q_OS_LINUX
+    const int procFd = ::open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd < 0) {
+        return false;
+    }
+
+    forEachProcess(procFd, [&](const char *procId, qint64 pid) {
+        quint64 startTime;
+        if (readStartTime(procFd, procId, startTime)) {
+            startTimes.insert(pid, startTime);
+        }
+    });
+
+    ::close(procFd);
+    return true;
+#else
+    Q_UNUSED(startTimes);
+    return false;
+#endif
+}
+
+bool KProcessList::filteredProcessInfoList(const ProcessFilter &filter, ProcessInfoFields fields, KProcessInfoList &list)
+{
+    KTRACE_SCOPE("KProcessList::filteredProcessInfoList");
+#ifdef Q_OS_LINUX
+    return procFilteredProcessList(filter, fields, list);
+#else
+    Q_UNUSED(filter);
+    Q_UNUSED(fields);
+    Q_UNUSED(list);
+    return false;
+#endif
+}
+
 // Determine UNIX processes by reading "/proc". Default to ps if
 // it does not exist
 KProcessInfoList KProcessList::processInfoList()
 {
+    return processInfoList(DefaultFields);
+}
+
+KProcessInfoList KProcessList::processInfoList(ProcessInfoFields fields)
+{
+    return processInfoList(fields, NoProcessListOptions);
+}
+
+KProcessInfoList KProcessList::processInfoList(ProcessInfoFields fields, ProcessListOptions options)
+{
+    KTRACE_SCOPE("KProcessList::processInfoList");
+#ifdef Q_OS_LINUX
+    KProcessInfoList rc;
+    if (!procProcessList(fields, options, rc)) {
+        return unixProcessListPS();
+    }
+    return rc;
+#else
+    Q_UNUSED(fields);
+    Q_UNUSED(options);
     const QDir procDir(QStringLiteral("/proc/"));
     if (!procDir.exists()) {
         return unixProcessListPS();
@@ -167,6 +660,12 @@ KProcessInfoList KProcessList::processInfoList()
         }
     }
     return rc;
+#endif
+}
+
+KProcessInfo KProcessList::processInfo(qint64 pid)
+{
+    return processInfo(pid, DefaultFields);
 }
 
 // Determine UNIX process by reading "/proc".
@@ -174,9 +673,22 @@ KProcessInfoList KProcessList::processInfoList()
 // TODO: Use ps if "/proc" does not exist or is bogus; use code
 //       from unixProcessListPS() but add a `-p pid` argument.
 //
-KProcessInfo KProcessList::processInfo(qint64 pid)
+KProcessInfo KProcessList::processInfo(qint64 pid, ProcessInfoFields fields)
 {
     KProcessInfo processInfo;
+#ifdef Q_OS_LINUX
+    if (pid < 0) {
+        return processInfo;
+    }
+    const int procFd = ::open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd >= 0) {
+        UserNameCache users;
+        getProcessInfoAt(procFd, QByteArray::number(pid).constData(), pid, fields, users, processInfo);
+        ::close(procFd);
+    }
+#else
+    Q_UNUSED(fields);
     getProcessInfo(QString::number(pid), processInfo);
+#endif
     return processInfo;
 }
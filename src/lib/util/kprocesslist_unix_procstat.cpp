@@ -7,17 +7,34 @@
     SPDX-License-Identifier: LGPL-2.1-only
 */
 
+#include "kparallel_p.h"
 #include "kprocesslist.h"
+#include "kprocesslist_p.h"
+#include "ktracing_p.h"
 #include "kprocesslist_unix_procstat_p.h"
 
 #include <QDir>
 #include <QProcess>
 
+#include <memory>
+
 using namespace KProcessList;
 
 // Determine UNIX processes by using the procstat library
 KProcessInfoList KProcessList::processInfoList()
 {
+    return processInfoList(DefaultFields, NoProcessListOptions);
+}
+
+KProcessInfoList KProcessList::processInfoList(ProcessInfoFields fields)
+{
+    return processInfoList(fields, NoProcessListOptions);
+}
+
+KProcessInfoList KProcessList::processInfoList(ProcessInfoFields fields, ProcessListOptions options)
+{
+    KTRACE_SCOPE("KProcessList::processInfoList");
+    Q_UNUSED(fields);
     KProcessInfoList rc;
 
     ProcStat pstat;
@@ -26,8 +43,24 @@ KProcessInfoList KProcessList::processInfoList()
     }
 
     ProcStatProcesses procs(pstat);
-    for (const auto &process_info : procs) {
-        rc.push_back(process_info);
+    if (options.testFlag(ParallelListing)) {
+        // The processes come in one go, their arguments are looked up one by one
+        rc.resize(procs.count());
+        KProcessInfo *const out = rc.data();
+        KParallel::forEachIndex(procs.count(), [&]() {
+            auto threadStat = std::make_shared<ProcStat>();
+            return [&, threadStat](qsizetype i) {
+                if (*threadStat) {
+                    out[i] = procs.processInfo(i, *threadStat);
+                }
+            };
+        });
+        // in case a thread couldn't open procstat
+        removeInvalid(rc);
+    } else {
+        for (const auto &process_info : procs) {
+            rc.push_back(process_info);
+        }
     }
 
     return rc;
@@ -41,3 +74,25 @@ KProcessInfo KProcessList::processInfo(qint64 pid)
     });
     return testProcessIterator != processInfoList.end() ? *testProcessIterator : KProcessInfo{};
 }
+
+KProcessInfo KProcessList::processInfo(qint64 pid, ProcessInfoFields fields)
+{
+    Q_UNUSED(fields);
+    return processInfo(pid);
+}
+
+// Not available here, Snapshot compares whole process listings instead
+bool KProcessList::processStartTimes(QHash<qint64, quint64> &startTimes)
+{
+    Q_UNUSED(startTimes);
+    return false;
+}
+
+// Not available here, the whole listing is filtered instead
+bool KProcessList::filteredProcessInfoList(const ProcessFilter &filter, ProcessInfoFields fields, KProcessInfoList &list)
+{
+    Q_UNUSED(filter);
+    Q_UNUSED(fields);
+    Q_UNUSED(list);
+    return false;
+}
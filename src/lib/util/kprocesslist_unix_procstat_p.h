@@ -95,31 +95,38 @@ public:
 
         const KProcessInfo operator*()
         {
-            QStringList command_line;
-            QString command;
-            struct kinfo_proc *proc = &processes.procs[pos];
-
-            // Don't use procstat_getpathname() because:
-            // - it can fail, and then it spams a warning to stderr
-            // - it produces a full path, e.g. /tmp/kde/build/kcoreaddons/bin/kprocesslisttest
-            //   rather than the command-name, so it fails in tests that check for
-            //   a process name only.
-            command = QString::fromLocal8Bit(proc->ki_comm);
-
-            char **args;
-            args = procstat_getargv(processes.parent.pstat, proc, 0);
-            if (args) {
-                for (int i = 0; args[i] != nullptr; i++) {
-                    command_line << QString::fromLocal8Bit(args[i]);
-                }
-            }
-
-            pid_t pid = proc->ki_pid;
-            QString user = QString::fromLocal8Bit(proc->ki_login);
-            return KProcessInfo(pid, command_line.join(QString::fromLocal8Bit(" ")), command, user);
+            return processes.processInfo(pos, processes.parent);
         }
     };
 
+    // Looks up the process at @p pos, using @p pstat for its arguments. The
+    // arguments are kept in @p pstat, so each thread needs a ProcStat of its own.
+    KProcessInfo processInfo(unsigned int pos, ProcStat &pstat) const
+    {
+        QStringList command_line;
+        QString command;
+        struct kinfo_proc *proc = &procs[pos];
+
+        // Don't use procstat_getpathname() because:
+        // - it can fail, and then it spams a warning to stderr
+        // - it produces a full path, e.g. /tmp/kde/build/kcoreaddons/bin/kprocesslisttest
+        //   rather than the command-name, so it fails in tests that check for
+        //   a process name only.
+        command = QString::fromLocal8Bit(proc->ki_comm);
+
+        char **args;
+        args = procstat_getargv(pstat.pstat, proc, 0);
+        if (args) {
+            for (int i = 0; args[i] != nullptr; i++) {
+                command_line << QString::fromLocal8Bit(args[i]);
+            }
+        }
+
+        pid_t pid = proc->ki_pid;
+        QString user = QString::fromLocal8Bit(proc->ki_login);
+        return KProcessInfo(pid, command_line.join(QString::fromLocal8Bit(" ")), command, user);
+    }
+
     ProcessIterator begin() const
     {
         return ProcessIterator(*this, 0);
@@ -7,10 +7,15 @@
     SPDX-License-Identifier: LGPL-2.1-only WITH Qt-LGPL-exception-1.1 OR LicenseRef-Qt-Commercial
 */
 
+#include "kparallel_p.h"
 #include "kprocesslist.h"
+#include "kprocesslist_p.h"
+#include "ktracing_p.h"
+#include "kuser_p.h"
 
 #include <QLibrary>
 #include <algorithm>
+#include <vector>
 
 // Enable Win API of XP SP1 and later
 #ifdef Q_OS_WIN
@@ -21,10 +26,14 @@
 #if !defined(PROCESS_SUSPEND_RESUME) // Check flag for MinGW
 #define PROCESS_SUSPEND_RESUME (0x0800)
 #endif // PROCESS_SUSPEND_RESUME
+#if !defined(PROCESS_QUERY_LIMITED_INFORMATION)
+#define PROCESS_QUERY_LIMITED_INFORMATION (0x1000)
+#endif // PROCESS_QUERY_LIMITED_INFORMATION
 #endif // Q_OS_WIN
 
 #include <psapi.h>
 #include <tlhelp32.h>
+#include <winternl.h>
 
 using namespace KProcessList;
 
@@ -48,6 +57,214 @@ static inline BOOL queryFullProcessImageName(HANDLE h, DWORD flags, LPWSTR buffe
     return (*queryFullProcessImageNameW)(h, flags, buffer, size);
 }
 
+/*
+ * All processes are retrieved at once with NtQuerySystemInformation(), along
+ * with their name, parent, times and memory usage. Only the full path of the
+ * executable and the owner need a handle of the process, so the processes are
+ * only opened for the fields asking for these, with the least access rights
+ * which even work for most processes of other users. The names of the owners
+ * are cached by their SID.
+ *
+ * Toolhelp snapshots are the fallback, should ntdll.dll lack the function.
+ */
+
+// SYSTEM_PROCESS_INFORMATION, of which winternl.h only names a few fields
+struct SystemProcessInformation {
+    ULONG NextEntryOffset;
+    ULONG NumberOfThreads;
+    LARGE_INTEGER WorkingSetPrivateSize;
+    ULONG HardFaultCount;
+    ULONG NumberOfThreadsHighWatermark;
+    ULONGLONG CycleTime;
+    LARGE_INTEGER CreateTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER KernelTime;
+    UNICODE_STRING ImageName;
+    LONG BasePriority;
+    HANDLE UniqueProcessId;
+    HANDLE InheritedFromUniqueProcessId;
+    ULONG HandleCount;
+    ULONG SessionId;
+    ULONG_PTR UniqueProcessKey;
+    SIZE_T PeakVirtualSize;
+    SIZE_T VirtualSize;
+    ULONG PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+};
+
+typedef NTSTATUS(NTAPI *NtQuerySystemInformationProtoType)(ULONG, PVOID, ULONG, PULONG);
+static const ULONG s_systemProcessInformationClass = 5;
+static const NTSTATUS s_statusInfoLengthMismatch = NTSTATUS(0xC0000004L);
+
+// The difference between the epoch of FILETIME, 1601, and the Unix one, in 100 ns
+static const qint64 s_fileTimeEpochOffset = 116444736000000000LL;
+
+// The entries of all processes, empty if they can't be retrieved this way.
+// 64 bit elements, as the entries are aligned to them.
+static std::vector<ULONGLONG> querySystemProcessInformation()
+{
+    static const auto query = reinterpret_cast<NtQuerySystemInformationProtoType>(
+        reinterpret_cast<void *>(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation")));
+    if (!query) {
+        return {};
+    }
+
+    ULONG size = 256 * 1024;
+    std::vector<ULONGLONG> buffer;
+    // Processes may start between learning the size and retrieving them
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        buffer.resize(size / sizeof(ULONGLONG) + 1);
+        ULONG needed = 0;
+        const NTSTATUS status = query(s_systemProcessInformationClass, buffer.data(), ULONG(buffer.size() * sizeof(ULONGLONG)), &needed);
+        if (status >= 0) {
+            return buffer;
+        }
+        if (status != s_statusInfoLengthMismatch) {
+            break;
+        }
+        size = qMax(size * 2, needed + 64 * 1024);
+    }
+    return {};
+}
+
+// Unlike the login names of KUser, these include the names of the system accounts
+static QString lookUpOwnerName(const KUserId &sid)
+{
+    WCHAR name[MAX_PATH] = {0};
+    DWORD nameLength = MAX_PATH;
+    WCHAR domain[MAX_PATH] = {0};
+    DWORD domainLength = MAX_PATH;
+    SID_NAME_USE use;
+    if (!LookupAccountSidW(nullptr, sid.nativeId(), name, &nameLength, domain, &domainLength, &use)) {
+        return QString();
+    }
+    return QString::fromWCharArray(name, nameLength);
+}
+
+static KIdNameCache<KUserId> &ownerNameCache()
+{
+    static KIdNameCache<KUserId> cache(lookUpOwnerName);
+    return cache;
+}
+
+// The KProcessInfo of the entry @p entry of NtQuerySystemInformation(), without the fields needing a process handle
+static KProcessInfo systemProcessInfo(const SystemProcessInformation &entry, ProcessInfoFields fields)
+{
+    const qint64 pid = qint64(reinterpret_cast<quintptr>(entry.UniqueProcessId));
+    // The same name as Toolhelp gives the idle process
+    const QString name = entry.ImageName.Buffer
+        ? QString::fromWCharArray(entry.ImageName.Buffer, entry.ImageName.Length / sizeof(WCHAR))
+        : QStringLiteral("[System Process]");
+
+    KProcessInfo info(pid, name, name, QString());
+    KProcessInfoPrivate *const d = KProcessInfoPrivate::get(info);
+    d->fields = fields & (CommandField | UserField | StatusFields);
+    if (fields.testFlag(StatusFields)) {
+        d->parentPid = qint64(reinterpret_cast<quintptr>(entry.InheritedFromUniqueProcessId));
+        d->userTime = entry.UserTime.QuadPart / 10000;
+        d->systemTime = entry.KernelTime.QuadPart / 10000;
+        d->residentSetSize = qint64(entry.WorkingSetSize);
+        if (entry.CreateTime.QuadPart > 0) {
+            d->startTime = QDateTime::fromMSecsSinceEpoch((entry.CreateTime.QuadPart - s_fileTimeEpochOffset) / 10000);
+        }
+    }
+    return info;
+}
+
+// Adds the path of the executable and the owner to @p info, as far as @p fields ask for them
+static void addProcessDetails(KProcessInfo &info, ProcessInfoFields fields)
+{
+    if (!(fields & (CommandField | UserField))) {
+        return;
+    }
+    HANDLE handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(info.pid()));
+    if (!handle) {
+        return;
+    }
+    KProcessInfoPrivate *const d = KProcessInfoPrivate::get(info);
+
+    if (fields.testFlag(CommandField)) {
+        WCHAR path[MAX_PATH] = {0};
+        DWORD pathLength = MAX_PATH;
+        if (queryFullProcessImageName(handle, 0, path, &pathLength)) {
+            d->command = QString::fromWCharArray(path, pathLength);
+        }
+    }
+
+    HANDLE token = nullptr;
+    if (fields.testFlag(UserField) && OpenProcessToken(handle, TOKEN_QUERY, &token)) {
+        DWORD size = 0;
+        GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
+            QByteArray buffer(size, Qt::Uninitialized);
+            auto *user = reinterpret_cast<PTOKEN_USER>(buffer.data());
+            if (GetTokenInformation(token, TokenUser, user, size, &size)) {
+                d->user = ownerNameCache().name(KUserId(user->User.Sid));
+            }
+        }
+        CloseHandle(token);
+    }
+
+    CloseHandle(handle);
+}
+
+/**
+ * Lists the processes with NtQuerySystemInformation(), only the one with @p pid if that
+ * isn't -1, and only those matching @p filter if given. Returns false if that isn't possible.
+ */
+static bool systemProcessList(ProcessInfoFields fields, ProcessListOptions options, qint64 pid, const ProcessFilter *filter, KProcessInfoList &rc)
+{
+    const std::vector<ULONGLONG> buffer = querySystemProcessInformation();
+    if (buffer.empty()) {
+        return false;
+    }
+
+    // The user of a process is only known once it is opened
+    const bool byUser = filter && !filter->user.isEmpty();
+    if (byUser) {
+        fields |= UserField;
+    }
+
+    const char *const data = reinterpret_cast<const char *>(buffer.data());
+    for (ULONG offset = 0;;) {
+        const auto *entry = reinterpret_cast<const SystemProcessInformation *>(data + offset);
+        KProcessInfo info = systemProcessInfo(*entry, fields);
+        if ((pid == -1 || info.pid() == pid) && (!filter || filter->name.isEmpty() || info.name() == filter->name)) {
+            rc.push_back(info);
+        }
+        if (entry->NextEntryOffset == 0) {
+            break;
+        }
+        offset += entry->NextEntryOffset;
+    }
+
+    if (fields & (CommandField | UserField)) {
+        if (options.testFlag(ParallelListing)) {
+            KProcessInfo *const out = rc.data();
+            KParallel::forEachIndex(rc.size(), [&]() {
+                return [&](qsizetype i) {
+                    addProcessDetails(out[i], fields);
+                };
+            });
+        } else {
+            for (KProcessInfo &info : rc) {
+                addProcessDetails(info, fields);
+            }
+        }
+    }
+
+    if (byUser) {
+        rc.erase(std::remove_if(rc.begin(),
+                                rc.end(),
+                                [filter](const KProcessInfo &info) {
+                                    return info.user() != filter->user;
+                                }),
+                 rc.end());
+    }
+    return true;
+}
+
 struct ProcessInfo {
     QString processOwner;
     QString fullPath;
@@ -93,7 +310,19 @@ static inline ProcessInfo winProcessInfo(DWORD processId)
     return pi;
 }
 
-KProcessInfoList KProcessList::processInfoList()
+static KProcessInfo winProcessInfo(const PROCESSENTRY32 &pe)
+{
+    const ProcessInfo processInf = winProcessInfo(pe.th32ProcessID);
+    const QString commandName = QString::fromUtf16(reinterpret_cast<const char16_t *>(pe.szExeFile));
+    if (processInf.fullPath.isEmpty()) {
+        return KProcessInfo(pe.th32ProcessID, commandName, processInf.processOwner);
+    } else {
+        return KProcessInfo(pe.th32ProcessID, processInf.fullPath, commandName, processInf.processOwner);
+    }
+}
+
+// The fallback, opening every process for its path and owner
+static KProcessInfoList toolhelpProcessList(ProcessListOptions options)
 {
     KProcessInfoList rc;
 
@@ -103,22 +332,62 @@ KProcessInfoList KProcessList::processInfoList()
     if (snapshot == INVALID_HANDLE_VALUE)
         return rc;
 
-    for (bool hasNext = Process32First(snapshot, &pe); hasNext; hasNext = Process32Next(snapshot, &pe)) {
-        const ProcessInfo processInf = winProcessInfo(pe.th32ProcessID);
-        const QString commandName = QString::fromUtf16(reinterpret_cast<char16_t *>(pe.szExeFile));
-        if (processInf.fullPath.isEmpty()) {
-            rc.push_back(KProcessInfo(pe.th32ProcessID, commandName, processInf.processOwner));
-        } else {
-            rc.push_back(KProcessInfo(pe.th32ProcessID, processInf.fullPath, commandName, processInf.processOwner));
+    if (options.testFlag(ParallelListing)) {
+        // Taking the snapshot is cheap, opening the processes for their path and owner isn't
+        QList<PROCESSENTRY32> entries;
+        for (bool hasNext = Process32First(snapshot, &pe); hasNext; hasNext = Process32Next(snapshot, &pe)) {
+            entries.append(pe);
+        }
+        rc.resize(entries.size());
+        KProcessInfo *const out = rc.data();
+        KParallel::forEachIndex(entries.size(), [&]() {
+            return [&](qsizetype i) {
+                out[i] = winProcessInfo(entries.at(i));
+            };
+        });
+    } else {
+        for (bool hasNext = Process32First(snapshot, &pe); hasNext; hasNext = Process32Next(snapshot, &pe)) {
+            rc.push_back(winProcessInfo(pe));
         }
     }
     CloseHandle(snapshot);
     return rc;
 }
 
+KProcessInfoList KProcessList::processInfoList()
+{
+    return processInfoList(DefaultFields, NoProcessListOptions);
+}
+
+KProcessInfoList KProcessList::processInfoList(ProcessInfoFields fields)
+{
+    return processInfoList(fields, NoProcessListOptions);
+}
+
+KProcessInfoList KProcessList::processInfoList(ProcessInfoFields fields, ProcessListOptions options)
+{
+    KTRACE_SCOPE("KProcessList::processInfoList");
+    KProcessInfoList rc;
+    if (!systemProcessList(fields, options, -1, nullptr, rc)) {
+        rc = toolhelpProcessList(options);
+    }
+    return rc;
+}
+
 KProcessInfo KProcessList::processInfo(qint64 pid)
 {
-    KProcessInfoList processInfoList = KProcessList::processInfoList();
+    return processInfo(pid, DefaultFields);
+}
+
+KProcessInfo KProcessList::processInfo(qint64 pid, ProcessInfoFields fields)
+{
+    KProcessInfoList processInfoList;
+    if (pid < 0) {
+        return KProcessInfo();
+    }
+    if (!systemProcessList(fields, NoProcessListOptions, pid, nullptr, processInfoList)) {
+        processInfoList = toolhelpProcessList(NoProcessListOptions);
+    }
     auto testProcessIterator = std::find_if(processInfoList.begin(), processInfoList.end(), [pid](const KProcessList::KProcessInfo &info) {
         return info.pid() == pid;
     });
@@ -127,3 +396,17 @@ KProcessInfo KProcessList::processInfo(qint64 pid)
     }
     return KProcessInfo();
 }
+
+// Not available here, Snapshot compares whole process listings instead
+bool KProcessList::processStartTimes(QHash<qint64, quint64> &startTimes)
+{
+    Q_UNUSED(startTimes);
+    return false;
+}
+
+// The names are part of the system information, only the matching processes are opened
+bool KProcessList::filteredProcessInfoList(const ProcessFilter &filter, ProcessInfoFields fields, KProcessInfoList &list)
+{
+    KTRACE_SCOPE("KProcessList::filteredProcessInfoList");
+    return systemProcessList(fields, NoProcessListOptions, -1, &filter, list);
+}
@@ -0,0 +1,349 @@
+/*
+    This file is part of the KDE Frameworks
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#include "kprocessmemoryinfo.h"
+
+#include <QLoggingCategory>
+#include <QSharedData>
+
+Q_DECLARE_LOGGING_CATEGORY(LOG_KPROCESSMEMORYINFO)
+Q_LOGGING_CATEGORY(LOG_KPROCESSMEMORYINFO, "kf.coreaddons.kprocessmemoryinfo", QtWarningMsg)
+
+// clang-format off
+#if defined(Q_OS_WINDOWS)
+    #include <windows.h>    // Windows.h must stay above Pspapi.h
+    #include <psapi.h>
+#elif defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+    #include <QByteArrayView>
+    #include <fcntl.h>
+    #include <unistd.h>
+#elif defined(Q_OS_MACOS)
+    #include <mach/mach.h>
+#elif defined(Q_OS_FREEBSD)
+    #include <sys/types.h>
+    #include <sys/sysctl.h>
+    #include <sys/user.h>
+    #include <unistd.h>
+#endif
+// clang-format on
+
+class KProcessMemoryInfoPrivate : public QSharedData
+{
+public:
+    KProcessMemoryInfoPrivate()
+    {
+    }
+
+    quint64 m_residentSetSize = 0;
+    quint64 m_proportionalSetSize = 0;
+    quint64 m_uniqueSetSize = 0;
+    quint64 m_anonymous = 0;
+    quint64 m_fileBacked = 0;
+    quint64 m_shared = 0;
+    quint64 m_swapped = 0;
+};
+
+KProcessMemoryInfo::KProcessMemoryInfo()
+    : d(new KProcessMemoryInfoPrivate)
+{
+    update();
+}
+
+KProcessMemoryInfo::~KProcessMemoryInfo()
+{
+}
+
+KProcessMemoryInfo::KProcessMemoryInfo(const KProcessMemoryInfo &other)
+    : d(other.d)
+{
+}
+
+KProcessMemoryInfo &KProcessMemoryInfo::operator=(const KProcessMemoryInfo &other)
+{
+    d = other.d;
+    return *this;
+}
+
+bool KProcessMemoryInfo::operator==(const KProcessMemoryInfo &other) const
+{
+    if (this == &other) {
+        return true;
+    }
+    // clang-format off
+    return (d->m_residentSetSize == other.d->m_residentSetSize
+            && d->m_proportionalSetSize == other.d->m_proportionalSetSize
+            && d->m_uniqueSetSize == other.d->m_uniqueSetSize
+            && d->m_anonymous == other.d->m_anonymous
+            && d->m_fileBacked == other.d->m_fileBacked
+            && d->m_shared == other.d->m_shared
+            && d->m_swapped == other.d->m_swapped);
+    // clang-format on
+}
+
+bool KProcessMemoryInfo::operator!=(const KProcessMemoryInfo &other) const
+{
+    return !operator==(other);
+}
+
+bool KProcessMemoryInfo::isNull() const
+{
+    return d->m_residentSetSize == 0;
+}
+
+quint64 KProcessMemoryInfo::residentSetSize() const
+{
+    return d->m_residentSetSize;
+}
+
+quint64 KProcessMemoryInfo::proportionalSetSize() const
+{
+    return d->m_proportionalSetSize;
+}
+
+quint64 KProcessMemoryInfo::uniqueSetSize() const
+{
+    return d->m_uniqueSetSize;
+}
+
+quint64 KProcessMemoryInfo::anonymous() const
+{
+    return d->m_anonymous;
+}
+
+quint64 KProcessMemoryInfo::fileBacked() const
+{
+    return d->m_fileBacked;
+}
+
+quint64 KProcessMemoryInfo::shared() const
+{
+    return d->m_shared;
+}
+
+quint64 KProcessMemoryInfo::swapped() const
+{
+    return d->m_swapped;
+}
+
+#if defined(Q_OS_WINDOWS)
+/*****************************************************************************
+ * Windows
+ ****************************************************************************/
+
+bool KProcessMemoryInfo::update()
+{
+    PROCESS_MEMORY_COUNTERS_EX pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS *>(&pmc), sizeof(pmc))) {
+        return false;
+    }
+
+    // The private bytes are committed memory, some of which may be paged out, so that
+    // they are only an upper bound of the unique set size
+    d->m_residentSetSize = pmc.WorkingSetSize;
+    d->m_uniqueSetSize = std::min<quint64>(pmc.PrivateUsage, pmc.WorkingSetSize);
+    d->m_anonymous = d->m_uniqueSetSize;
+    d->m_fileBacked = pmc.WorkingSetSize - d->m_uniqueSetSize;
+    d->m_shared = d->m_fileBacked;
+    d->m_swapped = pmc.PrivateUsage - d->m_uniqueSetSize;
+
+    return true;
+}
+
+#elif defined(Q_OS_LINUX) || defined(Q_OS_ANDROID)
+/*****************************************************************************
+ * GNU/Linux
+ ****************************************************************************/
+
+// Reads the whole of the small file @p fileName into @p buffer
+static bool readSmallFile(const char *fileName, char *buffer, qsizetype capacity, QByteArrayView &contents)
+{
+    const int fd = ::open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    qsizetype size = 0;
+    ssize_t bytesRead = 0;
+    while (size < capacity && (bytesRead = ::read(fd, buffer + size, capacity - size)) > 0) {
+        size += bytesRead;
+    }
+    ::close(fd);
+    contents = QByteArrayView(buffer, size);
+    return bytesRead >= 0;
+}
+
+// Parses the contents of /proc/self/smaps_rollup, which are lines of "<key>: <value> kB"
+// after a header line, in one pass
+static bool parseSmapsRollup(QByteArrayView smaps, KProcessMemoryInfoPrivate &d)
+{
+    enum Key { Rss, Pss, SharedClean, SharedDirty, PrivateClean, PrivateDirty, Anonymous, Swap, KeyCount };
+    static constexpr QByteArrayView keys[KeyCount] = {
+        "Rss",
+        "Pss",
+        "Shared_Clean",
+        "Shared_Dirty",
+        "Private_Clean",
+        "Private_Dirty",
+        "Anonymous",
+        "Swap",
+    };
+
+    quint64 values[KeyCount] = {};
+    int found = 0;
+    while (!smaps.isEmpty() && found != (1 << KeyCount) - 1) {
+        qsizetype lineEnd = smaps.indexOf('\n');
+        if (lineEnd < 0) {
+            lineEnd = smaps.size();
+        }
+        const QByteArrayView line = smaps.first(lineEnd);
+        smaps = smaps.sliced(qMin(lineEnd + 1, smaps.size()));
+
+        const qsizetype colon = line.indexOf(':');
+        if (colon < 0) {
+            continue;
+        }
+        const QByteArrayView key = line.first(colon);
+        const auto it = std::find_if(std::begin(keys), std::end(keys), [key](QByteArrayView candidate) {
+            return key.compare(candidate) == 0;
+        });
+        if (it == std::end(keys)) {
+            continue;
+        }
+
+        const QByteArrayView value = line.sliced(colon + 1).trimmed();
+        if (!value.endsWith("kB")) {
+            return false;
+        }
+        bool ok = false;
+        values[it - std::begin(keys)] = value.chopped(2).trimmed().toULongLong(&ok) * 1024;
+        if (!ok) {
+            return false;
+        }
+        found |= 1 << (it - std::begin(keys));
+    }
+    if (found != (1 << KeyCount) - 1) {
+        qCWarning(LOG_KPROCESSMEMORYINFO) << "KProcessMemoryInfo: parseSmapsRollup: missing values in /proc/self/smaps_rollup";
+        return false;
+    }
+
+    d.m_residentSetSize = values[Rss];
+    d.m_proportionalSetSize = values[Pss];
+    d.m_uniqueSetSize = values[PrivateClean] + values[PrivateDirty];
+    d.m_anonymous = values[Anonymous];
+    // shared memory (shmem) is not anonymous in the sense of smaps, so it counts as file-backed here
+    d.m_fileBacked = values[Rss] > values[Anonymous] ? values[Rss] - values[Anonymous] : 0;
+    d.m_shared = values[SharedClean] + values[SharedDirty];
+    d.m_swapped = values[Swap];
+
+    return true;
+}
+
+// Parses the contents of /proc/self/statm, which are sizes in pages, as
+// "<size> <resident> <shared> <text> <lib> <data> <dirty>"
+static bool parseStatm(QByteArrayView statm, KProcessMemoryInfoPrivate &d)
+{
+    quint64 values[3] = {};
+    for (quint64 &value : values) {
+        statm = statm.trimmed();
+        qsizetype end = statm.indexOf(' ');
+        if (end < 0) {
+            end = statm.size();
+        }
+        bool ok = false;
+        value = statm.first(end).toULongLong(&ok);
+        if (!ok) {
+            return false;
+        }
+        statm = statm.sliced(end);
+    }
+
+    const quint64 pageSize = ::sysconf(_SC_PAGESIZE);
+    const quint64 resident = values[1] * pageSize;
+    const quint64 shared = std::min(values[2] * pageSize, resident);
+
+    // statm only tells the resident pages backed by files or shared memory, which
+    // may or may not be shared, so everything else is taken as anonymous and unique
+    d.m_residentSetSize = resident;
+    d.m_proportionalSetSize = 0;
+    d.m_uniqueSetSize = resident - shared;
+    d.m_anonymous = resident - shared;
+    d.m_fileBacked = shared;
+    d.m_shared = shared;
+    d.m_swapped = 0;
+
+    return true;
+}
+
+bool KProcessMemoryInfo::update()
+{
+    // smaps_rollup (since Linux 4.14) has all the values, but walks all the
+    // mappings of the process, statm is cheaper but only has some of them
+    char buffer[2048];
+    QByteArrayView contents;
+    if (readSmallFile("/proc/self/smaps_rollup", buffer, sizeof(buffer), contents) && parseSmapsRollup(contents, *d)) {
+        return true;
+    }
+    if (readSmallFile("/proc/self/statm", buffer, sizeof(buffer), contents) && parseStatm(contents, *d)) {
+        return true;
+    }
+    return false;
+}
+
+#elif defined(Q_OS_MACOS)
+/*****************************************************************************
+ * macOS
+ ****************************************************************************/
+
+bool KProcessMemoryInfo::update()
+{
+    task_vm_info_data_t vmInfo;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&vmInfo, &count) != KERN_SUCCESS) {
+        return false;
+    }
+
+    // The physical footprint is what the system accounts to the process, i.e. the
+    // memory it would free on exit, which is the closest to the unique set size
+    d->m_residentSetSize = vmInfo.resident_size;
+    d->m_uniqueSetSize = std::min<quint64>(vmInfo.phys_footprint, vmInfo.resident_size);
+    d->m_anonymous = vmInfo.internal;
+    d->m_fileBacked = vmInfo.external;
+    d->m_shared = vmInfo.resident_size - d->m_uniqueSetSize;
+    d->m_swapped = vmInfo.compressed;
+
+    return true;
+}
+
+#elif defined(Q_OS_FREEBSD)
+/*****************************************************************************
+ * FreeBSD
+ ****************************************************************************/
+
+bool KProcessMemoryInfo::update()
+{
+    struct kinfo_proc proc;
+    size_t len = sizeof(proc);
+    int mib[4] = {CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid()};
+    if (sysctl(mib, 4, &proc, &len, NULL, 0) != 0 || len != sizeof(proc)) {
+        return false;
+    }
+
+    // Only the resident set size is cheaply available
+    d->m_residentSetSize = quint64(proc.ki_rssize) * getpagesize();
+
+    return true;
+}
+
+#else
+/*****************************************************************************
+ * Unsupported platform
+ ****************************************************************************/
+
+bool KProcessMemoryInfo::update()
+{
+    qCWarning(LOG_KPROCESSMEMORYINFO) << "KProcessMemoryInfo: unsupported platform!";
+    return false;
+}
+
+#endif
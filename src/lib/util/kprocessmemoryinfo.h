@@ -0,0 +1,130 @@
+/*
+    This file is part of the KDE Frameworks
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef KPROCESSMEMORYINFO_H
+#define KPROCESSMEMORYINFO_H
+
+#include <QSharedDataPointer>
+
+#include <kcoreaddons_export.h>
+
+class KProcessMemoryInfoPrivate;
+
+/**
+ * @brief The KProcessMemoryInfo class provides an interface to get the memory usage of the current process.
+ *
+ * Where KMemoryInfo describes the memory of the whole system, this describes the share of it
+ * the current process uses, e.g. for deciding how much of its caches to evict.
+ * \code
+ * KProcessMemoryInfo memInfo;
+ * if (!memInfo.isNull() && memInfo.uniqueSetSize() > budget) {
+ *     ...
+ * }
+ * \endcode
+ *
+ * Not every platform tells all of the values, those not known are zero.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KProcessMemoryInfo
+{
+public:
+    ~KProcessMemoryInfo();
+
+    /**
+     * @brief KProcessMemoryInfo
+     * Constructs a class with a snapshot of the memory usage of the current process. If an error occurs, a null object is returned.
+     * @sa isNull.
+     */
+    KProcessMemoryInfo();
+
+    /**
+     * @brief KProcessMemoryInfo
+     * Constructs a copy of the other processmemoryinfo.
+     */
+    KProcessMemoryInfo(const KProcessMemoryInfo &other);
+
+    /**
+     * @brief operator =
+     * Makes a copy of the other processmemoryinfo and returns a reference to the copy.
+     */
+    KProcessMemoryInfo &operator=(const KProcessMemoryInfo &other);
+
+    /**
+     * @brief operator ==
+     * @return @c true if this processmemoryinfo is equal to the other processmemoryinfo, otherwise @c false.
+     */
+    bool operator==(const KProcessMemoryInfo &other) const;
+
+    /**
+     * @brief operator !=
+     * @return @c true if this processmemoryinfo is different from the other processmemoryinfo, otherwise @c false.
+     */
+    bool operator!=(const KProcessMemoryInfo &other) const;
+
+    /**
+     * @brief isNull
+     * @return @c true if the class is null, otherwise @c false.
+     */
+    bool isNull() const;
+
+    /**
+     * @brief residentSetSize
+     * @return The RAM used by the process in bytes, including the pages it shares with other processes.
+     */
+    quint64 residentSetSize() const;
+
+    /**
+     * @brief proportionalSetSize
+     *
+     * The proportional set size counts the pages shared with other processes divided by the
+     * number of processes sharing them, so that it adds up over all processes.
+     * @return The proportional set size in bytes. Only known on Linux.
+     */
+    quint64 proportionalSetSize() const;
+
+    /**
+     * @brief uniqueSetSize
+     *
+     * The unique set size is the RAM used by this process only, which is what would be freed if it exited.
+     * @return The unique set size in bytes.
+     */
+    quint64 uniqueSetSize() const;
+
+    /**
+     * @brief anonymous
+     * @return The RAM used by the process which is not backed by files, e.g. its heap, in bytes.
+     */
+    quint64 anonymous() const;
+
+    /**
+     * @brief fileBacked
+     * @return The RAM used by the process for mapped files in bytes, e.g. for its libraries or KSharedDataCache segments.
+     */
+    quint64 fileBacked() const;
+
+    /**
+     * @brief shared
+     * @return The RAM the process shares with other processes in bytes, e.g. shared libraries and shared memory.
+     */
+    quint64 shared() const;
+
+    /**
+     * @brief swapped
+     * @return The memory of the process which is swapped out in bytes.
+     */
+    quint64 swapped() const;
+
+private:
+    /**
+     * @brief update Refresh the memory information.
+     * @return @c true on success, otherwise @c false.
+     */
+    KCOREADDONS_NO_EXPORT bool update();
+
+    QSharedDataPointer<KProcessMemoryInfoPrivate> d;
+};
+
+#endif // KPROCESSMEMORYINFO_H
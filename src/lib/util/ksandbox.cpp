@@ -52,13 +52,19 @@ KSandbox::ProcessContext KSandbox::makeHostContext(const QProcess &process)
     if (!process.workingDirectory().isEmpty()) {
         args << QStringLiteral("--directory=%1").arg(process.workingDirectory());
     }
-    const auto systemEnvironment = QProcessEnvironment::systemEnvironment().toStringList();
-    const auto processEnvironment = process.processEnvironment().toStringList();
-    for (const auto &variable : processEnvironment) {
-        if (systemEnvironment.contains(variable)) {
-            continue;
+    // An empty environment means the process inherits ours, then there's nothing to forward.
+    // Otherwise only forward what differs from our environment, looked up by name.
+    const QProcessEnvironment processEnvironment = process.processEnvironment();
+    if (!processEnvironment.isEmpty()) {
+        const QProcessEnvironment systemEnvironment = QProcessEnvironment::systemEnvironment();
+        const QStringList keys = processEnvironment.keys();
+        for (const QString &key : keys) {
+            const QString value = processEnvironment.value(key);
+            if (systemEnvironment.contains(key) && systemEnvironment.value(key) == value) {
+                continue;
+            }
+            args << QStringLiteral("--env=%1=%2").arg(key, value);
         }
-        args << QStringLiteral("--env=%1").arg(variable);
     }
     if (!process.program().isEmpty()) { // some callers are cheeky and pass no program but put it into the arguments (e.g. konsole)
         args << process.program();
@@ -8,21 +8,30 @@
 
 #include "kshell.h"
 #include "kshell_p.h"
-#include "kuser.h"
+#include "kuser_p.h"
 
 #include <QDir>
 
 QString KShell::homeDir(const QString &user)
 {
     if (user.isEmpty()) {
-        return QDir::homePath();
+        // Doesn't change while the process runs
+        static const QString s_homePath = QDir::homePath();
+        return s_homePath;
     }
-    return KUser(user).homeDir();
+    // ~user is expanded again and again, and the user database may be a network service
+    return kuserHomeDirCache().name(user);
 }
 
 QString KShell::joinArgs(const QStringList &args)
 {
     QString ret;
+    // enough if no argument needs quoting, which is the common case
+    qsizetype size = 0;
+    for (const auto &arg : args) {
+        size += arg.size() + 1;
+    }
+    ret.reserve(size);
     for (const auto &arg : args) {
         if (!ret.isEmpty()) {
             ret.append(QLatin1Char(' '));
@@ -68,3 +77,32 @@ QString KShell::tildeCollapse(const QString &path)
     }
     return path;
 }
+
+QStringList KShell::SplitArgsResult::toStringList() const
+{
+    QStringList ret;
+    ret.reserve(m_words.size());
+    for (QStringView word : m_words) {
+        ret.append(word.toString());
+    }
+    return ret;
+}
+
+void KShell::SplitArgsResult::clear()
+{
+    // keeps the capacity of the lists for the next command
+    m_words.clear();
+    m_strings.clear();
+}
+
+void KShell::SplitArgsResult::addView(QStringView word)
+{
+    m_words.append(word);
+}
+
+void KShell::SplitArgsResult::addString(QString &&word)
+{
+    // the data of the strings doesn't move when the list grows
+    m_strings.append(std::move(word));
+    m_words.append(m_strings.constLast());
+}
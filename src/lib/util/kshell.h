@@ -137,6 +137,64 @@ enum Errors {
  */
 KCOREADDONS_EXPORT QStringList splitArgs(const QString &cmd, Options flags = NoOptions, Errors *err = nullptr);
 
+class SplitArgsResult;
+
+/**
+ * Splits @p cmd like splitArgs(const QString &, Options, Errors *), but
+ * without copying the words which need no unquoting.
+ *
+ * This is meant for splitting many commands, e.g. the Exec lines of all
+ * desktop files. Reusing the same @p result for all of them avoids allocating
+ * a new list for each.
+ *
+ * On Windows, all words are copied.
+ *
+ * @param cmd the command to split
+ * @param result the words, replacing the previous contents; empty if an error
+ *  occurred
+ * @param flags operation flags, see \ref Option
+ * @return a status code, see \ref Errors
+ * @since 6.0
+ */
+KCOREADDONS_EXPORT Errors splitArgs(QStringView cmd, SplitArgsResult &result, Options flags = NoOptions);
+
+/**
+ * The words split from a command by splitArgs(QStringView, SplitArgsResult &, Options).
+ *
+ * Words which need no unquoting are views on the command, so they are only
+ * valid as long as the command is. The other words are views on strings
+ * owned by this object, and valid until it is reused or destroyed.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT SplitArgsResult
+{
+public:
+    /**
+     * @return the unquoted words
+     */
+    const QList<QStringView> &words() const
+    {
+        return m_words;
+    }
+
+    /**
+     * @return copies of the unquoted words
+     */
+    QStringList toStringList() const;
+
+private:
+    friend Errors splitArgs(QStringView cmd, SplitArgsResult &result, Options flags);
+
+    void clear();
+    void addView(QStringView word);
+    void addString(QString &&word);
+
+    QList<QStringView> m_words;
+    // the words which had to be unquoted, which m_words refers to
+    QStringList m_strings;
+};
+
 /**
  * Quotes and joins @p args together according to system shell rules.
  *
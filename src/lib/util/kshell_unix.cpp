@@ -14,6 +14,9 @@
 #include <QChar>
 #include <QStringList>
 
+#include <algorithm>
+#include <array>
+
 static int fromHex(QChar cUnicode)
 {
     char c = cUnicode.toLatin1();
@@ -43,10 +46,52 @@ inline static bool isMeta(QChar cUnicode)
     return (c < sizeof(iqm) * 8) && (iqm[c / 8] & (1 << (c & 7)));
 }
 
-QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
+// Classes of the characters which end a word without any quoting, see the fast path in splitArgs()
+enum CharClass : uchar {
+    PlainChar = 0,
+    SpaceChar = 1,
+    QuoteChar = 2,
+    MetaChar = 4,
+};
+
+static constexpr std::array<uchar, 128> charClasses()
 {
-    QStringList ret;
+    std::array<uchar, 128> classes = {};
+    classes[' '] = SpaceChar;
+    // '$' only quotes when followed by an apostrophe, it is left to the slow path anyway
+    for (char c : {'\\', '\'', '"', '$'}) {
+        classes[uchar(c)] |= QuoteChar;
+    }
+    for (char c : {'\\', '\'', '"', '$', '`', '<', '>', '|', ';', '&', '(', ')', '{', '}', '*', '?', '#', '[', ']'}) {
+        classes[uchar(c)] |= MetaChar;
+    }
+    return classes;
+}
+
+static constexpr std::array<uchar, 128> s_charClasses = charClasses();
+
+// The end of the run of characters in @p args starting at @p pos that are not of any class in @p stopClasses
+static int plainRunEnd(QStringView args, int pos, uchar stopClasses)
+{
+    const int length = args.length();
+    const QChar *data = args.data();
+    while (pos < length) {
+        const char16_t c = data[pos].unicode();
+        if (c < s_charClasses.size() && (s_charClasses[c] & stopClasses)) {
+            break;
+        }
+        ++pos;
+    }
+    return pos;
+}
+
+// Splits @p args, passing the words to @p addView if they are parts of @p args, or to @p addString if they had to be unquoted
+template<typename AddView, typename AddString>
+static KShell::Errors splitArgsImpl(QStringView args, KShell::Options flags, AddView addView, AddString addString)
+{
+    using namespace KShell;
     bool firstword = flags & AbortOnMeta;
+    const uchar stopClasses = SpaceChar | QuoteChar | ((flags & AbortOnMeta) ? MetaChar : 0);
 
     for (int pos = 0;;) {
         QChar c;
@@ -54,7 +99,7 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
             if (pos >= args.length()) {
                 goto okret;
             }
-            c = args.unicode()[pos++];
+            c = args[pos++];
         } while (c == QLatin1Char(' '));
         QString cret;
         if ((flags & TildeExpand) && c == QLatin1Char('~')) {
@@ -63,7 +108,7 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                 if (pos >= args.length()) {
                     break;
                 }
-                c = args.unicode()[pos];
+                c = args[pos];
                 if (c == QLatin1Char('/') || c == QLatin1Char(' ')) {
                     break;
                 }
@@ -76,19 +121,19 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                     goto metaerr;
                 }
             }
-            QString ccret = homeDir(args.mid(opos, pos - opos));
+            QString ccret = homeDir(args.mid(opos, pos - opos).toString());
             if (ccret.isEmpty()) {
                 pos = opos;
                 c = QLatin1Char('~');
                 goto notilde;
             }
             if (pos >= args.length()) {
-                ret += ccret;
+                addString(std::move(ccret));
                 goto okret;
             }
             pos++;
             if (c == QLatin1Char(' ')) {
-                ret += ccret;
+                addString(std::move(ccret));
                 firstword = false;
                 continue;
             }
@@ -104,10 +149,10 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                 do {
                     if (pos2 >= args.length()) {
                         // Exactly one word
-                        ret += args.mid(pos - 1);
+                        addView(args.mid(pos - 1));
                         goto okret;
                     }
-                    cc = args.unicode()[pos2++];
+                    cc = args[pos2++];
                 } while (cc == QLatin1Char('_') /* clang-format off */
                          || (cc >= QLatin1Char('A') && cc <= QLatin1Char('Z'))
                          || (cc >= QLatin1Char('a') && cc <= QLatin1Char('z'))
@@ -118,6 +163,22 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
             }
         }
     notilde:
+        if (cret.isEmpty()) {
+            // Fast path: most words have no quoting at all, so they are
+            // passed on as they are, without copying them char by char
+            const int start = pos - 1;
+            const int end = plainRunEnd(args, start, stopClasses);
+            if (end >= args.length() || args[end] == QLatin1Char(' ')) {
+                addView(args.mid(start, end - start));
+                pos = end;
+                firstword = false;
+                continue;
+            }
+            // the unquoted start is kept, and the rest goes the slow path
+            cret = args.mid(start, end - start).toString();
+            c = args[end];
+            pos = end + 1;
+        }
         do {
             if (c == QLatin1Char('\'')) {
                 int spos = pos;
@@ -125,15 +186,15 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                     if (pos >= args.length()) {
                         goto quoteerr;
                     }
-                    c = args.unicode()[pos++];
+                    c = args[pos++];
                 } while (c != QLatin1Char('\''));
-                cret += QStringView(args).mid(spos, pos - spos - 1);
+                cret += args.mid(spos, pos - spos - 1);
             } else if (c == QLatin1Char('"')) {
                 for (;;) {
                     if (pos >= args.length()) {
                         goto quoteerr;
                     }
-                    c = args.unicode()[pos++];
+                    c = args[pos++];
                     if (c == QLatin1Char('"')) {
                         break;
                     }
@@ -141,7 +202,7 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                         if (pos >= args.length()) {
                             goto quoteerr;
                         }
-                        c = args.unicode()[pos++];
+                        c = args[pos++];
                         if (c != QLatin1Char('"') //
                             && c != QLatin1Char('\\') //
                             && !((flags & AbortOnMeta) && (c == QLatin1Char('$') || c == QLatin1Char('`')))) {
@@ -152,13 +213,13 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                     }
                     cret += c;
                 }
-            } else if (c == QLatin1Char('$') && pos < args.length() && args.unicode()[pos] == QLatin1Char('\'')) {
+            } else if (c == QLatin1Char('$') && pos < args.length() && args[pos] == QLatin1Char('\'')) {
                 pos++;
                 for (;;) {
                     if (pos >= args.length()) {
                         goto quoteerr;
                     }
-                    c = args.unicode()[pos++];
+                    c = args[pos++];
                     if (c == QLatin1Char('\'')) {
                         break;
                     }
@@ -166,7 +227,7 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                         if (pos >= args.length()) {
                             goto quoteerr;
                         }
-                        c = args.unicode()[pos++];
+                        c = args[pos++];
                         switch (c.toLatin1()) {
                         case 'a':
                             cret += QLatin1Char('\a');
@@ -199,18 +260,18 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                             if (pos >= args.length()) {
                                 goto quoteerr;
                             }
-                            cret += QChar::fromLatin1(args.unicode()[pos++].toLatin1() & 31);
+                            cret += QChar::fromLatin1(args[pos++].toLatin1() & 31);
                             break;
                         case 'x': {
                             if (pos >= args.length()) {
                                 goto quoteerr;
                             }
-                            int hv = fromHex(args.unicode()[pos++]);
+                            int hv = fromHex(args[pos++]);
                             if (hv < 0) {
                                 goto quoteerr;
                             }
                             if (pos < args.length()) {
-                                int hhv = fromHex(args.unicode()[pos]);
+                                int hhv = fromHex(args[pos]);
                                 if (hhv > 0) {
                                     hv = hv * 16 + hhv;
                                     pos++;
@@ -227,7 +288,7 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                                     if (pos >= args.length()) {
                                         break;
                                     }
-                                    c = args.unicode()[pos];
+                                    c = args[pos];
                                     if (c.toLatin1() < '0' || c.toLatin1() > '7') {
                                         break;
                                     }
@@ -250,7 +311,7 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
                     if (pos >= args.length()) {
                         goto quoteerr;
                     }
-                    c = args.unicode()[pos++];
+                    c = args[pos++];
                 } else if ((flags & AbortOnMeta) && isMeta(c)) {
                     goto metaerr;
                 }
@@ -259,31 +320,63 @@ QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
             if (pos >= args.length()) {
                 break;
             }
-            c = args.unicode()[pos++];
+            c = args[pos++];
         } while (c != QLatin1Char(' '));
-        ret += cret;
+        addString(std::move(cret));
         firstword = false;
     }
 
 okret:
-    if (err) {
-        *err = NoError;
-    }
-    return ret;
+    return NoError;
 
 quoteerr:
-    if (err) {
-        *err = BadQuoting;
-    }
-    return QStringList();
+    return BadQuoting;
 
 metaerr:
+    return FoundMeta;
+}
+
+QStringList KShell::splitArgs(const QString &args, Options flags, Errors *err)
+{
+    QStringList ret;
+    const Errors error = splitArgsImpl(
+        args,
+        flags,
+        [&ret, &args](QStringView word) {
+            // a word which is all of the command can share its data
+            ret.append(word.size() == args.size() ? args : word.toString());
+        },
+        [&ret](QString &&word) {
+            ret.append(std::move(word));
+        });
     if (err) {
-        *err = FoundMeta;
+        *err = error;
+    }
+    if (error != NoError) {
+        ret.clear();
     }
-    return QStringList();
+    return ret;
+}
+
+KShell::Errors KShell::splitArgs(QStringView cmd, SplitArgsResult &result, Options flags)
+{
+    result.clear();
+    const Errors error = splitArgsImpl(
+        cmd,
+        flags,
+        [&result](QStringView word) {
+            result.addView(word);
+        },
+        [&result](QString &&word) {
+            result.addString(std::move(word));
+        });
+    if (error != NoError) {
+        result.clear();
+    }
+    return error;
 }
 
+
 inline static bool isSpecial(QChar cUnicode)
 {
     static const uchar iqm[] = {0xff, 0xff, 0xff, 0xff, 0xdf, 0x07, 0x00, 0xd8, 0x00, 0x00, 0x00, 0x38, 0x01, 0x00, 0x00, 0x78}; // 0-32 \'"$`<>|;&(){}*?#!~[]
@@ -297,11 +390,29 @@ QString KShell::quoteArg(const QString &arg)
     if (!arg.length()) {
         return QStringLiteral("''");
     }
-    for (int i = 0; i < arg.length(); i++) {
-        if (isSpecial(arg.unicode()[i])) {
-            QChar q(QLatin1Char('\''));
-            return q + QString(arg).replace(q, QLatin1String("'\\''")) + q;
+    // Most arguments need no quoting, they are returned without copying
+    const QChar *begin = arg.constData();
+    const QChar *end = begin + arg.size();
+    const QChar *special = std::find_if(begin, end, isSpecial);
+    if (special == end) {
+        return arg;
+    }
+
+    // Each apostrophe becomes '\'', so the size of the result is known up front
+    const QChar q(QLatin1Char('\''));
+    const qsizetype quotes = std::count(special, end, q);
+    QString ret(arg.size() + 2 + 3 * quotes, Qt::Uninitialized);
+    QChar *out = ret.data();
+    *out++ = q;
+    out = std::copy(begin, special, out);
+    for (const QChar *it = special; it != end; ++it) {
+        if (*it == q) {
+            *out++ = q;
+            *out++ = QLatin1Char('\\');
+            *out++ = q;
         }
+        *out++ = *it;
     }
-    return arg;
+    *out = q;
+    return ret;
 }
@@ -172,6 +172,18 @@ QStringList KShell::splitArgs(const QString &_args, Options flags, Errors *err)
     // not reached
 }
 
+KShell::Errors KShell::splitArgs(QStringView cmd, SplitArgsResult &result, Options flags)
+{
+    // cmd may consume quotes before the word splitting, so all words are copies here
+    result.clear();
+    Errors error = NoError;
+    const QStringList words = splitArgs(cmd.toString(), flags, &error);
+    for (QString word : words) {
+        result.addString(std::move(word));
+    }
+    return error;
+}
+
 QString KShell::quoteArgInternal(const QString &arg, bool _inquote)
 {
     // Escape quotes, preceding backslashes are doubled. Surround with quotes.
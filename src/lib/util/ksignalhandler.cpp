@@ -10,26 +10,48 @@
 #include <QTimer>
 
 #ifndef Q_OS_WIN
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <signal.h>
 #include <sys/socket.h>
 #include <unistd.h>
+
+// What the signal handler passes through the socket, one per signal
+struct KSignalHandlerRecord {
+    int signal;
+    int code;
+    pid_t pid;
+    uid_t uid;
+    int status;
+};
 #endif
 
 class KSignalHandlerPrivate : public QObject
 {
 public:
-    static void signalHandler(int signal);
+#ifndef Q_OS_WIN
+    static void signalHandler(int signal, siginfo_t *info, void *context);
+#endif
     void handleSignal();
 
     QSet<int> m_signalsRegistered;
     static int signalFd[2];
+#ifndef Q_OS_WIN
+    // Signals that didn't fit into the socket anymore
+    static std::atomic<quint64> s_droppedSignals;
+    QByteArray m_partialRecord;
+#endif
     QSocketNotifier *m_handler = nullptr;
 
     KSignalHandler *q;
 };
 int KSignalHandlerPrivate::signalFd[2];
+#ifndef Q_OS_WIN
+std::atomic<quint64> KSignalHandlerPrivate::s_droppedSignals = 0;
+#endif
 
 KSignalHandler::KSignalHandler()
     : d(new KSignalHandlerPrivate)
@@ -44,6 +66,9 @@ KSignalHandler::KSignalHandler()
     // ensure the sockets are not leaked to child processes, SOCK_CLOEXEC not supported on macOS
     fcntl(KSignalHandlerPrivate::signalFd[0], F_SETFD, FD_CLOEXEC);
     fcntl(KSignalHandlerPrivate::signalFd[1], F_SETFD, FD_CLOEXEC);
+    // the signal handler must never block on a full socket, and we read as much as there is
+    fcntl(KSignalHandlerPrivate::signalFd[0], F_SETFL, fcntl(KSignalHandlerPrivate::signalFd[0], F_GETFL) | O_NONBLOCK);
+    fcntl(KSignalHandlerPrivate::signalFd[1], F_SETFL, fcntl(KSignalHandlerPrivate::signalFd[1], F_GETFL) | O_NONBLOCK);
 
     QTimer::singleShot(0, [this] {
         d->m_handler = new QSocketNotifier(KSignalHandlerPrivate::signalFd[1], QSocketNotifier::Read, this);
@@ -67,33 +92,77 @@ void KSignalHandler::watchSignal(int signalToTrack)
 {
     d->m_signalsRegistered.insert(signalToTrack);
 #ifndef Q_OS_WIN
-    signal(signalToTrack, KSignalHandlerPrivate::signalHandler);
+    struct sigaction action = {};
+    action.sa_sigaction = KSignalHandlerPrivate::signalHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(signalToTrack, &action, nullptr);
 #endif
 }
 
-void KSignalHandlerPrivate::signalHandler(int signal)
-{
 #ifndef Q_OS_WIN
-    const int ret = ::write(signalFd[0], &signal, sizeof(signal));
-    if (ret != sizeof(signal)) {
-        qCWarning(KCOREADDONS_DEBUG) << "signalHandler couldn't write for signal" << strsignal(signal) << " Got error:" << strerror(errno);
+void KSignalHandlerPrivate::signalHandler(int signal, siginfo_t *info, void *context)
+{
+    Q_UNUSED(context);
+    // Only async-signal-safe calls in here
+    const int savedErrno = errno;
+    KSignalHandlerRecord record = {signal, 0, 0, 0, 0};
+    if (info) {
+        record.code = info->si_code;
+        record.pid = info->si_pid;
+        record.uid = info->si_uid;
+        if (signal == SIGCHLD) {
+            record.status = info->si_status;
+        }
     }
-#endif
+    if (::write(signalFd[0], &record, sizeof(record)) != sizeof(record)) {
+        // Too many signals at once, at least don't lose the signal itself
+        if (signal > 0 && signal < 64) {
+            s_droppedSignals.fetch_or(quint64(1) << signal, std::memory_order_relaxed);
+        }
+    }
+    errno = savedErrno;
 }
+#endif
 
 void KSignalHandlerPrivate::handleSignal()
 {
 #ifndef Q_OS_WIN
-    m_handler->setEnabled(false);
-    int signal;
-    const int ret = ::read(KSignalHandlerPrivate::signalFd[1], &signal, sizeof(signal));
-    if (ret != sizeof(signal)) {
+    // Handle as many signals as there are with each read
+    char buffer[64 * sizeof(KSignalHandlerRecord)];
+    const qsizetype partialSize = m_partialRecord.size();
+    memcpy(buffer, m_partialRecord.constData(), partialSize);
+    ssize_t ret;
+    do {
+        ret = ::read(KSignalHandlerPrivate::signalFd[1], buffer + partialSize, sizeof(buffer) - partialSize);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         qCWarning(KCOREADDONS_DEBUG) << "handleSignal couldn't read signal for fd" << KSignalHandlerPrivate::signalFd[1] << " Got error:" << strerror(errno);
+        m_handler->setEnabled(false);
         return;
     }
-    m_handler->setEnabled(true);
 
-    Q_EMIT q->signalReceived(signal);
+    QList<KSignalHandler::SignalInfo> infos;
+    const qsizetype size = partialSize + std::max<ssize_t>(ret, 0);
+    qsizetype offset = 0;
+    for (; offset + qsizetype(sizeof(KSignalHandlerRecord)) <= size; offset += sizeof(KSignalHandlerRecord)) {
+        KSignalHandlerRecord record;
+        memcpy(&record, buffer + offset, sizeof(record));
+        infos.append({record.signal, record.code, record.pid, record.uid, record.status});
+    }
+    m_partialRecord = QByteArray(buffer + offset, size - offset);
+
+    const quint64 droppedSignals = s_droppedSignals.exchange(0, std::memory_order_relaxed);
+    for (int signal = 1; signal < 64; ++signal) {
+        if (droppedSignals & (quint64(1) << signal)) {
+            infos.append({signal});
+        }
+    }
+
+    for (const KSignalHandler::SignalInfo &info : std::as_const(infos)) {
+        Q_EMIT q->signalInfoReceived(info);
+        Q_EMIT q->signalReceived(info.signal);
+    }
 #endif
 }
 
@@ -34,6 +34,35 @@ class KCOREADDONS_EXPORT KSignalHandler : public QObject
 public:
     ~KSignalHandler() override;
 
+    /**
+     * What the system told about a received signal.
+     *
+     * @see signalInfoReceived
+     * @since 6.0
+     */
+    struct SignalInfo {
+        /**
+         * The signal number
+         */
+        int signal = 0;
+        /**
+         * How the signal came about, the @c si_code of the signal (e.g. @c SI_USER or, for @c SIGCHLD, @c CLD_EXITED)
+         */
+        int code = 0;
+        /**
+         * The process that sent the signal, or for @c SIGCHLD the child whose state changed. 0 if unknown
+         */
+        qint64 pid = 0;
+        /**
+         * The real user id of the process that sent the signal, if @ref pid is known
+         */
+        uint uid = 0;
+        /**
+         * For @c SIGCHLD the exit code of the child, or the signal that terminated or stopped it
+         */
+        int status = 0;
+    };
+
     /**
      * Adds @p signal to be watched for. Once the process is notified about this signal, @m signalReceived will be emitted with the same @p signal as an
      * argument.
@@ -57,6 +86,20 @@ Q_SIGNALS:
      */
     void signalReceived(int signal);
 
+    /**
+     * Notifies that @p info.signal is emitted, along with what is known about its sender.
+     *
+     * It is emitted right before @m signalReceived for the same signal. This allows e.g. to find
+     * out which child finished when receiving @c SIGCHLD, without having to ask every child.
+     *
+     * When signals arrive faster than they can be handled, some of them might only be reported
+     * with their signal number, the other fields are 0 then.
+     *
+     * @see watchSignal
+     * @since 6.0
+     */
+    void signalInfoReceived(const KSignalHandler::SignalInfo &info);
+
 private:
     KCOREADDONS_NO_EXPORT KSignalHandler();
 
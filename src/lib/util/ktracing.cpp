@@ -0,0 +1,134 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "ktracing_p.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+
+#include <vector>
+
+std::atomic<KTracingSink *> KTracing::s_sink = nullptr;
+
+KTracingSink::~KTracingSink() = default;
+
+void KTracingSink::install(KTracingSink *sink)
+{
+    KTracing::s_sink.store(sink, std::memory_order_release);
+}
+
+KTracingSink *KTracingSink::installed()
+{
+    return KTracing::s_sink.load(std::memory_order_acquire);
+}
+
+bool KTracingSink::isAvailable()
+{
+    return HAVE_TRACING;
+}
+
+class KTracingRingBufferPrivate
+{
+public:
+    explicit KTracingRingBufferPrivate(int capacity)
+        : capacity(capacity)
+    {
+        clock.start();
+    }
+
+    struct Event {
+        const char *name = nullptr;
+        const char *argumentName = nullptr;
+        QVariant argument;
+        // in microseconds since the buffer was created
+        qint64 timestamp = 0;
+        quintptr thread = 0;
+        bool isBegin = false;
+    };
+
+    void append(Event &&event)
+    {
+        event.timestamp = clock.nsecsElapsed() / 1000;
+        event.thread = quintptr(QThread::currentThreadId());
+
+        QMutexLocker locker(&mutex);
+        if (events.size() < std::size_t(capacity)) {
+            events.push_back(std::move(event));
+        } else {
+            events[next] = std::move(event);
+            next = (next + 1) % events.size();
+        }
+    }
+
+    const int capacity;
+    QElapsedTimer clock;
+    mutable QMutex mutex;
+    // In order from index next on, once full
+    std::vector<Event> events;
+    std::size_t next = 0;
+};
+
+KTracingRingBuffer::KTracingRingBuffer(int capacity)
+    : d(new KTracingRingBufferPrivate(qMax(capacity, 1)))
+{
+}
+
+KTracingRingBuffer::~KTracingRingBuffer()
+{
+    Q_ASSERT(installed() != this);
+}
+
+void KTracingRingBuffer::begin(const char *name, const char *argumentName, const QVariant &argument)
+{
+    d->append({name, argumentName, argument, 0, 0, true});
+}
+
+void KTracingRingBuffer::end(const char *name)
+{
+    d->append({name, nullptr, QVariant(), 0, 0, false});
+}
+
+int KTracingRingBuffer::size() const
+{
+    QMutexLocker locker(&d->mutex);
+    return int(d->events.size());
+}
+
+QByteArray KTracingRingBuffer::toChromeTrace() const
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray events;
+
+    QMutexLocker locker(&d->mutex);
+    for (std::size_t i = 0; i < d->events.size(); ++i) {
+        const KTracingRingBufferPrivate::Event &event = d->events[(d->next + i) % d->events.size()];
+        QJsonObject object{
+            {QStringLiteral("name"), QString::fromLatin1(event.name)},
+            {QStringLiteral("cat"), QStringLiteral("kcoreaddons")},
+            {QStringLiteral("ph"), event.isBegin ? QStringLiteral("B") : QStringLiteral("E")},
+            {QStringLiteral("ts"), event.timestamp},
+            {QStringLiteral("pid"), pid},
+            {QStringLiteral("tid"), qint64(event.thread)},
+        };
+        if (event.argumentName) {
+            object.insert(QStringLiteral("args"), QJsonObject{{QString::fromLatin1(event.argumentName), QJsonValue::fromVariant(event.argument)}});
+        }
+        events.append(object);
+    }
+    return QJsonDocument(QJsonObject{{QStringLiteral("traceEvents"), events}}).toJson(QJsonDocument::Compact);
+}
+
+void KTracingRingBuffer::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->events.clear();
+    d->next = 0;
+}
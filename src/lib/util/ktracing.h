@@ -0,0 +1,133 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KTRACING_H
+#define KTRACING_H
+
+#include <kcoreaddons_export.h>
+
+#include <QByteArray>
+#include <QVariant>
+
+#include <memory>
+
+class KTracingRingBufferPrivate;
+
+/**
+ * @class KTracingSink ktracing.h KTracing
+ *
+ * Receives the begin and end events of the expensive operations of KCoreAddons,
+ * for showing the time spent in the library in traces of profilers like Perfetto or VTune.
+ * Adapters feeding e.g. the Perfetto SDK or ITT implement begin() and end().
+ *
+ * The events are only emitted if KCoreAddons was built with the ENABLE_TRACING CMake option,
+ * otherwise the operations aren't annotated at all, see isAvailable(). The traced operations are
+ * @li "KPluginMetaData::findPlugins", with the "namespace"
+ * @li "KSharedDataCache::lock", waiting for the lock of the cache named "cache"
+ * @li "KSharedDataCache::defragment", with the "maxPagesMoved", or 0 if unbounded
+ * @li "KDirWatch::rescan", with the number of watched "entries"
+ * @li "KProcessList::processInfoList"
+ * @li "KTextToHTML::convertToHtml", with the "length" of the text
+ *
+ * @code
+ * static KTracingRingBuffer buffer;
+ * KTracingSink::install(&buffer);
+ * ...
+ * QFile file(QStringLiteral("kcoreaddons.json"));
+ * if (file.open(QIODevice::WriteOnly)) {
+ *     file.write(buffer.toChromeTrace());
+ * }
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KTracingSink
+{
+public:
+    virtual ~KTracingSink();
+
+    /**
+     * Called when the operation @p name starts, in the thread running it, which may be any thread.
+     *
+     * @param name the operation, a string literal
+     * @param argumentName what @p argument is, a string literal, or @c nullptr if there is no argument
+     * @param argument describes the operation, e.g. the plugin namespace searched
+     */
+    virtual void begin(const char *name, const char *argumentName, const QVariant &argument) = 0;
+
+    /**
+     * Called when the operation @p name, the last one begun in the calling thread, ends.
+     */
+    virtual void end(const char *name) = 0;
+
+    /**
+     * Makes @p sink receive the events of all threads, replacing the previously installed sink.
+     * The operations running meanwhile still end in the sink they began in, so an uninstalled
+     * sink may only be deleted once these are done.
+     *
+     * @param sink the sink, not owned, or @c nullptr for not tracing
+     */
+    static void install(KTracingSink *sink);
+
+    /**
+     * @return the installed sink, or @c nullptr
+     */
+    static KTracingSink *installed();
+
+    /**
+     * @return whether KCoreAddons was built with tracing, otherwise no events are emitted
+     */
+    static bool isAvailable();
+};
+
+/**
+ * @class KTracingRingBuffer ktracing.h KTracing
+ *
+ * A KTracingSink keeping the most recent events in memory, to be written out
+ * in the Chrome trace event format, which can be viewed with e.g. Perfetto or chrome://tracing.
+ *
+ * Once full, every new event replaces the oldest one, so that the trace may start
+ * with the ends of operations whose beginnings were dropped.
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KTracingRingBuffer : public KTracingSink
+{
+public:
+    /**
+     * Creates a new KTracingRingBuffer keeping up to @p capacity events
+     */
+    explicit KTracingRingBuffer(int capacity = 65536);
+
+    /**
+     * Destroys a KTracingRingBuffer. It must not be installed anymore.
+     */
+    ~KTracingRingBuffer() override;
+
+    void begin(const char *name, const char *argumentName, const QVariant &argument) override;
+    void end(const char *name) override;
+
+    /**
+     * @return the number of events kept
+     */
+    int size() const;
+
+    /**
+     * @return the events kept in the Chrome trace event format, as a JSON document.
+     * Every operation is a pair of begin and end events in the row of its thread.
+     */
+    QByteArray toChromeTrace() const;
+
+    /**
+     * Forgets the events kept.
+     */
+    void clear();
+
+private:
+    std::unique_ptr<KTracingRingBufferPrivate> const d;
+};
+
+#endif
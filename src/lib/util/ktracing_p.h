@@ -0,0 +1,68 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KTRACING_P_H
+#define KTRACING_P_H
+
+#include "ktracing.h"
+
+#include <config-util.h> // HAVE_TRACING
+
+#include <atomic>
+
+namespace KTracing
+{
+// The installed KTracingSink
+extern std::atomic<KTracingSink *> s_sink;
+
+/// Emits the begin and end events of the scope to the installed sink, if any
+class Scope
+{
+public:
+    explicit Scope(const char *name)
+        : m_sink(s_sink.load(std::memory_order_acquire))
+        , m_name(name)
+    {
+        if (m_sink) {
+            m_sink->begin(name, nullptr, QVariant());
+        }
+    }
+    /// @p argument is only called when tracing
+    template<typename Argument>
+    Scope(const char *name, const char *argumentName, Argument &&argument)
+        : m_sink(s_sink.load(std::memory_order_acquire))
+        , m_name(name)
+    {
+        if (m_sink) {
+            m_sink->begin(name, argumentName, QVariant::fromValue(argument()));
+        }
+    }
+    ~Scope()
+    {
+        if (m_sink) {
+            m_sink->end(m_name);
+        }
+    }
+    Q_DISABLE_COPY(Scope)
+
+private:
+    KTracingSink *const m_sink;
+    const char *const m_name;
+};
+}
+
+// Annotates the rest of the enclosing scope as the operation @p name, optionally
+// described by @p argument, which is only evaluated when tracing. Compiled out
+// unless built with ENABLE_TRACING.
+#if HAVE_TRACING
+#define KTRACE_SCOPE(name) const KTracing::Scope ktraceScope(name)
+#define KTRACE_SCOPE_ARG(name, argumentName, argument) const KTracing::Scope ktraceScope(name, argumentName, [&]() { return argument; })
+#else
+#define KTRACE_SCOPE(name) static_cast<void>(0)
+#define KTRACE_SCOPE_ARG(name, argumentName, argument) static_cast<void>(0)
+#endif
+
+#endif
@@ -402,6 +402,21 @@ public:
      */
     static QStringList allUserNames(uint maxCount = KCOREADDONS_UINT_MAX);
 
+    /**
+     * Resolves the login names of many users at once, e.g. the owners of the files
+     * listed in a directory.
+     *
+     * The names are cached for a while and shared by all threads, so that every user
+     * is only looked up once, which is much faster when the user database is on the network.
+     * Creating a KUser for every id instead queries the user database each time.
+     *
+     * @param ids the ids of the users
+     * @return the login names of the users in the same order as @p ids, with an empty
+     *         string for each id which doesn't belong to a user
+     * @since 6.0
+     */
+    static QStringList namesForIds(const QList<KUserId> &ids);
+
 private:
     QExplicitlySharedDataPointer<class KUserPrivate> d;
 };
@@ -545,6 +560,20 @@ public:
      */
     static QStringList allGroupNames(uint maxCount = KCOREADDONS_UINT_MAX);
 
+    /**
+     * Resolves the names of many groups at once, e.g. the groups of the files
+     * listed in a directory.
+     *
+     * The names are cached for a while and shared by all threads, like those of
+     * KUser::namesForIds().
+     *
+     * @param ids the ids of the groups
+     * @return the names of the groups in the same order as @p ids, with an empty
+     *         string for each id which doesn't belong to a group
+     * @since 6.0
+     */
+    static QStringList namesForIds(const QList<KGroupId> &ids);
+
 private:
     QSharedDataPointer<class KUserGroupPrivate> d;
 };
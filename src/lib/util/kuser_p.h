@@ -0,0 +1,157 @@
+/*
+    KUser - represent a user/account
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KUSER_P_H
+#define KUSER_P_H
+
+#include "kuser.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+template<typename Id>
+inline bool kidNameCacheKeyIsValid(const Id &id)
+{
+    return id.isValid();
+}
+
+inline bool kidNameCacheKeyIsValid(const QString &name)
+{
+    return !name.isEmpty();
+}
+
+/**
+ * A thread-safe cache of the names of user or group ids, or of other
+ * attributes looked up in the user database, like the home directories
+ * of login names.
+ *
+ * Users and groups may come from a network service such as LDAP, so every
+ * lookup can be slow. The names are kept for a little while only, so that
+ * changes to the user database still show up.
+ *
+ * The lookups are done without holding the lock, so that a slow lookup
+ * doesn't block the other threads which only need cached names.
+ */
+template<typename Id>
+class KIdNameCache
+{
+public:
+    using LookUp = QString (*)(const Id &id);
+
+    explicit KIdNameCache(LookUp lookUp)
+        : m_lookUp(lookUp)
+    {
+        m_clock.start();
+    }
+
+    QString name(const Id &id)
+    {
+        return names({id}).constFirst();
+    }
+
+    QStringList names(const QList<Id> &ids)
+    {
+        QStringList result;
+        result.reserve(ids.size());
+        QSet<Id> missing;
+
+        QMutexLocker locker(&m_mutex);
+        const qint64 now = m_clock.elapsed();
+        for (const Id &id : ids) {
+            const auto it = m_entries.constFind(id);
+            if (it != m_entries.constEnd() && it->expiry > now) {
+                result.append(it->name);
+            } else {
+                result.append(QString());
+                missing.insert(id);
+            }
+        }
+        if (missing.isEmpty()) {
+            return result;
+        }
+        locker.unlock();
+
+        QHash<Id, QString> found;
+        found.reserve(missing.size());
+        for (const Id &id : std::as_const(missing)) {
+            found.insert(id, kidNameCacheKeyIsValid(id) ? m_lookUp(id) : QString());
+        }
+
+        locker.relock();
+        if (m_entries.size() + found.size() > s_maxEntries) {
+            prune(m_clock.elapsed());
+        }
+        const qint64 expiry = m_clock.elapsed() + s_timeToLive;
+        for (auto it = found.cbegin(); it != found.cend(); ++it) {
+            m_entries.insert(it.key(), Entry{it.value(), expiry});
+        }
+        locker.unlock();
+
+        for (qsizetype i = 0; i < ids.size(); ++i) {
+            const auto it = found.constFind(ids.at(i));
+            if (it != found.constEnd()) {
+                result[i] = it.value();
+            }
+        }
+        return result;
+    }
+
+    /** Caches @p name for @p id, e.g. once it was found in some other way */
+    void insert(const Id &id, const QString &name)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_entries.size() >= s_maxEntries) {
+            prune(m_clock.elapsed());
+        }
+        m_entries.insert(id, Entry{name, m_clock.elapsed() + s_timeToLive});
+    }
+
+    /** Drops all names, e.g. once it is known that they changed */
+    void clear()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_entries.clear();
+    }
+
+private:
+    // Drops the expired entries, or all of them if that isn't enough
+    void prune(qint64 now)
+    {
+        m_entries.removeIf([now](typename QHash<Id, Entry>::iterator it) {
+            return it.value().expiry <= now;
+        });
+        if (m_entries.size() >= s_maxEntries) {
+            m_entries.clear();
+        }
+    }
+
+    struct Entry {
+        QString name;
+        qint64 expiry;
+    };
+
+    static constexpr qint64 s_timeToLive = 60 * 1000;
+    static constexpr qsizetype s_maxEntries = 10000;
+
+    const LookUp m_lookUp;
+    QMutex m_mutex;
+    QElapsedTimer m_clock;
+    QHash<Id, Entry> m_entries;
+};
+
+/** @return the cache for the login names of user ids, shared by the whole library */
+KIdNameCache<KUserId> &kuserNameCache();
+
+/** @return the cache for the names of group ids, shared by the whole library */
+KIdNameCache<KGroupId> &kgroupNameCache();
+
+/** @return the cache for the home directories of login names, shared by the whole library */
+KIdNameCache<QString> &kuserHomeDirCache();
+
+#endif // KUSER_P_H
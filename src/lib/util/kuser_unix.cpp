@@ -10,7 +10,11 @@
 #include "config-util.h"
 #include "kcoreaddons_debug.h"
 #include "kuser.h"
+#include "kuser_p.h"
 
+#include <KDirWatch>
+#include <QCoreApplication>
+#include <QDir>
 #include <QFileInfo>
 
 #include <cerrno>
@@ -21,6 +25,7 @@
 
 #include <algorithm> // std::find
 #include <functional> // std::function
+#include <mutex> // std::call_once
 
 #if defined(__BIONIC__) && __ANDROID_API__ < 26
 static inline struct passwd *getpwent()
@@ -236,24 +241,66 @@ QString KUser::homeDir() const
     return d->homeDir;
 }
 
-QString KUser::faceIconPath() const
+// The face icon of a user with the home directory @p homeDir, if it has none from AccountsService
+static QString homeFaceIconPath(const QString &homeDir)
 {
-    QString pathToFaceIcon;
-    if (!d->loginName.isEmpty()) {
-        pathToFaceIcon = QStringLiteral(ACCOUNTS_SERVICE_ICON_DIR) + QLatin1Char('/') + d->loginName;
-    }
+    const QString pathToFaceIcon = homeDir + QLatin1Char('/') + QLatin1String(".face.icon");
+    return QFileInfo(pathToFaceIcon).isReadable() ? pathToFaceIcon : QString();
+}
 
+static QString lookUpFaceIcon(const QString &loginName)
+{
+    const QString pathToFaceIcon = QStringLiteral(ACCOUNTS_SERVICE_ICON_DIR) + QLatin1Char('/') + loginName;
     if (QFile::exists(pathToFaceIcon)) {
         return pathToFaceIcon;
     }
+    return homeFaceIconPath(kuserHomeDirCache().name(loginName));
+}
+
+/**
+ * The face icons of login names. Checking for them may stat files in the homes
+ * of the users, which are possibly on the network, so they are cached.
+ *
+ * Changes to the AccountsService icons and to the icon of the current user are
+ * noticed with KDirWatch, in the main thread. The icons of the other users are
+ * only looked up again once their entries expire, as watching their homes would
+ * poll them on network file systems.
+ */
+static KIdNameCache<QString> &kuserFaceIconCache()
+{
+    static KIdNameCache<QString> cache(lookUpFaceIcon);
+    static std::once_flag watching;
+    std::call_once(watching, []() {
+        QCoreApplication *app = QCoreApplication::instance();
+        if (!app) {
+            return;
+        }
+        QMetaObject::invokeMethod(
+            app,
+            []() {
+                auto *watch = new KDirWatch(QCoreApplication::instance());
+                watch->addDir(QStringLiteral(ACCOUNTS_SERVICE_ICON_DIR));
+                watch->addFile(QDir::homePath() + QLatin1String("/.face.icon"));
+                const auto invalidate = []() {
+                    kuserFaceIconCache().clear();
+                };
+                QObject::connect(watch, &KDirWatch::dirty, watch, invalidate);
+                QObject::connect(watch, &KDirWatch::created, watch, invalidate);
+                QObject::connect(watch, &KDirWatch::deleted, watch, invalidate);
+            },
+            Qt::QueuedConnection);
+    });
+    return cache;
+}
 
-    pathToFaceIcon = homeDir() + QLatin1Char('/') + QLatin1String(".face.icon");
-
-    if (QFileInfo(pathToFaceIcon).isReadable()) {
-        return pathToFaceIcon;
+QString KUser::faceIconPath() const
+{
+    if (d->loginName.isEmpty()) {
+        return homeFaceIconPath(homeDir());
     }
-
-    return QString();
+    // Known already, so it isn't looked up again
+    kuserHomeDirCache().insert(d->loginName, homeDir());
+    return kuserFaceIconCache().name(d->loginName);
 }
 
 QString KUser::shell() const
@@ -280,8 +327,25 @@ static void listGroupsForUser(const char *name, gid_t gid, uint maxCount, Func h
         numGroups = gid_buffer.size();
         getgrouplist(name, gid, gid_buffer.data(), &numGroups);
     }
+#if defined(_POSIX_THREAD_SAFE_FUNCTIONS) && !defined(Q_OS_OPENBSD) && (!defined(Q_OS_ANDROID) || defined(Q_OS_ANDROID) && (__ANDROID_API__ >= 24))
+    // thread-safe, so that the groups can be listed on another thread, e.g. by KUserLookupJob
+    QVarLengthArray<char, 1024> buf(os_gr_size());
+    struct group entry;
+    const auto getGroup = [&](gid_t groupId) -> struct group * {
+        struct group *g = nullptr;
+        int error;
+        while ((error = getgrgid_r(groupId, &entry, buf.data(), buf.size(), &g)) == ERANGE && buf.size() < 256000) {
+            buf.resize(buf.size() * 2);
+        }
+        return error == 0 ? g : nullptr;
+    };
+#else
+    const auto getGroup = [](gid_t groupId) {
+        return getgrgid(groupId); // ### not threadsafe
+    };
+#endif
     for (int i = 0; i < numGroups && found < maxCount; ++i) {
-        struct group *g = getgrgid(gid_buffer[i]); // ### not threadsafe
+        struct group *g = getGroup(gid_buffer[i]);
         // should never be null, but better be safe than crash
         if (g) {
             found++;
@@ -379,6 +443,11 @@ QStringList KUser::allUserNames(uint maxCount)
     return result;
 }
 
+QStringList KUser::namesForIds(const QList<KUserId> &ids)
+{
+    return kuserNameCache().names(ids);
+}
+
 KUser::~KUser()
 {
 }
@@ -580,10 +649,77 @@ QStringList KUserGroup::allGroupNames(uint maxCount)
     return result;
 }
 
+QStringList KUserGroup::namesForIds(const QList<KGroupId> &ids)
+{
+    return kgroupNameCache().names(ids);
+}
+
 KUserGroup::~KUserGroup()
 {
 }
 
+static QString lookUpUserName(const KUserId &uid)
+{
+#if defined(_POSIX_THREAD_SAFE_FUNCTIONS) && !defined(Q_OS_OPENBSD)
+    QVarLengthArray<char, 1024> buf(os_pw_size());
+    struct passwd entry;
+    struct passwd *pw = nullptr;
+    int error;
+    while ((error = getpwuid_r(uid.nativeId(), &entry, buf.data(), buf.size(), &pw)) == ERANGE) {
+        buf.resize(buf.size() * 2);
+    }
+    return error == 0 && pw ? QString::fromLocal8Bit(pw->pw_name) : QString();
+#else
+    static QMutex mutex; // getpwuid() is not thread-safe
+    QMutexLocker locker(&mutex);
+    const struct passwd *pw = getpwuid(uid.nativeId());
+    return pw ? QString::fromLocal8Bit(pw->pw_name) : QString();
+#endif
+}
+
+static QString lookUpGroupName(const KGroupId &gid)
+{
+#if defined(_POSIX_THREAD_SAFE_FUNCTIONS) && !defined(Q_OS_OPENBSD) && (!defined(Q_OS_ANDROID) || defined(Q_OS_ANDROID) && (__ANDROID_API__ >= 24))
+    // the buffer also holds the members, so it may need to be large
+    QVarLengthArray<char, 1024> buf(os_gr_size());
+    struct group entry;
+    struct group *gr = nullptr;
+    int error;
+    while ((error = getgrgid_r(gid.nativeId(), &entry, buf.data(), buf.size(), &gr)) == ERANGE && buf.size() < 256000) {
+        buf.resize(buf.size() * 2);
+    }
+    return error == 0 && gr ? QString::fromLocal8Bit(gr->gr_name) : QString();
+#else
+    static QMutex mutex; // getgrgid() is not thread-safe
+    QMutexLocker locker(&mutex);
+    const struct group *gr = getgrgid(gid.nativeId());
+    return gr ? QString::fromLocal8Bit(gr->gr_name) : QString();
+#endif
+}
+
+KIdNameCache<KUserId> &kuserNameCache()
+{
+    static KIdNameCache<KUserId> cache(lookUpUserName);
+    return cache;
+}
+
+KIdNameCache<KGroupId> &kgroupNameCache()
+{
+    static KIdNameCache<KGroupId> cache(lookUpGroupName);
+    return cache;
+}
+
+static QString lookUpHomeDir(const QString &loginName)
+{
+    return KUser(loginName).homeDir();
+}
+
+KIdNameCache<QString> &kuserHomeDirCache()
+{
+    static KIdNameCache<QString> cache(lookUpHomeDir);
+    return cache;
+}
+
 KUserId KUserId::fromName(const QString &name)
 {
     if (name.isEmpty()) {
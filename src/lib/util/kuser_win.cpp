@@ -8,6 +8,7 @@
 */
 
 #include "kuser.h"
+#include "kuser_p.h"
 
 #include "kcoreaddons_debug.h"
 #include <QDir>
@@ -482,6 +483,11 @@ QVariant KUser::property(UserProperty which) const
     return QVariant();
 }
 
+QStringList KUser::namesForIds(const QList<KUserId> &ids)
+{
+    return kuserNameCache().names(ids);
+}
+
 KUser::~KUser()
 {
 }
@@ -599,10 +605,59 @@ KGroupId KUserGroup::groupId() const
     return d->gid;
 }
 
+QStringList KUserGroup::namesForIds(const QList<KGroupId> &ids)
+{
+    return kgroupNameCache().names(ids);
+}
+
 KUserGroup::~KUserGroup()
 {
 }
 
+static QString nameFromUserId(const KUserId &uid)
+{
+    DWORD nameBufferLen = UNLEN + 1;
+    WCHAR nameBuffer[UNLEN + 1];
+    DWORD domainBufferLen = UNLEN + 1;
+    WCHAR domainBuffer[UNLEN + 1];
+    SID_NAME_USE use;
+    if (!LookupAccountSidW(nullptr, uid.nativeId(), nameBuffer, &nameBufferLen, domainBuffer, &domainBufferLen, &use)) {
+        return QString();
+    }
+    if (use != SidTypeUser && use != SidTypeDeletedAccount) {
+        return QString();
+    }
+    return QString::fromWCharArray(nameBuffer);
+}
+
+static QString lookUpGroupName(const KGroupId &gid)
+{
+    return nameFromGroupId(gid);
+}
+
+KIdNameCache<KUserId> &kuserNameCache()
+{
+    static KIdNameCache<KUserId> cache(nameFromUserId);
+    return cache;
+}
+
+KIdNameCache<KGroupId> &kgroupNameCache()
+{
+    static KIdNameCache<KGroupId> cache(lookUpGroupName);
+    return cache;
+}
+
+static QString lookUpHomeDir(const QString &loginName)
+{
+    return KUser(loginName).homeDir();
+}
+
+KIdNameCache<QString> &kuserHomeDirCache()
+{
+    static KIdNameCache<QString> cache(lookUpHomeDir);
+    return cache;
+}
+
 QList<KUser> KUser::allUsers(uint maxCount)
 {
     QList<KUser> result;
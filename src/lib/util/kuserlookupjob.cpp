@@ -0,0 +1,87 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "kuserlookupjob.h"
+
+#include "kuser_p.h"
+
+// Shared with the work, which only writes it before the job emits its result
+struct KUserLookupJobResult {
+    QString name;
+    KUserId uid;
+    KUserLookupJob::LookupFlags flags;
+
+    KUser user = KUser(KUserId());
+    QList<KUserGroup> groups;
+    QString faceIconPath;
+
+    void lookUp(KThreadedJob::Context &context)
+    {
+        user = uid.isValid() ? KUser(uid) : KUser(name);
+        if (!user.isValid()) {
+            context.setError(static_cast<int>(KUserLookupJob::Error::NoSuchUser),
+                             QObject::tr("User %1 does not exist").arg(uid.isValid() ? uid.toString() : name));
+            return;
+        }
+        kuserNameCache().insert(user.userId(), user.loginName());
+        kuserHomeDirCache().insert(user.loginName(), user.homeDir());
+
+        if (flags.testFlag(KUserLookupJob::LookupGroups) && !context.isCanceled()) {
+            groups = user.groups();
+            for (const KUserGroup &group : std::as_const(groups)) {
+                kgroupNameCache().insert(group.groupId(), group.name());
+            }
+        }
+
+        if (flags.testFlag(KUserLookupJob::LookupFaceIcon) && !context.isCanceled()) {
+            faceIconPath = user.faceIconPath();
+        }
+    }
+};
+
+KUserLookupJob::KUserLookupJob(const std::shared_ptr<KUserLookupJobResult> &result, QObject *parent)
+    : KThreadedJob(
+        [result](Context &context) {
+            result->lookUp(context);
+        },
+        parent)
+    , m_result(result)
+{
+}
+
+KUserLookupJob::KUserLookupJob(const QString &name, LookupFlags flags, QObject *parent)
+    : KUserLookupJob(std::make_shared<KUserLookupJobResult>(), parent)
+{
+    m_result->name = name;
+    m_result->flags = flags;
+}
+
+KUserLookupJob::KUserLookupJob(KUserId uid, LookupFlags flags, QObject *parent)
+    : KUserLookupJob(std::make_shared<KUserLookupJobResult>(), parent)
+{
+    m_result->uid = uid;
+    m_result->flags = flags;
+}
+
+KUserLookupJob::~KUserLookupJob() = default;
+
+KUser KUserLookupJob::user() const
+{
+    // the work may still be running after the job was killed
+    return isFinished() && !error() ? m_result->user : KUser(KUserId());
+}
+
+QList<KUserGroup> KUserLookupJob::groups() const
+{
+    return isFinished() && !error() ? m_result->groups : QList<KUserGroup>();
+}
+
+QString KUserLookupJob::faceIconPath() const
+{
+    return isFinished() && !error() ? m_result->faceIconPath : QString();
+}
+
+#include "moc_kuserlookupjob.cpp"
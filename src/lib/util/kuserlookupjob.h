@@ -0,0 +1,106 @@
+/*
+    This file is part of the KDE project
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KUSERLOOKUPJOB_H
+#define KUSERLOOKUPJOB_H
+
+#include <kcoreaddons_export.h>
+#include <kthreadedjob.h>
+#include <kuser.h>
+
+#include <memory>
+
+struct KUserLookupJobResult;
+
+/**
+ * @class KUserLookupJob kuserlookupjob.h KUserLookupJob
+ *
+ * Looks up a user, and optionally its groups and face icon, on a thread pool.
+ *
+ * The user database may be on the network, e.g. with LDAP or SSSD, so that
+ * constructing a KUser or calling KUser::groups() can block for a long time.
+ * This job does it on another thread instead.
+ *
+ * The names found are also put into the caches used by KUser::namesForIds()
+ * and KUserGroup::namesForIds(), so that resolving them later doesn't block.
+ * The same goes for the face icon and KUser::faceIconPath(), which looks into
+ * the home directory of the user, possibly on a network file system.
+ *
+ * @code
+ * auto job = new KUserLookupJob(QStringLiteral("alice"), KUserLookupJob::LookupGroups);
+ * connect(job, &KJob::result, this, [job]() {
+ *     if (!job->error()) {
+ *         showUser(job->user(), job->groups());
+ *     }
+ * });
+ * job->start();
+ * @endcode
+ *
+ * @since 6.0
+ */
+class KCOREADDONS_EXPORT KUserLookupJob : public KThreadedJob
+{
+    Q_OBJECT
+
+public:
+    /**
+     * What to look up besides the user itself
+     */
+    enum LookupFlag {
+        NoLookupFlags = 0,
+        /** Also look up the groups of the user, see groups() */
+        LookupGroups = 1,
+        /** Also look up the face icon of the user, see faceIconPath() */
+        LookupFaceIcon = 2,
+    };
+    Q_DECLARE_FLAGS(LookupFlags, LookupFlag)
+    Q_FLAG(LookupFlags)
+
+    /**
+     * @brief Special error codes emitted by KUserLookupJob
+     */
+    enum class Error {
+        /*** There is no user with the given login name or id */
+        NoSuchUser = KJob::UserDefinedError + 1,
+    };
+
+    /**
+     * Creates a job looking up the user with the login name @p name
+     */
+    explicit KUserLookupJob(const QString &name, LookupFlags flags = NoLookupFlags, QObject *parent = nullptr);
+
+    /**
+     * Creates a job looking up the user with the id @p uid
+     */
+    explicit KUserLookupJob(KUserId uid, LookupFlags flags = NoLookupFlags, QObject *parent = nullptr);
+
+    ~KUserLookupJob() override;
+
+    /**
+     * @return the user found, which is invalid until the job finished successfully
+     */
+    KUser user() const;
+
+    /**
+     * @return the groups of the user, if LookupGroups was passed
+     */
+    QList<KUserGroup> groups() const;
+
+    /**
+     * @return the face icon of the user, if LookupFaceIcon was passed
+     * @see KUser::faceIconPath()
+     */
+    QString faceIconPath() const;
+
+private:
+    KUserLookupJob(const std::shared_ptr<KUserLookupJobResult> &result, QObject *parent);
+
+    std::shared_ptr<KUserLookupJobResult> const m_result;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KUserLookupJob::LookupFlags)
+
+#endif
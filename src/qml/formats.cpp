@@ -6,39 +6,104 @@
 
 #include "formats.h"
 
+#include <cstring>
+
+Formats::Formats() = default;
+
+Formats::~Formats() = default;
+
+void Formats::updateLocale() const
+{
+    const QLocale locale;
+    if (locale == m_locale) {
+        return;
+    }
+    m_locale = locale;
+    m_format = KFormat(locale);
+    m_results.clear();
+    for (auto &formatter : m_relativeDateFormatters) {
+        formatter.reset();
+    }
+}
+
+template<typename Format>
+QString Formats::cached(Method method, quint64 value, int option, Format format) const
+{
+    updateLocale();
+    const CacheKey key{method, value, option};
+    auto it = m_results.constFind(key);
+    if (it == m_results.cend()) {
+        if (m_results.size() >= MaxCachedResults) {
+            m_results.clear();
+        }
+        it = m_results.insert(key, format());
+    }
+    return *it;
+}
+
+KFormat::RelativeDateFormatter &Formats::relativeDateFormatter(QLocale::FormatType format) const
+{
+    updateLocale();
+    if (!m_relativeDateAge.isValid() || m_relativeDateAge.hasExpired(1000)) {
+        for (auto &formatter : m_relativeDateFormatters) {
+            if (formatter) {
+                formatter->refresh();
+            }
+        }
+        m_relativeDateAge.start();
+    }
+    const int index = qBound(0, int(format), int(QLocale::NarrowFormat));
+    auto &formatter = m_relativeDateFormatters[index];
+    if (!formatter) {
+        formatter = std::make_unique<KFormat::RelativeDateFormatter>(m_format, QLocale::FormatType(index));
+    }
+    return *formatter;
+}
+
 QString Formats::formatByteSize(double size, int precision) const
 {
-    return m_format.formatByteSize(size, precision);
+    quint64 bits;
+    static_assert(sizeof(bits) == sizeof(size));
+    std::memcpy(&bits, &size, sizeof(bits));
+    return cached(Method::ByteSize, bits, precision, [&]() {
+        return m_format.formatByteSize(size, precision);
+    });
 }
 
 QString Formats::formatDuration(quint64 msecs, KFormat::DurationFormatOptions options) const
 {
-    return m_format.formatDuration(msecs, options);
+    return cached(Method::Duration, msecs, int(options), [&]() {
+        return m_format.formatDuration(msecs, options);
+    });
 }
 
 QString Formats::formatDuration(quint64 msecs, int options) const
 {
-    return m_format.formatDuration(msecs, static_cast<KFormat::DurationFormatOptions>(options));
+    return formatDuration(msecs, static_cast<KFormat::DurationFormatOptions>(options));
 }
 
 QString Formats::formatDecimalDuration(quint64 msecs, int decimalPlaces) const
 {
-    return m_format.formatDecimalDuration(msecs, decimalPlaces);
+    return cached(Method::DecimalDuration, msecs, decimalPlaces, [&]() {
+        return m_format.formatDecimalDuration(msecs, decimalPlaces);
+    });
 }
 
 QString Formats::formatSpelloutDuration(quint64 msecs) const
 {
-    return m_format.formatSpelloutDuration(msecs);
+    return cached(Method::SpelloutDuration, msecs, 0, [&]() {
+        return m_format.formatSpelloutDuration(msecs);
+    });
 }
 
 QString Formats::formatRelativeDate(const QDate &date, QLocale::FormatType format) const
 {
-    return m_format.formatRelativeDate(date, format);
+    return relativeDateFormatter(format).formatRelativeDate(date);
 }
 
 QString Formats::formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format) const
 {
-    return m_format.formatRelativeDateTime(dateTime, format);
+    return relativeDateFormatter(format).formatRelativeDateTime(dateTime);
 }
 
 #include "moc_formats.cpp"
@@ -8,13 +8,27 @@
 #define FORMATS_H
 
 #include <KFormat>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
 
+#include <memory>
+
+/**
+ * Exposes KFormat to QML.
+ *
+ * Delegates of long views tend to format the same few values over and over,
+ * so the results are cached. The caches are dropped when the default locale
+ * changes, the relative dates are refreshed at most once per second.
+ */
 class Formats : public QObject
 {
     Q_OBJECT
 
 public:
+    Formats();
+    ~Formats() override;
+
     /**
      * Converts size from bytes to the appropriate string representation
      */
@@ -91,7 +105,43 @@ public:
     Q_INVOKABLE QString formatRelativeDateTime(const QDateTime &dateTime, QLocale::FormatType format) const;
 
 private:
-    const KFormat m_format;
+    enum class Method {
+        ByteSize,
+        Duration,
+        DecimalDuration,
+        SpelloutDuration,
+    };
+    struct CacheKey {
+        Method method;
+        // The bit pattern of the size for ByteSize, the msecs otherwise
+        quint64 value;
+        // The precision, options or decimal places
+        int option;
+
+        bool operator==(const CacheKey &other) const
+        {
+            return method == other.method && value == other.value && option == other.option;
+        }
+    };
+    friend size_t qHash(const CacheKey &key, size_t seed)
+    {
+        return qHashMulti(seed, int(key.method), key.value, key.option);
+    }
+
+    // Dropping everything is good enough, a view hardly shows that many different values
+    static constexpr qsizetype MaxCachedResults = 10000;
+
+    void updateLocale() const;
+    template<typename Format>
+    QString cached(Method method, quint64 value, int option, Format format) const;
+    KFormat::RelativeDateFormatter &relativeDateFormatter(QLocale::FormatType format) const;
+
+    mutable QLocale m_locale;
+    mutable KFormat m_format;
+    mutable QHash<CacheKey, QString> m_results;
+    // By QLocale::FormatType
+    mutable std::unique_ptr<KFormat::RelativeDateFormatter> m_relativeDateFormatters[QLocale::NarrowFormat + 1];
+    mutable QElapsedTimer m_relativeDateAge;
 };
 
 #endif
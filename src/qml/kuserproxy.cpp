@@ -10,87 +10,155 @@
 #include <QFile>
 #include <QHostInfo>
 #include <QTextStream>
+#include <QTimer>
 #include <QUrl>
 
+#include <KDirWatch>
+#include <KUser>
+
+#include <utility>
+
 const QString etcPasswd = QStringLiteral("/etc/passwd");
 const QString accountsServiceIconPath = QStringLiteral("/var/lib/AccountsService/icons");
 
-KUserProxy::KUserProxy(QObject *parent)
-    : QObject(parent)
-    , m_temporaryEmptyFaceIconPath(false)
+/**
+ * The information about the current user, looked up once and shared by all KUser items.
+ *
+ * The watched files tend to change in bursts, e.g. when the face icon gets written,
+ * so the notifications are collected for a moment before the information is
+ * looked up again. Only what actually changed gets notified.
+ */
+class KUserProxyBackend : public QObject
 {
-    QString pathToFaceIcon(m_user.faceIconPath());
-    if (pathToFaceIcon.isEmpty()) {
-        // KUser returns null if the current faceIconPath is empty
-        // so we should explicitly watch ~/.face.icon rather than faceIconPath()
-        // as we want to watch for this file being created
-        pathToFaceIcon = QDir::homePath() + QStringLiteral("/.face.icon");
+    Q_OBJECT
+
+public:
+    static std::shared_ptr<KUserProxyBackend> instance()
+    {
+        static std::weak_ptr<KUserProxyBackend> s_backend;
+        std::shared_ptr<KUserProxyBackend> backend = s_backend.lock();
+        if (!backend) {
+            backend = std::make_shared<KUserProxyBackend>();
+            s_backend = backend;
+        }
+        return backend;
     }
 
-    m_dirWatch.addFile(pathToFaceIcon);
-    m_dirWatch.addFile(accountsServiceIconPath + QLatin1Char('/') + m_user.loginName());
-    if (QFile::exists(etcPasswd)) {
-        m_dirWatch.addFile(etcPasswd);
+    KUserProxyBackend()
+    {
+        QString pathToFaceIcon(m_user.faceIconPath());
+        if (pathToFaceIcon.isEmpty()) {
+            // KUser returns null if the current faceIconPath is empty
+            // so we should explicitly watch ~/.face.icon rather than faceIconPath()
+            // as we want to watch for this file being created
+            pathToFaceIcon = QDir::homePath() + QStringLiteral("/.face.icon");
+        }
+
+        m_dirWatch.addFile(pathToFaceIcon);
+        m_dirWatch.addFile(accountsServiceIconPath + QLatin1Char('/') + m_user.loginName());
+        if (QFile::exists(etcPasswd)) {
+            m_dirWatch.addFile(etcPasswd);
+        }
+
+        connect(&m_dirWatch, &KDirWatch::dirty, this, &KUserProxyBackend::scheduleUpdate);
+        connect(&m_dirWatch, &KDirWatch::created, this, &KUserProxyBackend::scheduleUpdate);
+        connect(&m_dirWatch, &KDirWatch::deleted, this, &KUserProxyBackend::scheduleUpdate);
+
+        m_updateTimer.setSingleShot(true);
+        m_updateTimer.setInterval(100);
+        connect(&m_updateTimer, &QTimer::timeout, this, &KUserProxyBackend::update);
+
+        resolveNames();
+        resolveFaceIcon();
     }
 
-    connect(&m_dirWatch, &KDirWatch::dirty, this, &KUserProxy::update);
-    connect(&m_dirWatch, &KDirWatch::created, this, &KUserProxy::update);
-    connect(&m_dirWatch, &KDirWatch::deleted, this, &KUserProxy::update);
-}
+    QString fullName() const
+    {
+        return m_fullName;
+    }
 
-KUserProxy::~KUserProxy()
-{
-}
+    QString loginName() const
+    {
+        return m_loginName;
+    }
 
-void KUserProxy::update(const QString &path)
-{
-    if (path == m_user.faceIconPath() || path == QDir::homePath() + QLatin1String("/.face.icon")
-        || path == accountsServiceIconPath + QLatin1Char('/') + m_user.loginName()) {
-        // we need to force updates, even when the path doesn't change,
-        // but the underlying image does. Change path temporarily, to
-        // make the Image reload.
-        // Needs cache: false in the Image item to actually reload
-        m_temporaryEmptyFaceIconPath = true;
-        Q_EMIT faceIconUrlChanged();
-        m_temporaryEmptyFaceIconPath = false;
-        Q_EMIT faceIconUrlChanged();
-    } else if (path == etcPasswd) {
-        m_user = KUser();
-        Q_EMIT nameChanged();
+    QUrl faceIconUrl() const
+    {
+        return m_faceIconUrl;
     }
-}
 
-QString KUserProxy::fullName() const
-{
-    QString fullName = m_user.property(KUser::FullName).toString();
-    if (!fullName.isEmpty()) {
-        return fullName;
+    QString os()
+    {
+        if (m_os.isEmpty()) {
+            m_os = readOs();
+        }
+        return m_os;
     }
-    return loginName();
-}
 
-QString KUserProxy::loginName() const
-{
-    return m_user.loginName();
-}
+Q_SIGNALS:
+    void nameChanged();
+    // Also emitted when the face icon file changed, but its URL didn't
+    void faceIconChanged();
 
-QUrl KUserProxy::faceIconUrl() const
-{
-    if (m_temporaryEmptyFaceIconPath) {
-        return QUrl();
+private:
+    void scheduleUpdate(const QString &path)
+    {
+        if (path == m_user.faceIconPath() || path == QDir::homePath() + QLatin1String("/.face.icon")
+            || path == accountsServiceIconPath + QLatin1Char('/') + m_user.loginName()) {
+            m_faceIconDirty = true;
+        } else if (path == etcPasswd) {
+            m_userDirty = true;
+        } else {
+            return;
+        }
+        m_updateTimer.start();
+    }
+
+    void update()
+    {
+        bool faceIconChanged = std::exchange(m_faceIconDirty, false);
+        if (std::exchange(m_userDirty, false)) {
+            m_user = KUser();
+            const QString oldFullName = m_fullName;
+            const QString oldLoginName = m_loginName;
+            resolveNames();
+            if (m_fullName != oldFullName || m_loginName != oldLoginName) {
+                Q_EMIT nameChanged();
+            }
+            faceIconChanged = resolveFaceIcon() || faceIconChanged;
+        } else if (faceIconChanged) {
+            resolveFaceIcon();
+        }
+        if (faceIconChanged) {
+            Q_EMIT this->faceIconChanged();
+        }
+    }
+
+    void resolveNames()
+    {
+        m_loginName = m_user.loginName();
+        m_fullName = m_user.property(KUser::FullName).toString();
+        if (m_fullName.isEmpty()) {
+            m_fullName = m_loginName;
+        }
     }
-    const QString u = m_user.faceIconPath();
-    const QFile f(u);
-    if (f.exists(u)) {
+
+    // Returns whether the URL changed
+    bool resolveFaceIcon()
+    {
+        const QString u = m_user.faceIconPath();
+        const QFile f(u);
         // We need to return a file URL, not a simple path
-        return QUrl::fromLocalFile(u);
+        const QUrl faceIconUrl = f.exists(u) ? QUrl::fromLocalFile(u) : QUrl();
+        if (faceIconUrl == m_faceIconUrl) {
+            return false;
+        }
+        m_faceIconUrl = faceIconUrl;
+        return true;
     }
-    return QUrl();
-}
 
-QString KUserProxy::os()
-{
-    if (m_os.isEmpty()) {
+    static QString readOs()
+    {
         QFile osfile(QStringLiteral("/etc/os-release"));
         if (osfile.exists()) {
             if (!osfile.open(QIODevice::ReadOnly | QIODevice::Text)) {
@@ -106,14 +174,71 @@ QString KUserProxy::os()
                         osfile.close();
                         QString pretty = fields.at(1);
                         pretty.chop(1);
-                        m_os = pretty;
                         return pretty;
                     }
                 }
             }
         }
+        return QString();
     }
-    return m_os;
+
+    KDirWatch m_dirWatch;
+    KUser m_user;
+    QString m_fullName;
+    QString m_loginName;
+    QUrl m_faceIconUrl;
+    QString m_os;
+    QTimer m_updateTimer;
+    bool m_faceIconDirty = false;
+    bool m_userDirty = false;
+};
+
+KUserProxy::KUserProxy(QObject *parent)
+    : QObject(parent)
+    , m_backend(KUserProxyBackend::instance())
+    , m_temporaryEmptyFaceIconPath(false)
+{
+    connect(m_backend.get(), &KUserProxyBackend::nameChanged, this, &KUserProxy::nameChanged);
+    connect(m_backend.get(), &KUserProxyBackend::faceIconChanged, this, &KUserProxy::reloadFaceIcon);
+}
+
+KUserProxy::~KUserProxy()
+{
+}
+
+void KUserProxy::reloadFaceIcon()
+{
+    // we need to force updates, even when the path doesn't change,
+    // but the underlying image does. Change path temporarily, to
+    // make the Image reload.
+    // Needs cache: false in the Image item to actually reload
+    m_temporaryEmptyFaceIconPath = true;
+    Q_EMIT faceIconUrlChanged();
+    m_temporaryEmptyFaceIconPath = false;
+    Q_EMIT faceIconUrlChanged();
+}
+
+QString KUserProxy::fullName() const
+{
+    return m_backend->fullName();
+}
+
+QString KUserProxy::loginName() const
+{
+    return m_backend->loginName();
+}
+
+QUrl KUserProxy::faceIconUrl() const
+{
+    if (m_temporaryEmptyFaceIconPath) {
+        return QUrl();
+    }
+    return m_backend->faceIconUrl();
+}
+
+QString KUserProxy::os()
+{
+    return m_backend->os();
 }
 
 QString KUserProxy::host() const
@@ -121,4 +246,5 @@ QString KUserProxy::host() const
     return QHostInfo::localHostName();
 }
 
+#include "kuserproxy.moc"
 #include "moc_kuserproxy.cpp"
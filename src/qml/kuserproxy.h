@@ -11,8 +11,9 @@
 #include <QObject>
 #include <QUrl>
 
-#include <KDirWatch>
-#include <KUser>
+#include <memory>
+
+class KUserProxyBackend;
 
 /**
  * KUserProxy (exposed as KUser to the QML runtime) is an object allowing
@@ -105,10 +106,9 @@ Q_SIGNALS:
     void faceIconUrlChanged();
 
 private:
-    void update(const QString &path);
-    KDirWatch m_dirWatch;
-    KUser m_user;
-    QString m_os;
+    void reloadFaceIcon();
+    // Shared by all KUser items
+    std::shared_ptr<KUserProxyBackend> m_backend;
     bool m_temporaryEmptyFaceIconPath;
 };
 